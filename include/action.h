@@ -8,6 +8,7 @@
 struct view;
 struct server;
 struct cursor_context;
+struct action_params;
 
 struct action {
 	struct wl_list link; /*
@@ -18,10 +19,21 @@ struct action {
 
 	uint32_t type;        /* enum action_type */
 	struct wl_list args;  /* struct action_arg.link */
+
+	/* Arguments resolved by action_is_valid(), private to action.c */
+	struct action_params *params;
 };
 
+/* Allocated from rc.arena along with its arguments */
 struct action *action_create(const char *action_name);
 
+/**
+ * action_is_valid() - check for required arguments
+ * @action: action
+ *
+ * Valid actions also get their arguments resolved into the typed form
+ * used by actions_run(), so no more arguments must be added afterwards.
+ */
 bool action_is_valid(struct action *action);
 bool action_is_show_menu(struct action *action);
 
@@ -47,6 +59,10 @@ bool actions_contain_toggle_keybinds(struct wl_list *action_list);
 void actions_run(struct view *activator, struct server *server,
 	struct wl_list *actions, struct cursor_context *ctx);
 
+/*
+ * Releases what an action owns outside of rc.arena, the memory of the
+ * action itself goes with the arena
+ */
 void action_free(struct action *action);
 void action_list_free(struct wl_list *action_list);
 
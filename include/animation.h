@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_ANIMATION_H
+#define LABWC_ANIMATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-util.h>
+
+struct lab_animation;
+struct server;
+
+struct lab_animation_impl {
+	/*
+	 * Move the scene to @progress, which is eased and runs from 0 to
+	 * 1. The last step of an animation always has a @progress of 1.
+	 */
+	void (*step)(struct lab_animation *animation, double progress);
+	/* Called once after the last step, may restart the animation */
+	void (*finish)(struct lab_animation *animation);
+};
+
+/*
+ * A transition of scene nodes, stepped once per output frame. Animations
+ * only move or reveal scene nodes, they never configure clients, so they
+ * cost no client redraws and stay in step with the display.
+ */
+struct lab_animation {
+	const struct lab_animation_impl *impl;
+	int duration_msec;
+	/* Set by the first frame after animation_start() */
+	int64_t start_msec;
+	struct wl_list link; /* server.animations, self-linked if idle */
+};
+
+/* Set up an idle animation, to be embedded in the animated object */
+void animation_init(struct lab_animation *animation,
+	const struct lab_animation_impl *impl);
+
+/**
+ * animation_start() - run @animation from the next output frame on
+ * @server: server
+ * @animation: animation, restarted if it is running already
+ * @duration_msec: duration, an animation of 0 ms steps to 1 at once
+ */
+void animation_start(struct server *server, struct lab_animation *animation,
+	int duration_msec);
+
+/* Jump to the end of @animation if it is running, stepping it to 1 */
+void animation_finish(struct lab_animation *animation);
+
+bool animation_is_running(struct lab_animation *animation);
+
+/* Step all running animations, called for every output frame */
+void animations_output_frame(struct server *server);
+
+/* Jump to the end of all running animations */
+void animations_finish_all(struct server *server);
+
+#endif /* LABWC_ANIMATION_H */
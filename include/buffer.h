@@ -33,6 +33,8 @@ struct lab_data_buffer {
 	struct wlr_buffer base;
 
 	bool surface_owns_data;
+	/* data is owned by the pixel storage pool, see buffer_pool_trim() */
+	bool pooled;
 	cairo_surface_t *surface;
 	void *data;
 	uint32_t format; /* currently always DRM_FORMAT_ARGB8888 */
@@ -70,4 +72,13 @@ struct lab_data_buffer *buffer_create_cairo(uint32_t logical_width,
 struct lab_data_buffer *buffer_create_from_data(void *pixel_data, uint32_t width,
 	uint32_t height, uint32_t stride);
 
+/*
+ * Free all pixel storage kept for reuse by buffer_create_cairo(), for
+ * example after a Reconfigure released and recreated the theme buffers.
+ */
+void buffer_pool_trim(void);
+
+/* Log the size of the pixel storage pool and its reuse counters */
+void buffer_pool_log_stats(void);
+
 #endif /* LABWC_BUFFER_H */
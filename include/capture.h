@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_CAPTURE_H
+#define LABWC_CAPTURE_H
+
+#include <stdint.h>
+
+/*
+ * Wire format of <core><captureSocket>. For every committed output
+ * buffer which can be exported as a dmabuf, the consumer receives one
+ * struct lab_capture_frame followed by @n_rects struct lab_capture_rect,
+ * with the @n_planes plane file descriptors attached as SCM_RIGHTS. The
+ * buffer is not reused by the compositor until the consumer writes back
+ * the @serial of the frame as a uint32_t. Until then, further commits of
+ * that output are not sent and their damage is added to the next frame.
+ */
+#define LAB_CAPTURE_VERSION 1
+#define LAB_CAPTURE_MAX_PLANES 4
+#define LAB_CAPTURE_MAX_RECTS 64
+
+struct lab_capture_frame {
+	uint32_t version;
+	uint32_t serial;
+	char output[32];
+	int64_t commit_nsec; /* CLOCK_MONOTONIC */
+	uint32_t width;
+	uint32_t height;
+	uint32_t format; /* DRM fourcc */
+	uint32_t n_planes;
+	uint64_t modifier;
+	uint32_t offset[LAB_CAPTURE_MAX_PLANES];
+	uint32_t stride[LAB_CAPTURE_MAX_PLANES];
+	/* Damage since the last frame sent for the output, buffer-local */
+	uint32_t n_rects;
+	uint32_t reserved;
+};
+
+struct lab_capture_rect {
+	int32_t x, y, width, height;
+};
+
+struct output;
+struct server;
+struct wlr_output_state;
+
+/**
+ * capture_init() - listen on <core><captureSocket>
+ * @server: server
+ *
+ * Only one consumer is connected at a time, a new connection replaces
+ * the previous one.
+ */
+void capture_init(struct server *server);
+void capture_reconfigure(struct server *server);
+void capture_finish(struct server *server);
+
+/**
+ * capture_output_commit() - pass a committed buffer to the consumer
+ * @output: output
+ * @state: state which was just committed successfully
+ *
+ * Called before @state is finished, the buffer is locked if it is sent.
+ */
+void capture_output_commit(struct output *output,
+	struct wlr_output_state *state);
+
+/* Release the buffer held for @output */
+void capture_output_destroy(struct output *output);
+
+#endif /* LABWC_CAPTURE_H */
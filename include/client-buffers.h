@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_CLIENT_BUFFERS_H
+#define LABWC_CLIENT_BUFFERS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+struct server;
+struct wlr_compositor;
+
+/* Buffers committed by a client and not yet replaced or released */
+struct client_buffer_usage {
+	pid_t pid;
+	size_t bytes;
+	size_t peak_bytes;
+	int surfaces;
+};
+
+/**
+ * client_buffers_init() - account the buffers committed by each client
+ * @server: server
+ * @compositor: compositor whose surfaces are accounted
+ *
+ * The size of the buffer attached to each surface is added up per client
+ * on commit, estimated at four bytes per pixel. A client exceeding
+ * <core><clientBufferLimit> is logged or disconnected, depending on
+ * <core><clientBufferLimitAction>.
+ */
+void client_buffers_init(struct server *server,
+	struct wlr_compositor *compositor);
+void client_buffers_finish(void);
+
+void client_buffers_for_each(
+	void (*func)(const struct client_buffer_usage *usage, void *data),
+	void *data);
+
+#endif /* LABWC_CLIENT_BUFFERS_H */
@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_ARENA_H
+#define LABWC_ARENA_H
+
+#include <stddef.h>
+
+struct lab_arena_chunk;
+
+/*
+ * Bump allocator for objects which all go away at the same time. There
+ * is no way to free a single allocation, the whole arena is released at
+ * once. A zeroed struct lab_arena is an empty arena.
+ */
+struct lab_arena {
+	struct lab_arena_chunk *chunks; /* newest first */
+	size_t used;  /* bytes handed out from the newest chunk */
+	size_t bytes; /* total size of all chunks */
+};
+
+/**
+ * lab_arena_alloc() - allocate zeroed memory from an arena
+ * @arena: arena
+ * @size: size in bytes
+ *
+ * The memory is aligned for any type and stays valid until
+ * lab_arena_release(). Aborts on allocation failure like xzalloc().
+ */
+void *lab_arena_alloc(struct lab_arena *arena, size_t size);
+
+/* Like znew(), but allocated from @arena */
+#define lab_arena_new(arena, expr) \
+	((__typeof__(expr) *)lab_arena_alloc((arena), sizeof(expr)))
+
+/* Like xstrdup(), but allocated from @arena */
+char *lab_arena_strdup(struct lab_arena *arena, const char *str);
+
+/* Frees all memory of @arena, which is empty and reusable afterwards */
+void lab_arena_release(struct lab_arena *arena);
+
+#endif /* LABWC_ARENA_H */
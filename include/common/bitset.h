@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_BITSET_H
+#define LABWC_BITSET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Enough for all evdev keycodes (KEY_MAX is 0x2ff) */
+#define LAB_BITSET_MAX_BITS 768
+
+struct lab_bitset {
+	uint64_t words[LAB_BITSET_MAX_BITS / 64];
+};
+
+/* Values not below LAB_BITSET_MAX_BITS are ignored */
+bool lab_bitset_contains(const struct lab_bitset *set, uint32_t value);
+void lab_bitset_add(struct lab_bitset *set, uint32_t value);
+void lab_bitset_remove(struct lab_bitset *set, uint32_t value);
+int lab_bitset_count(const struct lab_bitset *set);
+
+/**
+ * lab_bitset_parse_list - add the values of a list like "0,2-3" to a set
+ * @set: set
+ * @list: comma separated values and inclusive ranges, spaces are allowed
+ *
+ * Returns false, leaving @set untouched, if @list is empty, malformed or
+ * has values not below LAB_BITSET_MAX_BITS.
+ */
+bool lab_bitset_parse_list(struct lab_bitset *set, const char *list);
+
+/**
+ * lab_bitset_next - iterate over the values of a set in ascending order
+ * @set: set
+ * @value: value to start from (inclusive)
+ *
+ * Returns the smallest value >= @value in @set or -1 if there is none.
+ */
+int lab_bitset_next(const struct lab_bitset *set, uint32_t value);
+
+#define lab_bitset_for_each(pos, set) \
+	for (int pos = lab_bitset_next((set), 0); pos >= 0; \
+		pos = lab_bitset_next((set), (uint32_t)pos + 1))
+
+#endif /* LABWC_BITSET_H */
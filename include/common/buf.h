@@ -8,6 +8,8 @@
 #ifndef LABWC_BUF_H
 #define LABWC_BUF_H
 
+#include <stddef.h>
+
 struct buf {
 	/**
 	 * Pointer to underlying string buffer. If alloc != 0, then
@@ -16,15 +18,16 @@ struct buf {
 	char *data;
 	/**
 	 * Allocated length of buf. If zero, data was not allocated
-	 * (either NULL or literal empty string).
+	 * (either NULL or literal empty string). Grows at least by half
+	 * each time, so appending is amortized O(1).
 	 */
-	int alloc;
+	size_t alloc;
 	/**
 	 * Length of string contents (not including terminating NUL).
 	 * Currently this must be zero if alloc is zero (i.e. non-empty
 	 * literal strings are not allowed).
 	 */
-	int len;
+	size_t len;
 };
 
 /** Value used to initialize a struct buf to an empty string */
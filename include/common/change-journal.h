@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_CHANGE_JOURNAL_H
+#define LABWC_CHANGE_JOURNAL_H
+
+#include <stdint.h>
+
+/* Generations a journal can tell apart, older ones report any change */
+#define LAB_CHANGE_JOURNAL_SIZE 32
+
+/*
+ * A generation counter with the kinds of changes of its most recent
+ * generations, so that caches can be validated against the generation
+ * they were built for and only the changes they depend on.
+ */
+struct lab_change_journal {
+	uint64_t generation;
+	/* Bitsets of change kinds, indexed by generation */
+	uint32_t changes[LAB_CHANGE_JOURNAL_SIZE];
+};
+
+/**
+ * lab_change_journal_record() - start a new generation
+ * @journal: journal, zero-initialized to begin with
+ * @changes: bitset of the kinds of change, as defined by the user
+ */
+void lab_change_journal_record(struct lab_change_journal *journal,
+	uint32_t changes);
+
+/**
+ * lab_change_journal_since() - get the changes after a generation
+ * @journal: journal
+ * @generation: generation seen by the caller
+ *
+ * Returns the bitset of all changes recorded after @generation, or all
+ * bits set if @generation is too old.
+ */
+uint32_t lab_change_journal_since(const struct lab_change_journal *journal,
+	uint64_t generation);
+
+#endif /* LABWC_CHANGE_JOURNAL_H */
@@ -12,9 +12,39 @@ struct path {
 struct wl_list *paths_get_prev(struct wl_list *elm);
 struct wl_list *paths_get_next(struct wl_list *elm);
 
+/*
+ * paths_config_create() and paths_theme_create() list all candidates,
+ * whether they exist or not, most important first.
+ */
 void paths_config_create(struct wl_list *paths, const char *filename);
 void paths_theme_create(struct wl_list *paths, const char *theme_name,
 	const char *filename);
+
+/**
+ * paths_config_find() - list the config files named @filename that exist
+ * @paths: list to fill with struct path, most important first
+ *
+ * The candidates are stat()ed once and the result is cached until one of
+ * the XDG variables changes or inotify reports a file being created,
+ * removed or renamed in the directories of the candidates. Files that
+ * are only modified keep their place, so this is no substitute for
+ * checking their content.
+ */
+void paths_config_find(struct wl_list *paths, const char *filename);
+
+/* Like paths_config_find() for paths_theme_create() */
+void paths_theme_find(struct wl_list *paths, const char *theme_name,
+	const char *filename);
+
+/* Drop the cache of paths_config_find() and paths_theme_find() */
+void paths_cache_finish(void);
+
+/**
+ * paths_data_create() - list @subdir in the XDG data directories
+ * @paths: list to fill with struct path, most important first
+ * @subdir: e.g. "icons" or "applications"
+ */
+void paths_data_create(struct wl_list *paths, const char *subdir);
 void paths_destroy(struct wl_list *paths);
 
 #endif /* LABWC_DIR_H */
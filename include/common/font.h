@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: GPL-2.0-only */
 #ifndef LABWC_FONT_H
 #define LABWC_FONT_H
+#include <cairo.h>
 #include <pango/pango-font.h>
 
 struct lab_data_buffer;
@@ -45,6 +46,16 @@ void font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 	const char *text, struct font *font, const float *color,
 	const float *bg_color, double scale);
 
+/*
+ * Like font_buffer_create() for text of a size measured before with
+ * font_get_buffer_size(), into a new image surface. It only uses cairo
+ * and pango, so it can be called off the main thread. Returns NULL for
+ * empty text.
+ */
+cairo_surface_t *font_render_surface(int width, int height, const char *text,
+	struct font *font, const float *color, const float *bg_color,
+	double scale);
+
 /**
  * font_finish - free some font related resources
  * Note: use on exit
@@ -13,8 +13,22 @@
 /**
  * grab_file - read file into memory buffer
  * @filename: file to read
+ *
+ * The file is read as is, newlines included, into a buffer sized by
+ * fstat(). If it cannot be read, BUF_INIT is returned, so the alloc
+ * member tells a missing file from an empty one.
  * Free returned buffer with buf_reset().
  */
 struct buf grab_file(const char *filename);
 
+/**
+ * grab_file_next_line - iterate over the lines of a buffer
+ * @buffer: buffer returned by grab_file()
+ * @pos: offset of the next line, initialize to 0
+ *
+ * The newline ending the line is replaced with NUL in place.
+ * Returns the next line or NULL after the last one.
+ */
+char *grab_file_next_line(struct buf *buffer, size_t *pos);
+
 #endif /* LABWC_GRAB_FILE_H */
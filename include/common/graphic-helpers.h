@@ -36,6 +36,15 @@ struct multi_rect {
 struct multi_rect *multi_rect_create(struct wlr_scene_tree *parent,
 		float *colors[3], int line_width);
 
+/**
+ * multi_rect_set_style() - change the colors and line width in place
+ *
+ * multi_rect_set_size() has to be called afterwards if @line_width has
+ * changed.
+ */
+void multi_rect_set_style(struct multi_rect *rect, float *colors[3],
+		int line_width);
+
 void multi_rect_set_size(struct multi_rect *rect, int width, int height);
 
 /**
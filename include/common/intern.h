@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_INTERN_H
+#define LABWC_INTERN_H
+
+#include <stdint.h>
+
+/*
+ * Interned strings ("atoms") are kept once per distinct content and
+ * refcounted. Two atoms are equal if and only if their pointers are, and
+ * their hash is computed only once, when the first reference is taken.
+ * Atoms are plain NUL-terminated strings otherwise and must not be
+ * modified.
+ */
+
+/**
+ * lab_intern() - take a reference to the atom of @str
+ * @str: string, NULL gives NULL
+ *
+ * Release the result with lab_intern_release().
+ */
+const char *lab_intern(const char *str);
+
+/* Returns the atom of @str without taking a reference, NULL if none */
+const char *lab_intern_find(const char *str);
+
+/* Drops a reference taken by lab_intern(), NULL is ignored */
+void lab_intern_release(const char *atom);
+
+/* Precomputed hash of @atom, 0 for NULL */
+uint32_t lab_intern_hash(const char *atom);
+
+#endif /* LABWC_INTERN_H */
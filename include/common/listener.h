@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_LISTENER_H
+#define LABWC_LISTENER_H
+
+#include <stddef.h>
+#include <wayland-server-core.h>
+
+/*
+ * One entry of a table binding the wl_listeners of an object to the
+ * signals of the object it listens to. Objects with many listeners, like
+ * views, connect and disconnect all of them with one loop over a static
+ * table instead of a line per listener.
+ */
+struct lab_listener_binding {
+	size_t signal_offset;   /* of the wl_signal in the emitter */
+	size_t listener_offset; /* of the wl_listener in the receiver */
+	wl_notify_func_t notify;
+};
+
+/**
+ * LAB_LISTENER() - table entry for the common naming pattern
+ *
+ * @src_type: emitter type, the wl_signal is (src_type).events.<name>
+ * @dest_type: receiver type, the wl_listener is (dest_type).<member>
+ * @member: listener member, may be nested like base.destroy
+ * @name: signal name, the handler is handle_<name>
+ */
+#define LAB_LISTENER(src_type, dest_type, member, name) { \
+	.signal_offset = offsetof(src_type, events.name), \
+	.listener_offset = offsetof(dest_type, member), \
+	.notify = handle_##name, \
+}
+
+/**
+ * lab_listeners_connect() - connect all listeners of a table
+ * @src: signal emitter
+ * @dest: listener receiver
+ * @bindings: table
+ * @count: number of entries in @bindings
+ */
+void lab_listeners_connect(void *src, void *dest,
+	const struct lab_listener_binding *bindings, size_t count);
+
+/**
+ * lab_listeners_disconnect() - disconnect all listeners of a table
+ * @dest: listener receiver passed to lab_listeners_connect()
+ * @bindings: table
+ * @count: number of entries in @bindings
+ */
+void lab_listeners_disconnect(void *dest,
+	const struct lab_listener_binding *bindings, size_t count);
+
+#endif /* LABWC_LISTENER_H */
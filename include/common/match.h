@@ -3,6 +3,7 @@
 #define LABWC_MATCH_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 /**
  * match_glob() - Pattern match using shell wildcard rules (see glob(7))
@@ -12,4 +13,46 @@
  */
 bool match_glob(const char *pattern, const char *string);
 
+enum match_glob_type {
+	LAB_MATCH_GLOB_NONE = 0,  /* no pattern, matches everything */
+	LAB_MATCH_GLOB_ANY,       /* "*" */
+	LAB_MATCH_GLOB_LITERAL,   /* "foo" */
+	LAB_MATCH_GLOB_PREFIX,    /* "foo*" */
+	LAB_MATCH_GLOB_SUFFIX,    /* "*foo" */
+	LAB_MATCH_GLOB_SUBSTRING, /* "*foo*" */
+	LAB_MATCH_GLOB_FNMATCH,   /* anything else */
+};
+
+/*
+ * A pattern pre-classified by match_glob_compile(). The pattern string is
+ * borrowed and must outlive the matcher.
+ */
+struct match_glob {
+	enum match_glob_type type;
+	const char *pattern;
+	const char *needle;  /* pattern without the leading/trailing stars */
+	size_t len;          /* length of needle */
+};
+
+/**
+ * match_glob_compile() - classify a pattern for match_glob_compiled()
+ * @glob: matcher to set up
+ * @pattern: pattern using shell wildcard rules, or NULL
+ *
+ * Patterns which are literal or only have stars at the start and/or end
+ * are matched with plain case-insensitive string compares. All others,
+ * and patterns with non-ASCII characters, fall back to fnmatch(3).
+ */
+void match_glob_compile(struct match_glob *glob, const char *pattern);
+
+/**
+ * match_glob_compiled() - same as match_glob() with a compiled pattern
+ * @glob: compiled pattern
+ * @string: string to search, may be NULL
+ *
+ * Returns true without a pattern. Otherwise returns false for a NULL
+ * string.
+ */
+bool match_glob_compiled(const struct match_glob *glob, const char *string);
+
 #endif /* LABWC_MATCH_H */
@@ -2,7 +2,11 @@
 #ifndef LABWC_MEM_H
 #define LABWC_MEM_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include "config.h"
 
 /*
  * As defined in busybox, weston, etc.
@@ -60,4 +64,50 @@ char *xstrdup(const char *str);
 	free(ptr); (ptr) = NULL; \
 } while (0)
 
+/*
+ * Allocation accounting, built in with the meson option
+ * -Dmem-accounting=enabled. Allocations made through the functions
+ * above are tagged with the subsystem of the source file they are made
+ * from, and free() is redirected to keep track of live and peak bytes.
+ *
+ * Memory allocated here and freed elsewhere, for example by a glib
+ * destroy notifier set to plain free, stays accounted until its address
+ * is handed out again.
+ */
+enum mem_tag {
+	LAB_MEM_CONFIG = 0,
+	LAB_MEM_THEME,
+	LAB_MEM_VIEW,
+	LAB_MEM_SSD,
+	LAB_MEM_INPUT,
+	LAB_MEM_PROTOCOL,
+	LAB_MEM_OTHER,
+
+	LAB_MEM_TAG_COUNT
+};
+
+struct mem_stats {
+	size_t live_bytes;
+	size_t peak_bytes;
+	uint64_t allocations;
+	uint64_t frees;
+};
+
+const char *mem_tag_name(enum mem_tag tag);
+
+/* Returns false, with @stats zeroed, without allocation accounting */
+bool mem_get_stats(enum mem_tag tag, struct mem_stats *stats);
+
+#if HAVE_MEM_ACCOUNTING
+void *mem_xzalloc(size_t size, const char *file);
+void *mem_xrealloc(void *ptr, size_t size, const char *file);
+char *mem_xstrdup(const char *str, const char *file);
+void mem_free(void *ptr);
+
+#define xzalloc(size) mem_xzalloc((size), __FILE__)
+#define xrealloc(ptr, size) mem_xrealloc((ptr), (size), __FILE__)
+#define xstrdup(str) mem_xstrdup((str), __FILE__)
+#define free(ptr) mem_free(ptr)
+#endif
+
 #endif /* LABWC_MEM_H */
@@ -3,6 +3,7 @@
 #define LABWC_SCALED_ICON_BUFFER_H
 
 #include <stdbool.h>
+#include <wayland-server-core.h>
 
 struct wlr_scene_tree;
 struct wlr_scene_node;
@@ -12,10 +13,14 @@ struct scaled_icon_buffer {
 	struct scaled_scene_buffer *scaled_buffer;
 	struct wlr_scene_buffer *scene_buffer;
 	struct server *server;
-	char *app_id;
-	char *icon_name;
+	/* Interned, see common/intern.h */
+	const char *app_id;
+	const char *icon_name;
 	int width;
 	int height;
+	/* Notified by the icon loader while the icon is being decoded */
+	struct wl_listener on_ready;
+	bool waiting;
 };
 
 /*
@@ -3,14 +3,24 @@
 #define LABWC_SCALED_RECT_BUFFER_H
 
 #include <stdint.h>
+#include <wayland-server-core.h>
 
 struct wlr_scene_tree;
 struct wlr_scene_buffer;
+struct wlr_scene_rect;
 struct scaled_scene_buffer;
 
 struct scaled_rect_buffer {
+	/* Set if rendered by cairo, see scaled_rect_buffer_create() */
 	struct wlr_scene_buffer *scene_buffer;
 	struct scaled_scene_buffer *scaled_buffer;
+
+	/* Set if built from rects, see scaled_rect_buffer_create_native() */
+	struct wlr_scene_tree *tree;
+	struct wlr_scene_rect *fill;
+	struct wlr_scene_rect *borders[4];
+	struct wl_listener destroy;
+
 	int width;
 	int height;
 	int border_width;
@@ -28,4 +38,23 @@ struct scaled_rect_buffer *scaled_rect_buffer_create(
 	struct wlr_scene_tree *parent, int width, int height, int border_width,
 	float fill_color[4], float border_color[4]);
 
+/**
+ * scaled_rect_buffer_create_native() - create a bordered rectangle from
+ * wlr_scene_rect nodes
+ * @parent: parent tree
+ * @width: width including the border
+ * @height: height including the border
+ * @border_width: border width
+ * @fill_color: fill color, nothing is drawn for a transparent one
+ * @border_color: border color
+ *
+ * Unlike scaled_rect_buffer_create() no pixels are stored at any scale,
+ * which matters for large rectangles on high-density outputs. The rects
+ * can't reject pointer input though, so overlays which must let the
+ * pointer through use the cairo variant. Position and destroy ->tree.
+ */
+struct scaled_rect_buffer *scaled_rect_buffer_create_native(
+	struct wlr_scene_tree *parent, int width, int height, int border_width,
+	float fill_color[4], float border_color[4]);
+
 #endif /* LABWC_SCALED_RECT_BUFFER_H */
@@ -2,16 +2,19 @@
 #ifndef LABWC_SCALED_SCENE_BUFFER_H
 #define LABWC_SCALED_SCENE_BUFFER_H
 
+#include <cairo.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <wayland-server-core.h>
 
-#define LAB_SCALED_BUFFER_MAX_CACHE 2
-
 struct wlr_buffer;
 struct wlr_scene_tree;
 struct lab_data_buffer;
 struct scaled_scene_buffer;
 
 struct scaled_scene_buffer_impl {
+	/* Short name of the implementation for debug output */
+	const char *name;
 	/* Return a new buffer optimized for the new scale */
 	struct lab_data_buffer *(*create_buffer)
 		(struct scaled_scene_buffer *scaled_buffer, double scale);
@@ -20,6 +23,25 @@ struct scaled_scene_buffer_impl {
 	/* Returns true if the two buffers are visually the same */
 	bool (*equal)(struct scaled_scene_buffer *scaled_buffer_a,
 		struct scaled_scene_buffer *scaled_buffer_b);
+	/*
+	 * Might be NULL. Returns a hash of the state compared by equal(),
+	 * buffers which are equal must have the same hash. If set, buffers
+	 * to share are looked up in a hash table rather than by calling
+	 * equal() on all other buffers.
+	 */
+	uint32_t (*hash)(struct scaled_scene_buffer *scaled_buffer);
+	/*
+	 * Might be NULL. If set, buffers replacing one that is shown are
+	 * rendered on a worker thread, see render-pool.h: prepare_async()
+	 * copies what is needed to render the buffer on the main thread,
+	 * render_async() renders it on a worker into an ARGB32 image surface
+	 * with the device scale set, like create_buffer() would, and
+	 * free_async() frees the copy on the main thread again.
+	 */
+	void *(*prepare_async)(struct scaled_scene_buffer *scaled_buffer);
+	cairo_surface_t *(*render_async)(void *state, int width, int height,
+		double scale);
+	void (*free_async)(void *state);
 };
 
 struct scaled_scene_buffer {
@@ -31,8 +53,10 @@ struct scaled_scene_buffer {
 	/* Private */
 	bool drop_buffer;
 	double active_scale;
-	/* cached wlr_buffers for each scale */
-	struct wl_list cache;  /* struct scaled_buffer_cache_entry.link */
+	/* Being rendered by impl->render_async(), NULL otherwise */
+	struct scaled_scene_buffer_job *job;
+	/* cached wlr_buffers for each scale, most recently used first */
+	struct wl_list cache;  /* struct scaled_scene_buffer_cache_entry.link */
 	struct wl_listener destroy;
 	struct wl_listener outputs_update;
 	const struct scaled_scene_buffer_impl *impl;
@@ -48,13 +72,14 @@ struct scaled_scene_buffer {
  *    .-----------------------------|----------------|-----------.
  *    |                             v                |           |
  *    |  .---------------.    .-------------------------.        |
- *    |  | scaled_buffer |----| wlr_buffer LRU cache(2) |<---,   |
+ *    |  | scaled_buffer |----| wlr_buffer LRU cache    |<---,   |
  *    |  ´---------------`    ´-------------------------`    |   |
  *    |           |                       |                  |   |
  *    |        .------.       .--------------------------.   |   |
  *    |        | impl |       | wlr_buffer LRU cache of  |   |   |
  *    |        ´------`       |   other scaled_buffers   |   |   |
- *    |                       |   with impl->equal()     |   |   |
+ *    |                       |   with impl->hash() and  |   |   |
+ *    |                       |   impl->equal()          |   |   |
  *    |                       ´--------------------------`   |   |
  *    |                          /              |            |   |
  *    |                   not found           found          |   |
@@ -69,14 +94,17 @@ struct scaled_scene_buffer {
  * Create an auto scaling buffer that creates a wlr_scene_buffer
  * and subscribes to its output_enter and output_leave signals.
  *
- * If the maximal scale changes, it either sets an already existing buffer
- * that was rendered for the current scale or - if there is none - calls
+ * If the maximal scale increases, it either sets an already existing
+ * buffer that was rendered for the new scale or - if there is none - calls
  * implementation->create_buffer(self, scale) to get a new lab_data_buffer
- * optimized for the new scale.
+ * optimized for the new scale. If the maximal scale decreases, the buffer
+ * of the higher scale is kept as long as any output still has that scale.
  *
- * Up to LAB_SCALED_BUFFER_MAX_CACHE (2) buffers are cached in an LRU fashion
- * to handle the majority of use cases where a view is moved between no more
- * than two different scales.
+ * Buffers for scales which are not shown anymore are kept in an LRU cache
+ * shared by all scaled_scene_buffers, so that moving a view between outputs
+ * with different scales doesn't re-render it every time. The cache is
+ * limited to <core><bufferCacheSize> MiB of pixel data in total, including
+ * the buffers currently shown which are never evicted.
  *
  * scaled_scene_buffer will clean up automatically once the internal
  * wlr_scene_buffer is being destroyed. If implementation->destroy is set
@@ -86,12 +114,19 @@ struct scaled_scene_buffer {
  * Besides caching buffers for each scale per scaled_scene_buffer, we also
  * store all the scaled_scene_buffers from all the implementers in a list
  * in order to reuse backing buffers for visually duplicated
- * scaled_scene_buffers found via impl->equal().
+ * scaled_scene_buffers found via impl->equal(). For implementations with
+ * impl->hash(), the cached buffers are indexed by impl, hash and scale
+ * instead, so only buffers with the same hash are compared.
+ *
+ * With impl->render_async(), a new buffer is rendered off the main thread
+ * if the scene buffer shows one already: the old buffer stays displayed
+ * until the new one is ready and swapped in. The first buffer is rendered
+ * right away, so that nothing is missing when a view maps.
  *
  * All requested lab_data_buffers via impl->create_buffer() will be locked
  * during the lifetime of the buffer in the internal cache and unlocked
- * when being evacuated from the cache (due to LAB_SCALED_BUFFER_MAX_CACHE
- * or the internal wlr_scene_buffer being destroyed).
+ * when being evacuated from the cache (due to the cache size limit or the
+ * internal wlr_scene_buffer being destroyed).
  *
  * If drop_buffer was set during creation of the scaled_scene_buffer, the
  * backing wlr_buffer behind a lab_data_buffer will also get dropped
@@ -130,17 +165,52 @@ void scaled_scene_buffer_request_update(struct scaled_scene_buffer *self,
 
 /**
  * scaled_scene_buffer_invalidate_sharing - clear the list of entire cached
- * scaled_scene_buffers used to share visually dupliated buffers. This should
+ * scaled_scene_buffers and the hash table of their buffers used to share
+ * visually dupliated buffers. This should
  * be called on Reconfigure to force updates of newly created
  * scaled_scene_buffers rather than reusing ones created before Reconfigure.
  */
 void scaled_scene_buffer_invalidate_sharing(void);
 
+#define LAB_SCALED_BUFFER_HASH_INIT 2166136261u
+
+/**
+ * scaled_scene_buffer_hash - mix @len bytes at @data into @hash, for use
+ * in impl->hash(). Start with LAB_SCALED_BUFFER_HASH_INIT.
+ */
+uint32_t scaled_scene_buffer_hash(uint32_t hash, const void *data, size_t len);
+
+/* Like scaled_scene_buffer_hash() for a string which may be NULL */
+uint32_t scaled_scene_buffer_hash_str(uint32_t hash, const char *str);
+
+/**
+ * scaled_scene_buffer_log_stats - log the size of the buffer cache and
+ * the number of hits, misses and evictions since startup
+ */
+void scaled_scene_buffer_log_stats(void);
+
+struct scaled_scene_buffer_stats {
+	size_t bytes;
+	size_t entries;
+	uint64_t hits;    /* found in the own cache */
+	uint64_t shared;  /* found in the cache of a visually equal buffer */
+	uint64_t misses;  /* rendered by impl->create_buffer() */
+	uint64_t evictions;
+};
+
+/* Size of the buffer cache and counters since startup */
+const struct scaled_scene_buffer_stats *scaled_scene_buffer_get_stats(void);
+
 /* Private */
 struct scaled_scene_buffer_cache_entry {
 	struct wl_list link;   /* struct scaled_scene_buffer.cache */
+	struct wl_list lru_link; /* global LRU, most recently used first */
+	struct wl_list share_link; /* struct share_index_entry.cache_entries */
+	struct share_index_entry *share; /* NULL if not indexed */
+	struct scaled_scene_buffer *owner;
 	struct wlr_buffer *buffer;
 	double scale;
+	size_t size;  /* bytes of pixel data, approximated */
 };
 
 #endif /* LABWC_SCALED_SCENE_BUFFER_H */
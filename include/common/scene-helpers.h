@@ -18,6 +18,9 @@ struct wlr_surface *lab_wlr_surface_from_node(struct wlr_scene_node *node);
  */
 struct wlr_scene_node *lab_wlr_scene_get_prev_node(struct wlr_scene_node *node);
 
+/* Damage the whole output and schedule a new frame */
+void lab_wlr_scene_output_damage_whole(struct wlr_scene_output *scene_output);
+
 /* A variant of wlr_scene_output_commit() that respects wlr_output->pending */
 bool lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output,
 	struct wlr_output_state *output_state);
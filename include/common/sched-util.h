@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_SCHED_UTIL_H
+#define LABWC_SCHED_UTIL_H
+
+struct lab_bitset;
+
+enum lab_sched_policy {
+	LAB_SCHED_OTHER = 0,
+	LAB_SCHED_RR,
+	LAB_SCHED_FIFO,
+};
+
+/*
+ * Run the calling thread with @policy at @priority, clamped to the range
+ * of the policy, or with LAB_SCHED_OTHER at @nice. Children and threads
+ * started afterwards get the default policy and a nice value of at least
+ * 0, so that clients never inherit a raised priority.
+ */
+void set_scheduling(enum lab_sched_policy policy, int priority, int nice);
+
+/*
+ * Pin the calling thread, and the threads it starts from now on, to
+ * @cpus. Children are spawned with the previous affinity, which
+ * unpin_cpu_affinity() and repin_cpu_affinity() restore around spawning.
+ */
+void pin_cpu_affinity(const struct lab_bitset *cpus);
+void unpin_cpu_affinity(void);
+void repin_cpu_affinity(void);
+
+/* Lock the pages mapped so far into memory */
+void lock_memory(void);
+
+#endif /* LABWC_SCHED_UTIL_H */
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_SHADOW_H
+#define LABWC_SHADOW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * shadow_profile() - shadow opacity as a function of the distance from the
+ * window, sampled once per pixel of the total shadow width
+ * @total_size: visible plus inset size of the shadow
+ *
+ * Both the edge and the corner buffers are drawn from this profile, so exp()
+ * is only evaluated @total_size times rather than for every pixel. The
+ * returned array must be freed by the caller.
+ */
+double *shadow_profile(int total_size);
+
+/**
+ * shadow_edge_gradient() - draw the buffer used to render the edges of
+ * window drop-shadows
+ * @pixels: ARGB8888 row of @visible_size pixels
+ * @profile: profile from shadow_profile()
+ * @visible_size: size of the shadow extending beyond the window
+ * @total_size: visible plus inset size of the shadow
+ * @start_color: premultiplied RGBA color at the window edge
+ *
+ * The buffer is 1 pixel tall and can be rotated and scaled for the different
+ * edges. It is drawn as would be found at the right-hand edge of a window,
+ * fading from @start_color at its left edge to clear at its right edge.
+ */
+void shadow_edge_gradient(uint32_t *pixels, const double *profile,
+	int visible_size, int total_size, const float start_color[4]);
+
+/**
+ * shadow_corner_gradient() - draw the buffer used to render the corners of
+ * window drop-shadows
+ * @pixels: ARGB8888 square of @total_size pixels
+ * @stride: stride of @pixels in bytes
+ * @profile: profile from shadow_profile()
+ * @visible_size: size of the shadow extending beyond the window
+ * @total_size: visible plus inset size of the shadow
+ * @titlebar_height: height of the opaque titlebar, 0 for bottom corners
+ * @start_color: premultiplied RGBA color at the window corner
+ *
+ * The shadow looks better if the buffer is inset behind the window. It is
+ * drawn for the bottom-right corner but can be rotated for other corners,
+ * fading from @start_color at the top-left to clear at the opposite edge.
+ *
+ * If the window is translucent we don't want the shadow to be visible through
+ * it. For the bottom corners of the window this is easy, we just erase the
+ * square of the buffer which will be behind the window. For the top it's a
+ * little more complicated because the titlebar can have rounded corners.
+ * However, the titlebar itself is always opaque so we only have to erase the
+ * L-shaped area of the buffer which can appear behind the non-titlebar part of
+ * the window.
+ */
+void shadow_corner_gradient(uint32_t *pixels, size_t stride,
+	const double *profile, int visible_size, int total_size,
+	int titlebar_height, const float start_color[4]);
+
+#endif /* LABWC_SHADOW_H */
@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_SLAB_H
+#define LABWC_SLAB_H
+
+#include <stddef.h>
+
+struct lab_slab_chunk;
+struct lab_slab_free;
+
+/*
+ * Cache of same-sized objects which are created and destroyed at a high
+ * rate, like popups. Objects are carved out of chunks of several objects
+ * each and freed objects are kept on a free list for the next allocation,
+ * so the chunks are only given back by lab_slab_release().
+ *
+ * Builds with assertions poison freed objects and check the poison when
+ * an object is handed out again, to catch writes after free.
+ */
+struct lab_slab {
+	size_t size; /* of one object, set by LAB_SLAB_INIT() */
+	struct lab_slab_chunk *chunks;
+	struct lab_slab_free *free;
+	size_t nr_live;
+};
+
+/* Initializer for a cache of objects of @type */
+#define LAB_SLAB_INIT(type) { .size = sizeof(type) }
+
+/**
+ * lab_slab_alloc() - allocate a zeroed object from a cache
+ * @slab: cache
+ *
+ * Aborts on allocation failure like xzalloc().
+ */
+void *lab_slab_alloc(struct lab_slab *slab);
+
+/* Like znew(), but allocated from @slab */
+#define lab_slab_new(slab, expr) \
+	((__typeof__(expr) *)lab_slab_alloc(slab))
+
+/**
+ * lab_slab_free() - return an object to its cache
+ * @slab: cache it was allocated from
+ * @ptr: object, may be NULL
+ */
+void lab_slab_free(struct lab_slab *slab, void *ptr);
+
+/*
+ * Frees all chunks of @slab. Objects still allocated from it become
+ * invalid, the cache is empty and reusable afterwards.
+ */
+void lab_slab_release(struct lab_slab *slab);
+
+#endif /* LABWC_SLAB_H */
@@ -2,8 +2,21 @@
 #ifndef LABWC_SPAWN_H
 #define LABWC_SPAWN_H
 
+#include <signal.h>
+#include <stdbool.h>
 #include <sys/types.h>
 
+struct wl_event_loop;
+
+/**
+ * spawn_child_exit_func_t - called once a watched child has exited
+ * @pid: pid of the child, which has been reaped already
+ * @info: exit code or signal as filled in by waitid()
+ * @data: as passed to spawn_watch_child()
+ */
+typedef void (*spawn_child_exit_func_t)(pid_t pid, const siginfo_t *info,
+	void *data);
+
 /**
  * spawn_primary_client - execute asynchronously
  * @command: command to be executed
@@ -16,6 +29,13 @@ pid_t spawn_primary_client(const char *command);
  */
 void spawn_async_no_shell(char const *command);
 
+/**
+ * spawn_async_argv - execute asynchronously
+ * @argv: NULL-terminated arguments, as from g_shell_parse_argv(),
+ *	  nothing is run if empty
+ */
+void spawn_async_argv(char *const argv[]);
+
 /**
  * spawn_piped - execute asynchronously
  * @command: command to be executed
@@ -38,4 +58,24 @@ pid_t spawn_piped(const char *command, int *pipe_fd);
  */
 void spawn_piped_close(pid_t pid, int pipe_fd);
 
+/**
+ * spawn_watch_child - reap a child through a pidfd on the event loop
+ * @loop: event loop to watch the pidfd on
+ * @pid: child to watch
+ * @callback: called from the event loop once the child has exited
+ * @data: passed to @callback
+ *
+ * Watched children are left alone by the generic SIGCHLD handler, see
+ * spawn_child_is_watched(). Returns false if pidfds are not supported,
+ * in which case the child is reaped by the SIGCHLD handler as before.
+ */
+bool spawn_watch_child(struct wl_event_loop *loop, pid_t pid,
+	spawn_child_exit_func_t callback, void *data);
+
+/* Whether @pid is reaped by spawn_watch_child() */
+bool spawn_child_is_watched(pid_t pid);
+
+/* Stop watching all children, on exit */
+void spawn_watch_finish(void);
+
 #endif /* LABWC_SPAWN_H */
@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_TOKEN_BUCKET_H
+#define LABWC_TOKEN_BUCKET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct lab_token_bucket {
+	uint32_t rate;  /* tokens refilled per second */
+	uint32_t burst; /* capacity in tokens */
+	/* Fill level in 1/1000 tokens so that slow rates refill smoothly */
+	uint64_t level;
+	uint64_t last_msec;
+};
+
+/**
+ * lab_token_bucket_init() - set up a full bucket
+ * @bucket: bucket
+ * @rate: tokens refilled per second
+ * @burst: maximum number of tokens, at least 1
+ * @now_msec: current monotonic time in milliseconds
+ */
+void lab_token_bucket_init(struct lab_token_bucket *bucket, uint32_t rate,
+	uint32_t burst, uint64_t now_msec);
+
+/**
+ * lab_token_bucket_take() - refill the bucket and take one token
+ * @bucket: bucket
+ * @now_msec: current monotonic time in milliseconds
+ *
+ * Returns false if the bucket is empty.
+ */
+bool lab_token_bucket_take(struct lab_token_bucket *bucket, uint64_t now_msec);
+
+#endif /* LABWC_TOKEN_BUCKET_H */
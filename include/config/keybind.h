@@ -42,4 +42,17 @@ uint32_t parse_modifier(const char *symname);
 bool keybind_the_same(struct keybind *a, struct keybind *b);
 
 void keybind_update_keycodes(struct server *server);
+
+/**
+ * keybind_lookup - find the keybinds bound to a key
+ * @modifiers: modifier mask, must match exactly
+ * @sym: keysym to look up, or XKB_KEY_NoSymbol to look up @keycode
+ * @keycode: keycode to look up when @sym is XKB_KEY_NoSymbol
+ * @len: set to the number of keybinds returned
+ *
+ * Returns an array of matching keybinds in rc.keybinds order, or NULL.
+ * The array is only valid until keybinds or keycodes change.
+ */
+struct keybind **keybind_lookup(uint32_t modifiers, xkb_keysym_t sym,
+	xkb_keycode_t keycode, size_t *len);
 #endif /* LABWC_KEYBIND_H */
@@ -3,6 +3,7 @@
 #define LABWC_LIBINPUT_H
 
 #include <libinput.h>
+#include <stdbool.h>
 #include <string.h>
 #include <wayland-server-core.h>
 
@@ -39,4 +40,11 @@ enum lab_libinput_device_type get_device_type(const char *s);
 struct libinput_category *libinput_category_create(void);
 struct libinput_category *libinput_category_get_default(void);
 
+/*
+ * Returns true if @a and @b configure a device the same way, regardless
+ * of the name and type they match devices by
+ */
+bool libinput_category_settings_equal(const struct libinput_category *a,
+	const struct libinput_category *b);
+
 #endif /* LABWC_LIBINPUT_H */
@@ -50,4 +50,33 @@ enum direction mousebind_direction_from_str(const char *str, uint32_t *modifiers
 struct mousebind *mousebind_create(const char *context);
 bool mousebind_the_same(struct mousebind *a, struct mousebind *b);
 
+/**
+ * mousebind_index_build - (re)build the dispatch index of rc.mousebinds
+ *
+ * Must be called whenever rc.mousebinds has changed, i.e. after the
+ * config has been read and deduplicated.
+ */
+void mousebind_index_build(void);
+void mousebind_index_finish(void);
+
+/**
+ * mousebind_lookup_button - find the button bindings for an event
+ * @type: part of the window (or other context) under the cursor
+ * @modifiers: modifier mask, must match exactly
+ * @button: button, e.g. BTN_LEFT
+ * @len: set to the number of mousebinds returned
+ *
+ * Returns all non-scroll mousebinds whose context contains @type, in
+ * rc.mousebinds order, or NULL. Callers still filter by mouse_event.
+ */
+struct mousebind **mousebind_lookup_button(enum ssd_part_type type,
+	uint32_t modifiers, uint32_t button, size_t *len);
+
+/**
+ * mousebind_lookup_scroll - like mousebind_lookup_button() for scroll
+ * bindings in @direction
+ */
+struct mousebind **mousebind_lookup_scroll(enum ssd_part_type type,
+	uint32_t modifiers, enum direction direction, size_t *len);
+
 #endif /* LABWC_MOUSEBIND_H */
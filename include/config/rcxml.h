@@ -6,9 +6,12 @@
 #include <stdio.h>
 #include <wayland-server-core.h>
 
+#include "common/arena.h"
+#include "common/bitset.h"
 #include "common/border.h"
 #include "common/buf.h"
 #include "common/font.h"
+#include "common/sched-util.h"
 #include "common/three-state.h"
 #include "config/touch.h"
 #include "config/tablet.h"
@@ -47,11 +50,61 @@ enum tiling_events_mode {
 		(LAB_TILING_EVENTS_REGION | LAB_TILING_EVENTS_EDGE),
 };
 
+enum client_limit_action {
+	LAB_CLIENT_LIMIT_WARN = 0,
+	LAB_CLIENT_LIMIT_DISCONNECT,
+};
+
+enum motion_coalesce_mode {
+	LAB_MOTION_COALESCE_NONE = 0,
+	LAB_MOTION_COALESCE_POINTER_FRAME,
+	LAB_MOTION_COALESCE_OUTPUT_FRAME,
+};
+
+enum modifier_broadcast_mode {
+	LAB_MODIFIER_BROADCAST_ALL = 0,
+	LAB_MODIFIER_BROADCAST_VISIBLE,
+	LAB_MODIFIER_BROADCAST_POINTER,
+	LAB_MODIFIER_BROADCAST_NONE,
+};
+
+enum magnifier_filter {
+	LAB_MAG_FILTER_NEAREST = 0,
+	LAB_MAG_FILTER_BILINEAR,
+};
+
 struct title_button {
 	enum ssd_part_type type;
 	struct wl_list link;
 };
 
+enum idle_output_policy {
+	LAB_IDLE_OUTPUT_NONE = 0,
+	LAB_IDLE_OUTPUT_MIN_REFRESH,
+	LAB_IDLE_OUTPUT_STOP,
+};
+
+struct idle_output_config {
+	char *output;  /* NULL matches all outputs */
+	int timeout;   /* in seconds */
+	enum idle_output_policy policy;
+	struct wl_list link; /* struct rcxml.idle_outputs */
+};
+
+enum autostart_stage {
+	LAB_AUTOSTART_NOW = 0,
+	LAB_AUTOSTART_AFTER_PANEL,
+	LAB_AUTOSTART_AFTER_XWAYLAND,
+
+	LAB_AUTOSTART_STAGE_COUNT
+};
+
+struct autostart_entry {
+	char *command;
+	enum autostart_stage stage;
+	struct wl_list link; /* struct rcxml.autostart */
+};
+
 struct usable_area_override {
 	struct border margin;
 	char *output;
@@ -64,17 +117,41 @@ struct rcxml {
 	char *config_file;
 	bool merge_config;
 
+	/*
+	 * Keybinds, mousebinds, actions, window rules and regions of the
+	 * current config, released at once by rcxml_finish()
+	 */
+	struct lab_arena arena;
+
 	/* core */
 	bool xdg_shell_server_side_deco;
 	int gap;
 	enum adaptive_sync_mode adaptive_sync;
+	int adaptive_sync_min_refresh; /* in Hz, 0 to disable */
 	enum tearing_mode allow_tearing;
 	bool auto_enable_outputs;
 	bool reuse_output_mode;
 	enum view_placement_policy placement_policy;
 	bool xwayland_persistence;
+	bool xwayland_warm_start;
 	int placement_cascade_offset_x;
 	int placement_cascade_offset_y;
+	int max_render_time;  /* in ms, 0 for off, -1 for auto */
+	bool repaint_queue;
+	bool frame_timing;
+	int frame_timing_log_interval; /* in seconds, 0 to disable */
+	char *metrics_socket;
+	char *capture_socket;
+	int buffer_cache_size; /* in MiB */
+	int client_buffer_limit; /* in MiB, 0 for none */
+	enum client_limit_action client_buffer_limit_action;
+	bool auto_reload;
+	/* Only applied at startup */
+	enum lab_sched_policy sched_policy;
+	int sched_priority;
+	int nice;
+	struct lab_bitset cpu_affinity; /* empty for no pinning */
+	bool lock_memory;
 
 	/* focus */
 	bool focus_follow_mouse;
@@ -104,15 +181,24 @@ struct rcxml {
 	/* <margin top="" bottom="" left="" right="" output="" /> */
 	struct wl_list usable_area_overrides;
 
+	/* <idleOutput output="" timeout="" policy="" /> */
+	struct wl_list idle_outputs;
+
+	/* <autostart><command after="">...</command></autostart> */
+	struct wl_list autostart;
+
 	/* keyboard */
 	int repeat_rate;
 	int repeat_delay;
 	enum three_state kb_numlock_enable;
 	bool kb_layout_per_window;
+	enum modifier_broadcast_mode kb_modifier_broadcast;
 	struct wl_list keybinds;   /* struct keybind.link */
 
 	/* mouse */
 	long doubleclick_time;     /* in ms */
+	enum motion_coalesce_mode motion_coalesce;
+	int scroll_action_limit;   /* per frame, 0 for no limit */
 	struct wl_list mousebinds; /* struct mousebind.link */
 
 	/* touch tablet */
@@ -130,6 +216,8 @@ struct rcxml {
 	struct tablet_tool_config {
 		enum motion motion;
 		double relative_motion_sensitivity;
+		bool coalesce_motion;
+		int motion_prediction;  /* in ms, 0 to disable */
 	} tablet_tool;
 
 	/* libinput */
@@ -157,6 +245,8 @@ struct rcxml {
 	struct {
 		int popuptime;
 		int min_nr_workspaces;
+		int swipe_fingers;  /* 0 for no workspace swipe */
+		int slide_time;     /* ms, 0 for no slide on switches */
 		char *prefix;
 		struct wl_list workspaces;  /* struct workspace.link */
 	} workspace_config;
@@ -184,12 +274,22 @@ struct rcxml {
 	int mag_height;
 	float mag_scale;
 	float mag_increment;
-	bool mag_filter;
+	enum magnifier_filter mag_filter;
 };
 
 extern struct rcxml rc;
 
 void rcxml_parse_xml(struct buf *b);
+
+/**
+ * rcxml_parse_buffer() - load the configuration from memory, like
+ * rcxml_read() does from a file, including the defaults and validation
+ * @data: contents of an rc.xml file, not necessarily NUL-terminated
+ * @len: length of @data
+ *
+ * Used by the fuzzer and the parser benchmark. Free with rcxml_finish().
+ */
+void rcxml_parse_buffer(const char *data, size_t len);
 void rcxml_read(const char *filename);
 void rcxml_finish(void);
 
@@ -2,6 +2,8 @@
 #ifndef LABWC_SESSION_H
 #define LABWC_SESSION_H
 
+#include "config/rcxml.h"
+
 struct server;
 
 /**
@@ -23,6 +25,17 @@ void session_environment_init(void);
  */
 void session_autostart_init(struct server *server);
 
+/**
+ * session_autostart_stage - launch the <autostart> commands of @stage
+ * @stage: LAB_AUTOSTART_AFTER_PANEL once a panel has mapped, or
+ *         LAB_AUTOSTART_AFTER_XWAYLAND once xwayland is ready
+ *
+ * Each stage is only launched once per session and not before
+ * session_autostart_init(). Every launch is logged with its time since
+ * the autostart began.
+ */
+void session_autostart_stage(enum autostart_stage stage);
+
 /**
  * session_shutdown - run session shutdown file as shell script
  * Note: Same as `sh ~/.config/labwc/shutdown` (or equivalent XDG config dir)
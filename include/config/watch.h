@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_CONFIG_WATCH_H
+#define LABWC_CONFIG_WATCH_H
+
+struct server;
+
+/*
+ * With <core><autoReload>, watch the directories of rc.xml, themerc,
+ * themerc-override and the environment files and call server_reload()
+ * for the files written, once writes have settled.
+ */
+void config_watch_init(struct server *server);
+
+/* Follow a changed <core><autoReload>, theme name or config directories */
+void config_watch_reconfigure(struct server *server);
+
+void config_watch_finish(void);
+
+#endif /* LABWC_CONFIG_WATCH_H */
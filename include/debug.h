@@ -6,4 +6,15 @@ struct server;
 
 void debug_dump_scene(struct server *server);
 
+/**
+ * debug_dump_scene_json() - write the scene graph as JSON
+ * @server: server
+ * @path: file to write, stdout if NULL
+ *
+ * Buffer nodes include the size of the buffer and its number of locks,
+ * which shows how often a scaled buffer is shared. Totals of distinct
+ * buffers are added per subsystem (client, theme, fonts, icons, overlays).
+ */
+void debug_dump_scene_json(struct server *server, const char *path);
+
 #endif /* LABWC_DEBUG_H */
@@ -12,6 +12,14 @@ void xdg_server_decoration_init(struct server *server);
 void kde_server_decoration_update_default(void);
 void kde_server_decoration_set_view(struct view *view, struct wlr_surface *surface);
 
+/*
+ * Re-apply the decoration policy of view_wants_decorations() after the
+ * window rules or <core><decoration> changed, to the views whose policy
+ * differs from the one last applied
+ */
+void kde_server_decoration_update_views(void);
+void xdg_server_decoration_update_views(void);
+
 void kde_server_decoration_finish(struct server *server);
 void xdg_server_decoration_finish(struct server *server);
 
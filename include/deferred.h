@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_DEFERRED_H
+#define LABWC_DEFERRED_H
+
+#include <stdbool.h>
+#include <wayland-util.h>
+
+struct wl_event_loop;
+struct wl_event_source;
+
+/*
+ * Follow-up work of signal handlers, run once an event loop iteration has
+ * dispatched its events and before outputs render.
+ *
+ * A task is queued at most once, so a burst of events each scheduling the
+ * same task, e.g. the XWayland workarea after several struts changed,
+ * results in a single recomputation. Tasks run in the order they were
+ * first scheduled; tasks scheduled by a running task run in the same
+ * flush.
+ */
+struct deferred_queue {
+	struct wl_event_source *idle;
+	struct wl_event_loop *loop;
+	struct wl_list tasks; /* struct deferred_task.link, in order */
+};
+
+typedef void (*deferred_func_t)(void *data);
+
+/*
+ * Either set up with deferred_task_init() or statically initialized with
+ * .func, .data may then be set before deferred_task_schedule()
+ */
+struct deferred_task {
+	struct wl_list link; /* only valid while queued */
+	deferred_func_t func;
+	void *data;
+	bool queued;
+};
+
+void deferred_queue_init(struct deferred_queue *queue,
+	struct wl_event_loop *loop);
+
+/* Drops all remaining tasks, so deferred_task_cancel() stays safe on them */
+void deferred_queue_finish(struct deferred_queue *queue);
+
+/**
+ * deferred_queue_flush() - run all queued tasks now
+ * @queue: queue
+ *
+ * Called by output frames, so that tasks scheduled earlier in the same
+ * event loop iteration are done before rendering.
+ */
+void deferred_queue_flush(struct deferred_queue *queue);
+
+/**
+ * deferred_task_init() - set up a task which is not queued
+ * @task: task
+ * @func: called from the queue, at most once per deferred_task_schedule()
+ * @data: passed to @func
+ */
+void deferred_task_init(struct deferred_task *task, deferred_func_t func,
+	void *data);
+
+/*
+ * Queue @task unless it is queued already. A task must not schedule
+ * itself unconditionally.
+ */
+void deferred_task_schedule(struct deferred_queue *queue,
+	struct deferred_task *task);
+
+void deferred_task_cancel(struct deferred_task *task);
+
+#endif /* LABWC_DEFERRED_H */
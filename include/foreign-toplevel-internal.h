@@ -3,12 +3,34 @@
 #define LABWC_FOREIGN_TOPLEVEL_INTERNAL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <wayland-server-core.h>
+#include "deferred.h"
 #include "foreign-toplevel.h"
 
+/* View state which has changed since the last flush to the clients */
+enum foreign_toplevel_dirty {
+	LAB_FOREIGN_DIRTY_APP_ID = 1 << 0,
+	LAB_FOREIGN_DIRTY_TITLE = 1 << 1,
+	LAB_FOREIGN_DIRTY_OUTPUTS = 1 << 2,
+	LAB_FOREIGN_DIRTY_MAXIMIZED = 1 << 3,
+	LAB_FOREIGN_DIRTY_MINIMIZED = 1 << 4,
+	LAB_FOREIGN_DIRTY_FULLSCREEN = 1 << 5,
+	LAB_FOREIGN_DIRTY_ACTIVATED = 1 << 6,
+};
+
 struct foreign_toplevel {
 	struct view *view;
 
+	/*
+	 * Changes are collected in @dirty and sent to the clients of all
+	 * protocols by @flush_task, once per event loop iteration
+	 */
+	uint32_t dirty;
+	struct deferred_task flush_task;
+	/* Last value of view->events.activated */
+	bool activated;
+
 	/* *-toplevel implementations */
 	struct wlr_foreign_toplevel {
 		struct wlr_foreign_toplevel_handle_v1 *handle;
@@ -74,6 +96,20 @@ struct foreign_toplevel {
 void ext_foreign_toplevel_init(struct foreign_toplevel *toplevel);
 void wlr_foreign_toplevel_init(struct foreign_toplevel *toplevel);
 
+/**
+ * foreign_toplevel_mark_dirty() - schedule sending the state in @dirty
+ * @toplevel: toplevel
+ * @dirty: bitset of enum foreign_toplevel_dirty
+ */
+void foreign_toplevel_mark_dirty(struct foreign_toplevel *toplevel,
+	uint32_t dirty);
+
+/* Send the state in @dirty, called by the idle source set up above */
+void ext_foreign_toplevel_flush(struct foreign_toplevel *toplevel,
+	uint32_t dirty);
+void wlr_foreign_toplevel_flush(struct foreign_toplevel *toplevel,
+	uint32_t dirty);
+
 void foreign_request_minimize(struct foreign_toplevel *toplevel, bool minimized);
 void foreign_request_maximize(struct foreign_toplevel *toplevel, enum view_axis axis);
 void foreign_request_fullscreen(struct foreign_toplevel *toplevel, bool fullscreen);
@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_HUD_H
+#define LABWC_HUD_H
+
+struct output;
+struct server;
+
+enum hud_mode {
+	LAB_HUD_OFF = 0,
+	/* Frame pacing from the presentation feedback, see metrics.h */
+	LAB_HUD_FRAME_PACING,
+	/*
+	 * Frame rate, render time, commit and input latency and the hit
+	 * rate of the scaled buffer cache
+	 */
+	LAB_HUD_PERF,
+};
+
+/**
+ * hud_toggle() - show the on-screen statistics in the top left corner of
+ * each output, or hide them if they are already shown in @mode
+ * @server: server
+ * @mode: set of statistics to show
+ *
+ * The text is refreshed twice per second and only re-rendered when it
+ * has changed, so the overlay only damages its own area.
+ */
+void hud_toggle(struct server *server, enum hud_mode mode);
+
+/* Pick up theme and font changes */
+void hud_reconfigure(struct server *server);
+void hud_output_destroy(struct output *output);
+void hud_finish(struct server *server);
+
+#endif /* LABWC_HUD_H */
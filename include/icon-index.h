@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_ICON_INDEX_H
+#define LABWC_ICON_INDEX_H
+
+/**
+ * icon_index_init() - load the index of the icon theme <theme><icon>
+ *
+ * The index is read from $XDG_CACHE_HOME/labwc/ if none of the scanned
+ * directories changed since it was written, otherwise the icon themes
+ * and desktop entries are scanned again and the cache is rewritten.
+ */
+void icon_index_init(void);
+
+/* Drop the index, to be followed by icon_index_init() on reconfigure */
+void icon_index_finish(void);
+
+/**
+ * icon_index_lookup() - find the file of an icon
+ * @name: icon name, or absolute path which is returned as is
+ * @size: size in pixels the icon is shown at
+ *
+ * Icons of the configured theme are preferred over inherited ones, and
+ * among those a scalable one or the one closest to @size, preferably
+ * downscaled. The result is valid until icon_index_finish().
+ */
+const char *icon_index_lookup(const char *name, int size);
+
+/**
+ * icon_index_lookup_app() - find the icon name of an application
+ * @app_id: app_id or WM_CLASS, compared case-insensitively to the desktop
+ *	    file ids and the StartupWMClass keys of the desktop entries
+ *
+ * Returns NULL if no desktop entry matches.
+ */
+const char *icon_index_lookup_app(const char *app_id);
+
+#endif /* LABWC_ICON_INDEX_H */
@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_ICON_LOADER_H
+#define LABWC_ICON_LOADER_H
+
+#include <cairo.h>
+#include <stdbool.h>
+
+struct server;
+struct wl_listener;
+
+/* Start the thread decoding icons */
+void icon_loader_init(struct server *server);
+void icon_loader_finish(void);
+
+/**
+ * icon_loader_get() - get an icon decoded at a size
+ * @path: icon file, png or svg
+ * @size: width and height in pixels
+ * @pending: set to true if the icon is still being decoded
+ *
+ * Returns NULL until the icon is decoded or if it cannot be decoded. The
+ * surface is owned by the loader and only valid until the next call.
+ */
+cairo_surface_t *icon_loader_get(const char *path, int size, bool *pending);
+
+/**
+ * icon_loader_add_ready_listener() - get notified about decoded icons
+ * @listener: called on the main thread when icons requested with
+ *	      icon_loader_get() have been decoded, it has to remove
+ *	      itself from the list then
+ */
+void icon_loader_add_ready_listener(struct wl_listener *listener);
+
+#endif /* LABWC_ICON_LOADER_H */
@@ -2,13 +2,18 @@
 #ifndef LABWC_IMG_SVG_H
 #define LABWC_IMG_SVG_H
 
-#include <librsvg/rsvg.h>
-
 struct lab_data_buffer;
+struct img_svg;
 
-RsvgHandle *img_svg_load(const char *filename);
+struct img_svg *img_svg_load(const char *filename);
 
-struct lab_data_buffer *img_svg_render(RsvgHandle *svg, int w, int h,
+/*
+ * Rasterisations are cached by file content, size and scale, across
+ * images and Reconfigure, so this only runs librsvg on a cache miss.
+ */
+struct lab_data_buffer *img_svg_render(struct img_svg *svg, int w, int h,
 	double scale);
 
+void img_svg_destroy(struct img_svg *svg);
+
 #endif /* LABWC_IMG_SVG_H */
@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_IMG_XPM_COLOR_H
+#define LABWC_IMG_XPM_COLOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * xpm_parse_color() - parse an XPM color specification
+ * @spec: X11 color name or #rgb, #rrggbb, #rrrgggbbb or #rrrrggggbbbb
+ * @argb: returns the opaque color in ARGB8888
+ *
+ * Returns false if @spec is not a valid color.
+ */
+bool xpm_parse_color(const char *spec, uint32_t *argb);
+
+#endif /* LABWC_IMG_XPM_COLOR_H */
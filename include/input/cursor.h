@@ -110,6 +110,13 @@ enum lab_cursors cursor_get_from_edge(uint32_t resize_edges);
  */
 void cursor_update_focus(struct server *server);
 
+/*
+ * Like cursor_update_focus(), once at the end of the event loop iteration,
+ * for changes of the output layout or of layer surfaces which may move a
+ * surface below the cursor, see deferred.h
+ */
+void cursor_schedule_focus_update(struct server *server);
+
 /**
  * cursor_update_image - re-set the labwc cursor image
  * @seat - seat
@@ -127,6 +134,16 @@ void cursor_update_image(struct seat *seat);
  */
 bool cursor_process_motion(struct server *server, uint32_t time, double *sx, double *sy);
 
+/**
+ * cursor_flush_motion - process pointer motion deferred by
+ * <mouse><coalesceMotion>, if any
+ * @seat - seat
+ *
+ * The cursor has already been moved, this does the hit-test, focus update
+ * and wl_pointer.motion for the final position of the batch.
+ */
+void cursor_flush_motion(struct seat *seat);
+
 /**
  * Processes cursor button press. The return value indicates if a client
  * should be notified.
@@ -147,6 +164,18 @@ bool cursor_process_button_release(struct seat *seat, uint32_t button, uint32_t
 bool cursor_finish_button_release(struct seat *seat, uint32_t button);
 
 void cursor_init(struct seat *seat);
+
+/**
+ * cursor_load_scale - load the cursor theme for an output scale
+ * @seat: seat
+ * @scale: scale of an output
+ *
+ * wlroots loads the images of a new scale on first use, which would
+ * otherwise read the theme from disk while the pointer moves onto an
+ * output. This loads them up front and resolves all labwc cursors.
+ */
+void cursor_load_scale(struct seat *seat, float scale);
+
 void cursor_reload(struct seat *seat);
 void cursor_emulate_move(struct seat *seat,
 		struct wlr_input_device *device,
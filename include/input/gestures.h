@@ -3,8 +3,22 @@
 #define LABWC_GESTURES_H
 
 struct seat;
+struct workspace;
 
 void gestures_init(struct seat *seat);
 void gestures_finish(struct seat *seat);
 
+/**
+ * gestures_output_frame() - advance a workspace swipe animation
+ * @seat: seat
+ *
+ * Called for every output frame. Swipe updates only accumulate the
+ * finger offset, the workspaces are moved here once per frame.
+ */
+void gestures_output_frame(struct seat *seat);
+
+/* Forgets @workspace if a workspace swipe is showing it */
+void gestures_workspace_destroyed(struct seat *seat,
+	struct workspace *workspace);
+
 #endif /* LABWC_GESTURES_H */
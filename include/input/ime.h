@@ -54,6 +54,19 @@ struct input_method_popup {
 	struct input_method_relay *relay;
 	struct wl_list link; /* input_method_relay.popups */
 
+	/*
+	 * Inputs of the last placement. Text-input commits which leave the
+	 * cursor rectangle and the popup size unchanged don't move it.
+	 */
+	struct {
+		bool valid;
+		uint32_t layout_generation;
+		struct wlr_box cursor_rect;
+		int width, height;
+		/* Layout box of the output the popup is constrained to */
+		struct wlr_box output_box;
+	} placement;
+
 	struct wl_listener destroy;
 	struct wl_listener commit;
 };
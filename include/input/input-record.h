@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_INPUT_RECORD_H
+#define LABWC_INPUT_RECORD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct seat;
+
+/*
+ * Input events are recorded as they reach the cursor and keyboard handlers
+ * into a file of fixed-size records, see struct input_record in
+ * input-record.c. A recording can be replayed through the cursor_emulate_*()
+ * functions and the keyboard key handler to measure the processing cost of
+ * each class of events.
+ */
+
+void input_record_motion(uint32_t time_msec, double dx, double dy);
+void input_record_button(uint32_t time_msec, uint32_t button, uint32_t state);
+void input_record_axis(uint32_t time_msec, uint32_t orientation,
+	uint32_t source, double delta, double delta_discrete);
+void input_record_key(uint32_t time_msec, uint32_t keycode, uint32_t state);
+
+/**
+ * input_record_toggle() - start recording to @path or stop recording
+ * @path: file to write, truncated when recording starts
+ */
+void input_record_toggle(const char *path);
+
+/**
+ * input_replay_start() - replay a recording
+ * @seat: seat to feed the events to
+ * @path: file written by a recording
+ * @speed: replay rate relative to the recording, 0 for as fast as possible
+ *
+ * A summary with the processing cost of each event class is logged once
+ * all events have been replayed. Events are not recorded during a replay.
+ */
+void input_replay_start(struct seat *seat, const char *path, double speed);
+
+/* Stop recording and replaying */
+void input_record_finish(void);
+
+#endif /* LABWC_INPUT_RECORD_H */
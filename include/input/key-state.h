@@ -4,6 +4,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "common/bitset.h"
 
 /*
  * All keycodes in these functions are (Linux) libinput evdev scancodes which is
@@ -11,19 +12,38 @@
  * Note: These keycodes are different to XKB scancodes by a value of 8.
  */
 
+/* Keys of the keyboards of one seat, see struct seat.key_state */
+struct key_state {
+	struct lab_bitset pressed;
+	struct lab_bitset bound;
+	/*
+	 * pressed_sent = pressed - bound, kept up to date on every change
+	 * so that key_state_pressed_sent_keycodes() can hand out the array
+	 * as-is. Keys are removed by moving the last element into their
+	 * slot, using sent_index to find it.
+	 */
+	struct lab_bitset pressed_sent;
+	uint32_t sent_keycodes[LAB_BITSET_MAX_BITS];
+	uint16_t sent_index[LAB_BITSET_MAX_BITS];
+	int nr_sent;
+};
+
 /**
  * key_state_pressed_sent_keycodes - generate array of pressed+sent keys
  * Note: The array is generated by subtracting any bound keys from _all_ pressed
  * keys (because bound keys were not forwarded to clients).
  */
-uint32_t *key_state_pressed_sent_keycodes(void);
-int key_state_nr_pressed_sent_keycodes(void);
+uint32_t *key_state_pressed_sent_keycodes(struct key_state *state);
+int key_state_nr_pressed_sent_keycodes(struct key_state *state);
 
-void key_state_set_pressed(uint32_t keycode, bool is_pressed);
-void key_state_store_pressed_key_as_bound(uint32_t keycode);
-bool key_state_corresponding_press_event_was_bound(uint32_t keycode);
-void key_state_bound_key_remove(uint32_t keycode);
-int key_state_nr_bound_keys(void);
-int key_state_nr_pressed_keys(void);
+void key_state_set_pressed(struct key_state *state, uint32_t keycode,
+	bool is_pressed);
+void key_state_store_pressed_key_as_bound(struct key_state *state,
+	uint32_t keycode);
+bool key_state_corresponding_press_event_was_bound(struct key_state *state,
+	uint32_t keycode);
+void key_state_bound_key_remove(struct key_state *state, uint32_t keycode);
+int key_state_nr_bound_keys(struct key_state *state);
+int key_state_nr_pressed_keys(struct key_state *state);
 
 #endif /* LABWC_KEY_STATE_H */
@@ -9,7 +9,7 @@ struct seat;
 struct keyboard;
 struct wlr_keyboard;
 
-void keyboard_reset_current_keybind(void);
+void keyboard_reset_current_keybind(struct seat *seat);
 void keyboard_configure(struct seat *seat, struct wlr_keyboard *kb,
 	bool is_virtual);
 
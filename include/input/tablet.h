@@ -22,6 +22,25 @@ struct drawing_tablet {
 	double rotation;
 	double slider;
 	double wheel_delta;
+
+	/* Axis events merged by <tabletTool coalesceMotion="yes"> */
+	struct {
+		bool active;
+		uint32_t updated_axes;
+		uint32_t time_msec;
+		struct wlr_tablet_tool *tool;
+		struct wl_event_source *idle;
+	} pending;
+
+	/* Cursor image displacement by <tabletTool motionPrediction=""> */
+	struct {
+		bool valid;
+		bool applied;
+		double lx, ly; /* actual cursor position */
+		double vx, vy; /* smoothed velocity in px/ms */
+		uint32_t time_msec;
+	} prediction;
+
 	struct {
 		struct wl_listener destroy;
 	} handlers;
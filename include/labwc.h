@@ -42,13 +42,21 @@
 #include <wlr/types/wlr_input_method_v2.h>
 #include <wlr/types/wlr_tablet_v2.h>
 #include <wlr/util/log.h>
+#include "animation.h"
+#include "common/change-journal.h"
 #include "common/set.h"
 #include "config/keybind.h"
 #include "config/rcxml.h"
+#include "deferred.h"
 #include "input/cursor.h"
+#include "input/key-state.h"
+#include "metrics.h"
 #include "overlay.h"
 #include "regions.h"
+#include "scanout.h"
 #include "session-lock.h"
+#include "timer-wheel.h"
+#include "transaction.h"
 #if HAVE_NLS
 #include <libintl.h>
 #include <locale.h>
@@ -66,6 +74,7 @@ enum input_mode {
 	LAB_INPUT_STATE_RESIZE,
 	LAB_INPUT_STATE_MENU,
 	LAB_INPUT_STATE_WINDOW_SWITCHER,
+	LAB_INPUT_STATE_OVERVIEW,
 };
 
 struct input {
@@ -73,6 +82,25 @@ struct input {
 	struct seat *seat;
 	/* Set for pointer/touch devices */
 	double scroll_factor;
+	/*
+	 * Cached [0, 1] => layout mapping of touch and tablet devices, see
+	 * input_absolute_to_layout_coords()
+	 */
+	struct {
+		bool valid;
+		double x, y, width, height;
+	} mapping;
+	/*
+	 * libinput settings of pointer/touch devices. The profile is a copy
+	 * of the matching category, applied from an idle callback while
+	 * pending and compared against the category on reconfigure.
+	 */
+	struct {
+		enum lab_libinput_device_type type;
+		bool configured;
+		bool pending;
+		struct libinput_category profile;
+	} libinput;
 	struct wl_listener destroy;
 	struct wl_list link; /* seat.inputs */
 };
@@ -92,15 +120,32 @@ struct keyboard {
 	/* key repeat for compositor keybinds */
 	uint32_t keybind_repeat_keycode;
 	int32_t keybind_repeat_rate;
-	struct wl_event_source *keybind_repeat;
+	struct lab_timer keybind_repeat;
 };
 
 struct seat {
 	struct wlr_seat *seat;
 	struct server *server;
 	struct wlr_keyboard_group *keyboard_group;
+	/*
+	 * Bumped when the keymap changes, invalidating the layouts stored
+	 * in views with <keyboard><layoutScope>window
+	 */
+	uint32_t keyboard_layout_generation;
+
+	/* Keys pressed and bound on the keyboards of this seat */
+	struct key_state key_state;
+	/* Keybind of the last key press, for on-release keybinds */
+	struct keybind *cur_keybind;
+	/* Cycling ends once the keys bound while it was active are released */
+	bool cancel_cycling_on_key_release;
 
-	struct wl_list touch_points; /* struct touch_point.link */
+	/* Shared by keybind repeat, the snap overlay and configure timeouts */
+	struct timer_wheel timers;
+
+	/* Dense array of active touch points, see touch.c */
+	struct touch_point *touch_points;
+	int nr_touch_points;
 
 	/*
 	 * Enum of most recent server-side cursor image.  Set by
@@ -114,8 +159,44 @@ struct seat {
 	struct {
 		double x, y;
 	} smooth_scroll_offset;
+	/* Partial wheel detents of high-resolution wheels, in 120ths */
+	struct {
+		double x, y;
+	} discrete_scroll_offset;
+
+	/*
+	 * Axis events merged until the next pointer frame, indexed by
+	 * enum wl_pointer_axis. The client_* values are scaled by the
+	 * scroll factor of the device.
+	 */
+	struct pending_axis {
+		bool pending;
+		bool stop;
+		double delta, delta_discrete;
+		double client_delta, client_discrete;
+		enum wl_pointer_axis_source source;
+		enum wl_pointer_axis_relative_direction relative_direction;
+		uint32_t time_msec;
+	} pending_axis[2];
 	bool cursor_scroll_wheel_emulation;
 
+	/* Pointer motion deferred by <mouse><coalesceMotion> */
+	struct {
+		bool pending;
+		uint32_t time_msec;
+	} coalesced_motion;
+
+	/*
+	 * Node and SSD part under the cursor after the last motion event
+	 * which went through the full hover update, and the cursor image
+	 * it resulted in
+	 */
+	struct {
+		struct wlr_scene_node *node;
+		enum ssd_part_type type;
+		enum lab_cursors cursor;
+	} hover;
+
 	/*
 	 * The surface whose keyboard focus is temporarily cleared with
 	 * seat_focus_override_begin() and restored with
@@ -127,12 +208,27 @@ struct seat {
 	} focus_override;
 
 	struct wlr_pointer_constraint_v1 *current_constraint;
+	/*
+	 * Extents of the region of current_constraint, computed on first
+	 * use after the constraint changed or its surface was committed
+	 */
+	struct {
+		bool valid;
+		bool single_rect;
+		struct wlr_box box;
+	} constraint_bounds;
 
 	/* In support for ToggleKeybinds */
 	uint32_t nr_inhibited_keybind_views;
 
 	/* Used to hide the workspace OSD after switching workspaces */
 	struct wl_event_source *workspace_osd_timer;
+
+	/* Sends the modifiers of a burst of changes to unfocused clients */
+	struct wl_event_source *modifier_broadcast_idle;
+
+	/* Applies queued libinput device configurations */
+	struct wl_event_source *libinput_idle;
 	bool workspace_osd_shown_by_modifier;
 
 	/* if set, views cannot receive focus */
@@ -195,6 +291,22 @@ struct seat {
 	struct wl_listener hold_begin;
 	struct wl_listener hold_end;
 
+	/* Workspace switch by a touchpad swipe, see gestures.c */
+	struct {
+		/* Fingers are down */
+		bool active;
+		/* Fingers are down or the workspaces are sliding into place */
+		bool animating;
+		struct workspace *origin;
+		struct workspace *neighbor;
+		/* Width of the output under the cursor when it began */
+		int distance;
+		/* Offset of the origin given by the fingers, and as shown */
+		double target;
+		double shown;
+		int64_t last_frame_msec;
+	} workspace_swipe;
+
 	struct wl_listener request_set_cursor;
 	struct wl_listener request_set_shape;
 	struct wl_listener request_set_selection;
@@ -224,9 +336,20 @@ struct seat {
 	struct wl_listener virtual_keyboard_new;
 };
 
+struct hud_output;
 struct lab_data_buffer;
 struct workspace;
 
+/* Kinds of changes recorded in server->scene_journal */
+enum scene_change {
+	LAB_SCENE_CHANGE_VIEW_MOVED = 1 << 0,
+	LAB_SCENE_CHANGE_VIEW_RESIZED = 1 << 1,
+	LAB_SCENE_CHANGE_VIEW_MAPPED = 1 << 2,
+	LAB_SCENE_CHANGE_VIEW_UNMAPPED = 1 << 3,
+	LAB_SCENE_CHANGE_LAYERS = 1 << 4,
+	LAB_SCENE_CHANGE_OUTPUTS = 1 << 5,
+};
+
 enum lab_cycle_dir {
 	LAB_CYCLE_DIR_NONE,
 	LAB_CYCLE_DIR_FORWARD,
@@ -255,6 +378,13 @@ struct server {
 	struct wl_listener xdg_toplevel_decoration;
 #if HAVE_XWAYLAND
 	struct wlr_xwayland *xwayland;
+	/* Mapped struct xwayland_view with _NET_WM_STRUT_PARTIAL */
+	struct wl_list xwayland_strut_views;
+	/* Last _NET_WORKAREA sent to the XWM */
+	struct wlr_box xwayland_workarea;
+	/* Lazy xwayland server created by us for <xwaylandWarmStart> */
+	struct wlr_xwayland_server *xwayland_warm_server;
+	bool xwayland_warm_pending;
 	struct wl_listener xwayland_server_ready;
 	struct wl_listener xwayland_xwm_ready;
 	struct wl_listener xwayland_new_surface;
@@ -266,6 +396,13 @@ struct server {
 
 	struct wl_list views;
 	struct wl_list unmanaged_surfaces;
+	/* Subset of unmanaged_surfaces which take focus, in map order */
+	struct wl_list unmanaged_focus_surfaces;
+
+	/* Always-on-top and omnipresent views, see struct view.stack_link */
+	struct wl_list views_always_on_top;
+	struct wl_list views_omnipresent;
+	int64_t view_stack_top, view_stack_bottom;
 
 	struct seat seat;
 	struct wlr_scene *scene;
@@ -300,6 +437,12 @@ struct server {
 	/* Tree for all non-layer xdg/xwayland-shell surfaces */
 	struct wlr_scene_tree *view_tree;
 
+	/*
+	 * Child of view_tree above all workspace trees, holding the views
+	 * visible on all workspaces
+	 */
+	struct wlr_scene_tree *view_tree_omnipresent;
+
 	/*
 	 * Popups need to be rendered above always-on-top views, so we reparent
 	 * them to this dedicated tree
@@ -325,6 +468,21 @@ struct server {
 		struct lab_cosmic_workspace_group *cosmic_group;
 		struct lab_ext_workspace_manager *ext_manager;
 		struct lab_ext_workspace_group *ext_group;
+		/* Work deferred by workspaces_switch_to() */
+		struct {
+			struct wl_event_source *idle;
+			/* Workspace last reported active to the protocols */
+			struct workspace *reported;
+			bool update_focus;
+		} settle;
+		/* Slide between two workspaces, see workspaces_switch_to() */
+		struct {
+			struct lab_animation animation;
+			struct workspace *from;
+			struct workspace *to;
+			/* Offset @from ends at, the negated one @to starts at */
+			int distance;
+		} slide;
 		struct {
 			struct wl_listener layout_output_added;
 		} on;
@@ -332,8 +490,44 @@ struct server {
 
 	struct wl_list outputs;
 	struct wl_listener new_output;
+
+	/* struct lab_animation.link, stepped by output frames */
+	struct wl_list animations;
+
+	/* Follow-up work run before the next frame, see deferred.h */
+	struct deferred_queue deferred;
+
+	/* Outputs waiting for a deferred repaint, see <core><repaintQueue> */
+	struct wl_list repaint_queue;  /* struct output.repaint.link */
+	struct wl_event_source *repaint_idle;
 	struct wlr_output_layout *output_layout;
 
+	/*
+	 * Layout boxes of outputs which went away since views were last
+	 * arranged, see output_update_all_usable_areas()
+	 */
+	struct wl_array removed_output_boxes;  /* struct wlr_box */
+
+	/*
+	 * Bumped on hotplug and whenever an output commits a change that
+	 * may affect whether other configurations pass a test, like mode
+	 * or enabled state. Cached output test results of older
+	 * generations are stale.
+	 */
+	uint32_t output_test_generation;
+	/* Bumped on every change of the output layout */
+	uint32_t output_layout_generation;
+	/*
+	 * Hash of the names, boxes, scales and transforms of the outputs
+	 * the views are arranged for, the key of view->layout_history
+	 */
+	uint64_t output_layout_signature;
+	/*
+	 * Changes of views, layers and outputs (enum scene_change), for
+	 * caches to compare against the generation they were built for
+	 */
+	struct lab_change_journal scene_journal;
+
 	struct wl_listener output_layout_change;
 	struct wlr_output_manager_v1 *output_manager;
 	struct wl_listener output_manager_test;
@@ -346,9 +540,14 @@ struct server {
 	 * do_output_layout_change() must be called explicitly.
 	 */
 	int pending_output_layout_change;
+	/* Debounces layout changes not made by the compositor */
+	struct wl_event_source *output_layout_change_timer;
 
 	struct wl_listener renderer_lost;
 
+	/* Periodic frame timing summary */
+	struct wl_event_source *frame_timing_timer;
+
 	struct wlr_gamma_control_manager_v1 *gamma_control_manager_v1;
 	struct wl_listener gamma_control_set_gamma;
 
@@ -379,6 +578,14 @@ struct server {
 	/* Set when in cycle (alt-tab) mode */
 	struct osd_state {
 		struct view *cycle_view;
+		/*
+		 * struct view *, the views to cycle through in stacking
+		 * order, taken at osd_begin(). Destroyed views are set
+		 * to NULL.
+		 */
+		struct wl_array views;
+		size_t cycle_index;
+		size_t nr_views;
 		bool preview_was_enabled;
 		struct wlr_scene_node *preview_node;
 		struct wlr_scene_tree *preview_parent;
@@ -417,15 +624,146 @@ struct output {
 
 	/* In output-relative scene coordinates */
 	struct wlr_box usable_area;
+	/* Layer surfaces need re-arranging before the next frame */
+	bool usable_area_dirty;
+
+	/*
+	 * Position of the output in the layout, as looked up by
+	 * output_usable_area_in_layout_coords(). Invalidated on every
+	 * change of the output layout.
+	 */
+	struct {
+		bool valid;
+		int x, y;
+	} layout_origin;
+
+	/*
+	 * Snap boxes and adjacent outputs per enum view_edge, as looked up
+	 * by output_get_edge_box() and output_get_adjacent() on every
+	 * cursor motion while dragging a view. Invalidated together with
+	 * layout_origin and on changes of the usable area.
+	 */
+	struct {
+		bool valid;
+		int gap;  /* rc.gap of the tiled boxes */
+		struct wlr_box full[VIEW_EDGE_CENTER + 1];
+		struct wlr_box tiled[VIEW_EDGE_CENTER + 1];
+		/* Indexed by @wrap of output_get_adjacent() */
+		struct output *adjacent[VIEW_EDGE_CENTER + 1][2];
+	} edge_cache;
+
+	/*
+	 * Layout box and usable area (in layout coordinates) at the time
+	 * views were last arranged. Empty while the output is not usable.
+	 */
+	struct wlr_box arranged_box;
+	struct wlr_box arranged_usable_area;
 
 	struct wl_list regions;  /* struct region.link */
 
+	/* Results of tests requested by output management clients */
+	struct {
+		uint32_t generation;
+		size_t next;
+		struct output_test_result {
+			bool valid;
+			bool passed;
+			struct wlr_output_mode *mode;
+			int32_t width, height, refresh;  /* custom mode */
+			float scale;
+			enum wl_output_transform transform;
+			bool adaptive_sync;
+		} results[4];
+	} test_cache;
+
 	struct wl_listener destroy;
+	struct wl_listener commit;
 	struct wl_listener frame;
+	struct wl_listener present;
 	struct wl_listener request_state;
 
+	/* Delayed repaint, see <core><maxRenderTime> */
+	struct {
+		struct wl_event_source *timer;
+		struct wl_list link;  /* server.repaint_queue */
+		bool scheduled;
+		int64_t last_present_nsec;
+		int refresh_nsec;  /* 0 if unknown */
+		/* Start of the repaint awaiting presentation, 0 if none */
+		int64_t commit_start_nsec;
+		/* Render cost of the recent frames in nanoseconds */
+		uint32_t cost_nsec[16];
+		size_t cost_head;
+		/* Repeats the last frame, see <core><adaptiveSyncMinRefresh> */
+		struct wl_event_source *min_refresh_timer;
+		/* The next frame only repeats the last one */
+		bool repeat;
+	} repaint;
+
+	/* Idle output policy, see <idleOutput> */
+	struct {
+		struct wl_event_source *timer;
+		int64_t last_active_nsec;
+		bool active;
+		bool restore_adaptive_sync;
+	} idle;
+
+	/* Fullscreen views with view->output set to this output */
+	int nr_fullscreen_views;
+
+	/* Last frame event sent to views occluded by a fullscreen view */
+	int64_t occluded_frame_done_nsec;
+
+	/*
+	 * Opaque fullscreen view covering the output. The views entirely
+	 * on the output and the bottom and background layers below it are
+	 * disabled meanwhile, so the scene does not traverse them.
+	 */
+	struct view *culled_by;
+
+	/* Only allocated when <core><frameTiming> is enabled */
+	struct output_timing *timing;
+
+	/* On-screen statistics, NULL unless shown by hud_toggle() */
+	struct hud_output *hud;
+
+	/* Allocated once a <core><captureSocket> consumer connected */
+	struct capture_output *capture;
+
+	/* Overlap grid kept up to date by placement_find_best() */
+	struct placement_grid *placement_grid;
+
+	/* Lookup grid over regions, rebuilt by regions_update_geometry() */
+	struct region_grid *region_grid;
+
+	struct scanout_stats scanout;
+	struct output_metrics metrics;
+
+	/* Tearing page-flips, suspended after repeated fallbacks */
+	struct {
+		int failures; /* consecutive fallbacks */
+		int64_t backoff_nsec;
+		int64_t suspended_until_nsec;
+		/* Only tear this frame if it is directly scanned out */
+		bool needs_scanout;
+	} tearing;
+
+	/* Geometry changes of multiple views shown in one frame */
+	struct transaction transaction;
+
+	/* Area covered by the magnifier in the last frame, physical coords */
+	struct wlr_box magnifier_box;
+	bool magnifier_dirty;
+
 	bool leased;
+	/* Turned off by wlr-output-power-management */
+	bool power_off;
 	bool gamma_lut_changed;
+	/*
+	 * Gamma LUT applied by the renderer for outputs without hardware
+	 * gamma support, NULL if unused
+	 */
+	struct wlr_color_transform *gamma_transform;
 };
 
 #undef LAB_NR_LAYERS
@@ -474,15 +812,37 @@ void desktop_focus_view_or_surface(struct seat *seat, struct view *view,
 	struct wlr_surface *surface, bool raise);
 
 void desktop_arrange_all_views(struct server *server);
+
+/**
+ * desktop_arrange_views_in_boxes() - like desktop_arrange_all_views() but
+ * only adjust views which overlap one of @boxes (before or after the last
+ * layout change) or whose output is no longer usable
+ * @server: server
+ * @boxes: array of struct wlr_box in layout coordinates
+ */
+void desktop_arrange_views_in_boxes(struct server *server,
+	struct wl_array *boxes);
 void desktop_focus_output(struct output *output);
 struct view *desktop_topmost_focusable_view(struct server *server);
 
 /**
  * Toggles the (output local) visibility of the layershell top layer
  * based on the existence of a fullscreen window on the current workspace.
+ * Deferred until the end of the event loop iteration, see deferred.h.
  */
 void desktop_update_top_layer_visibility(struct server *server);
 
+/**
+ * desktop_update_top_layer_outputs() - like
+ * desktop_update_top_layer_visibility(), but right away and only for
+ * some outputs
+ * @outputs: bitset of output->scene_output->index
+ *
+ * Only outputs with fullscreen views assigned to them need to look at
+ * the views, see output->nr_fullscreen_views.
+ */
+void desktop_update_top_layer_outputs(struct server *server, uint64_t outputs);
+
 /**
  * desktop_focus_topmost_view() - focus the topmost view on the current
  * workspace, skipping views that claim not to want focus (those can
@@ -511,6 +871,18 @@ void seat_set_pressed(struct seat *seat, struct cursor_context *ctx);
 void seat_reset_pressed(struct seat *seat);
 void seat_output_layout_changed(struct seat *seat);
 
+/**
+ * input_absolute_to_layout_coords() - like
+ * wlr_cursor_absolute_to_layout_coords() for touch and tablet devices
+ *
+ * The output or region the device is mapped to is looked up on the first
+ * call after the mapping or the output layout changed, rather than on
+ * every event.
+ */
+void input_absolute_to_layout_coords(struct seat *seat,
+	struct wlr_input_device *dev, double x, double y,
+	double *lx, double *ly);
+
 /*
  * Temporarily clear the pointer/keyboard focus from the client at the
  * beginning of interactive move/resize, window switcher or menu interactions.
@@ -545,10 +917,37 @@ enum view_edge edge_from_cursor(struct seat *seat, struct output **dest_output);
 void output_init(struct server *server);
 void output_finish(struct server *server);
 void output_manager_init(struct server *server);
+/*
+ * Batch changes of several outputs: layout changes in between are ignored
+ * and the final layout is handled once by output_layout_change_end().
+ * Calls may be nested.
+ */
+void output_layout_change_begin(struct server *server);
+void output_layout_change_end(struct server *server);
 struct output *output_from_wlr_output(struct server *server,
 	struct wlr_output *wlr_output);
+/* Usable output named @name, compared case-insensitively */
 struct output *output_from_name(struct server *server, const char *name);
+/* Like output_from_name(), but the output may not be usable */
+struct output *output_find_by_name(struct server *server, const char *name);
 struct output *output_nearest_to(struct server *server, int lx, int ly);
+
+/*
+ * Output masks are indexed by the scene output index, which wlroots keeps
+ * below 64. Outputs beyond that are not added to the layout.
+ */
+#define LAB_OUTPUT_MASK_BITS 64
+
+/**
+ * output_mask_from_box() - get the usable outputs intersecting @box
+ * @box: box in layout coordinates
+ *
+ * Return: bitset of output->scene_output->index, as in view->outputs
+ */
+uint64_t output_mask_from_box(struct server *server, struct wlr_box *box);
+
+/* Bit of @output in view->outputs, 0 for NULL or outputs without a scene */
+uint64_t output_get_mask(struct output *output);
 struct output *output_nearest_to_cursor(struct server *server);
 
 /**
@@ -565,15 +964,61 @@ struct output *output_nearest_to_cursor(struct server *server);
 struct output *output_get_adjacent(struct output *output,
 	enum view_edge edge, bool wrap);
 
+/**
+ * output_get_edge_box() - get the area of @output covered by a view
+ * snapped to @edge, in layout coordinates
+ *
+ * @output: output
+ * @edge: edge, VIEW_EDGE_CENTER for the whole usable area
+ * @with_gaps: leave <core><gap> free around the box, as for the geometry
+ *             of a tiled view. Without, the box is the one shown by the
+ *             snapping overlay.
+ */
+struct wlr_box output_get_edge_box(struct output *output,
+	enum view_edge edge, bool with_gaps);
+
 bool output_is_usable(struct output *output);
 void output_update_usable_area(struct output *output);
+
+/**
+ * output_schedule_usable_area_update() - re-arrange the layer surfaces and
+ * update the usable area of @output before its next frame
+ * @output: output
+ *
+ * Several layer-shell commits within one frame result in a single update.
+ */
+void output_schedule_usable_area_update(struct output *output);
 void output_update_all_usable_areas(struct server *server, bool layout_changed);
+
+/*
+ * Like output_update_all_usable_areas() without a layout change, once at
+ * the end of the event loop iteration, see deferred.h
+ */
+void output_schedule_all_usable_areas_update(struct server *server);
 bool output_get_tearing_allowance(struct output *output);
+
+/**
+ * output_update_culling() - disable what an opaque fullscreen view hides
+ * @output: output
+ * @force: recompute the disabled views even if the covering view is the
+ *	   same, after the stacking, the workspace or the views changed
+ *
+ * Called before each repaint without @force, which only has an effect
+ * when the covering view changed, e.g. when its opaque region did.
+ */
+void output_update_culling(struct output *output, bool force);
 struct wlr_box output_usable_area_in_layout_coords(struct output *output);
 void handle_output_power_manager_set_mode(struct wl_listener *listener,
 	void *data);
 void output_enable_adaptive_sync(struct output *output, bool enabled);
 
+/**
+ * output_idle_reconfigure() - wake up all idle outputs and re-arm their idle
+ * timers after <idleOutput> settings have changed
+ * @server: server
+ */
+void output_idle_reconfigure(struct server *server);
+
 /**
  * output_max_scale() - get maximum scale factor of all usable outputs.
  * Used when loading/rendering resources (e.g. icons) that may be
@@ -583,10 +1028,37 @@ float output_max_scale(struct server *server);
 
 void new_tearing_hint(struct wl_listener *listener, void *data);
 
+/**
+ * tearing_commit_result() - account a page-flip committed or attempted
+ * with tearing
+ * @output: output
+ * @torn: whether the page-flip was committed with tearing, false if it
+ *	  had to fall back to a synchronized one
+ *
+ * Tearing is suspended for an exponentially growing period while the
+ * fallbacks keep coming, see tearing_is_suspended().
+ */
+void tearing_commit_result(struct output *output, bool torn);
+bool tearing_is_suspended(struct output *output);
+
 void server_init(struct server *server);
 void server_start(struct server *server);
 void server_finish(struct server *server);
 
+enum lab_reload {
+	LAB_RELOAD_ENVIRONMENT = 1 << 0,
+	LAB_RELOAD_THEME = 1 << 1,
+	/* rc.xml, the theme is reloaded too if it is affected */
+	LAB_RELOAD_CONFIG = 1 << 2,
+	LAB_RELOAD_ALL = LAB_RELOAD_ENVIRONMENT | LAB_RELOAD_CONFIG,
+};
+
+/**
+ * server_reload() - reload configuration files, as on SIGHUP
+ * @what: bitmask of enum lab_reload, LAB_RELOAD_ALL for SIGHUP
+ */
+void server_reload(struct server *server, uint32_t what);
+
 void create_constraint(struct wl_listener *listener, void *data);
 void constrain_cursor(struct server *server, struct wlr_pointer_constraint_v1
 	*constraint);
@@ -3,6 +3,7 @@
 #define LABWC_LAYERS_H
 #include <wayland-server.h>
 #include <wlr/types/wlr_layer_shell_v1.h>
+#include <wlr/util/box.h>
 
 struct server;
 struct output;
@@ -14,6 +15,18 @@ struct lab_layer_surface {
 
 	bool mapped;
 
+	/*
+	 * Input and result of the last configure by layers_arrange(), so
+	 * that surfaces with unchanged layout state are not re-configured
+	 */
+	struct {
+		bool valid;
+		struct wlr_layer_surface_v1_state state;
+		struct wlr_box full_area;
+		struct wlr_box usable_area_before;
+		struct wlr_box usable_area_after;
+	} arranged;
+
 	struct wl_listener map;
 	struct wl_listener unmap;
 	struct wl_listener surface_commit;
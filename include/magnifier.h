@@ -16,6 +16,19 @@ enum magnify_dir {
 
 void magnifier_toggle(struct server *server);
 void magnifier_set_scale(struct server *server, enum magnify_dir dir);
+
+/**
+ * magnifier_handle_cursor_motion() - schedule a magnifier redraw on the
+ * output(s) affected by the cursor having moved
+ * @server: server
+ */
+void magnifier_handle_cursor_motion(struct server *server);
+
+/**
+ * output_wants_magnification() - check whether the magnifier needs to be
+ * redrawn on @output even if no scene damage is pending; consumes the flag
+ * @output: output
+ */
 bool output_wants_magnification(struct output *output);
 void magnifier_draw(struct output *output, struct wlr_buffer *output_buffer,
 	struct wlr_box *damage);
@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_METRICS_H
+#define LABWC_METRICS_H
+
+#include <stdint.h>
+
+struct server;
+
+/* Counters kept for each output */
+struct output_metrics {
+	uint64_t frames_rendered;
+	/* Frame events without damage, nothing was rendered or committed */
+	uint64_t frames_skipped;
+	uint64_t commit_failures;
+	/* Tearing page-flips which were retried without tearing */
+	uint64_t tearing_fallbacks;
+	/* Page-flips committed with tearing */
+	uint64_t tearing_commits;
+
+	/* Frame pacing, from the presentation feedback of the backend */
+	uint64_t frames_presented;
+	/*
+	 * Vblanks passed without a new frame although the frame had been
+	 * committed in time for them
+	 */
+	uint64_t missed_vblanks;
+	/* Distance of presentation times from the ideal vblank grid */
+	uint64_t judder_ns_sum;
+	uint64_t judder_samples;
+	/* From the start of the repaint until the frame was presented */
+	uint64_t latency_ns_sum;
+	uint64_t latency_samples;
+
+	/* Frames with a cursor shown, by cursor plane or composited */
+	uint64_t cursor_hardware_frames;
+	uint64_t cursor_software_frames;
+	/* Switches from the hardware to the software cursor */
+	uint64_t cursor_fallbacks;
+};
+
+enum metrics_input {
+	LAB_METRICS_INPUT_MOTION = 0,
+	LAB_METRICS_INPUT_BUTTON,
+	LAB_METRICS_INPUT_AXIS,
+	LAB_METRICS_INPUT_KEY,
+
+	LAB_METRICS_INPUT_COUNT
+};
+
+/**
+ * metrics_init() - listen on <core><metricsSocket>
+ * @server: server
+ *
+ * Every connection to the socket is answered with all metrics in the
+ * Prometheus text exposition format. Requests starting with "GET" get an
+ * HTTP/1.0 response, anything else the plain text.
+ */
+void metrics_init(struct server *server);
+void metrics_reconfigure(struct server *server);
+void metrics_finish(struct server *server);
+
+void metrics_input_event(enum metrics_input type);
+
+/**
+ * metrics_action_executed() - account the execution time of an action
+ * @name: name of the action, must stay valid until metrics_finish()
+ * @ns: execution time in nanoseconds
+ */
+void metrics_action_executed(const char *name, uint64_t ns);
+
+#endif /* LABWC_METRICS_H */
@@ -8,6 +8,7 @@ struct lab_layer_surface;
 struct lab_layer_popup;
 struct menuitem;
 struct ssd_button;
+struct ssd_part;
 struct scaled_scene_buffer;
 
 enum node_descriptor_type {
@@ -22,6 +23,7 @@ enum node_descriptor_type {
 	LAB_NODE_DESC_TREE,
 	LAB_NODE_DESC_SCALED_SCENE_BUFFER,
 	LAB_NODE_DESC_SSD_BUTTON,
+	LAB_NODE_DESC_SSD_PART,
 };
 
 struct node_descriptor {
@@ -45,6 +47,7 @@ struct node_descriptor {
  *   - LAB_NODE_DESC_LAYER_POPUP    struct lab_layer_popup
  *   - LAB_NODE_DESC_MENUITEM       struct menuitem
  *   - LAB_NODE_DESC_SSD_BUTTON     struct ssd_button
+ *   - LAB_NODE_DESC_SSD_PART       struct ssd_part
  */
 void node_descriptor_create(struct wlr_scene_node *scene_node,
 	enum node_descriptor_type type, void *data);
@@ -3,6 +3,7 @@
 #define LABWC_OSD_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <wayland-server-core.h>
 
 /* TODO: add field with keyboard layout? */
@@ -31,9 +32,17 @@ struct window_switcher_field {
 	enum window_switcher_field_content content;
 	int width;
 	char *format;
+	/* struct osd_field_token, @format split up when it is parsed */
+	struct wl_array tokens;
 	struct wl_list link; /* struct rcxml.window_switcher.fields */
 };
 
+/* Rendered field texts of a view, see osd_field_get_content() */
+struct osd_field_cache {
+	uint64_t generation; /* 0 if not filled yet */
+	struct wl_array entries; /* struct osd_field_cache_entry */
+};
+
 struct buf;
 struct view;
 struct server;
@@ -51,10 +60,26 @@ void osd_finish(struct server *server);
 /* Notify OSD about a destroying view */
 void osd_on_view_destroy(struct view *view);
 
-/* Used by osd.c internally to render window switcher fields */
+/**
+ * osd_field_get_content() - append the text of @field for @view to @buf
+ *
+ * Used by osd.c internally to render window switcher fields. The text is
+ * generated once and cached per view until osd_field_invalidate() is
+ * called.
+ */
 void osd_field_get_content(struct window_switcher_field *field,
 	struct buf *buf, struct view *view);
 
+/**
+ * osd_field_invalidate() - drop the cached field texts
+ * @view: view whose title, app_id, output, workspace or state changed, or
+ *	  NULL after the config or the outputs have changed
+ *
+ * Also frees the memory of the cache of @view, so it is called when the
+ * view is destroyed.
+ */
+void osd_field_invalidate(struct view *view);
+
 /* Used by rcxml.c when parsing the config */
 struct window_switcher_field *osd_field_create(void);
 void osd_field_arg_from_xml_node(struct window_switcher_field *field,
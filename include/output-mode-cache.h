@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_OUTPUT_MODE_CACHE_H
+#define LABWC_OUTPUT_MODE_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct wlr_output;
+
+/*
+ * Last mode known to work on a monitor, identified by make, model and
+ * serial number. The cache is kept in $XDG_STATE_HOME/labwc/output-modes
+ * so that it survives restarts.
+ */
+struct output_mode_record {
+	int32_t width, height, refresh;
+};
+
+/**
+ * output_mode_cache_lookup() - get the last known good mode of a monitor
+ * @wlr_output: output
+ * @record: filled in on success
+ *
+ * Returns false if the monitor is unknown or not a physical display.
+ */
+bool output_mode_cache_lookup(struct wlr_output *wlr_output,
+	struct output_mode_record *record);
+
+/**
+ * output_mode_cache_store() - remember the current mode of an output
+ * @wlr_output: output which has just successfully committed a mode
+ */
+void output_mode_cache_store(struct wlr_output *wlr_output);
+
+void output_mode_cache_finish(void);
+
+#endif /* LABWC_OUTPUT_MODE_CACHE_H */
@@ -0,0 +1,150 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_OUTPUT_TIMING_H
+#define LABWC_OUTPUT_TIMING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <wayland-util.h>
+
+struct output;
+struct server;
+struct wlr_input_device;
+
+/*
+ * Phases of a single output frame. Durations are accumulated per phase, so
+ * a phase which runs more than once within a frame (for example a second
+ * commit after a failed tearing page-flip) is reported as the sum.
+ */
+enum frame_phase {
+	/* From the wlr_output frame event until build_state is started */
+	LAB_FRAME_PHASE_WAIT = 0,
+	/* wlr_scene_output_build_state() */
+	LAB_FRAME_PHASE_BUILD,
+	/* Same as BUILD, but with the software gamma LUT applied */
+	LAB_FRAME_PHASE_BUILD_GAMMA,
+	/* magnifier_draw() */
+	LAB_FRAME_PHASE_MAGNIFIER,
+	/* wlr_output_commit_state() */
+	LAB_FRAME_PHASE_COMMIT,
+	/* Tearing test and the non-tearing commit retry */
+	LAB_FRAME_PHASE_TEARING,
+
+	LAB_FRAME_PHASE_COUNT
+};
+
+#define LAB_FRAME_TIMING_SAMPLES 1024
+
+struct frame_timing_sample {
+	/* Duration of each phase in nanoseconds */
+	uint32_t ns[LAB_FRAME_PHASE_COUNT];
+};
+
+/* 1ms buckets, the last one also collects all longer latencies */
+#define LAB_INPUT_LATENCY_BUCKETS 128
+
+/* Input-to-commit latency of one input device on one output */
+struct input_latency {
+	char *device;
+	/* Timestamp of the oldest event not yet followed by a commit */
+	uint32_t pending_msec;
+	bool pending;
+
+	uint32_t histogram[LAB_INPUT_LATENCY_BUCKETS];
+	uint32_t count;
+	uint64_t total_msec;
+};
+
+struct output_timing {
+	struct frame_timing_sample samples[LAB_FRAME_TIMING_SAMPLES];
+	size_t head;   /* next sample to be written */
+	size_t count;  /* number of valid samples */
+
+	/* Frame currently being recorded */
+	struct frame_timing_sample current;
+	struct timespec frame_start;
+	struct timespec phase_start;
+	bool recording;
+	bool rendered;
+
+	/* Frames which took longer than the refresh period */
+	uint32_t missed;
+	uint32_t total;
+
+	/* struct input_latency, one per input device */
+	struct wl_array input_latency;
+};
+
+/**
+ * output_timing_init() - set up the periodic frame timing summary
+ * @server: server
+ *
+ * Samples are only recorded when <core><frameTiming> is enabled.
+ */
+void output_timing_init(struct server *server);
+void output_timing_finish(struct server *server);
+
+/**
+ * output_timing_reconfigure() - re-arm the summary timer and drop timing
+ * state after the timing options have changed.
+ */
+void output_timing_reconfigure(struct server *server);
+
+void output_timing_destroy(struct output *output);
+
+/**
+ * output_timing_frame_begin() - start recording a frame
+ * @output: output which received the frame event
+ */
+void output_timing_frame_begin(struct output *output);
+
+/**
+ * output_timing_phase_begin() - mark the start of a phase
+ * @output: output
+ */
+void output_timing_phase_begin(struct output *output);
+
+/**
+ * output_timing_phase_end() - account the time since the last
+ * output_timing_frame_begin() or output_timing_phase_begin() to @phase
+ * @output: output
+ * @phase: phase to account the elapsed time to
+ */
+void output_timing_phase_end(struct output *output, enum frame_phase phase);
+
+/**
+ * output_timing_frame_end() - finish recording a frame
+ * @output: output
+ *
+ * Frames which did not render anything are discarded.
+ */
+void output_timing_frame_end(struct output *output);
+
+/**
+ * output_timing_input_event() - tag the next commit of @output with an
+ * input event
+ * @output: output affected by the event, may be NULL
+ * @device: device which emitted the event
+ * @time_msec: timestamp of the event as reported by the backend
+ *
+ * Only the oldest event of each device is kept until the next commit.
+ */
+void output_timing_input_event(struct output *output,
+	struct wlr_input_device *device, uint32_t time_msec);
+
+/**
+ * output_timing_committed() - account the latency of all input events
+ * tagged to @output since its last commit
+ * @output: output which has successfully committed a new frame
+ */
+void output_timing_committed(struct output *output);
+
+/**
+ * output_timing_log_summary() - log p50/p99/p999 of each frame phase and
+ * of the input-to-commit latency of each input device for all outputs,
+ * followed by the run time of the functions recorded by probe_end()
+ * @server: server
+ */
+void output_timing_log_summary(struct server *server);
+
+#endif /* LABWC_OUTPUT_TIMING_H */
@@ -5,9 +5,37 @@
 struct server;
 struct wlr_output;
 
+struct virtual_output_mode {
+	int width, height;
+	int refresh;  /* mHz, 0 for the backend default of 60Hz */
+};
+
+/**
+ * output_virtual_add() - add a headless output
+ * @server: server
+ * @output_name: name of the new output, may be NULL
+ * @mode: initial mode, NULL for 1920x1080@60Hz
+ * @store_wlr_output: filled in with the new output before it is announced
+ */
 void output_virtual_add(struct server *server, const char *output_name,
+		const struct virtual_output_mode *mode,
 		struct wlr_output **store_wlr_output);
 void output_virtual_remove(struct server *server, const char *output_name);
+
+/**
+ * output_virtual_add_many() - add @count headless outputs at once
+ * @name_template: names of the outputs, the first "%d" is replaced by the
+ *                 index from 1 to @count, "-<index>" is appended without
+ *                 one; NULL for the backend's names
+ *
+ * The output layout change is handled once all outputs are added, rather
+ * than for each of them. With a @count of 1, @name_template is used as is.
+ */
+void output_virtual_add_many(struct server *server, const char *name_template,
+		int count, const struct virtual_output_mode *mode);
+/* Remove the outputs added by output_virtual_add_many() in one layout change */
+void output_virtual_remove_many(struct server *server,
+		const char *name_template, int count);
 void output_virtual_update_fallback(struct server *server);
 
 #endif
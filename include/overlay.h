@@ -5,6 +5,7 @@
 #include <wlr/util/box.h>
 #include "common/graphic-helpers.h"
 #include "regions.h"
+#include "timer-wheel.h"
 #include "view.h"
 
 struct overlay_rect {
@@ -31,7 +32,7 @@ struct overlay {
 	} active;
 
 	/* For delayed snap-to-edge overlay */
-	struct wl_event_source *timer;
+	struct lab_timer timer;
 };
 
 void overlay_reconfigure(struct seat *seat);
@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_OVERVIEW_H
+#define LABWC_OVERVIEW_H
+
+#include <stdbool.h>
+
+struct output;
+struct server;
+struct view;
+enum lab_cycle_dir;
+
+/**
+ * overview_toggle() - show all views of all workspaces side by side
+ *
+ * Each output shows thumbnails of the views on it in a grid. The
+ * thumbnails are snapshots, downscaled when they are rendered, and are
+ * refreshed at a reduced rate, so the clients themselves are not
+ * composited while the overview is shown.
+ */
+void overview_toggle(struct server *server);
+
+/* Moves the selection by one thumbnail */
+void overview_cycle(struct server *server, enum lab_cycle_dir direction);
+
+/* Closes the overview and focuses the selected view */
+void overview_activate(struct server *server);
+
+/**
+ * overview_press() - handle a button press in the overview
+ *
+ * Closes the overview and focuses the view of the thumbnail at @lx, @ly,
+ * if there is one.
+ */
+void overview_press(struct server *server, double lx, double ly);
+
+/* Closes the overview */
+void overview_finish(struct server *server);
+
+/* Notify the overview about a destroying view */
+void overview_on_view_destroy(struct view *view);
+
+#endif /* LABWC_OVERVIEW_H */
@@ -6,6 +6,11 @@
 #include <wlr/util/box.h>
 #include "view.h"
 
+struct output;
+
 bool placement_find_best(struct view *view, struct wlr_box *geometry);
 
+/* Free the placement state kept for @output */
+void placement_finish(struct output *output);
+
 #endif /* LABWC_PLACEMENT_H */
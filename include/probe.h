@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_PROBE_H
+#define LABWC_PROBE_H
+
+#include <stdbool.h>
+#include <time.h>
+
+/*
+ * Functions whose run time is recorded while <core><frameTiming> is
+ * enabled, to see how they scale with the number of views and outputs
+ */
+enum probe_site {
+	LAB_PROBE_PLACEMENT_FIND_BEST = 0,
+	LAB_PROBE_WORKSPACES_SWITCH_TO,
+	/* Focus and protocol updates deferred by workspaces_switch_to() */
+	LAB_PROBE_WORKSPACES_SETTLE,
+	LAB_PROBE_GET_CURSOR_CONTEXT,
+
+	LAB_PROBE_COUNT
+};
+
+struct probe_timer {
+	struct timespec start;
+	bool running;
+};
+
+/**
+ * probe_begin() - start timing a call
+ * @timer: timer on the stack of the caller
+ */
+void probe_begin(struct probe_timer *timer);
+
+/**
+ * probe_end() - account the time since probe_begin() to @site
+ * @timer: timer passed to probe_begin()
+ * @site: function which was timed
+ */
+void probe_end(struct probe_timer *timer, enum probe_site site);
+
+/* Log the call count, mean, max and percentiles of each site */
+void probe_log_summary(void);
+
+/* Drop all recorded calls */
+void probe_reset(void);
+
+#endif /* LABWC_PROBE_H */
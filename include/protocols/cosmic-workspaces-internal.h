@@ -14,6 +14,9 @@ enum pending_change {
 	CW_PENDING_WS_ACTIVATE   = 1 << 1,
 	CW_PENDING_WS_DEACTIVATE = 1 << 2,
 	CW_PENDING_WS_REMOVE     = 1 << 3,
+
+	/* Only the last (de)activate request per workspace is applied */
+	CW_PENDING_WS_STATE      = CW_PENDING_WS_ACTIVATE | CW_PENDING_WS_DEACTIVATE,
 };
 
 void cosmic_group_output_send_initial_state(struct lab_cosmic_workspace_group *group,
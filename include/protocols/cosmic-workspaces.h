@@ -13,6 +13,10 @@ struct lab_cosmic_workspace_manager {
 	uint32_t caps;
 	struct wl_event_source *idle_source;
 	struct wl_event_loop *event_loop;
+	/* Bumped on every change sent to clients, see done_serial */
+	uint32_t serial;
+	/* Value of serial when the last done event was sent */
+	uint32_t done_serial;
 
 	struct {
 		struct wl_listener display_destroy;
@@ -15,6 +15,9 @@ enum pending_ext_workspaces_change {
 	WS_PENDING_WS_DEACTIVATE = 1 << 2,
 	WS_PENDING_WS_REMOVE     = 1 << 3,
 	WS_PENDING_WS_ASSIGN     = 1 << 4,
+
+	/* Only the last (de)activate request per workspace is applied */
+	WS_PENDING_WS_STATE      = WS_PENDING_WS_ACTIVATE | WS_PENDING_WS_DEACTIVATE,
 };
 
 void ext_group_output_send_initial_state(struct lab_ext_workspace_group *group,
@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_PROTOCOLS_RATE_LIMIT_H
+#define LABWC_PROTOCOLS_RATE_LIMIT_H
+
+#include <stdbool.h>
+
+struct wl_client;
+
+/* Protocol requests which are expensive enough to be rate-limited */
+enum lab_rate_limit {
+	LAB_RATE_LIMIT_WORKSPACE_COMMIT = 0,
+	LAB_RATE_LIMIT_OUTPUT_TEST,
+	LAB_RATE_LIMIT_OUTPUT_APPLY,
+
+	LAB_RATE_LIMIT_COUNT
+};
+
+/**
+ * lab_rate_limit_allow() - account one request of @client
+ * @client: client which sent the request, may be NULL
+ * @limit: kind of request
+ *
+ * Each client has its own token bucket per kind of request, which is
+ * dropped when the client disconnects. Returns false if the client has
+ * exceeded its budget and the request should be rejected. The number of
+ * rejected requests is logged at debug level.
+ */
+bool lab_rate_limit_allow(struct wl_client *client, enum lab_rate_limit limit);
+
+#endif /* LABWC_PROTOCOLS_RATE_LIMIT_H */
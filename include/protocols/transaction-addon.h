@@ -14,12 +14,18 @@ struct lab_transaction_op {
 	} events;
 
 	// Private
+	struct lab_transaction_session_context *ctx;
 	struct wl_list link;
 };
 
 struct lab_transaction_session_context {
 	int ref_count;
 	struct wl_list transaction_ops;
+
+	// Private
+	/* Destroyed ops kept for re-use, freed with the context */
+	struct wl_list free_ops;
+	int nr_free_ops;
 };
 
 struct lab_wl_resource_addon {
@@ -56,6 +62,16 @@ struct lab_transaction_op *lab_transaction_op_add(
 	struct lab_transaction_session_context *ctx,
 	uint32_t pending_change, void *src, void *data);
 
+/*
+ * Like lab_transaction_op_add() but first destroys all pending operations
+ * on the same src whose change is part of the supersedes mask. This allows
+ * repeated requests like activate/deactivate on the same target to collapse
+ * into the last one before the transaction is committed.
+ */
+struct lab_transaction_op *lab_transaction_op_add_unique(
+	struct lab_transaction_session_context *ctx,
+	uint32_t pending_change, void *src, void *data, uint32_t supersedes);
+
 /*
  * Removes the transaction operation from the ctx list and frees it.
  *
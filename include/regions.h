@@ -39,9 +39,15 @@ bool regions_should_snap(struct server *server);
 void regions_reconfigure(struct server *server);
 void regions_reconfigure_output(struct output *output);
 
-/* re-calculate the geometry based on usable area */
+/*
+ * re-calculate the geometry based on usable area and rebuild the lookup
+ * grid used by regions_from_cursor()
+ */
 void regions_update_geometry(struct output *output);
 
+/* Free the lookup grid of an output which is going away */
+void regions_finish_output(struct output *output);
+
 /**
  * Mark all views which are currently region-tiled to the given output as
  * evacuated. This means that the view->tiled_region pointer is reset to
@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_RENDER_POOL_H
+#define LABWC_RENDER_POOL_H
+
+#include <stdbool.h>
+
+struct server;
+
+/*
+ * Worker threads rendering buffers off the main thread, used by
+ * scaled_scene_buffer implementations with impl->render_async()
+ */
+void render_pool_init(struct server *server);
+void render_pool_finish(void);
+
+typedef void (*render_func_t)(void *data);
+
+/**
+ * render_pool_submit() - render something on a worker thread
+ * @render: called on a worker thread, may only use libc, cairo and pango
+ *	    on objects it does not share with the main thread
+ * @done: called on the main thread once @render returned, or on
+ *	  render_pool_finish() for jobs which did not run
+ * @data: passed to both
+ *
+ * Returns false if there are no workers, nothing is called then.
+ */
+bool render_pool_submit(render_func_t render, render_func_t done, void *data);
+
+#endif /* LABWC_RENDER_POOL_H */
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_RENDER_SCALE_H
+#define LABWC_RENDER_SCALE_H
+
+struct server;
+struct view;
+
+/**
+ * render_scale_update() - apply the renderScale window rule to a view
+ * @view: mapped view
+ *
+ * The client is asked for buffers at the output scale times renderScale
+ * and the scene upscales them with the renderFilter of the rule. Views
+ * without the rule are left to the scene, which asks for the output
+ * scale.
+ */
+void render_scale_update(struct view *view);
+
+/* Stop overriding the preferred scale of @view, e.g. on unmap */
+void render_scale_finish(struct view *view);
+
+/* Re-apply the rules to all mapped views after they were reloaded */
+void render_scale_reconfigure(struct server *server);
+
+#endif /* LABWC_RENDER_SCALE_H */
@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_SANDBOX_H
+#define LABWC_SANDBOX_H
+
+#include <stdbool.h>
+
+struct server;
+struct wl_client;
+
+/* Copy of the security context of a client, see security-context-v1 */
+struct sandbox_info {
+	bool sandboxed;
+	/* NULL if not sandboxed or not set by the sandbox */
+	char *engine;
+	char *app_id;
+	char *instance_id;
+};
+
+/**
+ * sandbox_info_from_client() - get the security context of a client
+ *
+ * The context is looked up once per client and kept until the client is
+ * destroyed. A client's context is set when it connects and never changes,
+ * so this must not be called while the client is created.
+ */
+const struct sandbox_info *sandbox_info_from_client(struct server *server,
+	struct wl_client *client);
+
+#endif /* LABWC_SANDBOX_H */
@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_SCANOUT_H
+#define LABWC_SCANOUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct output;
+struct server;
+struct wlr_output_state;
+
+enum scanout_status {
+	LAB_SCANOUT_HIT = 0,
+	/* Disabled by WLR_SCENE_DISABLE_DIRECT_SCANOUT */
+	LAB_SCANOUT_DISABLED,
+	LAB_SCANOUT_MAGNIFIER,
+	LAB_SCANOUT_GAMMA,
+	/* The cursor is composited because no cursor plane took it */
+	LAB_SCANOUT_SOFTWARE_CURSOR,
+	/* No client buffer visible on the output */
+	LAB_SCANOUT_NO_CANDIDATE,
+	/* More than one buffer visible on the output */
+	LAB_SCANOUT_OVERLAP,
+	LAB_SCANOUT_TRANSFORM,
+	LAB_SCANOUT_FORMAT,
+	/* Anything else, for example a failed backend test */
+	LAB_SCANOUT_REJECTED,
+
+	LAB_SCANOUT_STATUS_COUNT
+};
+
+struct scanout_stats {
+	uint32_t count[LAB_SCANOUT_STATUS_COUNT];
+	enum scanout_status last;
+	/* Whether the last frame had a composited cursor */
+	bool software_cursor;
+};
+
+/**
+ * scanout_update() - account whether the frame just built for @output is
+ * directly scanned out and why not
+ * @output: output
+ * @state: output state filled by wlr_scene_output_build_state()
+ */
+void scanout_update(struct output *output, struct wlr_output_state *state);
+
+/**
+ * scanout_log_summary() - log direct scanout hits and misses by reason
+ * for all outputs
+ * @server: server
+ */
+void scanout_log_summary(struct server *server);
+
+#endif /* LABWC_SCANOUT_H */
@@ -20,6 +20,8 @@ struct session_lock_manager {
 	 */
 	struct wlr_session_lock_v1 *lock;
 	bool locked;
+	/* Views, layers and menus are disabled while all outputs are blanked */
+	bool content_hidden;
 
 	struct wl_list lock_outputs;
 
@@ -129,6 +129,18 @@ struct ssd_part {
 	struct wl_list link;
 };
 
+/**
+ * ssd_part_register - make @part findable from its scene node
+ * @part: part with its node set
+ *
+ * Attaches a LAB_NODE_DESC_SSD_PART node descriptor to part->node, so
+ * that ssd_get_part_type() classifies a hit node without searching the
+ * part lists. Must be called once for each part when it is created.
+ * A scaled buffer has a node descriptor of its own, parts drawn by one
+ * wrap it in a tree and use the tree as their node.
+ */
+void ssd_part_register(struct ssd_part *part);
+
 struct ssd_hover_state {
 	struct view *view;
 	struct ssd_button *button;
@@ -8,6 +8,7 @@
 #ifndef LABWC_THEME_H
 #define LABWC_THEME_H
 
+#include <stdint.h>
 #include <stdio.h>
 #include <wlr/render/wlr_renderer.h>
 #include "ssd.h"
@@ -38,6 +39,16 @@ enum lab_button_state {
 	LAB_BS_ALL = LAB_BS_HOVERD | LAB_BS_TOGGLED | LAB_BS_ROUNDED,
 };
 
+/* Groups of window assets which are rendered on first use */
+enum lab_theme_asset {
+	LAB_THEME_ASSET_CORNERS = 1 << 0,
+	LAB_THEME_ASSET_BUTTONS = 1 << 1,
+	LAB_THEME_ASSET_SHADOWS = 1 << 2,
+
+	LAB_THEME_ASSET_ALL = LAB_THEME_ASSET_CORNERS
+		| LAB_THEME_ASSET_BUTTONS | LAB_THEME_ASSET_SHADOWS,
+};
+
 struct theme {
 	int border_width;
 
@@ -95,6 +106,9 @@ struct theme {
 		struct lab_data_buffer *shadow_corner_top;
 		struct lab_data_buffer *shadow_corner_bottom;
 		struct lab_data_buffer *shadow_edge;
+
+		/* Bitset of enum lab_theme_asset already rendered */
+		uint32_t assets_loaded;
 	} window[2];
 
 	/* Derived from font sizes */
@@ -156,6 +170,17 @@ struct theme {
 	/* magnifier */
 	float mag_border_color[4];
 	int mag_border_width;
+
+	/* Set by theme_init(), see theme_is_current() */
+	bool loaded;
+	uint32_t sources_hash;
+
+	/*
+	 * Inputs of the window assets which are not theme fields, compared
+	 * by theme_reload() to decide which assets can be carried over
+	 */
+	int corner_radius;
+	uint32_t button_sources_hash;
 };
 
 #define THEME_INACTIVE 0
@@ -164,7 +189,7 @@ struct theme {
 struct server;
 
 /**
- * theme_init - read openbox theme and generate button textures
+ * theme_init - read openbox theme
  * @theme: theme data
  * @server: server
  * @theme_name: theme-name in <theme-dir>/<theme-name>/labwc/themerc
@@ -173,9 +198,57 @@ struct server;
 void theme_init(struct theme *theme, struct server *server, const char *theme_name);
 
 /**
- * theme_finish - free button textures
+ * theme_ensure_assets - render window assets on first use
+ * @theme: theme data
+ * @active: THEME_INACTIVE or THEME_ACTIVE
+ * @assets: bitset of enum lab_theme_asset
+ *
+ * The corner, button and shadow fields of theme->window[@active] are only
+ * valid for the groups passed to this function since the last theme_init().
+ * Groups which have been rendered before are not rendered again.
+ */
+void theme_ensure_assets(struct theme *theme, int active, uint32_t assets);
+
+/**
+ * theme_is_current - check whether reloading the theme would give the
+ * same result
+ * @theme: theme data
+ * @theme_name: theme-name that would be passed to theme_init()
+ *
+ * Compares the theme related rc.xml options and the stat() data of the
+ * themerc files with those seen by the last theme_init().
+ */
+bool theme_is_current(struct theme *theme, const char *theme_name);
+
+/**
+ * theme_reload - replace @theme by a newly read theme
+ * @theme: theme data, initialized by theme_init()
+ * @server: server
+ * @theme_name: theme-name as for theme_init()
+ *
+ * The new theme is read while @theme stays intact, and then replaces it
+ * in place. Window assets of the old theme which were rendered from the
+ * same colors, sizes and button sources are moved over instead of being
+ * rendered again.
+ */
+void theme_reload(struct theme *theme, struct server *server,
+	const char *theme_name);
+
+/**
+ * theme_finish - free button textures and other window assets
  * @theme: theme data
  */
 void theme_finish(struct theme *theme);
 
+/**
+ * theme_parse_buffer - apply the themerc entries in @data to @theme, the
+ * same way as they are read from a themerc file by theme_init()
+ * @theme: theme data, which is not reset first
+ * @data: themerc contents, not necessarily NUL-terminated
+ * @len: length of @data
+ *
+ * No assets are created. Used by the fuzzer and the parser benchmark.
+ */
+void theme_parse_buffer(struct theme *theme, const char *data, size_t len);
+
 #endif /* LABWC_THEME_H */
@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_TIMER_WHEEL_H
+#define LABWC_TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-util.h>
+
+struct wl_event_loop;
+struct wl_event_source;
+
+/*
+ * A set of one-shot timers multiplexed onto a single wl_event_loop timer.
+ *
+ * Timers are kept sorted by deadline and the underlying timerfd is only
+ * reprogrammed when the earliest deadline moves forward. Disarming a timer
+ * never touches the timerfd; an early wakeup just re-arms it for the next
+ * deadline.
+ */
+struct timer_wheel {
+	struct wl_event_source *source;
+	struct wl_list timers; /* struct lab_timer.link, by deadline */
+	uint64_t programmed_msec; /* deadline of the timerfd, 0 if idle */
+};
+
+typedef void (*lab_timer_func_t)(void *data);
+
+struct lab_timer {
+	struct wl_list link;
+	uint64_t deadline_msec;
+	lab_timer_func_t func;
+	void *data;
+	bool armed;
+};
+
+void timer_wheel_init(struct timer_wheel *wheel, struct wl_event_loop *loop);
+
+/* Disarms all remaining timers, so lab_timer_disarm() stays safe on them */
+void timer_wheel_finish(struct timer_wheel *wheel);
+
+/**
+ * lab_timer_init() - set up a disarmed timer
+ * @timer: timer
+ * @func: called once from the event loop when the timer expires
+ * @data: passed to @func
+ */
+void lab_timer_init(struct lab_timer *timer, lab_timer_func_t func,
+	void *data);
+
+/**
+ * lab_timer_arm() - (re-)arm a timer to expire @delay_msec from now
+ * @wheel: timer wheel
+ * @timer: timer, which may be re-armed from its own callback
+ * @delay_msec: delay in milliseconds, at least 1ms is used
+ */
+void lab_timer_arm(struct timer_wheel *wheel, struct lab_timer *timer,
+	int delay_msec);
+
+void lab_timer_disarm(struct lab_timer *timer);
+
+static inline bool
+lab_timer_is_armed(struct lab_timer *timer)
+{
+	return timer->armed;
+}
+
+#endif /* LABWC_TIMER_WHEEL_H */
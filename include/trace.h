@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_TRACE_H
+#define LABWC_TRACE_H
+
+#include "config.h"
+
+/*
+ * Spans written to the ftrace trace_marker file in the format understood
+ * by Perfetto and systrace, so that a compositor session can be profiled
+ * together with the kernel and other processes.
+ *
+ * Tracing is built in with the meson option -Dtrace=enabled and only
+ * active while the trace_marker file can be opened for writing. Without
+ * the option all of the functions and macros below compile to nothing.
+ */
+
+#if HAVE_TRACE
+
+/**
+ * trace_begin() - start a span
+ * @name: name of the span, nested within the span currently open
+ */
+void trace_begin(const char *name);
+
+/* End the innermost open span */
+void trace_end(void);
+
+/* Close the trace_marker file */
+void trace_finish(void);
+
+static inline void
+trace_scope_end(const char **name)
+{
+	(void)name;
+	trace_end();
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+/*
+ * TRACE_SCOPE() - trace the rest of the enclosing block as a span, which
+ * is ended on every way out of the block
+ */
+#define TRACE_SCOPE(name) \
+	const char *TRACE_CONCAT(trace_scope_, __LINE__) \
+		__attribute__((cleanup(trace_scope_end), unused)) = \
+		(trace_begin(name), name)
+
+#else
+
+static inline void trace_begin(const char *name) { (void)name; }
+static inline void trace_end(void) { }
+static inline void trace_finish(void) { }
+
+#define TRACE_SCOPE(name) do { } while (0)
+
+#endif /* HAVE_TRACE */
+
+/* Trace the rest of the enclosing function as a span named after it */
+#define TRACE_FUNC() TRACE_SCOPE(__func__)
+
+#endif /* LABWC_TRACE_H */
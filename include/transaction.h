@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_TRANSACTION_H
+#define LABWC_TRANSACTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-util.h>
+#include "timer-wheel.h"
+
+struct output;
+struct server;
+struct view;
+
+/*
+ * A configure transaction collects the views which were resized between
+ * transaction_begin() and transaction_commit(). Until each of them has
+ * committed a buffer for its new size, or the timeout expires, outputs
+ * showing any of them are not repainted, so that all views appear at
+ * their new geometry in the same frame.
+ *
+ * The transaction is also a batch scope: the outputs of views moved
+ * within it and the visibility of the top layers are recomputed once
+ * by the outermost transaction_commit() rather than after every view.
+ */
+struct transaction {
+	/* Nesting level of transaction_begin() */
+	int depth;
+	/* struct view.transaction_link, views which have not yet committed */
+	struct wl_list views;
+	/* Set once the outermost transaction_commit() has been called */
+	bool waiting;
+	/* Some view.outputs_dirty is set */
+	bool outputs_dirty;
+	/* Outputs to pass to desktop_update_top_layer_outputs() */
+	uint64_t top_layer_outputs;
+	/* Deferred work is being done by the outermost commit */
+	bool flushing;
+	struct lab_timer timeout;
+};
+
+void transaction_init(struct server *server);
+void transaction_finish(struct server *server);
+
+/**
+ * transaction_begin() - start collecting resized views
+ * @server: server
+ *
+ * Calls may be nested, only the outermost transaction_commit() counts.
+ */
+void transaction_begin(struct server *server);
+
+/**
+ * transaction_commit() - wait for the collected views
+ * @server: server
+ *
+ * The outermost call first runs the deferred view_update_outputs() and
+ * desktop_update_top_layer_outputs() calls. A transaction with less
+ * than two views is then dropped immediately since there is nothing to
+ * synchronize.
+ */
+void transaction_commit(struct server *server);
+
+/**
+ * transaction_defer_outputs() - postpone view_update_outputs() to the
+ * end of the open transaction
+ * @view: view whose geometry has changed
+ *
+ * Return: true if there is an open transaction and @view has been marked
+ * for update, false if the caller has to update @view now.
+ */
+bool transaction_defer_outputs(struct view *view);
+
+/**
+ * transaction_defer_top_layer() - postpone
+ * desktop_update_top_layer_outputs() to the end of the open transaction
+ * @server: server
+ * @outputs: bitset of output->scene_output->index, added to those of
+ *           earlier deferred calls
+ *
+ * Return: true if there is an open transaction, false otherwise.
+ */
+bool transaction_defer_top_layer(struct server *server, uint64_t outputs);
+
+/**
+ * transaction_add_view() - add @view to the open transaction, if any
+ * @view: view which has been sent a configure with a new size
+ */
+void transaction_add_view(struct view *view);
+
+/**
+ * transaction_view_done() - remove @view from the transaction
+ * @view: view which has committed its new size, timed out or is going
+ *        away
+ */
+void transaction_view_done(struct view *view);
+
+/**
+ * transaction_blocks_output() - check whether repainting @output has to
+ * wait for views of the pending transaction
+ * @output: output
+ */
+bool transaction_blocks_output(struct output *output);
+
+#endif /* LABWC_TRANSACTION_H */
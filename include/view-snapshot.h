@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_VIEW_SNAPSHOT_H
+#define LABWC_VIEW_SNAPSHOT_H
+
+struct view;
+struct wlr_scene_tree;
+
+/**
+ * view_snapshot_create() - capture the current content of a view
+ * @view: view to capture, which may be disabled or on another workspace
+ * @parent: tree to add the snapshot to
+ * @scale: pixels of the snapshot per layout pixel, less than 1 for
+ *	thumbnails
+ *
+ * The surfaces and subsurfaces of @view are rendered into one buffer.
+ * The returned scene buffer has the size of view->current in layout
+ * coordinates and sits at 0,0 in @parent. It does not change when the
+ * client redraws, so previews, thumbnails and animations can show it
+ * without keeping the live surface tree on screen. The caller destroys
+ * its node. Returns NULL if the view has no content or rendering fails.
+ */
+struct wlr_scene_buffer *view_snapshot_create(struct view *view,
+	struct wlr_scene_tree *parent, float scale);
+
+#endif /* LABWC_VIEW_SNAPSHOT_H */
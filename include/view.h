@@ -10,7 +10,15 @@
 #include <wayland-util.h>
 #include <wlr/util/box.h>
 #include <xkbcommon/xkbcommon.h>
+#include "common/match.h"
 #include "common/three-state.h"
+#include "osd.h"
+#include "timer-wheel.h"
+#include "window-rules.h"
+#include "workspaces.h"
+
+/* Time given to clients to respond to a configure request */
+#define CONFIGURE_TIMEOUT_MS 100
 
 #define LAB_MIN_VIEW_HEIGHT 60
 
@@ -24,6 +32,9 @@
 #define VIEW_FALLBACK_WIDTH  640
 #define VIEW_FALLBACK_HEIGHT 480
 
+/* Output layouts a view remembers its geometry for, see layout_history */
+#define VIEW_LAYOUT_HISTORY_SIZE 4
+
 /*
  * In labwc, a view is a container for surfaces which can be moved around by
  * the user. In practice this means XDG toplevel and XWayland windows.
@@ -165,10 +176,33 @@ struct view_impl {
 };
 
 struct view {
+	/*
+	 * Hot fields, read for every view by for_each_view() scans,
+	 * matches_criteria() and the geometry checks of the cursor and
+	 * output code. They are kept together in the first two cache lines
+	 * (64-bit), so that such scans touch as little of each view as
+	 * possible. The rest of the struct is only read for specific views.
+	 */
+	struct wl_list link;
 	struct server *server;
-	enum view_type type;
 	const struct view_impl *impl;
-	struct wl_list link;
+	struct wlr_scene_tree *scene_tree;
+	struct wlr_surface *surface;
+	struct workspace *workspace;
+	enum view_type type;
+	bool mapped;
+	bool minimized;
+	bool fullscreen;
+	bool visible_on_all_workspaces;
+
+	/*
+	 * The outputs that the view is displayed on.
+	 * This is used to notify the foreign toplevel
+	 * implementation and to update the SSD invisible
+	 * resize area.
+	 * It is a bitset of output->scene_output->index.
+	 */
+	uint64_t outputs;
 
 	/*
 	 * The primary output that the view is displayed on. Specifically:
@@ -188,53 +222,64 @@ struct view {
 	struct output *output;
 
 	/*
-	 * The outputs that the view is displayed on.
-	 * This is used to notify the foreign toplevel
-	 * implementation and to update the SSD invisible
-	 * resize area.
-	 * It is a bitset of output->scene_output->index.
+	 * Geometry of the wlr_surface contained within the view, as
+	 * currently displayed. Should be kept in sync with the
+	 * scene-graph at all times.
 	 */
-	uint64_t outputs;
+	struct wlr_box current;
+	/*
+	 * Expected geometry after any pending move/resize requests
+	 * have been processed. Should match current geometry when no
+	 * move/resize requests are pending.
+	 */
+	struct wlr_box pending;
+
+	enum view_axis maximized;
+	enum view_edge tiled;
+	bool shaded;
+	bool ssd_enabled;
+	/* view_update_outputs() is deferred by the open transaction */
+	bool outputs_dirty;
+	/* End of the hot fields */
+
+	/*
+	 * Secondary index of server->views: stack_link is in the list of
+	 * the workspace or always-on-top tree the view is parented to, in
+	 * the same order. stack_order decreases from the topmost view down.
+	 */
+	struct wl_list stack_link;
+	struct wl_list *stack_bucket;
+	int64_t stack_order;
+
+	/* Interned lower-cased app_id the view is indexed by, or NULL */
+	const char *app_id_key;
+
+	struct window_rules_cache window_rules;
+	struct osd_field_cache osd_fields;
 
-	struct workspace *workspace;
-	struct wlr_surface *surface;
-	struct wlr_scene_tree *scene_tree;
 	struct wlr_scene_tree *content_tree;
 
-	bool mapped;
 	bool been_mapped;
-	bool ssd_enabled;
+	/* Mapped on a hidden workspace, see view_finish_deferred_init() */
+	bool init_deferred;
 	bool ssd_titlebar_hidden;
 	enum ssd_preference ssd_preference;
-	bool shaded;
-	bool minimized;
-	enum view_axis maximized;
-	bool fullscreen;
 	bool tearing_hint;
 	enum three_state force_tearing;
-	bool visible_on_all_workspaces;
-	enum view_edge tiled;
 	uint32_t edges_visible;  /* enum wlr_edges bitset */
 	bool inhibits_keybinds;
+	/* Layout on deactivation, valid for seat->keyboard_layout_generation */
 	xkb_layout_index_t keyboard_layout;
+	uint32_t keyboard_layout_generation;
+
+	/* Set while the view has been asked to close by view_close_many() */
+	struct view_close_batch *close_batch;
 
 	/* Pointer to an output owned struct region, may be NULL */
 	struct region *tiled_region;
 	/* Set to region->name when tiled_region is free'd by a destroying output */
 	char *tiled_region_evacuate;
 
-	/*
-	 * Geometry of the wlr_surface contained within the view, as
-	 * currently displayed. Should be kept in sync with the
-	 * scene-graph at all times.
-	 */
-	struct wlr_box current;
-	/*
-	 * Expected geometry after any pending move/resize requests
-	 * have been processed. Should match current geometry when no
-	 * move/resize requests are pending.
-	 */
-	struct wlr_box pending;
 	/*
 	 * Saved geometry which will be restored when the view returns
 	 * to normal/floating state after being maximized/fullscreen/
@@ -242,6 +287,16 @@ struct view {
 	 * maximized/fullscreen/tiled.
 	 */
 	struct wlr_box natural_geometry;
+	/*
+	 * Last snapped resize of this view, see snap-constraints.c.
+	 * Unused while direction is VIEW_EDGE_INVALID.
+	 */
+	struct {
+		bool pending;
+		int offset;
+		enum view_edge direction;
+		struct wlr_box geom;
+	} snap_hit;
 	/*
 	 * Whenever an output layout change triggers a view relocation, the
 	 * last pending position (or natural geometry) will be saved so the
@@ -249,10 +304,21 @@ struct view {
 	 * change.
 	 */
 	struct wlr_box last_layout_geometry;
+	/*
+	 * Geometries the view had in the last output layouts it left, most
+	 * recent first, restored as they were on returning to the layout
+	 */
+	struct view_layout_geometry {
+		uint64_t signature; /* server->output_layout_signature */
+		struct wlr_box box;
+	} layout_history[VIEW_LAYOUT_HISTORY_SIZE];
 
 	/* used by xdg-shell views */
 	uint32_t pending_configure_serial;
-	struct wl_event_source *pending_configure_timeout;
+	struct lab_timer pending_configure_timeout;
+
+	/* server.transaction.views, self-linked if not in a transaction */
+	struct wl_list transaction_link;
 
 	struct ssd *ssd;
 	struct resize_indicator {
@@ -309,6 +375,29 @@ struct view_query {
 	char *desktop;
 	enum ssd_mode decoration;
 	char *monitor;
+
+	/* Compiled from the patterns above on first use */
+	bool compiled;
+	struct match_glob identifier_glob;
+	struct match_glob title_glob;
+	struct match_glob sandbox_engine_glob;
+	struct match_glob sandbox_app_id_glob;
+	struct match_glob tiled_region_glob;
+	/*
+	 * Lower-cased and interned identifier if it has no wildcards, for
+	 * the app_id index
+	 */
+	const char *identifier_key;
+	/* desktop="other", or the parsed desktop otherwise */
+	bool desktop_other;
+	struct workspace_ref desktop_ref;
+	enum view_query_monitor {
+		LAB_QUERY_MONITOR_ANY = 0,
+		LAB_QUERY_MONITOR_CURRENT,
+		LAB_QUERY_MONITOR_LEFT,
+		LAB_QUERY_MONITOR_RIGHT,
+		LAB_QUERY_MONITOR_NAME,
+	} monitor_type;
 };
 
 struct xdg_toplevel_view {
@@ -319,6 +408,28 @@ struct xdg_toplevel_view {
 	struct wl_listener set_app_id;
 	struct wl_listener request_show_window_menu;
 	struct wl_listener new_popup;
+
+	/*
+	 * view->pending has a size which has not been sent yet because
+	 * the client had not acked the previous configure
+	 */
+	bool configure_deferred;
+
+	/*
+	 * Output on which an opaque fullscreen view covers this one, which
+	 * is disabled in the scene meanwhile. See output_update_culling().
+	 */
+	struct output *culled_on;
+
+	/* Last frame event sent to a view with a maxFps window rule */
+	int64_t last_frame_done_nsec;
+
+	/* Scene buffer of the main surface with a renderScale window rule */
+	struct {
+		struct wlr_scene_buffer *buffer;
+		struct wl_listener outputs_update;
+		struct wl_listener destroy;
+	} render_scale;
 };
 
 /* All criteria is applied in AND logic */
@@ -371,6 +482,15 @@ void view_query_free(struct view_query *view);
  */
 bool view_matches_query(struct view *view, struct view_query *query);
 
+/**
+ * view_query_compile() - pre-classify the glob patterns of a query and
+ * parse its desktop and monitor
+ * @query: query whose pattern strings have all been set
+ *
+ * Called by view_matches_query() on first use if needed.
+ */
+void view_query_compile(struct view_query *query);
+
 /**
  * for_each_view() - iterate over all views which match criteria
  * @view: Iterator.
@@ -436,6 +556,16 @@ struct view *view_next_no_head_stop(struct wl_list *head, struct view *from,
 struct view *view_prev_no_head_stop(struct wl_list *head, struct view *from,
 	enum lab_view_criteria criteria);
 
+/**
+ * view_stack_add() - insert a new view at the top of server->views and of
+ * the stacking index of its workspace
+ * @view: view, whose scene_tree must already exist
+ */
+void view_stack_add(struct view *view);
+
+/* Drop all views from the stacking index list @bucket */
+void view_stack_detach_all(struct wl_list *bucket);
+
 /**
  * view_array_append() - Append views that match criteria to array
  * @server: server context
@@ -462,6 +592,20 @@ struct view *view_prev_no_head_stop(struct wl_list *head, struct view *from,
 void view_array_append(struct server *server, struct wl_array *views,
 	enum lab_view_criteria criteria);
 
+/**
+ * view_array_append_by_identifier() - append the views which can match any
+ * of @queries, looked up by app_id
+ * @server: server context
+ * @views: array to append to, in the same order as view_array_append()
+ * @queries: list of struct view_query
+ *
+ * Only works if each query has an identifier without wildcards. Returns
+ * false and appends nothing otherwise. The views appended still need to
+ * be checked with view_matches_query().
+ */
+bool view_array_append_by_identifier(struct server *server,
+	struct wl_array *views, struct wl_list *queries);
+
 enum view_wants_focus view_wants_focus(struct view *view);
 bool view_contains_window_type(struct view *view, enum window_type window_type);
 
@@ -504,6 +648,28 @@ void view_set_activated(struct view *view, bool activated);
 void view_set_output(struct view *view, struct output *output);
 void view_close(struct view *view);
 
+/* Send SIGTERM to the client process of @view, unless that is labwc */
+void view_kill(struct view *view);
+
+typedef void (*view_close_done_func_t)(void *data);
+
+/**
+ * view_close_many() - ask several views to close as one batch
+ * @server: server
+ * @views: array of struct view *
+ * @kill_timeout_msec: kill the clients of views which are still around
+ *                     after this many milliseconds, 0 to never kill
+ * @done: called once all views are gone or the batch has timed out,
+ *        may be NULL
+ * @data: passed to @done
+ *
+ * Focus moves straight to the topmost view which is not being closed,
+ * rather than through each of the closing views as they go away.
+ * Views which refuse to close are focusable again after the timeout.
+ */
+void view_close_many(struct server *server, struct wl_array *views,
+	int kill_timeout_msec, view_close_done_func_t done, void *data);
+
 /**
  * view_move_resize - resize and move view
  * @view: view to be resized and moved
@@ -576,12 +742,33 @@ bool view_is_tiled(struct view *view);
 bool view_is_tiled_and_notify_tiled(struct view *view);
 bool view_is_floating(struct view *view);
 void view_move_to_workspace(struct view *view, struct workspace *workspace);
+
+/**
+ * view_finish_deferred_init() - set up what view_impl_map() left out
+ * @view: view mapped while its workspace was hidden
+ *
+ * Does nothing unless the workspace of @view is now the current one.
+ */
+void view_finish_deferred_init(struct view *view);
 enum ssd_mode view_get_ssd_mode(struct view *view);
 void view_set_ssd_mode(struct view *view, enum ssd_mode mode);
 void view_set_decorations(struct view *view, enum ssd_mode mode, bool force_ssd);
 void view_toggle_fullscreen(struct view *view);
 void view_invalidate_last_layout_geometry(struct view *view);
 void view_adjust_for_layout_change(struct view *view);
+
+/**
+ * view_save_layout_geometry() - remember the geometry of @view for the
+ * current output layout, before it is left
+ */
+void view_save_layout_geometry(struct view *view);
+
+/**
+ * view_update_outputs() - recompute the set of usable outputs @view is
+ * shown on, without touching its geometry
+ * @view: view
+ */
+void view_update_outputs(struct view *view);
 void view_move_to_edge(struct view *view, enum view_edge direction, bool snap_to_windows);
 void view_grow_to_edge(struct view *view, enum view_edge direction);
 void view_shrink_to_edge(struct view *view, enum view_edge direction);
@@ -3,7 +3,9 @@
 #define LABWC_WINDOW_RULES_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <wayland-util.h>
+#include "common/match.h"
 
 enum window_rule_event {
 	LAB_WINDOW_RULE_EVENT_ON_FIRST_MAP = 0,
@@ -16,6 +18,42 @@ enum property {
 	LAB_PROP_TRUE,
 };
 
+enum window_rule_prop {
+	LAB_WINDOW_RULE_PROP_SERVER_DECORATION = 0,
+	LAB_WINDOW_RULE_PROP_SKIP_TASKBAR,
+	LAB_WINDOW_RULE_PROP_SKIP_WINDOW_SWITCHER,
+	LAB_WINDOW_RULE_PROP_IGNORE_FOCUS_REQUEST,
+	LAB_WINDOW_RULE_PROP_IGNORE_CONFIGURE_REQUEST,
+	LAB_WINDOW_RULE_PROP_FIXED_POSITION,
+	LAB_WINDOW_RULE_PROP_PREFER_SCANOUT,
+	LAB_WINDOW_RULE_PROP_TEARING,
+
+	LAB_WINDOW_RULE_PROP_COUNT
+};
+
+/* Numeric properties, 0 if not set by any rule */
+enum window_rule_value {
+	LAB_WINDOW_RULE_VALUE_RENDER_SCALE = 0,
+	LAB_WINDOW_RULE_VALUE_RENDER_FILTER,
+	LAB_WINDOW_RULE_VALUE_MAX_FPS,
+	LAB_WINDOW_RULE_VALUE_MAX_FPS_UNFOCUSED,
+	LAB_WINDOW_RULE_VALUE_COUNT
+};
+
+/* Values of renderFilter */
+enum lab_render_filter {
+	LAB_RENDER_FILTER_UNSET = 0,
+	LAB_RENDER_FILTER_LINEAR,
+	LAB_RENDER_FILTER_NEAREST,
+};
+
+/* Properties of all window rules resolved for one view */
+struct window_rules_cache {
+	uint64_t generation; /* 0 if not resolved yet */
+	enum property props[LAB_WINDOW_RULE_PROP_COUNT];
+	double values[LAB_WINDOW_RULE_VALUE_COUNT];
+};
+
 /*
  * 'identifier' represents:
  *   - 'app_id' for native Wayland windows
@@ -38,6 +76,15 @@ struct window_rule {
 	enum property ignore_focus_request;
 	enum property ignore_configure_request;
 	enum property fixed_position;
+	enum property prefer_scanout;
+	enum property tearing;
+	double values[LAB_WINDOW_RULE_VALUE_COUNT];
+
+	/* Compiled by window_rules_compile() after parsing */
+	struct match_glob identifier_glob;
+	struct match_glob title_glob;
+	struct match_glob sandbox_engine_glob;
+	struct match_glob sandbox_app_id_glob;
 
 	struct wl_list link; /* struct rcxml.window_rules */
 };
@@ -45,6 +92,39 @@ struct window_rule {
 struct view;
 
 void window_rules_apply(struct view *view, enum window_rule_event event);
+
+/* Pre-compile the match patterns of all rules in rc.window_rules */
+void window_rules_compile(void);
+
+/**
+ * window_rules_get_property() - get a window rule property of a view
+ * @view: view
+ * @property: name of the property as used in rc.xml, e.g. "skipTaskbar"
+ *
+ * The properties of all rules are resolved once and cached per view until
+ * window_rules_invalidate() is called.
+ */
 enum property window_rules_get_property(struct view *view, const char *property);
 
+/**
+ * window_rules_get_value() - get a numeric window rule property of a view
+ * @view: view
+ * @value: property
+ *
+ * Resolved and cached together with the properties of
+ * window_rules_get_property(), so it is cheap enough to call per frame.
+ * Returns 0 if no matching rule sets the property.
+ */
+double window_rules_get_value(struct view *view, enum window_rule_value value);
+
+/**
+ * window_rules_invalidate() - drop resolved window rule properties
+ * @view: view whose title, app_id or window type changed, or NULL after
+ *	  the rules have been reloaded
+ *
+ * If any rule uses matchOnce, the properties of all views depend on the
+ * other views and are dropped as well.
+ */
+void window_rules_invalidate(struct view *view);
+
 #endif /* LABWC_WINDOW_RULES_H */
@@ -20,6 +20,7 @@ struct workspace {
 
 	char *name;
 	struct wlr_scene_tree *tree;
+	struct wl_list views; /* struct view.stack_link, topmost first */
 
 	struct lab_cosmic_workspace *cosmic_workspace;
 	struct {
@@ -39,10 +40,47 @@ struct workspace {
 
 void workspaces_init(struct server *server);
 void workspaces_switch_to(struct workspace *target, bool update_focus);
+
+/**
+ * workspaces_settle() - run the focus and protocol updates deferred by
+ * workspaces_switch_to() right away
+ * @server: server
+ *
+ * Does nothing if no workspace switch is pending.
+ */
+void workspaces_settle(struct server *server);
 void workspaces_destroy(struct server *server);
 void workspaces_osd_hide(struct seat *seat);
 struct workspace *workspaces_find(struct workspace *anchor, const char *name,
 	bool wrap);
+
+enum workspace_ref_type {
+	LAB_WORKSPACE_REF_NAME = 0,
+	LAB_WORKSPACE_REF_INDEX,
+	LAB_WORKSPACE_REF_CURRENT,
+	LAB_WORKSPACE_REF_LAST,
+	LAB_WORKSPACE_REF_LEFT,
+	LAB_WORKSPACE_REF_RIGHT,
+};
+
+/* Workspace argument of an action, parsed once when the config is loaded */
+struct workspace_ref {
+	enum workspace_ref_type type;
+	size_t index;  /* 1-based, for LAB_WORKSPACE_REF_INDEX */
+	char *key;     /* lower-cased name, for LAB_WORKSPACE_REF_NAME */
+};
+
+/**
+ * workspace_ref_parse() - parse @name as accepted by workspaces_find()
+ * @ref: reference to fill in, release with workspace_ref_finish()
+ * @name: workspace name, 1-based index, "current", "last", "left" or "right"
+ */
+void workspace_ref_parse(struct workspace_ref *ref, const char *name);
+void workspace_ref_finish(struct workspace_ref *ref);
+
+/* Like workspaces_find(), but doesn't look at any strings but the key */
+struct workspace *workspaces_find_ref(struct workspace *anchor,
+	const struct workspace_ref *ref, bool wrap);
 void workspaces_reconfigure(struct server *server);
 
 #endif /* LABWC_WORKSPACES_H */
@@ -15,6 +15,8 @@ struct xwayland_unmanaged {
 	struct wlr_xwayland_surface *xwayland_surface;
 	struct wlr_scene_node *node;
 	struct wl_list link;
+	/* server.unmanaged_focus_surfaces, self-linked if not listed */
+	struct wl_list focus_link;
 
 	struct mappable mappable;
 
@@ -52,15 +54,31 @@ struct xwayland_view {
 	struct wl_listener set_window_type;
 	struct wl_listener focus_in;
 	struct wl_listener map_request;
+	struct wl_listener set_hints;
+
+	/* server.xwayland_strut_views, self-linked if not listed */
+	struct wl_list strut_link;
+
+	/*
+	 * Derived from the xsurface by update_cached_props() whenever one
+	 * of the properties involved changes, since focus and window-rule
+	 * code query them a lot
+	 */
+	struct {
+		uint32_t window_types; /* 1 << enum window_type */
+		enum view_wants_focus wants_focus;
+	} props;
 
 	/* Not (yet) implemented */
 /*	struct wl_listener set_role; */
-/*	struct wl_listener set_hints; */
 };
 
 void xwayland_unmanaged_create(struct server *server,
 	struct wlr_xwayland_surface *xsurface, bool mapped);
 
+/* Free the structures kept for reuse by xwayland_unmanaged_create() */
+void xwayland_unmanaged_pool_finish(void);
+
 void xwayland_view_create(struct server *server,
 	struct wlr_xwayland_surface *xsurface, bool mapped);
 
@@ -70,13 +88,27 @@ void xwayland_server_init(struct server *server,
 	struct wlr_compositor *compositor);
 void xwayland_server_finish(struct server *server);
 
-void xwayland_adjust_usable_area(struct view *view,
-	struct wlr_output_layout *layout, struct wlr_output *output,
-	struct wlr_box *usable);
-
+/**
+ * xwayland_adjust_usable_area() - subtract the struts of all mapped
+ * XWayland views (e.g. panels) from the usable area of @output
+ * @server: server
+ * @output: output
+ * @usable: usable area of @output in output coordinates
+ */
+void xwayland_adjust_usable_area(struct server *server,
+	struct wlr_output *output, struct wlr_box *usable);
+
+/* Deferred until the end of the event loop iteration, see deferred.h */
 void xwayland_update_workarea(struct server *server);
 
 void xwayland_reset_cursor(struct server *server);
 
+/**
+ * xwayland_output_presented() - start a <xwaylandWarmStart> xwayland
+ * server once every usable output has presented a frame
+ * @server: server
+ */
+void xwayland_output_presented(struct server *server);
+
 #endif /* HAVE_XWAYLAND */
 #endif /* LABWC_XWAYLAND_H */
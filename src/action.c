@@ -1,28 +1,40 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <glib.h>
 #include <signal.h>
 #include <string.h>
 #include <strings.h>
 #include <unistd.h>
 #include <wlr/util/log.h>
 #include "action.h"
+#include "buffer.h"
+#include "common/arena.h"
 #include "common/macros.h"
 #include "common/list.h"
 #include "common/mem.h"
 #include "common/parse-bool.h"
+#include "common/parse-double.h"
+#include "common/scaled-scene-buffer.h"
 #include "common/spawn.h"
 #include "common/string-helpers.h"
 #include "debug.h"
+#include "hud.h"
 #include "labwc.h"
 #include "magnifier.h"
+#include "metrics.h"
 
 #include "osd.h"
+#include "overview.h"
+#include "output-timing.h"
 #include "output-virtual.h"
 #include "regions.h"
+#include "scanout.h"
 #include "ssd.h"
+#include "trace.h"
 #include "view.h"
 #include "workspaces.h"
+#include "input/input-record.h"
 #include "input/keyboard.h"
 
 enum action_arg_type {
@@ -60,6 +72,60 @@ struct action_arg_list {
 	struct wl_list value;
 };
 
+enum warp_target {
+	LAB_WARP_TARGET_INVALID = 0,
+	LAB_WARP_TARGET_OUTPUT,
+	LAB_WARP_TARGET_WINDOW,
+};
+
+/* From the left/top edge, or from the right/bottom edge if negative */
+struct warp_coord {
+	bool center;
+	int offset;
+};
+
+enum action_branch {
+	LAB_BRANCH_THEN = 0,
+	LAB_BRANCH_ELSE,
+	LAB_BRANCH_NONE,
+
+	LAB_BRANCH_COUNT
+};
+
+static const char * const branch_names[LAB_BRANCH_COUNT] = {
+	[LAB_BRANCH_THEN] = "then",
+	[LAB_BRANCH_ELSE] = "else",
+	[LAB_BRANCH_NONE] = "none",
+};
+
+/*
+ * Arguments of an action in the form actions_run() needs them. They are
+ * looked up once when the config is loaded, so running a bound action
+ * doesn't walk the argument list or compare any strings. Borrowed strings
+ * are owned by the action_arg they come from.
+ */
+struct action_params {
+	char **argv;              /* Execute, with a leading ~ expanded */
+	const char *file;         /* Debug, InputRecord, InputReplay */
+	const char *output_name;  /* FocusOutput, MoveToOutput, VirtualOutput* */
+	bool json;                /* Debug */
+	bool wrap;
+	bool follow;
+	bool has_workspace;
+	struct workspace_ref workspace;  /* GoToDesktop, SendToDesktop */
+	enum view_edge direction;
+	enum view_placement_policy policy;
+	struct virtual_output_mode mode;
+	int count;                /* VirtualOutputAdd, VirtualOutputRemove */
+	double speed;
+	struct {
+		enum warp_target to;
+		struct warp_coord x, y;
+	} warp;
+	struct wl_list *queries;  /* If, ForEach; NULL if none */
+	struct wl_list *branches[LAB_BRANCH_COUNT];
+};
+
 enum action_type {
 	ACTION_TYPE_INVALID = 0,
 	ACTION_TYPE_NONE,
@@ -127,6 +193,12 @@ enum action_type {
 	ACTION_TYPE_ZOOM_OUT,
 	ACTION_TYPE_WARP_CURSOR,
 	ACTION_TYPE_HIDE_CURSOR,
+	ACTION_TYPE_DUMP_FRAME_TIMING,
+	ACTION_TYPE_INPUT_RECORD,
+	ACTION_TYPE_INPUT_REPLAY,
+	ACTION_TYPE_TOGGLE_FRAME_PACING,
+	ACTION_TYPE_TOGGLE_PERF_HUD,
+	ACTION_TYPE_TOGGLE_OVERVIEW,
 };
 
 const char *action_names[] = {
@@ -196,6 +268,12 @@ const char *action_names[] = {
 	"ZoomOut",
 	"WarpCursor",
 	"HideCursor",
+	"DumpFrameTiming",
+	"InputRecord",
+	"InputReplay",
+	"ToggleFramePacing",
+	"TogglePerfHud",
+	"ToggleOverview",
 	NULL
 };
 
@@ -205,10 +283,10 @@ action_arg_add_str(struct action *action, const char *key, const char *value)
 	assert(action);
 	assert(key);
 	assert(value && "Tried to add NULL action string argument");
-	struct action_arg_str *arg = znew(*arg);
+	struct action_arg_str *arg = lab_arena_new(&rc.arena, *arg);
 	arg->base.type = LAB_ACTION_ARG_STR;
-	arg->base.key = xstrdup(key);
-	arg->value = xstrdup(value);
+	arg->base.key = lab_arena_strdup(&rc.arena, key);
+	arg->value = lab_arena_strdup(&rc.arena, value);
 	wl_list_append(&action->args, &arg->base.link);
 }
 
@@ -217,9 +295,9 @@ action_arg_add_bool(struct action *action, const char *key, bool value)
 {
 	assert(action);
 	assert(key);
-	struct action_arg_bool *arg = znew(*arg);
+	struct action_arg_bool *arg = lab_arena_new(&rc.arena, *arg);
 	arg->base.type = LAB_ACTION_ARG_BOOL;
-	arg->base.key = xstrdup(key);
+	arg->base.key = lab_arena_strdup(&rc.arena, key);
 	arg->value = value;
 	wl_list_append(&action->args, &arg->base.link);
 }
@@ -229,9 +307,9 @@ action_arg_add_int(struct action *action, const char *key, int value)
 {
 	assert(action);
 	assert(key);
-	struct action_arg_int *arg = znew(*arg);
+	struct action_arg_int *arg = lab_arena_new(&rc.arena, *arg);
 	arg->base.type = LAB_ACTION_ARG_INT;
-	arg->base.key = xstrdup(key);
+	arg->base.key = lab_arena_strdup(&rc.arena, key);
 	arg->value = value;
 	wl_list_append(&action->args, &arg->base.link);
 }
@@ -241,9 +319,9 @@ action_arg_add_list(struct action *action, const char *key, enum action_arg_type
 {
 	assert(action);
 	assert(key);
-	struct action_arg_list *arg = znew(*arg);
+	struct action_arg_list *arg = lab_arena_new(&rc.arena, *arg);
 	arg->base.type = type;
-	arg->base.key = xstrdup(key);
+	arg->base.key = lab_arena_strdup(&rc.arena, key);
 	wl_list_init(&arg->value);
 	wl_list_append(&action->args, &arg->base.link);
 }
@@ -466,11 +544,38 @@ action_arg_from_xml_node(struct action *action, const char *nodename, const char
 		}
 		break;
 	case ACTION_TYPE_VIRTUAL_OUTPUT_ADD:
+		if (!strcmp(argument, "width") || !strcmp(argument, "height")) {
+			action_arg_add_int(action, argument, atoi(content));
+			goto cleanup;
+		}
+		if (!strcmp(argument, "refresh")) {
+			double refresh;
+			if (set_double(content, &refresh) && refresh > 0) {
+				/* Stored in mHz like wlr_output_mode.refresh */
+				action_arg_add_int(action, argument,
+					(int)(refresh * 1000 + 0.5));
+			} else {
+				wlr_log(WLR_ERROR, "Invalid argument for action %s: '%s' (%s)",
+					action_names[action->type], argument, content);
+			}
+			goto cleanup;
+		}
+		/* Falls through to VirtualOutputRemove */
 	case ACTION_TYPE_VIRTUAL_OUTPUT_REMOVE:
 		if (!strcmp(argument, "output_name")) {
 			action_arg_add_str(action, argument, content);
 			goto cleanup;
 		}
+		if (!strcmp(argument, "count")) {
+			int count = atoi(content);
+			if (count > 0) {
+				action_arg_add_int(action, argument, count);
+			} else {
+				wlr_log(WLR_ERROR, "Invalid argument for action %s: '%s' (%s)",
+					action_names[action->type], argument, content);
+			}
+			goto cleanup;
+		}
 		break;
 	case ACTION_TYPE_AUTO_PLACE:
 		if (!strcmp(argument, "policy")) {
@@ -491,6 +596,32 @@ action_arg_from_xml_node(struct action *action, const char *nodename, const char
 			goto cleanup;
 		}
 		break;
+	case ACTION_TYPE_DEBUG:
+		if (!strcmp(argument, "format") || !strcmp(argument, "file")) {
+			action_arg_add_str(action, argument, content);
+			goto cleanup;
+		}
+		break;
+	case ACTION_TYPE_INPUT_REPLAY:
+		if (!strcmp(argument, "speed")) {
+			double speed;
+			if (set_double(content, &speed) && speed >= 0) {
+				/* Stored in permille of the recorded rate */
+				action_arg_add_int(action, argument,
+					(int)(speed * 1000 + 0.5));
+			} else {
+				wlr_log(WLR_ERROR, "Invalid argument for action %s: '%s' (%s)",
+					action_names[action->type], argument, content);
+			}
+			goto cleanup;
+		}
+		/* Falls through to InputRecord */
+	case ACTION_TYPE_INPUT_RECORD:
+		if (!strcmp(argument, "file")) {
+			action_arg_add_str(action, argument, content);
+			goto cleanup;
+		}
+		break;
 	}
 
 	wlr_log(WLR_ERROR, "Invalid argument for action %s: '%s'",
@@ -525,7 +656,7 @@ action_create(const char *action_name)
 		return NULL;
 	}
 
-	struct action *action = znew(*action);
+	struct action *action = lab_arena_new(&rc.arena, *action);
 	action->type = action_type;
 	wl_list_init(&action->args);
 	return action;
@@ -560,19 +691,150 @@ action_list_is_valid(struct wl_list *actions)
 static bool
 action_branches_are_valid(struct action *action)
 {
-	static const char * const branches[] = { "then", "else", "none" };
-	for (size_t i = 0; i < ARRAY_SIZE(branches); i++) {
+	for (size_t i = 0; i < ARRAY_SIZE(branch_names); i++) {
 		struct wl_list *children =
-			action_get_actionlist(action, branches[i]);
+			action_get_actionlist(action, branch_names[i]);
 		if (children && !action_list_is_valid(children)) {
 			wlr_log(WLR_ERROR, "Invalid action in %s '%s' branch",
-				action_names[action->type], branches[i]);
+				action_names[action->type], branch_names[i]);
 			return false;
 		}
 	}
 	return true;
 }
 
+static void
+action_params_free(struct action_params *params)
+{
+	if (!params) {
+		return;
+	}
+	g_strfreev(params->argv);
+	workspace_ref_finish(&params->workspace);
+	free(params);
+}
+
+static enum warp_target
+warp_target_parse(const char *to)
+{
+	if (!strcasecmp(to, "output")) {
+		return LAB_WARP_TARGET_OUTPUT;
+	} else if (!strcasecmp(to, "window")) {
+		return LAB_WARP_TARGET_WINDOW;
+	}
+	wlr_log(WLR_ERROR, "Invalid argument for action WarpCursor: 'to' (%s)", to);
+	return LAB_WARP_TARGET_INVALID;
+}
+
+static struct warp_coord
+warp_coord_parse(const char *value)
+{
+	if (!strcasecmp(value, "center")) {
+		return (struct warp_coord){ .center = true };
+	}
+	return (struct warp_coord){ .offset = atoi(value) };
+}
+
+/* Fills in action->params from the argument list */
+static void
+action_resolve(struct action *action)
+{
+	action_params_free(action->params);
+	struct action_params *params = znew(*params);
+	action->params = params;
+
+	switch (action->type) {
+	case ACTION_TYPE_EXECUTE: {
+		struct buf cmd = BUF_INIT;
+		buf_add(&cmd, action_get_str(action, "command", ""));
+		buf_expand_tilde(&cmd);
+		/* Split once here rather than on every execution */
+		GError *err = NULL;
+		if (!g_shell_parse_argv(cmd.data, NULL, &params->argv, &err)) {
+			wlr_log(WLR_ERROR, "invalid Execute command '%s': %s",
+				cmd.data, err->message);
+			g_error_free(err);
+			params->argv = NULL;
+		}
+		buf_reset(&cmd);
+		break;
+	}
+	case ACTION_TYPE_DEBUG:
+		params->json = !strcasecmp(
+			action_get_str(action, "format", "text"), "json");
+		params->file = action_get_str(action, "file", NULL);
+		break;
+	case ACTION_TYPE_SEND_TO_DESKTOP:
+		params->follow = action_get_bool(action, "follow", true);
+		/* Falls through to GoToDesktop */
+	case ACTION_TYPE_GO_TO_DESKTOP: {
+		params->wrap = action_get_bool(action, "wrap", true);
+		const char *to = action_get_str(action, "to", NULL);
+		if (to) {
+			workspace_ref_parse(&params->workspace, to);
+			params->has_workspace = true;
+		}
+		break;
+	}
+	case ACTION_TYPE_FOCUS_OUTPUT:
+	case ACTION_TYPE_MOVE_TO_OUTPUT:
+		params->output_name = action_get_str(action, "output", NULL);
+		params->direction = action_get_int(action, "direction",
+			VIEW_EDGE_INVALID);
+		params->wrap = action_get_bool(action, "wrap", false);
+		break;
+	case ACTION_TYPE_VIRTUAL_OUTPUT_ADD:
+		params->mode = (struct virtual_output_mode){
+			.width = action_get_int(action, "width", 1920),
+			.height = action_get_int(action, "height", 1080),
+			.refresh = action_get_int(action, "refresh", 0),
+		};
+		/* Falls through to VirtualOutputRemove */
+	case ACTION_TYPE_VIRTUAL_OUTPUT_REMOVE:
+		params->output_name = action_get_str(action, "output_name", NULL);
+		params->count = action_get_int(action, "count", 1);
+		break;
+	case ACTION_TYPE_AUTO_PLACE:
+		params->policy = action_get_int(action, "policy",
+			LAB_PLACE_AUTOMATIC);
+		break;
+	case ACTION_TYPE_WARP_CURSOR:
+		params->warp.to = warp_target_parse(
+			action_get_str(action, "to", "output"));
+		params->warp.x = warp_coord_parse(
+			action_get_str(action, "x", "center"));
+		params->warp.y = warp_coord_parse(
+			action_get_str(action, "y", "center"));
+		break;
+	case ACTION_TYPE_INPUT_REPLAY:
+		params->speed = action_get_int(action, "speed", 1000) / 1000.0;
+		/* Falls through to InputRecord */
+	case ACTION_TYPE_INPUT_RECORD:
+		params->file = action_get_str(action, "file", NULL);
+		break;
+	case ACTION_TYPE_IF:
+	case ACTION_TYPE_FOR_EACH:
+		params->queries = action_get_querylist(action, "query");
+		for (size_t i = 0; i < LAB_BRANCH_COUNT; i++) {
+			params->branches[i] =
+				action_get_actionlist(action, branch_names[i]);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/* Actions which did not go through action_is_valid() are resolved late */
+static struct action_params *
+action_get_params(struct action *action)
+{
+	if (!action->params) {
+		action_resolve(action);
+	}
+	return action->params;
+}
+
 /* Checks for *required* arguments */
 bool
 action_is_valid(struct action *action)
@@ -603,15 +865,25 @@ action_is_valid(struct action *action)
 	case ACTION_TYPE_SNAP_TO_REGION:
 		arg_name = "region";
 		break;
+	case ACTION_TYPE_INPUT_RECORD:
+	case ACTION_TYPE_INPUT_REPLAY:
+		arg_name = "file";
+		break;
 	case ACTION_TYPE_IF:
 	case ACTION_TYPE_FOR_EACH:
-		return action_branches_are_valid(action);
+		if (!action_branches_are_valid(action)) {
+			return false;
+		}
+		action_resolve(action);
+		return true;
 	default:
 		/* No arguments required */
+		action_resolve(action);
 		return true;
 	}
 
 	if (action_get_arg(action, arg_name, arg_type)) {
+		action_resolve(action);
 		return true;
 	}
 
@@ -629,15 +901,11 @@ action_is_show_menu(struct action *action)
 void
 action_free(struct action *action)
 {
-	/* Free args */
+	/* The action and its args live in rc.arena */
 	struct action_arg *arg, *arg_tmp;
 	wl_list_for_each_safe(arg, arg_tmp, &action->args, link) {
 		wl_list_remove(&arg->link);
-		zfree(arg->key);
-		if (arg->type == LAB_ACTION_ARG_STR) {
-			struct action_arg_str *str_arg = (struct action_arg_str *)arg;
-			zfree(str_arg->value);
-		} else if (arg->type == LAB_ACTION_ARG_ACTION_LIST) {
+		if (arg->type == LAB_ACTION_ARG_ACTION_LIST) {
 			struct action_arg_list *list_arg = (struct action_arg_list *)arg;
 			action_list_free(&list_arg->value);
 		} else if (arg->type == LAB_ACTION_ARG_QUERY_LIST) {
@@ -647,9 +915,9 @@ action_free(struct action *action)
 				view_query_free(elm);
 			}
 		}
-		zfree(arg);
 	}
-	zfree(action);
+	action_params_free(action->params);
+	action->params = NULL;
 }
 
 void
@@ -686,45 +954,40 @@ view_for_action(struct view *activator, struct server *server,
 }
 
 static bool
-run_if_action(struct view *view, struct server *server, struct action *action)
+run_if_action(struct view *view, struct server *server,
+		struct action_params *params)
 {
 	struct view_query *query;
-	struct wl_list *queries, *actions;
-	const char *branch = "then";
+	enum action_branch branch = LAB_BRANCH_THEN;
 
-	queries = action_get_querylist(action, "query");
-	if (queries) {
-		branch = "else";
+	if (params->queries) {
+		branch = LAB_BRANCH_ELSE;
 		/* All queries are OR'ed */
-		wl_list_for_each(query, queries, link) {
+		wl_list_for_each(query, params->queries, link) {
 			if (view_matches_query(view, query)) {
-				branch = "then";
+				branch = LAB_BRANCH_THEN;
 				break;
 			}
 		}
 	}
 
-	actions = action_get_actionlist(action, branch);
-	if (actions) {
-		actions_run(view, server, actions, NULL);
+	if (params->branches[branch]) {
+		actions_run(view, server, params->branches[branch], NULL);
 	}
-	return !strcmp(branch, "then");
+	return branch == LAB_BRANCH_THEN;
 }
 
 static struct output *
 get_target_output(struct output *output, struct server *server,
-	struct action *action)
+	struct action_params *params)
 {
-	const char *output_name = action_get_str(action, "output", NULL);
 	struct output *target = NULL;
 
-	if (output_name) {
-		target = output_from_name(server, output_name);
+	if (params->output_name) {
+		target = output_from_name(server, params->output_name);
 	} else {
-		enum view_edge edge =
-			action_get_int(action, "direction", VIEW_EDGE_INVALID);
-		bool wrap = action_get_bool(action, "wrap", false);
-		target = output_get_adjacent(output, edge, wrap);
+		target = output_get_adjacent(output, params->direction,
+			params->wrap);
 	}
 
 	if (!target) {
@@ -734,54 +997,52 @@ get_target_output(struct output *output, struct server *server,
 	return target;
 }
 
+static int
+warp_coord_resolve(struct warp_coord coord, int start, int size)
+{
+	if (coord.center) {
+		return start + size / 2;
+	}
+	return coord.offset >= 0 ? start + coord.offset
+		: start + size + coord.offset;
+}
+
 static void
-warp_cursor(struct view *view, struct output *output, const char *to, const char *x, const char *y)
+warp_cursor(struct server *server, struct view *view, struct output *output,
+		struct action_params *params)
 {
 	struct wlr_box target_area = {0};
-	int goto_x;
-	int goto_y;
 
-	if (!strcasecmp(to, "output") && output) {
+	if (params->warp.to == LAB_WARP_TARGET_OUTPUT && output) {
 		target_area = output_usable_area_in_layout_coords(output);
-	} else if (!strcasecmp(to, "window") && view) {
+	} else if (params->warp.to == LAB_WARP_TARGET_WINDOW && view) {
 		target_area = view->current;
-	} else {
-		wlr_log(WLR_ERROR, "Invalid argument for action WarpCursor: 'to' (%s)", to);
 	}
 
-	if (!strcasecmp(x, "center")) {
-		goto_x = target_area.x + target_area.width / 2;
-	} else {
-		int offset_x = atoi(x);
-		goto_x = offset_x >= 0 ?
-			target_area.x + offset_x :
-			target_area.x + target_area.width + offset_x;
-	}
+	int goto_x = warp_coord_resolve(params->warp.x, target_area.x,
+		target_area.width);
+	int goto_y = warp_coord_resolve(params->warp.y, target_area.y,
+		target_area.height);
 
-	if (!strcasecmp(y, "center")) {
-		goto_y = target_area.y + target_area.height / 2;
-	} else {
-		int offset_y = atoi(y);
-		goto_y = offset_y >= 0 ?
-			target_area.y + offset_y :
-			target_area.y + target_area.height + offset_y;
-	}
-
-	wlr_cursor_warp(output->server->seat.cursor, NULL, goto_x, goto_y);
-	cursor_update_focus(output->server);
+	wlr_cursor_warp(server->seat.cursor, NULL, goto_x, goto_y);
+	cursor_update_focus(server);
 }
 
+/* Views to be closed at the end of the ForEach action being run */
+static struct wl_array *deferred_close;
+
 void
 actions_run(struct view *activator, struct server *server,
 	struct wl_list *actions, struct cursor_context *cursor_ctx)
 {
+	TRACE_FUNC();
 	if (!actions) {
 		wlr_log(WLR_ERROR, "empty actions");
 		return;
 	}
 
 	/* This cancels any pending on-release keybinds */
-	keyboard_reset_current_keybind();
+	keyboard_reset_current_keybind(&server->seat);
 
 	struct view *view;
 	struct action *action;
@@ -792,6 +1053,9 @@ actions_run(struct view *activator, struct server *server,
 		ctx = *cursor_ctx;
 	}
 
+	/* Side effects of moving views are flushed once all actions ran */
+	transaction_begin(server);
+
 	wl_list_for_each(action, actions, link) {
 		if (server->input_mode == LAB_INPUT_STATE_WINDOW_SWITCHER
 				&& action->type != ACTION_TYPE_NEXT_WINDOW
@@ -806,38 +1070,48 @@ actions_run(struct view *activator, struct server *server,
 
 		/*
 		 * Refetch view because it may have been changed due to the
-		 * previous action
+		 * previous action. A workspace switch by the previous action
+		 * only updates the focus once settled, so do that first.
 		 */
+		workspaces_settle(server);
 		view = view_for_action(activator, server, action, &ctx);
 
+		struct action_params *params = action_get_params(action);
+		const char *name = action_names[action->type];
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
 		switch (action->type) {
 		case ACTION_TYPE_CLOSE:
-			if (view) {
+			if (view && deferred_close) {
+				/* Closed together once the ForEach is done */
+				struct view **item = wl_array_add(deferred_close,
+					sizeof(*item));
+				if (item) {
+					*item = view;
+				}
+			} else if (view) {
 				view_close(view);
 			}
 			break;
 		case ACTION_TYPE_KILL:
 			if (view) {
-				/* Send SIGTERM to the process associated with the surface */
-				assert(view->impl->get_pid);
-				pid_t pid = view->impl->get_pid(view);
-				if (pid == getpid()) {
-					wlr_log(WLR_ERROR, "Preventing sending SIGTERM to labwc");
-				} else if (pid > 0) {
-					kill(pid, SIGTERM);
-				}
+				view_kill(view);
 			}
 			break;
 		case ACTION_TYPE_DEBUG:
-			debug_dump_scene(server);
+			if (params->json) {
+				debug_dump_scene_json(server, params->file);
+			} else {
+				debug_dump_scene(server);
+			}
+			scanout_log_summary(server);
+			scaled_scene_buffer_log_stats();
+			buffer_pool_log_stats();
 			break;
 		case ACTION_TYPE_EXECUTE:
-			{
-				struct buf cmd = BUF_INIT;
-				buf_add(&cmd, action_get_str(action, "command", NULL));
-				buf_expand_tilde(&cmd);
-				spawn_async_no_shell(cmd.data);
-				buf_reset(&cmd);
+			if (params->argv) {
+				spawn_async_argv(params->argv);
 			}
 			break;
 		case ACTION_TYPE_EXIT:
@@ -975,21 +1249,23 @@ actions_run(struct view *activator, struct server *server,
 		case ACTION_TYPE_GO_TO_DESKTOP:
 			{
 				bool follow = true;
-				bool wrap = action_get_bool(action, "wrap", true);
-				const char *to = action_get_str(action, "to", NULL);
 				/*
-				 * `to` is always != NULL here because otherwise we would have
-				 * removed the action during the initial parsing step as it is
-				 * a required argument for both SendToDesktop and GoToDesktop.
+				 * `to` is always set for actions from the config
+				 * because it is a required argument for both
+				 * SendToDesktop and GoToDesktop.
 				 */
-				struct workspace *target = workspaces_find(
-					server->workspaces.current, to, wrap);
+				if (!params->has_workspace) {
+					break;
+				}
+				struct workspace *target = workspaces_find_ref(
+					server->workspaces.current,
+					&params->workspace, params->wrap);
 				if (!target) {
 					break;
 				}
 				if (action->type == ACTION_TYPE_SEND_TO_DESKTOP) {
 					view_move_to_workspace(view, target);
-					follow = action_get_bool(action, "follow", true);
+					follow = params->follow;
 
 					/* Ensure that the focus is not on another desktop */
 					if (!follow && server->active_view == view) {
@@ -1006,7 +1282,7 @@ actions_run(struct view *activator, struct server *server,
 			if (!view) {
 				break;
 			}
-			target = get_target_output(view->output, server, action);
+			target = get_target_output(view->output, server, params);
 			if (target) {
 				view_move_to_output(view, target);
 			}
@@ -1059,14 +1335,14 @@ actions_run(struct view *activator, struct server *server,
 			break;
 		case ACTION_TYPE_FOCUS_OUTPUT:
 			output = output_nearest_to_cursor(server);
-			target = get_target_output(output, server, action);
+			target = get_target_output(output, server, params);
 			if (target) {
 				desktop_focus_output(target);
 			}
 			break;
 		case ACTION_TYPE_IF:
 			if (view) {
-				run_if_action(view, server, action);
+				run_if_action(view, server, params);
 			}
 			break;
 		case ACTION_TYPE_FOR_EACH:
@@ -1075,41 +1351,52 @@ actions_run(struct view *activator, struct server *server,
 				struct view **item;
 				bool matches = false;
 				wl_array_init(&views);
-				view_array_append(server, &views, LAB_VIEW_CRITERIA_NONE);
+				/*
+				 * Without an else branch, views which don't match
+				 * have nothing to run, so only the views with the
+				 * queried identifiers need to be checked
+				 */
+				if (params->branches[LAB_BRANCH_ELSE]
+						|| !params->queries
+						|| !view_array_append_by_identifier(server,
+							&views, params->queries)) {
+					view_array_append(server, &views,
+						LAB_VIEW_CRITERIA_NONE);
+				}
+				struct wl_array closing;
+				wl_array_init(&closing);
+				struct wl_array *outer_close = deferred_close;
+				deferred_close = &closing;
+				transaction_begin(server);
 				wl_array_for_each(item, &views) {
-					matches |= run_if_action(*item, server, action);
+					matches |= run_if_action(*item, server, params);
 				}
+				transaction_commit(server);
+				deferred_close = outer_close;
+				if (closing.size) {
+					view_close_many(server, &closing,
+						/* kill_timeout_msec */ 0, NULL, NULL);
+				}
+				wl_array_release(&closing);
 				wl_array_release(&views);
-				if (!matches) {
-					struct wl_list *actions;
-					actions = action_get_actionlist(action, "none");
-					if (actions) {
-						actions_run(view, server, actions, NULL);
-					}
+				struct wl_list *none = params->branches[LAB_BRANCH_NONE];
+				if (!matches && none) {
+					actions_run(view, server, none, NULL);
 				}
 			}
 			break;
 		case ACTION_TYPE_VIRTUAL_OUTPUT_ADD:
-			{
-				const char *output_name = action_get_str(action, "output_name",
-						NULL);
-				output_virtual_add(server, output_name,
-					/*store_wlr_output*/ NULL);
-			}
+			output_virtual_add_many(server, params->output_name,
+				params->count, &params->mode);
 			break;
 		case ACTION_TYPE_VIRTUAL_OUTPUT_REMOVE:
-			{
-				const char *output_name = action_get_str(action, "output_name",
-						NULL);
-				output_virtual_remove(server, output_name);
-			}
+			output_virtual_remove_many(server, params->output_name,
+				params->count);
 			break;
 		case ACTION_TYPE_AUTO_PLACE:
 			if (view) {
-				enum view_placement_policy policy =
-					action_get_int(action, "policy", LAB_PLACE_AUTOMATIC);
 				view_place_by_policy(view,
-					/* allow_cursor */ true, policy);
+					/* allow_cursor */ true, params->policy);
 			}
 			break;
 		case ACTION_TYPE_TOGGLE_TEARING:
@@ -1161,18 +1448,31 @@ actions_run(struct view *activator, struct server *server,
 			magnifier_set_scale(server, MAGNIFY_DECREASE);
 			break;
 		case ACTION_TYPE_WARP_CURSOR:
-			{
-				const char *to = action_get_str(action, "to", "output");
-				const char *x = action_get_str(action, "x", "center");
-				const char *y = action_get_str(action, "y", "center");
-				struct output *output = output_nearest_to_cursor(server);
-
-				warp_cursor(view, output, to, x, y);
-			}
+			warp_cursor(server, view, output_nearest_to_cursor(server),
+				params);
 			break;
 		case ACTION_TYPE_HIDE_CURSOR:
 			cursor_set_visible(&server->seat, false);
 			break;
+		case ACTION_TYPE_DUMP_FRAME_TIMING:
+			output_timing_log_summary(server);
+			break;
+		case ACTION_TYPE_INPUT_RECORD:
+			input_record_toggle(params->file);
+			break;
+		case ACTION_TYPE_INPUT_REPLAY:
+			input_replay_start(&server->seat, params->file,
+				params->speed);
+			break;
+		case ACTION_TYPE_TOGGLE_FRAME_PACING:
+			hud_toggle(server, LAB_HUD_FRAME_PACING);
+			break;
+		case ACTION_TYPE_TOGGLE_PERF_HUD:
+			hud_toggle(server, LAB_HUD_PERF);
+			break;
+		case ACTION_TYPE_TOGGLE_OVERVIEW:
+			overview_toggle(server);
+			break;
 		case ACTION_TYPE_INVALID:
 			wlr_log(WLR_ERROR, "Not executing unknown action");
 			break;
@@ -1186,5 +1486,13 @@ actions_run(struct view *activator, struct server *server,
 				"Not executing invalid action (%u)"
 				" This is a BUG. Please report.", action->type);
 		}
+
+		struct timespec end;
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		metrics_action_executed(name,
+			(uint64_t)(end.tv_sec - start.tv_sec) * 1000000000
+			+ end.tv_nsec - start.tv_nsec);
 	}
+
+	transaction_commit(server);
 }
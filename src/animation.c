@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * animation.c: frame-clock driven scene transitions
+ *
+ * Animations are stepped from the frame handler of the outputs rather
+ * than from timers, so each step is shown on the next vblank. The time
+ * of an animation starts at its first frame, so that a slow first frame
+ * does not skip the start. With several outputs, every frame computes
+ * the progress from the same clock, so they don't speed it up.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <time.h>
+#include "animation.h"
+#include "common/macros.h"
+#include "labwc.h"
+
+static int64_t
+now_msec(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Cubic ease-out, fast at first and settling gently */
+static double
+ease(double t)
+{
+	double rest = 1.0 - t;
+	return 1.0 - rest * rest * rest;
+}
+
+static void
+schedule_frames(struct server *server)
+{
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output_is_usable(output)) {
+			wlr_output_schedule_frame(output->wlr_output);
+		}
+	}
+}
+
+void
+animation_init(struct lab_animation *animation,
+		const struct lab_animation_impl *impl)
+{
+	assert(impl && impl->step);
+	*animation = (struct lab_animation){ .impl = impl };
+	wl_list_init(&animation->link);
+}
+
+void
+animation_start(struct server *server, struct lab_animation *animation,
+		int duration_msec)
+{
+	assert(animation->impl);
+	wl_list_remove(&animation->link);
+	animation->duration_msec = MAX(duration_msec, 0);
+	animation->start_msec = 0;
+	wl_list_insert(server->animations.prev, &animation->link);
+	schedule_frames(server);
+}
+
+bool
+animation_is_running(struct lab_animation *animation)
+{
+	return !wl_list_empty(&animation->link);
+}
+
+static void
+complete(struct lab_animation *animation)
+{
+	wl_list_remove(&animation->link);
+	wl_list_init(&animation->link);
+	animation->impl->step(animation, 1.0);
+	if (animation->impl->finish) {
+		animation->impl->finish(animation);
+	}
+}
+
+void
+animation_finish(struct lab_animation *animation)
+{
+	if (animation_is_running(animation)) {
+		complete(animation);
+	}
+}
+
+void
+animations_output_frame(struct server *server)
+{
+	if (wl_list_empty(&server->animations)) {
+		return;
+	}
+
+	/*
+	 * Take the running animations one by one from a private list, so
+	 * that handlers can finish or start any animation. Those started by
+	 * a handler begin with the next frame.
+	 */
+	struct wl_list running;
+	wl_list_init(&running);
+	wl_list_insert_list(&running, &server->animations);
+	wl_list_init(&server->animations);
+
+	int64_t now = now_msec();
+	while (!wl_list_empty(&running)) {
+		struct lab_animation *animation =
+			wl_container_of(running.next, animation, link);
+		if (!animation->start_msec) {
+			animation->start_msec = now;
+		}
+		int64_t elapsed = now - animation->start_msec;
+		if (elapsed >= animation->duration_msec) {
+			complete(animation);
+			continue;
+		}
+		wl_list_remove(&animation->link);
+		wl_list_insert(server->animations.prev, &animation->link);
+		animation->impl->step(animation,
+			ease((double)elapsed / animation->duration_msec));
+	}
+
+	if (!wl_list_empty(&server->animations)) {
+		schedule_frames(server);
+	}
+}
+
+void
+animations_finish_all(struct server *server)
+{
+	while (!wl_list_empty(&server->animations)) {
+		struct lab_animation *animation = wl_container_of(
+			server->animations.next, animation, link);
+		complete(animation);
+	}
+}
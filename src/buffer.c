@@ -25,14 +25,100 @@
  */
 
 #include <assert.h>
+#include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
 #include <drm_fourcc.h>
+#include <wayland-util.h>
 #include <wlr/interfaces/wlr_buffer.h>
+#include <wlr/util/log.h>
 #include "buffer.h"
 #include "common/mem.h"
 
+/*
+ * Pixel storage of buffers created by buffer_create_cairo() is recycled
+ * through a pool with four size classes per power of two, from 4 KiB up
+ * to 64 MiB. Larger buffers are not pooled. The pool holds at most
+ * BUFFER_POOL_MAX_BYTES, anything beyond is freed right away.
+ */
+#define BUFFER_POOL_MIN_SHIFT 12
+#define BUFFER_POOL_MAX_SHIFT 26
+#define BUFFER_POOL_CLASSES \
+	(1 + 4 * (BUFFER_POOL_MAX_SHIFT - BUFFER_POOL_MIN_SHIFT))
+#define BUFFER_POOL_MAX_BYTES (8 << 20)
+
+static struct {
+	struct wl_array free[BUFFER_POOL_CLASSES]; /* void * */
+	size_t pooled_bytes;
+	uint64_t allocs;
+	uint64_t reuses;
+	uint64_t trims;
+} pool;
+
 static const struct wlr_buffer_impl data_buffer_impl;
 
+/*
+ * Returns the size class of @size and stores the size of blocks of that
+ * class in @class_size. Returns -1 if @size is too large to be pooled.
+ */
+static int
+pool_size_class(size_t size, size_t *class_size)
+{
+	if (size <= (1u << BUFFER_POOL_MIN_SHIFT)) {
+		*class_size = 1u << BUFFER_POOL_MIN_SHIFT;
+		return 0;
+	}
+	/* 2^shift < size <= 2^(shift + 1) */
+	int shift = 63 - __builtin_clzll((unsigned long long)size - 1);
+	if (shift >= BUFFER_POOL_MAX_SHIFT) {
+		*class_size = size;
+		return -1;
+	}
+	size_t base = (size_t)1 << shift;
+	size_t step = base / 4;
+	size_t quarters = (size - base + step - 1) / step; /* 1 to 4 */
+	*class_size = base + quarters * step;
+	return 4 * (shift - BUFFER_POOL_MIN_SHIFT) + (int)quarters;
+}
+
+/* Returns zeroed storage of at least @size bytes */
+static void *
+pool_alloc(size_t size)
+{
+	size_t class_size;
+	int class = pool_size_class(size, &class_size);
+	void **blocks = class >= 0 ? pool.free[class].data : NULL;
+	size_t nr = class >= 0 ? pool.free[class].size / sizeof(void *) : 0;
+	if (!nr) {
+		pool.allocs++;
+		return xzalloc(class_size);
+	}
+	void *data = blocks[nr - 1];
+	pool.free[class].size -= sizeof(void *);
+	pool.pooled_bytes -= class_size;
+	pool.reuses++;
+	memset(data, 0, size);
+	return data;
+}
+
+static void
+pool_release(void *data, size_t size)
+{
+	size_t class_size;
+	int class = pool_size_class(size, &class_size);
+	if (class < 0 || pool.pooled_bytes + class_size > BUFFER_POOL_MAX_BYTES) {
+		free(data);
+		return;
+	}
+	void **slot = wl_array_add(&pool.free[class], sizeof(*slot));
+	if (!slot) {
+		free(data);
+		return;
+	}
+	*slot = data;
+	pool.pooled_bytes += class_size;
+}
+
 static struct lab_data_buffer *
 data_buffer_from_buffer(struct wlr_buffer *buffer)
 {
@@ -46,7 +132,9 @@ data_buffer_destroy(struct wlr_buffer *wlr_buffer)
 	struct lab_data_buffer *buffer = data_buffer_from_buffer(wlr_buffer);
 	/* this also frees buffer->data if surface_owns_data == true */
 	cairo_surface_destroy(buffer->surface);
-	if (!buffer->surface_owns_data) {
+	if (buffer->pooled) {
+		pool_release(buffer->data, buffer->stride * wlr_buffer->height);
+	} else if (!buffer->surface_owns_data) {
 		free(buffer->data);
 	}
 	wlr_buffer_finish(wlr_buffer);
@@ -105,10 +193,19 @@ struct lab_data_buffer *
 buffer_create_cairo(uint32_t logical_width, uint32_t logical_height, float scale)
 {
 	/* Create an image surface with the scaled size */
-	cairo_surface_t *surface =
-		cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
-			lroundf(logical_width * scale),
-			lroundf(logical_height * scale));
+	int width = lroundf(logical_width * scale);
+	int height = lroundf(logical_height * scale);
+	int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+	void *data = NULL;
+	cairo_surface_t *surface;
+	if (width > 0 && height > 0 && stride > 0) {
+		data = pool_alloc((size_t)stride * height);
+		surface = cairo_image_surface_create_for_data(data,
+			CAIRO_FORMAT_ARGB32, width, height, stride);
+	} else {
+		surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+			width, height);
+	}
 
 	/**
 	 * Tell cairo about the device scale so we can keep drawing in unscaled
@@ -126,6 +223,10 @@ buffer_create_cairo(uint32_t logical_width, uint32_t logical_height, float scale
 	struct lab_data_buffer *buffer = buffer_adopt_cairo_surface(surface);
 	buffer->logical_width = logical_width;
 	buffer->logical_height = logical_height;
+	if (data) {
+		buffer->surface_owns_data = false;
+		buffer->pooled = true;
+	}
 
 	return buffer;
 }
@@ -146,3 +247,26 @@ buffer_create_from_data(void *pixel_data, uint32_t width, uint32_t height,
 	buffer->surface_owns_data = false;
 	return buffer;
 }
+
+void
+buffer_pool_trim(void)
+{
+	for (size_t i = 0; i < BUFFER_POOL_CLASSES; i++) {
+		void **block;
+		wl_array_for_each(block, &pool.free[i]) {
+			free(*block);
+			pool.trims++;
+		}
+		wl_array_release(&pool.free[i]);
+		wl_array_init(&pool.free[i]);
+	}
+	pool.pooled_bytes = 0;
+}
+
+void
+buffer_pool_log_stats(void)
+{
+	wlr_log(WLR_INFO, "buffer pool: %zu KiB pooled, %" PRIu64 " allocations, "
+		"%" PRIu64 " reuses, %" PRIu64 " trimmed", pool.pooled_bytes >> 10,
+		pool.allocs, pool.reuses, pool.trims);
+}
@@ -0,0 +1,395 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * capture.c: committed output buffers handed to a recorder as dmabufs
+ *
+ * The socket is opt-in with <core><captureSocket>, see capture.h for the
+ * wire format. The buffers are the ones the outputs show, so recording
+ * costs neither a composition pass nor a readback. The consumer paces
+ * itself: a buffer stays locked until it is released, and commits in the
+ * meantime only add to the damage carried by the next frame, so a slow
+ * consumer never delays the outputs.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <pixman.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <wlr/render/dmabuf.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+#include "capture.h"
+#include "common/buf.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/string-helpers.h"
+#include "config/rcxml.h"
+#include "labwc.h"
+
+struct capture_output {
+	/* Buffer sent to the consumer and not released yet */
+	struct wlr_buffer *held;
+	uint32_t serial;
+	/* Damage of the commits since the last frame sent */
+	pixman_region32_t damage;
+};
+
+static struct {
+	/* Value of <core><captureSocket> and the path it expanded to */
+	char *configured;
+	char *path;
+	int fd;
+	struct wl_event_source *source;
+
+	int client_fd;
+	struct wl_event_source *client_source;
+
+	struct server *server;
+	uint32_t next_serial;
+} capture = {
+	.fd = -1,
+	.client_fd = -1,
+};
+
+static int64_t
+now_nsec(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void
+release_held(struct capture_output *capture_output)
+{
+	if (capture_output->held) {
+		wlr_buffer_unlock(capture_output->held);
+		capture_output->held = NULL;
+	}
+}
+
+static void
+client_close(void)
+{
+	if (capture.client_fd < 0) {
+		return;
+	}
+	wl_event_source_remove(capture.client_source);
+	capture.client_source = NULL;
+	close(capture.client_fd);
+	capture.client_fd = -1;
+
+	struct output *output;
+	wl_list_for_each(output, &capture.server->outputs, link) {
+		if (output->capture) {
+			release_held(output->capture);
+			pixman_region32_clear(&output->capture->damage);
+		}
+	}
+}
+
+static void
+release_serial(uint32_t serial)
+{
+	struct output *output;
+	wl_list_for_each(output, &capture.server->outputs, link) {
+		if (output->capture && output->capture->held
+				&& output->capture->serial == serial) {
+			release_held(output->capture);
+			return;
+		}
+	}
+}
+
+static int
+handle_client_readable(int fd, uint32_t mask, void *data)
+{
+	uint32_t serials[16];
+	for (;;) {
+		ssize_t len = read(fd, serials, sizeof(serials));
+		if (len < 0 && errno == EINTR) {
+			continue;
+		}
+		if (len < 0 && errno == EAGAIN) {
+			return 0;
+		}
+		if (len <= 0) {
+			wlr_log(WLR_INFO, "capture consumer disconnected");
+			client_close();
+			return 0;
+		}
+		/* A partial serial is a protocol error, treat it as such */
+		if (len % sizeof(serials[0])) {
+			wlr_log(WLR_ERROR, "capture consumer sent garbage");
+			client_close();
+			return 0;
+		}
+		for (size_t i = 0; i < len / sizeof(serials[0]); i++) {
+			release_serial(serials[i]);
+		}
+	}
+}
+
+static int
+handle_connection(int fd, uint32_t mask, void *data)
+{
+	struct server *server = data;
+	int client_fd = accept4(fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (client_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot accept capture connection");
+		return 0;
+	}
+	client_close();
+	capture.client_fd = client_fd;
+	capture.client_source = wl_event_loop_add_fd(server->wl_event_loop,
+		client_fd, WL_EVENT_READABLE, handle_client_readable, NULL);
+	wlr_log(WLR_INFO, "capture consumer connected");
+	return 0;
+}
+
+static struct capture_output *
+get_capture_output(struct output *output)
+{
+	if (!output->capture) {
+		output->capture = znew(*output->capture);
+		pixman_region32_init(&output->capture->damage);
+	}
+	return output->capture;
+}
+
+/* Returns false if the consumer is gone or could not take the frame */
+static bool
+send_frame(struct output *output, struct wlr_buffer *buffer,
+		struct wlr_dmabuf_attributes *attribs, uint32_t serial)
+{
+	struct capture_output *capture_output = output->capture;
+	struct lab_capture_frame frame = {
+		.version = LAB_CAPTURE_VERSION,
+		.serial = serial,
+		.commit_nsec = now_nsec(),
+		.width = buffer->width,
+		.height = buffer->height,
+		.format = attribs->format,
+		.n_planes = attribs->n_planes,
+		.modifier = attribs->modifier,
+	};
+	snprintf(frame.output, sizeof(frame.output), "%s",
+		output->wlr_output->name);
+	for (int i = 0; i < attribs->n_planes; i++) {
+		frame.offset[i] = attribs->offset[i];
+		frame.stride[i] = attribs->stride[i];
+	}
+
+	int nr_boxes;
+	pixman_box32_t *boxes = pixman_region32_rectangles(
+		&capture_output->damage, &nr_boxes);
+	if (nr_boxes > LAB_CAPTURE_MAX_RECTS) {
+		boxes = pixman_region32_extents(&capture_output->damage);
+		nr_boxes = 1;
+	}
+	struct lab_capture_rect rects[LAB_CAPTURE_MAX_RECTS];
+	for (int i = 0; i < nr_boxes; i++) {
+		rects[i] = (struct lab_capture_rect){
+			.x = boxes[i].x1,
+			.y = boxes[i].y1,
+			.width = boxes[i].x2 - boxes[i].x1,
+			.height = boxes[i].y2 - boxes[i].y1,
+		};
+	}
+	frame.n_rects = nr_boxes;
+
+	struct iovec iov[] = {
+		{ .iov_base = &frame, .iov_len = sizeof(frame) },
+		{ .iov_base = rects, .iov_len = nr_boxes * sizeof(rects[0]) },
+	};
+	char control[CMSG_SPACE(sizeof(int) * LAB_CAPTURE_MAX_PLANES)] = {0};
+	struct msghdr msg = {
+		.msg_iov = iov,
+		.msg_iovlen = ARRAY_SIZE(iov),
+		.msg_control = control,
+		.msg_controllen = CMSG_SPACE(sizeof(int) * attribs->n_planes),
+	};
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * attribs->n_planes);
+	memcpy(CMSG_DATA(cmsg), attribs->fd, sizeof(int) * attribs->n_planes);
+
+	ssize_t ret;
+	do {
+		ret = sendmsg(capture.client_fd, &msg,
+			MSG_DONTWAIT | MSG_NOSIGNAL);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0 && errno == EAGAIN) {
+		/* Socket buffer full, the damage goes with the next frame */
+		return false;
+	}
+	if (ret < 0) {
+		wlr_log_errno(WLR_INFO, "capture consumer lost");
+		client_close();
+		return false;
+	}
+	if ((size_t)ret < iov[0].iov_len + iov[1].iov_len) {
+		/* The rest of the frame can't be sent without blocking */
+		wlr_log(WLR_INFO, "capture consumer too slow, disconnecting");
+		client_close();
+		return false;
+	}
+	return true;
+}
+
+void
+capture_output_commit(struct output *output, struct wlr_output_state *state)
+{
+	if (capture.client_fd < 0 || !state->buffer) {
+		return;
+	}
+	struct wlr_buffer *buffer = state->buffer;
+	struct capture_output *capture_output = get_capture_output(output);
+
+	if (state->committed & WLR_OUTPUT_STATE_DAMAGE) {
+		pixman_region32_union(&capture_output->damage,
+			&capture_output->damage, &state->damage);
+	} else {
+		pixman_region32_union_rect(&capture_output->damage,
+			&capture_output->damage, 0, 0,
+			buffer->width, buffer->height);
+	}
+	pixman_region32_intersect_rect(&capture_output->damage,
+		&capture_output->damage, 0, 0, buffer->width, buffer->height);
+
+	if (capture_output->held) {
+		/* The consumer is behind, it gets a later frame */
+		return;
+	}
+
+	struct wlr_dmabuf_attributes attribs;
+	if (!wlr_buffer_get_dmabuf(buffer, &attribs)
+			|| attribs.n_planes > LAB_CAPTURE_MAX_PLANES) {
+		wlr_log(WLR_DEBUG, "cannot export buffer of %s for capture",
+			output->wlr_output->name);
+		return;
+	}
+
+	uint32_t serial = ++capture.next_serial;
+	if (send_frame(output, buffer, &attribs, serial)) {
+		capture_output->held = wlr_buffer_lock(buffer);
+		capture_output->serial = serial;
+		pixman_region32_clear(&capture_output->damage);
+	}
+}
+
+void
+capture_output_destroy(struct output *output)
+{
+	struct capture_output *capture_output = output->capture;
+	if (!capture_output) {
+		return;
+	}
+	release_held(capture_output);
+	pixman_region32_fini(&capture_output->damage);
+	free(capture_output);
+	output->capture = NULL;
+}
+
+static void
+capture_close(void)
+{
+	client_close();
+	if (capture.source) {
+		wl_event_source_remove(capture.source);
+		capture.source = NULL;
+	}
+	if (capture.fd >= 0) {
+		close(capture.fd);
+		capture.fd = -1;
+		unlink(capture.path);
+	}
+	zfree(capture.configured);
+	zfree(capture.path);
+}
+
+/* Only remove a stale socket, never some other file at the same path */
+static void
+unlink_stale_socket(const char *path)
+{
+	struct stat st;
+	if (!lstat(path, &st) && S_ISSOCK(st.st_mode)) {
+		unlink(path);
+	}
+}
+
+static void
+capture_open(struct server *server, const char *configured)
+{
+	struct buf path = BUF_INIT;
+	buf_add(&path, configured);
+	buf_expand_tilde(&path);
+	buf_expand_shell_variables(&path);
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if (path.len >= sizeof(addr.sun_path)) {
+		wlr_log(WLR_ERROR, "capture socket path too long: %s", path.data);
+		goto out;
+	}
+	strcpy(addr.sun_path, path.data);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot create capture socket");
+		goto out;
+	}
+	unlink_stale_socket(path.data);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+			|| listen(fd, 1) < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot listen on %s", path.data);
+		close(fd);
+		goto out;
+	}
+
+	capture.fd = fd;
+	capture.configured = xstrdup(configured);
+	capture.path = xstrdup(path.data);
+	capture.source = wl_event_loop_add_fd(server->wl_event_loop, fd,
+		WL_EVENT_READABLE, handle_connection, server);
+	wlr_log(WLR_INFO, "serving output capture on %s", capture.path);
+out:
+	buf_reset(&path);
+}
+
+void
+capture_init(struct server *server)
+{
+	capture.server = server;
+	if (!string_null_or_empty(rc.capture_socket)) {
+		capture_open(server, rc.capture_socket);
+	}
+}
+
+void
+capture_reconfigure(struct server *server)
+{
+	/* Keep the socket, and the consumer connected to it, if unchanged */
+	if (capture.configured && rc.capture_socket
+			&& !strcmp(capture.configured, rc.capture_socket)) {
+		return;
+	}
+	capture_close();
+	capture_init(server);
+}
+
+void
+capture_finish(struct server *server)
+{
+	capture_close();
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		capture_output_destroy(output);
+	}
+}
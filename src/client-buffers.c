@@ -0,0 +1,219 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * client-buffers.c: buffer memory committed by each client
+ *
+ * Every surface of the compositor is followed, so subsurfaces, popups and
+ * cursors count as well as toplevels and layer surfaces. The accounting
+ * lives in the destroy listener of each client and is dropped when the
+ * client disconnects; surfaces outliving their client's record, which
+ * wl_client_destroy() drops first, are simply no longer accounted.
+ *
+ * The size is estimated from the dimensions of the buffer, as the memory
+ * behind a dmabuf cannot be known exactly.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/log.h>
+#include "client-buffers.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "config.h"
+#include "config/rcxml.h"
+#include "labwc.h"
+
+#if HAVE_XWAYLAND
+#include <wlr/xwayland.h>
+#endif
+
+#define BYTES_PER_PIXEL 4
+
+struct client_usage {
+	struct wl_client *client;
+	struct client_buffer_usage usage;
+	bool over_limit;
+	struct wl_list surfaces; /* struct surface_usage.link */
+	struct wl_list link; /* clients */
+	struct wl_listener destroy;
+};
+
+struct surface_usage {
+	struct wlr_surface *surface;
+	struct client_usage *client; /* NULL once the client is gone */
+	size_t bytes;
+	struct wl_list link;
+	struct wl_listener commit;
+	struct wl_listener destroy;
+};
+
+static struct {
+	struct server *server;
+	struct wl_list clients; /* struct client_usage.link */
+	struct wl_listener new_surface;
+} buffers = {
+	.clients = WL_LIST_INIT(&buffers.clients),
+};
+
+static void
+handle_client_destroy(struct wl_listener *listener, void *data)
+{
+	struct client_usage *client =
+		wl_container_of(listener, client, destroy);
+	struct surface_usage *surface, *tmp;
+	wl_list_for_each_safe(surface, tmp, &client->surfaces, link) {
+		surface->client = NULL;
+		wl_list_remove(&surface->link);
+		wl_list_init(&surface->link);
+	}
+	wl_list_remove(&client->link);
+	wl_list_remove(&client->destroy.link);
+	free(client);
+}
+
+static struct client_usage *
+get_client_usage(struct wl_client *wl_client)
+{
+	/* The destroy listener doubles as per-client storage */
+	struct wl_listener *listener =
+		wl_client_get_destroy_listener(wl_client, handle_client_destroy);
+	if (listener) {
+		struct client_usage *client =
+			wl_container_of(listener, client, destroy);
+		return client;
+	}
+
+	struct client_usage *client = znew(*client);
+	client->client = wl_client;
+	wl_client_get_credentials(wl_client, &client->usage.pid, NULL, NULL);
+	wl_list_init(&client->surfaces);
+	wl_list_insert(&buffers.clients, &client->link);
+	client->destroy.notify = handle_client_destroy;
+	wl_client_add_destroy_listener(wl_client, &client->destroy);
+	return client;
+}
+
+static bool
+is_xwayland(struct wl_client *wl_client)
+{
+#if HAVE_XWAYLAND
+	struct wlr_xwayland *xwayland = buffers.server->xwayland;
+	return xwayland && xwayland->server
+		&& xwayland->server->client == wl_client;
+#else
+	return false;
+#endif
+}
+
+static void
+check_limit(struct client_usage *client)
+{
+	size_t limit = (size_t)rc.client_buffer_limit * 1024 * 1024;
+	if (!limit || client->usage.bytes <= limit) {
+		client->over_limit = false;
+		return;
+	}
+	if (client->over_limit) {
+		return;
+	}
+	client->over_limit = true;
+
+	wlr_log(WLR_ERROR, "client pid %d committed %zu MiB of buffers, "
+		"above the limit of %d MiB", (int)client->usage.pid,
+		client->usage.bytes / (1024 * 1024), rc.client_buffer_limit);
+
+	/* Xwayland serves all X11 clients, it is never disconnected */
+	if (rc.client_buffer_limit_action == LAB_CLIENT_LIMIT_DISCONNECT
+			&& !is_xwayland(client->client)) {
+		/* The client is destroyed once its requests are dispatched */
+		wl_client_post_implementation_error(client->client,
+			"buffer memory limit of %d MiB exceeded",
+			rc.client_buffer_limit);
+	}
+}
+
+static void
+handle_commit(struct wl_listener *listener, void *data)
+{
+	struct surface_usage *surface =
+		wl_container_of(listener, surface, commit);
+	struct wlr_surface *wlr_surface = surface->surface;
+	if (!surface->client) {
+		return;
+	}
+
+	struct wlr_buffer *buffer = wlr_surface->buffer
+		? &wlr_surface->buffer->base : NULL;
+	size_t bytes = buffer
+		? (size_t)buffer->width * buffer->height * BYTES_PER_PIXEL : 0;
+	if (bytes == surface->bytes) {
+		return;
+	}
+
+	struct client_buffer_usage *usage = &surface->client->usage;
+	usage->bytes = usage->bytes - surface->bytes + bytes;
+	usage->peak_bytes = MAX(usage->peak_bytes, usage->bytes);
+	surface->bytes = bytes;
+	check_limit(surface->client);
+}
+
+static void
+handle_surface_destroy(struct wl_listener *listener, void *data)
+{
+	struct surface_usage *surface =
+		wl_container_of(listener, surface, destroy);
+	if (surface->client) {
+		surface->client->usage.bytes -= surface->bytes;
+		surface->client->usage.surfaces--;
+		check_limit(surface->client);
+	}
+	wl_list_remove(&surface->link);
+	wl_list_remove(&surface->commit.link);
+	wl_list_remove(&surface->destroy.link);
+	free(surface);
+}
+
+static void
+handle_new_surface(struct wl_listener *listener, void *data)
+{
+	struct wlr_surface *wlr_surface = data;
+	struct client_usage *client =
+		get_client_usage(wl_resource_get_client(wlr_surface->resource));
+
+	struct surface_usage *surface = znew(*surface);
+	surface->surface = wlr_surface;
+	surface->client = client;
+	wl_list_insert(&client->surfaces, &surface->link);
+	client->usage.surfaces++;
+
+	surface->commit.notify = handle_commit;
+	wl_signal_add(&wlr_surface->events.commit, &surface->commit);
+	surface->destroy.notify = handle_surface_destroy;
+	wl_signal_add(&wlr_surface->events.destroy, &surface->destroy);
+}
+
+void
+client_buffers_init(struct server *server, struct wlr_compositor *compositor)
+{
+	buffers.server = server;
+	buffers.new_surface.notify = handle_new_surface;
+	wl_signal_add(&compositor->events.new_surface, &buffers.new_surface);
+}
+
+void
+client_buffers_finish(void)
+{
+	wl_list_remove(&buffers.new_surface.link);
+}
+
+void
+client_buffers_for_each(
+		void (*func)(const struct client_buffer_usage *usage, void *data),
+		void *data)
+{
+	struct client_usage *client;
+	wl_list_for_each(client, &buffers.clients, link) {
+		func(&client->usage, data);
+	}
+}
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <string.h>
+#include "common/arena.h"
+#include "common/macros.h"
+#include "common/mem.h"
+
+/* The first chunk, later ones double in size up to the maximum */
+#define ARENA_CHUNK_MIN (4 * 1024)
+#define ARENA_CHUNK_MAX (256 * 1024)
+
+struct lab_arena_chunk {
+	struct lab_arena_chunk *next;
+	size_t size;
+	alignas(max_align_t) unsigned char data[];
+};
+
+static size_t
+align_up(size_t size)
+{
+	return (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+}
+
+void *
+lab_arena_alloc(struct lab_arena *arena, size_t size)
+{
+	assert(arena);
+	size = align_up(MAX(size, (size_t)1));
+
+	struct lab_arena_chunk *chunk = arena->chunks;
+	if (!chunk || chunk->size - arena->used < size) {
+		size_t chunk_size = chunk
+			? MIN(chunk->size * 2, (size_t)ARENA_CHUNK_MAX)
+			: ARENA_CHUNK_MIN;
+		chunk_size = MAX(chunk_size, size);
+		chunk = xzalloc(sizeof(*chunk) + chunk_size);
+		chunk->size = chunk_size;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+		arena->used = 0;
+		arena->bytes += chunk_size;
+	}
+
+	/* Chunks are zeroed when allocated and never reused */
+	void *ptr = chunk->data + arena->used;
+	arena->used += size;
+	return ptr;
+}
+
+char *
+lab_arena_strdup(struct lab_arena *arena, const char *str)
+{
+	assert(str);
+	size_t len = strlen(str);
+	char *copy = lab_arena_alloc(arena, len + 1);
+	memcpy(copy, str, len);
+	return copy;
+}
+
+void
+lab_arena_release(struct lab_arena *arena)
+{
+	struct lab_arena_chunk *chunk = arena->chunks;
+	while (chunk) {
+		struct lab_arena_chunk *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	*arena = (struct lab_arena){0};
+}
@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <ctype.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "common/bitset.h"
+#include "common/macros.h"
+
+bool
+lab_bitset_contains(const struct lab_bitset *set, uint32_t value)
+{
+	if (value >= LAB_BITSET_MAX_BITS) {
+		return false;
+	}
+	return set->words[value / 64] & (1ull << (value % 64));
+}
+
+void
+lab_bitset_add(struct lab_bitset *set, uint32_t value)
+{
+	if (value >= LAB_BITSET_MAX_BITS) {
+		return;
+	}
+	set->words[value / 64] |= 1ull << (value % 64);
+}
+
+void
+lab_bitset_remove(struct lab_bitset *set, uint32_t value)
+{
+	if (value >= LAB_BITSET_MAX_BITS) {
+		return;
+	}
+	set->words[value / 64] &= ~(1ull << (value % 64));
+}
+
+int
+lab_bitset_count(const struct lab_bitset *set)
+{
+	int count = 0;
+	for (size_t i = 0; i < ARRAY_SIZE(set->words); i++) {
+		count += __builtin_popcountll(set->words[i]);
+	}
+	return count;
+}
+
+static bool
+parse_value(const char **p, uint32_t *value)
+{
+	while (isspace((unsigned char)**p)) {
+		(*p)++;
+	}
+	if (!isdigit((unsigned char)**p)) {
+		return false;
+	}
+	char *end;
+	unsigned long n = strtoul(*p, &end, 10);
+	if (n >= LAB_BITSET_MAX_BITS) {
+		return false;
+	}
+	*p = end;
+	while (isspace((unsigned char)**p)) {
+		(*p)++;
+	}
+	*value = n;
+	return true;
+}
+
+bool
+lab_bitset_parse_list(struct lab_bitset *set, const char *list)
+{
+	struct lab_bitset parsed = {0};
+	const char *p = list;
+	for (;;) {
+		uint32_t first, last;
+		if (!parse_value(&p, &first)) {
+			return false;
+		}
+		last = first;
+		if (*p == '-') {
+			p++;
+			if (!parse_value(&p, &last) || last < first) {
+				return false;
+			}
+		}
+		for (uint32_t value = first; value <= last; value++) {
+			lab_bitset_add(&parsed, value);
+		}
+		if (*p == '\0') {
+			break;
+		}
+		if (*p++ != ',') {
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(set->words); i++) {
+		set->words[i] |= parsed.words[i];
+	}
+	return true;
+}
+
+int
+lab_bitset_next(const struct lab_bitset *set, uint32_t value)
+{
+	if (value >= LAB_BITSET_MAX_BITS) {
+		return -1;
+	}
+	size_t i = value / 64;
+	/* Mask off the bits below @value in the first word */
+	uint64_t word = set->words[i] & (~0ull << (value % 64));
+	for (;;) {
+		if (word) {
+			return (int)(i * 64) + __builtin_ctzll(word);
+		}
+		if (++i == ARRAY_SIZE(set->words)) {
+			return -1;
+		}
+		word = set->words[i];
+	}
+}
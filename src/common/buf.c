@@ -14,7 +14,7 @@ void
 buf_expand_tilde(struct buf *s)
 {
 	struct buf new = BUF_INIT;
-	for (int i = 0 ; i < s->len ; i++) {
+	for (size_t i = 0 ; i < s->len ; i++) {
 		if (s->data[i] == '~') {
 			buf_add(&new, getenv("HOME"));
 		} else {
@@ -48,7 +48,7 @@ buf_expand_shell_variables(struct buf *s)
 	struct buf new = BUF_INIT;
 	struct buf environment_variable = BUF_INIT;
 
-	for (int i = 0 ; i < s->len ; i++) {
+	for (size_t i = 0 ; i < s->len ; i++) {
 		if (s->data[i] == '$' && isvalid(s->data[i+1])) {
 			/* expand environment variable */
 			buf_clear(&environment_variable);
@@ -73,7 +73,7 @@ buf_expand_shell_variables(struct buf *s)
 }
 
 static void
-buf_expand(struct buf *s, int new_alloc)
+buf_expand(struct buf *s, size_t new_alloc)
 {
 	/*
 	 * "s->alloc &&" ensures that s->data is always allocated after
@@ -103,29 +103,28 @@ buf_add_fmt(struct buf *s, const char *fmt, ...)
 	if (string_null_or_empty(fmt)) {
 		return;
 	}
-	va_list ap;
+	va_list ap, retry;
 
+	/* Format into the spare capacity, only a longer result is redone */
+	buf_expand(s, s->len + 1);
+	size_t spare = s->alloc - s->len;
 	va_start(ap, fmt);
-	int n = vsnprintf(NULL, 0, fmt, ap);
+	va_copy(retry, ap);
+	int n = vsnprintf(s->data + s->len, spare, fmt, ap);
 	va_end(ap);
 
-	if (n < 0) {
-		return;
+	if (n >= 0 && (size_t)n >= spare) {
+		buf_expand(s, s->len + n + 1);
+		n = vsnprintf(s->data + s->len, n + 1, fmt, retry);
 	}
-
-	size_t size = (size_t)n + 1;
-	buf_expand(s, s->len + size);
-
-	va_start(ap, fmt);
-	n = vsnprintf(s->data + s->len, size, fmt, ap);
-	va_end(ap);
+	va_end(retry);
 
 	if (n < 0) {
+		s->data[s->len] = 0;
 		return;
 	}
 
 	s->len += n;
-	s->data[s->len] = 0;
 }
 
 void
@@ -134,7 +133,7 @@ buf_add(struct buf *s, const char *data)
 	if (string_null_or_empty(data)) {
 		return;
 	}
-	int len = strlen(data);
+	size_t len = strlen(data);
 	buf_expand(s, s->len + len + 1);
 	memcpy(s->data + s->len, data, len);
 	s->len += len;
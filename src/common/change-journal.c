@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include "common/change-journal.h"
+
+void
+lab_change_journal_record(struct lab_change_journal *journal,
+		uint32_t changes)
+{
+	journal->generation++;
+	journal->changes[journal->generation % LAB_CHANGE_JOURNAL_SIZE] =
+		changes;
+}
+
+uint32_t
+lab_change_journal_since(const struct lab_change_journal *journal,
+		uint64_t generation)
+{
+	if (generation >= journal->generation) {
+		return 0;
+	}
+	if (journal->generation - generation > LAB_CHANGE_JOURNAL_SIZE) {
+		return UINT32_MAX;
+	}
+	uint32_t changes = 0;
+	for (uint64_t i = generation + 1; i <= journal->generation; i++) {
+		changes |= journal->changes[i % LAB_CHANGE_JOURNAL_SIZE];
+	}
+	return changes;
+}
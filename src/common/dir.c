@@ -4,15 +4,23 @@
  *
  * Copyright Johan Malm 2020
  */
+#define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <errno.h>
 #include <glib.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
 #include "common/dir.h"
+#include "common/array.h"
 #include "common/buf.h"
 #include "common/list.h"
+#include "common/macros.h"
 #include "common/mem.h"
 #include "common/string-helpers.h"
 #include "labwc.h"
@@ -54,6 +62,20 @@ static struct dir theme_dirs[] = {
 	}
 };
 
+static struct dir data_dirs[] = {
+	{
+		.prefix = "XDG_DATA_HOME",
+		.default_prefix = "$HOME/.local/share",
+		.path = "",
+	}, {
+		.prefix = "XDG_DATA_DIRS",
+		.default_prefix = "/usr/local/share:/usr/share",
+		.path = "",
+	}, {
+		.path = NULL,
+	}
+};
+
 struct ctx {
 	void (*build_path_fn)(struct ctx *ctx, char *prefix, const char *path);
 	const char *filename;
@@ -64,6 +86,32 @@ struct ctx {
 	struct wl_list *list;
 };
 
+/* Existing files of a paths_*_find() call, see paths_find() */
+struct resolved {
+	char *key;
+	struct wl_array paths; /* char *, most important first */
+	struct wl_list link;
+};
+
+static struct {
+	bool initialized;
+	int inotify_fd; /* -1 if unavailable, then nothing is cached */
+	struct wl_array watches; /* int */
+	/* Variables the cached paths were built from */
+	struct buf environment;
+	struct wl_list entries;
+} cache = {
+	.inotify_fd = -1,
+};
+
+static const char *const environment_names[] = {
+	"HOME",
+	"XDG_CONFIG_HOME",
+	"XDG_CONFIG_DIRS",
+	"XDG_DATA_HOME",
+	"XDG_DATA_DIRS",
+};
+
 struct wl_list *paths_get_prev(struct wl_list *elm) { return elm->prev; }
 struct wl_list *paths_get_next(struct wl_list *elm) { return elm->next; }
 
@@ -74,6 +122,13 @@ build_config_path(struct ctx *ctx, char *prefix, const char *path)
 	snprintf(ctx->buf, ctx->len, "%s/%s/%s", prefix, path, ctx->filename);
 }
 
+static void
+build_data_path(struct ctx *ctx, char *prefix, const char *path)
+{
+	assert(prefix);
+	snprintf(ctx->buf, ctx->len, "%s/%s", prefix, ctx->filename);
+}
+
 static void
 build_theme_path_labwc(struct ctx *ctx, char *prefix, const char *path)
 {
@@ -128,9 +183,8 @@ find_dir(struct ctx *ctx)
 			}
 
 			/*
-			 * TODO: We could stat() and continue here if we really
-			 * wanted to only respect only the first hit, but feels
-			 * like it is probably overkill.
+			 * All candidates are listed, existing or not. Callers
+			 * which only want existing files use paths_*_find().
 			 */
 			struct path *path = znew(*path);
 			path->string = xstrdup(ctx->buf);
@@ -191,6 +245,250 @@ paths_theme_create(struct wl_list *paths, const char *theme_name,
 	find_dir(&ctx);
 }
 
+void
+paths_data_create(struct wl_list *paths, const char *subdir)
+{
+	char buf[4096] = { 0 };
+	wl_list_init(paths);
+	struct ctx ctx = {
+		.build_path_fn = build_data_path,
+		.filename = subdir,
+		.buf = buf,
+		.len = sizeof(buf),
+		.dirs = data_dirs,
+		.list = paths,
+	};
+	find_dir(&ctx);
+}
+
+static void
+copy_paths(struct wl_list *paths, struct wl_array *strings)
+{
+	char **string;
+	wl_array_for_each(string, strings) {
+		struct path *path = znew(*path);
+		path->string = xstrdup(*string);
+		wl_list_append(paths, &path->link);
+	}
+}
+
+static void
+resolved_destroy(struct resolved *resolved)
+{
+	char **string;
+	wl_array_for_each(string, &resolved->paths) {
+		free(*string);
+	}
+	wl_array_release(&resolved->paths);
+	free(resolved->key);
+	free(resolved);
+}
+
+static void
+cache_drop(void)
+{
+	struct resolved *resolved, *tmp;
+	wl_list_for_each_safe(resolved, tmp, &cache.entries, link) {
+		wl_list_remove(&resolved->link);
+		resolved_destroy(resolved);
+	}
+
+	int *wd;
+	wl_array_for_each(wd, &cache.watches) {
+		inotify_rm_watch(cache.inotify_fd, *wd);
+	}
+	wl_array_release(&cache.watches);
+	wl_array_init(&cache.watches);
+}
+
+/* Returns false if the cache cannot be used at all */
+static bool
+cache_validate(void)
+{
+	if (!cache.initialized) {
+		cache.initialized = true;
+		wl_list_init(&cache.entries);
+		wl_array_init(&cache.watches);
+		cache.environment = BUF_INIT;
+		cache.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (cache.inotify_fd < 0) {
+			wlr_log_errno(WLR_INFO, "paths are not cached");
+		}
+	}
+	if (cache.inotify_fd < 0) {
+		return false;
+	}
+
+	/*
+	 * Any event means something was created, removed or renamed, except
+	 * IN_IGNORED which follows the removal of our own watches
+	 */
+	char events[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	bool changed = false;
+	ssize_t len;
+	while ((len = read(cache.inotify_fd, events, sizeof(events))) > 0) {
+		for (char *p = events; p < events + len;) {
+			struct inotify_event *event = (struct inotify_event *)p;
+			changed |= !(event->mask & IN_IGNORED);
+			p += sizeof(*event) + event->len;
+		}
+	}
+
+	struct buf environment = BUF_INIT;
+	for (size_t i = 0; i < ARRAY_SIZE(environment_names); i++) {
+		const char *value = getenv(environment_names[i]);
+		buf_add_fmt(&environment, "%s\n", value ? value : "");
+	}
+	buf_add_fmt(&environment, "%s\n", rc.config_dir ? rc.config_dir : "");
+	if (!cache.environment.len
+			|| strcmp(environment.data, cache.environment.data)) {
+		changed = true;
+		buf_move(&cache.environment, &environment);
+	}
+	buf_reset(&environment);
+
+	if (changed) {
+		cache_drop();
+	}
+	return true;
+}
+
+/*
+ * Watch the directory @path is in, or the closest parent that exists,
+ * so that creating or removing the file invalidates the cache. Returns
+ * false if that is not possible.
+ */
+static bool
+watch_parent(const char *path)
+{
+	struct buf dir = BUF_INIT;
+	buf_add(&dir, path);
+	bool ok = false;
+	for (;;) {
+		char *slash = strrchr(dir.data, '/');
+		if (!slash) {
+			break;
+		}
+		*slash = '\0';
+		const char *name = *dir.data ? dir.data : "/";
+		int wd = inotify_add_watch(cache.inotify_fd, name,
+			IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+			| IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+		if (wd >= 0) {
+			int *watched;
+			bool found = false;
+			wl_array_for_each(watched, &cache.watches) {
+				found |= *watched == wd;
+			}
+			if (!found) {
+				array_add(&cache.watches, wd);
+			}
+			ok = true;
+			break;
+		}
+		if ((errno != ENOENT && errno != ENOTDIR) || !*dir.data) {
+			break;
+		}
+	}
+	buf_reset(&dir);
+	return ok;
+}
+
+/*
+ * Fill @paths with the files of @create(@paths, @theme_name, @filename)
+ * that exist. The result is kept until the environment changes or inotify
+ * reports a change in one of the directories.
+ */
+static void
+paths_find(struct wl_list *paths, const char *theme_name, const char *filename,
+		void (*create)(struct wl_list *paths, const char *theme_name,
+			const char *filename))
+{
+	bool cacheable = cache_validate();
+	wl_list_init(paths);
+
+	char *key = strdup_printf("%s/%s", theme_name ? theme_name : "",
+		filename);
+	struct resolved *resolved;
+	if (cacheable) {
+		wl_list_for_each(resolved, &cache.entries, link) {
+			if (!strcmp(resolved->key, key)) {
+				copy_paths(paths, &resolved->paths);
+				free(key);
+				return;
+			}
+		}
+	}
+
+	struct wl_list candidates;
+	create(&candidates, theme_name, filename);
+	resolved = znew(*resolved);
+	resolved->key = key;
+	wl_array_init(&resolved->paths);
+	struct path *path;
+	wl_list_for_each(path, &candidates, link) {
+		/* Watch first, so that a file created meanwhile is noticed */
+		if (cacheable) {
+			cacheable = watch_parent(path->string);
+		}
+		struct stat st;
+		if (!stat(path->string, &st) && !S_ISDIR(st.st_mode)) {
+			char *string = xstrdup(path->string);
+			array_add(&resolved->paths, string);
+		}
+	}
+	paths_destroy(&candidates);
+	copy_paths(paths, &resolved->paths);
+
+	if (cacheable) {
+		wl_list_insert(&cache.entries, &resolved->link);
+	} else {
+		resolved_destroy(resolved);
+	}
+}
+
+static void
+create_config(struct wl_list *paths, const char *theme_name,
+		const char *filename)
+{
+	paths_config_create(paths, filename);
+}
+
+void
+paths_config_find(struct wl_list *paths, const char *filename)
+{
+	/* Theme names can't be empty, so the keys don't collide */
+	paths_find(paths, NULL, filename, create_config);
+}
+
+void
+paths_theme_find(struct wl_list *paths, const char *theme_name,
+		const char *filename)
+{
+	if (!theme_name) {
+		wl_list_init(paths);
+		return;
+	}
+	paths_find(paths, theme_name, filename, paths_theme_create);
+}
+
+void
+paths_cache_finish(void)
+{
+	if (!cache.initialized) {
+		return;
+	}
+	cache_drop();
+	wl_array_release(&cache.watches);
+	buf_reset(&cache.environment);
+	if (cache.inotify_fd >= 0) {
+		close(cache.inotify_fd);
+		cache.inotify_fd = -1;
+	}
+	cache.initialized = false;
+}
+
 void
 paths_destroy(struct wl_list *paths)
 {
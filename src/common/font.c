@@ -1,12 +1,17 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <cairo.h>
 #include <drm_fourcc.h>
+#include <glib.h>
+#include <math.h>
 #include <pango/pangocairo.h>
+#include <stdlib.h>
+#include <string.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
 #include "common/font.h"
 #include "common/graphic-helpers.h"
+#include "common/mem.h"
 #include "common/string-helpers.h"
 #include "labwc.h"
 #include "buffer.h"
@@ -22,6 +27,68 @@ font_to_pango_desc(struct font *font)
 	return desc;
 }
 
+/*
+ * Measured extents are cached per font and text, so that clients which
+ * update their title often do not cause a full Pango layout on every
+ * update. The cache is simply emptied when it is full.
+ */
+#define LAB_FONT_EXTENTS_CACHE_MAX 256
+
+static struct {
+	/* Font descriptions by font_key(), PangoFontDescription */
+	GHashTable *descs;
+	/* Extents by font_key() and text, PangoRectangle */
+	GHashTable *extents;
+
+	/* Layout on a 1x1 surface, only used for measuring */
+	cairo_surface_t *surface;
+	cairo_t *cairo;
+	PangoLayout *layout;
+} font_cache;
+
+static char *
+font_key(struct font *font)
+{
+	return g_strdup_printf("%s\x1f%d\x1f%d\x1f%d",
+		font->name ? font->name : "", font->size, font->slant,
+		font->weight);
+}
+
+/* Returns a description owned by the cache, do not free */
+static PangoFontDescription *
+font_cached_desc(struct font *font, char *key)
+{
+	if (!font_cache.descs) {
+		font_cache.descs = g_hash_table_new_full(g_str_hash,
+			g_str_equal, g_free,
+			(GDestroyNotify)pango_font_description_free);
+	}
+	PangoFontDescription *desc = g_hash_table_lookup(font_cache.descs, key);
+	if (!desc) {
+		desc = font_to_pango_desc(font);
+		g_hash_table_insert(font_cache.descs, g_strdup(key), desc);
+	}
+	return desc;
+}
+
+static PangoLayout *
+measure_layout(void)
+{
+	if (!font_cache.layout) {
+		font_cache.surface =
+			cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+		font_cache.cairo = cairo_create(font_cache.surface);
+		font_cache.layout = pango_cairo_create_layout(font_cache.cairo);
+		pango_context_set_round_glyph_positions(
+			pango_layout_get_context(font_cache.layout), false);
+		pango_layout_set_single_paragraph_mode(font_cache.layout, TRUE);
+		pango_layout_set_width(font_cache.layout, -1);
+		pango_layout_set_ellipsize(font_cache.layout,
+			PANGO_ELLIPSIZE_MIDDLE);
+	}
+	return font_cache.layout;
+}
+
 static PangoRectangle
 font_extents(struct font *font, const char *string)
 {
@@ -29,21 +96,25 @@ font_extents(struct font *font, const char *string)
 	if (!string) {
 		return rect;
 	}
-	cairo_surface_t *surface;
-	cairo_t *c;
-	PangoLayout *layout;
 
-	surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
-	c = cairo_create(surface);
-	layout = pango_cairo_create_layout(c);
-	pango_context_set_round_glyph_positions(pango_layout_get_context(layout), false);
-	PangoFontDescription *desc = font_to_pango_desc(font);
+	char *key = font_key(font);
+	char *extents_key = g_strdup_printf("%s\n%s", key, string);
+	if (!font_cache.extents) {
+		font_cache.extents = g_hash_table_new_full(g_str_hash,
+			g_str_equal, g_free, free);
+	}
+	PangoRectangle *cached =
+		g_hash_table_lookup(font_cache.extents, extents_key);
+	if (cached) {
+		rect = *cached;
+		g_free(extents_key);
+		g_free(key);
+		return rect;
+	}
 
-	pango_layout_set_font_description(layout, desc);
+	PangoLayout *layout = measure_layout();
+	pango_layout_set_font_description(layout, font_cached_desc(font, key));
 	pango_layout_set_text(layout, string, -1);
-	pango_layout_set_single_paragraph_mode(layout, TRUE);
-	pango_layout_set_width(layout, -1);
-	pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_MIDDLE);
 	pango_layout_get_extents(layout, NULL, &rect);
 	pango_extents_to_pixels(&rect, NULL);
 
@@ -51,10 +122,14 @@ font_extents(struct font *font, const char *string)
 	/* TODO: remove the 4 pixel addition and always do the padding by the caller */
 	rect.width += 4;
 
-	cairo_destroy(c);
-	cairo_surface_destroy(surface);
-	pango_font_description_free(desc);
-	g_object_unref(layout);
+	if (g_hash_table_size(font_cache.extents)
+			>= LAB_FONT_EXTENTS_CACHE_MAX) {
+		g_hash_table_remove_all(font_cache.extents);
+	}
+	PangoRectangle *copy = znew(*copy);
+	*copy = rect;
+	g_hash_table_insert(font_cache.extents, extents_key, copy);
+	g_free(key);
 	return rect;
 }
 
@@ -84,25 +159,12 @@ font_get_buffer_size(int max_width, const char *text, struct font *font,
 	*height = text_extents.height;
 }
 
-void
-font_buffer_create(struct lab_data_buffer **buffer, int max_width,
-	const char *text, struct font *font, const float *color,
-	const float *bg_color, double scale)
+/* Only uses cairo and pango, see font_render_surface() */
+static void
+draw_text(cairo_surface_t *surf, int width, const char *text,
+		PangoFontDescription *desc, const float *color,
+		const float *bg_color)
 {
-	if (string_null_or_empty(text)) {
-		return;
-	}
-
-	int width, height;
-	font_get_buffer_size(max_width, text, font, &width, &height);
-
-	*buffer = buffer_create_cairo(width, height, scale);
-	if (!*buffer) {
-		wlr_log(WLR_ERROR, "Failed to create font buffer");
-		return;
-	}
-
-	cairo_surface_t *surf = (*buffer)->surface;
 	cairo_t *cairo = cairo_create(surf);
 
 	/*
@@ -142,9 +204,7 @@ font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 		cairo_font_options_destroy(opts);
 	}
 
-	PangoFontDescription *desc = font_to_pango_desc(font);
 	pango_layout_set_font_description(layout, desc);
-	pango_font_description_free(desc);
 	pango_cairo_update_layout(cairo, layout);
 	pango_cairo_show_layout(cairo, layout);
 
@@ -154,8 +214,69 @@ font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 	cairo_destroy(cairo);
 }
 
+void
+font_buffer_create(struct lab_data_buffer **buffer, int max_width,
+	const char *text, struct font *font, const float *color,
+	const float *bg_color, double scale)
+{
+	if (string_null_or_empty(text)) {
+		return;
+	}
+
+	int width, height;
+	font_get_buffer_size(max_width, text, font, &width, &height);
+
+	*buffer = buffer_create_cairo(width, height, scale);
+	if (!*buffer) {
+		wlr_log(WLR_ERROR, "Failed to create font buffer");
+		return;
+	}
+
+	char *key = font_key(font);
+	draw_text((*buffer)->surface, width, text, font_cached_desc(font, key),
+		color, bg_color);
+	g_free(key);
+}
+
+cairo_surface_t *
+font_render_surface(int width, int height, const char *text,
+	struct font *font, const float *color, const float *bg_color,
+	double scale)
+{
+	if (string_null_or_empty(text)) {
+		return NULL;
+	}
+
+	/* The same size and device scale as buffer_create_cairo() */
+	cairo_surface_t *surf = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+		lroundf(width * scale), lroundf(height * scale));
+	if (cairo_surface_status(surf)) {
+		cairo_surface_destroy(surf);
+		return NULL;
+	}
+	cairo_surface_set_device_scale(surf, scale, scale);
+
+	/* The cached descriptions belong to the main thread */
+	PangoFontDescription *desc = font_to_pango_desc(font);
+	draw_text(surf, width, text, desc, color, bg_color);
+	pango_font_description_free(desc);
+	return surf;
+}
+
 void
 font_finish(void)
 {
+	if (font_cache.layout) {
+		g_object_unref(font_cache.layout);
+		cairo_destroy(font_cache.cairo);
+		cairo_surface_destroy(font_cache.surface);
+	}
+	if (font_cache.extents) {
+		g_hash_table_destroy(font_cache.extents);
+	}
+	if (font_cache.descs) {
+		g_hash_table_destroy(font_cache.descs);
+	}
+	memset(&font_cache, 0, sizeof(font_cache));
 	pango_cairo_font_map_set_default(NULL);
 }
@@ -8,29 +8,90 @@
 #define _POSIX_C_SOURCE 200809L
 #include "common/grab-file.h"
 #include "common/buf.h"
+#include "common/mem.h"
 
-#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Chunk size for files which don't report their size, like those in /proc */
+#define GRAB_FILE_CHUNK 4096
+
+static bool
+read_all(int fd, struct buf *buffer, size_t size)
+{
+	while (buffer->len < size) {
+		ssize_t ret = read(fd, buffer->data + buffer->len,
+			size - buffer->len);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret < 0) {
+			return false;
+		}
+		if (!ret) {
+			/* End of file, which may have shrunk since fstat() */
+			break;
+		}
+		buffer->len += ret;
+	}
+	return true;
+}
 
 struct buf
 grab_file(const char *filename)
 {
-	char *line = NULL;
-	size_t len = 0;
-	FILE *stream = fopen(filename, "r");
-	if (!stream) {
+	int fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
 		return BUF_INIT;
 	}
-	struct buf buffer = BUF_INIT;
-	while ((getline(&line, &len, stream) != -1)) {
-		char *p = strrchr(line, '\n');
-		if (p) {
-			*p = '\0';
+	struct stat st;
+	if (fstat(fd, &st) < 0 || S_ISDIR(st.st_mode)) {
+		close(fd);
+		return BUF_INIT;
+	}
+
+	/* One read into an exactly sized buffer, unless the size is unknown */
+	size_t size = st.st_size ? (size_t)st.st_size : GRAB_FILE_CHUNK;
+	struct buf buffer = {
+		.data = xmalloc(size + 1),
+		.alloc = size + 1,
+	};
+	for (;;) {
+		if (!read_all(fd, &buffer, size)) {
+			close(fd);
+			buf_reset(&buffer);
+			return BUF_INIT;
 		}
-		buf_add(&buffer, line);
+		if (st.st_size || buffer.len < size) {
+			break;
+		}
+		size *= 2;
+		buffer.data = xrealloc(buffer.data, size + 1);
+		buffer.alloc = size + 1;
 	}
-	free(line);
-	fclose(stream);
+	close(fd);
+	buffer.data[buffer.len] = '\0';
 	return buffer;
 }
+
+char *
+grab_file_next_line(struct buf *buffer, size_t *pos)
+{
+	if (*pos >= buffer->len) {
+		return NULL;
+	}
+	char *line = buffer->data + *pos;
+	char *end = memchr(line, '\n', buffer->len - *pos);
+	if (end) {
+		*end = '\0';
+		*pos = end - buffer->data + 1;
+	} else {
+		*pos = buffer->len;
+	}
+	return line;
+}
@@ -23,7 +23,6 @@ struct multi_rect *
 multi_rect_create(struct wlr_scene_tree *parent, float *colors[3], int line_width)
 {
 	struct multi_rect *rect = znew(*rect);
-	rect->line_width = line_width;
 	rect->tree = wlr_scene_tree_create(parent);
 	rect->destroy.notify = multi_rect_destroy_notify;
 	wl_signal_add(&rect->tree->node.events.destroy, &rect->destroy);
@@ -32,12 +31,26 @@ multi_rect_create(struct wlr_scene_tree *parent, float *colors[3], int line_widt
 		rect->right[i] = wlr_scene_rect_create(rect->tree, 0, 0, colors[i]);
 		rect->bottom[i] = wlr_scene_rect_create(rect->tree, 0, 0, colors[i]);
 		rect->left[i] = wlr_scene_rect_create(rect->tree, 0, 0, colors[i]);
+	}
+	multi_rect_set_style(rect, colors, line_width);
+	return rect;
+}
+
+void
+multi_rect_set_style(struct multi_rect *rect, float *colors[3], int line_width)
+{
+	assert(rect);
+	rect->line_width = line_width;
+	for (size_t i = 0; i < 3; i++) {
+		wlr_scene_rect_set_color(rect->top[i], colors[i]);
+		wlr_scene_rect_set_color(rect->right[i], colors[i]);
+		wlr_scene_rect_set_color(rect->bottom[i], colors[i]);
+		wlr_scene_rect_set_color(rect->left[i], colors[i]);
 		wlr_scene_node_set_position(&rect->top[i]->node,
 			i * line_width, i * line_width);
 		wlr_scene_node_set_position(&rect->left[i]->node,
 			i * line_width, (i + 1) * line_width);
 	}
-	return rect;
 }
 
 void
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <glib.h>
+#include <stddef.h>
+#include <string.h>
+#include "common/intern.h"
+#include "common/mem.h"
+
+struct atom {
+	uint32_t refcount;
+	uint32_t hash;
+	char str[];
+};
+
+/* Atoms by their string, which is the key stored in the table */
+static GHashTable *atoms;
+
+static struct atom *
+atom_from_str(const char *str)
+{
+	return (struct atom *)(str - offsetof(struct atom, str));
+}
+
+const char *
+lab_intern(const char *str)
+{
+	if (!str) {
+		return NULL;
+	}
+	if (!atoms) {
+		atoms = g_hash_table_new(g_str_hash, g_str_equal);
+	}
+	struct atom *atom = g_hash_table_lookup(atoms, str);
+	if (atom) {
+		atom->refcount++;
+		return atom->str;
+	}
+
+	size_t len = strlen(str);
+	atom = xzalloc(sizeof(*atom) + len + 1);
+	memcpy(atom->str, str, len);
+	atom->refcount = 1;
+	atom->hash = g_str_hash(str);
+	g_hash_table_insert(atoms, atom->str, atom);
+	return atom->str;
+}
+
+const char *
+lab_intern_find(const char *str)
+{
+	if (!str || !atoms) {
+		return NULL;
+	}
+	struct atom *atom = g_hash_table_lookup(atoms, str);
+	return atom ? atom->str : NULL;
+}
+
+void
+lab_intern_release(const char *str)
+{
+	if (!str) {
+		return;
+	}
+	struct atom *atom = atom_from_str(str);
+	assert(atom->refcount > 0);
+	if (--atom->refcount) {
+		return;
+	}
+	g_hash_table_remove(atoms, atom->str);
+	free(atom);
+}
+
+uint32_t
+lab_intern_hash(const char *str)
+{
+	return str ? atom_from_str(str)->hash : 0;
+}
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include "common/listener.h"
+
+static struct wl_listener *
+listener_at(void *dest, const struct lab_listener_binding *binding)
+{
+	return (struct wl_listener *)((char *)dest + binding->listener_offset);
+}
+
+void
+lab_listeners_connect(void *src, void *dest,
+		const struct lab_listener_binding *bindings, size_t count)
+{
+	assert(src && dest);
+	for (size_t i = 0; i < count; i++) {
+		struct wl_signal *signal = (struct wl_signal *)
+			((char *)src + bindings[i].signal_offset);
+		struct wl_listener *listener = listener_at(dest, &bindings[i]);
+		listener->notify = bindings[i].notify;
+		wl_signal_add(signal, listener);
+	}
+}
+
+void
+lab_listeners_disconnect(void *dest,
+		const struct lab_listener_binding *bindings, size_t count)
+{
+	assert(dest);
+	for (size_t i = 0; i < count; i++) {
+		wl_list_remove(&listener_at(dest, &bindings[i])->link);
+	}
+}
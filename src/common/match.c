@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 #include <fnmatch.h>
+#include <string.h>
+#include <strings.h>
 #include "common/match.h"
 
 bool
@@ -8,3 +10,96 @@ match_glob(const char *pattern, const char *string)
 {
 	return fnmatch(pattern, string, FNM_CASEFOLD) == 0;
 }
+
+static bool
+needs_fnmatch(const char *str, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		unsigned char c = str[i];
+		/*
+		 * Case folding of multibyte characters is locale dependent,
+		 * leave that to fnmatch()
+		 */
+		if (c >= 0x80 || strchr("*?[\\", c)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+match_glob_compile(struct match_glob *glob, const char *pattern)
+{
+	*glob = (struct match_glob){
+		.type = LAB_MATCH_GLOB_NONE,
+		.pattern = pattern,
+	};
+	if (!pattern) {
+		return;
+	}
+
+	const char *start = pattern;
+	const char *end = pattern + strlen(pattern);
+	while (*start == '*') {
+		start++;
+	}
+	while (end > start && end[-1] == '*') {
+		end--;
+	}
+	bool leading = start > pattern;
+	bool trailing = *end == '*';
+
+	glob->needle = start;
+	glob->len = end - start;
+
+	if (needs_fnmatch(start, glob->len)) {
+		glob->type = LAB_MATCH_GLOB_FNMATCH;
+	} else if (!glob->len && leading) {
+		glob->type = LAB_MATCH_GLOB_ANY;
+	} else if (leading && trailing) {
+		glob->type = LAB_MATCH_GLOB_SUBSTRING;
+	} else if (leading) {
+		glob->type = LAB_MATCH_GLOB_SUFFIX;
+	} else if (trailing) {
+		glob->type = LAB_MATCH_GLOB_PREFIX;
+	} else {
+		glob->type = LAB_MATCH_GLOB_LITERAL;
+	}
+}
+
+bool
+match_glob_compiled(const struct match_glob *glob, const char *string)
+{
+	if (glob->type == LAB_MATCH_GLOB_NONE) {
+		return true;
+	}
+	if (!string) {
+		return false;
+	}
+
+	size_t len = glob->len;
+	switch (glob->type) {
+	case LAB_MATCH_GLOB_ANY:
+		return true;
+	case LAB_MATCH_GLOB_LITERAL:
+		return !strcasecmp(string, glob->needle);
+	case LAB_MATCH_GLOB_PREFIX:
+		return !strncasecmp(string, glob->needle, len);
+	case LAB_MATCH_GLOB_SUFFIX: {
+		size_t slen = strlen(string);
+		return slen >= len
+			&& !strcasecmp(string + slen - len, glob->needle);
+	}
+	case LAB_MATCH_GLOB_SUBSTRING: {
+		size_t slen = strlen(string);
+		for (size_t i = 0; i + len <= slen; i++) {
+			if (!strncasecmp(string + i, glob->needle, len)) {
+				return true;
+			}
+		}
+		return false;
+	}
+	default:
+		return match_glob(glob->pattern, string);
+	}
+}
@@ -3,8 +3,15 @@
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
+#include "common/macros.h"
 #include "common/mem.h"
 
+/* The wrappers are defined here, don't account them twice */
+#undef xzalloc
+#undef xrealloc
+#undef xstrdup
+#undef free
+
 static void
 die_if_null(void *ptr)
 {
@@ -45,3 +52,257 @@ xstrdup(const char *str)
 	die_if_null(copy);
 	return copy;
 }
+
+static const char *tag_names[LAB_MEM_TAG_COUNT] = {
+	[LAB_MEM_CONFIG] = "config",
+	[LAB_MEM_THEME] = "theme",
+	[LAB_MEM_VIEW] = "view",
+	[LAB_MEM_SSD] = "ssd",
+	[LAB_MEM_INPUT] = "input",
+	[LAB_MEM_PROTOCOL] = "protocol",
+	[LAB_MEM_OTHER] = "other",
+};
+
+const char *
+mem_tag_name(enum mem_tag tag)
+{
+	assert(tag < LAB_MEM_TAG_COUNT);
+	return tag_names[tag];
+}
+
+#if HAVE_MEM_ACCOUNTING
+
+static struct mem_stats stats[LAB_MEM_TAG_COUNT];
+
+/*
+ * Live allocations in an open addressing hash table with linear probing,
+ * keyed by address. Deleted slots are filled by shifting back the rest of
+ * their cluster, so lookups never have to skip tombstones.
+ */
+struct allocation {
+	void *ptr;
+	size_t size;
+	enum mem_tag tag;
+};
+
+static struct allocation *table;
+static size_t table_size; /* power of two */
+static size_t table_used;
+
+static size_t
+slot_of(const void *ptr)
+{
+	uintptr_t key = (uintptr_t)ptr;
+	key ^= key >> 17;
+	key *= 0xed5ad4bbU;
+	key ^= key >> 11;
+	return key & (table_size - 1);
+}
+
+static void table_insert(void *ptr, size_t size, enum mem_tag tag);
+
+static void
+table_grow(void)
+{
+	struct allocation *old = table;
+	size_t old_size = table_size;
+
+	table_size = table_size ? table_size * 2 : 4096;
+	table = calloc(table_size, sizeof(*table));
+	die_if_null(table);
+	table_used = 0;
+	for (size_t i = 0; i < old_size; i++) {
+		if (old[i].ptr) {
+			table_insert(old[i].ptr, old[i].size, old[i].tag);
+		}
+	}
+	free(old);
+}
+
+static void
+account_remove(struct allocation *allocation)
+{
+	struct mem_stats *tag_stats = &stats[allocation->tag];
+	tag_stats->live_bytes -= allocation->size;
+	tag_stats->frees++;
+}
+
+/* Returns the slot of @ptr, or the empty slot ending its cluster */
+static size_t
+table_find(const void *ptr)
+{
+	size_t i = slot_of(ptr);
+	while (table[i].ptr && table[i].ptr != ptr) {
+		i = (i + 1) & (table_size - 1);
+	}
+	return i;
+}
+
+static void
+table_insert(void *ptr, size_t size, enum mem_tag tag)
+{
+	if ((table_used + 1) * 4 > table_size * 3) {
+		table_grow();
+	}
+	size_t i = table_find(ptr);
+	if (table[i].ptr) {
+		/* Freed behind our back and handed out again */
+		account_remove(&table[i]);
+	} else {
+		table_used++;
+	}
+	table[i] = (struct allocation){ .ptr = ptr, .size = size, .tag = tag };
+}
+
+static void
+table_remove(void *ptr)
+{
+	if (!table) {
+		return;
+	}
+	size_t i = table_find(ptr);
+	if (!table[i].ptr) {
+		/* Not allocated through the wrappers, e.g. by strdup() */
+		return;
+	}
+	account_remove(&table[i]);
+	table[i].ptr = NULL;
+	table_used--;
+
+	/* Move later entries of the cluster which would otherwise be lost */
+	size_t hole = i;
+	for (size_t j = (i + 1) & (table_size - 1); table[j].ptr;
+			j = (j + 1) & (table_size - 1)) {
+		size_t home = slot_of(table[j].ptr);
+		/* Keep j if its home slot lies cyclically in (hole, j] */
+		bool keep = hole <= j ? (hole < home && home <= j)
+			: (hole < home || home <= j);
+		if (keep) {
+			continue;
+		}
+		table[hole] = table[j];
+		table[j].ptr = NULL;
+		hole = j;
+	}
+}
+
+static enum mem_tag
+tag_from_path(const char *file)
+{
+	static const struct {
+		const char *pattern;
+		enum mem_tag tag;
+	} patterns[] = {
+		{ "/config/", LAB_MEM_CONFIG },
+		/* Only the config is allocated from arenas so far */
+		{ "/common/arena.c", LAB_MEM_CONFIG },
+		{ "/ssd/", LAB_MEM_SSD },
+		{ "/input/", LAB_MEM_INPUT },
+		{ "/protocols/", LAB_MEM_PROTOCOL },
+		{ "/foreign-toplevel/", LAB_MEM_PROTOCOL },
+		{ "/decorations/", LAB_MEM_PROTOCOL },
+		{ "/img/", LAB_MEM_THEME },
+		{ "theme.c", LAB_MEM_THEME },
+		{ "font", LAB_MEM_THEME },
+		{ "scaled-", LAB_MEM_THEME },
+		{ "view", LAB_MEM_VIEW },
+		{ "xdg", LAB_MEM_VIEW },
+		{ "xwayland", LAB_MEM_VIEW },
+		{ "layers.c", LAB_MEM_VIEW },
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(patterns); i++) {
+		if (strstr(file, patterns[i].pattern)) {
+			return patterns[i].tag;
+		}
+	}
+	return LAB_MEM_OTHER;
+}
+
+/* __FILE__ is the same string literal for all calls from one file */
+static enum mem_tag
+tag_from_file(const char *file)
+{
+	static struct {
+		const char *file;
+		enum mem_tag tag;
+	} cache[256];
+
+	size_t i = ((uintptr_t)file >> 4) % ARRAY_SIZE(cache);
+	if (cache[i].file != file) {
+		cache[i].file = file;
+		cache[i].tag = tag_from_path(file);
+	}
+	return cache[i].tag;
+}
+
+static void
+account_add(void *ptr, size_t size, const char *file)
+{
+	enum mem_tag tag = tag_from_file(file);
+	struct mem_stats *tag_stats = &stats[tag];
+	tag_stats->allocations++;
+	tag_stats->live_bytes += size;
+	tag_stats->peak_bytes = MAX(tag_stats->peak_bytes,
+		tag_stats->live_bytes);
+	table_insert(ptr, size, tag);
+}
+
+void *
+mem_xzalloc(size_t size, const char *file)
+{
+	void *ptr = xzalloc(size);
+	if (ptr) {
+		account_add(ptr, size, file);
+	}
+	return ptr;
+}
+
+void *
+mem_xrealloc(void *ptr, size_t size, const char *file)
+{
+	if (ptr) {
+		table_remove(ptr);
+	}
+	ptr = xrealloc(ptr, size);
+	if (ptr) {
+		account_add(ptr, size, file);
+	}
+	return ptr;
+}
+
+char *
+mem_xstrdup(const char *str, const char *file)
+{
+	char *copy = xstrdup(str);
+	account_add(copy, strlen(copy) + 1, file);
+	return copy;
+}
+
+void
+mem_free(void *ptr)
+{
+	if (ptr) {
+		table_remove(ptr);
+	}
+	free(ptr);
+}
+
+bool
+mem_get_stats(enum mem_tag tag, struct mem_stats *tag_stats)
+{
+	assert(tag < LAB_MEM_TAG_COUNT);
+	*tag_stats = stats[tag];
+	return true;
+}
+
+#else
+
+bool
+mem_get_stats(enum mem_tag tag, struct mem_stats *tag_stats)
+{
+	assert(tag < LAB_MEM_TAG_COUNT);
+	*tag_stats = (struct mem_stats){0};
+	return false;
+}
+
+#endif /* HAVE_MEM_ACCOUNTING */
@@ -29,6 +29,45 @@ _create_buffer(struct scaled_scene_buffer *scaled_buffer, double scale)
 	return buffer;
 }
 
+/* What a worker needs to render the text, see _render_async() */
+struct font_job {
+	char *text;
+	struct font font;
+	float color[4];
+	float bg_color[4];
+};
+
+static void *
+_prepare_async(struct scaled_scene_buffer *scaled_buffer)
+{
+	struct scaled_font_buffer *self = scaled_buffer->data;
+	struct font_job *job = znew(*job);
+	job->text = xstrdup(self->text ? self->text : "");
+	job->font = self->font;
+	job->font.name = self->font.name ? xstrdup(self->font.name) : NULL;
+	memcpy(job->color, self->color, sizeof(job->color));
+	memcpy(job->bg_color, self->bg_color, sizeof(job->bg_color));
+	return job;
+}
+
+/* Worker thread, the size was measured by scaled_font_buffer_update() */
+static cairo_surface_t *
+_render_async(void *state, int width, int height, double scale)
+{
+	struct font_job *job = state;
+	return font_render_surface(width, height, job->text, &job->font,
+		job->color, job->bg_color, scale);
+}
+
+static void
+_free_async(void *state)
+{
+	struct font_job *job = state;
+	free(job->text);
+	free(job->font.name);
+	free(job);
+}
+
 static void
 _destroy(struct scaled_scene_buffer *scaled_buffer)
 {
@@ -57,10 +96,31 @@ _equal(struct scaled_scene_buffer *scaled_buffer_a,
 		&& !memcmp(a->bg_color, b->bg_color, sizeof(a->bg_color));
 }
 
+static uint32_t
+_hash(struct scaled_scene_buffer *scaled_buffer)
+{
+	struct scaled_font_buffer *self = scaled_buffer->data;
+
+	uint32_t hash = LAB_SCALED_BUFFER_HASH_INIT;
+	hash = scaled_scene_buffer_hash_str(hash, self->text);
+	hash = scaled_scene_buffer_hash(hash, &self->max_width, sizeof(self->max_width));
+	hash = scaled_scene_buffer_hash_str(hash, self->font.name);
+	hash = scaled_scene_buffer_hash(hash, &self->font.size, sizeof(self->font.size));
+	hash = scaled_scene_buffer_hash(hash, &self->font.slant, sizeof(self->font.slant));
+	hash = scaled_scene_buffer_hash(hash, &self->font.weight, sizeof(self->font.weight));
+	hash = scaled_scene_buffer_hash(hash, self->color, sizeof(self->color));
+	return scaled_scene_buffer_hash(hash, self->bg_color, sizeof(self->bg_color));
+}
+
 static const struct scaled_scene_buffer_impl impl = {
+	.name = "font",
 	.create_buffer = _create_buffer,
 	.destroy = _destroy,
 	.equal = _equal,
+	.hash = _hash,
+	.prepare_async = _prepare_async,
+	.render_async = _render_async,
+	.free_async = _free_async,
 };
 
 /* Public API */
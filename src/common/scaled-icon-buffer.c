@@ -1,29 +1,105 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <math.h>
 #include <string.h>
+#include <wayland-server-core.h>
+#include "buffer.h"
+#include "common/intern.h"
 #include "common/macros.h"
 #include "common/mem.h"
 #include "common/scaled-icon-buffer.h"
 #include "common/scaled-scene-buffer.h"
-#include "common/string-helpers.h"
 #include "config.h"
 #include "config/rcxml.h"
+#include "icon-index.h"
+#include "icon-loader.h"
 #include "img/img.h"
 #include "node.h"
 
+#if HAVE_LIBSFDO
+static void
+handle_icon_ready(struct wl_listener *listener, void *data)
+{
+	struct scaled_icon_buffer *self =
+		wl_container_of(listener, self, on_ready);
+	wl_list_remove(&self->on_ready.link);
+	self->waiting = false;
+	scaled_scene_buffer_request_update(self->scaled_buffer,
+		self->width, self->height);
+}
+
+static const char *
+lookup_icon(struct scaled_icon_buffer *self, int size)
+{
+	const char *names[] = {
+		self->icon_name,
+		self->app_id ? icon_index_lookup_app(self->app_id) : NULL,
+		self->app_id,
+		rc.fallback_app_icon_name,
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(names); i++) {
+		const char *path = names[i] ? icon_index_lookup(names[i], size) : NULL;
+		if (path) {
+			return path;
+		}
+	}
+	return NULL;
+}
+#endif
+
 static struct lab_data_buffer *
 _create_buffer(struct scaled_scene_buffer *scaled_buffer, double scale)
 {
+#if HAVE_LIBSFDO
+	struct scaled_icon_buffer *self = scaled_buffer->data;
+	int size = lround(MAX(self->width, self->height) * scale);
+	const char *path = lookup_icon(self, size);
+	if (!path) {
+		return NULL;
+	}
+
+	/* Decoding is done off the main thread, come back when it is */
+	bool pending;
+	cairo_surface_t *icon = icon_loader_get(path, size, &pending);
+	if (pending && !self->waiting) {
+		self->on_ready.notify = handle_icon_ready;
+		icon_loader_add_ready_listener(&self->on_ready);
+		self->waiting = true;
+	}
+	if (!icon) {
+		return NULL;
+	}
+
+	struct lab_data_buffer *buffer =
+		buffer_create_cairo(self->width, self->height, scale);
+	if (!buffer) {
+		return NULL;
+	}
+	cairo_t *cairo = cairo_create(buffer->surface);
+	/* Undo the device scale, the icon is decoded in pixels already */
+	cairo_scale(cairo, 1.0 / scale, 1.0 / scale);
+	int x = (cairo_image_surface_get_width(buffer->surface) - size) / 2;
+	int y = (cairo_image_surface_get_height(buffer->surface) - size) / 2;
+	cairo_set_source_surface(cairo, icon, x, y);
+	cairo_paint(cairo);
+	cairo_destroy(cairo);
+	cairo_surface_flush(buffer->surface);
+	return buffer;
+#else
 	return NULL;
+#endif
 }
 
 static void
 _destroy(struct scaled_scene_buffer *scaled_buffer)
 {
 	struct scaled_icon_buffer *self = scaled_buffer->data;
-	free(self->app_id);
-	free(self->icon_name);
+	if (self->waiting) {
+		wl_list_remove(&self->on_ready.link);
+	}
+	lab_intern_release(self->app_id);
+	lab_intern_release(self->icon_name);
 	free(self);
 }
 
@@ -34,16 +110,34 @@ _equal(struct scaled_scene_buffer *scaled_buffer_a,
 	struct scaled_icon_buffer *a = scaled_buffer_a->data;
 	struct scaled_icon_buffer *b = scaled_buffer_b->data;
 
-	return str_equal(a->app_id, b->app_id)
-		&& str_equal(a->icon_name, b->icon_name)
+	/* Interned strings are equal if their pointers are */
+	return a->app_id == b->app_id
+		&& a->icon_name == b->icon_name
 		&& a->width == b->width
 		&& a->height == b->height;
 }
 
+static uint32_t
+_hash(struct scaled_scene_buffer *scaled_buffer)
+{
+	struct scaled_icon_buffer *self = scaled_buffer->data;
+
+	uint32_t hash = LAB_SCALED_BUFFER_HASH_INIT;
+	uint32_t app_id_hash = lab_intern_hash(self->app_id);
+	uint32_t icon_name_hash = lab_intern_hash(self->icon_name);
+	hash = scaled_scene_buffer_hash(hash, &app_id_hash, sizeof(app_id_hash));
+	hash = scaled_scene_buffer_hash(hash, &icon_name_hash,
+		sizeof(icon_name_hash));
+	hash = scaled_scene_buffer_hash(hash, &self->width, sizeof(self->width));
+	return scaled_scene_buffer_hash(hash, &self->height, sizeof(self->height));
+}
+
 static struct scaled_scene_buffer_impl impl = {
+	.name = "icon",
 	.create_buffer = _create_buffer,
 	.destroy = _destroy,
 	.equal = _equal,
+	.hash = _hash,
 };
 
 struct scaled_icon_buffer *
@@ -72,10 +166,13 @@ scaled_icon_buffer_set_app_id(struct scaled_icon_buffer *self,
 	const char *app_id)
 {
 	assert(app_id);
-	if (str_equal(self->app_id, app_id)) {
+	const char *atom = lab_intern(app_id);
+	if (atom == self->app_id) {
+		lab_intern_release(atom);
 		return;
 	}
-	xstrdup_replace(self->app_id, app_id);
+	lab_intern_release(self->app_id);
+	self->app_id = atom;
 	scaled_scene_buffer_request_update(self->scaled_buffer, self->width, self->height);
 }
 
@@ -84,10 +181,13 @@ scaled_icon_buffer_set_icon_name(struct scaled_icon_buffer *self,
 	const char *icon_name)
 {
 	assert(icon_name);
-	if (str_equal(self->icon_name, icon_name)) {
+	const char *atom = lab_intern(icon_name);
+	if (atom == self->icon_name) {
+		lab_intern_release(atom);
 		return;
 	}
-	xstrdup_replace(self->icon_name, icon_name);
+	lab_intern_release(self->icon_name);
+	self->icon_name = atom;
 	scaled_scene_buffer_request_update(self->scaled_buffer, self->width, self->height);
 }
 
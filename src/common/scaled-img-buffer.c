@@ -40,6 +40,7 @@ _equal(struct scaled_scene_buffer *scaled_buffer_a,
 }
 
 static struct scaled_scene_buffer_impl impl = {
+	.name = "img",
 	.create_buffer = _create_buffer,
 	.destroy = _destroy,
 	.equal = _equal,
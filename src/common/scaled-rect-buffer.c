@@ -4,6 +4,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <wayland-server-core.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/box.h>
 #include <wlr/util/log.h>
 #include "buffer.h"
 #include "common/graphic-helpers.h"
@@ -82,10 +84,25 @@ _equal(struct scaled_scene_buffer *scaled_buffer_a, struct scaled_scene_buffer *
 		&& !memcmp(a->border_color, b->border_color, sizeof(a->border_color));
 }
 
+static uint32_t
+_hash(struct scaled_scene_buffer *scaled_buffer)
+{
+	struct scaled_rect_buffer *self = scaled_buffer->data;
+
+	uint32_t hash = LAB_SCALED_BUFFER_HASH_INIT;
+	hash = scaled_scene_buffer_hash(hash, &self->width, sizeof(self->width));
+	hash = scaled_scene_buffer_hash(hash, &self->height, sizeof(self->height));
+	hash = scaled_scene_buffer_hash(hash, &self->border_width, sizeof(self->border_width));
+	hash = scaled_scene_buffer_hash(hash, self->fill_color, sizeof(self->fill_color));
+	return scaled_scene_buffer_hash(hash, self->border_color, sizeof(self->border_color));
+}
+
 static const struct scaled_scene_buffer_impl impl = {
+	.name = "rect",
 	.create_buffer = _create_buffer,
 	.destroy = _destroy,
 	.equal = _equal,
+	.hash = _hash,
 };
 
 struct scaled_rect_buffer *scaled_rect_buffer_create(
@@ -114,3 +131,63 @@ struct scaled_rect_buffer *scaled_rect_buffer_create(
 
 	return self;
 }
+
+static void
+handle_native_destroy(struct wl_listener *listener, void *data)
+{
+	struct scaled_rect_buffer *self =
+		wl_container_of(listener, self, destroy);
+	wl_list_remove(&self->destroy.link);
+	free(self);
+}
+
+struct scaled_rect_buffer *
+scaled_rect_buffer_create_native(struct wlr_scene_tree *parent, int width,
+		int height, int border_width, float fill_color[4],
+		float border_color[4])
+{
+	assert(parent);
+	assert(width >= 0 && height >= 0);
+
+	struct scaled_rect_buffer *self = znew(*self);
+	self->tree = wlr_scene_tree_create(parent);
+	self->destroy.notify = handle_native_destroy;
+	wl_signal_add(&self->tree->node.events.destroy, &self->destroy);
+	self->width = width;
+	self->height = height;
+	self->border_width = border_width;
+	memcpy(self->fill_color, fill_color, sizeof(self->fill_color));
+	memcpy(self->border_color, border_color, sizeof(self->border_color));
+
+	/* The border is drawn over the fill by cairo, here they abut */
+	int bw = MIN(border_width, MIN(width, height) / 2);
+	if (fill_color[3] > 0 && width > 2 * bw && height > 2 * bw) {
+		self->fill = wlr_scene_rect_create(self->tree,
+			width - 2 * bw, height - 2 * bw, fill_color);
+		wlr_scene_node_set_position(&self->fill->node, bw, bw);
+	}
+	if (bw <= 0 || border_color[3] <= 0) {
+		return self;
+	}
+
+	/*
+	 * +---------+
+	 * +-+-----+-+
+	 * | |     | |
+	 * +-+-----+-+
+	 * +---------+
+	 */
+	struct wlr_box boxes[4] = {
+		{ 0, 0, width, bw },
+		{ 0, height - bw, width, bw },
+		{ 0, bw, bw, height - 2 * bw },
+		{ width - bw, bw, bw, height - 2 * bw },
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(boxes); i++) {
+		self->borders[i] = wlr_scene_rect_create(self->tree,
+			boxes[i].width, boxes[i].height, border_color);
+		wlr_scene_node_set_position(&self->borders[i]->node,
+			boxes[i].x, boxes[i].y);
+	}
+	return self;
+}
@@ -1,7 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <glib.h>
+#include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_output.h>
@@ -12,7 +15,9 @@
 #include "common/macros.h"
 #include "common/mem.h"
 #include "common/scaled-scene-buffer.h"
+#include "config/rcxml.h"
 #include "node.h"
+#include "render-pool.h"
 
 /*
  * This holds all the scaled_scene_buffers from all the implementers.
@@ -20,11 +25,112 @@
  */
 static struct wl_list all_scaled_buffers = WL_LIST_INIT(&all_scaled_buffers);
 
+/*
+ * Cache entries of scaled_scene_buffers with impl->hash(), by impl, hash
+ * and scale. Entries with colliding keys share a share_index_entry.
+ */
+struct share_index_entry {
+	guint key;
+	struct wl_list cache_entries; /* struct scaled_scene_buffer_cache_entry.share_link */
+};
+
+static GHashTable *share_index;
+
+/* All cache entries of all scaled_scene_buffers, most recently used first */
+static struct wl_list cache_lru = WL_LIST_INIT(&cache_lru);
+
+static struct scaled_scene_buffer_stats cache_stats;
+
+/* A buffer rendered by impl->render_async() */
+struct scaled_scene_buffer_job {
+	/* Main thread only, NULL once the result is not wanted anymore */
+	struct scaled_scene_buffer *owner;
+	const struct scaled_scene_buffer_impl *impl;
+	uint32_t hash;
+	/* Read by the worker */
+	void *state;
+	int width;
+	int height;
+	double scale;
+	/* Written by the worker */
+	cairo_surface_t *surface;
+};
+
 /* Internal API */
+static guint
+share_key(const struct scaled_scene_buffer_impl *impl, uint32_t hash,
+		double scale)
+{
+	hash = scaled_scene_buffer_hash(hash, &impl, sizeof(impl));
+	return scaled_scene_buffer_hash(hash, &scale, sizeof(scale));
+}
+
+static void
+share_index_add(struct scaled_scene_buffer_cache_entry *cache_entry,
+		uint32_t hash)
+{
+	if (!share_index) {
+		share_index = g_hash_table_new_full(g_direct_hash,
+			g_direct_equal, NULL, free);
+	}
+	guint key = share_key(cache_entry->owner->impl, hash, cache_entry->scale);
+	struct share_index_entry *entry =
+		g_hash_table_lookup(share_index, GUINT_TO_POINTER(key));
+	if (!entry) {
+		entry = znew(*entry);
+		entry->key = key;
+		wl_list_init(&entry->cache_entries);
+		g_hash_table_insert(share_index, GUINT_TO_POINTER(key), entry);
+	}
+	wl_list_insert(&entry->cache_entries, &cache_entry->share_link);
+	cache_entry->share = entry;
+}
+
+static void
+share_index_remove(struct scaled_scene_buffer_cache_entry *cache_entry)
+{
+	struct share_index_entry *entry = cache_entry->share;
+	if (!entry) {
+		return;
+	}
+	wl_list_remove(&cache_entry->share_link);
+	cache_entry->share = NULL;
+	if (wl_list_empty(&entry->cache_entries)) {
+		g_hash_table_remove(share_index, GUINT_TO_POINTER(entry->key));
+	}
+}
+
+static struct scaled_scene_buffer_cache_entry *
+share_index_find(struct scaled_scene_buffer *self, uint32_t hash, double scale)
+{
+	if (!share_index) {
+		return NULL;
+	}
+	struct share_index_entry *entry = g_hash_table_lookup(share_index,
+		GUINT_TO_POINTER(share_key(self->impl, hash, scale)));
+	if (!entry) {
+		return NULL;
+	}
+	struct scaled_scene_buffer_cache_entry *cache_entry;
+	wl_list_for_each(cache_entry, &entry->cache_entries, share_link) {
+		struct scaled_scene_buffer *owner = cache_entry->owner;
+		if (owner != self && owner->impl == self->impl
+				&& cache_entry->scale == scale
+				&& self->impl->equal(self, owner)) {
+			return cache_entry;
+		}
+	}
+	return NULL;
+}
+
 static void
 _cache_entry_destroy(struct scaled_scene_buffer_cache_entry *cache_entry, bool drop_buffer)
 {
+	share_index_remove(cache_entry);
 	wl_list_remove(&cache_entry->link);
+	wl_list_remove(&cache_entry->lru_link);
+	cache_stats.bytes -= cache_entry->size;
+	cache_stats.entries--;
 	if (cache_entry->buffer) {
 		/* Allow the buffer to get dropped if there are no further consumers */
 		if (drop_buffer && !cache_entry->buffer->dropped) {
@@ -47,6 +153,113 @@ find_cache_for_scale(struct scaled_scene_buffer *scene_buffer, double scale)
 	return NULL;
 }
 
+static void
+cache_entry_touch(struct scaled_scene_buffer_cache_entry *cache_entry)
+{
+	/* LRU cache, recently used in front */
+	wl_list_remove(&cache_entry->link);
+	wl_list_insert(&cache_entry->owner->cache, &cache_entry->link);
+	wl_list_remove(&cache_entry->lru_link);
+	wl_list_insert(&cache_lru, &cache_entry->lru_link);
+}
+
+/* Evict least recently used buffers which are not shown anymore */
+static void
+cache_evict(void)
+{
+	size_t budget = (size_t)rc.buffer_cache_size << 20;
+	struct scaled_scene_buffer_cache_entry *cache_entry, *tmp;
+	wl_list_for_each_reverse_safe(cache_entry, tmp, &cache_lru, lru_link) {
+		if (cache_stats.bytes <= budget) {
+			break;
+		}
+		struct scaled_scene_buffer *owner = cache_entry->owner;
+		if (cache_entry->scale == owner->active_scale) {
+			continue;
+		}
+		_cache_entry_destroy(cache_entry, owner->drop_buffer);
+		cache_stats.evictions++;
+	}
+}
+
+static void add_cache_entry(struct scaled_scene_buffer *self, double scale,
+	struct wlr_buffer *wlr_buffer, uint32_t hash);
+
+/* Drop the job of @self, which may still be rendering */
+static void
+job_abandon(struct scaled_scene_buffer *self)
+{
+	if (self->job) {
+		self->job->owner = NULL;
+		self->job = NULL;
+	}
+}
+
+/* Worker thread */
+static void
+job_render(void *data)
+{
+	struct scaled_scene_buffer_job *job = data;
+	job->surface = job->impl->render_async(job->state, job->width,
+		job->height, job->scale);
+}
+
+static void
+job_done(void *data)
+{
+	struct scaled_scene_buffer_job *job = data;
+	struct scaled_scene_buffer *self = job->owner;
+	if (self) {
+		self->job = NULL;
+		struct wlr_buffer *wlr_buffer = NULL;
+		if (job->surface) {
+			struct lab_data_buffer *buffer =
+				buffer_adopt_cairo_surface(job->surface);
+			buffer->logical_width = job->width;
+			buffer->logical_height = job->height;
+			job->surface = NULL;
+			wlr_buffer = &buffer->base;
+		} else {
+			/* The same as a NULL buffer from impl->create_buffer() */
+			self->width = 0;
+			self->height = 0;
+		}
+		add_cache_entry(self, job->scale, wlr_buffer, job->hash);
+	}
+	if (job->surface) {
+		cairo_surface_destroy(job->surface);
+	}
+	job->impl->free_async(job->state);
+	free(job);
+}
+
+static bool
+render_async(struct scaled_scene_buffer *self, double scale, uint32_t hash)
+{
+	if (self->job && self->job->scale == scale) {
+		/* Already being rendered */
+		return true;
+	}
+	job_abandon(self);
+
+	struct scaled_scene_buffer_job *job = znew(*job);
+	job->owner = self;
+	job->impl = self->impl;
+	job->hash = hash;
+	job->state = self->impl->prepare_async(self);
+	job->width = self->width;
+	job->height = self->height;
+	job->scale = scale;
+	if (!render_pool_submit(job_render, job_done, job)) {
+		self->impl->free_async(job->state);
+		free(job);
+		return false;
+	}
+	self->job = job;
+	cache_stats.misses++;
+	return true;
+}
+
 static void
 _update_buffer(struct scaled_scene_buffer *self, double scale)
 {
@@ -56,9 +269,9 @@ _update_buffer(struct scaled_scene_buffer *self, double scale)
 	struct scaled_scene_buffer_cache_entry *cache_entry =
 		find_cache_for_scale(self, scale);
 	if (cache_entry) {
-		/* LRU cache, recently used in front */
-		wl_list_remove(&cache_entry->link);
-		wl_list_insert(&self->cache, &cache_entry->link);
+		job_abandon(self);
+		cache_stats.hits++;
+		cache_entry_touch(cache_entry);
 		wlr_scene_buffer_set_buffer(self->scene_buffer, cache_entry->buffer);
 		/*
 		 * If found in our local cache,
@@ -69,8 +282,19 @@ _update_buffer(struct scaled_scene_buffer *self, double scale)
 	}
 
 	struct wlr_buffer *wlr_buffer = NULL;
+	uint32_t hash = self->impl->hash ? self->impl->hash(self) : 0;
 
-	if (self->impl->equal) {
+	if (self->impl->hash) {
+		cache_entry = share_index_find(self, hash, scale);
+		if (cache_entry) {
+			/* Ensure self->width and self->height are set correctly */
+			self->width = cache_entry->owner->width;
+			self->height = cache_entry->owner->height;
+			wlr_buffer = cache_entry->buffer;
+			cache_stats.shared++;
+			cache_entry_touch(cache_entry);
+		}
+	} else if (self->impl->equal) {
 		/* Search from other cached scaled-scene-buffers */
 		struct scaled_scene_buffer *scene_buffer;
 		wl_list_for_each(scene_buffer, &all_scaled_buffers, link) {
@@ -92,10 +316,19 @@ _update_buffer(struct scaled_scene_buffer *self, double scale)
 			self->width = scene_buffer->width;
 			self->height = scene_buffer->height;
 			wlr_buffer = cache_entry->buffer;
+			cache_stats.shared++;
+			cache_entry_touch(cache_entry);
 			break;
 		}
 	}
 
+	if (!wlr_buffer && self->impl->render_async
+			&& self->scene_buffer->buffer
+			&& render_async(self, scale, hash)) {
+		/* Keep showing the old buffer until the new one is ready */
+		return;
+	}
+
 	if (!wlr_buffer) {
 		/*
 		 * Create new buffer, will get destroyed along the backing
@@ -103,6 +336,7 @@ _update_buffer(struct scaled_scene_buffer *self, double scale)
 		 */
 		struct lab_data_buffer *buffer =
 			self->impl->create_buffer(self, scale);
+		cache_stats.misses++;
 		if (buffer) {
 			self->width = buffer->logical_width;
 			self->height = buffer->logical_height;
@@ -112,30 +346,36 @@ _update_buffer(struct scaled_scene_buffer *self, double scale)
 			self->height = 0;
 		}
 	}
+	job_abandon(self);
+	add_cache_entry(self, scale, wlr_buffer, hash);
+}
+
+static void
+add_cache_entry(struct scaled_scene_buffer *self, double scale,
+		struct wlr_buffer *wlr_buffer, uint32_t hash)
+{
 	if (wlr_buffer) {
 		/* Ensure the buffer doesn't get deleted behind our back */
 		wlr_buffer_lock(wlr_buffer);
 	}
 
-	/* Create or reuse cache entry */
-	if (wl_list_length(&self->cache) < LAB_SCALED_BUFFER_MAX_CACHE) {
-		cache_entry = znew(*cache_entry);
-	} else {
-		cache_entry = wl_container_of(self->cache.prev, cache_entry, link);
-		if (cache_entry->buffer) {
-			/* Allow the old buffer to get dropped if there are no further consumers */
-			if (self->drop_buffer && !cache_entry->buffer->dropped) {
-				wlr_buffer_drop(cache_entry->buffer);
-			}
-			wlr_buffer_unlock(cache_entry->buffer);
-		}
-		wl_list_remove(&cache_entry->link);
-	}
-
-	/* Update the cache entry */
+	/* Create the cache entry */
+	struct scaled_scene_buffer_cache_entry *cache_entry = znew(*cache_entry);
+	cache_entry->owner = self;
 	cache_entry->scale = scale;
 	cache_entry->buffer = wlr_buffer;
+	if (wlr_buffer) {
+		cache_entry->size = (size_t)wlr_buffer->width * wlr_buffer->height * 4;
+	}
 	wl_list_insert(&self->cache, &cache_entry->link);
+	wl_list_insert(&cache_lru, &cache_entry->lru_link);
+	/* Buffers excluded from sharing by invalidate_sharing() stay so */
+	if (self->impl->hash && !wl_list_empty(&self->link)) {
+		share_index_add(cache_entry, hash);
+	}
+	cache_stats.bytes += cache_entry->size;
+	cache_stats.entries++;
+	cache_evict();
 
 	/* And finally update the wlr_scene_buffer itself */
 	wlr_scene_buffer_set_buffer(self->scene_buffer, cache_entry->buffer);
@@ -151,6 +391,7 @@ _handle_node_destroy(struct wl_listener *listener, void *data)
 
 	wl_list_remove(&self->destroy.link);
 	wl_list_remove(&self->outputs_update.link);
+	job_abandon(self);
 
 	wl_list_for_each_safe(cache_entry, cache_entry_tmp, &self->cache, link) {
 		_cache_entry_destroy(cache_entry, self->drop_buffer);
@@ -164,6 +405,19 @@ _handle_node_destroy(struct wl_listener *listener, void *data)
 	free(self);
 }
 
+static bool
+scene_has_scale(struct wlr_scene *scene, double scale)
+{
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		if (scene_output->output->enabled
+				&& scene_output->output->scale == scale) {
+			return true;
+		}
+	}
+	return false;
+}
+
 static void
 _handle_outputs_update(struct wl_listener *listener, void *data)
 {
@@ -175,9 +429,24 @@ _handle_outputs_update(struct wl_listener *listener, void *data)
 	for (size_t i = 0; i < event->size; i++) {
 		max_scale = MAX(max_scale, event->active[i]->output->scale);
 	}
-	if (max_scale && self->active_scale != max_scale) {
-		_update_buffer(self, max_scale);
+	if (!max_scale || self->active_scale == max_scale) {
+		return;
+	}
+
+	/*
+	 * Keep showing the buffer of a higher scale seen before, scaled
+	 * down, while an output with that scale still exists. Dragging a
+	 * view back and forth between outputs of different scales then
+	 * keeps one buffer rather than switching (and possibly rendering)
+	 * it on every crossing. Only once the set of output scales has
+	 * changed is the buffer rendered for the outputs it is on again.
+	 */
+	if (max_scale < self->active_scale
+			&& scene_has_scale(event->active[0]->scene,
+				self->active_scale)) {
+		return;
 	}
+	_update_buffer(self, max_scale);
 }
 
 /* Public API */
@@ -230,6 +499,9 @@ scaled_scene_buffer_request_update(struct scaled_scene_buffer *self,
 	assert(width >= 0);
 	assert(height >= 0);
 
+	/* A buffer being rendered has the old content */
+	job_abandon(self);
+
 	struct scaled_scene_buffer_cache_entry *cache_entry, *cache_entry_tmp;
 	wl_list_for_each_safe(cache_entry, cache_entry_tmp, &self->cache, link) {
 		_cache_entry_destroy(cache_entry, self->drop_buffer);
@@ -240,9 +512,12 @@ scaled_scene_buffer_request_update(struct scaled_scene_buffer *self,
 	 * Tell wlroots about the buffer size so we can receive output_enter
 	 * events even when the actual backing buffer is not set yet.
 	 * The buffer size set here is updated when the backing buffer is
-	 * created in _update_buffer().
+	 * created in _update_buffer(). A buffer still shown while the new
+	 * one is rendered asynchronously keeps its size until then.
 	 */
-	wlr_scene_buffer_set_dest_size(self->scene_buffer, width, height);
+	if (!self->impl->render_async || !self->scene_buffer->buffer) {
+		wlr_scene_buffer_set_dest_size(self->scene_buffer, width, height);
+	}
 	self->width = width;
 	self->height = height;
 
@@ -255,6 +530,43 @@ scaled_scene_buffer_request_update(struct scaled_scene_buffer *self,
 	}
 }
 
+void
+scaled_scene_buffer_log_stats(void)
+{
+	wlr_log(WLR_INFO, "scaled buffer cache: %zu buffers, %zu KiB of %d MiB, "
+		"%" PRIu64 " hits, %" PRIu64 " shared, %" PRIu64 " misses, "
+		"%" PRIu64 " evictions", cache_stats.entries,
+		cache_stats.bytes >> 10, rc.buffer_cache_size, cache_stats.hits,
+		cache_stats.shared, cache_stats.misses, cache_stats.evictions);
+}
+
+const struct scaled_scene_buffer_stats *
+scaled_scene_buffer_get_stats(void)
+{
+	return &cache_stats;
+}
+
+uint32_t
+scaled_scene_buffer_hash(uint32_t hash, const void *data, size_t len)
+{
+	/* FNV-1a */
+	const unsigned char *bytes = data;
+	for (size_t i = 0; i < len; i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+uint32_t
+scaled_scene_buffer_hash_str(uint32_t hash, const char *str)
+{
+	if (!str) {
+		return scaled_scene_buffer_hash(hash, "", 1);
+	}
+	/* Include the terminating NUL so that "a" + "bc" != "ab" + "c" */
+	return scaled_scene_buffer_hash(hash, str, strlen(str) + 1);
+}
+
 void
 scaled_scene_buffer_invalidate_sharing(void)
 {
@@ -263,4 +575,20 @@ scaled_scene_buffer_invalidate_sharing(void)
 		wl_list_remove(&scene_buffer->link);
 		wl_list_init(&scene_buffer->link);
 	}
+
+	if (share_index) {
+		GHashTableIter iter;
+		gpointer value;
+		g_hash_table_iter_init(&iter, share_index);
+		while (g_hash_table_iter_next(&iter, NULL, &value)) {
+			struct share_index_entry *entry = value;
+			struct scaled_scene_buffer_cache_entry *cache_entry, *next;
+			wl_list_for_each_safe(cache_entry, next,
+					&entry->cache_entries, share_link) {
+				wl_list_remove(&cache_entry->share_link);
+				cache_entry->share = NULL;
+			}
+		}
+		g_hash_table_remove_all(share_index);
+	}
 }
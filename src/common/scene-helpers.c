@@ -6,10 +6,13 @@
 #include <wlr/util/log.h>
 #include <wlr/util/region.h>
 #include <wlr/util/transform.h>
+#include "capture.h"
 #include "common/scene-helpers.h"
 #include "labwc.h"
 #include "magnifier.h"
 #include "output-state.h"
+#include "output-timing.h"
+#include "trace.h"
 
 struct wlr_surface *
 lab_wlr_surface_from_node(struct wlr_scene_node *node)
@@ -42,29 +45,48 @@ lab_wlr_scene_get_prev_node(struct wlr_scene_node *node)
 /*
  * This is a slightly modified copy of scene_output_damage(),
  * required to properly add the magnifier damage to scene_output
- * ->damage_ring and scene_output->pending_commit_damage.
+ * ->damage_ring and optionally to scene_output->pending_commit_damage.
  *
- * The only difference is code style and removal of wlr_output_schedule_frame().
+ * The only difference is code style, the @commit argument and removal
+ * of wlr_output_schedule_frame().
  */
 static void
 scene_output_damage(struct wlr_scene_output *scene_output,
-		const pixman_region32_t *damage)
+		const struct wlr_box *box, bool commit)
 {
 	struct wlr_output *output = scene_output->output;
 
 	pixman_region32_t clipped;
-	pixman_region32_init(&clipped);
-	pixman_region32_intersect_rect(&clipped, damage, 0, 0, output->width, output->height);
+	pixman_region32_init_rect(&clipped, box->x, box->y,
+		box->width, box->height);
+	pixman_region32_intersect_rect(&clipped, &clipped, 0, 0,
+		output->width, output->height);
 
 	if (pixman_region32_not_empty(&clipped)) {
 		wlr_damage_ring_add(&scene_output->damage_ring, &clipped);
-		pixman_region32_union(&scene_output->WLR_PRIVATE.pending_commit_damage,
-			&scene_output->WLR_PRIVATE.pending_commit_damage, &clipped);
+		if (commit) {
+			pixman_region32_union(
+				&scene_output->WLR_PRIVATE.pending_commit_damage,
+				&scene_output->WLR_PRIVATE.pending_commit_damage,
+				&clipped);
+		}
 	}
 
 	pixman_region32_fini(&clipped);
 }
 
+void
+lab_wlr_scene_output_damage_whole(struct wlr_scene_output *scene_output)
+{
+	struct wlr_output *output = scene_output->output;
+	struct wlr_box box = {
+		.width = output->width,
+		.height = output->height,
+	};
+	scene_output_damage(scene_output, &box, /* commit */ true);
+	wlr_output_schedule_frame(output);
+}
+
 /*
  * This is a copy of wlr_scene_output_commit()
  * as it doesn't use the pending state at all.
@@ -73,52 +95,104 @@ bool
 lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output,
 		struct wlr_output_state *state)
 {
+	TRACE_FUNC();
 	assert(scene_output);
 	assert(state);
 	struct wlr_output *wlr_output = scene_output->output;
 	struct output *output = wlr_output->data;
-	bool wants_magnification = output_wants_magnification(output);
-
 	/*
-	 * FIXME: Regardless of wants_magnification, we are currently adding
-	 * damages to next frame when magnifier is shown, which forces
-	 * rendering on every output commit and overloads CPU.
-	 * We also need to verify the necessity of wants_magnification.
+	 * The magnifier is only redrawn on its own when the cursor moved or
+	 * the magnification changed. Scene damage within the magnified area
+	 * causes a regular render which redraws the magnifier anyway.
 	 */
+	bool wants_magnification = output_wants_magnification(output);
+
 	if (!wlr_output->needs_frame
 			&& !pixman_region32_not_empty(
 				&scene_output->WLR_PRIVATE.pending_commit_damage)
+			&& !(state->committed & WLR_OUTPUT_STATE_GAMMA_LUT)
 			&& !wants_magnification) {
+		output->metrics.frames_skipped++;
 		return true;
 	}
 
-	if (!wlr_scene_output_build_state(scene_output, state, NULL)) {
+	if (wants_magnification && !wlr_box_empty(&output->magnifier_box)) {
+		/* Restore the area covered by the magnifier in the last frame */
+		scene_output_damage(scene_output, &output->magnifier_box,
+			/* commit */ true);
+	}
+
+	/*
+	 * Without hardware gamma support the LUT is applied by the renderer
+	 * as part of the same render pass. The magnifier copies from the
+	 * resulting buffer, so the magnified area is corrected as well.
+	 */
+	struct wlr_scene_output_state_options options = {
+		.color_transform = output->gamma_transform,
+	};
+
+	output_timing_phase_end(output, LAB_FRAME_PHASE_WAIT);
+	if (!wlr_scene_output_build_state(scene_output, state, &options)) {
 		wlr_log(WLR_ERROR, "Failed to build output state for %s",
 			wlr_output->name);
+		output->metrics.commit_failures++;
 		return false;
 	}
+	output_timing_phase_end(output, output->gamma_transform
+		? LAB_FRAME_PHASE_BUILD_GAMMA : LAB_FRAME_PHASE_BUILD);
+	scanout_update(output, state);
+
+	/*
+	 * Tearing enabled by window rule only while the view is scanned out,
+	 * a composited frame presented mid-scanout gains little latency.
+	 */
+	if (state->tearing_page_flip && output->tearing.needs_scanout
+			&& output->scanout.last != LAB_SCANOUT_HIT) {
+		state->tearing_page_flip = false;
+	}
 
 	if (state->tearing_page_flip) {
 		if (!wlr_output_test_state(wlr_output, state)) {
 			state->tearing_page_flip = false;
+			tearing_commit_result(output, /*torn*/ false);
 		}
+		output_timing_phase_end(output, LAB_FRAME_PHASE_TEARING);
 	}
 
 	struct wlr_box additional_damage = {0};
 	if (state->buffer && magnifier_is_enabled()) {
+		output_timing_phase_begin(output);
 		magnifier_draw(output, state->buffer, &additional_damage);
+		output_timing_phase_end(output, LAB_FRAME_PHASE_MAGNIFIER);
+		if (!wlr_box_empty(&additional_damage)
+				&& (state->committed & WLR_OUTPUT_STATE_DAMAGE)) {
+			pixman_region32_union_rect(&state->damage,
+				&state->damage, additional_damage.x,
+				additional_damage.y, additional_damage.width,
+				additional_damage.height);
+		}
 	}
 
+	output_timing_phase_begin(output);
 	bool committed = wlr_output_commit_state(wlr_output, state);
+	output_timing_phase_end(output, LAB_FRAME_PHASE_COMMIT);
 	/*
 	 * Handle case where the output state test for tearing succeeded,
 	 * but actual commit failed. Retry without tearing.
 	 */
 	if (!committed && state->tearing_page_flip) {
 		state->tearing_page_flip = false;
+		tearing_commit_result(output, /*torn*/ false);
 		committed = wlr_output_commit_state(wlr_output, state);
+		output_timing_phase_end(output, LAB_FRAME_PHASE_TEARING);
 	}
 	if (committed) {
+		output->metrics.frames_rendered++;
+		if (state->tearing_page_flip) {
+			tearing_commit_result(output, /*torn*/ true);
+		}
+		output_timing_committed(output);
+		capture_output_commit(output, state);
 		if (state == &output->pending) {
 			wlr_output_state_finish(&output->pending);
 			wlr_output_state_init(&output->pending);
@@ -126,17 +200,20 @@ lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output,
 	} else {
 		wlr_log(WLR_INFO, "Failed to commit output %s",
 			wlr_output->name);
+		output->metrics.commit_failures++;
 		return false;
 	}
 
+	/*
+	 * Only add the magnifier area to the damage ring so that it gets
+	 * repainted when one of the current buffers is reused, but don't
+	 * force another frame by adding it to the pending commit damage.
+	 */
 	if (!wlr_box_empty(&additional_damage)) {
-		pixman_region32_t region;
-		pixman_region32_init_rect(&region,
-			additional_damage.x, additional_damage.y,
-			additional_damage.width, additional_damage.height);
-		scene_output_damage(scene_output, &region);
-		pixman_region32_fini(&region);
+		scene_output_damage(scene_output, &additional_damage,
+			/* commit */ false);
 	}
+	output->magnifier_box = additional_damage;
 
 	return true;
 }
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/* cpu_set_t and SCHED_RESET_ON_FORK */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <wlr/util/log.h>
+#include "common/bitset.h"
+#include "common/buf.h"
+#include "common/sched-util.h"
+
+static bool pinned;
+static cpu_set_t original_cpus;
+static cpu_set_t pinned_cpus;
+
+void
+set_scheduling(enum lab_sched_policy policy, int priority, int nice)
+{
+	if (policy == LAB_SCHED_OTHER) {
+		if (!nice) {
+			return;
+		}
+		/* Resets a negative nice value to 0 in children */
+		struct sched_param param = {0};
+		if (sched_setscheduler(0, SCHED_OTHER | SCHED_RESET_ON_FORK,
+				&param) < 0) {
+			wlr_log_errno(WLR_ERROR, "cannot set SCHED_RESET_ON_FORK");
+			return;
+		}
+		if (setpriority(PRIO_PROCESS, 0, nice) < 0) {
+			wlr_log_errno(WLR_ERROR, "cannot set nice value %d", nice);
+			return;
+		}
+		wlr_log(WLR_INFO, "running with nice value %d", nice);
+		return;
+	}
+
+	int sched_policy = policy == LAB_SCHED_FIFO ? SCHED_FIFO : SCHED_RR;
+	const char *name = policy == LAB_SCHED_FIFO ? "SCHED_FIFO" : "SCHED_RR";
+	int min = sched_get_priority_min(sched_policy);
+	int max = sched_get_priority_max(sched_policy);
+	struct sched_param param = {
+		.sched_priority = priority < min ? min
+			: priority > max ? max : priority,
+	};
+	if (sched_setscheduler(0, sched_policy | SCHED_RESET_ON_FORK,
+			&param) < 0) {
+		/* Mostly EPERM without CAP_SYS_NICE or RLIMIT_RTPRIO */
+		wlr_log_errno(WLR_ERROR, "cannot run with %s priority %d",
+			name, param.sched_priority);
+		return;
+	}
+	wlr_log(WLR_INFO, "running with %s priority %d", name,
+		param.sched_priority);
+}
+
+void
+pin_cpu_affinity(const struct lab_bitset *cpus)
+{
+	if (sched_getaffinity(0, sizeof(original_cpus), &original_cpus) < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot get CPU affinity");
+		return;
+	}
+
+	CPU_ZERO(&pinned_cpus);
+	struct buf list = BUF_INIT;
+	lab_bitset_for_each(cpu, cpus) {
+		if (cpu >= CPU_SETSIZE) {
+			break;
+		}
+		CPU_SET(cpu, &pinned_cpus);
+		buf_add_fmt(&list, "%s%d", list.len ? "," : "", cpu);
+	}
+	if (sched_setaffinity(0, sizeof(pinned_cpus), &pinned_cpus) < 0) {
+		/* EINVAL if none of @cpus is online */
+		wlr_log_errno(WLR_ERROR, "cannot pin to CPUs %s", list.data);
+	} else {
+		pinned = true;
+		wlr_log(WLR_INFO, "pinned to CPUs %s", list.data);
+	}
+	buf_reset(&list);
+}
+
+void
+unpin_cpu_affinity(void)
+{
+	if (pinned) {
+		sched_setaffinity(0, sizeof(original_cpus), &original_cpus);
+	}
+}
+
+void
+repin_cpu_affinity(void)
+{
+	if (pinned) {
+		sched_setaffinity(0, sizeof(pinned_cpus), &pinned_cpus);
+	}
+}
+
+void
+lock_memory(void)
+{
+	/*
+	 * Only the current pages: with MCL_FUTURE, mappings made later, like
+	 * client buffers, would fail once RLIMIT_MEMLOCK is reached.
+	 */
+	if (mlockall(MCL_CURRENT) < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot lock memory");
+		return;
+	}
+	wlr_log(WLR_INFO, "locked memory");
+}
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <math.h>
+#include <string.h>
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/shadow.h"
+
+double *
+shadow_profile(int total_size)
+{
+	/* Standard deviation normalised against the shadow width, squared */
+	double variance = 0.3 * 0.3;
+
+	double *profile = znew_n(*profile, total_size);
+	for (int i = 0; i < total_size; i++) {
+		/* Distance normalised against total shadow width */
+		double n = (double)i / (double)total_size;
+		/* Gaussian dropoff */
+		profile[i] = exp(-(n * n) / variance);
+	}
+	return profile;
+}
+
+/* ARGB8888 in native endianness, as used by cairo image surfaces */
+static uint32_t
+shadow_pixel(const float color[4], double alpha)
+{
+	/* RGBA values are all pre-multiplied */
+	uint32_t a = (uint8_t)(color[3] * alpha * 255);
+	uint32_t r = (uint8_t)(color[0] * alpha * 255);
+	uint32_t g = (uint8_t)(color[1] * alpha * 255);
+	uint32_t b = (uint8_t)(color[2] * alpha * 255);
+	return a << 24 | r << 16 | g << 8 | b;
+}
+
+void
+shadow_edge_gradient(uint32_t *pixels, const double *profile,
+		int visible_size, int total_size, const float start_color[4])
+{
+	/* Inset portion which is obscured */
+	int inset = total_size - visible_size;
+
+	/*
+	 * We add on inset here because we don't bother drawing inset for the
+	 * edge shadow buffers but still need the pattern to line up with the
+	 * corner shadow buffers which do have inset drawn.
+	 */
+	for (int x = 0; x < visible_size; x++) {
+		pixels[x] = shadow_pixel(start_color, profile[x + inset]);
+	}
+}
+
+void
+shadow_corner_gradient(uint32_t *pixels, size_t stride, const double *profile,
+		int visible_size, int total_size, int titlebar_height,
+		const float start_color[4])
+{
+	int inset = total_size - visible_size;
+
+	for (int y = 0; y < total_size; y++) {
+		uint32_t *pixel_row =
+			(uint32_t *)((unsigned char *)pixels + y * stride);
+
+		/*
+		 * Erase the L-shaped region which could be visible through a
+		 * transparent window but not obscured by the titlebar. If
+		 * inset is smaller than the titlebar height then there's
+		 * nothing to do, this is handled by (inset - titlebar_height)
+		 * being negative.
+		 */
+		int erase = 0;
+		if (y < inset - titlebar_height) {
+			erase = inset;
+		} else if (y < inset) {
+			erase = MAX(inset - titlebar_height, 0);
+		}
+		memset(pixel_row, 0, erase * sizeof(*pixel_row));
+
+		/*
+		 * For Gaussian drop-off in 2d you can just calculate the outer
+		 * product of the horizontal and vertical profiles.
+		 */
+		double gauss_y = profile[y];
+		for (int x = erase; x < total_size; x++) {
+			pixel_row[x] = shadow_pixel(start_color,
+				profile[x] * gauss_y);
+		}
+	}
+}
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <string.h>
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/slab.h"
+
+/* Objects are handed out in chunks of about this size, at least 8 */
+#define SLAB_CHUNK_BYTES (4 * 1024)
+#define SLAB_CHUNK_MIN_OBJECTS 8
+
+#ifndef NDEBUG
+#define SLAB_POISON 0x6b
+#endif
+
+struct lab_slab_chunk {
+	struct lab_slab_chunk *next;
+	alignas(max_align_t) unsigned char data[];
+};
+
+/* Overlays the start of a freed object */
+struct lab_slab_free {
+	struct lab_slab_free *next;
+};
+
+static size_t
+object_size(const struct lab_slab *slab)
+{
+	size_t size = MAX(slab->size, sizeof(struct lab_slab_free));
+	return (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+}
+
+static void
+poison(const struct lab_slab *slab, struct lab_slab_free *object)
+{
+#ifndef NDEBUG
+	memset(object + 1, SLAB_POISON, object_size(slab) - sizeof(*object));
+#endif
+}
+
+static void
+check_poison(const struct lab_slab *slab, const struct lab_slab_free *object)
+{
+#ifndef NDEBUG
+	const unsigned char *bytes = (const unsigned char *)(object + 1);
+	for (size_t i = 0; i < object_size(slab) - sizeof(*object); i++) {
+		assert(bytes[i] == SLAB_POISON && "slab object written after free");
+	}
+#endif
+}
+
+static void
+add_chunk(struct lab_slab *slab)
+{
+	size_t size = object_size(slab);
+	size_t count = MAX(SLAB_CHUNK_BYTES / size,
+		(size_t)SLAB_CHUNK_MIN_OBJECTS);
+	struct lab_slab_chunk *chunk = xzalloc(sizeof(*chunk) + count * size);
+	chunk->next = slab->chunks;
+	slab->chunks = chunk;
+
+	/* In reverse, so that objects are handed out in address order */
+	for (size_t i = count; i-- > 0;) {
+		struct lab_slab_free *object =
+			(struct lab_slab_free *)(chunk->data + i * size);
+		object->next = slab->free;
+		poison(slab, object);
+		slab->free = object;
+	}
+}
+
+void *
+lab_slab_alloc(struct lab_slab *slab)
+{
+	assert(slab && slab->size);
+	if (!slab->free) {
+		add_chunk(slab);
+	}
+	struct lab_slab_free *object = slab->free;
+	check_poison(slab, object);
+	slab->free = object->next;
+	slab->nr_live++;
+	memset(object, 0, object_size(slab));
+	return object;
+}
+
+void
+lab_slab_free(struct lab_slab *slab, void *ptr)
+{
+	if (!ptr) {
+		return;
+	}
+	assert(slab->nr_live > 0);
+	struct lab_slab_free *object = ptr;
+	object->next = slab->free;
+	poison(slab, object);
+	slab->free = object;
+	slab->nr_live--;
+}
+
+void
+lab_slab_release(struct lab_slab *slab)
+{
+	struct lab_slab_chunk *chunk = slab->chunks;
+	while (chunk) {
+		struct lab_slab_chunk *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	slab->chunks = NULL;
+	slab->free = NULL;
+	slab->nr_live = 0;
+}
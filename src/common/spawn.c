@@ -1,28 +1,89 @@
 // SPDX-License-Identifier: GPL-2.0-only
-#define _POSIX_C_SOURCE 200809L
+/* POSIX_SPAWN_SETSID is a GNU extension in older glibc */
+#define _GNU_SOURCE
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <glib.h>
 #include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <wayland-server-core.h>
 #include <wlr/util/log.h>
 #include "common/spawn.h"
 #include "common/fd-util.h"
+#include "common/mem.h"
+#include "common/sched-util.h"
 
-static void
-reset_signals_and_limits(void)
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+struct child_watch {
+	pid_t pid;
+	int pidfd;
+	struct wl_event_source *source;
+	spawn_child_exit_func_t callback;
+	void *data;
+	struct wl_list link;
+};
+
+static struct wl_list child_watches = {
+	.prev = &child_watches,
+	.next = &child_watches,
+};
+
+extern char **environ;
+
+/*
+ * Children are created with posix_spawn() rather than fork(), which lets
+ * libc use clone(CLONE_VM | CLONE_VFORK) so that the cost of launching does
+ * not grow with the size of the compositor's address space. The state that
+ * used to be reset in the forked child is reset through spawn attributes:
+ * an empty signal mask and SIGPIPE back to its default disposition. The
+ * open-files limit and CPU affinity have no spawn attribute and are
+ * restored around the call.
+ */
+static pid_t
+spawn(const char *file, char *const argv[],
+		const posix_spawn_file_actions_t *actions, bool new_session)
 {
-	restore_nofile_limit();
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
 
 	sigset_t set;
 	sigemptyset(&set);
-	sigprocmask(SIG_SETMASK, &set, NULL);
+	posix_spawnattr_setsigmask(&attr, &set);
 
 	/* Restore ignored signals */
-	signal(SIGPIPE, SIG_DFL);
+	sigaddset(&set, SIGPIPE);
+	posix_spawnattr_setsigdefault(&attr, &set);
+
+	short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+	if (new_session) {
+		flags |= POSIX_SPAWN_SETSID;
+	}
+	posix_spawnattr_setflags(&attr, flags);
+
+	pid_t pid = -1;
+	restore_nofile_limit();
+	unpin_cpu_affinity();
+	int err = posix_spawnp(&pid, file, actions, &attr, argv, environ);
+	repin_cpu_affinity();
+	increase_nofile_limit();
+	posix_spawnattr_destroy(&attr);
+
+	if (err) {
+		wlr_log(WLR_ERROR, "unable to spawn %s: %s", file, strerror(err));
+		return -1;
+	}
+	return pid;
 }
 
 static bool
@@ -43,6 +104,20 @@ set_cloexec(int fd)
 	return true;
 }
 
+void
+spawn_async_argv(char *const argv[])
+{
+	assert(argv);
+	if (!argv[0]) {
+		return;
+	}
+	/*
+	 * The child is reaped by the generic SIGCHLD handler in
+	 * src/server.c, so no double-fork is needed to avoid zombies.
+	 */
+	spawn(argv[0], argv, NULL, /*new_session*/ true);
+}
+
 void
 spawn_async_no_shell(char const *command)
 {
@@ -59,34 +134,7 @@ spawn_async_no_shell(char const *command)
 		return;
 	}
 
-	/*
-	 * Avoid zombie processes by using a double-fork, whereby the
-	 * grandchild becomes orphaned & the responsibility of the OS.
-	 */
-	pid_t child = 0, grandchild = 0;
-
-	child = fork();
-	switch (child) {
-	case -1:
-		wlr_log(WLR_ERROR, "unable to fork()");
-		goto out;
-	case 0:
-		reset_signals_and_limits();
-
-		setsid();
-		grandchild = fork();
-		if (grandchild == 0) {
-			execvp(argv[0], argv);
-			_exit(0);
-		} else if (grandchild < 0) {
-			wlr_log(WLR_ERROR, "unable to fork()");
-		}
-		_exit(0);
-	default:
-		break;
-	}
-	waitpid(child, NULL, 0);
-out:
+	spawn_async_argv(argv);
 	g_strfreev(argv);
 }
 
@@ -106,23 +154,18 @@ spawn_primary_client(const char *command)
 		return -1;
 	}
 
-	pid_t child = fork();
-	switch (child) {
-	case -1:
-		wlr_log_errno(WLR_ERROR, "Failed to fork");
-		g_strfreev(argv);
-		return -1;
-	case 0:
-		/* child */
-		close(STDIN_FILENO);
-		reset_signals_and_limits();
-		execvp(argv[0], argv);
-		wlr_log_errno(WLR_ERROR, "Failed to execute primary client %s", command);
-		_exit(1);
-	default:
-		g_strfreev(argv);
-		return child;
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addclose(&actions, STDIN_FILENO);
+
+	pid_t child = spawn(argv[0], argv, &actions, /*new_session*/ false);
+	if (child < 0) {
+		wlr_log(WLR_ERROR, "Failed to execute primary client %s",
+			command);
 	}
+	posix_spawn_file_actions_destroy(&actions);
+	g_strfreev(argv);
+	return child;
 }
 
 pid_t
@@ -136,51 +179,30 @@ spawn_piped(const char *command, int *pipe_fd)
 		return -1;
 	}
 
-	pid_t pid = fork();
-	if (pid < 0) {
-		close(pipe_rw[0]);
-		close(pipe_rw[1]);
-		wlr_log(WLR_ERROR, "unable to fork()");
-		return pid;
-	}
-
-	if (pid == 0) {
-		/* child */
-		reset_signals_and_limits();
-
-		/*
-		 * replace stdin and stderr with /dev/null
-		 * and stdout with the write end of the pipe
-		 */
-		dup2(pipe_rw[1], STDOUT_FILENO);
-		close(pipe_rw[0]);
-		close(pipe_rw[1]);
-
-		int dev_null = open("/dev/null", O_RDWR);
-		if (dev_null < 0) {
-			wlr_log_errno(WLR_ERROR, "opening /dev/null failed");
-			/*
-			 * Just close stdin and stderr and
-			 * hope $command can deal with that.
-			 */
-			close(STDIN_FILENO);
-			close(STDERR_FILENO);
-		} else {
-			dup2(dev_null, STDIN_FILENO);
-			dup2(dev_null, STDERR_FILENO);
-			close(dev_null);
-		}
+	/*
+	 * Replace stdin and stderr with /dev/null
+	 * and stdout with the write end of the pipe
+	 */
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, pipe_rw[1], STDOUT_FILENO);
+	posix_spawn_file_actions_addclose(&actions, pipe_rw[0]);
+	posix_spawn_file_actions_addclose(&actions, pipe_rw[1]);
+	posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null",
+		O_RDWR, 0);
+	posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO,
+		STDERR_FILENO);
 
-		execl("/bin/sh", "sh", "-c", command, NULL);
-		/*
-		 * Our stderr points to /dev/null or is closed
-		 * at this point so logging is pretty useless.
-		 */
-		_exit(1);
-	}
+	char *argv[] = { "sh", "-c", (char *)command, NULL };
+	pid_t pid = spawn("/bin/sh", argv, &actions, /*new_session*/ false);
+	posix_spawn_file_actions_destroy(&actions);
 
 	/* labwc */
 	close(pipe_rw[1]);
+	if (pid < 0) {
+		close(pipe_rw[0]);
+		return pid;
+	}
 
 	/*
 	 * Prevent leaking the read end of the pipe to further
@@ -192,6 +214,83 @@ spawn_piped(const char *command, int *pipe_fd)
 	return pid;
 }
 
+static void
+child_watch_destroy(struct child_watch *watch)
+{
+	wl_event_source_remove(watch->source);
+	close(watch->pidfd);
+	wl_list_remove(&watch->link);
+	free(watch);
+}
+
+static int
+handle_pidfd(int fd, uint32_t mask, void *data)
+{
+	struct child_watch *watch = data;
+	siginfo_t info = {0};
+	int ret = waitid(P_PIDFD, watch->pidfd, &info, WEXITED | WNOHANG);
+	if (!ret && !info.si_pid) {
+		/* Not exited yet */
+		return 0;
+	}
+	/* On error the child has been reaped elsewhere and info stays 0 */
+	spawn_child_exit_func_t callback = watch->callback;
+	void *callback_data = watch->data;
+	pid_t pid = watch->pid;
+	child_watch_destroy(watch);
+	callback(pid, &info, callback_data);
+	return 0;
+}
+
+bool
+spawn_watch_child(struct wl_event_loop *loop, pid_t pid,
+		spawn_child_exit_func_t callback, void *data)
+{
+	assert(callback);
+	int pidfd = syscall(SYS_pidfd_open, pid, 0);
+	if (pidfd < 0) {
+		wlr_log_errno(WLR_DEBUG, "pidfd_open() failed for %ld",
+			(long)pid);
+		return false;
+	}
+
+	struct child_watch *watch = znew(*watch);
+	watch->pid = pid;
+	watch->pidfd = pidfd;
+	watch->callback = callback;
+	watch->data = data;
+	watch->source = wl_event_loop_add_fd(loop, pidfd, WL_EVENT_READABLE,
+		handle_pidfd, watch);
+	if (!watch->source) {
+		close(pidfd);
+		free(watch);
+		return false;
+	}
+	wl_list_insert(&child_watches, &watch->link);
+	return true;
+}
+
+bool
+spawn_child_is_watched(pid_t pid)
+{
+	struct child_watch *watch;
+	wl_list_for_each(watch, &child_watches, link) {
+		if (watch->pid == pid) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+spawn_watch_finish(void)
+{
+	struct child_watch *watch, *tmp;
+	wl_list_for_each_safe(watch, tmp, &child_watches, link) {
+		child_watch_destroy(watch);
+	}
+}
+
 void
 spawn_piped_close(pid_t pid, int pipe_fd)
 {
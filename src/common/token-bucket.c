@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include "common/macros.h"
+#include "common/token-bucket.h"
+
+#define MILLITOKENS 1000
+
+void
+lab_token_bucket_init(struct lab_token_bucket *bucket, uint32_t rate,
+		uint32_t burst, uint64_t now_msec)
+{
+	assert(burst > 0);
+	bucket->rate = rate;
+	bucket->burst = burst;
+	bucket->level = (uint64_t)burst * MILLITOKENS;
+	bucket->last_msec = now_msec;
+}
+
+bool
+lab_token_bucket_take(struct lab_token_bucket *bucket, uint64_t now_msec)
+{
+	/* A clock going backwards just doesn't refill */
+	if (now_msec > bucket->last_msec) {
+		uint64_t capacity = (uint64_t)bucket->burst * MILLITOKENS;
+		uint64_t elapsed = now_msec - bucket->last_msec;
+		/* One token per 1000/rate ms is rate millitokens per ms */
+		uint64_t refill = MIN(elapsed, capacity) * bucket->rate;
+		bucket->level = MIN(bucket->level + refill, capacity);
+		bucket->last_msec = now_msec;
+	}
+
+	if (bucket->level < MILLITOKENS) {
+		return false;
+	}
+	bucket->level -= MILLITOKENS;
+	return true;
+}
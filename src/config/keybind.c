@@ -12,6 +12,116 @@
 #include "config/rcxml.h"
 #include "labwc.h"
 
+/*
+ * Index of rc.keybinds by modifier mask plus keycode and by modifier mask
+ * plus keysym. Each entry holds the matching keybinds in rc.keybinds order
+ * so that the first match still wins. The index is rebuilt lazily on the
+ * first lookup after keybinds or keycodes have changed.
+ */
+struct keybind_index_entry {
+	gint64 key;
+	struct wl_array keybinds; /* struct keybind * */
+};
+
+static GHashTable *keybind_index;
+static bool keybind_index_stale = true;
+
+static gint64
+index_key(uint32_t modifiers, bool is_keycode, uint32_t value)
+{
+	return (gint64)(((guint64)modifiers << 33)
+		| ((guint64)is_keycode << 32) | value);
+}
+
+static void
+index_entry_destroy(gpointer data)
+{
+	struct keybind_index_entry *entry = data;
+	wl_array_release(&entry->keybinds);
+	free(entry);
+}
+
+static void
+index_add(uint32_t modifiers, bool is_keycode, uint32_t value,
+		struct keybind *keybind)
+{
+	gint64 key = index_key(modifiers, is_keycode, value);
+	struct keybind_index_entry *entry =
+		g_hash_table_lookup(keybind_index, &key);
+	if (!entry) {
+		entry = znew(*entry);
+		entry->key = key;
+		wl_array_init(&entry->keybinds);
+		g_hash_table_insert(keybind_index, &entry->key, entry);
+	}
+
+	/* Keybinds are added in order, so duplicates are adjacent */
+	size_t len = entry->keybinds.size / sizeof(keybind);
+	if (len && ((struct keybind **)entry->keybinds.data)[len - 1] == keybind) {
+		return;
+	}
+	struct keybind **slot = wl_array_add(&entry->keybinds, sizeof(*slot));
+	if (slot) {
+		*slot = keybind;
+	}
+}
+
+static void
+keybind_index_rebuild(void)
+{
+	if (keybind_index) {
+		g_hash_table_remove_all(keybind_index);
+	} else {
+		keybind_index = g_hash_table_new_full(g_int64_hash,
+			g_int64_equal, NULL, index_entry_destroy);
+	}
+
+	struct keybind *keybind;
+	wl_list_for_each(keybind, &rc.keybinds, link) {
+		for (size_t i = 0; i < keybind->keycodes_len; i++) {
+			index_add(keybind->modifiers, true,
+				keybind->keycodes[i], keybind);
+		}
+		for (size_t i = 0; i < keybind->keysyms_len; i++) {
+			index_add(keybind->modifiers, false,
+				keybind->keysyms[i], keybind);
+		}
+	}
+	keybind_index_stale = false;
+}
+
+static void
+keybind_index_invalidate(void)
+{
+	keybind_index_stale = true;
+	if (keybind_index && wl_list_empty(&rc.keybinds)) {
+		/* Nothing left to index, e.g. on exit */
+		g_hash_table_destroy(keybind_index);
+		keybind_index = NULL;
+	}
+}
+
+struct keybind **
+keybind_lookup(uint32_t modifiers, xkb_keysym_t sym, xkb_keycode_t keycode,
+		size_t *len)
+{
+	*len = 0;
+	if (keybind_index_stale) {
+		keybind_index_rebuild();
+	}
+
+	gint64 key = sym == XKB_KEY_NoSymbol
+		? index_key(modifiers, true, keycode)
+		: index_key(modifiers, false, xkb_keysym_to_lower(sym));
+	struct keybind_index_entry *entry =
+		g_hash_table_lookup(keybind_index, &key);
+	if (!entry) {
+		return NULL;
+	}
+	*len = entry->keybinds.size / sizeof(struct keybind *);
+	return entry->keybinds.data;
+}
+
 uint32_t
 parse_modifier(const char *symname)
 {
@@ -113,13 +223,14 @@ keybind_update_keycodes(struct server *server)
 		wlr_log(WLR_DEBUG, "Found layout %s", xkb_keymap_layout_get_name(keymap, i));
 		xkb_keymap_key_for_each(keymap, update_keycodes_iter, &i);
 	}
+	keybind_index_invalidate();
 }
 
 struct keybind *
 keybind_create(const char *keybind)
 {
 	xkb_keysym_t sym;
-	struct keybind *k = znew(*k);
+	struct keybind *k = lab_arena_new(&rc.arena, *k);
 	xkb_keysym_t keysyms[MAX_KEYSYMS];
 	gchar **symnames = g_strsplit(keybind, "-", -1);
 	for (size_t i = 0; symnames[i]; i++) {
@@ -164,7 +275,7 @@ keybind_create(const char *keybind)
 			sym = xkb_keysym_to_lower(sym);
 			if (sym == XKB_KEY_NoSymbol) {
 				wlr_log(WLR_ERROR, "unknown keybind (%s)", symname);
-				free(k);
+				/* Left to the arena */
 				k = NULL;
 				break;
 			}
@@ -183,9 +294,11 @@ keybind_create(const char *keybind)
 		return NULL;
 	}
 	wl_list_append(&rc.keybinds, &k->link);
-	k->keysyms = xmalloc(k->keysyms_len * sizeof(xkb_keysym_t));
+	k->keysyms = lab_arena_alloc(&rc.arena,
+		k->keysyms_len * sizeof(xkb_keysym_t));
 	memcpy(k->keysyms, keysyms, k->keysyms_len * sizeof(xkb_keysym_t));
 	wl_list_init(&k->actions);
+	keybind_index_invalidate();
 	return k;
 }
 
@@ -194,6 +307,6 @@ keybind_destroy(struct keybind *keybind)
 {
 	assert(wl_list_empty(&keybind->actions));
 
-	zfree(keybind->keysyms);
-	zfree(keybind);
+	/* The memory goes with rc.arena */
+	keybind_index_invalidate();
 }
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <glib.h>
 #include <linux/input-event-codes.h>
 #include <strings.h>
 #include <unistd.h>
@@ -137,7 +138,7 @@ mousebind_create(const char *context)
 		wlr_log(WLR_ERROR, "mousebind context not specified");
 		return NULL;
 	}
-	struct mousebind *m = znew(*m);
+	struct mousebind *m = lab_arena_new(&rc.arena, *m);
 	m->context = context_from_str(context);
 	if (m->context != LAB_SSD_NONE) {
 		wl_list_append(&rc.mousebinds, &m->link);
@@ -145,3 +146,117 @@ mousebind_create(const char *context)
 	wl_list_init(&m->actions);
 	return m;
 }
+
+/*
+ * Dispatch index of rc.mousebinds keyed by the context of the event (the
+ * part of the window under the cursor), modifiers and button or scroll
+ * direction. A mousebind is listed under every context it contains, in
+ * rc.mousebinds order.
+ */
+struct mousebind_index_entry {
+	gint64 key;
+	struct wl_array mousebinds; /* struct mousebind * */
+};
+
+static GHashTable *mousebind_index;
+
+static gint64
+index_key(enum ssd_part_type type, uint32_t modifiers, bool scroll,
+		uint32_t value)
+{
+	return (gint64)(((guint64)scroll << 56) | ((guint64)type << 48)
+		| ((guint64)modifiers << 16) | (value & 0xffff));
+}
+
+static void
+index_entry_destroy(gpointer data)
+{
+	struct mousebind_index_entry *entry = data;
+	wl_array_release(&entry->mousebinds);
+	free(entry);
+}
+
+static void
+index_add(gint64 key, struct mousebind *mousebind)
+{
+	struct mousebind_index_entry *entry =
+		g_hash_table_lookup(mousebind_index, &key);
+	if (!entry) {
+		entry = znew(*entry);
+		entry->key = key;
+		wl_array_init(&entry->mousebinds);
+		g_hash_table_insert(mousebind_index, &entry->key, entry);
+	}
+	struct mousebind **slot =
+		wl_array_add(&entry->mousebinds, sizeof(*slot));
+	if (slot) {
+		*slot = mousebind;
+	}
+}
+
+void
+mousebind_index_build(void)
+{
+	mousebind_index_finish();
+	mousebind_index = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+		NULL, index_entry_destroy);
+
+	struct mousebind *mousebind;
+	wl_list_for_each(mousebind, &rc.mousebinds, link) {
+		bool scroll = mousebind->mouse_event == MOUSE_ACTION_SCROLL;
+		uint32_t value = scroll ? mousebind->direction : mousebind->button;
+		if (value > 0xffff) {
+			continue;
+		}
+		for (enum ssd_part_type type = LAB_SSD_NONE + 1;
+				type < LAB_SSD_END_MARKER; type++) {
+			if (ssd_part_contains(mousebind->context, type)) {
+				index_add(index_key(type, mousebind->modifiers,
+					scroll, value), mousebind);
+			}
+		}
+	}
+}
+
+void
+mousebind_index_finish(void)
+{
+	if (mousebind_index) {
+		g_hash_table_destroy(mousebind_index);
+		mousebind_index = NULL;
+	}
+}
+
+static struct mousebind **
+lookup(gint64 key, size_t *len)
+{
+	*len = 0;
+	if (!mousebind_index) {
+		return NULL;
+	}
+	struct mousebind_index_entry *entry =
+		g_hash_table_lookup(mousebind_index, &key);
+	if (!entry) {
+		return NULL;
+	}
+	*len = entry->mousebinds.size / sizeof(struct mousebind *);
+	return entry->mousebinds.data;
+}
+
+struct mousebind **
+mousebind_lookup_button(enum ssd_part_type type, uint32_t modifiers,
+		uint32_t button, size_t *len)
+{
+	if (button > 0xffff) {
+		*len = 0;
+		return NULL;
+	}
+	return lookup(index_key(type, modifiers, false, button), len);
+}
+
+struct mousebind **
+mousebind_lookup_scroll(enum ssd_part_type type, uint32_t modifiers,
+		enum direction direction, size_t *len)
+{
+	return lookup(index_key(type, modifiers, true, direction), len);
+}
@@ -10,6 +10,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/util/box.h>
@@ -33,6 +35,7 @@
 #include "labwc.h"
 #include "osd.h"
 #include "regions.h"
+#include "trace.h"
 #include "view.h"
 #include "window-rules.h"
 #include "workspaces.h"
@@ -40,6 +43,7 @@
 struct parser_state {
 	bool in_regions;
 	bool in_usable_area_override;
+	bool in_idle_output;
 	bool in_keybind;
 	bool in_mousebind;
 	bool in_touch;
@@ -51,6 +55,7 @@ struct parser_state {
 	bool in_action_else_branch;
 	bool in_action_none_branch;
 	struct usable_area_override *current_usable_area_override;
+	struct idle_output_config *current_idle_output;
 	struct keybind *current_keybind;
 	struct mousebind *current_mousebind;
 	struct touch_config_entry *current_touch;
@@ -147,6 +152,43 @@ parse_window_type(const char *type)
 
 
 
+static void
+fill_idle_output(char *nodename, char *content, struct parser_state *state)
+{
+	if (!strcasecmp(nodename, "idleOutput")) {
+		state->current_idle_output = znew(*state->current_idle_output);
+		state->current_idle_output->timeout = 300;
+		state->current_idle_output->policy = LAB_IDLE_OUTPUT_MIN_REFRESH;
+		wl_list_append(&rc.idle_outputs, &state->current_idle_output->link);
+		return;
+	}
+	string_truncate_at_pattern(nodename, ".idleoutput");
+	if (!content) {
+		/* nop */
+	} else if (!state->current_idle_output) {
+		wlr_log(WLR_ERROR, "no idle-output object");
+	} else if (!strcmp(nodename, "output")) {
+		xstrdup_replace(state->current_idle_output->output, content);
+	} else if (!strcmp(nodename, "timeout")) {
+		state->current_idle_output->timeout = MAX(1, atoi(content));
+	} else if (!strcmp(nodename, "policy")) {
+		if (!strcasecmp(content, "minRefresh")) {
+			state->current_idle_output->policy =
+				LAB_IDLE_OUTPUT_MIN_REFRESH;
+		} else if (!strcasecmp(content, "stop")) {
+			state->current_idle_output->policy = LAB_IDLE_OUTPUT_STOP;
+		} else if (!strcasecmp(content, "none")) {
+			state->current_idle_output->policy = LAB_IDLE_OUTPUT_NONE;
+		} else {
+			wlr_log(WLR_ERROR, "invalid idle output policy %s",
+				content);
+		}
+	} else {
+		wlr_log(WLR_ERROR, "Unexpected data idle-output parser: %s=\"%s\"",
+			nodename, content);
+	}
+}
+
 static void
 fill_usable_area_override(char *nodename, char *content, struct parser_state *state)
 {
@@ -196,7 +238,8 @@ static void
 fill_window_rule(char *nodename, char *content, struct parser_state *state)
 {
 	if (!strcasecmp(nodename, "windowRule.windowRules")) {
-		state->current_window_rule = znew(*state->current_window_rule);
+		state->current_window_rule =
+			lab_arena_new(&rc.arena, *state->current_window_rule);
 		state->current_window_rule->window_type = -1; // Window types are >= 0
 		wl_list_append(&rc.window_rules, &state->current_window_rule->link);
 		wl_list_init(&state->current_window_rule->actions);
@@ -211,17 +254,21 @@ fill_window_rule(char *nodename, char *content, struct parser_state *state)
 
 	/* Criteria */
 	} else if (!strcmp(nodename, "identifier")) {
-		xstrdup_replace(state->current_window_rule->identifier, content);
+		state->current_window_rule->identifier =
+			lab_arena_strdup(&rc.arena, content);
 	} else if (!strcmp(nodename, "title")) {
-		xstrdup_replace(state->current_window_rule->title, content);
+		state->current_window_rule->title =
+			lab_arena_strdup(&rc.arena, content);
 	} else if (!strcmp(nodename, "type")) {
 		state->current_window_rule->window_type = parse_window_type(content);
 	} else if (!strcasecmp(nodename, "matchOnce")) {
 		set_bool(content, &state->current_window_rule->match_once);
 	} else if (!strcasecmp(nodename, "sandboxEngine")) {
-		xstrdup_replace(state->current_window_rule->sandbox_engine, content);
+		state->current_window_rule->sandbox_engine =
+			lab_arena_strdup(&rc.arena, content);
 	} else if (!strcasecmp(nodename, "sandboxAppId")) {
-		xstrdup_replace(state->current_window_rule->sandbox_app_id, content);
+		state->current_window_rule->sandbox_app_id =
+			lab_arena_strdup(&rc.arena, content);
 
 	/* Event */
 	} else if (!strcmp(nodename, "event")) {
@@ -246,6 +293,33 @@ fill_window_rule(char *nodename, char *content, struct parser_state *state)
 		set_property(content, &state->current_window_rule->ignore_configure_request);
 	} else if (!strcasecmp(nodename, "fixedPosition")) {
 		set_property(content, &state->current_window_rule->fixed_position);
+	} else if (!strcasecmp(nodename, "preferScanout")) {
+		set_property(content, &state->current_window_rule->prefer_scanout);
+	} else if (!strcasecmp(nodename, "tearing")) {
+		set_property(content, &state->current_window_rule->tearing);
+	} else if (!strcasecmp(nodename, "renderScale")) {
+		/* Scales above 1 would only cost more, 0 stays unset */
+		double scale = CLAMP(atof(content), 0, 1);
+		state->current_window_rule->values[
+			LAB_WINDOW_RULE_VALUE_RENDER_SCALE] = scale;
+	} else if (!strcasecmp(nodename, "renderFilter")) {
+		enum lab_render_filter filter = LAB_RENDER_FILTER_UNSET;
+		if (!strcasecmp(content, "linear")) {
+			filter = LAB_RENDER_FILTER_LINEAR;
+		} else if (!strcasecmp(content, "nearest")) {
+			filter = LAB_RENDER_FILTER_NEAREST;
+		} else {
+			wlr_log(WLR_ERROR, "invalid renderFilter '%s'", content);
+		}
+		state->current_window_rule->values[
+			LAB_WINDOW_RULE_VALUE_RENDER_FILTER] = filter;
+	} else if (!strcasecmp(nodename, "maxFps")) {
+		state->current_window_rule->values[
+			LAB_WINDOW_RULE_VALUE_MAX_FPS] = MAX(0, atof(content));
+	} else if (!strcasecmp(nodename, "maxFpsUnfocused")) {
+		state->current_window_rule->values[
+			LAB_WINDOW_RULE_VALUE_MAX_FPS_UNFOCUSED] =
+				MAX(0, atof(content));
 
 	/* Actions */
 	} else if (!strcmp(nodename, "name.action")) {
@@ -297,7 +371,7 @@ fill_region(char *nodename, char *content, struct parser_state *state)
 	string_truncate_at_pattern(nodename, ".region.regions");
 
 	if (!strcasecmp(nodename, "region.regions")) {
-		state->current_region = znew(*state->current_region);
+		state->current_region = lab_arena_new(&rc.arena, *state->current_region);
 		wl_list_append(&rc.regions, &state->current_region->link);
 	} else if (!content) {
 		/* intentionally left empty */
@@ -305,16 +379,16 @@ fill_region(char *nodename, char *content, struct parser_state *state)
 		wlr_log(WLR_ERROR, "Expecting <region name=\"\" before %s='%s'",
 			nodename, content);
 	} else if (!strcasecmp(nodename, "name")) {
-		/* Prevent leaking memory if config contains multiple names */
+		/* The first name wins if config contains multiple names */
 		if (!state->current_region->name) {
-			state->current_region->name = xstrdup(content);
+			state->current_region->name =
+				lab_arena_strdup(&rc.arena, content);
 		}
 	} else if (strstr("xywidtheight", nodename) && !strchr(content, '%')) {
 		wlr_log(WLR_ERROR, "Removing invalid region '%s': %s='%s' misses"
 			" a trailing %%", state->current_region->name, nodename, content);
 		wl_list_remove(&state->current_region->link);
-		zfree(state->current_region->name);
-		zfree(state->current_region);
+		state->current_region = NULL;
 	} else if (!strcmp(nodename, "x")) {
 		state->current_region->percentage.x = atoi(content);
 	} else if (!strcmp(nodename, "y")) {
@@ -895,6 +969,9 @@ entry(xmlNode *node, char *nodename, char *content, struct parser_state *state)
 
 	static uint32_t button_map_from;
 
+	/* <autostart><command after=""> is seen before the command text */
+	static enum autostart_stage autostart_stage = LAB_AUTOSTART_NOW;
+
 	if (!nodename) {
 		return;
 	}
@@ -908,6 +985,9 @@ entry(xmlNode *node, char *nodename, char *content, struct parser_state *state)
 	if (state->in_usable_area_override) {
 		fill_usable_area_override(nodename, content, state);
 	}
+	if (state->in_idle_output) {
+		fill_idle_output(nodename, content, state);
+	}
 	if (state->in_keybind) {
 		if (state->in_action_query) {
 			fill_action_query(nodename, content,
@@ -924,6 +1004,7 @@ entry(xmlNode *node, char *nodename, char *content, struct parser_state *state)
 		} else {
 			fill_keybind(nodename, content, state);
 		}
+		return;
 	}
 	if (state->in_mousebind) {
 		if (state->in_action_query) {
@@ -941,6 +1022,7 @@ entry(xmlNode *node, char *nodename, char *content, struct parser_state *state)
 		} else {
 			fill_mousebind(nodename, content, state);
 		}
+		return;
 	}
 	if (state->in_touch) {
 		fill_touch(nodename, content, state);
@@ -979,6 +1061,12 @@ entry(xmlNode *node, char *nodename, char *content, struct parser_state *state)
 		return;
 	}
 
+	if (!strcasecmp(nodename, "command.autostart") && !content
+			&& node->type == XML_ELEMENT_NODE) {
+		autostart_stage = LAB_AUTOSTART_NOW;
+		return;
+	}
+
 	if (!strcasecmp(nodename, "prefix.desktops")) {
 		xstrdup_replace(rc.workspace_config.prefix, content ? content : "");
 		return;
@@ -1017,6 +1105,8 @@ entry(xmlNode *node, char *nodename, char *content, struct parser_state *state)
 		rc.gap = atoi(content);
 	} else if (!strcasecmp(nodename, "adaptiveSync.core")) {
 		set_adaptive_sync_mode(content, &rc.adaptive_sync);
+	} else if (!strcasecmp(nodename, "adaptiveSyncMinRefresh.core")) {
+		rc.adaptive_sync_min_refresh = MAX(0, atoi(content));
 	} else if (!strcasecmp(nodename, "allowTearing.core")) {
 		set_tearing_mode(content, &rc.allow_tearing);
 	} else if (!strcasecmp(nodename, "autoEnableOutputs.core")) {
@@ -1025,6 +1115,64 @@ entry(xmlNode *node, char *nodename, char *content, struct parser_state *state)
 		set_bool(content, &rc.reuse_output_mode);
 	} else if (!strcasecmp(nodename, "xwaylandPersistence.core")) {
 		set_bool(content, &rc.xwayland_persistence);
+	} else if (!strcasecmp(nodename, "xwaylandWarmStart.core")) {
+		set_bool(content, &rc.xwayland_warm_start);
+	} else if (!strcasecmp(nodename, "maxRenderTime.core")) {
+		if (!strcasecmp(content, "auto")) {
+			rc.max_render_time = -1;
+		} else if (!strcasecmp(content, "off")) {
+			rc.max_render_time = 0;
+		} else {
+			rc.max_render_time = MAX(0, atoi(content));
+		}
+	} else if (!strcasecmp(nodename, "repaintQueue.core")) {
+		set_bool(content, &rc.repaint_queue);
+	} else if (!strcasecmp(nodename, "frameTiming.core")) {
+		set_bool(content, &rc.frame_timing);
+	} else if (!strcasecmp(nodename, "frameTimingLogInterval.core")) {
+		rc.frame_timing_log_interval = MAX(0, atoi(content));
+	} else if (!strcasecmp(nodename, "metricsSocket.core")) {
+		xstrdup_replace(rc.metrics_socket, content);
+	} else if (!strcasecmp(nodename, "captureSocket.core")) {
+		xstrdup_replace(rc.capture_socket, content);
+	} else if (!strcasecmp(nodename, "bufferCacheSize.core")) {
+		rc.buffer_cache_size = MAX(0, atoi(content));
+	} else if (!strcasecmp(nodename, "clientBufferLimit.core")) {
+		rc.client_buffer_limit = MAX(0, atoi(content));
+	} else if (!strcasecmp(nodename, "clientBufferLimitAction.core")) {
+		if (!strcasecmp(content, "warn")) {
+			rc.client_buffer_limit_action = LAB_CLIENT_LIMIT_WARN;
+		} else if (!strcasecmp(content, "disconnect")) {
+			rc.client_buffer_limit_action =
+				LAB_CLIENT_LIMIT_DISCONNECT;
+		} else {
+			wlr_log(WLR_ERROR, "invalid clientBufferLimitAction %s",
+				content);
+		}
+	} else if (!strcasecmp(nodename, "autoReload.core")) {
+		set_bool(content, &rc.auto_reload);
+	} else if (!strcasecmp(nodename, "schedPolicy.core")) {
+		if (!strcasecmp(content, "other")) {
+			rc.sched_policy = LAB_SCHED_OTHER;
+		} else if (!strcasecmp(content, "rr")) {
+			rc.sched_policy = LAB_SCHED_RR;
+		} else if (!strcasecmp(content, "fifo")) {
+			rc.sched_policy = LAB_SCHED_FIFO;
+		} else {
+			wlr_log(WLR_ERROR, "invalid schedPolicy %s", content);
+		}
+	} else if (!strcasecmp(nodename, "schedPriority.core")) {
+		rc.sched_priority = atoi(content);
+	} else if (!strcasecmp(nodename, "nice.core")) {
+		rc.nice = MIN(MAX(atoi(content), -20), 19);
+	} else if (!strcasecmp(nodename, "cpuAffinity.core")) {
+		rc.cpu_affinity = (struct lab_bitset){0};
+		if (*content && !lab_bitset_parse_list(&rc.cpu_affinity,
+				content)) {
+			wlr_log(WLR_ERROR, "invalid cpuAffinity %s", content);
+		}
+	} else if (!strcasecmp(nodename, "lockMemory.core")) {
+		set_bool(content, &rc.lock_memory);
 	} else if (!strcmp(nodename, "policy.placement")) {
 		enum view_placement_policy policy = view_placement_parse(content);
 		if (policy != LAB_PLACE_INVALID) {
@@ -1069,6 +1217,19 @@ entry(xmlNode *node, char *nodename, char *content, struct parser_state *state)
 		} else {
 			wlr_log(WLR_ERROR, "invalid doubleClickTime");
 		}
+	} else if (!strcasecmp(nodename, "coalesceMotion.mouse")) {
+		if (!strcasecmp(content, "frame")) {
+			rc.motion_coalesce = LAB_MOTION_COALESCE_POINTER_FRAME;
+		} else if (!strcasecmp(content, "output")) {
+			rc.motion_coalesce = LAB_MOTION_COALESCE_OUTPUT_FRAME;
+		} else if (!strcasecmp(content, "no")) {
+			rc.motion_coalesce = LAB_MOTION_COALESCE_NONE;
+	rc.scroll_action_limit = 0;
+		} else {
+			wlr_log(WLR_ERROR, "invalid coalesceMotion %s", content);
+		}
+	} else if (!strcasecmp(nodename, "scrollActionLimit.mouse")) {
+		rc.scroll_action_limit = MAX(0, atoi(content));
 	} else if (!strcasecmp(nodename, "scrollFactor.mouse")) {
 		/* This is deprecated. Show an error message in post_processing() */
 		set_double(content, &mouse_scroll_factor);
@@ -1091,6 +1252,19 @@ entry(xmlNode *node, char *nodename, char *content, struct parser_state *state)
 		 * if we decide to also support "application".
 		 */
 		rc.kb_layout_per_window = !strcasecmp(content, "window");
+	} else if (!strcasecmp(nodename, "broadcastModifiers.keyboard")) {
+		if (!strcasecmp(content, "all")) {
+			rc.kb_modifier_broadcast = LAB_MODIFIER_BROADCAST_ALL;
+		} else if (!strcasecmp(content, "visible")) {
+			rc.kb_modifier_broadcast = LAB_MODIFIER_BROADCAST_VISIBLE;
+		} else if (!strcasecmp(content, "pointer")) {
+			rc.kb_modifier_broadcast = LAB_MODIFIER_BROADCAST_POINTER;
+		} else if (!strcasecmp(content, "no")) {
+			rc.kb_modifier_broadcast = LAB_MODIFIER_BROADCAST_NONE;
+		} else {
+			wlr_log(WLR_ERROR, "invalid broadcastModifiers %s",
+				content);
+		}
 	} else if (!strcasecmp(nodename, "screenEdgeStrength.resistance")) {
 		rc.screen_edge_strength = atoi(content);
 	} else if (!strcasecmp(nodename, "windowEdgeStrength.resistance")) {
@@ -1169,6 +1343,10 @@ entry(xmlNode *node, char *nodename, char *content, struct parser_state *state)
 		rc.workspace_config.popuptime = atoi(content);
 	} else if (!strcasecmp(nodename, "number.desktops")) {
 		rc.workspace_config.min_nr_workspaces = MAX(1, atoi(content));
+	} else if (!strcasecmp(nodename, "swipeFingers.desktops")) {
+		rc.workspace_config.swipe_fingers = MAX(0, atoi(content));
+	} else if (!strcasecmp(nodename, "slideTime.desktops")) {
+		rc.workspace_config.slide_time = MAX(0, atoi(content));
 	} else if (!strcasecmp(nodename, "popupShow.resize")) {
 		if (!strcasecmp(content, "Always")) {
 			rc.resize_indicator = LAB_RESIZE_INDICATOR_ALWAYS;
@@ -1185,6 +1363,20 @@ entry(xmlNode *node, char *nodename, char *content, struct parser_state *state)
 		rc.resize_corner_range = atoi(content);
 	} else if (!strcasecmp(nodename, "minimumArea.resize")) {
 		rc.resize_minimum_area = MAX(0, atoi(content));
+	} else if (!strcasecmp(nodename, "after.command.autostart")) {
+		if (!strcasecmp(content, "panel")) {
+			autostart_stage = LAB_AUTOSTART_AFTER_PANEL;
+		} else if (!strcasecmp(content, "xwayland")) {
+			autostart_stage = LAB_AUTOSTART_AFTER_XWAYLAND;
+		} else {
+			wlr_log(WLR_ERROR, "invalid autostart after='%s'", content);
+		}
+	} else if (!strcasecmp(nodename, "command.autostart")) {
+		struct autostart_entry *autostart = znew(*autostart);
+		autostart->command = xstrdup(content);
+		autostart->stage = autostart_stage;
+		wl_list_append(&rc.autostart, &autostart->link);
+		autostart_stage = LAB_AUTOSTART_NOW;
 	} else if (!strcasecmp(nodename, "mouseEmulation.tablet")) {
 		set_bool(content, &rc.tablet.force_mouse_emulation);
 	} else if (!strcasecmp(nodename, "mapToOutput.tablet")) {
@@ -1215,6 +1407,10 @@ entry(xmlNode *node, char *nodename, char *content, struct parser_state *state)
 	} else if (!strcasecmp(nodename, "relativeMotionSensitivity.tabletTool")) {
 		rc.tablet_tool.relative_motion_sensitivity =
 			tablet_get_dbl_if_positive(content, "relativeMotionSensitivity");
+	} else if (!strcasecmp(nodename, "coalesceMotion.tabletTool")) {
+		set_bool(content, &rc.tablet_tool.coalesce_motion);
+	} else if (!strcasecmp(nodename, "motionPrediction.tabletTool")) {
+		rc.tablet_tool.motion_prediction = MAX(0, atoi(content));
 	} else if (!strcasecmp(nodename, "ignoreButtonReleasePeriod.menu")) {
 		rc.menu_ignore_button_release_period = atoi(content);
 	} else if (!strcasecmp(nodename, "showIcons.menu")) {
@@ -1230,7 +1426,21 @@ entry(xmlNode *node, char *nodename, char *content, struct parser_state *state)
 		set_float(content, &rc.mag_increment);
 		rc.mag_increment = MAX(0, rc.mag_increment);
 	} else if (!strcasecmp(nodename, "useFilter.magnifier")) {
-		set_bool(content, &rc.mag_filter);
+		rc.mag_filter = parse_bool(content, true)
+			? LAB_MAG_FILTER_BILINEAR : LAB_MAG_FILTER_NEAREST;
+	} else if (!strcasecmp(nodename, "filter.magnifier")) {
+		if (!strcasecmp(content, "nearest")) {
+			rc.mag_filter = LAB_MAG_FILTER_NEAREST;
+		} else if (!strcasecmp(content, "bilinear")) {
+			rc.mag_filter = LAB_MAG_FILTER_BILINEAR;
+		} else if (!strcasecmp(content, "mipmapped")) {
+			/* Mipmaps only help when minifying, never when magnifying */
+			wlr_log(WLR_INFO, "magnifier filter 'mipmapped' is "
+				"equivalent to 'bilinear' when magnifying");
+			rc.mag_filter = LAB_MAG_FILTER_BILINEAR;
+		} else {
+			wlr_log(WLR_ERROR, "invalid magnifier filter %s", content);
+		}
 	}
 }
 
@@ -1276,6 +1486,12 @@ xml_tree_walk(xmlNode *node, struct parser_state *state)
 			state->in_usable_area_override = false;
 			continue;
 		}
+		if (!strcasecmp((char *)n->name, "idleOutput")) {
+			state->in_idle_output = true;
+			traverse(n, state);
+			state->in_idle_output = false;
+			continue;
+		}
 		if (!strcasecmp((char *)n->name, "keybind")) {
 			state->in_keybind = true;
 			traverse(n, state);
@@ -1347,12 +1563,11 @@ xml_tree_walk(xmlNode *node, struct parser_state *state)
 	}
 }
 
-/* Exposed in header file to allow unit tests to parse buffers */
-void
-rcxml_parse_xml(struct buf *b)
+static void
+parse_xml_memory(const char *data, size_t len)
 {
 	int options = 0;
-	xmlDoc *d = xmlReadMemory(b->data, b->len, NULL, NULL, options);
+	xmlDoc *d = xmlReadMemory(data, len, NULL, NULL, options);
 	if (!d) {
 		wlr_log(WLR_ERROR, "error parsing config file");
 		return;
@@ -1363,6 +1578,49 @@ rcxml_parse_xml(struct buf *b)
 	xmlCleanupParser();
 }
 
+/* Exposed in header file to allow unit tests to parse buffers */
+void
+rcxml_parse_xml(struct buf *b)
+{
+	parse_xml_memory(b->data, b->len);
+}
+
+/*
+ * Parse a config file straight from a read-only mapping rather than copying
+ * it into a growing buffer first
+ */
+static bool
+parse_xml_file(const char *filename)
+{
+	int fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return false;
+	}
+
+	wlr_log(WLR_INFO, "read config file %s", filename);
+
+	if (st.st_size == 0) {
+		/* mmap() refuses empty mappings */
+		close(fd);
+		parse_xml_memory("", 0);
+		return true;
+	}
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		wlr_log_errno(WLR_ERROR, "cannot map %s", filename);
+		return false;
+	}
+	parse_xml_memory(data, st.st_size);
+	munmap(data, st.st_size);
+	return true;
+}
+
 static void
 init_font_defaults(struct font *font)
 {
@@ -1380,6 +1638,8 @@ rcxml_init(void)
 		wl_list_init(&rc.title_buttons_left);
 		wl_list_init(&rc.title_buttons_right);
 		wl_list_init(&rc.usable_area_overrides);
+		wl_list_init(&rc.idle_outputs);
+		wl_list_init(&rc.autostart);
 		wl_list_init(&rc.keybinds);
 		wl_list_init(&rc.mousebinds);
 		wl_list_init(&rc.libinput_categories);
@@ -1404,10 +1664,27 @@ rcxml_init(void)
 
 	rc.gap = 0;
 	rc.adaptive_sync = LAB_ADAPTIVE_SYNC_DISABLED;
+	rc.adaptive_sync_min_refresh = 30;
 	rc.allow_tearing = false;
 	rc.auto_enable_outputs = true;
 	rc.reuse_output_mode = false;
 	rc.xwayland_persistence = false;
+	rc.xwayland_warm_start = false;
+	rc.max_render_time = 0;
+	rc.repaint_queue = false;
+	rc.frame_timing = false;
+	rc.frame_timing_log_interval = 60;
+	rc.metrics_socket = NULL;
+	rc.capture_socket = NULL;
+	rc.buffer_cache_size = 16;
+	rc.client_buffer_limit = 0;
+	rc.client_buffer_limit_action = LAB_CLIENT_LIMIT_WARN;
+	rc.auto_reload = false;
+	rc.sched_policy = LAB_SCHED_OTHER;
+	rc.sched_priority = 1;
+	rc.nice = 0;
+	rc.cpu_affinity = (struct lab_bitset){0};
+	rc.lock_memory = false;
 
 	init_font_defaults(&rc.font_activewindow);
 	init_font_defaults(&rc.font_inactivewindow);
@@ -1420,6 +1697,7 @@ rcxml_init(void)
 	rc.raise_on_focus = false;
 
 	rc.doubleclick_time = 500;
+	rc.motion_coalesce = LAB_MOTION_COALESCE_NONE;
 
 	rc.tablet.force_mouse_emulation = false;
 	rc.tablet.output_name = NULL;
@@ -1428,11 +1706,14 @@ rcxml_init(void)
 	tablet_load_default_button_mappings();
 	rc.tablet_tool.motion = LAB_TABLET_MOTION_ABSOLUTE;
 	rc.tablet_tool.relative_motion_sensitivity = 1.0;
+	rc.tablet_tool.coalesce_motion = false;
+	rc.tablet_tool.motion_prediction = 0;
 
 	rc.repeat_rate = 25;
 	rc.repeat_delay = 600;
 	rc.kb_numlock_enable = LAB_STATE_UNSPECIFIED;
 	rc.kb_layout_per_window = false;
+	rc.kb_modifier_broadcast = LAB_MODIFIER_BROADCAST_ALL;
 	rc.screen_edge_strength = 20;
 	rc.window_edge_strength = 20;
 	rc.unsnap_threshold = 20;
@@ -1459,6 +1740,8 @@ rcxml_init(void)
 
 	rc.workspace_config.popuptime = INT_MIN;
 	rc.workspace_config.min_nr_workspaces = 1;
+	rc.workspace_config.swipe_fingers = 0;
+	rc.workspace_config.slide_time = 0;
 
 	rc.menu_ignore_button_release_period = 250;
 	rc.menu_show_icons = true;
@@ -1467,7 +1750,7 @@ rcxml_init(void)
 	rc.mag_height = 400;
 	rc.mag_scale = 2.0;
 	rc.mag_increment = 0.2;
-	rc.mag_filter = true;
+	rc.mag_filter = LAB_MAG_FILTER_BILINEAR;
 }
 
 static void
@@ -1552,7 +1835,6 @@ deduplicate_mouse_bindings(void)
 			if (mousebind_the_same(existing, current)) {
 				wl_list_remove(&existing->link);
 				action_list_free(&existing->actions);
-				free(existing);
 				replaced++;
 				break;
 			}
@@ -1561,7 +1843,6 @@ deduplicate_mouse_bindings(void)
 	wl_list_for_each_safe(current, tmp, &rc.mousebinds, link) {
 		if (wl_list_empty(&current->actions)) {
 			wl_list_remove(&current->link);
-			free(current);
 			cleared++;
 		}
 	}
@@ -1660,6 +1941,8 @@ post_processing(void)
 	 */
 	deduplicate_key_bindings();
 	deduplicate_mouse_bindings();
+	mousebind_index_build();
+	window_rules_compile();
 
 	if (!rc.font_activewindow.name) {
 		rc.font_activewindow.name = xstrdup("sans");
@@ -1726,12 +2009,8 @@ static void
 rule_destroy(struct window_rule *rule)
 {
 	wl_list_remove(&rule->link);
-	zfree(rule->identifier);
-	zfree(rule->title);
-	zfree(rule->sandbox_engine);
-	zfree(rule->sandbox_app_id);
+	/* The rule and its strings go with rc.arena */
 	action_list_free(&rule->actions);
-	zfree(rule);
 }
 
 static void
@@ -1790,8 +2069,6 @@ validate(void)
 				"Removing invalid region '%s': %d%% x %d%% @ %d%%,%d%%",
 				region->name, box.width, box.height, box.x, box.y);
 			wl_list_remove(&region->link);
-			zfree(region->name);
-			free(region);
 		}
 	}
 
@@ -1823,6 +2100,7 @@ validate(void)
 void
 rcxml_read(const char *filename)
 {
+	TRACE_FUNC();
 	rcxml_init();
 
 	struct wl_list paths;
@@ -1834,10 +2112,9 @@ rcxml_read(const char *filename)
 		path->string = xstrdup(filename);
 		wl_list_append(&paths, &path->link);
 	} else {
-		paths_config_create(&paths, "rc.xml");
+		paths_config_find(&paths, "rc.xml");
 	}
 
-	/* Reading file into buffer before parsing - better for unit tests */
 	bool should_merge_config = rc.merge_config;
 	struct wl_list *(*iter)(struct wl_list *list);
 	iter = should_merge_config ? paths_get_prev : paths_get_next;
@@ -1854,27 +2131,9 @@ rcxml_read(const char *filename)
 	 */
 	for (struct wl_list *elm = iter(&paths); elm != &paths; elm = iter(elm)) {
 		struct path *path = wl_container_of(elm, path, link);
-		FILE *stream = fopen(path->string, "r");
-		if (!stream) {
+		if (!parse_xml_file(path->string)) {
 			continue;
 		}
-
-		wlr_log(WLR_INFO, "read config file %s", path->string);
-
-		struct buf b = BUF_INIT;
-		char *line = NULL;
-		size_t len = 0;
-		while (getline(&line, &len, stream) != -1) {
-			char *p = strrchr(line, '\n');
-			if (p) {
-				*p = '\0';
-			}
-			buf_add(&b, line);
-		}
-		zfree(line);
-		fclose(stream);
-		rcxml_parse_xml(&b);
-		buf_reset(&b);
 		if (!should_merge_config) {
 			break;
 		}
@@ -1884,6 +2143,15 @@ rcxml_read(const char *filename)
 	validate();
 }
 
+void
+rcxml_parse_buffer(const char *data, size_t len)
+{
+	rcxml_init();
+	parse_xml_memory(data, len);
+	post_processing();
+	validate();
+}
+
 void
 rcxml_finish(void)
 {
@@ -1897,6 +2165,8 @@ rcxml_finish(void)
 	zfree(rc.fallback_app_icon_name);
 	zfree(rc.workspace_config.prefix);
 	zfree(rc.tablet.output_name);
+	zfree(rc.metrics_socket);
+	zfree(rc.capture_socket);
 
 
 	struct usable_area_override *area, *area_tmp;
@@ -1906,6 +2176,20 @@ rcxml_finish(void)
 		zfree(area);
 	}
 
+	struct idle_output_config *idle, *idle_tmp;
+	wl_list_for_each_safe(idle, idle_tmp, &rc.idle_outputs, link) {
+		wl_list_remove(&idle->link);
+		zfree(idle->output);
+		zfree(idle);
+	}
+
+	struct autostart_entry *autostart, *autostart_tmp;
+	wl_list_for_each_safe(autostart, autostart_tmp, &rc.autostart, link) {
+		wl_list_remove(&autostart->link);
+		zfree(autostart->command);
+		zfree(autostart);
+	}
+
 	struct keybind *k, *k_tmp;
 	wl_list_for_each_safe(k, k_tmp, &rc.keybinds, link) {
 		wl_list_remove(&k->link);
@@ -1913,11 +2197,11 @@ rcxml_finish(void)
 		keybind_destroy(k);
 	}
 
+	mousebind_index_finish();
 	struct mousebind *m, *m_tmp;
 	wl_list_for_each_safe(m, m_tmp, &rc.mousebinds, link) {
 		wl_list_remove(&m->link);
 		action_list_free(&m->actions);
-		zfree(m);
 	}
 
 	struct touch_config_entry *touch_config, *touch_config_tmp;
@@ -1942,7 +2226,8 @@ rcxml_finish(void)
 		zfree(w);
 	}
 
-	regions_destroy(NULL, &rc.regions);
+	/* Regions own nothing outside of rc.arena */
+	wl_list_init(&rc.regions);
 
 	clear_window_switcher_fields();
 
@@ -1951,6 +2236,9 @@ rcxml_finish(void)
 		rule_destroy(rule);
 	}
 
+	/* Nothing refers to the old objects any more, drop them at once */
+	lab_arena_release(&rc.arena);
+
 	/* Reset state vars for starting fresh when Reload is triggered */
 	mouse_scroll_factor = -1;
 }
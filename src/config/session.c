@@ -8,16 +8,19 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <wlr/backend/drm.h>
 #include <wlr/backend/multi.h>
 #include <wlr/util/log.h>
 #include "common/buf.h"
 #include "common/dir.h"
 #include "common/file-helpers.h"
+#include "common/grab-file.h"
 #include "common/mem.h"
 #include "common/parse-bool.h"
 #include "common/spawn.h"
 #include "common/string-helpers.h"
+#include "config/rcxml.h"
 #include "config/session.h"
 #include "labwc.h"
 
@@ -87,22 +90,17 @@ err:
 static bool
 read_environment_file(const char *filename)
 {
-	char *line = NULL;
-	size_t len = 0;
-	FILE *stream = fopen(filename, "r");
-	if (!stream) {
+	struct buf file = grab_file(filename);
+	if (!file.alloc) {
 		return false;
 	}
 	wlr_log(WLR_INFO, "read environment file %s", filename);
-	while (getline(&line, &len, stream) != -1) {
-		char *p = strrchr(line, '\n');
-		if (p) {
-			*p = '\0';
-		}
+	size_t pos = 0;
+	char *line;
+	while ((line = grab_file_next_line(&file, &pos))) {
 		process_line(line);
 	}
-	free(line);
-	fclose(stream);
+	buf_reset(&file);
 	return true;
 }
 
@@ -245,9 +243,55 @@ update_activation_env(struct server *server, bool initialize)
 	free(env_unset_keys);
 }
 
+static void
+add_stat_line(struct buf *sources, const char *path)
+{
+	struct stat st;
+	if (stat(path, &st) < 0) {
+		buf_add_fmt(sources, "%s -\n", path);
+		return;
+	}
+	buf_add_fmt(sources, "%s %lu %lld %lld.%09ld\n", path,
+		(unsigned long)st.st_ino, (long long)st.st_size,
+		(long long)st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+}
+
+/*
+ * Describe every environment file and environment.d directory which
+ * session_environment_init() could read, by stat() data. A directory
+ * is listed with all its entries because editing a file in place does
+ * not change the mtime of the directory.
+ */
+static void
+describe_environment_sources(struct buf *sources, struct wl_list *paths)
+{
+	struct path *path;
+	wl_list_for_each(path, paths, link) {
+		add_stat_line(sources, path->string);
+
+		char *dir = strdup_printf("%s.d", path->string);
+		add_stat_line(sources, dir);
+		struct dirent **dirlist = NULL;
+		int num_entries = scandir(dir, &dirlist, env_file_filter,
+			alphasort);
+		for (int i = 0; i < num_entries; i++) {
+			char *file = strdup_printf("%s/%s", dir,
+				dirlist[i]->d_name);
+			add_stat_line(sources, file);
+			free(file);
+			free(dirlist[i]);
+		}
+		free(dirlist);
+		free(dir);
+	}
+}
+
 void
 session_environment_init(void)
 {
+	/* Sources seen by the last call, see describe_environment_sources() */
+	static struct buf last_sources = BUF_INIT;
+
 	/*
 	 * Set default for XDG_CURRENT_DESKTOP so xdg-desktop-portal-wlr is happy.
 	 * May be overridden either by already having a value set or by the user
@@ -268,6 +312,23 @@ session_environment_init(void)
 	paths_config_create(&paths, "environment");
 
 	bool should_merge_config = rc.merge_config;
+
+	/*
+	 * The environment of this process still holds what the files set
+	 * last time, so there is nothing to do if none of them has changed.
+	 * This also stops recursive assignments from growing on reconfigure.
+	 */
+	struct buf sources = BUF_INIT;
+	buf_add_fmt(&sources, "merge %d\n", should_merge_config);
+	describe_environment_sources(&sources, &paths);
+	if (last_sources.len && !strcmp(sources.data, last_sources.data)) {
+		wlr_log(WLR_DEBUG, "environment files unchanged");
+		buf_reset(&sources);
+		paths_destroy(&paths);
+		return;
+	}
+	buf_move(&last_sources, &sources);
+
 	struct wl_list *(*iter)(struct wl_list *list);
 	iter = should_merge_config ? paths_get_prev : paths_get_next;
 
@@ -291,7 +352,7 @@ void
 session_run_script(const char *script)
 {
 	struct wl_list paths;
-	paths_config_create(&paths, script);
+	paths_config_find(&paths, script);
 
 	bool should_merge_config = rc.merge_config;
 	struct wl_list *(*iter)(struct wl_list *list);
@@ -314,12 +375,63 @@ session_run_script(const char *script)
 	paths_destroy(&paths);
 }
 
+static const char *const autostart_stage_names[] = {
+	[LAB_AUTOSTART_NOW] = "startup",
+	[LAB_AUTOSTART_AFTER_PANEL] = "panel",
+	[LAB_AUTOSTART_AFTER_XWAYLAND] = "xwayland",
+};
+
+static struct {
+	struct timespec start;
+	bool started;
+	bool done[LAB_AUTOSTART_STAGE_COUNT];
+} autostart;
+
+static double
+msec_since(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1e3
+		+ (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+void
+session_autostart_stage(enum autostart_stage stage)
+{
+	assert(stage < LAB_AUTOSTART_STAGE_COUNT);
+	if (!autostart.started || autostart.done[stage]) {
+		return;
+	}
+	autostart.done[stage] = true;
+
+	/* The commands are not waited for, so all entries of a stage overlap */
+	struct autostart_entry *entry;
+	wl_list_for_each(entry, &rc.autostart, link) {
+		if (entry->stage != stage) {
+			continue;
+		}
+		spawn_async_no_shell(entry->command);
+		wlr_log(WLR_INFO, "autostart: launched '%s' on %s at %.1f ms",
+			entry->command, autostart_stage_names[stage],
+			msec_since(&autostart.start));
+	}
+}
+
 void
 session_autostart_init(struct server *server)
 {
 	/* Update dbus and systemd user environment, each may fail gracefully */
 	update_activation_env(server, /* initialize */ true);
 	session_run_script("autostart");
+
+	clock_gettime(CLOCK_MONOTONIC, &autostart.start);
+	autostart.started = true;
+	session_autostart_stage(LAB_AUTOSTART_NOW);
+#if !HAVE_XWAYLAND
+	/* There is no xwayland to wait for */
+	session_autostart_stage(LAB_AUTOSTART_AFTER_XWAYLAND);
+#endif
 }
 
 void
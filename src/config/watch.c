@@ -0,0 +1,225 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * watch.c: reload configuration files when they are written
+ *
+ * The directories of the files are watched rather than the files, as
+ * editors commonly replace a file by renaming a new one over it. Writes
+ * are debounced, so that saving several files or a file written in
+ * pieces results in a single reload, and server_reload() is only asked
+ * to reload what the written files affect.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "common/array.h"
+#include "common/buf.h"
+#include "common/dir.h"
+#include "common/mem.h"
+#include "common/string-helpers.h"
+#include "config/rcxml.h"
+#include "config/watch.h"
+#include "labwc.h"
+
+#define WATCH_DEBOUNCE_MSEC 250
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM \
+	| IN_MOVED_TO | IN_ONLYDIR)
+
+struct watched_file {
+	int wd;
+	char *name;
+	uint32_t what; /* enum lab_reload */
+};
+
+static struct {
+	struct server *server;
+	int fd;
+	struct wl_event_source *source;
+	struct wl_event_source *timer;
+	struct wl_array files; /* struct watched_file */
+	uint32_t pending;
+} watch = {
+	.fd = -1,
+};
+
+/* Watch @dir for @name, any file in it if @name is empty */
+static void
+watch_dir(const char *dir, const char *name, uint32_t what)
+{
+	struct watched_file file = {
+		.wd = inotify_add_watch(watch.fd, *dir ? dir : "/", WATCH_MASK),
+		.what = what,
+	};
+	if (file.wd < 0) {
+		/* Mostly directories that don't exist */
+		return;
+	}
+	file.name = xstrdup(name);
+	array_add(&watch.files, file);
+}
+
+static void
+watch_file(const char *path, uint32_t what)
+{
+	struct buf dir = BUF_INIT;
+	buf_add(&dir, path);
+	char *slash = strrchr(dir.data, '/');
+	if (slash) {
+		*slash = '\0';
+		watch_dir(dir.data, slash + 1, what);
+	}
+	buf_reset(&dir);
+}
+
+static void
+watch_paths(struct wl_list *paths, const char *suffix, uint32_t what)
+{
+	struct path *path;
+	wl_list_for_each(path, paths, link) {
+		char *string = strdup_printf("%s%s", path->string, suffix);
+		watch_file(string, what);
+		free(string);
+	}
+	paths_destroy(paths);
+}
+
+static void
+unwatch_all(void)
+{
+	struct watched_file *file;
+	wl_array_for_each(file, &watch.files) {
+		/* A directory watched for several files has a single wd */
+		inotify_rm_watch(watch.fd, file->wd);
+		free(file->name);
+	}
+	wl_array_release(&watch.files);
+	wl_array_init(&watch.files);
+}
+
+static void
+watch_all(void)
+{
+	struct wl_list paths;
+	if (rc.config_file) {
+		watch_file(rc.config_file, LAB_RELOAD_CONFIG);
+	} else {
+		paths_config_create(&paths, "rc.xml");
+		watch_paths(&paths, "", LAB_RELOAD_CONFIG);
+	}
+
+	paths_config_create(&paths, "themerc-override");
+	watch_paths(&paths, "", LAB_RELOAD_THEME);
+	if (rc.theme_name) {
+		paths_theme_create(&paths, rc.theme_name, "themerc");
+		watch_paths(&paths, "", LAB_RELOAD_THEME);
+	}
+
+	paths_config_create(&paths, "environment");
+	watch_paths(&paths, "", LAB_RELOAD_ENVIRONMENT);
+	/* Creating or removing environment.d, see read_environment_dir() */
+	paths_config_create(&paths, "environment");
+	watch_paths(&paths, ".d", LAB_RELOAD_ENVIRONMENT);
+	/* And the files in it */
+	paths_config_create(&paths, "environment.d");
+	struct path *path;
+	wl_list_for_each(path, &paths, link) {
+		watch_dir(path->string, "", LAB_RELOAD_ENVIRONMENT);
+	}
+	paths_destroy(&paths);
+}
+
+static int
+handle_timer(void *data)
+{
+	uint32_t what = watch.pending;
+	watch.pending = 0;
+	wlr_log(WLR_INFO, "configuration files changed, reloading");
+	server_reload(watch.server, what);
+	return 0;
+}
+
+static int
+handle_events(int fd, uint32_t mask, void *data)
+{
+	char events[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+	bool matched = false;
+	while ((len = read(fd, events, sizeof(events))) > 0) {
+		for (char *p = events; p < events + len;) {
+			struct inotify_event *event = (struct inotify_event *)p;
+			p += sizeof(*event) + event->len;
+			if (event->mask & IN_IGNORED) {
+				continue;
+			}
+			struct watched_file *file;
+			wl_array_for_each(file, &watch.files) {
+				if (file->wd != event->wd) {
+					continue;
+				}
+				if (!*file->name || (event->len
+						&& !strcmp(file->name, event->name))) {
+					watch.pending |= file->what;
+					matched = true;
+				}
+			}
+		}
+	}
+	/* Every write postpones the reload, until they have settled */
+	if (matched) {
+		wl_event_source_timer_update(watch.timer, WATCH_DEBOUNCE_MSEC);
+	}
+	return 0;
+}
+
+void
+config_watch_reconfigure(struct server *server)
+{
+	watch.server = server;
+	if (watch.fd >= 0) {
+		unwatch_all();
+	}
+	if (!rc.auto_reload) {
+		return;
+	}
+
+	if (watch.fd < 0) {
+		watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (watch.fd < 0) {
+			wlr_log_errno(WLR_ERROR, "cannot watch configuration");
+			return;
+		}
+		wl_array_init(&watch.files);
+		watch.source = wl_event_loop_add_fd(server->wl_event_loop,
+			watch.fd, WL_EVENT_READABLE, handle_events, NULL);
+		watch.timer = wl_event_loop_add_timer(server->wl_event_loop,
+			handle_timer, NULL);
+	}
+	watch_all();
+}
+
+void
+config_watch_init(struct server *server)
+{
+	config_watch_reconfigure(server);
+}
+
+void
+config_watch_finish(void)
+{
+	if (watch.fd < 0) {
+		return;
+	}
+	unwatch_all();
+	wl_array_release(&watch.files);
+	wl_event_source_remove(watch.source);
+	wl_event_source_remove(watch.timer);
+	watch.source = NULL;
+	watch.timer = NULL;
+	close(watch.fd);
+	watch.fd = -1;
+	watch.pending = 0;
+}
@@ -1,7 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#include <glib.h>
 #include <wlr/types/wlr_layer_shell_v1.h>
 #include <wlr/types/wlr_scene.h>
+#include "common/buf.h"
 #include "common/graphic-helpers.h"
+#include "common/macros.h"
+#include "common/scaled-scene-buffer.h"
 #include "common/scene-helpers.h"
 #include "common/string-helpers.h"
 #include "debug.h"
@@ -105,6 +109,9 @@ get_special(struct server *server, struct wlr_scene_node *node)
 	if (node == &server->view_tree_always_on_top->node) {
 		return "server->always_on_top";
 	}
+	if (node == &server->view_tree_omnipresent->node) {
+		return "server->omnipresent";
+	}
 	if (node->parent == server->view_tree) {
 		struct workspace *workspace;
 		wl_list_for_each(workspace, &server->workspaces.all, link) {
@@ -264,3 +271,216 @@ debug_dump_scene(struct server *server)
 	 */
 	last_view = NULL;
 }
+
+/*
+ * Buffers are accounted to the first subsystem that matches: client
+ * surfaces, then the scaled buffer implementation, then the tree they
+ * are in.
+ */
+enum dump_subsystem {
+	LAB_DUMP_CLIENT = 0,
+	LAB_DUMP_THEME,
+	LAB_DUMP_FONTS,
+	LAB_DUMP_ICONS,
+	LAB_DUMP_OVERLAYS,
+	LAB_DUMP_OTHER,
+
+	LAB_DUMP_COUNT
+};
+
+static const char *subsystem_names[LAB_DUMP_COUNT] = {
+	[LAB_DUMP_CLIENT] = "client",
+	[LAB_DUMP_THEME] = "theme",
+	[LAB_DUMP_FONTS] = "fonts",
+	[LAB_DUMP_ICONS] = "icons",
+	[LAB_DUMP_OVERLAYS] = "overlays",
+	[LAB_DUMP_OTHER] = "other",
+};
+
+struct dump_totals {
+	int nodes;
+	/* Each wlr_buffer is only counted once, however often it is shown */
+	int buffers;
+	size_t bytes;
+};
+
+struct json_dump {
+	struct server *server;
+	struct buf buf;
+	GHashTable *seen_buffers;
+	struct dump_totals totals[LAB_DUMP_COUNT];
+};
+
+static void
+json_add_string(struct buf *buf, const char *str)
+{
+	buf_add_char(buf, '"');
+	for (const char *p = str ? str : ""; *p; p++) {
+		unsigned char c = *p;
+		if (c == '"' || c == '\\') {
+			buf_add_char(buf, '\\');
+			buf_add_char(buf, c);
+		} else if (c < 0x20) {
+			buf_add_fmt(buf, "\\u%04x", c);
+		} else {
+			buf_add_char(buf, c);
+		}
+	}
+	buf_add_char(buf, '"');
+}
+
+static bool
+is_overlay_root(struct server *server, struct wlr_scene_node *node)
+{
+	struct seat *seat = &server->seat;
+	if ((seat->overlay.region_rect.tree
+				&& node == &seat->overlay.region_rect.tree->node)
+			|| (seat->overlay.edge_rect.tree
+				&& node == &seat->overlay.edge_rect.tree->node)
+			|| (server->osd_state.preview_outline
+				&& node == &server->osd_state.preview_outline->tree->node)) {
+		return true;
+	}
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (node == &output->osd_tree->node
+				|| (output->workspace_osd
+					&& node == &output->workspace_osd->node)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static enum dump_subsystem
+get_buffer_subsystem(struct wlr_scene_node *node, bool in_overlay)
+{
+	if (lab_wlr_surface_from_node(node)) {
+		return LAB_DUMP_CLIENT;
+	}
+	struct node_descriptor *desc = node->data;
+	if (desc && desc->type == LAB_NODE_DESC_SCALED_SCENE_BUFFER) {
+		struct scaled_scene_buffer *scaled_buffer = desc->data;
+		const char *name = scaled_buffer->impl->name;
+		if (name && !strcmp(name, "font")) {
+			return LAB_DUMP_FONTS;
+		}
+		if (name && !strcmp(name, "icon")) {
+			return LAB_DUMP_ICONS;
+		}
+		if (!in_overlay) {
+			return LAB_DUMP_THEME;
+		}
+	}
+	return in_overlay ? LAB_DUMP_OVERLAYS : LAB_DUMP_OTHER;
+}
+
+static void
+dump_json_buffer(struct json_dump *dump, struct wlr_scene_node *node,
+		bool in_overlay)
+{
+	struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
+	struct wlr_buffer *buffer = scene_buffer->buffer;
+	enum dump_subsystem subsystem = get_buffer_subsystem(node, in_overlay);
+	struct dump_totals *totals = &dump->totals[subsystem];
+
+	buf_add(&dump->buf, ", \"subsystem\": ");
+	json_add_string(&dump->buf, subsystem_names[subsystem]);
+	if (!buffer) {
+		return;
+	}
+
+	/* Approximated like the scaled buffer cache, 4 bytes per pixel */
+	size_t bytes = (size_t)buffer->width * buffer->height * 4;
+	buf_add_fmt(&dump->buf, ", \"buffer\": {\"width\": %d, "
+		"\"height\": %d, \"bytes\": %zu, \"locks\": %zu}",
+		buffer->width, buffer->height, bytes, buffer->n_locks);
+
+	if (!g_hash_table_contains(dump->seen_buffers, buffer)) {
+		g_hash_table_add(dump->seen_buffers, buffer);
+		totals->buffers++;
+		totals->bytes += bytes;
+	}
+}
+
+static void
+dump_json_node(struct json_dump *dump, struct wlr_scene_node *node,
+		int x, int y, bool in_overlay)
+{
+	struct buf *buf = &dump->buf;
+	in_overlay = in_overlay || is_overlay_root(dump->server, node);
+
+	buf_add(buf, "{\"name\": ");
+	json_add_string(buf, get_special(dump->server, node));
+	buf_add_fmt(buf, ", \"type\": \"%s\", \"x\": %d, \"y\": %d, "
+		"\"enabled\": %s", get_node_type(node), x, y,
+		node->enabled ? "true" : "false");
+
+	if (node->type == WLR_SCENE_NODE_BUFFER) {
+		dump->totals[get_buffer_subsystem(node, in_overlay)].nodes++;
+		dump_json_buffer(dump, node, in_overlay);
+	} else if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+		buf_add(buf, ", \"children\": [");
+		struct wlr_scene_node *child;
+		bool first = true;
+		wl_list_for_each(child, &tree->children, link) {
+			buf_add(buf, first ? "" : ", ");
+			first = false;
+			dump_json_node(dump, child, x + child->x, y + child->y,
+				in_overlay);
+		}
+		buf_add_char(buf, ']');
+	}
+	buf_add_char(buf, '}');
+}
+
+static void
+dump_json_totals(struct json_dump *dump)
+{
+	struct buf *buf = &dump->buf;
+	buf_add(buf, ",\n\"totals\": {");
+	for (size_t i = 0; i < LAB_DUMP_COUNT; i++) {
+		struct dump_totals *totals = &dump->totals[i];
+		buf_add_fmt(buf, "%s\"%s\": {\"nodes\": %d, \"buffers\": %d, "
+			"\"bytes\": %zu}", i ? ", " : "", subsystem_names[i],
+			totals->nodes, totals->buffers, totals->bytes);
+	}
+
+	const struct scaled_scene_buffer_stats *stats =
+		scaled_scene_buffer_get_stats();
+	buf_add_fmt(buf, "},\n\"buffer_cache\": {\"entries\": %zu, "
+		"\"bytes\": %zu}", stats->entries, stats->bytes);
+}
+
+void
+debug_dump_scene_json(struct server *server, const char *path)
+{
+	struct json_dump dump = {
+		.server = server,
+		.buf = BUF_INIT,
+		.seen_buffers = g_hash_table_new(NULL, NULL),
+	};
+
+	buf_add(&dump.buf, "{\"scene\": ");
+	dump_json_node(&dump, &server->scene->tree.node, 0, 0,
+		/* in_overlay */ false);
+	dump_json_totals(&dump);
+	buf_add(&dump.buf, "}\n");
+	g_hash_table_destroy(dump.seen_buffers);
+	last_view = NULL;
+
+	/* Formatted in memory first, so the output is written in one go */
+	FILE *file = path ? fopen(path, "w") : stdout;
+	if (!file) {
+		wlr_log_errno(WLR_ERROR, "cannot write scene dump to %s", path);
+	} else {
+		fwrite(dump.buf.data, 1, dump.buf.len, file);
+		if (file == stdout) {
+			fflush(file);
+		} else {
+			fclose(file);
+		}
+	}
+	buf_reset(&dump.buf);
+}
@@ -14,6 +14,9 @@ struct kde_deco {
 	struct wl_list link;  /* decorations */
 	struct wlr_server_decoration *wlr_kde_decoration;
 	struct view *view;
+	/* The view_wants_decorations() result last applied to the view */
+	bool have_policy;
+	bool wants_ssd;
 	struct wl_listener mode;
 	struct wl_listener destroy;
 };
@@ -28,6 +31,20 @@ handle_destroy(struct wl_listener *listener, void *data)
 	free(kde_deco);
 }
 
+/* Only touches the view if its resolved policy changed */
+static void
+apply_policy(struct kde_deco *kde_deco)
+{
+	bool wants_ssd = view_wants_decorations(kde_deco->view);
+	if (kde_deco->have_policy && wants_ssd == kde_deco->wants_ssd) {
+		return;
+	}
+	kde_deco->have_policy = true;
+	kde_deco->wants_ssd = wants_ssd;
+	view_set_ssd_mode(kde_deco->view,
+		wants_ssd ? LAB_SSD_MODE_FULL : LAB_SSD_MODE_NONE);
+}
+
 static void
 handle_mode(struct wl_listener *listener, void *data)
 {
@@ -52,11 +69,7 @@ handle_mode(struct wl_listener *listener, void *data)
 			"requested: %u", client_mode);
 	}
 
-	if (kde_deco->view->ssd_preference == LAB_SSD_PREF_SERVER) {
-		view_set_ssd_mode(kde_deco->view, LAB_SSD_MODE_FULL);
-	} else {
-		view_set_ssd_mode(kde_deco->view, LAB_SSD_MODE_NONE);
-	}
+	apply_policy(kde_deco);
 }
 
 static void
@@ -116,6 +129,17 @@ kde_server_decoration_update_default(void)
 		: WLR_SERVER_DECORATION_MANAGER_MODE_CLIENT);
 }
 
+void
+kde_server_decoration_update_views(void)
+{
+	struct kde_deco *kde_deco;
+	wl_list_for_each(kde_deco, &decorations, link) {
+		if (kde_deco->view) {
+			apply_policy(kde_deco);
+		}
+	}
+}
+
 void
 kde_server_decoration_init(struct server *server)
 {
@@ -1,14 +1,21 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <wlr/types/wlr_xdg_decoration_v1.h>
+#include "common/list.h"
 #include "common/mem.h"
 #include "decorations.h"
 #include "labwc.h"
 #include "view.h"
 
+static struct wl_list decorations = WL_LIST_INIT(&decorations);
+
 struct xdg_deco {
+	struct wl_list link; /* decorations */
 	struct wlr_xdg_toplevel_decoration_v1 *wlr_xdg_decoration;
 	enum wlr_xdg_toplevel_decoration_v1_mode client_mode;
 	struct view *view;
+	/* The view_wants_decorations() result last applied to the view */
+	bool have_policy;
+	bool wants_ssd;
 	struct wl_listener destroy;
 	struct wl_listener request_mode;
 	struct wl_listener surface_commit;
@@ -20,6 +27,7 @@ xdg_deco_destroy(struct wl_listener *listener, void *data)
 	struct xdg_deco *xdg_deco = wl_container_of(listener, xdg_deco, destroy);
 	wl_list_remove(&xdg_deco->destroy.link);
 	wl_list_remove(&xdg_deco->request_mode.link);
+	wl_list_remove(&xdg_deco->link);
 	if (xdg_deco->surface_commit.notify) {
 		wl_list_remove(&xdg_deco->surface_commit.link);
 		xdg_deco->surface_commit.notify = NULL;
@@ -40,6 +48,47 @@ handle_surface_commit(struct wl_listener *listener, void *data)
 	}
 }
 
+static void
+send_mode(struct xdg_deco *xdg_deco)
+{
+	enum wlr_xdg_toplevel_decoration_v1_mode client_mode =
+		xdg_deco->wants_ssd
+		? WLR_XDG_TOPLEVEL_DECORATION_V1_MODE_SERVER_SIDE
+		: WLR_XDG_TOPLEVEL_DECORATION_V1_MODE_CLIENT_SIDE;
+
+	/*
+	 * We may get multiple request_mode calls in an uninitialized state.
+	 * Just update the last requested mode and only add the commit
+	 * handler on the first uninitialized state call.
+	 */
+	xdg_deco->client_mode = client_mode;
+
+	if (xdg_deco->wlr_xdg_decoration->toplevel->base->initialized) {
+		wlr_xdg_toplevel_decoration_v1_set_mode(xdg_deco->wlr_xdg_decoration,
+			client_mode);
+	} else if (!xdg_deco->surface_commit.notify) {
+		xdg_deco->surface_commit.notify = handle_surface_commit;
+		wl_signal_add(
+			&xdg_deco->wlr_xdg_decoration->toplevel->base->surface->events.commit,
+			&xdg_deco->surface_commit);
+	}
+}
+
+/* Returns false if the resolved policy of the view did not change */
+static bool
+apply_policy(struct xdg_deco *xdg_deco)
+{
+	bool wants_ssd = view_wants_decorations(xdg_deco->view);
+	if (xdg_deco->have_policy && wants_ssd == xdg_deco->wants_ssd) {
+		return false;
+	}
+	xdg_deco->have_policy = true;
+	xdg_deco->wants_ssd = wants_ssd;
+	view_set_ssd_mode(xdg_deco->view,
+		wants_ssd ? LAB_SSD_MODE_FULL : LAB_SSD_MODE_NONE);
+	return true;
+}
+
 static void
 xdg_deco_request_mode(struct wl_listener *listener, void *data)
 {
@@ -56,36 +105,15 @@ xdg_deco_request_mode(struct wl_listener *listener, void *data)
 		break;
 	case WLR_XDG_TOPLEVEL_DECORATION_V1_MODE_NONE:
 		xdg_deco->view->ssd_preference = LAB_SSD_PREF_UNSPEC;
-		client_mode = rc.xdg_shell_server_side_deco
-			? WLR_XDG_TOPLEVEL_DECORATION_V1_MODE_SERVER_SIDE
-			: WLR_XDG_TOPLEVEL_DECORATION_V1_MODE_CLIENT_SIDE;
 		break;
 	default:
 		wlr_log(WLR_ERROR, "Unspecified xdg decoration variant "
 			"requested: %u", client_mode);
 	}
 
-	/*
-	 * We may get multiple request_mode calls in an uninitialized state.
-	 * Just update the last requested mode and only add the commit
-	 * handler on the first uninitialized state call.
-	 */
-	xdg_deco->client_mode = client_mode;
-
-	if (xdg_deco->wlr_xdg_decoration->toplevel->base->initialized) {
-		wlr_xdg_toplevel_decoration_v1_set_mode(xdg_deco->wlr_xdg_decoration,
-			client_mode);
-	} else if (!xdg_deco->surface_commit.notify) {
-		xdg_deco->surface_commit.notify = handle_surface_commit;
-		wl_signal_add(
-			&xdg_deco->wlr_xdg_decoration->toplevel->base->surface->events.commit,
-			&xdg_deco->surface_commit);
-	}
-	if (client_mode == WLR_XDG_TOPLEVEL_DECORATION_V1_MODE_SERVER_SIDE) {
-		view_set_ssd_mode(xdg_deco->view, LAB_SSD_MODE_FULL);
-	} else {
-		view_set_ssd_mode(xdg_deco->view, LAB_SSD_MODE_NONE);
-	}
+	/* Every request is answered, even if the mode stays the same */
+	apply_policy(xdg_deco);
+	send_mode(xdg_deco);
 }
 
 static void
@@ -110,6 +138,7 @@ xdg_toplevel_decoration(struct wl_listener *listener, void *data)
 		&xdg_deco->request_mode);
 	xdg_deco->request_mode.notify = xdg_deco_request_mode;
 
+	wl_list_append(&decorations, &xdg_deco->link);
 	xdg_deco_request_mode(&xdg_deco->request_mode, wlr_xdg_decoration);
 }
 
@@ -128,6 +157,17 @@ xdg_server_decoration_init(struct server *server)
 	server->xdg_toplevel_decoration.notify = xdg_toplevel_decoration;
 }
 
+void
+xdg_server_decoration_update_views(void)
+{
+	struct xdg_deco *xdg_deco;
+	wl_list_for_each(xdg_deco, &decorations, link) {
+		if (apply_policy(xdg_deco)) {
+			send_mode(xdg_deco);
+		}
+	}
+}
+
 void
 xdg_server_decoration_finish(struct server *server)
 {
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <wayland-server-core.h>
+#include "deferred.h"
+
+static void
+handle_idle(void *data)
+{
+	struct deferred_queue *queue = data;
+	queue->idle = NULL;
+	deferred_queue_flush(queue);
+}
+
+void
+deferred_queue_init(struct deferred_queue *queue, struct wl_event_loop *loop)
+{
+	wl_list_init(&queue->tasks);
+	queue->loop = loop;
+	queue->idle = NULL;
+}
+
+void
+deferred_queue_finish(struct deferred_queue *queue)
+{
+	struct deferred_task *task, *tmp;
+	wl_list_for_each_safe(task, tmp, &queue->tasks, link) {
+		deferred_task_cancel(task);
+	}
+	if (queue->idle) {
+		wl_event_source_remove(queue->idle);
+		queue->idle = NULL;
+	}
+}
+
+void
+deferred_queue_flush(struct deferred_queue *queue)
+{
+	while (!wl_list_empty(&queue->tasks)) {
+		struct deferred_task *task =
+			wl_container_of(queue->tasks.next, task, link);
+		deferred_task_cancel(task);
+		/* Tasks scheduled from here run in this flush as well */
+		task->func(task->data);
+	}
+	if (queue->idle) {
+		wl_event_source_remove(queue->idle);
+		queue->idle = NULL;
+	}
+}
+
+void
+deferred_task_init(struct deferred_task *task, deferred_func_t func,
+		void *data)
+{
+	wl_list_init(&task->link);
+	task->func = func;
+	task->data = data;
+	task->queued = false;
+}
+
+void
+deferred_task_schedule(struct deferred_queue *queue,
+		struct deferred_task *task)
+{
+	assert(task->func);
+	if (task->queued) {
+		return;
+	}
+	wl_list_insert(queue->tasks.prev, &task->link);
+	task->queued = true;
+	if (!queue->idle) {
+		queue->idle = wl_event_loop_add_idle(queue->loop,
+			handle_idle, queue);
+	}
+}
+
+void
+deferred_task_cancel(struct deferred_task *task)
+{
+	if (!task->queued) {
+		return;
+	}
+	wl_list_remove(&task->link);
+	wl_list_init(&task->link);
+	task->queued = false;
+}
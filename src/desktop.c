@@ -1,14 +1,16 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include "config.h"
 #include <assert.h>
+#include "common/macros.h"
 #include "common/scene-helpers.h"
 #include "common/surface-helpers.h"
-#include "dnd.h"
 #include "labwc.h"
 #include "layers.h"
 #include "node.h"
 #include "osd.h"
+#include "probe.h"
 #include "ssd.h"
+#include "trace.h"
 #include "view.h"
 #include "window-rules.h"
 #include "workspaces.h"
@@ -31,12 +33,52 @@ desktop_arrange_all_views(struct server *server)
 	 * still unmapped. We do want to adjust the geometry of those
 	 * views.
 	 */
+	transaction_begin(server);
 	struct view *view;
 	wl_list_for_each(view, &server->views, link) {
 		if (!wlr_box_empty(&view->pending)) {
 			view_adjust_for_layout_change(view);
 		}
 	}
+	transaction_commit(server);
+}
+
+static bool
+box_intersects_any(struct wlr_box *box, struct wl_array *boxes)
+{
+	struct wlr_box *other, dummy;
+	wl_array_for_each(other, boxes) {
+		if (wlr_box_intersection(&dummy, box, other)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+desktop_arrange_views_in_boxes(struct server *server, struct wl_array *boxes)
+{
+	transaction_begin(server);
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		if (wlr_box_empty(&view->pending)) {
+			continue;
+		}
+		/*
+		 * Views are checked against both their current geometry
+		 * and the one from before they were last moved by a layout
+		 * change, so that a view evacuated from an output returns
+		 * when the output comes back.
+		 */
+		if (!output_is_usable(view->output)
+				|| box_intersects_any(&view->pending, boxes)
+				|| (!wlr_box_empty(&view->last_layout_geometry)
+				&& box_intersects_any(&view->last_layout_geometry,
+					boxes))) {
+			view_adjust_for_layout_change(view);
+		}
+	}
+	transaction_commit(server);
 }
 
 void
@@ -115,21 +157,35 @@ desktop_focus_view_or_surface(struct seat *seat, struct view *view,
 	}
 }
 
+/*
+ * Trees of the views on the current workspace which are neither
+ * always-on-top nor always-on-bottom, topmost first
+ */
+static void
+get_workspace_trees(struct server *server, struct wlr_scene_tree *trees[2])
+{
+	trees[0] = server->view_tree_omnipresent;
+	trees[1] = server->workspaces.current->tree;
+}
+
 struct view *
 desktop_topmost_focusable_view(struct server *server)
 {
 	struct view *view;
-	struct wl_list *node_list;
 	struct wlr_scene_node *node;
-	node_list = &server->workspaces.current->tree->children;
-	wl_list_for_each_reverse(node, node_list, link) {
-		if (!node->data) {
-			/* We found some non-view, most likely the region overlay */
-			continue;
-		}
-		view = node_view_from_node(node);
-		if (view->mapped && view_is_focusable(view)) {
-			return view;
+	struct wlr_scene_tree *trees[2];
+	get_workspace_trees(server, trees);
+	for (size_t i = 0; i < ARRAY_SIZE(trees); i++) {
+		wl_list_for_each_reverse(node, &trees[i]->children, link) {
+			if (!node->data) {
+				/* We found some non-view, most likely the region overlay */
+				continue;
+			}
+			view = node_view_from_node(node);
+			if (view->mapped && view_is_focusable(view)
+					&& !view->close_batch) {
+				return view;
+			}
 		}
 	}
 	return NULL;
@@ -160,24 +216,26 @@ desktop_focus_output(struct output *output)
 	struct view *view;
 	struct wlr_scene_node *node;
 	struct wlr_output_layout *layout = output->server->output_layout;
-	struct wl_list *list_head =
-		&output->server->workspaces.current->tree->children;
-	wl_list_for_each_reverse(node, list_head, link) {
-		if (!node->data) {
-			continue;
-		}
-		view = node_view_from_node(node);
-		if (!view_is_focusable(view)) {
-			continue;
-		}
-		if (wlr_output_layout_intersects(layout,
-				output->wlr_output, &view->current)) {
-			desktop_focus_view(view, /*raise*/ false);
-			wlr_cursor_warp(view->server->seat.cursor, NULL,
-				view->current.x + view->current.width / 2,
-				view->current.y + view->current.height / 2);
-			cursor_update_focus(view->server);
-			return;
+	struct wlr_scene_tree *trees[2];
+	get_workspace_trees(output->server, trees);
+	for (size_t i = 0; i < ARRAY_SIZE(trees); i++) {
+		wl_list_for_each_reverse(node, &trees[i]->children, link) {
+			if (!node->data) {
+				continue;
+			}
+			view = node_view_from_node(node);
+			if (!view_is_focusable(view)) {
+				continue;
+			}
+			if (wlr_output_layout_intersects(layout,
+					output->wlr_output, &view->current)) {
+				desktop_focus_view(view, /*raise*/ false);
+				wlr_cursor_warp(view->server->seat.cursor, NULL,
+					view->current.x + view->current.width / 2,
+					view->current.y + view->current.height / 2);
+				cursor_update_focus(view->server);
+				return;
+			}
 		}
 	}
 	/* No view found on desired output */
@@ -190,19 +248,68 @@ desktop_focus_output(struct output *output)
 	cursor_update_focus(output->server);
 }
 
+static void
+update_top_layer_visibility(void *data)
+{
+	desktop_update_top_layer_outputs(data, UINT64_MAX);
+}
+
 void
 desktop_update_top_layer_visibility(struct server *server)
+{
+	static struct deferred_task task = {
+		.func = update_top_layer_visibility,
+	};
+	task.data = server;
+	deferred_task_schedule(&server->deferred, &task);
+}
+
+void
+desktop_update_top_layer_outputs(struct server *server, uint64_t outputs)
 {
 	struct view *view;
 	struct output *output;
 	uint32_t top = ZWLR_LAYER_SHELL_V1_LAYER_TOP;
+	uint32_t overlay = ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY;
 
-	/* Enable all top layers */
+	if (transaction_defer_top_layer(server, outputs)) {
+		return;
+	}
+
+	/* The views below an opaque fullscreen view may have changed */
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output_get_mask(output) & outputs) {
+			output_update_culling(output, /*force*/ true);
+		}
+	}
+
+	/* All layers stay disabled until the session is unlocked */
+	if (server->session_lock_manager
+			&& server->session_lock_manager->content_hidden) {
+		return;
+	}
+
+	/* Enable all top and overlay layers */
+	uint64_t fullscreen_outputs = 0;
 	wl_list_for_each(output, &server->outputs, link) {
 		if (!output_is_usable(output)) {
 			continue;
 		}
+		uint64_t mask = output_get_mask(output);
+		if (outputs != UINT64_MAX && !(mask & outputs)) {
+			continue;
+		}
 		wlr_scene_node_set_enabled(&output->layer_tree[top]->node, true);
+		wlr_scene_node_set_enabled(&output->layer_tree[overlay]->node, true);
+		wlr_scene_node_set_enabled(&output->layer_popup_tree->node, true);
+		if (output->nr_fullscreen_views) {
+			fullscreen_outputs |= mask;
+		}
+	}
+
+	/* Nothing to disable, which is the usual case */
+	if (!fullscreen_outputs) {
+		return;
 	}
 
 	/*
@@ -217,9 +324,23 @@ desktop_update_top_layer_visibility(struct server *server)
 		if (!output_is_usable(view->output)) {
 			continue;
 		}
-		if (view->fullscreen && !(view->outputs & outputs_covered)) {
+		if (view->fullscreen && !(view->outputs & outputs_covered)
+				&& (output_get_mask(view->output)
+					& fullscreen_outputs)) {
 			wlr_scene_node_set_enabled(
 				&view->output->layer_tree[top]->node, false);
+			/*
+			 * Overlays would prevent direct scanout, so hide
+			 * them as well if requested by window rule
+			 */
+			if (window_rules_get_property(view, "preferScanout")
+					== LAB_PROP_TRUE) {
+				wlr_scene_node_set_enabled(&view->output
+					->layer_tree[overlay]->node, false);
+				wlr_scene_node_set_enabled(
+					&view->output->layer_popup_tree->node,
+					false);
+			}
 		}
 		outputs_covered |= view->outputs;
 	}
@@ -242,26 +363,131 @@ get_surface_from_layer_node(struct wlr_scene_node *node)
 	return NULL;
 }
 
-/* TODO: make this less big and scary */
-struct cursor_context
-get_cursor_context(struct server *server)
+/*
+ * Returns a fullscreen view covering all of the output at @lx,@ly, so that
+ * nothing stacked below it needs to be hit-tested.
+ */
+static struct view *
+covering_view_at(struct server *server, double lx, double ly)
 {
-	struct cursor_context ret = {.type = LAB_SSD_NONE};
-	struct wlr_cursor *cursor = server->seat.cursor;
+	struct wlr_output *wlr_output = wlr_output_layout_output_at(
+		server->output_layout, lx, ly);
+	struct output *output = output_from_wlr_output(server, wlr_output);
+	if (!output_is_usable(output)) {
+		return NULL;
+	}
 
-	/* Prevent drag icons to be on top of the hitbox detection */
-	if (server->seat.drag.active) {
-		dnd_icons_show(&server->seat, false);
+	struct wlr_box box;
+	wlr_output_layout_get_box(server->output_layout, wlr_output, &box);
+
+	struct view *view;
+	for_each_view(view, &server->views,
+			LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+		if (view->minimized || !view_on_output(view, output)) {
+			continue;
+		}
+		/* Only the topmost view on the output is considered */
+		int x, y;
+		if (!view->fullscreen || view->output != output
+				|| !wlr_scene_node_coords(&view->scene_tree->node, &x, &y)) {
+			return NULL;
+		}
+		struct wlr_box intersection;
+		if (!wlr_box_intersection(&intersection, &view->current, &box)
+				|| !wlr_box_equal(&intersection, &box)) {
+			return NULL;
+		}
+		return view;
 	}
+	return NULL;
+}
 
-	struct wlr_scene_node *node =
-		wlr_scene_node_at(&server->scene->tree.node,
-			cursor->x, cursor->y, &ret.sx, &ret.sy);
+/*
+ * Drag icons follow the cursor and would always be hit. They are skipped
+ * rather than disabled for the hit-test, which would damage them twice
+ * for every motion event of a drag.
+ */
+static bool
+skip_hit_test(struct server *server, struct wlr_scene_node *node)
+{
+	return node == &server->seat.drag.icons->node;
+}
 
-	if (server->seat.drag.active) {
-		dnd_icons_show(&server->seat, true);
+/*
+ * Hit-test the nodes stacked above @node, walking up to the scene root.
+ * At each level only the siblings above the current subtree are tested.
+ */
+static struct wlr_scene_node *
+node_at_above(struct server *server, struct wlr_scene_node *node,
+		double lx, double ly, double *sx, double *sy)
+{
+	for (; node->parent; node = &node->parent->node) {
+		struct wlr_scene_node *sibling;
+		wl_list_for_each_reverse(sibling, &node->parent->children, link) {
+			if (sibling == node) {
+				break;
+			}
+			if (skip_hit_test(server, sibling)) {
+				continue;
+			}
+			struct wlr_scene_node *hit =
+				wlr_scene_node_at(sibling, lx, ly, sx, sy);
+			if (hit) {
+				return hit;
+			}
+		}
 	}
+	return NULL;
+}
 
+/*
+ * wlr_scene_node_at() walks every node stacked above the hit, which on
+ * a busy desktop is most of the scene. When a fullscreen view covers the
+ * output under the cursor, only the nodes above it and the view itself
+ * can be hit, so the (usually much larger) part of the scene below it is
+ * skipped.
+ */
+static struct wlr_scene_node *
+scene_node_at(struct server *server, double lx, double ly,
+		double *sx, double *sy)
+{
+	struct view *view = covering_view_at(server, lx, ly);
+	if (view) {
+		struct wlr_scene_node *node = &view->scene_tree->node;
+		struct wlr_scene_node *hit =
+			node_at_above(server, node, lx, ly, sx, sy);
+		if (!hit) {
+			hit = wlr_scene_node_at(node, lx, ly, sx, sy);
+		}
+		if (hit) {
+			return hit;
+		}
+		/* Outside the input region of the view, test everything */
+	}
+
+	struct wlr_scene_node *child;
+	wl_list_for_each_reverse(child, &server->scene->tree.children, link) {
+		if (skip_hit_test(server, child)) {
+			continue;
+		}
+		struct wlr_scene_node *hit =
+			wlr_scene_node_at(child, lx, ly, sx, sy);
+		if (hit) {
+			return hit;
+		}
+	}
+	return NULL;
+}
+
+/* TODO: make this less big and scary */
+static struct cursor_context
+cursor_context_at_cursor(struct server *server)
+{
+	struct cursor_context ret = {.type = LAB_SSD_NONE};
+	struct wlr_cursor *cursor = server->seat.cursor;
+
+	struct wlr_scene_node *node = scene_node_at(server,
+		cursor->x, cursor->y, &ret.sx, &ret.sy);
 	ret.node = node;
 	if (!node) {
 		ret.type = LAB_SSD_ROOT;
@@ -278,6 +504,23 @@ get_cursor_context(struct server *server)
 		}
 	}
 #endif
+
+	/*
+	 * Most hits are on the main surface of a toplevel. Its view is
+	 * set on the xdg or xwayland surface when the view is created, so
+	 * there is no need to climb to the node descriptor of the view.
+	 */
+	if (node->type == WLR_SCENE_NODE_BUFFER) {
+		struct wlr_surface *surface = lab_wlr_surface_from_node(node);
+		struct view *view = surface ? view_from_wlr_surface(surface) : NULL;
+		if (view) {
+			ret.view = view;
+			ret.type = LAB_SSD_CLIENT;
+			ret.surface = surface;
+			return ret;
+		}
+	}
+
 	while (node) {
 		struct node_descriptor *desc = node->data;
 		if (desc) {
@@ -326,6 +569,8 @@ get_cursor_context(struct server *server)
 			case LAB_NODE_DESC_NODE:
 			case LAB_NODE_DESC_TREE:
 			case LAB_NODE_DESC_SCALED_SCENE_BUFFER:
+			case LAB_NODE_DESC_SSD_PART:
+				/* SSD parts are classified once the view is found */
 				break;
 			}
 		}
@@ -364,3 +609,14 @@ get_cursor_context(struct server *server)
 	return ret;
 }
 
+struct cursor_context
+get_cursor_context(struct server *server)
+{
+	TRACE_FUNC();
+	struct probe_timer timer;
+	probe_begin(&timer);
+	struct cursor_context ctx = cursor_context_at_cursor(server);
+	probe_end(&timer, LAB_PROBE_GET_CURSOR_CONTEXT);
+	return ctx;
+}
+
@@ -18,14 +18,14 @@ handle_handle_destroy(struct wl_listener *listener, void *data)
 	ext_toplevel->handle = NULL;
 }
 
-/* Compositor signals */
-static void
-handle_new_app_id(struct wl_listener *listener, void *data)
+void
+ext_foreign_toplevel_flush(struct foreign_toplevel *toplevel, uint32_t dirty)
 {
-	struct foreign_toplevel *toplevel =
-		wl_container_of(listener, toplevel, ext_toplevel.on_view.new_app_id);
-	assert(toplevel->ext_toplevel.handle);
-
+	if (!toplevel->ext_toplevel.handle
+			|| !(dirty & (LAB_FOREIGN_DIRTY_APP_ID
+				| LAB_FOREIGN_DIRTY_TITLE))) {
+		return;
+	}
 	struct wlr_ext_foreign_toplevel_handle_v1_state state = {
 		.title = view_get_string_prop(toplevel->view, "title"),
 		.app_id = view_get_string_prop(toplevel->view, "app_id")
@@ -34,19 +34,21 @@ handle_new_app_id(struct wl_listener *listener, void *data)
 		toplevel->ext_toplevel.handle, &state);
 }
 
+/* Compositor signals */
+static void
+handle_new_app_id(struct wl_listener *listener, void *data)
+{
+	struct foreign_toplevel *toplevel =
+		wl_container_of(listener, toplevel, ext_toplevel.on_view.new_app_id);
+	foreign_toplevel_mark_dirty(toplevel, LAB_FOREIGN_DIRTY_APP_ID);
+}
+
 static void
 handle_new_title(struct wl_listener *listener, void *data)
 {
 	struct foreign_toplevel *toplevel =
 		wl_container_of(listener, toplevel, ext_toplevel.on_view.new_title);
-	assert(toplevel->ext_toplevel.handle);
-
-	struct wlr_ext_foreign_toplevel_handle_v1_state state = {
-		.title = view_get_string_prop(toplevel->view, "title"),
-		.app_id = view_get_string_prop(toplevel->view, "app_id")
-	};
-	wlr_ext_foreign_toplevel_handle_v1_update_state(
-		toplevel->ext_toplevel.handle, &state);
+	foreign_toplevel_mark_dirty(toplevel, LAB_FOREIGN_DIRTY_TITLE);
 }
 
 /* Internal signals */
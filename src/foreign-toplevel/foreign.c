@@ -39,6 +39,24 @@ foreign_request_close(struct foreign_toplevel *toplevel)
 	view_close(toplevel->view);
 }
 
+static void
+handle_flush(void *data)
+{
+	struct foreign_toplevel *toplevel = data;
+	uint32_t dirty = toplevel->dirty;
+	toplevel->dirty = 0;
+	wlr_foreign_toplevel_flush(toplevel, dirty);
+	ext_foreign_toplevel_flush(toplevel, dirty);
+}
+
+void
+foreign_toplevel_mark_dirty(struct foreign_toplevel *toplevel, uint32_t dirty)
+{
+	toplevel->dirty |= dirty;
+	deferred_task_schedule(&toplevel->view->server->deferred,
+		&toplevel->flush_task);
+}
+
 /* Public API */
 struct foreign_toplevel *
 foreign_toplevel_create(struct view *view)
@@ -48,6 +66,7 @@ foreign_toplevel_create(struct view *view)
 
 	struct foreign_toplevel *toplevel = znew(*toplevel);
 	toplevel->view = view;
+	deferred_task_init(&toplevel->flush_task, handle_flush, toplevel);
 
 	wl_signal_init(&toplevel->events.toplevel_parent);
 	wl_signal_init(&toplevel->events.toplevel_destroy);
@@ -72,5 +91,6 @@ foreign_toplevel_destroy(struct foreign_toplevel *toplevel)
 	wl_signal_emit_mutable(&toplevel->events.toplevel_destroy, NULL);
 	assert(!toplevel->wlr_toplevel.handle);
 	assert(!toplevel->ext_toplevel.handle);
+	deferred_task_cancel(&toplevel->flush_task);
 	free(toplevel);
 }
@@ -74,14 +74,10 @@ handle_handle_destroy(struct wl_listener *listener, void *data)
 	wlr_toplevel->handle = NULL;
 }
 
-/* Compositor signals */
+/* State updates, see wlr_foreign_toplevel_flush() */
 static void
-handle_new_app_id(struct wl_listener *listener, void *data)
+send_app_id(struct foreign_toplevel *toplevel)
 {
-	struct foreign_toplevel *toplevel =
-		wl_container_of(listener, toplevel, wlr_toplevel.on_view.new_app_id);
-	assert(toplevel->wlr_toplevel.handle);
-
 	const char *app_id = view_get_string_prop(toplevel->view, "app_id");
 	const char *wlr_app_id = toplevel->wlr_toplevel.handle->app_id;
 	if (app_id && wlr_app_id && !strcmp(app_id, wlr_app_id)) {
@@ -92,12 +88,8 @@ handle_new_app_id(struct wl_listener *listener, void *data)
 }
 
 static void
-handle_new_title(struct wl_listener *listener, void *data)
+send_title(struct foreign_toplevel *toplevel)
 {
-	struct foreign_toplevel *toplevel =
-		wl_container_of(listener, toplevel, wlr_toplevel.on_view.new_title);
-	assert(toplevel->wlr_toplevel.handle);
-
 	const char *title = view_get_string_prop(toplevel->view, "title");
 	const char *wlr_title = toplevel->wlr_toplevel.handle->title;
 	if (title && wlr_title && !strcmp(title, wlr_title)) {
@@ -108,12 +100,8 @@ handle_new_title(struct wl_listener *listener, void *data)
 }
 
 static void
-handle_new_outputs(struct wl_listener *listener, void *data)
+send_outputs(struct foreign_toplevel *toplevel)
 {
-	struct foreign_toplevel *toplevel =
-		wl_container_of(listener, toplevel, wlr_toplevel.on_view.new_outputs);
-	assert(toplevel->wlr_toplevel.handle);
-
 	/*
 	 * Loop over all outputs and notify foreign_toplevel clients about changes.
 	 * wlr_foreign_toplevel_handle_v1_output_xxx() keeps track of the active
@@ -134,26 +122,91 @@ handle_new_outputs(struct wl_listener *listener, void *data)
 }
 
 static void
-handle_maximized(struct wl_listener *listener, void *data)
+send_maximized(struct foreign_toplevel *toplevel)
 {
-	struct foreign_toplevel *toplevel =
-		wl_container_of(listener, toplevel, wlr_toplevel.on_view.maximized);
-	assert(toplevel->wlr_toplevel.handle);
-
 	wlr_foreign_toplevel_handle_v1_set_maximized(
 		toplevel->wlr_toplevel.handle,
 		toplevel->view->maximized == VIEW_AXIS_BOTH);
 }
 
+static void
+send_fullscreen(struct foreign_toplevel *toplevel)
+{
+	wlr_foreign_toplevel_handle_v1_set_fullscreen(
+		toplevel->wlr_toplevel.handle, toplevel->view->fullscreen);
+}
+
+void
+wlr_foreign_toplevel_flush(struct foreign_toplevel *toplevel, uint32_t dirty)
+{
+	struct wlr_foreign_toplevel_handle_v1 *handle = toplevel->wlr_toplevel.handle;
+	if (!handle) {
+		return;
+	}
+	if (dirty & LAB_FOREIGN_DIRTY_APP_ID) {
+		send_app_id(toplevel);
+	}
+	if (dirty & LAB_FOREIGN_DIRTY_TITLE) {
+		send_title(toplevel);
+	}
+	if (dirty & LAB_FOREIGN_DIRTY_OUTPUTS) {
+		send_outputs(toplevel);
+	}
+	if (dirty & LAB_FOREIGN_DIRTY_MAXIMIZED) {
+		send_maximized(toplevel);
+	}
+	if (dirty & LAB_FOREIGN_DIRTY_MINIMIZED) {
+		wlr_foreign_toplevel_handle_v1_set_minimized(handle,
+			toplevel->view->minimized);
+	}
+	if (dirty & LAB_FOREIGN_DIRTY_FULLSCREEN) {
+		send_fullscreen(toplevel);
+	}
+	if (dirty & LAB_FOREIGN_DIRTY_ACTIVATED) {
+		wlr_foreign_toplevel_handle_v1_set_activated(handle,
+			toplevel->activated);
+	}
+}
+
+/* Compositor signals */
+static void
+handle_new_app_id(struct wl_listener *listener, void *data)
+{
+	struct foreign_toplevel *toplevel =
+		wl_container_of(listener, toplevel, wlr_toplevel.on_view.new_app_id);
+	foreign_toplevel_mark_dirty(toplevel, LAB_FOREIGN_DIRTY_APP_ID);
+}
+
+static void
+handle_new_title(struct wl_listener *listener, void *data)
+{
+	struct foreign_toplevel *toplevel =
+		wl_container_of(listener, toplevel, wlr_toplevel.on_view.new_title);
+	foreign_toplevel_mark_dirty(toplevel, LAB_FOREIGN_DIRTY_TITLE);
+}
+
+static void
+handle_new_outputs(struct wl_listener *listener, void *data)
+{
+	struct foreign_toplevel *toplevel =
+		wl_container_of(listener, toplevel, wlr_toplevel.on_view.new_outputs);
+	foreign_toplevel_mark_dirty(toplevel, LAB_FOREIGN_DIRTY_OUTPUTS);
+}
+
+static void
+handle_maximized(struct wl_listener *listener, void *data)
+{
+	struct foreign_toplevel *toplevel =
+		wl_container_of(listener, toplevel, wlr_toplevel.on_view.maximized);
+	foreign_toplevel_mark_dirty(toplevel, LAB_FOREIGN_DIRTY_MAXIMIZED);
+}
+
 static void
 handle_minimized(struct wl_listener *listener, void *data)
 {
 	struct foreign_toplevel *toplevel =
 		wl_container_of(listener, toplevel, wlr_toplevel.on_view.minimized);
-	assert(toplevel->wlr_toplevel.handle);
-
-	wlr_foreign_toplevel_handle_v1_set_minimized(
-		toplevel->wlr_toplevel.handle, toplevel->view->minimized);
+	foreign_toplevel_mark_dirty(toplevel, LAB_FOREIGN_DIRTY_MINIMIZED);
 }
 
 static void
@@ -161,10 +214,7 @@ handle_fullscreened(struct wl_listener *listener, void *data)
 {
 	struct foreign_toplevel *toplevel =
 		wl_container_of(listener, toplevel, wlr_toplevel.on_view.fullscreened);
-	assert(toplevel->wlr_toplevel.handle);
-
-	wlr_foreign_toplevel_handle_v1_set_fullscreen(
-		toplevel->wlr_toplevel.handle, toplevel->view->fullscreen);
+	foreign_toplevel_mark_dirty(toplevel, LAB_FOREIGN_DIRTY_FULLSCREEN);
 }
 
 static void
@@ -172,11 +222,9 @@ handle_activated(struct wl_listener *listener, void *data)
 {
 	struct foreign_toplevel *toplevel =
 		wl_container_of(listener, toplevel, wlr_toplevel.on_view.activated);
-	assert(toplevel->wlr_toplevel.handle);
-
 	bool *activated = data;
-	wlr_foreign_toplevel_handle_v1_set_activated(
-		toplevel->wlr_toplevel.handle, *activated);
+	toplevel->activated = *activated;
+	foreign_toplevel_mark_dirty(toplevel, LAB_FOREIGN_DIRTY_ACTIVATED);
 }
 
 /* Internal signals */
@@ -236,11 +284,11 @@ wlr_foreign_toplevel_init(struct foreign_toplevel *toplevel)
 	}
 
 	/* These states may be set before the initial map */
-	handle_new_app_id(&wlr_toplevel->on_view.new_app_id, NULL);
-	handle_new_title(&wlr_toplevel->on_view.new_title, NULL);
-	handle_maximized(&wlr_toplevel->on_view.maximized, NULL);
-	handle_fullscreened(&wlr_toplevel->on_view.fullscreened, NULL);
-	handle_new_outputs(&wlr_toplevel->on_view.new_outputs, NULL);
+	send_app_id(toplevel);
+	send_title(toplevel);
+	send_maximized(toplevel);
+	send_fullscreen(toplevel);
+	send_outputs(toplevel);
 
 	/* Client side requests */
 	CONNECT_SIGNAL(wlr_toplevel->handle, &wlr_toplevel->on, request_maximize);
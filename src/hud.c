@@ -0,0 +1,363 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * hud.c: on-screen statistics for debugging performance
+ *
+ * Each output gets a small box in its osd_tree with one font buffer per
+ * line. The statistics are rates over the last update interval, computed
+ * from the difference of the counters in struct output_metrics.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_scene.h>
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/scaled-font-buffer.h"
+#include "common/scaled-rect-buffer.h"
+#include "common/scaled-scene-buffer.h"
+#include "config/rcxml.h"
+#include "hud.h"
+#include "labwc.h"
+#include "output-timing.h"
+#include "theme.h"
+
+#define HUD_UPDATE_MSEC 500
+#define HUD_MAX_LINES 8
+#define HUD_MAX_LINE 128
+#define HUD_PADDING 6
+#define HUD_MARGIN 8
+
+struct hud_output {
+	struct output *output;
+	struct wlr_scene_tree *tree;
+	struct scaled_rect_buffer *bg;
+	struct scaled_font_buffer *lines[HUD_MAX_LINES];
+	int nr_lines;
+
+	/* Counters at the previous update */
+	struct output_metrics last;
+	uint64_t last_input_msec;
+	uint64_t last_input_count;
+	int64_t last_nsec;
+};
+
+static struct {
+	enum hud_mode mode;
+	struct wl_event_source *timer;
+
+	/* The buffer cache is global, its line is formatted once per update */
+	struct scaled_scene_buffer_stats last_cache;
+	char cache_line[HUD_MAX_LINE];
+} hud;
+
+static int64_t
+now_nsec(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/* The overlay must never steal pointer focus */
+static bool
+reject_input(struct wlr_scene_buffer *buffer, double *sx, double *sy)
+{
+	return false;
+}
+
+static double
+average_msec(uint64_t sum_ns, uint64_t samples)
+{
+	return samples ? sum_ns / 1e6 / samples : 0.0;
+}
+
+static int
+format_frame_pacing(struct hud_output *hud_output, double seconds,
+		char lines[][HUD_MAX_LINE])
+{
+	struct output *output = hud_output->output;
+	struct output_metrics *now = &output->metrics;
+	struct output_metrics *last = &hud_output->last;
+	int refresh = output->repaint.refresh_nsec;
+
+	snprintf(lines[0], HUD_MAX_LINE, "%s  %.1f Hz  %.1f fps",
+		output->wlr_output->name, refresh ? 1e9 / refresh : 0.0,
+		(now->frames_presented - last->frames_presented) / seconds);
+	snprintf(lines[1], HUD_MAX_LINE, "missed vblanks %" PRIu64
+		"  (%" PRIu64 " total)",
+		now->missed_vblanks - last->missed_vblanks,
+		now->missed_vblanks);
+	snprintf(lines[2], HUD_MAX_LINE, "judder %.2f ms  latency %.2f ms",
+		average_msec(now->judder_ns_sum - last->judder_ns_sum,
+			now->judder_samples - last->judder_samples),
+		average_msec(now->latency_ns_sum - last->latency_ns_sum,
+			now->latency_samples - last->latency_samples));
+	return 3;
+}
+
+/* Sum of the input-to-commit latency of all devices on @output */
+static void
+input_latency_totals(struct output *output, uint64_t *msec, uint64_t *count)
+{
+	*msec = 0;
+	*count = 0;
+	if (!output->timing) {
+		return;
+	}
+	struct input_latency *latency;
+	wl_array_for_each(latency, &output->timing->input_latency) {
+		*msec += latency->total_msec;
+		*count += latency->count;
+	}
+}
+
+static int
+format_perf(struct hud_output *hud_output, double seconds,
+		char lines[][HUD_MAX_LINE])
+{
+	struct output *output = hud_output->output;
+	struct output_metrics *now = &output->metrics;
+	struct output_metrics *last = &hud_output->last;
+	int refresh = output->repaint.refresh_nsec;
+
+	snprintf(lines[0], HUD_MAX_LINE, "%s  %.1f fps  (%.1f Hz)",
+		output->wlr_output->name,
+		(now->frames_rendered - last->frames_rendered) / seconds,
+		refresh ? 1e9 / refresh : 0.0);
+
+	uint64_t cost_sum = 0;
+	uint32_t cost_max = 0;
+	size_t nr_costs = 0;
+	for (size_t i = 0; i < ARRAY_SIZE(output->repaint.cost_nsec); i++) {
+		uint32_t cost = output->repaint.cost_nsec[i];
+		if (cost) {
+			cost_sum += cost;
+			cost_max = MAX(cost_max, cost);
+			nr_costs++;
+		}
+	}
+	snprintf(lines[1], HUD_MAX_LINE, "frame time %.2f ms  max %.2f ms",
+		average_msec(cost_sum, nr_costs), cost_max / 1e6);
+
+	snprintf(lines[2], HUD_MAX_LINE, "commit latency %.2f ms",
+		average_msec(now->latency_ns_sum - last->latency_ns_sum,
+			now->latency_samples - last->latency_samples));
+
+	uint64_t input_msec, input_count;
+	input_latency_totals(output, &input_msec, &input_count);
+	if (output->timing) {
+		uint64_t count = input_count - hud_output->last_input_count;
+		snprintf(lines[3], HUD_MAX_LINE, "input latency %.1f ms",
+			count ? (double)(input_msec
+				- hud_output->last_input_msec) / count : 0.0);
+	} else {
+		snprintf(lines[3], HUD_MAX_LINE,
+			"input latency needs <frameTiming>");
+	}
+	hud_output->last_input_msec = input_msec;
+	hud_output->last_input_count = input_count;
+
+	memcpy(lines[4], hud.cache_line, HUD_MAX_LINE);
+	return 5;
+}
+
+static void
+update_cache_line(void)
+{
+	const struct scaled_scene_buffer_stats *now =
+		scaled_scene_buffer_get_stats();
+	struct scaled_scene_buffer_stats *last = &hud.last_cache;
+	uint64_t found = (now->hits - last->hits) + (now->shared - last->shared);
+	uint64_t lookups = found + (now->misses - last->misses);
+	if (lookups) {
+		snprintf(hud.cache_line, HUD_MAX_LINE,
+			"buffer cache %.1f%% hits  %zu KiB",
+			100.0 * found / lookups, now->bytes / 1024);
+	} else {
+		snprintf(hud.cache_line, HUD_MAX_LINE,
+			"buffer cache idle  %zu KiB", now->bytes / 1024);
+	}
+	*last = *now;
+}
+
+static void
+update_background(struct hud_output *hud_output, int width, int height)
+{
+	if (hud_output->bg && hud_output->bg->width == width
+			&& hud_output->bg->height == height) {
+		return;
+	}
+	if (hud_output->bg) {
+		wlr_scene_node_destroy(&hud_output->bg->scene_buffer->node);
+	}
+	struct theme *theme = hud_output->output->server->theme;
+	hud_output->bg = scaled_rect_buffer_create(hud_output->tree, width,
+		height, theme->osd_border_width, theme->osd_bg_color,
+		theme->osd_border_color);
+	hud_output->bg->scene_buffer->point_accepts_input = reject_input;
+	wlr_scene_node_lower_to_bottom(&hud_output->bg->scene_buffer->node);
+}
+
+static void
+hud_output_update(struct hud_output *hud_output, int64_t now)
+{
+	struct output *output = hud_output->output;
+	struct theme *theme = output->server->theme;
+	double seconds = (now - hud_output->last_nsec) / 1e9;
+	if (seconds <= 0) {
+		return;
+	}
+
+	char text[HUD_MAX_LINES][HUD_MAX_LINE];
+	int nr_lines = 0;
+	switch (hud.mode) {
+	case LAB_HUD_FRAME_PACING:
+		nr_lines = format_frame_pacing(hud_output, seconds, text);
+		break;
+	case LAB_HUD_PERF:
+		nr_lines = format_perf(hud_output, seconds, text);
+		break;
+	case LAB_HUD_OFF:
+		return;
+	}
+	hud_output->last = output->metrics;
+	hud_output->last_nsec = now;
+
+	int width = 0;
+	int y = HUD_PADDING;
+	for (int i = 0; i < nr_lines; i++) {
+		struct scaled_font_buffer *line = hud_output->lines[i];
+		if (!line) {
+			line = scaled_font_buffer_create(hud_output->tree);
+			line->scene_buffer->point_accepts_input = reject_input;
+			hud_output->lines[i] = line;
+		}
+		/* Unchanged text is not re-rendered and adds no damage */
+		if (!line->text || strcmp(line->text, text[i])) {
+			scaled_font_buffer_update(line, text[i], -1,
+				&rc.font_osd, theme->osd_label_text_color,
+				theme->osd_bg_color);
+		}
+		wlr_scene_node_set_position(&line->scene_buffer->node,
+			HUD_PADDING, y);
+		width = MAX(width, line->width);
+		y += line->height;
+	}
+	for (int i = nr_lines; i < hud_output->nr_lines; i++) {
+		wlr_scene_node_destroy(&hud_output->lines[i]->scene_buffer->node);
+		hud_output->lines[i] = NULL;
+	}
+	hud_output->nr_lines = nr_lines;
+
+	/* Round up so that small changes of the text don't resize the box */
+	width = (width + 2 * HUD_PADDING + 31) / 32 * 32;
+	update_background(hud_output, width, y + HUD_PADDING);
+
+	struct wlr_box usable = output_usable_area_in_layout_coords(output);
+	wlr_scene_node_set_position(&hud_output->tree->node,
+		usable.x + HUD_MARGIN, usable.y + HUD_MARGIN);
+}
+
+static struct hud_output *
+hud_output_create(struct output *output)
+{
+	struct hud_output *hud_output = znew(*hud_output);
+	hud_output->output = output;
+	hud_output->tree = wlr_scene_tree_create(output->osd_tree);
+	hud_output->last = output->metrics;
+	input_latency_totals(output, &hud_output->last_input_msec,
+		&hud_output->last_input_count);
+	hud_output->last_nsec = now_nsec();
+	output->hud = hud_output;
+	return hud_output;
+}
+
+void
+hud_output_destroy(struct output *output)
+{
+	struct hud_output *hud_output = output->hud;
+	if (!hud_output) {
+		return;
+	}
+	wlr_scene_node_destroy(&hud_output->tree->node);
+	free(hud_output);
+	output->hud = NULL;
+}
+
+static void
+destroy_all(struct server *server)
+{
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		hud_output_destroy(output);
+	}
+}
+
+static int
+handle_timer(void *data)
+{
+	struct server *server = data;
+	int64_t now = now_nsec();
+	update_cache_line();
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (!output_is_usable(output)) {
+			hud_output_destroy(output);
+			continue;
+		}
+		if (!output->hud) {
+			/* Rates are shown from the next update on */
+			hud_output_create(output);
+			continue;
+		}
+		hud_output_update(output->hud, now);
+	}
+	wl_event_source_timer_update(hud.timer, HUD_UPDATE_MSEC);
+	return 0;
+}
+
+void
+hud_toggle(struct server *server, enum hud_mode mode)
+{
+	assert(mode != LAB_HUD_OFF);
+	destroy_all(server);
+	if (hud.mode == mode) {
+		hud_finish(server);
+		return;
+	}
+
+	hud.mode = mode;
+	hud.last_cache = *scaled_scene_buffer_get_stats();
+	if (!hud.timer) {
+		hud.timer = wl_event_loop_add_timer(server->wl_event_loop,
+			handle_timer, server);
+	}
+	handle_timer(server);
+}
+
+void
+hud_reconfigure(struct server *server)
+{
+	if (hud.mode == LAB_HUD_OFF) {
+		return;
+	}
+	/* Recreated with the new theme by the next update */
+	destroy_all(server);
+	handle_timer(server);
+}
+
+void
+hud_finish(struct server *server)
+{
+	destroy_all(server);
+	if (hud.timer) {
+		wl_event_source_remove(hud.timer);
+	}
+	hud.timer = NULL;
+	hud.mode = LAB_HUD_OFF;
+}
@@ -0,0 +1,732 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * icon-index.c: XDG icon theme and desktop entry lookup
+ *
+ * Scanning an icon theme reads hundreds of directories, which is far too
+ * slow to do whenever a window maps. The icons of the configured theme,
+ * the themes it inherits, the pixmaps and the Icon keys of the desktop
+ * entries are indexed once and the index is written to
+ * $XDG_CACHE_HOME/labwc/. Later starts mmap() it and only stat() the
+ * scanned directories; the index is rebuilt if any of their mtimes
+ * changed, e.g. when a package installed new icons.
+ *
+ * The index is a single blob of fixed-size records followed by a string
+ * table, all strings being referenced by their offset in that table:
+ *
+ *   header | dirs[] | icons[] | apps[] | strings
+ *
+ * Icons are sorted by name and apps by app id, so both are found by
+ * binary search without parsing anything at startup.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "common/array.h"
+#include "common/buf.h"
+#include "common/dir.h"
+#include "common/list.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/string-helpers.h"
+#include "config.h"
+#include "config/rcxml.h"
+#include "icon-index.h"
+
+#define ICON_INDEX_MAGIC 0x4e43494c /* "LICN" */
+#define ICON_INDEX_VERSION 1
+/* Themes in the inheritance chain, including hicolor */
+#define ICON_THEME_MAX 16
+
+struct index_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size; /* of the whole blob */
+	uint32_t theme;
+	uint32_t nr_dirs;
+	uint32_t nr_icons;
+	uint32_t nr_apps;
+	uint32_t strings; /* offset of the string table in the blob */
+};
+
+struct index_dir {
+	uint32_t path;
+	uint32_t pad;
+	int64_t mtime_nsec; /* -1 if the directory did not exist */
+};
+
+struct index_icon {
+	uint32_t name;
+	uint32_t path;
+	uint16_t size; /* nominal size in pixels, 0 if unknown */
+	uint8_t rank; /* position of its theme in the inheritance chain */
+	uint8_t scalable;
+};
+
+struct index_app {
+	uint32_t app_id;
+	uint32_t icon;
+};
+
+static struct {
+	void *blob;
+	size_t size;
+	bool mapped;
+	const struct index_header *header;
+	const struct index_icon *icons;
+	const struct index_app *apps;
+	const char *strings;
+} cache;
+
+struct builder {
+	struct wl_array dirs; /* struct index_dir */
+	struct wl_array icons; /* struct index_icon */
+	struct wl_array apps; /* struct index_app */
+	struct wl_array strings; /* char */
+};
+
+struct theme {
+	char *name;
+	GKeyFile *keys; /* index.theme, NULL if none was found */
+};
+
+static uint32_t
+add_string_len(struct builder *b, const char *str, size_t len)
+{
+	uint32_t offset = b->strings.size;
+	char *dest = wl_array_add(&b->strings, len + 1);
+	if (!dest) {
+		wlr_log(WLR_ERROR, "cannot allocate icon index");
+		exit(EXIT_FAILURE);
+	}
+	memcpy(dest, str, len);
+	dest[len] = '\0';
+	return offset;
+}
+
+static uint32_t
+add_string(struct builder *b, const char *str)
+{
+	return add_string_len(b, str, strlen(str));
+}
+
+static int64_t
+dir_mtime_nsec(const char *path)
+{
+	struct stat st;
+	if (stat(path, &st) || !S_ISDIR(st.st_mode)) {
+		return -1;
+	}
+	return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+/* Directories whose contents are indexed, to tell when it is stale */
+static void
+record_dir(struct builder *b, const char *path)
+{
+	struct index_dir dir = {
+		.path = add_string(b, path),
+		.mtime_nsec = dir_mtime_nsec(path),
+	};
+	array_add(&b->dirs, dir);
+}
+
+static void
+scan_icon_dir(struct builder *b, const char *path, int size, bool scalable,
+		int rank)
+{
+	record_dir(b, path);
+	DIR *dir = opendir(path);
+	if (!dir) {
+		return;
+	}
+	struct buf file = BUF_INIT;
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		const char *ext = strrchr(entry->d_name, '.');
+		if (!ext || ext == entry->d_name) {
+			continue;
+		}
+		bool svg = !strcasecmp(ext, ".svg");
+#if !HAVE_RSVG
+		if (svg) {
+			continue;
+		}
+#endif
+		if (!svg && strcasecmp(ext, ".png")) {
+			continue;
+		}
+		buf_clear(&file);
+		buf_add_fmt(&file, "%s/%s", path, entry->d_name);
+		struct index_icon icon = {
+			.name = add_string_len(b, entry->d_name,
+				ext - entry->d_name),
+			.path = add_string(b, file.data),
+			.size = CLAMP(size, 0, UINT16_MAX),
+			.rank = rank,
+			.scalable = svg || scalable,
+		};
+		array_add(&b->icons, icon);
+	}
+	buf_reset(&file);
+	closedir(dir);
+}
+
+/* Icon base directories, ~/.icons first as the icon theme spec says */
+static void
+icon_base_dirs(struct wl_list *paths)
+{
+	paths_data_create(paths, "icons");
+	const char *home = getenv("HOME");
+	if (!string_null_or_empty(home)) {
+		struct path *path = znew(*path);
+		path->string = strdup_printf("%s/.icons", home);
+		wl_list_insert(paths, &path->link);
+	}
+}
+
+static GKeyFile *
+load_theme_keys(struct wl_list *bases, const char *name)
+{
+	struct buf file = BUF_INIT;
+	GKeyFile *keys = g_key_file_new();
+	struct path *base;
+	wl_list_for_each(base, bases, link) {
+		buf_clear(&file);
+		buf_add_fmt(&file, "%s/%s/index.theme", base->string, name);
+		if (g_key_file_load_from_file(keys, file.data, G_KEY_FILE_NONE,
+				NULL)) {
+			buf_reset(&file);
+			return keys;
+		}
+	}
+	buf_reset(&file);
+	g_key_file_free(keys);
+	return NULL;
+}
+
+static bool
+chain_contains(struct wl_array *chain, const char *name)
+{
+	struct theme *theme;
+	wl_array_for_each(theme, chain) {
+		if (!strcmp(theme->name, name)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void
+chain_add(struct wl_array *chain, struct wl_list *bases, const char *name)
+{
+	if (chain->size / sizeof(struct theme) >= ICON_THEME_MAX
+			|| chain_contains(chain, name)) {
+		return;
+	}
+	struct theme theme = {
+		.name = xstrdup(name),
+		.keys = load_theme_keys(bases, name),
+	};
+	array_add(chain, theme);
+}
+
+/* The configured theme, the themes it inherits and finally hicolor */
+static void
+build_theme_chain(struct wl_array *chain, struct wl_list *bases,
+		const char *name)
+{
+	wl_array_init(chain);
+	if (!string_null_or_empty(name)) {
+		chain_add(chain, bases, name);
+	}
+	/* The array may move while it is iterated, so index it */
+	for (size_t i = 0; i < chain->size / sizeof(struct theme); i++) {
+		struct theme *theme = (struct theme *)chain->data + i;
+		if (!theme->keys) {
+			continue;
+		}
+		char **inherits = g_key_file_get_string_list(theme->keys,
+			"Icon Theme", "Inherits", NULL, NULL);
+		for (char **p = inherits; p && *p; p++) {
+			chain_add(chain, bases, g_strstrip(*p));
+		}
+		g_strfreev(inherits);
+	}
+	chain_add(chain, bases, "hicolor");
+}
+
+static void
+scan_theme(struct builder *b, struct wl_list *bases, struct theme *theme,
+		int rank)
+{
+	char **subdirs = theme->keys ? g_key_file_get_string_list(theme->keys,
+		"Icon Theme", "Directories", NULL, NULL) : NULL;
+	struct buf path = BUF_INIT;
+	struct path *base;
+	wl_list_for_each(base, bases, link) {
+		buf_clear(&path);
+		buf_add_fmt(&path, "%s/%s", base->string, theme->name);
+		record_dir(b, path.data);
+		if (dir_mtime_nsec(path.data) < 0) {
+			continue;
+		}
+		for (char **p = subdirs; p && *p; p++) {
+			int size = g_key_file_get_integer(theme->keys, *p,
+				"Size", NULL);
+			char *type = g_key_file_get_string(theme->keys, *p,
+				"Type", NULL);
+			bool scalable = type && !strcmp(type, "Scalable");
+			g_free(type);
+
+			buf_clear(&path);
+			buf_add_fmt(&path, "%s/%s/%s", base->string,
+				theme->name, *p);
+			scan_icon_dir(b, path.data, size, scalable, rank);
+		}
+	}
+	buf_reset(&path);
+	g_strfreev(subdirs);
+}
+
+static void
+scan_desktop_entries(struct builder *b)
+{
+	struct wl_list paths;
+	paths_data_create(&paths, "applications");
+	struct buf file = BUF_INIT;
+	GKeyFile *keys = g_key_file_new();
+	struct path *path;
+	wl_list_for_each(path, &paths, link) {
+		record_dir(b, path->string);
+		DIR *dir = opendir(path->string);
+		if (!dir) {
+			continue;
+		}
+		struct dirent *entry;
+		while ((entry = readdir(dir))) {
+			if (!str_endswith(entry->d_name, ".desktop")) {
+				continue;
+			}
+			buf_clear(&file);
+			buf_add_fmt(&file, "%s/%s", path->string, entry->d_name);
+			if (!g_key_file_load_from_file(keys, file.data,
+					G_KEY_FILE_NONE, NULL)) {
+				continue;
+			}
+			char *icon = g_key_file_get_string(keys,
+				"Desktop Entry", "Icon", NULL);
+			if (string_null_or_empty(icon)) {
+				g_free(icon);
+				continue;
+			}
+			/* The id of a desktop file is its name without suffix */
+			uint32_t app_id = add_string_len(b, entry->d_name,
+				strlen(entry->d_name) - strlen(".desktop"));
+			struct index_app app = {
+				.app_id = app_id,
+				.icon = add_string(b, icon),
+			};
+			array_add(&b->apps, app);
+
+			char *wm_class = g_key_file_get_string(keys,
+				"Desktop Entry", "StartupWMClass", NULL);
+			if (!string_null_or_empty(wm_class)) {
+				app.app_id = add_string(b, wm_class);
+				array_add(&b->apps, app);
+			}
+			g_free(wm_class);
+			g_free(icon);
+		}
+		closedir(dir);
+	}
+	g_key_file_free(keys);
+	buf_reset(&file);
+	paths_destroy(&paths);
+}
+
+/* Strings of the builder while sorting, qsort() has no user data */
+static const char *sort_strings;
+
+static int
+compare_icons(const void *a, const void *b)
+{
+	const struct index_icon *icon_a = a;
+	const struct index_icon *icon_b = b;
+	int ret = strcmp(sort_strings + icon_a->name,
+		sort_strings + icon_b->name);
+	if (ret) {
+		return ret;
+	}
+	/* Keep the order of the base directories */
+	return icon_a->path < icon_b->path ? -1 : icon_a->path > icon_b->path;
+}
+
+static int
+compare_apps(const void *a, const void *b)
+{
+	const struct index_app *app_a = a;
+	const struct index_app *app_b = b;
+	int ret = strcasecmp(sort_strings + app_a->app_id,
+		sort_strings + app_b->app_id);
+	if (ret) {
+		return ret;
+	}
+	/* Strings are appended, so earlier data directories win */
+	return app_a->icon < app_b->icon ? -1 : app_a->icon > app_b->icon;
+}
+
+static void *
+builder_serialize(struct builder *b, const char *theme_name, size_t *size)
+{
+	uint32_t theme = add_string(b, theme_name);
+	sort_strings = b->strings.data;
+	qsort(b->icons.data, b->icons.size / sizeof(struct index_icon),
+		sizeof(struct index_icon), compare_icons);
+	qsort(b->apps.data, b->apps.size / sizeof(struct index_app),
+		sizeof(struct index_app), compare_apps);
+	sort_strings = NULL;
+
+	struct index_header header = {
+		.magic = ICON_INDEX_MAGIC,
+		.version = ICON_INDEX_VERSION,
+		.theme = theme,
+		.nr_dirs = b->dirs.size / sizeof(struct index_dir),
+		.nr_icons = b->icons.size / sizeof(struct index_icon),
+		.nr_apps = b->apps.size / sizeof(struct index_app),
+		.strings = sizeof(header) + b->dirs.size + b->icons.size
+			+ b->apps.size,
+	};
+	*size = header.strings + b->strings.size;
+	header.size = *size;
+
+	char *blob = xzalloc(*size);
+	char *p = blob;
+	memcpy(p, &header, sizeof(header));
+	p += sizeof(header);
+	memcpy(p, b->dirs.data, b->dirs.size);
+	p += b->dirs.size;
+	memcpy(p, b->icons.data, b->icons.size);
+	p += b->icons.size;
+	memcpy(p, b->apps.data, b->apps.size);
+	p += b->apps.size;
+	memcpy(p, b->strings.data, b->strings.size);
+	return blob;
+}
+
+static void *
+index_build(const char *theme_name, size_t *size)
+{
+	struct builder b = {0};
+	wl_array_init(&b.dirs);
+	wl_array_init(&b.icons);
+	wl_array_init(&b.apps);
+	wl_array_init(&b.strings);
+
+	struct wl_list bases;
+	icon_base_dirs(&bases);
+	struct wl_array chain;
+	build_theme_chain(&chain, &bases, theme_name);
+	int rank = 0;
+	struct theme *theme;
+	wl_array_for_each(theme, &chain) {
+		scan_theme(&b, &bases, theme, rank++);
+		zfree(theme->name);
+		if (theme->keys) {
+			g_key_file_free(theme->keys);
+		}
+	}
+	wl_array_release(&chain);
+	paths_destroy(&bases);
+
+	/* Unthemed icons come last */
+	struct wl_list pixmaps;
+	paths_data_create(&pixmaps, "pixmaps");
+	struct path *path;
+	wl_list_for_each(path, &pixmaps, link) {
+		scan_icon_dir(&b, path->string, 0, false, rank);
+	}
+	paths_destroy(&pixmaps);
+
+	scan_desktop_entries(&b);
+
+	void *blob = builder_serialize(&b, theme_name, size);
+	wlr_log(WLR_INFO, "indexed %zu icons and %zu desktop entries",
+		b.icons.size / sizeof(struct index_icon),
+		b.apps.size / sizeof(struct index_app));
+	wl_array_release(&b.dirs);
+	wl_array_release(&b.icons);
+	wl_array_release(&b.apps);
+	wl_array_release(&b.strings);
+	return blob;
+}
+
+static bool
+string_valid(const struct index_header *header, uint32_t offset)
+{
+	return offset < header->size - header->strings;
+}
+
+/* Checks the bounds of everything, the file may be truncated or corrupt */
+static bool
+index_valid(const void *blob, size_t size, const char *theme_name)
+{
+	const struct index_header *header = blob;
+	if (size < sizeof(*header) || header->magic != ICON_INDEX_MAGIC
+			|| header->version != ICON_INDEX_VERSION
+			|| header->size != size) {
+		return false;
+	}
+	uint64_t records = sizeof(*header)
+		+ (uint64_t)header->nr_dirs * sizeof(struct index_dir)
+		+ (uint64_t)header->nr_icons * sizeof(struct index_icon)
+		+ (uint64_t)header->nr_apps * sizeof(struct index_app);
+	/* A NUL at the very end terminates any string in the table */
+	if (records != header->strings || header->strings >= size
+			|| ((const char *)blob)[size - 1] != '\0') {
+		return false;
+	}
+	const char *strings = (const char *)blob + header->strings;
+	if (!string_valid(header, header->theme)
+			|| strcmp(strings + header->theme, theme_name)) {
+		return false;
+	}
+
+	const struct index_dir *dirs = (const void *)(header + 1);
+	for (uint32_t i = 0; i < header->nr_dirs; i++) {
+		if (!string_valid(header, dirs[i].path)
+				|| dir_mtime_nsec(strings + dirs[i].path)
+					!= dirs[i].mtime_nsec) {
+			return false;
+		}
+	}
+	const struct index_icon *icons = (const void *)(dirs + header->nr_dirs);
+	for (uint32_t i = 0; i < header->nr_icons; i++) {
+		if (!string_valid(header, icons[i].name)
+				|| !string_valid(header, icons[i].path)) {
+			return false;
+		}
+	}
+	const struct index_app *apps = (const void *)(icons + header->nr_icons);
+	for (uint32_t i = 0; i < header->nr_apps; i++) {
+		if (!string_valid(header, apps[i].app_id)
+				|| !string_valid(header, apps[i].icon)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void
+index_set(void *blob, size_t size, bool mapped)
+{
+	cache.blob = blob;
+	cache.size = size;
+	cache.mapped = mapped;
+	cache.header = blob;
+	const struct index_dir *dirs = (const void *)(cache.header + 1);
+	cache.icons = (const void *)(dirs + cache.header->nr_dirs);
+	cache.apps = (const void *)(cache.icons + cache.header->nr_icons);
+	cache.strings = (const char *)blob + cache.header->strings;
+}
+
+static bool
+index_map(const char *path, const char *theme_name)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size < (off_t)sizeof(struct index_header)) {
+		close(fd);
+		return false;
+	}
+	void *blob = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (blob == MAP_FAILED) {
+		return false;
+	}
+	if (!index_valid(blob, st.st_size, theme_name)) {
+		munmap(blob, st.st_size);
+		return false;
+	}
+	index_set(blob, st.st_size, /*mapped*/ true);
+	return true;
+}
+
+/* Written to a temporary file first, so readers never see half of it */
+static void
+index_write(const char *path, const void *blob, size_t size)
+{
+	struct buf tmp = BUF_INIT;
+	buf_add_fmt(&tmp, "%s.%d", path, (int)getpid());
+	int fd = open(tmp.data, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		wlr_log_errno(WLR_DEBUG, "cannot write icon index %s", tmp.data);
+		goto out;
+	}
+	const char *p = blob;
+	size_t left = size;
+	while (left) {
+		ssize_t ret = write(fd, p, left);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret < 0) {
+			wlr_log_errno(WLR_ERROR, "cannot write icon index");
+			close(fd);
+			unlink(tmp.data);
+			goto out;
+		}
+		p += ret;
+		left -= ret;
+	}
+	close(fd);
+	if (rename(tmp.data, path)) {
+		wlr_log_errno(WLR_ERROR, "cannot write icon index %s", path);
+		unlink(tmp.data);
+	}
+out:
+	buf_reset(&tmp);
+}
+
+/* Returns the path of the cache file of @theme_name, creating its parent */
+static void
+index_path(struct buf *path, const char *theme_name)
+{
+	const char *cache_home = getenv("XDG_CACHE_HOME");
+	if (string_null_or_empty(cache_home)) {
+		buf_add(path, "$HOME/.cache");
+		buf_expand_shell_variables(path);
+	} else {
+		buf_add(path, cache_home);
+	}
+	mkdir(path->data, 0700);
+	buf_add(path, "/labwc");
+	mkdir(path->data, 0700);
+
+	buf_add(path, "/icon-index-");
+	for (const char *p = theme_name; *p; p++) {
+		buf_add_char(path, *p == '/' ? '_' : *p);
+	}
+}
+
+void
+icon_index_init(void)
+{
+	const char *theme_name = rc.icon_theme_name ? rc.icon_theme_name : "";
+	struct buf path = BUF_INIT;
+	index_path(&path, theme_name);
+	if (index_map(path.data, theme_name)) {
+		wlr_log(WLR_DEBUG, "icon index loaded from %s", path.data);
+		buf_reset(&path);
+		return;
+	}
+
+	size_t size;
+	void *blob = index_build(theme_name, &size);
+	index_write(path.data, blob, size);
+	index_set(blob, size, /*mapped*/ false);
+	buf_reset(&path);
+}
+
+void
+icon_index_finish(void)
+{
+	if (!cache.blob) {
+		return;
+	}
+	if (cache.mapped) {
+		munmap(cache.blob, cache.size);
+	} else {
+		free(cache.blob);
+	}
+	memset(&cache, 0, sizeof(cache));
+}
+
+/* Whether @a fits @size better than @b for icons of the same theme */
+static bool
+better_fit(const struct index_icon *a, const struct index_icon *b, int size)
+{
+	/* Exact sizes first, then scalable ones, then downscaled ones */
+	int fit_a = a->scalable ? 1 : a->size >= size ? 2 * (a->size - size)
+		: 2 * (size - a->size) + UINT16_MAX * 2;
+	int fit_b = b->scalable ? 1 : b->size >= size ? 2 * (b->size - size)
+		: 2 * (size - b->size) + UINT16_MAX * 2;
+	return fit_a < fit_b;
+}
+
+const char *
+icon_index_lookup(const char *name, int size)
+{
+	if (string_null_or_empty(name)) {
+		return NULL;
+	}
+	if (name[0] == '/') {
+		return name;
+	}
+	if (!cache.blob) {
+		return NULL;
+	}
+
+	/* Lower bound on the name */
+	size_t lo = 0;
+	size_t hi = cache.header->nr_icons;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (strcmp(cache.strings + cache.icons[mid].name, name) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	const struct index_icon *best = NULL;
+	for (size_t i = lo; i < cache.header->nr_icons; i++) {
+		const struct index_icon *icon = &cache.icons[i];
+		if (strcmp(cache.strings + icon->name, name)) {
+			break;
+		}
+		if (!best || icon->rank < best->rank
+				|| (icon->rank == best->rank
+					&& better_fit(icon, best, size))) {
+			best = icon;
+		}
+	}
+	return best ? cache.strings + best->path : NULL;
+}
+
+const char *
+icon_index_lookup_app(const char *app_id)
+{
+	if (string_null_or_empty(app_id) || !cache.blob) {
+		return NULL;
+	}
+	size_t lo = 0;
+	size_t hi = cache.header->nr_apps;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (strcasecmp(cache.strings + cache.apps[mid].app_id,
+				app_id) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (lo < cache.header->nr_apps && !strcasecmp(
+			cache.strings + cache.apps[lo].app_id, app_id)) {
+		return cache.strings + cache.apps[lo].icon;
+	}
+	return NULL;
+}
@@ -0,0 +1,315 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * icon-loader.c: icons decoded by a worker thread
+ *
+ * Decoding an svg icon can take milliseconds, much more than a frame has
+ * to spare when a window maps. Icons are decoded into image surfaces of
+ * the size they are shown at by a worker thread, and scaled_icon_buffer
+ * is redrawn once they are ready. Decoded icons are kept in a small LRU
+ * cache, so an icon is not decoded again for each window or scale.
+ *
+ * The worker only uses libc, cairo and librsvg. Everything else, notably
+ * the allocation wrappers of common/mem.h, is confined to the main thread;
+ * the worker only reads the path and size of an entry and stores the
+ * surface, with the entry being off the cache and queue lists meanwhile.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <cairo.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+#include "common/macros.h"
+#include "common/mem.h"
+#include "config.h"
+#include "icon-loader.h"
+#include "labwc.h"
+
+#if HAVE_RSVG
+#include <librsvg/rsvg.h>
+#endif
+
+#define ICON_LOADER_CACHE_SIZE 128
+
+enum icon_state {
+	LAB_ICON_PENDING = 0,
+	LAB_ICON_DECODED,
+	LAB_ICON_FAILED,
+};
+
+struct icon_entry {
+	char *path;
+	int size;
+	enum icon_state state;
+	cairo_surface_t *surface; /* NULL unless decoded */
+	struct wl_list link; /* loader.entries, most recently used first */
+	struct wl_list job_link; /* loader.queue or loader.done */
+};
+
+static struct {
+	pthread_t thread;
+	bool running;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/* Protected by lock */
+	struct wl_list queue;
+	struct wl_list done;
+	bool quit;
+
+	int event_fd;
+	struct wl_event_source *source;
+	struct wl_list entries;
+	size_t nr_entries;
+	struct wl_signal ready;
+} loader = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.event_fd = -1,
+};
+
+static bool
+render_png(cairo_t *cairo, const char *path, int size)
+{
+	cairo_surface_t *image = cairo_image_surface_create_from_png(path);
+	if (cairo_surface_status(image)) {
+		cairo_surface_destroy(image);
+		return false;
+	}
+	int width = cairo_image_surface_get_width(image);
+	int height = cairo_image_surface_get_height(image);
+	double scale = (double)size / MAX(MAX(width, height), 1);
+
+	/* Keep the aspect ratio and center the icon */
+	cairo_translate(cairo, (size - width * scale) / 2,
+		(size - height * scale) / 2);
+	cairo_scale(cairo, scale, scale);
+	cairo_set_source_surface(cairo, image, 0, 0);
+	cairo_pattern_set_filter(cairo_get_source(cairo), CAIRO_FILTER_GOOD);
+	cairo_paint(cairo);
+	cairo_surface_destroy(image);
+	return true;
+}
+
+#if HAVE_RSVG
+static bool
+render_svg(cairo_t *cairo, const char *path, int size)
+{
+	GError *err = NULL;
+	RsvgHandle *svg = rsvg_handle_new_from_file(path, &err);
+	if (!svg) {
+		g_error_free(err);
+		return false;
+	}
+	RsvgRectangle viewport = { .width = size, .height = size };
+	bool ok = rsvg_handle_render_document(svg, cairo, &viewport, &err);
+	if (!ok) {
+		g_error_free(err);
+	}
+	g_object_unref(svg);
+	return ok;
+}
+#endif
+
+/* Runs on the worker thread */
+static cairo_surface_t *
+decode(const char *path, int size)
+{
+	cairo_surface_t *surface =
+		cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+	cairo_t *cairo = cairo_create(surface);
+	bool ok = false;
+	const char *ext = strrchr(path, '.');
+#if HAVE_RSVG
+	if (ext && !strcasecmp(ext, ".svg")) {
+		ok = render_svg(cairo, path, size);
+	} else
+#endif
+	if (ext && !strcasecmp(ext, ".png")) {
+		ok = render_png(cairo, path, size);
+	}
+	cairo_destroy(cairo);
+	if (!ok || cairo_surface_status(surface)) {
+		cairo_surface_destroy(surface);
+		return NULL;
+	}
+	cairo_surface_flush(surface);
+	return surface;
+}
+
+static void *
+worker_main(void *data)
+{
+	pthread_mutex_lock(&loader.lock);
+	for (;;) {
+		while (!loader.quit && wl_list_empty(&loader.queue)) {
+			pthread_cond_wait(&loader.cond, &loader.lock);
+		}
+		if (loader.quit) {
+			break;
+		}
+		struct icon_entry *entry =
+			wl_container_of(loader.queue.next, entry, job_link);
+		wl_list_remove(&entry->job_link);
+		pthread_mutex_unlock(&loader.lock);
+
+		cairo_surface_t *surface = decode(entry->path, entry->size);
+
+		pthread_mutex_lock(&loader.lock);
+		entry->surface = surface;
+		wl_list_insert(loader.done.prev, &entry->job_link);
+		uint64_t one = 1;
+		if (write(loader.event_fd, &one, sizeof(one)) < 0) {
+			/* The counter is already non-zero, never mind */
+		}
+	}
+	pthread_mutex_unlock(&loader.lock);
+	return NULL;
+}
+
+static int
+handle_done(int fd, uint32_t mask, void *data)
+{
+	uint64_t count;
+	if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+		wlr_log_errno(WLR_ERROR, "icon loader");
+	}
+
+	pthread_mutex_lock(&loader.lock);
+	struct icon_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &loader.done, job_link) {
+		wl_list_remove(&entry->job_link);
+		wl_list_init(&entry->job_link);
+		entry->state = entry->surface
+			? LAB_ICON_DECODED : LAB_ICON_FAILED;
+		if (!entry->surface) {
+			wlr_log(WLR_DEBUG, "cannot decode icon %s", entry->path);
+		}
+	}
+	pthread_mutex_unlock(&loader.lock);
+
+	wl_signal_emit_mutable(&loader.ready, NULL);
+	return 0;
+}
+
+void
+icon_loader_init(struct server *server)
+{
+	wl_list_init(&loader.queue);
+	wl_list_init(&loader.done);
+	wl_list_init(&loader.entries);
+	wl_signal_init(&loader.ready);
+	loader.quit = false;
+
+	loader.event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (loader.event_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot create icon loader eventfd");
+		return;
+	}
+	if (pthread_create(&loader.thread, NULL, worker_main, NULL)) {
+		wlr_log(WLR_ERROR, "cannot start icon loader thread");
+		close(loader.event_fd);
+		loader.event_fd = -1;
+		return;
+	}
+	loader.running = true;
+	loader.source = wl_event_loop_add_fd(server->wl_event_loop,
+		loader.event_fd, WL_EVENT_READABLE, handle_done, NULL);
+}
+
+static void
+entry_destroy(struct icon_entry *entry)
+{
+	wl_list_remove(&entry->link);
+	wl_list_remove(&entry->job_link);
+	if (entry->surface) {
+		cairo_surface_destroy(entry->surface);
+	}
+	free(entry->path);
+	free(entry);
+	loader.nr_entries--;
+}
+
+/* Only decoded or failed entries, pending ones belong to the worker */
+static void
+evict_entries(void)
+{
+	struct icon_entry *entry, *tmp;
+	wl_list_for_each_reverse_safe(entry, tmp, &loader.entries, link) {
+		if (loader.nr_entries <= ICON_LOADER_CACHE_SIZE) {
+			return;
+		}
+		if (entry->state != LAB_ICON_PENDING) {
+			entry_destroy(entry);
+		}
+	}
+}
+
+cairo_surface_t *
+icon_loader_get(const char *path, int size, bool *pending)
+{
+	*pending = false;
+	if (!loader.running || size <= 0) {
+		return NULL;
+	}
+
+	struct icon_entry *entry;
+	wl_list_for_each(entry, &loader.entries, link) {
+		if (entry->size == size && !strcmp(entry->path, path)) {
+			wl_list_remove(&entry->link);
+			wl_list_insert(&loader.entries, &entry->link);
+			/* The worker may still be writing the surface */
+			*pending = entry->state == LAB_ICON_PENDING;
+			return *pending ? NULL : entry->surface;
+		}
+	}
+
+	entry = znew(*entry);
+	entry->path = xstrdup(path);
+	entry->size = size;
+	wl_list_insert(&loader.entries, &entry->link);
+	loader.nr_entries++;
+
+	pthread_mutex_lock(&loader.lock);
+	wl_list_insert(loader.queue.prev, &entry->job_link);
+	pthread_cond_signal(&loader.cond);
+	pthread_mutex_unlock(&loader.lock);
+
+	evict_entries();
+	*pending = true;
+	return NULL;
+}
+
+void
+icon_loader_add_ready_listener(struct wl_listener *listener)
+{
+	wl_signal_add(&loader.ready, listener);
+}
+
+void
+icon_loader_finish(void)
+{
+	if (!loader.running) {
+		return;
+	}
+	pthread_mutex_lock(&loader.lock);
+	loader.quit = true;
+	pthread_cond_signal(&loader.cond);
+	pthread_mutex_unlock(&loader.lock);
+	pthread_join(loader.thread, NULL);
+	loader.running = false;
+
+	struct icon_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &loader.entries, link) {
+		entry_destroy(entry);
+	}
+	wl_event_source_remove(loader.source);
+	loader.source = NULL;
+	close(loader.event_fd);
+	loader.event_fd = -1;
+}
@@ -1,12 +1,20 @@
 // SPDX-License-Identifier: GPL-2.0-only
-
+#define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <stdlib.h>
+#include <time.h>
 #include <wlr/types/wlr_idle_notify_v1.h>
 #include <wlr/types/wlr_idle_inhibit_v1.h>
 #include "common/mem.h"
 #include "idle.h"
 
+/*
+ * Each activity notification re-arms the timers of all idle-notify
+ * clients. Idle timeouts are in seconds, so notifications are sent at
+ * most once per this interval.
+ */
+#define IDLE_NOTIFY_INTERVAL_MSEC 100
+
 struct lab_idle_inhibitor {
 	struct wlr_idle_inhibitor_v1 *wlr_inhibitor;
 	struct wl_listener on_destroy;
@@ -20,6 +28,11 @@ struct lab_idle_manager {
 		struct wl_listener on_destroy;
 	} inhibitor;
 	struct wlr_seat *wlr_seat;
+	struct {
+		struct wl_event_source *timer;
+		struct wlr_seat *pending; /* activity not notified yet */
+		int64_t last_msec;
+	} coalesce;
 };
 
 static struct lab_idle_manager *manager;
@@ -58,9 +71,36 @@ handle_idle_inhibitor_new(struct wl_listener *listener, void *data)
 	wlr_idle_notifier_v1_set_inhibited(manager->ext, true);
 }
 
+static int64_t
+now_msec(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void
+notify_activity(struct wlr_seat *seat, int64_t now)
+{
+	manager->coalesce.pending = NULL;
+	manager->coalesce.last_msec = now;
+	wlr_idle_notifier_v1_notify_activity(manager->ext, seat);
+}
+
+/* Sends the activity swallowed at the end of an interval */
+static int
+handle_coalesce_timer(void *data)
+{
+	if (manager->coalesce.pending) {
+		notify_activity(manager->coalesce.pending, now_msec());
+	}
+	return 0;
+}
+
 static void
 handle_inhibitor_manager_destroy(struct wl_listener *listener, void *data)
 {
+	wl_event_source_remove(manager->coalesce.timer);
 	wl_list_remove(&manager->inhibitor.on_new_inhibitor.link);
 	wl_list_remove(&manager->inhibitor.on_destroy.link);
 	zfree(manager);
@@ -74,6 +114,8 @@ idle_manager_create(struct wl_display *display, struct wlr_seat *wlr_seat)
 	manager->wlr_seat = wlr_seat;
 
 	manager->ext = wlr_idle_notifier_v1_create(display);
+	manager->coalesce.timer = wl_event_loop_add_timer(
+		wl_display_get_event_loop(display), handle_coalesce_timer, NULL);
 
 	manager->inhibitor.manager = wlr_idle_inhibit_v1_create(display);
 	manager->inhibitor.on_new_inhibitor.notify = handle_idle_inhibitor_new;
@@ -98,5 +140,20 @@ idle_manager_notify_activity(struct wlr_seat *seat)
 		return;
 	}
 
-	wlr_idle_notifier_v1_notify_activity(manager->ext, seat);
+	/*
+	 * The first event after a quiet interval, and thus the one waking
+	 * up an idle client, is sent right away. Later ones only mark the
+	 * activity, which the timer sends once the interval has passed.
+	 */
+	int64_t now = now_msec();
+	int64_t elapsed = now - manager->coalesce.last_msec;
+	if (elapsed >= IDLE_NOTIFY_INTERVAL_MSEC) {
+		notify_activity(seat, now);
+		return;
+	}
+	if (!manager->coalesce.pending) {
+		wl_event_source_timer_update(manager->coalesce.timer,
+			IDLE_NOTIFY_INTERVAL_MSEC - elapsed);
+	}
+	manager->coalesce.pending = seat;
 }
@@ -1,20 +1,179 @@
 // SPDX-License-Identifier: GPL-2.0-only
 /*
  * Copyright (C) Johan Malm 2023
+ *
+ * Rasterising an svg with librsvg is the bulk of the time spent loading
+ * an svg theme. The rasters are therefore cached by the hash of the file
+ * content, the size and the scale, before any lab_img modifiers are
+ * applied, so the normal, hover and toggled variants of a button share
+ * one rasterisation. The cache is not tied to a theme and survives
+ * Reconfigure; a file that was rasterised before is not even parsed
+ * again until a size or scale is requested that is not cached.
  */
 #define _POSIX_C_SOURCE 200809L
 #include <cairo.h>
 #include <librsvg/rsvg.h>
+#include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/util/log.h>
 #include "buffer.h"
+#include "common/list.h"
+#include "common/mem.h"
 #include "common/string-helpers.h"
 #include "img/img-svg.h"
 #include "labwc.h"
 
-RsvgHandle *
+/* Pixels of all cached rasters together, the least recently used go first */
+#define SVG_CACHE_BYTES (8 * 1024 * 1024)
+
+struct img_svg {
+	uint64_t hash; /* of the file content */
+	/* The file content until it is parsed, then the handle */
+	char *data;
+	size_t len;
+	RsvgHandle *handle;
+};
+
+struct svg_raster {
+	uint64_t hash;
+	int width;
+	int height;
+	double scale;
+	cairo_surface_t *surface;
+	struct wl_list link; /* rasters, most recently used first */
+};
+
+static struct wl_list rasters = WL_LIST_INIT(&rasters);
+static size_t raster_bytes;
+
+static uint64_t
+hash_data(const char *data, size_t len)
+{
+	/* FNV-1a */
+	uint64_t hash = 14695981039346656037u;
+	for (size_t i = 0; i < len; i++) {
+		hash = (hash ^ (unsigned char)data[i]) * 1099511628211u;
+	}
+	return hash;
+}
+
+static size_t
+surface_bytes(cairo_surface_t *surface)
+{
+	return (size_t)cairo_image_surface_get_stride(surface)
+		* cairo_image_surface_get_height(surface);
+}
+
+static void
+raster_destroy(struct svg_raster *raster)
+{
+	raster_bytes -= surface_bytes(raster->surface);
+	cairo_surface_destroy(raster->surface);
+	wl_list_remove(&raster->link);
+	free(raster);
+}
+
+static bool
+hash_is_cached(uint64_t hash)
+{
+	struct svg_raster *raster;
+	wl_list_for_each(raster, &rasters, link) {
+		if (raster->hash == hash) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static struct svg_raster *
+find_raster(uint64_t hash, int w, int h, double scale)
+{
+	struct svg_raster *raster;
+	wl_list_for_each(raster, &rasters, link) {
+		if (raster->hash == hash && raster->width == w
+				&& raster->height == h && raster->scale == scale) {
+			wl_list_remove(&raster->link);
+			wl_list_insert(&rasters, &raster->link);
+			return raster;
+		}
+	}
+	return NULL;
+}
+
+/* Both surfaces are ARGB32 of the same size in pixels */
+static void
+copy_pixels(cairo_surface_t *dst, cairo_surface_t *src)
+{
+	cairo_surface_flush(src);
+	cairo_surface_flush(dst);
+	unsigned char *dst_data = cairo_image_surface_get_data(dst);
+	unsigned char *src_data = cairo_image_surface_get_data(src);
+	int dst_stride = cairo_image_surface_get_stride(dst);
+	int src_stride = cairo_image_surface_get_stride(src);
+	int row = cairo_image_surface_get_width(src) * 4;
+	int height = cairo_image_surface_get_height(src);
+	for (int y = 0; y < height; y++) {
+		memcpy(dst_data + y * dst_stride, src_data + y * src_stride, row);
+	}
+	cairo_surface_mark_dirty(dst);
+}
+
+static void
+add_raster(uint64_t hash, int w, int h, double scale, cairo_surface_t *image)
+{
+	cairo_surface_t *surface = cairo_image_surface_create(
+		CAIRO_FORMAT_ARGB32, cairo_image_surface_get_width(image),
+		cairo_image_surface_get_height(image));
+	if (cairo_surface_status(surface)) {
+		cairo_surface_destroy(surface);
+		return;
+	}
+	copy_pixels(surface, image);
+
+	struct svg_raster *raster = znew(*raster);
+	raster->hash = hash;
+	raster->width = w;
+	raster->height = h;
+	raster->scale = scale;
+	raster->surface = surface;
+	wl_list_insert(&rasters, &raster->link);
+	raster_bytes += surface_bytes(surface);
+
+	struct svg_raster *tmp;
+	wl_list_for_each_reverse_safe(raster, tmp, &rasters, link) {
+		if (raster_bytes <= SVG_CACHE_BYTES) {
+			break;
+		}
+		raster_destroy(raster);
+	}
+}
+
+static bool
+parse(struct img_svg *svg)
+{
+	if (svg->handle) {
+		return true;
+	}
+	GError *err = NULL;
+	svg->handle = rsvg_handle_new_from_data((const guint8 *)svg->data,
+		svg->len, &err);
+	if (err) {
+		wlr_log(WLR_DEBUG, "error parsing svg: %s", err->message);
+		g_error_free(err);
+		/* As with rsvg_handle_new_from_file(), no handle on errors */
+		svg->handle = NULL;
+		return false;
+	}
+	g_free(svg->data);
+	svg->data = NULL;
+	return true;
+}
+
+struct img_svg *
 img_svg_load(const char *filename)
 {
 	if (string_null_or_empty(filename)) {
@@ -22,22 +181,42 @@ img_svg_load(const char *filename)
 	}
 
 	GError *err = NULL;
-	RsvgHandle *svg = rsvg_handle_new_from_file(filename, &err);
-	if (err) {
+	gchar *data;
+	gsize len;
+	if (!g_file_get_contents(filename, &data, &len, &err)) {
 		wlr_log(WLR_DEBUG, "error reading svg %s-%s", filename, err->message);
 		g_error_free(err);
-		/*
-		 * rsvg_handle_new_from_file() returns NULL if an error occurs,
-		 * so there is no need to free svg here.
-		 */
+		return NULL;
+	}
+
+	struct img_svg *svg = znew(*svg);
+	svg->data = data;
+	svg->len = len;
+	svg->hash = hash_data(data, len);
+
+	/* Content rasterised before has been parsed successfully already */
+	if (!hash_is_cached(svg->hash) && !parse(svg)) {
+		wlr_log(WLR_DEBUG, "error reading svg %s", filename);
+		img_svg_destroy(svg);
 		return NULL;
 	}
 	return svg;
 }
 
 struct lab_data_buffer *
-img_svg_render(RsvgHandle *svg, int w, int h, double scale)
+img_svg_render(struct img_svg *svg, int w, int h, double scale)
 {
+	struct svg_raster *raster = find_raster(svg->hash, w, h, scale);
+	if (raster) {
+		struct lab_data_buffer *buffer = buffer_create_cairo(w, h, scale);
+		copy_pixels(buffer->surface, raster->surface);
+		return buffer;
+	}
+
+	if (!parse(svg)) {
+		return NULL;
+	}
+
 	struct lab_data_buffer *buffer = buffer_create_cairo(w, h, scale);
 	cairo_surface_t *image = buffer->surface;
 	cairo_t *cr = cairo_create(image);
@@ -47,7 +226,7 @@ img_svg_render(RsvgHandle *svg, int w, int h, double scale)
 		.width = w,
 		.height = h,
 	};
-	rsvg_handle_render_document(svg, cr, &viewport, &err);
+	rsvg_handle_render_document(svg->handle, cr, &viewport, &err);
 	if (err) {
 		wlr_log(WLR_ERROR, "error rendering svg: %s", err->message);
 		g_error_free(err);
@@ -60,11 +239,24 @@ img_svg_render(RsvgHandle *svg, int w, int h, double scale)
 	cairo_surface_flush(buffer->surface);
 	cairo_destroy(cr);
 
+	add_raster(svg->hash, w, h, scale, image);
 	return buffer;
 
 error:
 	wlr_buffer_drop(&buffer->base);
 	cairo_destroy(cr);
-	g_object_unref(svg);
 	return NULL;
 }
+
+void
+img_svg_destroy(struct img_svg *svg)
+{
+	if (!svg) {
+		return;
+	}
+	if (svg->handle) {
+		g_object_unref(svg->handle);
+	}
+	g_free(svg->data);
+	free(svg);
+}
@@ -22,8 +22,7 @@
 #include "common/macros.h"
 #include "common/mem.h"
 #include "img/img-xpm.h"
-
-#include "xpm-color-table.h"
+#include "img/xpm-color.h"
 
 enum buf_op { op_header, op_cmap, op_body };
 
@@ -37,71 +36,20 @@ struct file_handle {
 	struct buf buf;
 };
 
-static inline uint32_t
-make_argb(uint8_t a, uint8_t r, uint8_t g, uint8_t b)
-{
-	return ((uint32_t)a << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
-}
-
-static int
-compare_xcolor_entries(const void *a, const void *b)
-{
-	return g_ascii_strcasecmp((const char *)a,
-		color_names + ((const struct xcolor_entry *)b)->name_offset);
-}
+/*
+ * Images with one or two chars per pixel are decoded through a table indexed
+ * directly by the pixel chars rather than through the color hash
+ */
+#define XPM_DIRECT_CPP_MAX 2
 
-static bool
-lookup_named_color(const char *name, uint32_t *argb)
+static inline uint16_t
+direct_key(const char *pixel, int cpp)
 {
-	struct xcolor_entry *found = bsearch(name, xcolors, ARRAY_SIZE(xcolors),
-		sizeof(struct xcolor_entry), compare_xcolor_entries);
-	if (!found) {
-		return false;
-	}
-
-	*argb = make_argb(0xFF, found->red, found->green, found->blue);
-	return true;
-}
-
-static bool
-parse_color(const char *spec, uint32_t *argb)
-{
-	if (spec[0] != '#') {
-		return lookup_named_color(spec, argb);
-	}
-
-	int red, green, blue;
-	switch (strlen(spec + 1)) {
-	case 3:
-		if (sscanf(spec + 1, "%1x%1x%1x", &red, &green, &blue) != 3) {
-			return false;
-		}
-		*argb = make_argb(255, (red * 255) / 15, (green * 255) / 15,
-			(blue * 255) / 15);
-		return true;
-	case 6:
-		if (sscanf(spec + 1, "%2x%2x%2x", &red, &green, &blue) != 3) {
-			return false;
-		}
-		*argb = make_argb(255, red, green, blue);
-		return true;
-	case 9:
-		if (sscanf(spec + 1, "%3x%3x%3x", &red, &green, &blue) != 3) {
-			return false;
-		}
-		*argb = make_argb(255, (red * 255) / 4095, (green * 255) / 4095,
-			(blue * 255) / 4095);
-		return true;
-	case 12:
-		if (sscanf(spec + 1, "%4x%4x%4x", &red, &green, &blue) != 3) {
-			return false;
-		}
-		*argb = make_argb(255, (red * 255) / 65535,
-			(green * 255) / 65535, (blue * 255) / 65535);
-		return true;
-	default:
-		return false;
+	uint16_t key = (uint8_t)pixel[0];
+	if (cpp > 1) {
+		key |= (uint16_t)(uint8_t)pixel[1] << 8;
 	}
+	return key;
 }
 
 static bool
@@ -246,7 +194,7 @@ xpm_extract_color(const char *buffer)
 
 	uint32_t argb;
 	if (current_key > 1 && (g_ascii_strcasecmp(current_color, "None") != 0)
-			&& parse_color(current_color, &argb)) {
+			&& xpm_parse_color(current_color, &argb)) {
 		return argb;
 	} else {
 		return 0;
@@ -328,6 +276,11 @@ xpm_load_to_surface(struct file_handle *handle)
 
 	/* The hash is used for fast lookups of color from chars */
 	GHashTable *color_hash = g_hash_table_new(g_str_hash, g_str_equal);
+	/* Index + 1 into colors[] by direct_key(), 0 for unknown chars */
+	uint16_t *direct = NULL;
+	if (cpp <= XPM_DIRECT_CPP_MAX) {
+		direct = znew_n(uint16_t, 1 << (8 * cpp));
+	}
 
 	char *name_buf = xzalloc(n_col * (cpp + 1));
 	struct xpm_color *colors = znew_n(struct xpm_color, n_col);
@@ -349,7 +302,16 @@ xpm_load_to_surface(struct file_handle *handle)
 
 		color->argb = xpm_extract_color(buffer);
 
-		g_hash_table_insert(color_hash, color->color_string, color);
+		if (direct) {
+			/* Keys shorter than cpp must not match any pixel */
+			if (strlen(color->color_string) == (size_t)cpp) {
+				direct[direct_key(color->color_string, cpp)] =
+					cnt + 1;
+			}
+		} else {
+			g_hash_table_insert(color_hash, color->color_string,
+				color);
+		}
 
 		if (cnt == 0) {
 			fallbackcolor = color;
@@ -373,6 +335,17 @@ xpm_load_to_surface(struct file_handle *handle)
 			goto out;
 		}
 
+		if (direct) {
+			for (int n = 0; n < wbytes; n += cpp) {
+				uint16_t index =
+					direct[direct_key(&buffer[n], cpp)];
+				/* Bad XPM...punt */
+				*pixtmp++ = index ? colors[index - 1].argb
+					: fallbackcolor->argb;
+			}
+			continue;
+		}
+
 		for (int n = 0, xcnt = 0; n < wbytes; n += cpp, xcnt++) {
 			g_strlcpy(pixel_str, &buffer[n], cpp + 1);
 
@@ -392,6 +365,7 @@ xpm_load_to_surface(struct file_handle *handle)
 
 out:
 	g_hash_table_destroy(color_hash);
+	free(direct);
 	free(colors);
 	free(name_buf);
 	return surface;
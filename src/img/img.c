@@ -27,7 +27,7 @@ struct lab_img_data {
 	/* Handler for the loaded image file */
 	struct lab_data_buffer *buffer; /* for PNG/XBM/XPM image */
 #if HAVE_RSVG
-	RsvgHandle *svg; /* for SVG image */
+	struct img_svg *svg; /* for SVG image */
 #endif
 };
 
@@ -203,9 +203,7 @@ lab_img_destroy(struct lab_img *img)
 			wlr_buffer_drop(&img->data->buffer->base);
 		}
 #if HAVE_RSVG
-		if (img->data->svg) {
-			g_object_unref(img->data->svg);
-		}
+		img_svg_destroy(img->data->svg);
 #endif
 		free(img->data);
 	}
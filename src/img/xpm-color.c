@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: LGPL-2.0-or-later
+/*
+ * XPM color parsing adapted from gdk-pixbuf
+ *
+ * Copyright (C) 1999 Mark Crichton
+ * Copyright (C) 1999 The Free Software Foundation
+ *
+ * Authors: Mark Crichton <crichton@gimp.org>
+ *          Federico Mena-Quintero <federico@gimp.org>
+ *
+ * Adapted for labwc by John Lindgren, 2024
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common/macros.h"
+#include "img/xpm-color.h"
+
+#include "xpm-color-table.h"
+
+static inline uint32_t
+make_argb(uint8_t a, uint8_t r, uint8_t g, uint8_t b)
+{
+	return ((uint32_t)a << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+}
+
+static int
+compare_xcolor_entries(const void *a, const void *b)
+{
+	return g_ascii_strcasecmp((const char *)a,
+		color_names + ((const struct xcolor_entry *)b)->name_offset);
+}
+
+static bool
+lookup_named_color(const char *name, uint32_t *argb)
+{
+	struct xcolor_entry *found = bsearch(name, xcolors, ARRAY_SIZE(xcolors),
+		sizeof(struct xcolor_entry), compare_xcolor_entries);
+	if (!found) {
+		return false;
+	}
+
+	*argb = make_argb(0xFF, found->red, found->green, found->blue);
+	return true;
+}
+
+bool
+xpm_parse_color(const char *spec, uint32_t *argb)
+{
+	if (spec[0] != '#') {
+		return lookup_named_color(spec, argb);
+	}
+
+	int red, green, blue;
+	switch (strlen(spec + 1)) {
+	case 3:
+		if (sscanf(spec + 1, "%1x%1x%1x", &red, &green, &blue) != 3) {
+			return false;
+		}
+		*argb = make_argb(255, (red * 255) / 15, (green * 255) / 15,
+			(blue * 255) / 15);
+		return true;
+	case 6:
+		if (sscanf(spec + 1, "%2x%2x%2x", &red, &green, &blue) != 3) {
+			return false;
+		}
+		*argb = make_argb(255, red, green, blue);
+		return true;
+	case 9:
+		if (sscanf(spec + 1, "%3x%3x%3x", &red, &green, &blue) != 3) {
+			return false;
+		}
+		*argb = make_argb(255, (red * 255) / 4095, (green * 255) / 4095,
+			(blue * 255) / 4095);
+		return true;
+	case 12:
+		if (sscanf(spec + 1, "%4x%4x%4x", &red, &green, &blue) != 3) {
+			return false;
+		}
+		*argb = make_argb(255, (red * 255) / 65535,
+			(green * 255) / 65535, (blue * 255) / 65535);
+		return true;
+	default:
+		return false;
+	}
+}
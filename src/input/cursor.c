@@ -2,6 +2,7 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <linux/input-event-codes.h>
+#include <math.h>
 #include <sys/time.h>
 #include <time.h>
 #include <wlr/backend/libinput.h>
@@ -18,12 +19,16 @@
 #include "dnd.h"
 #include "idle.h"
 #include "input/gestures.h"
+#include "input/input-record.h"
 #include "input/keyboard.h"
 #include "input/tablet.h"
 #include "input/tablet-tool.h"
 #include "input/touch.h"
 #include "labwc.h"
 #include "layers.h"
+#include "magnifier.h"
+#include "output-timing.h"
+#include "overview.h"
 #include "regions.h"
 #include "ssd.h"
 #include "view.h"
@@ -31,7 +36,11 @@
 
 #define LAB_CURSOR_SHAPE_V1_VERSION 1
 
-static const char * const *cursor_names = NULL;
+/*
+ * Name of each cursor image in the current theme, resolved once when
+ * the theme is loaded so that setting a cursor is a plain table lookup
+ */
+static const char *cursor_names[LAB_CURSOR_COUNT];
 
 /* Usual cursor names */
 static const char * const cursors_xdg[] = {
@@ -388,6 +397,35 @@ process_cursor_motion_out_of_surface(struct server *server,
 	return true;
 }
 
+static void
+remember_hover(struct seat *seat, struct cursor_context *ctx)
+{
+	seat->hover.node = ctx->node;
+	seat->hover.type = ctx->type;
+	seat->hover.cursor = seat->server_cursor;
+}
+
+/*
+ * Returns true if the cursor moved within the node and SSD part of the
+ * last motion event and nothing changed the resulting pointer focus or
+ * cursor image since. The enter event, the cursor image and the focus
+ * are then already up to date.
+ */
+static bool
+hover_unchanged(struct seat *seat, struct cursor_context *ctx)
+{
+	if (!ctx->node || ctx->node != seat->hover.node
+			|| ctx->type != seat->hover.type
+			|| seat->server_cursor != seat->hover.cursor
+			|| seat->drag.active) {
+		return false;
+	}
+	if (seat->pressed.surface && ctx->surface != seat->pressed.surface) {
+		return false;
+	}
+	return seat->seat->pointer_state.focused_surface == ctx->surface;
+}
+
 /*
  * Common logic shared by cursor_update_focus(), process_cursor_motion()
  * and cursor_axis()
@@ -409,6 +447,16 @@ cursor_update_common(struct server *server, struct cursor_context *ctx,
 		return false;
 	}
 
+	if (cursor_has_moved && hover_unchanged(seat, ctx)) {
+		if (ctx->surface) {
+			*sx = ctx->sx;
+			*sy = ctx->sy;
+			return true;
+		}
+		return false;
+	}
+	seat->hover.node = NULL;
+
 	/* TODO: verify drag_icon logic */
 	if (seat->pressed.surface && ctx->surface != seat->pressed.surface
 			&& !update_pressed_surface(seat, ctx)
@@ -436,6 +484,7 @@ cursor_update_common(struct server *server, struct cursor_context *ctx,
 			ctx->sx, ctx->sy);
 		seat->server_cursor = LAB_CURSOR_CLIENT;
 		if (cursor_has_moved) {
+			remember_hover(seat, ctx);
 			*sx = ctx->sx;
 			*sy = ctx->sy;
 			return true;
@@ -455,6 +504,9 @@ cursor_update_common(struct server *server, struct cursor_context *ctx,
 				cursor = LAB_CURSOR_DEFAULT;
 			}
 			cursor_set(seat, cursor);
+			if (cursor_has_moved) {
+				remember_hover(seat, ctx);
+			}
 		}
 	}
 	return false;
@@ -479,6 +531,8 @@ cursor_get_resize_edges(struct wlr_cursor *cursor, struct cursor_context *ctx)
 bool
 cursor_process_motion(struct server *server, uint32_t time, double *sx, double *sy)
 {
+	magnifier_handle_cursor_motion(server);
+
 	/* If the mode is non-passthrough, delegate to those functions. */
 	if (server->input_mode == LAB_INPUT_STATE_MOVE) {
 		process_cursor_move(server, time);
@@ -557,6 +611,22 @@ cursor_update_focus(struct server *server)
 	}
 }
 
+static void
+update_focus(void *data)
+{
+	cursor_update_focus(data);
+}
+
+void
+cursor_schedule_focus_update(struct server *server)
+{
+	static struct deferred_task task = {
+		.func = update_focus,
+	};
+	task.data = server;
+	deferred_task_schedule(&server->deferred, &task);
+}
+
 static void
 warp_cursor_to_constraint_hint(struct seat *seat,
 		struct wlr_pointer_constraint_v1 *constraint)
@@ -586,6 +656,8 @@ handle_constraint_commit(struct wl_listener *listener, void *data)
 	/* Prevents unused variable warning when compiled without asserts */
 	(void)constraint;
 	assert(constraint->surface = data);
+	/* The region may have changed with the committed state */
+	seat->constraint_bounds.valid = false;
 }
 
 static void
@@ -605,6 +677,7 @@ destroy_constraint(struct wl_listener *listener, void *data)
 		}
 		wl_list_init(&seat->constraint_commit.link);
 		seat->current_constraint = NULL;
+		seat->constraint_bounds.valid = false;
 	}
 
 	free(constraint);
@@ -648,6 +721,7 @@ constrain_cursor(struct server *server, struct wlr_pointer_constraint_v1
 	}
 
 	seat->current_constraint = constraint;
+	seat->constraint_bounds.valid = false;
 
 	if (!constraint) {
 		wl_list_init(&seat->constraint_commit.link);
@@ -660,6 +734,44 @@ constrain_cursor(struct server *server, struct wlr_pointer_constraint_v1
 		&seat->constraint_commit);
 }
 
+static void
+update_constraint_bounds(struct seat *seat)
+{
+	pixman_region32_t *region = &seat->current_constraint->region;
+	pixman_box32_t *extents = pixman_region32_extents(region);
+	seat->constraint_bounds.single_rect =
+		pixman_region32_n_rects(region) == 1;
+	seat->constraint_bounds.box = (struct wlr_box){
+		.x = extents->x1,
+		.y = extents->y1,
+		.width = extents->x2 - extents->x1,
+		.height = extents->y2 - extents->y1,
+	};
+	seat->constraint_bounds.valid = true;
+}
+
+/*
+ * Confined games get a relative motion event for every report of the
+ * mouse, so most events end up inside the confinement. For the usual
+ * single rectangle the region does not have to be searched for those.
+ */
+static bool
+inside_constraint_rect(struct seat *seat, double sx, double sy)
+{
+	if (!seat->constraint_bounds.valid) {
+		update_constraint_bounds(seat);
+	}
+	if (!seat->constraint_bounds.single_rect) {
+		return false;
+	}
+	/* Same test as wlr_region_confine(), which floors the target */
+	struct wlr_box *box = &seat->constraint_bounds.box;
+	int x = floor(sx);
+	int y = floor(sy);
+	return x >= box->x && x < box->x + box->width
+		&& y >= box->y && y < box->y + box->height;
+}
+
 static void
 apply_constraint(struct seat *seat, struct wlr_pointer *pointer, double *x, double *y)
 {
@@ -677,6 +789,10 @@ apply_constraint(struct seat *seat, struct wlr_pointer *pointer, double *x, doub
 	sx -= seat->server->active_view->current.x;
 	sy -= seat->server->active_view->current.y;
 
+	if (inside_constraint_rect(seat, sx + *x, sy + *y)) {
+		return;
+	}
+
 	double sx_confined, sy_confined;
 	if (!wlr_region_confine(&seat->current_constraint->region, sx, sy,
 			sx + *x, sy + *y, &sx_confined, &sy_confined)) {
@@ -713,6 +829,44 @@ preprocess_cursor_motion(struct seat *seat, struct wlr_pointer *pointer,
 	 * without any input.
 	 */
 	wlr_cursor_move(seat->cursor, &pointer->base, dx, dy);
+
+	/*
+	 * Relative motion has already been sent for every event. Absolute
+	 * motion is only processed once per batch unless a constraint is
+	 * active, in which case clients expect every event unbatched.
+	 */
+	if (rc.motion_coalesce != LAB_MOTION_COALESCE_NONE
+			&& !seat->current_constraint) {
+		seat->coalesced_motion.pending = true;
+		seat->coalesced_motion.time_msec = time_msec;
+		if (rc.motion_coalesce == LAB_MOTION_COALESCE_OUTPUT_FRAME) {
+			/* Hardware cursor motion does not schedule a frame */
+			struct wlr_output *wlr_output = wlr_output_layout_output_at(
+				seat->server->output_layout,
+				seat->cursor->x, seat->cursor->y);
+			if (wlr_output) {
+				wlr_output_schedule_frame(wlr_output);
+			}
+		}
+		return;
+	}
+
+	double sx, sy;
+	bool notify = cursor_process_motion(seat->server, time_msec, &sx, &sy);
+	if (notify) {
+		wlr_seat_pointer_notify_motion(seat->seat, time_msec, sx, sy);
+	}
+}
+
+void
+cursor_flush_motion(struct seat *seat)
+{
+	if (!seat->coalesced_motion.pending) {
+		return;
+	}
+	seat->coalesced_motion.pending = false;
+
+	uint32_t time_msec = seat->coalesced_motion.time_msec;
 	double sx, sy;
 	bool notify = cursor_process_motion(seat->server, time_msec, &sx, &sy);
 	if (notify) {
@@ -745,6 +899,8 @@ handle_motion(struct wl_listener *listener, void *data)
 	struct wlr_pointer_motion_event *event = data;
 	idle_manager_notify_activity(seat->seat);
 	cursor_set_visible(seat, /* visible */ true);
+	input_record_motion(event->time_msec, event->delta_x, event->delta_y);
+	metrics_input_event(LAB_METRICS_INPUT_MOTION);
 
 	if (seat->cursor_scroll_wheel_emulation) {
 		uint32_t orientation;
@@ -782,6 +938,8 @@ handle_motion(struct wl_listener *listener, void *data)
 		preprocess_cursor_motion(seat, event->pointer,
 			event->time_msec, event->delta_x, event->delta_y);
 	}
+	output_timing_input_event(output_nearest_to_cursor(server),
+		&event->pointer->base, event->time_msec);
 }
 
 static void
@@ -806,6 +964,8 @@ handle_motion_absolute(struct wl_listener *listener, void *data)
 
 	double dx = lx - seat->cursor->x;
 	double dy = ly - seat->cursor->y;
+	input_record_motion(event->time_msec, dx, dy);
+	metrics_input_event(LAB_METRICS_INPUT_MOTION);
 
 	wlr_relative_pointer_manager_v1_send_relative_motion(
 		seat->server->relative_pointer_manager,
@@ -814,6 +974,8 @@ handle_motion_absolute(struct wl_listener *listener, void *data)
 
 	preprocess_cursor_motion(seat, event->pointer,
 		event->time_msec, dx, dy);
+	output_timing_input_event(output_nearest_to_cursor(seat->server),
+		&event->pointer->base, event->time_msec);
 }
 
 static void
@@ -824,26 +986,25 @@ process_release_mousebinding(struct server *server,
 		return;
 	}
 
-	struct mousebind *mousebind;
 	uint32_t modifiers = keyboard_get_all_modifiers(&server->seat);
-
-	wl_list_for_each(mousebind, &rc.mousebinds, link) {
-		if (ssd_part_contains(mousebind->context, ctx->type)
-				&& mousebind->button == button
-				&& modifiers == mousebind->modifiers) {
-			switch (mousebind->mouse_event) {
-			case MOUSE_ACTION_RELEASE:
+	size_t len;
+	struct mousebind **mousebinds =
+		mousebind_lookup_button(ctx->type, modifiers, button, &len);
+
+	for (size_t i = 0; i < len; i++) {
+		struct mousebind *mousebind = mousebinds[i];
+		switch (mousebind->mouse_event) {
+		case MOUSE_ACTION_RELEASE:
+			break;
+		case MOUSE_ACTION_CLICK:
+			if (mousebind->pressed_in_context) {
 				break;
-			case MOUSE_ACTION_CLICK:
-				if (mousebind->pressed_in_context) {
-					break;
-				}
-				continue;
-			default:
-				continue;
 			}
-			actions_run(ctx->view, server, &mousebind->actions, ctx);
+			continue;
+		default:
+			continue;
 		}
+		actions_run(ctx->view, server, &mousebind->actions, ctx);
 	}
 }
 
@@ -889,46 +1050,45 @@ process_press_mousebinding(struct server *server, struct cursor_context *ctx,
 		return false;
 	}
 
-	struct mousebind *mousebind;
 	bool double_click = is_double_click(rc.doubleclick_time, button, ctx);
 	bool consumed_by_frame_context = false;
 	uint32_t modifiers = keyboard_get_all_modifiers(&server->seat);
-
-	wl_list_for_each(mousebind, &rc.mousebinds, link) {
-		if (ssd_part_contains(mousebind->context, ctx->type)
-				&& mousebind->button == button
-				&& modifiers == mousebind->modifiers) {
-			switch (mousebind->mouse_event) {
-			case MOUSE_ACTION_DRAG: /* fallthrough */
-			case MOUSE_ACTION_CLICK:
-				/*
-				 * DRAG and CLICK actions will be processed on
-				 * the release event, unless the press event is
-				 * counted as a DOUBLECLICK.
-				 */
-				if (!double_click) {
-					/* Swallow the press event */
-					consumed_by_frame_context |=
-						mousebind->context == LAB_SSD_FRAME;
-					consumed_by_frame_context |=
-						mousebind->context == LAB_SSD_ALL;
-					mousebind->pressed_in_context = true;
-				}
-				continue;
-			case MOUSE_ACTION_DOUBLECLICK:
-				if (!double_click) {
-					continue;
-				}
-				break;
-			case MOUSE_ACTION_PRESS:
-				break;
-			default:
+	size_t len;
+	struct mousebind **mousebinds =
+		mousebind_lookup_button(ctx->type, modifiers, button, &len);
+
+	for (size_t i = 0; i < len; i++) {
+		struct mousebind *mousebind = mousebinds[i];
+		switch (mousebind->mouse_event) {
+		case MOUSE_ACTION_DRAG: /* fallthrough */
+		case MOUSE_ACTION_CLICK:
+			/*
+			 * DRAG and CLICK actions will be processed on
+			 * the release event, unless the press event is
+			 * counted as a DOUBLECLICK.
+			 */
+			if (!double_click) {
+				/* Swallow the press event */
+				consumed_by_frame_context |=
+					mousebind->context == LAB_SSD_FRAME;
+				consumed_by_frame_context |=
+					mousebind->context == LAB_SSD_ALL;
+				mousebind->pressed_in_context = true;
+			}
+			continue;
+		case MOUSE_ACTION_DOUBLECLICK:
+			if (!double_click) {
 				continue;
 			}
-			consumed_by_frame_context |= mousebind->context == LAB_SSD_FRAME;
-			consumed_by_frame_context |= mousebind->context == LAB_SSD_ALL;
-			actions_run(ctx->view, server, &mousebind->actions, ctx);
+			break;
+		case MOUSE_ACTION_PRESS:
+			break;
+		default:
+			continue;
 		}
+		consumed_by_frame_context |= mousebind->context == LAB_SSD_FRAME;
+		consumed_by_frame_context |= mousebind->context == LAB_SSD_ALL;
+		actions_run(ctx->view, server, &mousebind->actions, ctx);
 	}
 	return consumed_by_frame_context;
 }
@@ -959,6 +1119,12 @@ cursor_process_button_press(struct seat *seat, uint32_t button, uint32_t time_ms
 		return false;
 	}
 
+	if (server->input_mode == LAB_INPUT_STATE_OVERVIEW) {
+		overview_press(server, seat->cursor->x, seat->cursor->y);
+		lab_set_add(&seat->bound_buttons, button);
+		return false;
+	}
+
 	/*
 	 * On press, set focus to a non-view surface that wants it.
 	 * Action processing does not run for these surfaces and thus
@@ -1084,6 +1250,9 @@ handle_button(struct wl_listener *listener, void *data)
 	struct wlr_pointer_button_event *event = data;
 	idle_manager_notify_activity(seat->seat);
 	cursor_set_visible(seat, /* visible */ true);
+	cursor_flush_motion(seat);
+	input_record_button(event->time_msec, event->button, event->state);
+	metrics_input_event(LAB_METRICS_INPUT_BUTTON);
 
 	bool notify;
 	switch (event->state) {
@@ -1109,11 +1278,13 @@ handle_button(struct wl_listener *listener, void *data)
 
 struct scroll_info {
 	int direction;
-	bool run_action;
+	/* Number of times scroll actions should run */
+	int steps;
 };
 
 static struct scroll_info
-compare_delta(double delta, double delta_discrete, double *accum)
+compare_delta(double delta, double delta_discrete, double *accum,
+		double *accum_discrete)
 {
 	/*
 	 * Smooth scroll deltas are in surface space, so treating each unit as a
@@ -1137,14 +1308,26 @@ compare_delta(double delta, double delta_discrete, double *accum)
 	if (delta == 0.0) {
 		/* Delta 0 marks the end of a scroll */
 		*accum = 0.0;
+		*accum_discrete = 0.0;
 	} else {
 		/* Accumulate smooth scrolling until we hit threshold */
 		*accum += delta;
 	}
 
-	if (delta_discrete != 0 || fabs(*accum) > SCROLL_THRESHOLD) {
+	if (delta_discrete != 0) {
+		/*
+		 * delta_discrete is in 120ths of a wheel detent and high-
+		 * resolution wheels send fractions of it. Only whole detents
+		 * count as steps.
+		 */
+		const double DETENT = 120.0;
+		*accum_discrete += delta_discrete;
+		info.steps = (int)(fabs(*accum_discrete) / DETENT);
+		*accum_discrete = fmod(*accum_discrete, DETENT);
+		*accum = 0.0;
+	} else if (fabs(*accum) > SCROLL_THRESHOLD) {
 		*accum = fmod(*accum, SCROLL_THRESHOLD);
-		info.run_action = true;
+		info.steps = 1;
 	}
 
 	return info;
@@ -1162,7 +1345,8 @@ process_cursor_axis(struct server *server, enum wl_pointer_axis orientation,
 
 	if (orientation == WL_POINTER_AXIS_HORIZONTAL_SCROLL) {
 		info = compare_delta(delta, delta_discrete,
-			&server->seat.smooth_scroll_offset.x);
+			&server->seat.smooth_scroll_offset.x,
+			&server->seat.discrete_scroll_offset.x);
 
 		if (info.direction < 0) {
 			direction = LAB_DIRECTION_LEFT;
@@ -1171,7 +1355,8 @@ process_cursor_axis(struct server *server, enum wl_pointer_axis orientation,
 		}
 	} else if (orientation == WL_POINTER_AXIS_VERTICAL_SCROLL) {
 		info = compare_delta(delta, delta_discrete,
-			&server->seat.smooth_scroll_offset.y);
+			&server->seat.smooth_scroll_offset.y,
+			&server->seat.discrete_scroll_offset.y);
 
 		if (info.direction < 0) {
 			direction = LAB_DIRECTION_UP;
@@ -1184,20 +1369,24 @@ process_cursor_axis(struct server *server, enum wl_pointer_axis orientation,
 
 	bool handled = false;
 	if (direction != LAB_DIRECTION_INVALID) {
-		struct mousebind *mousebind;
-		wl_list_for_each(mousebind, &rc.mousebinds, link) {
-			if (ssd_part_contains(mousebind->context, ctx.type)
-					&& mousebind->direction == direction
-					&& modifiers == mousebind->modifiers
-					&& mousebind->mouse_event == MOUSE_ACTION_SCROLL) {
-				handled = true;
-				/*
-				 * Action may not be executed if the accumulated scroll
-				 * delta on touchpads doesn't exceed the threshold
-				 */
-				if (info.run_action) {
-					actions_run(ctx.view, server, &mousebind->actions, &ctx);
-				}
+		size_t len;
+		struct mousebind **mousebinds = mousebind_lookup_scroll(
+			ctx.type, modifiers, direction, &len);
+		handled = len > 0;
+
+		/*
+		 * Actions may not be executed if the accumulated scroll
+		 * delta on touchpads doesn't exceed the threshold, or be
+		 * executed several times for a fast scroll.
+		 */
+		int steps = info.steps;
+		if (rc.scroll_action_limit) {
+			steps = MIN(steps, rc.scroll_action_limit);
+		}
+		for (int step = 0; step < steps; step++) {
+			for (size_t i = 0; i < len; i++) {
+				actions_run(ctx.view, server,
+					&mousebinds[i]->actions, &ctx);
 			}
 		}
 	}
@@ -1226,6 +1415,10 @@ handle_axis(struct wl_listener *listener, void *data)
 	struct wlr_pointer_axis_event *event = data;
 	idle_manager_notify_activity(seat->seat);
 	cursor_set_visible(seat, /* visible */ true);
+	cursor_flush_motion(seat);
+	input_record_axis(event->time_msec, event->orientation, event->source,
+		event->delta, event->delta_discrete);
+	metrics_input_event(LAB_METRICS_INPUT_AXIS);
 
 	/* input->scroll_factor is set for pointer/touch devices */
 	assert(event->pointer->base.type == WLR_INPUT_DEVICE_POINTER
@@ -1233,16 +1426,57 @@ handle_axis(struct wl_listener *listener, void *data)
 	struct input *input = event->pointer->base.data;
 	double scroll_factor = input->scroll_factor;
 
-	bool notify = process_cursor_axis(server, event->orientation,
-		event->delta, event->delta_discrete);
+	if (event->orientation >= ARRAY_SIZE(seat->pending_axis)) {
+		wlr_log(WLR_DEBUG, "Failed to handle cursor axis event");
+		return;
+	}
 
-	if (notify) {
-		/* Notify the client with pointer focus of the axis event. */
-		wlr_seat_pointer_notify_axis(seat->seat, event->time_msec,
-			event->orientation, scroll_factor * event->delta,
-			round(scroll_factor * event->delta_discrete),
-			event->source, event->relative_direction);
+	/* Merge all axis events up to the next pointer frame */
+	struct pending_axis *axis = &seat->pending_axis[event->orientation];
+	axis->pending = true;
+	if (event->delta == 0.0) {
+		/* Delta 0 marks the end of a scroll */
+		axis->stop = true;
+	} else {
+		axis->delta += event->delta;
+		axis->delta_discrete += event->delta_discrete;
+		axis->client_delta += scroll_factor * event->delta;
+		axis->client_discrete += scroll_factor * event->delta_discrete;
+	}
+	axis->source = event->source;
+	axis->relative_direction = event->relative_direction;
+	axis->time_msec = event->time_msec;
+}
+
+static void
+flush_axis(struct seat *seat, enum wl_pointer_axis orientation)
+{
+	struct pending_axis *axis = &seat->pending_axis[orientation];
+	if (!axis->pending) {
+		return;
+	}
+
+	if (axis->delta != 0.0) {
+		bool notify = process_cursor_axis(seat->server, orientation,
+			axis->delta, axis->delta_discrete);
+		if (notify) {
+			/* Notify the client with pointer focus of the axis event. */
+			wlr_seat_pointer_notify_axis(seat->seat, axis->time_msec,
+				orientation, axis->client_delta,
+				round(axis->client_discrete), axis->source,
+				axis->relative_direction);
+		}
+	}
+	if (axis->stop) {
+		bool notify = process_cursor_axis(seat->server, orientation,
+			0.0, 0.0);
+		if (notify) {
+			wlr_seat_pointer_notify_axis(seat->seat, axis->time_msec,
+				orientation, 0.0, 0, axis->source,
+				axis->relative_direction);
+		}
 	}
+	*axis = (struct pending_axis){0};
 }
 
 static void
@@ -1256,6 +1490,11 @@ handle_frame(struct wl_listener *listener, void *data)
 	 * between.
 	 */
 	struct seat *seat = wl_container_of(listener, seat, on_cursor.frame);
+	if (rc.motion_coalesce == LAB_MOTION_COALESCE_POINTER_FRAME) {
+		cursor_flush_motion(seat);
+	}
+	flush_axis(seat, WL_POINTER_AXIS_VERTICAL_SCROLL);
+	flush_axis(seat, WL_POINTER_AXIS_HORIZONTAL_SCROLL);
 	/* Notify the client with pointer focus of the frame event. */
 	wlr_seat_pointer_notify_frame(seat->seat);
 }
@@ -1266,12 +1505,12 @@ cursor_emulate_axis(struct seat *seat, struct wlr_input_device *device,
 		enum wl_pointer_axis_source source, uint32_t time_msec)
 {
 	struct server *server = seat->server;
-	struct input *input = device->data;
 
 	double scroll_factor = 1.0;
 	/* input->scroll_factor is set for pointer/touch devices */
-	if (device->type == WLR_INPUT_DEVICE_POINTER
-			|| device->type == WLR_INPUT_DEVICE_TOUCH) {
+	if (device && (device->type == WLR_INPUT_DEVICE_POINTER
+			|| device->type == WLR_INPUT_DEVICE_TOUCH)) {
+		struct input *input = device->data;
 		scroll_factor = input->scroll_factor;
 	}
 
@@ -1314,8 +1553,7 @@ cursor_emulate_move_absolute(struct seat *seat, struct wlr_input_device *device,
 		double x, double y, uint32_t time_msec)
 {
 	double lx, ly;
-	wlr_cursor_absolute_to_layout_coords(seat->cursor,
-		device, x, y, &lx, &ly);
+	input_absolute_to_layout_coords(seat, device, x, y, &lx, &ly);
 
 	double dx = lx - seat->cursor->x;
 	double dy = ly - seat->cursor->y;
@@ -1367,28 +1605,55 @@ cursor_load(struct seat *seat)
 	 *
 	 * However, the aliasing does not include the "grab" cursor
 	 * icon which labwc uses when dragging a window. To fix that,
-	 * try to get the grab cursor icon from wlroots. If the user
-	 * supplied an appropriate cursor theme which includes the
-	 * "grab" cursor icon, we will keep using it.
-	 *
-	 * If no "grab" icon can be found we will fall back to the
-	 * old style cursor names and use "grabbing" instead which
-	 * is part of the X11 fallbacks and thus always available.
+	 * each cursor-spec name is looked up in the theme once and
+	 * the old style name (e.g. "grabbing" instead of "grab") is
+	 * used for the ones which can't be found. These are part of
+	 * the X11 fallbacks and thus always available.
 	 *
 	 * Shipping the complete alias table for X11 cursor names
-	 * (and not just the "grab" cursor alias) makes sure that
-	 * this also works for wlroots versions before 0.16.2.
+	 * makes sure that this also works for wlroots versions before
+	 * 0.16.2.
 	 *
 	 * See the cursor name alias table on the top of this file
 	 * for the actual cursor names used.
 	 */
-	if (wlr_xcursor_manager_get_xcursor(seat->xcursor_manager,
-			cursors_xdg[LAB_CURSOR_GRAB], 1)) {
-		cursor_names = cursors_xdg;
-	} else {
+	int nr_fallbacks = 0;
+	for (int i = LAB_CURSOR_DEFAULT; i < LAB_CURSOR_COUNT; i++) {
+		if (wlr_xcursor_manager_get_xcursor(seat->xcursor_manager,
+				cursors_xdg[i], 1)) {
+			cursor_names[i] = cursors_xdg[i];
+		} else {
+			cursor_names[i] = cursors_x11[i];
+			nr_fallbacks++;
+		}
+	}
+	if (nr_fallbacks) {
 		wlr_log(WLR_INFO,
-			"Cursor theme is missing cursor names, using fallback");
-		cursor_names = cursors_x11;
+			"Cursor theme is missing %d cursor names, using fallback",
+			nr_fallbacks);
+	}
+
+	/* Themes of a previous cursor manager are gone */
+	struct output *output;
+	wl_list_for_each(output, &seat->server->outputs, link) {
+		cursor_load_scale(seat, output->wlr_output->scale);
+	}
+}
+
+void
+cursor_load_scale(struct seat *seat, float scale)
+{
+	if (!wlr_xcursor_manager_load(seat->xcursor_manager, scale)) {
+		wlr_log(WLR_ERROR, "failed to load cursor theme for scale %.2f",
+			scale);
+		return;
+	}
+	for (int i = LAB_CURSOR_DEFAULT; i < LAB_CURSOR_COUNT; i++) {
+		if (!wlr_xcursor_manager_get_xcursor(seat->xcursor_manager,
+				cursor_names[i], scale)) {
+			wlr_log(WLR_DEBUG, "no cursor image '%s' at scale %.2f",
+				cursor_names[i], scale);
+		}
 	}
 }
 
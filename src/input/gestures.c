@@ -1,9 +1,235 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <time.h>
 #include <wlr/types/wlr_pointer_gestures_v1.h>
 #include "common/macros.h"
 #include "input/gestures.h"
 #include "labwc.h"
 #include "idle.h"
+#include "workspaces.h"
+
+/*
+ * Time constant of the exponential approach of the shown workspace offset
+ * to the one given by the fingers, in milliseconds
+ */
+#define SWIPE_SMOOTHING_MSEC 25.0
+/* Fraction of the output width a swipe must cover to switch workspaces */
+#define SWIPE_COMMIT_FRACTION 0.25
+
+static int64_t
+now_msec(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void
+schedule_frames(struct server *server)
+{
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output_is_usable(output)) {
+			wlr_output_schedule_frame(output->wlr_output);
+		}
+	}
+}
+
+static void
+set_neighbor(struct seat *seat, struct workspace *neighbor)
+{
+	struct workspace *old = seat->workspace_swipe.neighbor;
+	if (old == neighbor) {
+		return;
+	}
+	if (old) {
+		/* Unless it has become the current one by other means */
+		if (old != seat->server->workspaces.current) {
+			wlr_scene_node_set_enabled(&old->tree->node, false);
+		}
+		wlr_scene_node_set_position(&old->tree->node, 0, 0);
+	}
+	if (neighbor) {
+		wlr_scene_node_set_enabled(&neighbor->tree->node, true);
+	}
+	seat->workspace_swipe.neighbor = neighbor;
+}
+
+/* Moves the current workspace and its neighbor to the shown offset */
+static void
+position_workspaces(struct seat *seat)
+{
+	double shown = seat->workspace_swipe.shown;
+	int offset = lround(shown);
+	struct workspace *current = seat->workspace_swipe.origin;
+
+	/* Content follows the fingers, so moving left reveals the right one */
+	struct workspace *neighbor = NULL;
+	if (offset) {
+		neighbor = workspaces_find(current, offset < 0 ? "right" : "left",
+			/* wrap */ false);
+	}
+	set_neighbor(seat, neighbor);
+
+	wlr_scene_node_set_position(&current->tree->node, offset, 0);
+	if (neighbor) {
+		int distance = seat->workspace_swipe.distance;
+		wlr_scene_node_set_position(&neighbor->tree->node,
+			offset + (offset < 0 ? distance : -distance), 0);
+	}
+}
+
+static void
+finish_workspace_swipe(struct seat *seat)
+{
+	struct server *server = seat->server;
+	struct workspace *origin = seat->workspace_swipe.origin;
+	struct workspace *target = seat->workspace_swipe.target
+		? seat->workspace_swipe.neighbor : NULL;
+
+	if (origin) {
+		wlr_scene_node_set_position(&origin->tree->node, 0, 0);
+	}
+	if (origin != server->workspaces.current) {
+		/* Switched or destroyed by other means meanwhile */
+		target = NULL;
+	}
+	if (target) {
+		/* The neighbor is enabled already, switch to it */
+		wlr_scene_node_set_position(&target->tree->node, 0, 0);
+		seat->workspace_swipe.neighbor = NULL;
+		workspaces_switch_to(target, /* update_focus */ true);
+	} else {
+		set_neighbor(seat, NULL);
+	}
+	seat->workspace_swipe.origin = NULL;
+	seat->workspace_swipe.active = false;
+	seat->workspace_swipe.animating = false;
+	seat->workspace_swipe.shown = 0;
+	seat->workspace_swipe.target = 0;
+}
+
+void
+gestures_output_frame(struct seat *seat)
+{
+	if (!seat->workspace_swipe.animating) {
+		return;
+	}
+	if (seat->workspace_swipe.origin != seat->server->workspaces.current) {
+		finish_workspace_swipe(seat);
+		return;
+	}
+
+	/*
+	 * Updates only accumulate the offset, the scene is moved once per
+	 * frame. The step depends on the time since the last one, so that
+	 * frames of several outputs don't speed up the animation.
+	 */
+	int64_t now = now_msec();
+	double elapsed = now - seat->workspace_swipe.last_frame_msec;
+	seat->workspace_swipe.last_frame_msec = now;
+	double target = seat->workspace_swipe.target;
+	double shown = seat->workspace_swipe.shown;
+	shown += (target - shown) * (1.0 - exp(-elapsed / SWIPE_SMOOTHING_MSEC));
+	if (fabs(target - shown) < 1.0) {
+		shown = target;
+	}
+	seat->workspace_swipe.shown = shown;
+
+	if (!seat->workspace_swipe.active && shown == target) {
+		finish_workspace_swipe(seat);
+		return;
+	}
+	position_workspaces(seat);
+	if (shown != target) {
+		schedule_frames(seat->server);
+	}
+}
+
+static bool
+workspace_swipe_begin(struct seat *seat, uint32_t fingers)
+{
+	struct server *server = seat->server;
+	if (!rc.workspace_config.swipe_fingers
+			|| fingers != (uint32_t)rc.workspace_config.swipe_fingers
+			|| server->input_mode != LAB_INPUT_STATE_PASSTHROUGH
+			|| wl_list_length(&server->workspaces.all) < 2) {
+		return false;
+	}
+	if (seat->workspace_swipe.animating) {
+		/* Land the previous swipe before starting a new one */
+		finish_workspace_swipe(seat);
+	}
+	/* And a slide of a workspace switch, which moves the same trees */
+	animation_finish(&server->workspaces.slide.animation);
+
+	struct output *output = output_nearest_to(server,
+		seat->cursor->x, seat->cursor->y);
+	struct wlr_box box = {0};
+	if (output_is_usable(output)) {
+		wlr_output_layout_get_box(server->output_layout,
+			output->wlr_output, &box);
+	}
+	if (wlr_box_empty(&box)) {
+		return false;
+	}
+
+	seat->workspace_swipe.origin = server->workspaces.current;
+	seat->workspace_swipe.active = true;
+	seat->workspace_swipe.animating = true;
+	seat->workspace_swipe.distance = box.width;
+	seat->workspace_swipe.target = 0;
+	seat->workspace_swipe.shown = 0;
+	seat->workspace_swipe.last_frame_msec = now_msec();
+	return true;
+}
+
+static void
+workspace_swipe_update(struct seat *seat, double dx)
+{
+	struct workspace *origin = seat->workspace_swipe.origin;
+	if (!origin) {
+		return;
+	}
+	int distance = seat->workspace_swipe.distance;
+	double target = seat->workspace_swipe.target + dx;
+	target = MAX(-distance, MIN(distance, target));
+
+	/* Don't pull in a workspace that does not exist */
+	if (target && !workspaces_find(origin,
+			target < 0 ? "right" : "left", /* wrap */ false)) {
+		target = 0;
+	}
+	seat->workspace_swipe.target = target;
+	schedule_frames(seat->server);
+}
+
+static void
+workspace_swipe_end(struct seat *seat, bool cancelled)
+{
+	double target = seat->workspace_swipe.target;
+	int distance = seat->workspace_swipe.distance;
+	if (cancelled || fabs(target) < distance * SWIPE_COMMIT_FRACTION) {
+		target = 0;
+	} else {
+		target = target < 0 ? -distance : distance;
+	}
+	seat->workspace_swipe.target = target;
+	seat->workspace_swipe.active = false;
+	schedule_frames(seat->server);
+}
+
+void
+gestures_workspace_destroyed(struct seat *seat, struct workspace *workspace)
+{
+	if (seat->workspace_swipe.neighbor == workspace) {
+		seat->workspace_swipe.neighbor = NULL;
+	}
+	if (seat->workspace_swipe.origin == workspace) {
+		seat->workspace_swipe.origin = NULL;
+	}
+}
 
 static void
 handle_pinch_begin(struct wl_listener *listener, void *data)
@@ -54,6 +280,9 @@ handle_swipe_begin(struct wl_listener *listener, void *data)
 	idle_manager_notify_activity(seat->seat);
 	cursor_set_visible(seat, /* visible */ true);
 
+	if (workspace_swipe_begin(seat, event->fingers)) {
+		return;
+	}
 	wlr_pointer_gestures_v1_send_swipe_begin(seat->pointer_gestures,
 		seat->seat, event->time_msec, event->fingers);
 }
@@ -67,6 +296,10 @@ handle_swipe_update(struct wl_listener *listener, void *data)
 	idle_manager_notify_activity(seat->seat);
 	cursor_set_visible(seat, /* visible */ true);
 
+	if (seat->workspace_swipe.active) {
+		workspace_swipe_update(seat, event->dx);
+		return;
+	}
 	wlr_pointer_gestures_v1_send_swipe_update(seat->pointer_gestures,
 		seat->seat, event->time_msec, event->dx, event->dy);
 }
@@ -80,6 +313,10 @@ handle_swipe_end(struct wl_listener *listener, void *data)
 	idle_manager_notify_activity(seat->seat);
 	cursor_set_visible(seat, /* visible */ true);
 
+	if (seat->workspace_swipe.active) {
+		workspace_swipe_end(seat, event->cancelled);
+		return;
+	}
 	wlr_pointer_gestures_v1_send_swipe_end(seat->pointer_gestures,
 		seat->seat, event->time_msec, event->cancelled);
 }
@@ -3,6 +3,7 @@
 
 #include <assert.h>
 #include "common/mem.h"
+#include "common/slab.h"
 #include "input/ime.h"
 #include "node.h"
 #include "view.h"
@@ -11,6 +12,8 @@
 	(wl_resource_get_client((wlr_obj1)->resource) \
 	== wl_resource_get_client((wlr_obj2)->resource))
 
+static struct lab_slab popup_slab = LAB_SLAB_INIT(struct input_method_popup);
+
 static bool
 is_keyboard_emulated_by_input_method(struct wlr_keyboard *keyboard,
 		struct wlr_input_method_v2 *input_method)
@@ -193,60 +196,105 @@ update_text_inputs_focused_surface(struct input_method_relay *relay)
 	}
 }
 
-static void
-update_popup_position(struct input_method_popup *popup)
+/* Returns the cursor rectangle of the active text-input in layout coords */
+static struct wlr_box
+get_cursor_rect(struct input_method_relay *relay)
 {
-	struct input_method_relay *relay = popup->relay;
-	struct server *server = relay->seat->server;
 	struct text_input *text_input = relay->active_text_input;
-
-	if (!text_input || !relay->focused_surface
-			|| !popup->popup_surface->surface->mapped) {
-		return;
-	}
-
-	struct wlr_box cursor_rect;
 	struct wlr_xdg_surface *xdg_surface =
 		wlr_xdg_surface_try_from_wlr_surface(relay->focused_surface);
 	struct wlr_layer_surface_v1 *layer_surface =
 		wlr_layer_surface_v1_try_from_wlr_surface(relay->focused_surface);
 
-	if ((text_input->input->current.features
+	if (!(text_input->input->current.features
 			& WLR_TEXT_INPUT_V3_FEATURE_CURSOR_RECTANGLE)
-			&& (xdg_surface || layer_surface)) {
-		cursor_rect = text_input->input->current.cursor_rectangle;
-
-		/*
-		 * wlr_surface->data is:
-		 * - for XDG surfaces: view->content_tree
-		 * - for layer surfaces: lab_layer_surface->scene_layer_surface->tree
-		 * - for layer popups: lab_layer_popup->scene_tree
-		 */
-		struct wlr_scene_tree *tree = relay->focused_surface->data;
-		int lx, ly;
-		wlr_scene_node_coords(&tree->node, &lx, &ly);
-		cursor_rect.x += lx;
-		cursor_rect.y += ly;
-
-		if (xdg_surface) {
-			/* Take into account invisible xdg-shell CSD borders */
-			cursor_rect.x -= xdg_surface->geometry.x;
-			cursor_rect.y -= xdg_surface->geometry.y;
-		}
-	} else {
-		cursor_rect = (struct wlr_box){0};
+			|| !(xdg_surface || layer_surface)) {
+		return (struct wlr_box){0};
+	}
+
+	struct wlr_box cursor_rect = text_input->input->current.cursor_rectangle;
+
+	/*
+	 * wlr_surface->data is:
+	 * - for XDG surfaces: view->content_tree
+	 * - for layer surfaces: lab_layer_surface->scene_layer_surface->tree
+	 * - for layer popups: lab_layer_popup->scene_tree
+	 */
+	struct wlr_scene_tree *tree = relay->focused_surface->data;
+	int lx, ly;
+	wlr_scene_node_coords(&tree->node, &lx, &ly);
+	cursor_rect.x += lx;
+	cursor_rect.y += ly;
+
+	if (xdg_surface) {
+		/* Take into account invisible xdg-shell CSD borders */
+		cursor_rect.x -= xdg_surface->geometry.x;
+		cursor_rect.y -= xdg_surface->geometry.y;
+	}
+	return cursor_rect;
+}
+
+/*
+ * Looks up the output box to constrain the popup to. The nearest output
+ * stays the same as long as the cursor rectangle remains on it.
+ */
+static bool
+get_output_box(struct input_method_popup *popup, struct wlr_box *cursor_rect,
+		struct wlr_box *output_box)
+{
+	struct server *server = popup->relay->seat->server;
+	if (popup->placement.valid && popup->placement.layout_generation
+				== server->output_layout_generation
+			&& wlr_box_contains_point(&popup->placement.output_box,
+				cursor_rect->x, cursor_rect->y)) {
+		*output_box = popup->placement.output_box;
+		return true;
 	}
 
 	struct output *output =
-		output_nearest_to(server, cursor_rect.x, cursor_rect.y);
+		output_nearest_to(server, cursor_rect->x, cursor_rect->y);
 	if (!output_is_usable(output)) {
 		wlr_log(WLR_ERROR,
 			"Cannot position IME popup (unusable output)");
+		return false;
+	}
+	wlr_output_layout_get_box(
+		server->output_layout, output->wlr_output, output_box);
+	return true;
+}
+
+static void
+update_popup_position(struct input_method_popup *popup)
+{
+	struct input_method_relay *relay = popup->relay;
+	struct server *server = relay->seat->server;
+	struct text_input *text_input = relay->active_text_input;
+
+	if (!text_input || !relay->focused_surface
+			|| !popup->popup_surface->surface->mapped) {
 		return;
 	}
+
+	struct wlr_box cursor_rect = get_cursor_rect(relay);
+	int width = popup->popup_surface->surface->current.width;
+	int height = popup->popup_surface->surface->current.height;
+
+	/* Make sure IME popups are always on top, above layer-shell surfaces */
+	wlr_scene_node_raise_to_top(&relay->popup_tree->node);
+
+	if (popup->placement.valid
+			&& popup->placement.layout_generation
+				== server->output_layout_generation
+			&& wlr_box_equal(&popup->placement.cursor_rect, &cursor_rect)
+			&& popup->placement.width == width
+			&& popup->placement.height == height) {
+		return;
+	}
+
 	struct wlr_box output_box;
-	wlr_output_layout_get_box(
-		server->output_layout, output->wlr_output, &output_box);
+	if (!get_output_box(popup, &cursor_rect, &output_box)) {
+		return;
+	}
 
 	/* Use xdg-positioner utilities to position popup */
 	struct wlr_xdg_positioner_rules rules = {
@@ -254,8 +302,8 @@ update_popup_position(struct input_method_popup *popup)
 		.anchor = XDG_POSITIONER_ANCHOR_BOTTOM_LEFT,
 		.gravity = XDG_POSITIONER_GRAVITY_BOTTOM_RIGHT,
 		.size = {
-			.width = popup->popup_surface->surface->current.width,
-			.height = popup->popup_surface->surface->current.height,
+			.width = width,
+			.height = height,
 		},
 		.constraint_adjustment =
 			XDG_POSITIONER_CONSTRAINT_ADJUSTMENT_FLIP_Y
@@ -268,8 +316,6 @@ update_popup_position(struct input_method_popup *popup)
 
 	wlr_scene_node_set_position(
 		&popup->tree->node, popup_box.x, popup_box.y);
-	/* Make sure IME popups are always on top, above layer-shell surfaces */
-	wlr_scene_node_raise_to_top(&relay->popup_tree->node);
 
 	wlr_input_popup_surface_v2_send_text_input_rectangle(
 		popup->popup_surface, &(struct wlr_box){
@@ -278,6 +324,13 @@ update_popup_position(struct input_method_popup *popup)
 			.width = cursor_rect.width,
 			.height = cursor_rect.height,
 		});
+
+	popup->placement.valid = true;
+	popup->placement.layout_generation = server->output_layout_generation;
+	popup->placement.cursor_rect = cursor_rect;
+	popup->placement.width = width;
+	popup->placement.height = height;
+	popup->placement.output_box = output_box;
 }
 
 static void
@@ -390,7 +443,7 @@ handle_popup_surface_destroy(struct wl_listener *listener, void *data)
 	wl_list_remove(&popup->destroy.link);
 	wl_list_remove(&popup->commit.link);
 	wl_list_remove(&popup->link);
-	free(popup);
+	lab_slab_free(&popup_slab, popup);
 }
 
 static void
@@ -407,7 +460,7 @@ handle_input_method_new_popup_surface(struct wl_listener *listener, void *data)
 	struct input_method_relay *relay = wl_container_of(listener, relay,
 		input_method_new_popup_surface);
 
-	struct input_method_popup *popup = znew(*popup);
+	struct input_method_popup *popup = lab_slab_new(&popup_slab, *popup);
 	popup->popup_surface = data;
 	popup->relay = relay;
 
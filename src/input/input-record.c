@@ -0,0 +1,367 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wlr/interfaces/wlr_keyboard.h>
+#include <wlr/util/log.h>
+#include "common/macros.h"
+#include "common/mem.h"
+#include "input/cursor.h"
+#include "input/input-record.h"
+#include "labwc.h"
+
+#define INPUT_RECORD_MAGIC "LABINPUT"
+#define INPUT_RECORD_VERSION 1
+
+/* Events replayed at once without yielding to the event loop */
+#define REPLAY_BATCH 64
+
+enum input_record_type {
+	LAB_INPUT_RECORD_MOTION = 0,
+	LAB_INPUT_RECORD_BUTTON,
+	LAB_INPUT_RECORD_AXIS,
+	LAB_INPUT_RECORD_KEY,
+
+	LAB_INPUT_RECORD_COUNT
+};
+
+static const char *type_names[LAB_INPUT_RECORD_COUNT] = {
+	[LAB_INPUT_RECORD_MOTION] = "motion",
+	[LAB_INPUT_RECORD_BUTTON] = "button",
+	[LAB_INPUT_RECORD_AXIS] = "axis",
+	[LAB_INPUT_RECORD_KEY] = "key",
+};
+
+struct input_record_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+};
+
+/* Native endianness, files are not meant to be moved between machines */
+struct input_record {
+	uint32_t time_msec;
+	uint8_t type;
+	uint8_t reserved[3];
+	/* Button, axis orientation or keycode */
+	uint32_t code;
+	/* Button or key state, axis source */
+	uint32_t state;
+	/* Motion delta, axis delta and discrete delta */
+	double x, y;
+};
+
+struct replay_stats {
+	uint32_t count;
+	uint64_t total_ns;
+	uint64_t max_ns;
+};
+
+static FILE *record_file;
+
+static struct {
+	struct input_record *records;
+	size_t nr_records, next;
+	double speed;
+	int64_t start_msec;
+	uint32_t first_time_msec;
+	struct lab_timer timer;
+	struct replay_stats stats[LAB_INPUT_RECORD_COUNT];
+	uint32_t skipped;
+} replay;
+
+static int64_t
+now_nsec(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void
+record(struct input_record *rec)
+{
+	if (!record_file || replay.records) {
+		return;
+	}
+	if (fwrite(rec, sizeof(*rec), 1, record_file) != 1) {
+		wlr_log_errno(WLR_ERROR, "failed to write input recording");
+		fclose(record_file);
+		record_file = NULL;
+	}
+}
+
+void
+input_record_motion(uint32_t time_msec, double dx, double dy)
+{
+	record(&(struct input_record){
+		.time_msec = time_msec,
+		.type = LAB_INPUT_RECORD_MOTION,
+		.x = dx,
+		.y = dy,
+	});
+}
+
+void
+input_record_button(uint32_t time_msec, uint32_t button, uint32_t state)
+{
+	record(&(struct input_record){
+		.time_msec = time_msec,
+		.type = LAB_INPUT_RECORD_BUTTON,
+		.code = button,
+		.state = state,
+	});
+}
+
+void
+input_record_axis(uint32_t time_msec, uint32_t orientation, uint32_t source,
+		double delta, double delta_discrete)
+{
+	record(&(struct input_record){
+		.time_msec = time_msec,
+		.type = LAB_INPUT_RECORD_AXIS,
+		.code = orientation,
+		.state = source,
+		.x = delta,
+		.y = delta_discrete,
+	});
+}
+
+void
+input_record_key(uint32_t time_msec, uint32_t keycode, uint32_t state)
+{
+	record(&(struct input_record){
+		.time_msec = time_msec,
+		.type = LAB_INPUT_RECORD_KEY,
+		.code = keycode,
+		.state = state,
+	});
+}
+
+void
+input_record_toggle(const char *path)
+{
+	if (record_file) {
+		fclose(record_file);
+		record_file = NULL;
+		wlr_log(WLR_INFO, "input recording stopped");
+		return;
+	}
+	if (!path) {
+		wlr_log(WLR_ERROR, "no file to record input to");
+		return;
+	}
+	record_file = fopen(path, "wb");
+	if (!record_file) {
+		wlr_log_errno(WLR_ERROR, "cannot record input to %s", path);
+		return;
+	}
+	struct input_record_header header = {
+		.magic = INPUT_RECORD_MAGIC,
+		.version = INPUT_RECORD_VERSION,
+		.record_size = sizeof(struct input_record),
+	};
+	if (fwrite(&header, sizeof(header), 1, record_file) != 1) {
+		wlr_log_errno(WLR_ERROR, "cannot record input to %s", path);
+		fclose(record_file);
+		record_file = NULL;
+		return;
+	}
+	wlr_log(WLR_INFO, "recording input to %s", path);
+}
+
+static struct wlr_keyboard *
+replay_keyboard(struct seat *seat)
+{
+	/* Only keyboard devices are connected to keyboard_key_notify() */
+	struct input *input;
+	wl_list_for_each(input, &seat->inputs, link) {
+		if (input->wlr_input_device->type == WLR_INPUT_DEVICE_KEYBOARD) {
+			return ((struct keyboard *)input)->wlr_keyboard;
+		}
+	}
+	return NULL;
+}
+
+static bool
+replay_event(struct seat *seat, const struct input_record *rec,
+		uint32_t time_msec)
+{
+	switch (rec->type) {
+	case LAB_INPUT_RECORD_MOTION:
+		cursor_emulate_move(seat, NULL, rec->x, rec->y, time_msec);
+		return true;
+	case LAB_INPUT_RECORD_BUTTON:
+		cursor_emulate_button(seat, rec->code, rec->state, time_msec);
+		return true;
+	case LAB_INPUT_RECORD_AXIS:
+		cursor_emulate_axis(seat, NULL, rec->code, rec->x, rec->y,
+			rec->state, time_msec);
+		return true;
+	case LAB_INPUT_RECORD_KEY: {
+		struct wlr_keyboard *keyboard = replay_keyboard(seat);
+		if (!keyboard) {
+			return false;
+		}
+		struct wlr_keyboard_key_event event = {
+			.time_msec = time_msec,
+			.keycode = rec->code,
+			.update_state = true,
+			.state = rec->state,
+		};
+		wlr_keyboard_notify_key(keyboard, &event);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+static void
+replay_log_summary(void)
+{
+	wlr_log(WLR_INFO, "replayed %zu input events, %u skipped",
+		replay.nr_records, replay.skipped);
+	for (size_t type = 0; type < LAB_INPUT_RECORD_COUNT; type++) {
+		struct replay_stats *stats = &replay.stats[type];
+		if (!stats->count) {
+			continue;
+		}
+		wlr_log(WLR_INFO, "  %-6s %u events, mean=%.3fms max=%.3fms",
+			type_names[type], stats->count,
+			stats->total_ns / 1e6 / stats->count, stats->max_ns / 1e6);
+	}
+}
+
+static void
+replay_stop(void)
+{
+	lab_timer_disarm(&replay.timer);
+	zfree(replay.records);
+	replay.nr_records = 0;
+	replay.next = 0;
+}
+
+/* Milliseconds from the start of the replay at which @rec is due */
+static int64_t
+replay_due_msec(const struct input_record *rec)
+{
+	uint32_t offset = rec->time_msec - replay.first_time_msec;
+	return replay.start_msec + (int64_t)(offset / replay.speed);
+}
+
+static void
+handle_replay_timer(void *data)
+{
+	struct seat *seat = data;
+	int64_t now_msec = now_nsec() / 1000000;
+
+	for (int n = 0; replay.next < replay.nr_records; n++) {
+		struct input_record *rec = &replay.records[replay.next];
+		int64_t due = replay.speed > 0 ? replay_due_msec(rec) : now_msec;
+		if (due > now_msec || n == REPLAY_BATCH) {
+			lab_timer_arm(&seat->timers, &replay.timer,
+				(int)MAX(due - now_msec, 1));
+			return;
+		}
+		replay.next++;
+
+		int64_t start = now_nsec();
+		if (!replay_event(seat, rec, (uint32_t)now_msec)) {
+			replay.skipped++;
+			continue;
+		}
+		uint64_t ns = now_nsec() - start;
+		struct replay_stats *stats = &replay.stats[rec->type];
+		stats->count++;
+		stats->total_ns += ns;
+		stats->max_ns = MAX(stats->max_ns, ns);
+	}
+
+	replay_log_summary();
+	replay_stop();
+}
+
+static bool
+replay_load(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		wlr_log_errno(WLR_ERROR, "cannot replay input from %s", path);
+		return false;
+	}
+
+	struct input_record_header header;
+	if (fread(&header, sizeof(header), 1, file) != 1
+			|| memcmp(header.magic, INPUT_RECORD_MAGIC,
+				sizeof(header.magic))
+			|| header.version != INPUT_RECORD_VERSION
+			|| header.record_size != sizeof(struct input_record)) {
+		wlr_log(WLR_ERROR, "%s is not an input recording", path);
+		fclose(file);
+		return false;
+	}
+
+	size_t alloc = 0;
+	for (;;) {
+		if (replay.nr_records == alloc) {
+			alloc = alloc ? alloc * 2 : 1024;
+			replay.records = xrealloc(replay.records,
+				alloc * sizeof(*replay.records));
+		}
+		if (fread(&replay.records[replay.nr_records],
+				sizeof(*replay.records), 1, file) != 1) {
+			break;
+		}
+		replay.nr_records++;
+	}
+	fclose(file);
+	return true;
+}
+
+void
+input_replay_start(struct seat *seat, const char *path, double speed)
+{
+	if (replay.records) {
+		wlr_log(WLR_ERROR, "an input replay is already running");
+		return;
+	}
+	if (!path) {
+		wlr_log(WLR_ERROR, "no input recording to replay");
+		return;
+	}
+	if (!replay_load(path)) {
+		zfree(replay.records);
+		return;
+	}
+	if (!replay.nr_records) {
+		wlr_log(WLR_INFO, "%s is an empty input recording", path);
+		zfree(replay.records);
+		return;
+	}
+
+	replay.speed = MAX(speed, 0.0);
+	replay.next = 0;
+	replay.skipped = 0;
+	memset(replay.stats, 0, sizeof(replay.stats));
+	replay.first_time_msec = replay.records[0].time_msec;
+	replay.start_msec = now_nsec() / 1000000;
+	lab_timer_init(&replay.timer, handle_replay_timer, seat);
+	lab_timer_arm(&seat->timers, &replay.timer, 1);
+	wlr_log(WLR_INFO, "replaying %zu input events from %s",
+		replay.nr_records, path);
+}
+
+void
+input_record_finish(void)
+{
+	if (record_file) {
+		fclose(record_file);
+		record_file = NULL;
+	}
+	if (replay.records) {
+		replay_stop();
+	}
+}
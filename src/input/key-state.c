@@ -5,13 +5,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <wlr/util/log.h>
-#include "common/set.h"
+#include "common/bitset.h"
 #include "input/key-state.h"
 
-static struct lab_set pressed, bound, pressed_sent;
-
 static void
-report(struct lab_set *key_set, const char *msg)
+report(struct lab_bitset *key_set, const char *msg)
 {
 	static char *should_print;
 	static bool has_run;
@@ -24,71 +22,98 @@ report(struct lab_set *key_set, const char *msg)
 		return;
 	}
 	printf("%s", msg);
-	for (int i = 0; i < key_set->size; ++i) {
-		printf("%d,", key_set->values[i]);
+	lab_bitset_for_each(keycode, key_set) {
+		printf("%d,", keycode);
 	}
 	printf("\n");
 }
 
-uint32_t *
-key_state_pressed_sent_keycodes(void)
+static void
+sent_add(struct key_state *state, uint32_t keycode)
 {
-	report(&pressed, "before - pressed:");
-	report(&bound, "before - bound:");
+	if (keycode >= LAB_BITSET_MAX_BITS
+			|| lab_bitset_contains(&state->pressed_sent, keycode)) {
+		return;
+	}
+	lab_bitset_add(&state->pressed_sent, keycode);
+	state->sent_index[keycode] = state->nr_sent;
+	state->sent_keycodes[state->nr_sent++] = keycode;
+}
 
-	/* pressed_sent = pressed - bound */
-	pressed_sent = pressed;
-	for (int i = 0; i < bound.size; ++i) {
-		lab_set_remove(&pressed_sent, bound.values[i]);
+static void
+sent_remove(struct key_state *state, uint32_t keycode)
+{
+	if (!lab_bitset_contains(&state->pressed_sent, keycode)) {
+		return;
 	}
+	lab_bitset_remove(&state->pressed_sent, keycode);
+	uint32_t last = state->sent_keycodes[--state->nr_sent];
+	state->sent_keycodes[state->sent_index[keycode]] = last;
+	state->sent_index[last] = state->sent_index[keycode];
+}
 
-	report(&pressed_sent, "after - pressed_sent:");
+uint32_t *
+key_state_pressed_sent_keycodes(struct key_state *state)
+{
+	report(&state->pressed, "pressed:");
+	report(&state->bound, "bound:");
+	report(&state->pressed_sent, "pressed_sent:");
 
-	return pressed_sent.values;
+	return state->sent_keycodes;
 }
 
 int
-key_state_nr_pressed_sent_keycodes(void)
+key_state_nr_pressed_sent_keycodes(struct key_state *state)
 {
-	return pressed_sent.size;
+	return state->nr_sent;
 }
 
 void
-key_state_set_pressed(uint32_t keycode, bool is_pressed)
+key_state_set_pressed(struct key_state *state, uint32_t keycode,
+		bool is_pressed)
 {
 	if (is_pressed) {
-		lab_set_add(&pressed, keycode);
+		lab_bitset_add(&state->pressed, keycode);
+		if (!lab_bitset_contains(&state->bound, keycode)) {
+			sent_add(state, keycode);
+		}
 	} else {
-		lab_set_remove(&pressed, keycode);
+		lab_bitset_remove(&state->pressed, keycode);
+		sent_remove(state, keycode);
 	}
 }
 
 void
-key_state_store_pressed_key_as_bound(uint32_t keycode)
+key_state_store_pressed_key_as_bound(struct key_state *state, uint32_t keycode)
 {
-	lab_set_add(&bound, keycode);
+	lab_bitset_add(&state->bound, keycode);
+	sent_remove(state, keycode);
 }
 
 bool
-key_state_corresponding_press_event_was_bound(uint32_t keycode)
+key_state_corresponding_press_event_was_bound(struct key_state *state,
+		uint32_t keycode)
 {
-	return lab_set_contains(&bound, keycode);
+	return lab_bitset_contains(&state->bound, keycode);
 }
 
 void
-key_state_bound_key_remove(uint32_t keycode)
+key_state_bound_key_remove(struct key_state *state, uint32_t keycode)
 {
-	lab_set_remove(&bound, keycode);
+	lab_bitset_remove(&state->bound, keycode);
+	if (lab_bitset_contains(&state->pressed, keycode)) {
+		sent_add(state, keycode);
+	}
 }
 
 int
-key_state_nr_bound_keys(void)
+key_state_nr_bound_keys(struct key_state *state)
 {
-	return bound.size;
+	return lab_bitset_count(&state->bound);
 }
 
 int
-key_state_nr_pressed_keys(void)
+key_state_nr_pressed_keys(struct key_state *state)
 {
-	return pressed.size;
+	return lab_bitset_count(&state->pressed);
 }
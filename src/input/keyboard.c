@@ -6,13 +6,19 @@
 #include <wlr/backend/session.h>
 #include <wlr/interfaces/wlr_keyboard.h>
 #include "action.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/string-helpers.h"
 #include "common/three-state.h"
 #include "idle.h"
 #include "input/ime.h"
+#include "input/input-record.h"
 #include "input/keyboard.h"
 #include "input/key-state.h"
 #include "labwc.h"
 #include "osd.h"
+#include "output-timing.h"
+#include "overview.h"
 #include "regions.h"
 #include "view.h"
 #include "workspaces.h"
@@ -36,15 +42,11 @@ struct keyinfo {
 	bool is_modifier;
 };
 
-static bool should_cancel_cycling_on_next_key_release;
-
-static struct keybind *cur_keybind;
-
 /* Called on --reconfigure to prevent segfault when handling release keybinds */
 void
-keyboard_reset_current_keybind(void)
+keyboard_reset_current_keybind(struct seat *seat)
 {
-	cur_keybind = NULL;
+	seat->cur_keybind = NULL;
 }
 
 static void
@@ -82,7 +84,7 @@ keyboard_get_all_modifiers(struct seat *seat)
 static void
 end_cycling(struct server *server)
 {
-	should_cancel_cycling_on_next_key_release = false;
+	server->seat.cancel_cycling_on_key_release = false;
 
 	if (server->input_mode != LAB_INPUT_STATE_WINDOW_SWITCHER) {
 		return;
@@ -101,25 +103,68 @@ seat_client_from_keyboard_resource(struct wl_resource *resource)
 	return wl_resource_get_user_data(resource);
 }
 
+static bool
+client_in_array(struct wl_array *clients, struct wl_client *client)
+{
+	struct wl_client **entry;
+	wl_array_for_each(entry, clients) {
+		if (*entry == client) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Appends the clients of views shown on the current workspace */
 static void
-broadcast_modifiers_to_unfocused_clients(struct wlr_seat *seat,
-		const struct keyboard *keyboard,
+add_visible_clients(struct server *server, struct wl_array *clients)
+{
+	struct view *view;
+	for_each_view(view, &server->views,
+			LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+		if (view->minimized || !view->surface) {
+			continue;
+		}
+		struct wl_client *client =
+			wl_resource_get_client(view->surface->resource);
+		if (client_in_array(clients, client)) {
+			continue;
+		}
+		struct wl_client **entry = wl_array_add(clients, sizeof(*entry));
+		if (entry) {
+			*entry = client;
+		}
+	}
+}
+
+static void
+broadcast_modifiers_to_unfocused_clients(struct seat *seat,
 		const struct wlr_keyboard_modifiers *modifiers)
 {
-	/* Prevent overwriting the group modifier by a virtual keyboard */
-	if (keyboard->is_virtual) {
-		return;
+	struct wlr_seat *wlr_seat = seat->seat;
+	struct wlr_seat_client *pointer_client =
+		wlr_seat->pointer_state.focused_client;
+
+	struct wl_array visible;
+	wl_array_init(&visible);
+	if (rc.kb_modifier_broadcast == LAB_MODIFIER_BROADCAST_VISIBLE) {
+		add_visible_clients(seat->server, &visible);
 	}
 
 	struct wlr_seat_client *client;
-	wl_list_for_each(client, &seat->clients, link) {
-		if (client == seat->keyboard_state.focused_client) {
+	wl_list_for_each(client, &wlr_seat->clients, link) {
+		if (client == wlr_seat->keyboard_state.focused_client) {
 			/*
 			 * We've already notified the focused client by calling
 			 * wlr_seat_keyboard_notify_modifiers()
 			 */
 			continue;
 		}
+		if (rc.kb_modifier_broadcast != LAB_MODIFIER_BROADCAST_ALL
+				&& client != pointer_client
+				&& !client_in_array(&visible, client->client)) {
+			continue;
+		}
 		uint32_t serial = wlr_seat_client_next_serial(client);
 		struct wl_resource *resource;
 		wl_resource_for_each(resource, &client->keyboards) {
@@ -136,6 +181,36 @@ broadcast_modifiers_to_unfocused_clients(struct wlr_seat *seat,
 			}
 		}
 	}
+	wl_array_release(&visible);
+}
+
+/*
+ * Several modifier changes often arrive in one go, for example when
+ * pressing Ctrl+Shift together or from xkb latches. Unfocused clients
+ * only get the state after the last of them.
+ */
+static void
+handle_modifier_broadcast_idle(void *data)
+{
+	struct seat *seat = data;
+	seat->modifier_broadcast_idle = NULL;
+	broadcast_modifiers_to_unfocused_clients(seat,
+		&seat->keyboard_group->keyboard.modifiers);
+}
+
+static void
+schedule_modifier_broadcast(struct seat *seat, const struct keyboard *keyboard)
+{
+	/* Prevent overwriting the group modifier by a virtual keyboard */
+	if (keyboard->is_virtual
+			|| rc.kb_modifier_broadcast == LAB_MODIFIER_BROADCAST_NONE) {
+		return;
+	}
+	if (!seat->modifier_broadcast_idle) {
+		seat->modifier_broadcast_idle = wl_event_loop_add_idle(
+			seat->server->wl_event_loop,
+			handle_modifier_broadcast_idle, seat);
+	}
 }
 
 static void
@@ -159,8 +234,8 @@ keyboard_modifiers_notify(struct wl_listener *listener, void *data)
 	if (window_switcher_active || seat->workspace_osd_shown_by_modifier) {
 		if (!keyboard_get_all_modifiers(seat)) {
 			if (window_switcher_active) {
-				if (key_state_nr_bound_keys()) {
-					should_cancel_cycling_on_next_key_release = true;
+				if (key_state_nr_bound_keys(&seat->key_state)) {
+					seat->cancel_cycling_on_key_release = true;
 				} else {
 					end_cycling(server);
 				}
@@ -191,12 +266,10 @@ keyboard_modifiers_notify(struct wl_listener *listener, void *data)
 		 * clients, whereas KWin and Weston pass modifiers to clients
 		 * with pointer-focus.
 		 *
-		 * This could be made configurable if there are unintended
-		 * consequences. If so, modifiers ought to still be passed to
-		 * clients with pointer-focus (see issue #2271)
+		 * <keyboard><broadcastModifiers> limits this to clients
+		 * which are visible or have pointer-focus (see issue #2271).
 		 */
-		broadcast_modifiers_to_unfocused_clients(seat->seat,
-			keyboard, &wlr_keyboard->modifiers);
+		schedule_modifier_broadcast(seat, keyboard);
 	}
 }
 
@@ -204,32 +277,19 @@ static struct keybind *
 match_keybinding_for_sym(struct server *server, uint32_t modifiers,
 		xkb_keysym_t sym, xkb_keycode_t xkb_keycode)
 {
-	struct keybind *keybind;
-	wl_list_for_each(keybind, &rc.keybinds, link) {
-		if (modifiers ^ keybind->modifiers) {
-			continue;
-		}
+	/* Keycodes are used when sym is XKB_KEY_NoSymbol */
+	size_t len;
+	struct keybind **keybinds =
+		keybind_lookup(modifiers, sym, xkb_keycode, &len);
+	for (size_t i = 0; i < len; i++) {
+		struct keybind *keybind = keybinds[i];
 		if (server->seat.nr_inhibited_keybind_views
 				&& server->active_view
 				&& server->active_view->inhibits_keybinds
 				&& !actions_contain_toggle_keybinds(&keybind->actions)) {
 			continue;
 		}
-		if (sym == XKB_KEY_NoSymbol) {
-			/* Use keycodes */
-			for (size_t i = 0; i < keybind->keycodes_len; i++) {
-				if (keybind->keycodes[i] == xkb_keycode) {
-					return keybind;
-				}
-			}
-		} else {
-			/* Use syms */
-			for (size_t i = 0; i < keybind->keysyms_len; i++) {
-				if (xkb_keysym_to_lower(sym) == keybind->keysyms[i]) {
-					return keybind;
-				}
-			}
-		}
+		return keybind;
 	}
 	return NULL;
 }
@@ -388,11 +448,13 @@ get_keyinfo(struct wlr_keyboard *wlr_keyboard, uint32_t evdev_keycode)
 static bool
 handle_key_release(struct server *server, uint32_t evdev_keycode)
 {
+	struct seat *seat = &server->seat;
 	/*
 	 * Release events for keys that were not bound should always be
 	 * forwarded to clients to avoid stuck keys.
 	 */
-	if (!key_state_corresponding_press_event_was_bound(evdev_keycode)) {
+	if (!key_state_corresponding_press_event_was_bound(&seat->key_state,
+			evdev_keycode)) {
 		return false;
 	}
 
@@ -405,7 +467,7 @@ handle_key_release(struct server *server, uint32_t evdev_keycode)
 	 * forward the event) and because we absorb the equivalent release
 	 * event it gets stuck on repeat.
 	 */
-	if (should_cancel_cycling_on_next_key_release) {
+	if (seat->cancel_cycling_on_key_release) {
 		end_cycling(server);
 	}
 
@@ -413,7 +475,7 @@ handle_key_release(struct server *server, uint32_t evdev_keycode)
 	 * If a press event was handled by a compositor binding, then do
 	 * not forward the corresponding release event to clients.
 	 */
-	key_state_bound_key_remove(evdev_keycode);
+	key_state_bound_key_remove(&seat->key_state, evdev_keycode);
 	return true;
 }
 
@@ -465,6 +527,37 @@ handle_cycle_view_key(struct server *server, struct keyinfo *keyinfo)
 	return false;
 }
 
+/* Returns true if the keystroke is consumed */
+static bool
+handle_overview_key(struct server *server, struct keyinfo *keyinfo)
+{
+	if (keyinfo->is_modifier) {
+		return false;
+	}
+
+	for (int i = 0; i < keyinfo->translated.nr_syms; i++) {
+		switch (keyinfo->translated.syms[i]) {
+		case XKB_KEY_Escape:
+			overview_finish(server);
+			return true;
+		case XKB_KEY_Return:
+		case XKB_KEY_KP_Enter:
+			overview_activate(server);
+			return true;
+		case XKB_KEY_Up:
+		case XKB_KEY_Left:
+			overview_cycle(server, LAB_CYCLE_DIR_BACKWARD);
+			return true;
+		case XKB_KEY_Down:
+		case XKB_KEY_Right:
+		case XKB_KEY_Tab:
+			overview_cycle(server, LAB_CYCLE_DIR_FORWARD);
+			return true;
+		}
+	}
+	return false;
+}
+
 static enum lab_key_handled
 handle_compositor_keybindings(struct keyboard *keyboard,
 		struct wlr_keyboard_key_event *event)
@@ -475,17 +568,19 @@ handle_compositor_keybindings(struct keyboard *keyboard,
 	struct keyinfo keyinfo = get_keyinfo(wlr_keyboard, event->keycode);
 	bool locked = seat->server->session_lock_manager->locked;
 
-	key_state_set_pressed(event->keycode,
+	struct key_state *key_state = &seat->key_state;
+	key_state_set_pressed(key_state, event->keycode,
 		event->state == WL_KEYBOARD_KEY_STATE_PRESSED);
 
 	if (event->state == WL_KEYBOARD_KEY_STATE_RELEASED) {
-		if (cur_keybind && cur_keybind->on_release) {
-			key_state_bound_key_remove(event->keycode);
-			if (locked && !cur_keybind->allow_when_locked) {
-				cur_keybind = NULL;
+		struct keybind *keybind = seat->cur_keybind;
+		if (keybind && keybind->on_release) {
+			key_state_bound_key_remove(key_state, event->keycode);
+			if (locked && !keybind->allow_when_locked) {
+				seat->cur_keybind = NULL;
 				return true;
 			}
-			actions_run(NULL, server, &cur_keybind->actions, NULL);
+			actions_run(NULL, server, &keybind->actions, NULL);
 			return true;
 		} else {
 			return handle_key_release(server, event->keycode);
@@ -494,7 +589,7 @@ handle_compositor_keybindings(struct keyboard *keyboard,
 
 	/* Catch C-A-F1 to C-A-F12 to change tty */
 	if (handle_change_vt_key(server, keyboard, &keyinfo.translated)) {
-		key_state_store_pressed_key_as_bound(event->keycode);
+		key_state_store_pressed_key_as_bound(key_state, event->keycode);
 		return LAB_KEY_HANDLED_TRUE_AND_VT_CHANGED;
 	}
 
@@ -505,11 +600,16 @@ handle_compositor_keybindings(struct keyboard *keyboard,
 	 */
 	if (!locked) {
 		if (server->input_mode == LAB_INPUT_STATE_MENU) {
-			key_state_store_pressed_key_as_bound(event->keycode);
+			key_state_store_pressed_key_as_bound(key_state, event->keycode);
 			return true;
 		} else if (server->input_mode == LAB_INPUT_STATE_WINDOW_SWITCHER) {
 			if (handle_cycle_view_key(server, &keyinfo)) {
-				key_state_store_pressed_key_as_bound(event->keycode);
+				key_state_store_pressed_key_as_bound(key_state, event->keycode);
+				return true;
+			}
+		} else if (server->input_mode == LAB_INPUT_STATE_OVERVIEW) {
+			if (handle_overview_key(server, &keyinfo)) {
+				key_state_store_pressed_key_as_bound(key_state, event->keycode);
 				return true;
 			}
 		}
@@ -518,16 +618,18 @@ handle_compositor_keybindings(struct keyboard *keyboard,
 	/*
 	 * Handle compositor keybinds
 	 */
-	cur_keybind = match_keybinding(server, &keyinfo, keyboard->is_virtual);
-	if (cur_keybind && (!locked || cur_keybind->allow_when_locked)) {
+	struct keybind *keybind =
+		match_keybinding(server, &keyinfo, keyboard->is_virtual);
+	seat->cur_keybind = keybind;
+	if (keybind && (!locked || keybind->allow_when_locked)) {
 		/*
 		 * Update key-state before action_run() because the action
 		 * might lead to seat_focus() in which case we pass the
 		 * 'pressed-sent' keys to the new surface.
 		 */
-		key_state_store_pressed_key_as_bound(event->keycode);
-		if (!cur_keybind->on_release) {
-			actions_run(NULL, server, &cur_keybind->actions, NULL);
+		key_state_store_pressed_key_as_bound(key_state, event->keycode);
+		if (!keybind->on_release) {
+			actions_run(NULL, server, &keybind->actions, NULL);
 		}
 		return true;
 	}
@@ -535,11 +637,10 @@ handle_compositor_keybindings(struct keyboard *keyboard,
 	return false;
 }
 
-static int
+static void
 handle_keybind_repeat(void *data)
 {
 	struct keyboard *keyboard = data;
-	assert(keyboard->keybind_repeat);
 	assert(keyboard->keybind_repeat_rate > 0);
 
 	/* synthesize event */
@@ -550,26 +651,23 @@ handle_keybind_repeat(void *data)
 
 	handle_compositor_keybindings(keyboard, &event);
 	int next_repeat_ms = 1000 / keyboard->keybind_repeat_rate;
-	wl_event_source_timer_update(keyboard->keybind_repeat,
+	lab_timer_arm(&keyboard->base.seat->timers, &keyboard->keybind_repeat,
 		next_repeat_ms);
-
-	return 0; /* ignored per wl_event_loop docs */
 }
 
 static void
-start_keybind_repeat(struct server *server, struct keyboard *keyboard,
+start_keybind_repeat(struct keyboard *keyboard,
 		struct wlr_keyboard_key_event *event)
 {
 	struct wlr_keyboard *wlr_keyboard = keyboard->wlr_keyboard;
-	assert(!keyboard->keybind_repeat);
+	assert(!lab_timer_is_armed(&keyboard->keybind_repeat));
 
 	if (wlr_keyboard->repeat_info.rate > 0
 			&& wlr_keyboard->repeat_info.delay > 0) {
 		keyboard->keybind_repeat_keycode = event->keycode;
 		keyboard->keybind_repeat_rate = wlr_keyboard->repeat_info.rate;
-		keyboard->keybind_repeat = wl_event_loop_add_timer(
-			server->wl_event_loop, handle_keybind_repeat, keyboard);
-		wl_event_source_timer_update(keyboard->keybind_repeat,
+		lab_timer_arm(&keyboard->base.seat->timers,
+			&keyboard->keybind_repeat,
 			wlr_keyboard->repeat_info.delay);
 	}
 }
@@ -577,10 +675,7 @@ start_keybind_repeat(struct server *server, struct keyboard *keyboard,
 void
 keyboard_cancel_keybind_repeat(struct keyboard *keyboard)
 {
-	if (keyboard->keybind_repeat) {
-		wl_event_source_remove(keyboard->keybind_repeat);
-		keyboard->keybind_repeat = NULL;
-	}
+	lab_timer_disarm(&keyboard->keybind_repeat);
 }
 
 void
@@ -596,6 +691,17 @@ keyboard_cancel_all_keybind_repeats(struct seat *seat)
 	}
 }
 
+/* Output most likely to show the response to a key press */
+static struct output *
+keyboard_output(struct server *server)
+{
+	struct view *view = server->active_view;
+	if (view && output_is_usable(view->output)) {
+		return view->output;
+	}
+	return output_nearest_to_cursor(server);
+}
+
 static void
 keyboard_key_notify(struct wl_listener *listener, void *data)
 {
@@ -605,6 +711,10 @@ keyboard_key_notify(struct wl_listener *listener, void *data)
 	struct wlr_keyboard_key_event *event = data;
 	struct wlr_seat *wlr_seat = seat->seat;
 	idle_manager_notify_activity(seat->seat);
+	output_timing_input_event(keyboard_output(seat->server),
+		keyboard->base.wlr_input_device, event->time_msec);
+	input_record_key(event->time_msec, event->keycode, event->state);
+	metrics_input_event(LAB_METRICS_INPUT_KEY);
 
 	/* any new press/release cancels current keybind repeat */
 	keyboard_cancel_keybind_repeat(keyboard);
@@ -624,7 +734,7 @@ keyboard_key_notify(struct wl_listener *listener, void *data)
 		 */
 		if (!is_modifier(keyboard->wlr_keyboard, event->keycode)
 				&& event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
-			start_keybind_repeat(seat->server, keyboard, event);
+			start_keybind_repeat(keyboard, event);
 		}
 	} else if (!input_method_keyboard_grab_forward_key(keyboard, event)) {
 		wlr_seat_set_keyboard(wlr_seat, keyboard->wlr_keyboard);
@@ -709,18 +819,75 @@ reset_window_keyboard_layout_groups(struct server *server)
 	/*
 	 * Technically it would be possible to reconcile previous group indices
 	 * to new group ones if particular layouts exist in both old and new,
-	 * but let's keep it simple for now and just reset them all.
+	 * but let's keep it simple for now and just reset them all. Views
+	 * notice on activation, see view_set_activated().
 	 */
-	struct view *view;
-	for_each_view(view, &server->views, LAB_VIEW_CRITERIA_NONE) {
-		view->keyboard_layout = 0;
-	}
+	server->seat.keyboard_layout_generation++;
 
-	struct view *active_view = server->active_view;
-	if (!active_view) {
+	if (!server->active_view) {
 		return;
 	}
-	keyboard_update_layout(&server->seat, active_view->keyboard_layout);
+	keyboard_update_layout(&server->seat, 0);
+}
+
+static const char * const rmlvo_variables[] = {
+	"XKB_DEFAULT_RULES",
+	"XKB_DEFAULT_MODEL",
+	"XKB_DEFAULT_LAYOUT",
+	"XKB_DEFAULT_VARIANT",
+	"XKB_DEFAULT_OPTIONS",
+};
+
+/*
+ * The keymap compiled for the RMLVO names in the environment. Every
+ * keyboard is configured with the same names, so compiling the keymap
+ * once serves all of them until the environment changes.
+ */
+static struct {
+	struct xkb_context *context;
+	char *rmlvo[ARRAY_SIZE(rmlvo_variables)];
+	struct xkb_keymap *keymap;
+} keymap_cache;
+
+static void
+keymap_cache_clear(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(rmlvo_variables); i++) {
+		zfree(keymap_cache.rmlvo[i]);
+	}
+	xkb_keymap_unref(keymap_cache.keymap);
+	keymap_cache.keymap = NULL;
+}
+
+/* Returns a new reference to the keymap for the current environment */
+static struct xkb_keymap *
+keymap_from_environment(void)
+{
+	bool match = keymap_cache.keymap;
+	for (size_t i = 0; match && i < ARRAY_SIZE(rmlvo_variables); i++) {
+		match = str_equal(keymap_cache.rmlvo[i],
+			getenv(rmlvo_variables[i]));
+	}
+	if (match) {
+		return xkb_keymap_ref(keymap_cache.keymap);
+	}
+
+	keymap_cache_clear();
+	if (!keymap_cache.context) {
+		keymap_cache.context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+	}
+	struct xkb_rule_names rules = { 0 };
+	struct xkb_keymap *keymap = xkb_map_new_from_names(
+		keymap_cache.context, &rules, XKB_KEYMAP_COMPILE_NO_FLAGS);
+	if (!keymap) {
+		return NULL;
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(rmlvo_variables); i++) {
+		const char *value = getenv(rmlvo_variables[i]);
+		keymap_cache.rmlvo[i] = value ? xstrdup(value) : NULL;
+	}
+	keymap_cache.keymap = xkb_keymap_ref(keymap);
+	return keymap;
 }
 
 /*
@@ -732,10 +899,7 @@ set_layout(struct server *server, struct wlr_keyboard *kb)
 {
 	static bool fallback_mode;
 
-	struct xkb_rule_names rules = { 0 };
-	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-	struct xkb_keymap *keymap = xkb_map_new_from_names(context, &rules,
-		XKB_KEYMAP_COMPILE_NO_FLAGS);
+	struct xkb_keymap *keymap = keymap_from_environment();
 
 	/*
 	 * With XKB_DEFAULT_LAYOUT set to empty odd things happen with
@@ -760,7 +924,6 @@ set_layout(struct server *server, struct wlr_keyboard *kb)
 			set_layout(server, kb);
 		}
 	}
-	xkb_context_unref(context);
 }
 
 void
@@ -793,6 +956,9 @@ keyboard_setup_handlers(struct keyboard *keyboard)
 	wl_signal_add(&wlr_kb->events.key, &keyboard->key);
 	keyboard->modifier.notify = keyboard_modifiers_notify;
 	wl_signal_add(&wlr_kb->events.modifiers, &keyboard->modifier);
+
+	lab_timer_init(&keyboard->keybind_repeat, handle_keybind_repeat,
+		keyboard);
 }
 
 void
@@ -806,4 +972,7 @@ keyboard_group_finish(struct seat *seat)
 		wlr_keyboard_group_destroy(seat->keyboard_group);
 		seat->keyboard_group = NULL;
 	}
+	keymap_cache_clear();
+	xkb_context_unref(keymap_cache.context);
+	keymap_cache.context = NULL;
 }
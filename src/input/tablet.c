@@ -148,7 +148,7 @@ tablet_get_coords(struct drawing_tablet *tablet, double *x, double *y, double *d
 	double lx = -1, ly = -1;
 	switch (tablet->motion_mode) {
 	case LAB_TABLET_MOTION_ABSOLUTE:
-		wlr_cursor_absolute_to_layout_coords(tablet->seat->cursor,
+		input_absolute_to_layout_coords(tablet->seat,
 			tablet->wlr_input_device, *x, *y, &lx, &ly);
 		break;
 	case LAB_TABLET_MOTION_RELATIVE:
@@ -188,10 +188,14 @@ notify_motion(struct drawing_tablet *tablet, struct drawing_tablet_tool *tool,
 			tablet->tablet_v2, surface);
 	}
 
+	double lx, ly;
 	switch (tablet->motion_mode) {
 	case LAB_TABLET_MOTION_ABSOLUTE:
-		wlr_cursor_warp_absolute(tablet->seat->cursor,
-			tablet->wlr_input_device, x, y);
+		/* What wlr_cursor_warp_absolute() does, minus the mapping */
+		input_absolute_to_layout_coords(tablet->seat,
+			tablet->wlr_input_device, x, y, &lx, &ly);
+		wlr_cursor_warp_closest(tablet->seat->cursor,
+			tablet->wlr_input_device, lx, ly);
 		break;
 	case LAB_TABLET_MOTION_RELATIVE:
 		wlr_cursor_move(tablet->seat->cursor,
@@ -250,6 +254,10 @@ handle_tablet_tool_proximity(struct wl_listener *listener, void *data)
 		return;
 	}
 
+	/* Keep the order of axis and other events */
+	tablet_flush_axis(tablet);
+	cursor_unpredict(tablet);
+
 	idle_manager_notify_activity(tablet->seat->seat);
 	cursor_set_visible(tablet->seat, /* visible */ true);
 
@@ -257,6 +265,7 @@ handle_tablet_tool_proximity(struct wl_listener *listener, void *data)
 		tablet->motion_mode =
 			tool_motion_mode(rc.tablet_tool.motion, ev->tool);
 	}
+	tablet->prediction.valid = false;
 
 	/*
 	 * Reset relative coordinates, we don't want to move the
@@ -302,58 +311,63 @@ handle_tablet_tool_proximity(struct wl_listener *listener, void *data)
 
 static bool is_down_mouse_emulation = false;
 
+/*
+ * Move the cursor image ahead along the recent pen velocity. Only the
+ * image is moved: cursor_unpredict() restores the actual position before
+ * any other tablet event is processed.
+ */
 static void
-handle_tablet_tool_axis(struct wl_listener *listener, void *data)
+cursor_predict(struct drawing_tablet *tablet, uint32_t time_msec)
 {
-	struct wlr_tablet_tool_axis_event *ev = data;
-	struct drawing_tablet *tablet = ev->tablet->data;
-	struct drawing_tablet_tool *tool = ev->tool->data;
-	if (!tablet) {
-		wlr_log(WLR_DEBUG, "tool axis event before tablet create");
+	if (!rc.tablet_tool.motion_prediction
+			|| tablet->motion_mode != LAB_TABLET_MOTION_ABSOLUTE) {
 		return;
 	}
+	struct wlr_cursor *cursor = tablet->seat->cursor;
+	double lx = cursor->x;
+	double ly = cursor->y;
+
+	if (!tablet->prediction.valid) {
+		tablet->prediction.vx = 0.0;
+		tablet->prediction.vy = 0.0;
+	} else if (time_msec > tablet->prediction.time_msec) {
+		double dt = time_msec - tablet->prediction.time_msec;
+		/* Smooth the velocity so that sensor noise is not amplified */
+		tablet->prediction.vx = 0.5 * tablet->prediction.vx
+			+ 0.5 * (lx - tablet->prediction.lx) / dt;
+		tablet->prediction.vy = 0.5 * tablet->prediction.vy
+			+ 0.5 * (ly - tablet->prediction.ly) / dt;
+	}
+	tablet->prediction.valid = true;
+	tablet->prediction.lx = lx;
+	tablet->prediction.ly = ly;
+	tablet->prediction.time_msec = time_msec;
+
+	double horizon = rc.tablet_tool.motion_prediction;
+	wlr_cursor_warp_closest(cursor, NULL,
+		lx + tablet->prediction.vx * horizon,
+		ly + tablet->prediction.vy * horizon);
+	tablet->prediction.applied = true;
+}
 
-	idle_manager_notify_activity(tablet->seat->seat);
-	cursor_set_visible(tablet->seat, /* visible */ true);
+static void
+cursor_unpredict(struct drawing_tablet *tablet)
+{
+	if (!tablet->prediction.applied) {
+		return;
+	}
+	tablet->prediction.applied = false;
+	wlr_cursor_warp_closest(tablet->seat->cursor, NULL,
+		tablet->prediction.lx, tablet->prediction.ly);
+}
 
-	/*
-	 * Reset relative coordinates. If those axes aren't updated,
-	 * the delta is zero.
-	 */
-	tablet->dx = 0;
-	tablet->dy = 0;
-	tablet->tilt_x = 0;
-	tablet->tilt_y = 0;
+static void
+process_axis(struct drawing_tablet *tablet, struct wlr_tablet_tool *wlr_tool,
+		uint32_t updated_axes, uint32_t time_msec)
+{
+	struct drawing_tablet_tool *tool = wlr_tool->data;
 
-	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_X) {
-		tablet->x = ev->x;
-		tablet->dx = ev->dx;
-	}
-	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_Y) {
-		tablet->y = ev->y;
-		tablet->dy = ev->dy;
-	}
-	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_DISTANCE) {
-		tablet->distance = ev->distance;
-	}
-	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_PRESSURE) {
-		tablet->pressure = ev->pressure;
-	}
-	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_TILT_X) {
-		tablet->tilt_x = ev->tilt_x;
-	}
-	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_TILT_Y) {
-		tablet->tilt_y = ev->tilt_y;
-	}
-	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_ROTATION) {
-		tablet->rotation = ev->rotation;
-	}
-	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_SLIDER) {
-		tablet->slider = ev->slider;
-	}
-	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_WHEEL) {
-		tablet->wheel_delta = ev->wheel_delta;
-	}
+	cursor_unpredict(tablet);
 
 	double x, y, dx, dy;
 	struct wlr_surface *surface = tablet_get_coords(tablet, &x, &y, &dx, &dy);
@@ -373,18 +387,18 @@ handle_tablet_tool_axis(struct wl_listener *listener, void *data)
 			&& tablet->seat->server->input_mode == LAB_INPUT_STATE_PASSTHROUGH)
 			|| wlr_tablet_tool_v2_has_implicit_grab(tool->tool_v2))) {
 		/* motion seems to be supported by all tools */
-		notify_motion(tablet, tool, surface, x, y, dx, dy, ev->time_msec);
+		notify_motion(tablet, tool, surface, x, y, dx, dy, time_msec);
 
 		/* notify about other axis based on tool capabilities */
-		if (ev->tool->distance) {
+		if (wlr_tool->distance) {
 			wlr_tablet_v2_tablet_tool_notify_distance(tool->tool_v2,
 				tablet->distance);
 		}
-		if (ev->tool->pressure) {
+		if (wlr_tool->pressure) {
 			wlr_tablet_v2_tablet_tool_notify_pressure(tool->tool_v2,
 				tablet->pressure);
 		}
-		if (ev->tool->tilt) {
+		if (wlr_tool->tilt) {
 			/*
 			 * From https://gitlab.freedesktop.org/wayland/wayland-protocols/-/blob/main/stable/tablet/tablet-v2.xml
 			 * "Other extra axes are in physical units as specified in the protocol.
@@ -403,20 +417,20 @@ handle_tablet_tool_axis(struct wl_listener *listener, void *data)
 			wlr_tablet_v2_tablet_tool_notify_tilt(tool->tool_v2,
 				tilt_x, tilt_y);
 		}
-		if (ev->tool->rotation) {
+		if (wlr_tool->rotation) {
 			wlr_tablet_v2_tablet_tool_notify_rotation(tool->tool_v2,
 				tablet->rotation);
 		}
-		if (ev->tool->slider) {
+		if (wlr_tool->slider) {
 			wlr_tablet_v2_tablet_tool_notify_slider(tool->tool_v2,
 				tablet->slider);
 		}
-		if (ev->tool->wheel) {
+		if (wlr_tool->wheel) {
 			wlr_tablet_v2_tablet_tool_notify_wheel(tool->tool_v2,
 				tablet->wheel_delta, 0);
 		}
 	} else {
-		if (ev->updated_axes & (WLR_TABLET_TOOL_AXIS_X | WLR_TABLET_TOOL_AXIS_Y)) {
+		if (updated_axes & (WLR_TABLET_TOOL_AXIS_X | WLR_TABLET_TOOL_AXIS_Y)) {
 			if (tool && tool->tool_v2->focused_surface) {
 				wlr_tablet_v2_tablet_tool_notify_proximity_out(
 					tool->tool_v2);
@@ -425,17 +439,128 @@ handle_tablet_tool_axis(struct wl_listener *listener, void *data)
 			switch (tablet->motion_mode) {
 			case LAB_TABLET_MOTION_ABSOLUTE:
 				cursor_emulate_move_absolute(tablet->seat,
-					&ev->tablet->base,
-					x, y, ev->time_msec);
+					&tablet->tablet->base,
+					x, y, time_msec);
 				break;
 			case LAB_TABLET_MOTION_RELATIVE:
 				cursor_emulate_move(tablet->seat,
-					&ev->tablet->base,
-					dx, dy, ev->time_msec);
+					&tablet->tablet->base,
+					dx, dy, time_msec);
 				break;
 			}
 		}
 	}
+
+	cursor_predict(tablet, time_msec);
+}
+
+/* Process axis events merged since the last flush */
+static void
+tablet_flush_axis(struct drawing_tablet *tablet)
+{
+	if (tablet->pending.idle) {
+		wl_event_source_remove(tablet->pending.idle);
+		tablet->pending.idle = NULL;
+	}
+	if (!tablet->pending.active) {
+		return;
+	}
+	tablet->pending.active = false;
+	process_axis(tablet, tablet->pending.tool,
+		tablet->pending.updated_axes, tablet->pending.time_msec);
+}
+
+static void
+handle_flush_idle(void *data)
+{
+	struct drawing_tablet *tablet = data;
+	tablet->pending.idle = NULL;
+	tablet_flush_axis(tablet);
+}
+
+static void
+handle_tablet_tool_axis(struct wl_listener *listener, void *data)
+{
+	struct wlr_tablet_tool_axis_event *ev = data;
+	struct drawing_tablet *tablet = ev->tablet->data;
+	if (!tablet) {
+		wlr_log(WLR_DEBUG, "tool axis event before tablet create");
+		return;
+	}
+
+	idle_manager_notify_activity(tablet->seat->seat);
+	cursor_set_visible(tablet->seat, /* visible */ true);
+
+	/* Events of different tools are not merged */
+	if (tablet->pending.active && tablet->pending.tool != ev->tool) {
+		tablet_flush_axis(tablet);
+	}
+
+	if (!tablet->pending.active) {
+		/*
+		 * Reset relative coordinates. If those axes aren't updated,
+		 * the delta is zero.
+		 */
+		tablet->dx = 0;
+		tablet->dy = 0;
+		tablet->tilt_x = 0;
+		tablet->tilt_y = 0;
+		tablet->pending.updated_axes = 0;
+	}
+
+	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_X) {
+		tablet->x = ev->x;
+		tablet->dx += ev->dx;
+	}
+	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_Y) {
+		tablet->y = ev->y;
+		tablet->dy += ev->dy;
+	}
+	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_DISTANCE) {
+		tablet->distance = ev->distance;
+	}
+	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_PRESSURE) {
+		tablet->pressure = ev->pressure;
+	}
+	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_TILT_X) {
+		tablet->tilt_x = ev->tilt_x;
+	}
+	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_TILT_Y) {
+		tablet->tilt_y = ev->tilt_y;
+	}
+	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_ROTATION) {
+		tablet->rotation = ev->rotation;
+	}
+	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_SLIDER) {
+		tablet->slider = ev->slider;
+	}
+	if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_WHEEL) {
+		if (tablet->pending.updated_axes & WLR_TABLET_TOOL_AXIS_WHEEL) {
+			tablet->wheel_delta += ev->wheel_delta;
+		} else {
+			tablet->wheel_delta = ev->wheel_delta;
+		}
+	}
+
+	tablet->pending.active = true;
+	tablet->pending.updated_axes |= ev->updated_axes;
+	tablet->pending.time_msec = ev->time_msec;
+	tablet->pending.tool = ev->tool;
+
+	if (!rc.tablet_tool.coalesce_motion) {
+		tablet_flush_axis(tablet);
+		return;
+	}
+
+	/*
+	 * Merge all axis events of the current event loop iteration. The
+	 * tablet protocol frame is sent per iteration as well.
+	 */
+	if (!tablet->pending.idle) {
+		tablet->pending.idle = wl_event_loop_add_idle(
+			tablet->seat->server->wl_event_loop,
+			handle_flush_idle, tablet);
+	}
 }
 
 static uint32_t
@@ -471,6 +596,10 @@ handle_tablet_tool_tip(struct wl_listener *listener, void *data)
 		return;
 	}
 
+	/* Keep the order of axis and other events */
+	tablet_flush_axis(tablet);
+	cursor_unpredict(tablet);
+
 	idle_manager_notify_activity(tablet->seat->seat);
 	cursor_set_visible(tablet->seat, /* visible */ true);
 
@@ -551,6 +680,10 @@ handle_tablet_tool_button(struct wl_listener *listener, void *data)
 		return;
 	}
 
+	/* Keep the order of axis and other events */
+	tablet_flush_axis(tablet);
+	cursor_unpredict(tablet);
+
 	idle_manager_notify_activity(tablet->seat->seat);
 	cursor_set_visible(tablet->seat, /* visible */ true);
 
@@ -614,6 +747,9 @@ handle_destroy(struct wl_listener *listener, void *data)
 
 	wl_list_remove(&tablet->link);
 	tablet_pad_attach_tablet(tablet->seat);
+	if (tablet->pending.idle) {
+		wl_event_source_remove(tablet->pending.idle);
+	}
 
 	wl_list_remove(&tablet->handlers.destroy.link);
 	free(tablet);
@@ -1,7 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#include <linux/input-event-codes.h>
 #include <wayland-util.h>
 #include <wlr/types/wlr_touch.h>
-#include <linux/input-event-codes.h>
+#include <wlr/util/log.h>
 #include "common/macros.h"
 #include "common/mem.h"
 #include "common/scene-helpers.h"
@@ -11,15 +12,34 @@
 #include "config/mousebind.h"
 #include "action.h"
 
+/* Touch points beyond this are ignored */
+#define TOUCH_POINTS_MAX 32
+
 /* Holds layout -> surface offsets to report motion events in relative coords */
 struct touch_point {
 	int32_t touch_id;
-	uint32_t x_offset;
-	uint32_t y_offset;
+	double x_offset;
+	double y_offset;
 	struct wlr_surface *surface;
-	struct wl_list link; /* seat.touch_points */
+
+	/* Latest motion since the last frame, sent in handle_touch_frame() */
+	bool motion_pending;
+	struct wlr_touch *touch;
+	double x, y;
+	uint32_t time_msec;
 };
 
+static struct touch_point *
+touch_point_find(struct seat *seat, int32_t touch_id)
+{
+	for (int i = 0; i < seat->nr_touch_points; i++) {
+		if (seat->touch_points[i].touch_id == touch_id) {
+			return &seat->touch_points[i];
+		}
+	}
+	return NULL;
+}
+
 static struct wlr_surface*
 touch_get_coords(struct seat *seat, struct wlr_touch *touch, double x, double y,
 		double *x_offset, double *y_offset)
@@ -37,8 +57,7 @@ touch_get_coords(struct seat *seat, struct wlr_touch *touch, double x, double y,
 
 	/* Convert coordinates: first [0, 1] => layout, then layout => surface */
 	double lx, ly;
-	wlr_cursor_absolute_to_layout_coords(seat->cursor, &touch->base,
-		x, y, &lx, &ly);
+	input_absolute_to_layout_coords(seat, &touch->base, x, y, &lx, &ly);
 
 	double sx, sy;
 	struct wlr_scene_node *node =
@@ -56,6 +75,40 @@ touch_get_coords(struct seat *seat, struct wlr_touch *touch, double x, double y,
 	return surface;
 }
 
+static void
+touch_point_send_motion(struct seat *seat, struct touch_point *touch_point)
+{
+	if (!touch_point->motion_pending) {
+		return;
+	}
+	touch_point->motion_pending = false;
+
+	struct wlr_touch *touch = touch_point->touch;
+	if (touch_point->surface) {
+		/* Convert coordinates: first [0, 1] => layout */
+		double lx, ly;
+		input_absolute_to_layout_coords(seat, &touch->base,
+			touch_point->x, touch_point->y, &lx, &ly);
+
+		/* Apply offsets to get surface coords before reporting event */
+		double sx = lx - touch_point->x_offset;
+		double sy = ly - touch_point->y_offset;
+
+		if (seat->nr_touch_points == 1) {
+			wlr_cursor_warp_absolute(seat->cursor, &touch->base,
+				touch_point->x, touch_point->y);
+		}
+		wlr_seat_touch_notify_motion(seat->seat, touch_point->time_msec,
+			touch_point->touch_id, sx, sy);
+	} else {
+		if (seat->nr_touch_points == 1) {
+			cursor_emulate_move_absolute(seat, &touch->base,
+				touch_point->x, touch_point->y,
+				touch_point->time_msec);
+		}
+	}
+}
+
 static void
 handle_touch_motion(struct wl_listener *listener, void *data)
 {
@@ -64,36 +117,18 @@ handle_touch_motion(struct wl_listener *listener, void *data)
 
 	idle_manager_notify_activity(seat->seat);
 
-	int touch_point_count = wl_list_length(&seat->touch_points);
-
-	/* Find existing touch point to determine initial offsets to subtract */
-	struct touch_point *touch_point;
-	wl_list_for_each(touch_point, &seat->touch_points, link) {
-		if (touch_point->touch_id == event->touch_id) {
-			if (touch_point->surface) {
-				/* Convert coordinates: first [0, 1] => layout */
-				double lx, ly;
-				wlr_cursor_absolute_to_layout_coords(seat->cursor,
-					&event->touch->base, event->x, event->y, &lx, &ly);
-
-				/* Apply offsets to get surface coords before reporting event */
-				double sx = lx - touch_point->x_offset;
-				double sy = ly - touch_point->y_offset;
-
-				if (touch_point_count == 1) {
-					wlr_cursor_warp_absolute(seat->cursor, &event->touch->base,
-						event->x, event->y);
-				}
-				wlr_seat_touch_notify_motion(seat->seat, event->time_msec,
-					event->touch_id, sx, sy);
-			} else {
-				if (touch_point_count == 1) {
-					cursor_emulate_move_absolute(seat, &event->touch->base,
-						event->x, event->y, event->time_msec);
-				}
-			}
-			return;
-		}
+	/*
+	 * Only remember the latest position. Motion is sent once per
+	 * touch point and frame in handle_touch_frame().
+	 */
+	struct touch_point *touch_point =
+		touch_point_find(seat, event->touch_id);
+	if (touch_point) {
+		touch_point->motion_pending = true;
+		touch_point->touch = event->touch;
+		touch_point->x = event->x;
+		touch_point->y = event->y;
+		touch_point->time_msec = event->time_msec;
 	}
 }
 
@@ -102,6 +137,9 @@ handle_touch_frame(struct wl_listener *listener, void *data)
 {
 	struct seat *seat = wl_container_of(listener, seat, touch_frame);
 
+	for (int i = 0; i < seat->nr_touch_points; i++) {
+		touch_point_send_motion(seat, &seat->touch_points[i]);
+	}
 	wlr_seat_touch_notify_frame(seat->seat);
 }
 
@@ -113,36 +151,43 @@ handle_touch_down(struct wl_listener *listener, void *data)
 
 	idle_manager_notify_activity(seat->seat);
 
+	if (seat->nr_touch_points == TOUCH_POINTS_MAX
+			|| touch_point_find(seat, event->touch_id)) {
+		wlr_log(WLR_DEBUG, "ignoring touch point %d", event->touch_id);
+		return;
+	}
+
 	/* Compute layout => surface offset and save for this touch point */
-	struct touch_point *touch_point = znew(*touch_point);
+	struct touch_point *touch_point =
+		&seat->touch_points[seat->nr_touch_points++];
+	*touch_point = (struct touch_point){0};
 	double x_offset = 0.0, y_offset = 0.0;
 	touch_point->surface = touch_get_coords(seat, event->touch,
 			event->x, event->y, &x_offset, &y_offset);
 	touch_point->touch_id = event->touch_id;
 	touch_point->x_offset = x_offset;
 	touch_point->y_offset = y_offset;
-
-	wl_list_insert(&seat->touch_points, &touch_point->link);
-	int touch_point_count = wl_list_length(&seat->touch_points);
+	int touch_point_count = seat->nr_touch_points;
 
 	/* hide the cursor when starting touch input */
 	cursor_set_visible(seat, /* visible */ false);
 
 	if (touch_point->surface) {
-		seat_pointer_end_grab(seat, touch_point->surface);
+		struct wlr_surface *surface = touch_point->surface;
+		seat_pointer_end_grab(seat, surface);
 		/* Clear focus to not interfere with touch input */
 		wlr_seat_pointer_notify_clear_focus(seat->seat);
 
 		/* Convert coordinates: first [0, 1] => layout */
 		double lx, ly;
-		wlr_cursor_absolute_to_layout_coords(seat->cursor,
-			&event->touch->base, event->x, event->y, &lx, &ly);
+		input_absolute_to_layout_coords(seat, &event->touch->base,
+			event->x, event->y, &lx, &ly);
 
 		/* Apply offsets to get surface coords before reporting event */
 		double sx = lx - x_offset;
 		double sy = ly - y_offset;
 
-		struct view *view = view_from_wlr_surface(touch_point->surface);
+		struct view *view = view_from_wlr_surface(surface);
 		struct mousebind *mousebind;
 		wl_list_for_each(mousebind, &rc.mousebinds, link) {
 			if (mousebind->mouse_event == MOUSE_ACTION_PRESS
@@ -156,7 +201,7 @@ handle_touch_down(struct wl_listener *listener, void *data)
 			wlr_cursor_warp_absolute(seat->cursor, &event->touch->base,
 				event->x, event->y);
 		}
-		wlr_seat_touch_notify_down(seat->seat, touch_point->surface,
+		wlr_seat_touch_notify_down(seat->seat, surface,
 			event->time_msec, event->touch_id, sx, sy);
 	} else {
 		if (touch_point_count == 1) {
@@ -176,27 +221,31 @@ handle_touch_up(struct wl_listener *listener, void *data)
 
 	idle_manager_notify_activity(seat->seat);
 
-	/* Remove the touch point from the seat */
-	struct touch_point *touch_point, *tmp;
-	wl_list_for_each_safe(touch_point, tmp, &seat->touch_points, link) {
-		if (touch_point->touch_id == event->touch_id) {
-			if (touch_point->surface) {
-				wlr_seat_touch_notify_up(seat->seat, event->time_msec,
-					event->touch_id);
-			} else {
-				cursor_emulate_button(seat, BTN_LEFT,
-					WL_POINTER_BUTTON_STATE_RELEASED, event->time_msec);
-			}
-			wl_list_remove(&touch_point->link);
-			zfree(touch_point);
-			break;
-		}
+	struct touch_point *touch_point =
+		touch_point_find(seat, event->touch_id);
+	if (!touch_point) {
+		return;
 	}
+
+	/* Motion within the same frame happened before the up event */
+	touch_point_send_motion(seat, touch_point);
+	if (touch_point->surface) {
+		wlr_seat_touch_notify_up(seat->seat, event->time_msec,
+			event->touch_id);
+	} else {
+		cursor_emulate_button(seat, BTN_LEFT,
+			WL_POINTER_BUTTON_STATE_RELEASED, event->time_msec);
+	}
+
+	/* Remove the touch point from the seat, keeping the array dense */
+	*touch_point = seat->touch_points[--seat->nr_touch_points];
 }
 
 void
 touch_init(struct seat *seat)
 {
+	seat->touch_points = znew_n(*seat->touch_points, TOUCH_POINTS_MAX);
+	seat->nr_touch_points = 0;
 	CONNECT_SIGNAL(seat->cursor, seat, touch_down);
 	CONNECT_SIGNAL(seat->cursor, seat, touch_up);
 	CONNECT_SIGNAL(seat->cursor, seat, touch_motion);
@@ -210,4 +259,6 @@ touch_finish(struct seat *seat)
 	wl_list_remove(&seat->touch_up.link);
 	wl_list_remove(&seat->touch_motion.link);
 	wl_list_remove(&seat->touch_frame.link);
+	zfree(seat->touch_points);
+	seat->nr_touch_points = 0;
 }
@@ -16,13 +16,18 @@
 #include <wlr/util/log.h>
 #include "common/macros.h"
 #include "common/mem.h"
+#include "common/slab.h"
 #include "config/rcxml.h"
+#include "config/session.h"
 #include "layers.h"
 #include "labwc.h"
 #include "node.h"
+#include "trace.h"
 
 #define LAB_LAYERSHELL_VERSION 4
 
+static struct lab_slab popup_slab = LAB_SLAB_INIT(struct lab_layer_popup);
+
 static void
 apply_override(struct output *output, struct wlr_box *usable_area)
 {
@@ -38,6 +43,52 @@ apply_override(struct output *output, struct wlr_box *usable_area)
 	}
 }
 
+static bool
+same_arrange_state(const struct wlr_layer_surface_v1_state *a,
+		const struct wlr_layer_surface_v1_state *b)
+{
+	return a->anchor == b->anchor
+		&& a->exclusive_zone == b->exclusive_zone
+		&& a->exclusive_edge == b->exclusive_edge
+		&& a->margin.top == b->margin.top
+		&& a->margin.right == b->margin.right
+		&& a->margin.bottom == b->margin.bottom
+		&& a->margin.left == b->margin.left
+		&& a->desired_width == b->desired_width
+		&& a->desired_height == b->desired_height;
+}
+
+static void
+arrange_surface(struct lab_layer_surface *surface,
+		const struct wlr_box *full_area, struct wlr_box *usable_area)
+{
+	struct wlr_scene_layer_surface_v1 *scene = surface->scene_layer_surface;
+	const struct wlr_layer_surface_v1_state *state =
+		&scene->layer_surface->current;
+
+	/*
+	 * The position, the configured size and the space reserved by
+	 * the surface only depend on these, so the result of the last
+	 * configure still applies. This keeps panels which commit new
+	 * content all the time from being sent configures.
+	 */
+	if (surface->arranged.valid
+			&& same_arrange_state(&surface->arranged.state, state)
+			&& wlr_box_equal(&surface->arranged.full_area, full_area)
+			&& wlr_box_equal(&surface->arranged.usable_area_before,
+				usable_area)) {
+		*usable_area = surface->arranged.usable_area_after;
+		return;
+	}
+
+	surface->arranged.state = *state;
+	surface->arranged.full_area = *full_area;
+	surface->arranged.usable_area_before = *usable_area;
+	wlr_scene_layer_surface_v1_configure(scene, full_area, usable_area);
+	surface->arranged.usable_area_after = *usable_area;
+	surface->arranged.valid = true;
+}
+
 static void
 arrange_one_layer(const struct wlr_box *full_area, struct wlr_box *usable_area,
 		struct wlr_scene_tree *tree, bool exclusive)
@@ -52,7 +103,7 @@ arrange_one_layer(const struct wlr_box *full_area, struct wlr_box *usable_area,
 		if (!!scene->layer_surface->current.exclusive_zone != exclusive) {
 			continue;
 		}
-		wlr_scene_layer_surface_v1_configure(scene, full_area, usable_area);
+		arrange_surface(surface, full_area, usable_area);
 	}
 }
 
@@ -64,7 +115,10 @@ arrange_one_layer(const struct wlr_box *full_area, struct wlr_box *usable_area,
 void
 layers_arrange(struct output *output)
 {
+	TRACE_FUNC();
 	assert(output);
+	lab_change_journal_record(&output->server->scene_journal,
+		LAB_SCENE_CHANGE_LAYERS);
 	struct wlr_box full_area = { 0 };
 	wlr_output_effective_resolution(output->wlr_output,
 		&full_area.width, &full_area.height);
@@ -242,6 +296,14 @@ is_on_demand(struct wlr_layer_surface_v1 *layer_surface)
 		ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_ON_DEMAND;
 }
 
+/* Committed state which affects the arrangement of layer surfaces */
+#define LAYER_ARRANGE_STATE (WLR_LAYER_SURFACE_V1_STATE_DESIRED_SIZE \
+	| WLR_LAYER_SURFACE_V1_STATE_ANCHOR \
+	| WLR_LAYER_SURFACE_V1_STATE_EXCLUSIVE_ZONE \
+	| WLR_LAYER_SURFACE_V1_STATE_MARGIN \
+	| WLR_LAYER_SURFACE_V1_STATE_LAYER \
+	| WLR_LAYER_SURFACE_V1_STATE_EXCLUSIVE_EDGE)
+
 static void
 handle_surface_commit(struct wl_listener *listener, void *data)
 {
@@ -259,6 +321,11 @@ handle_surface_commit(struct wl_listener *listener, void *data)
 	uint32_t committed = layer_surface->current.committed;
 	struct output *output = (struct output *)wlr_output->data;
 
+	if (layer_surface->initial_commit) {
+		/* A (re-)mapping surface has to be sent a configure */
+		layer->arranged.valid = false;
+	}
+
 	/* Process layer change */
 	if (committed & WLR_LAYER_SURFACE_V1_STATE_LAYER) {
 		wlr_scene_node_reparent(&layer->scene_layer_surface->tree->node,
@@ -289,14 +356,22 @@ handle_surface_commit(struct wl_listener *listener, void *data)
 	}
 out:
 
-	if (committed || layer->mapped != layer_surface->surface->mapped) {
+	if (layer->mapped != layer_surface->surface->mapped
+			|| layer_surface->initial_commit) {
+		/* Map state changes and initial configures are not deferred */
 		layer->mapped = layer_surface->surface->mapped;
 		output_update_usable_area(output);
 		/*
 		 * Update cursor focus here to ensure we
 		 * enter a new/moved/resized layer surface.
 		 */
-		cursor_update_focus(layer->server);
+		cursor_schedule_focus_update(layer->server);
+	} else if (committed & LAYER_ARRANGE_STATE) {
+		/*
+		 * Clients animating their size or exclusive zone commit
+		 * new state for every frame, arrange once per output frame
+		 */
+		output_schedule_usable_area_update(output);
 	}
 }
 
@@ -326,6 +401,7 @@ handle_unmap(struct wl_listener *listener, void *data)
 	struct lab_layer_surface *layer = wl_container_of(listener, layer, unmap);
 	struct wlr_layer_surface_v1 *layer_surface =
 		layer->scene_layer_surface->layer_surface;
+	layer->arranged.valid = false;
 	if (layer_surface->output) {
 		output_update_usable_area(layer_surface->output->data);
 	}
@@ -354,6 +430,11 @@ handle_map(struct wl_listener *listener, void *data)
 
 	struct seat *seat = &layer->server->seat;
 	layer_try_set_focus(seat, layer->scene_layer_surface->layer_surface);
+
+	/* A surface which reserves an exclusive zone is taken as a panel */
+	if (layer->scene_layer_surface->layer_surface->current.exclusive_zone > 0) {
+		session_autostart_stage(LAB_AUTOSTART_AFTER_PANEL);
+	}
 }
 
 static void
@@ -372,7 +453,7 @@ popup_handle_destroy(struct wl_listener *listener, void *data)
 
 	cursor_update_focus(popup->server);
 
-	free(popup);
+	lab_slab_free(&popup_slab, popup);
 }
 
 static void
@@ -406,13 +487,13 @@ static struct lab_layer_popup *
 create_popup(struct server *server, struct wlr_xdg_popup *wlr_popup,
 		struct wlr_scene_tree *parent)
 {
-	struct lab_layer_popup *popup = znew(*popup);
+	struct lab_layer_popup *popup = lab_slab_new(&popup_slab, *popup);
 	popup->server = server;
 	popup->wlr_popup = wlr_popup;
 	popup->scene_tree =
 		wlr_scene_xdg_surface_create(parent, wlr_popup->base);
 	if (!popup->scene_tree) {
-		free(popup);
+		lab_slab_free(&popup_slab, popup);
 		return NULL;
 	}
 
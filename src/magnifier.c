@@ -1,10 +1,12 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 #include <assert.h>
+#include <math.h>
 #include <wlr/render/swapchain.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/transform.h>
 #include "common/box.h"
+#include "common/macros.h"
 #include "labwc.h"
 #include "magnifier.h"
 #include "theme.h"
@@ -79,9 +81,36 @@ magnifier_draw(struct output *output, struct wlr_buffer *output_buffer, struct w
 		box_logical_to_physical(&mag_box, output->wlr_output);
 	}
 
+	/*
+	 * Source region in physical output coordinates. Only this region is
+	 * copied into the temporary buffer, which is mag_scale^2 times less
+	 * work than copying the whole magnifier area.
+	 */
+	struct wlr_fbox src = {
+		.width = mag_box.width / mag_scale,
+		.height = mag_box.height / mag_scale,
+	};
+	if (fullscreen) {
+		src.x = cursor_pos.x - (cursor_pos.x / mag_scale);
+		src.y = cursor_pos.y - (cursor_pos.y / mag_scale);
+	} else {
+		src.x = mag_box.x
+			+ mag_box.width * (mag_scale - 1.0) / (2.0 * mag_scale);
+		src.y = mag_box.y
+			+ mag_box.height * (mag_scale - 1.0) / (2.0 * mag_scale);
+	}
+
+	/* Pixel-aligned region covering the source region */
+	struct wlr_box copy_box = {
+		.x = floor(src.x),
+		.y = floor(src.y),
+	};
+	copy_box.width = MAX(1, (int)ceil(src.x + src.width) - copy_box.x);
+	copy_box.height = MAX(1, (int)ceil(src.y + src.height) - copy_box.y);
+
 	/* (Re)create the temporary buffer if required */
-	if (tmp_buffer && (tmp_buffer->width != mag_box.width
-			|| tmp_buffer->height != mag_box.height)) {
+	if (tmp_buffer && (tmp_buffer->width != copy_box.width
+			|| tmp_buffer->height != copy_box.height)) {
 		wlr_log(WLR_DEBUG, "tmp magnifier buffer size changed, dropping");
 		assert(tmp_texture);
 		wlr_texture_destroy(tmp_texture);
@@ -91,7 +120,7 @@ magnifier_draw(struct output *output, struct wlr_buffer *output_buffer, struct w
 	}
 	if (!tmp_buffer) {
 		tmp_buffer = wlr_allocator_create_buffer(
-			server->allocator, mag_box.width, mag_box.height,
+			server->allocator, copy_box.width, copy_box.height,
 			&output->wlr_output->swapchain->format);
 	}
 	if (!tmp_buffer) {
@@ -125,11 +154,11 @@ magnifier_draw(struct output *output, struct wlr_buffer *output_buffer, struct w
 	}
 
 	struct wlr_box src_box_for_copy;
-	wlr_box_intersection(&src_box_for_copy, &mag_box, &output_box);
+	wlr_box_intersection(&src_box_for_copy, &copy_box, &output_box);
 
 	struct wlr_box dst_box_for_copy = src_box_for_copy;
-	dst_box_for_copy.x -= mag_box.x;
-	dst_box_for_copy.y -= mag_box.y;
+	dst_box_for_copy.x -= copy_box.x;
+	dst_box_for_copy.y -= copy_box.y;
 
 	struct wlr_render_texture_options opts = {
 		.texture = output_texture,
@@ -180,27 +209,19 @@ magnifier_draw(struct output *output, struct wlr_buffer *output_buffer, struct w
 	}
 
 	struct wlr_fbox src_box_for_paste = {
-		.width = mag_box.width / mag_scale,
-		.height = mag_box.height / mag_scale,
+		.x = src.x - copy_box.x,
+		.y = src.y - copy_box.y,
+		.width = src.width,
+		.height = src.height,
 	};
 
-	if (fullscreen) {
-		src_box_for_paste.x = cursor_pos.x - (cursor_pos.x / mag_scale);
-		src_box_for_paste.y = cursor_pos.y - (cursor_pos.y / mag_scale);
-	} else {
-		src_box_for_paste.x =
-			mag_box.width * (mag_scale - 1.0) / (2.0 * mag_scale);
-		src_box_for_paste.y =
-			mag_box.height * (mag_scale - 1.0) / (2.0 * mag_scale);
-	}
-
 	/* Paste the magnified result back into the output buffer */
 	opts = (struct wlr_render_texture_options) {
 		.texture = tmp_texture,
 		.src_box = src_box_for_paste,
 		.dst_box = mag_box,
-		.filter_mode = rc.mag_filter ? WLR_SCALE_FILTER_BILINEAR
-			: WLR_SCALE_FILTER_NEAREST,
+		.filter_mode = rc.mag_filter == LAB_MAG_FILTER_NEAREST
+			? WLR_SCALE_FILTER_NEAREST : WLR_SCALE_FILTER_BILINEAR,
 	};
 	wlr_render_pass_add_texture(tmp_render_pass, &opts);
 	if (!wlr_render_pass_submit(tmp_render_pass)) {
@@ -217,20 +238,40 @@ cleanup:
 bool
 output_wants_magnification(struct output *output)
 {
-	static double x = -1;
-	static double y = -1;
-	struct wlr_cursor *cursor = output->server->seat.cursor;
-	if (!magnify_on) {
-		x = -1;
-		y = -1;
-		return false;
+	bool dirty = output->magnifier_dirty;
+	output->magnifier_dirty = false;
+	return dirty;
+}
+
+/*
+ * Mark the output under the cursor and any output still showing the
+ * magnifier from a previous frame as needing a redraw. Scene damage
+ * within the magnified area is handled by the regular damage tracking,
+ * so nothing is rendered while the magnified desktop is idle.
+ */
+static void
+mark_dirty(struct server *server)
+{
+	struct output *cursor_output =
+		magnify_on ? output_nearest_to_cursor(server) : NULL;
+
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output != cursor_output
+				&& wlr_box_empty(&output->magnifier_box)) {
+			continue;
+		}
+		output->magnifier_dirty = true;
+		wlr_output_schedule_frame(output->wlr_output);
 	}
-	if (cursor->x == x && cursor->y == y) {
-		return false;
+}
+
+void
+magnifier_handle_cursor_motion(struct server *server)
+{
+	if (magnify_on) {
+		mark_dirty(server);
 	}
-	x = cursor->x;
-	y = cursor->y;
-	return output_nearest_to_cursor(output->server) == output;
 }
 
 static void
@@ -246,19 +287,13 @@ void
 magnifier_toggle(struct server *server)
 {
 	enable_magnifier(server, !magnify_on);
-
-	struct output *output = output_nearest_to_cursor(server);
-	if (output) {
-		wlr_output_schedule_frame(output->wlr_output);
-	}
+	mark_dirty(server);
 }
 
 /* Increases and decreases magnification scale */
 void
 magnifier_set_scale(struct server *server, enum magnify_dir dir)
 {
-	struct output *output = output_nearest_to_cursor(server);
-
 	if (dir == MAGNIFY_INCREASE) {
 		if (magnify_on) {
 			mag_scale += rc.mag_increment;
@@ -274,9 +309,7 @@ magnifier_set_scale(struct server *server, enum magnify_dir dir)
 		}
 	}
 
-	if (output) {
-		wlr_output_schedule_frame(output->wlr_output);
-	}
+	mark_dirty(server);
 }
 
 /* Reset any buffers held by the magnifier */
@@ -3,15 +3,19 @@
 #include <pango/pangocairo.h>
 #include <signal.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include "buffer.h"
 #include "common/dir.h"
 #include "common/fd-util.h"
 #include "common/font.h"
 #include "common/mem.h"
+#include "common/sched-util.h"
 #include "common/spawn.h"
 #include "config/session.h"
 #include "labwc.h"
 #include "theme.h"
+#include "trace.h"
 
 struct rcxml rc = { 0 };
 
@@ -105,6 +109,36 @@ send_signal_to_labwc_pid(int signal)
 	kill(pid, signal);
 }
 
+/* Start-up phases are timed with CLOCK_MONOTONIC and logged at info level */
+static struct timespec startup_begin, startup_phase_begin;
+
+static double
+msec_between(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e3
+		+ (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void
+startup_phase_done(const char *phase)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	wlr_log(WLR_INFO, "startup: %s took %.1f ms (%.1f ms total)", phase,
+		msec_between(&startup_phase_begin, &now),
+		msec_between(&startup_begin, &now));
+	startup_phase_begin = now;
+}
+
+static void
+handle_primary_client_exit(pid_t pid, const siginfo_t *info, void *data)
+{
+	struct server *server = data;
+	wlr_log(WLR_INFO, "primary client %ld exited (code %d, status %d)",
+		(long)pid, info->si_code, info->si_status);
+	wl_display_terminate(server->wl_display);
+}
+
 struct idle_ctx {
 	struct server *server;
 	const char *primary_client;
@@ -117,6 +151,8 @@ idle_callback(void *data)
 	/* Idle callbacks destroy automatically once triggered */
 	struct idle_ctx *ctx = data;
 
+	startup_phase_done("event loop start");
+
 	/* Start session-manager if one is specified by -S|--session */
 	if (ctx->primary_client) {
 		ctx->server->primary_client_pid = spawn_primary_client(ctx->primary_client);
@@ -126,6 +162,10 @@ idle_callback(void *data)
 			wl_display_terminate(ctx->server->wl_display);
 			return;
 		}
+		/* Falls back to the SIGCHLD handler without pidfd support */
+		spawn_watch_child(ctx->server->wl_event_loop,
+			ctx->server->primary_client_pid,
+			handle_primary_client_exit, ctx->server);
 	}
 
 	session_autostart_init(ctx->server);
@@ -189,11 +229,15 @@ main(int argc, char *argv[])
 	}
 
 	wlr_log_init(verbosity, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &startup_begin);
+	startup_phase_begin = startup_begin;
 
 	die_on_detecting_suid();
 	die_on_no_fonts();
+	startup_phase_done("font check");
 
 	session_environment_init();
+	startup_phase_done("session environment");
 
 #if HAVE_NLS
 	/* Initialize locale after setting env vars */
@@ -203,6 +247,7 @@ main(int argc, char *argv[])
 #endif
 
 	rcxml_read(rc.config_file);
+	startup_phase_done("config");
 
 	/*
 	 * Set environment variable LABWC_PID to the pid of the compositor
@@ -231,14 +276,31 @@ main(int argc, char *argv[])
 
 	increase_nofile_limit();
 
+	/* Before server_init(), so that the threads it starts are pinned */
+	set_scheduling(rc.sched_policy, rc.sched_priority, rc.nice);
+	if (lab_bitset_count(&rc.cpu_affinity)) {
+		pin_cpu_affinity(&rc.cpu_affinity);
+	}
+
 	struct server server = { 0 };
 	server_init(&server);
+	startup_phase_done("server init");
 	server_start(&server);
+	startup_phase_done("server start");
 
 	struct theme theme = { 0 };
 	theme_init(&theme, &server, rc.theme_name);
 	rc.theme = &theme;
 	server.theme = &theme;
+	/* Snapping overlays are only repositioned from now on */
+	overlay_reconfigure(&server.seat);
+	startup_phase_done("theme");
+
+	/* Once the renderer, fonts and theme have been loaded */
+	if (rc.lock_memory) {
+		lock_memory();
+		startup_phase_done("memory lock");
+	}
 
 	/* Delay startup of applications until the event loop is ready */
 	struct idle_ctx idle_ctx = {
@@ -254,9 +316,12 @@ main(int argc, char *argv[])
 
 	theme_finish(&theme);
 	rcxml_finish();
+	paths_cache_finish();
 	font_finish();
 
 	server_finish(&server);
+	buffer_pool_trim();
+	trace_finish();
 
 	return 0;
 }
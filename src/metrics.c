@@ -0,0 +1,565 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * metrics.c: counters and histograms served over a Unix socket
+ *
+ * The socket is opt-in with <core><metricsSocket>. Each connection gets a
+ * single reply in the Prometheus text exposition format and is closed, so
+ * a scrape costs one walk over outputs, views and the scene graph and
+ * nothing is done between scrapes apart from bumping counters.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "client-buffers.h"
+#include "common/buf.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/scaled-scene-buffer.h"
+#include "common/string-helpers.h"
+#include "config/rcxml.h"
+#include "labwc.h"
+#include "metrics.h"
+#include "view.h"
+
+/* Clients which don't send a request in time get the metrics anyway */
+#define METRICS_CLIENT_TIMEOUT_MSEC 1000
+#define METRICS_MAX_CLIENTS 8
+
+/* Upper bounds of the action duration histogram buckets in seconds */
+static const double action_buckets[] = {
+	0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1,
+};
+
+static const char *input_names[LAB_METRICS_INPUT_COUNT] = {
+	[LAB_METRICS_INPUT_MOTION] = "motion",
+	[LAB_METRICS_INPUT_BUTTON] = "button",
+	[LAB_METRICS_INPUT_AXIS] = "axis",
+	[LAB_METRICS_INPUT_KEY] = "key",
+};
+
+struct action_metrics {
+	const char *name;
+	uint64_t count;
+	uint64_t total_ns;
+	/* Not cumulative, the last bucket is +Inf */
+	uint64_t buckets[ARRAY_SIZE(action_buckets) + 1];
+};
+
+struct metrics_client {
+	int fd;
+	struct wl_event_source *source;
+	struct wl_event_source *timer;
+	struct server *server;
+	struct wl_list link;
+};
+
+static struct {
+	/* Value of <core><metricsSocket> and the path it expanded to */
+	char *configured;
+	char *path;
+	int fd;
+	struct wl_event_source *source;
+	struct wl_list clients; /* struct metrics_client.link */
+	int nr_clients;
+
+	uint64_t input_events[LAB_METRICS_INPUT_COUNT];
+	struct wl_array actions; /* struct action_metrics */
+} metrics = {
+	.fd = -1,
+	.clients = WL_LIST_INIT(&metrics.clients),
+};
+
+void
+metrics_input_event(enum metrics_input type)
+{
+	assert(type < LAB_METRICS_INPUT_COUNT);
+	metrics.input_events[type]++;
+}
+
+void
+metrics_action_executed(const char *name, uint64_t ns)
+{
+	struct action_metrics *action, *found = NULL;
+	wl_array_for_each(action, &metrics.actions) {
+		if (action->name == name) {
+			found = action;
+			break;
+		}
+	}
+	if (!found) {
+		found = wl_array_add(&metrics.actions, sizeof(*found));
+		if (!found) {
+			return;
+		}
+		*found = (struct action_metrics){ .name = name };
+	}
+	found->count++;
+	found->total_ns += ns;
+
+	size_t i = 0;
+	while (i < ARRAY_SIZE(action_buckets) && ns > action_buckets[i] * 1e9) {
+		i++;
+	}
+	found->buckets[i]++;
+}
+
+static void
+add_header(struct buf *buf, const char *name, const char *type,
+		const char *help)
+{
+	buf_add_fmt(buf, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void
+add_output_counter(struct buf *buf, struct server *server, const char *name,
+		const char *help, size_t offset)
+{
+	add_header(buf, name, "counter", help);
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		uint64_t value = *(uint64_t *)((char *)&output->metrics + offset);
+		buf_add_fmt(buf, "%s{output=\"%s\"} %" PRIu64 "\n", name,
+			output->wlr_output->name, value);
+	}
+}
+
+/* Nanosecond sums and sample counts, exported in seconds */
+static void
+add_output_summary(struct buf *buf, struct server *server, const char *name,
+		const char *help, size_t sum_offset, size_t count_offset)
+{
+	add_header(buf, name, "summary", help);
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		char *base = (char *)&output->metrics;
+		uint64_t sum = *(uint64_t *)(base + sum_offset);
+		uint64_t count = *(uint64_t *)(base + count_offset);
+		buf_add_fmt(buf, "%s_sum{output=\"%s\"} %.9f\n", name,
+			output->wlr_output->name, sum / 1e9);
+		buf_add_fmt(buf, "%s_count{output=\"%s\"} %" PRIu64 "\n", name,
+			output->wlr_output->name, count);
+	}
+}
+
+struct scene_counts {
+	int buffers;
+	int surfaces;
+};
+
+static void
+count_scene_buffer(struct wlr_scene_buffer *buffer, int sx, int sy,
+		void *data)
+{
+	struct scene_counts *counts = data;
+	counts->buffers++;
+	if (wlr_scene_surface_try_from_buffer(buffer)) {
+		counts->surfaces++;
+	}
+}
+
+static void
+add_scene_metrics(struct buf *buf, struct server *server)
+{
+	int mapped = 0, unmapped = 0;
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		if (view->mapped) {
+			mapped++;
+		} else {
+			unmapped++;
+		}
+	}
+	add_header(buf, "labwc_views", "gauge", "Number of views");
+	buf_add_fmt(buf, "labwc_views{state=\"mapped\"} %d\n", mapped);
+	buf_add_fmt(buf, "labwc_views{state=\"unmapped\"} %d\n", unmapped);
+
+	struct scene_counts counts = {0};
+	wlr_scene_node_for_each_buffer(&server->scene->tree.node,
+		count_scene_buffer, &counts);
+	add_header(buf, "labwc_scene_buffers", "gauge",
+		"Enabled scene buffer nodes");
+	buf_add_fmt(buf, "labwc_scene_buffers %d\n", counts.buffers);
+	add_header(buf, "labwc_surfaces", "gauge",
+		"Enabled scene buffer nodes showing a client surface");
+	buf_add_fmt(buf, "labwc_surfaces %d\n", counts.surfaces);
+}
+
+static void
+add_buffer_cache_metrics(struct buf *buf)
+{
+	const struct scaled_scene_buffer_stats *stats =
+		scaled_scene_buffer_get_stats();
+	add_header(buf, "labwc_buffer_cache_lookups_total", "counter",
+		"Scaled buffer cache lookups by result");
+	buf_add_fmt(buf, "labwc_buffer_cache_lookups_total{result=\"hit\"} %"
+		PRIu64 "\n", stats->hits);
+	buf_add_fmt(buf, "labwc_buffer_cache_lookups_total{result=\"shared\"} %"
+		PRIu64 "\n", stats->shared);
+	buf_add_fmt(buf, "labwc_buffer_cache_lookups_total{result=\"miss\"} %"
+		PRIu64 "\n", stats->misses);
+	add_header(buf, "labwc_buffer_cache_evictions_total", "counter",
+		"Scaled buffers evicted from the cache");
+	buf_add_fmt(buf, "labwc_buffer_cache_evictions_total %" PRIu64 "\n",
+		stats->evictions);
+	add_header(buf, "labwc_buffer_cache_bytes", "gauge",
+		"Size of the scaled buffer cache");
+	buf_add_fmt(buf, "labwc_buffer_cache_bytes %zu\n", stats->bytes);
+	add_header(buf, "labwc_buffer_cache_entries", "gauge",
+		"Number of buffers in the scaled buffer cache");
+	buf_add_fmt(buf, "labwc_buffer_cache_entries %zu\n", stats->entries);
+}
+
+static void
+add_client_bytes(const struct client_buffer_usage *usage, void *data)
+{
+	buf_add_fmt(data, "labwc_client_buffer_bytes{pid=\"%d\"} %zu\n",
+		(int)usage->pid, usage->bytes);
+}
+
+static void
+add_client_peak_bytes(const struct client_buffer_usage *usage, void *data)
+{
+	buf_add_fmt(data, "labwc_client_buffer_peak_bytes{pid=\"%d\"} %zu\n",
+		(int)usage->pid, usage->peak_bytes);
+}
+
+static void
+add_client_surfaces(const struct client_buffer_usage *usage, void *data)
+{
+	buf_add_fmt(data, "labwc_client_surfaces{pid=\"%d\"} %d\n",
+		(int)usage->pid, usage->surfaces);
+}
+
+static void
+add_client_metrics(struct buf *buf)
+{
+	add_header(buf, "labwc_client_buffer_bytes", "gauge",
+		"Estimated size of the buffers committed by each client");
+	client_buffers_for_each(add_client_bytes, buf);
+	add_header(buf, "labwc_client_buffer_peak_bytes", "gauge",
+		"Highest size of the buffers committed by each client");
+	client_buffers_for_each(add_client_peak_bytes, buf);
+	add_header(buf, "labwc_client_surfaces", "gauge",
+		"Surfaces of each client");
+	client_buffers_for_each(add_client_surfaces, buf);
+}
+
+static void
+add_action_metrics(struct buf *buf)
+{
+	add_header(buf, "labwc_action_duration_seconds", "histogram",
+		"Execution time of actions");
+	struct action_metrics *action;
+	wl_array_for_each(action, &metrics.actions) {
+		uint64_t cumulative = 0;
+		for (size_t i = 0; i < ARRAY_SIZE(action_buckets); i++) {
+			cumulative += action->buckets[i];
+			buf_add_fmt(buf, "labwc_action_duration_seconds_bucket"
+				"{action=\"%s\",le=\"%g\"} %" PRIu64 "\n",
+				action->name, action_buckets[i], cumulative);
+		}
+		buf_add_fmt(buf, "labwc_action_duration_seconds_bucket"
+			"{action=\"%s\",le=\"+Inf\"} %" PRIu64 "\n",
+			action->name, action->count);
+		buf_add_fmt(buf, "labwc_action_duration_seconds_sum"
+			"{action=\"%s\"} %.9f\n", action->name,
+			action->total_ns / 1e9);
+		buf_add_fmt(buf, "labwc_action_duration_seconds_count"
+			"{action=\"%s\"} %" PRIu64 "\n", action->name,
+			action->count);
+	}
+}
+
+static void
+add_mem_metrics(struct buf *buf)
+{
+	struct mem_stats stats[LAB_MEM_TAG_COUNT];
+	for (size_t i = 0; i < LAB_MEM_TAG_COUNT; i++) {
+		if (!mem_get_stats(i, &stats[i])) {
+			/* Built without -Dmem-accounting */
+			return;
+		}
+	}
+
+	add_header(buf, "labwc_mem_live_bytes", "gauge",
+		"Bytes allocated and not yet freed, by subsystem");
+	for (size_t i = 0; i < LAB_MEM_TAG_COUNT; i++) {
+		buf_add_fmt(buf, "labwc_mem_live_bytes{subsystem=\"%s\"} %zu\n",
+			mem_tag_name(i), stats[i].live_bytes);
+	}
+	add_header(buf, "labwc_mem_peak_bytes", "gauge",
+		"Highest number of live bytes, by subsystem");
+	for (size_t i = 0; i < LAB_MEM_TAG_COUNT; i++) {
+		buf_add_fmt(buf, "labwc_mem_peak_bytes{subsystem=\"%s\"} %zu\n",
+			mem_tag_name(i), stats[i].peak_bytes);
+	}
+	add_header(buf, "labwc_mem_allocations_total", "counter",
+		"Allocations, by subsystem");
+	for (size_t i = 0; i < LAB_MEM_TAG_COUNT; i++) {
+		buf_add_fmt(buf, "labwc_mem_allocations_total{subsystem=\"%s\"} %"
+			PRIu64 "\n", mem_tag_name(i), stats[i].allocations);
+	}
+	add_header(buf, "labwc_mem_frees_total", "counter",
+		"Frees of accounted allocations, by subsystem");
+	for (size_t i = 0; i < LAB_MEM_TAG_COUNT; i++) {
+		buf_add_fmt(buf, "labwc_mem_frees_total{subsystem=\"%s\"} %"
+			PRIu64 "\n", mem_tag_name(i), stats[i].frees);
+	}
+}
+
+static void
+metrics_format(struct buf *buf, struct server *server)
+{
+	add_output_counter(buf, server, "labwc_output_frames_rendered_total",
+		"Frames rendered and committed",
+		offsetof(struct output_metrics, frames_rendered));
+	add_output_counter(buf, server, "labwc_output_frames_skipped_total",
+		"Frame events without anything to render",
+		offsetof(struct output_metrics, frames_skipped));
+	add_output_counter(buf, server, "labwc_output_commit_failures_total",
+		"Failed output commits",
+		offsetof(struct output_metrics, commit_failures));
+	add_output_counter(buf, server, "labwc_output_tearing_fallbacks_total",
+		"Tearing page-flips retried without tearing",
+		offsetof(struct output_metrics, tearing_fallbacks));
+	add_output_counter(buf, server, "labwc_output_tearing_commits_total",
+		"Page-flips committed with tearing",
+		offsetof(struct output_metrics, tearing_commits));
+	add_output_counter(buf, server, "labwc_output_frames_presented_total",
+		"Frames presented according to the backend",
+		offsetof(struct output_metrics, frames_presented));
+	add_output_counter(buf, server, "labwc_output_missed_vblanks_total",
+		"Vblanks missed by frames committed in time for them",
+		offsetof(struct output_metrics, missed_vblanks));
+	add_output_summary(buf, server, "labwc_output_judder_seconds",
+		"Deviation of presentation times from the vblank grid",
+		offsetof(struct output_metrics, judder_ns_sum),
+		offsetof(struct output_metrics, judder_samples));
+	add_output_summary(buf, server, "labwc_output_latency_seconds",
+		"Time from the start of a repaint until its presentation",
+		offsetof(struct output_metrics, latency_ns_sum),
+		offsetof(struct output_metrics, latency_samples));
+	add_output_counter(buf, server,
+		"labwc_output_cursor_hardware_frames_total",
+		"Frames with the cursor on a cursor plane",
+		offsetof(struct output_metrics, cursor_hardware_frames));
+	add_output_counter(buf, server,
+		"labwc_output_cursor_software_frames_total",
+		"Frames with the cursor composited by the renderer",
+		offsetof(struct output_metrics, cursor_software_frames));
+	add_output_counter(buf, server, "labwc_output_cursor_fallbacks_total",
+		"Switches from the hardware to the software cursor",
+		offsetof(struct output_metrics, cursor_fallbacks));
+
+	add_scene_metrics(buf, server);
+	add_buffer_cache_metrics(buf);
+	add_client_metrics(buf);
+
+	add_header(buf, "labwc_input_events_total", "counter",
+		"Input events handled by the compositor");
+	for (size_t i = 0; i < LAB_METRICS_INPUT_COUNT; i++) {
+		buf_add_fmt(buf, "labwc_input_events_total{type=\"%s\"} %"
+			PRIu64 "\n", input_names[i], metrics.input_events[i]);
+	}
+
+	add_action_metrics(buf);
+	add_mem_metrics(buf);
+}
+
+static void
+client_destroy(struct metrics_client *client)
+{
+	wl_event_source_remove(client->source);
+	wl_event_source_remove(client->timer);
+	close(client->fd);
+	wl_list_remove(&client->link);
+	metrics.nr_clients--;
+	free(client);
+}
+
+static void
+client_reply(struct metrics_client *client, bool http)
+{
+	struct buf body = BUF_INIT;
+	metrics_format(&body, client->server);
+
+	struct buf reply = BUF_INIT;
+	if (http) {
+		buf_add_fmt(&reply, "HTTP/1.0 200 OK\r\n"
+			"Content-Type: text/plain; version=0.0.4\r\n"
+			"Content-Length: %zu\r\n\r\n", body.len);
+	}
+	buf_add(&reply, body.data);
+	buf_reset(&body);
+
+	/* The socket is non-blocking, a client which doesn't read loses */
+	size_t written = 0;
+	while (written < reply.len) {
+		ssize_t ret = write(client->fd, reply.data + written,
+			reply.len - written);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret <= 0) {
+			wlr_log_errno(WLR_DEBUG, "metrics reply truncated");
+			break;
+		}
+		written += ret;
+	}
+	buf_reset(&reply);
+	client_destroy(client);
+}
+
+static int
+handle_client_readable(int fd, uint32_t mask, void *data)
+{
+	struct metrics_client *client = data;
+	char request[256];
+	ssize_t len = read(fd, request, sizeof(request));
+	if (len < 0 && (errno == EAGAIN || errno == EINTR)) {
+		return 0;
+	}
+	bool http = len >= 3 && !strncmp(request, "GET", 3);
+	client_reply(client, http);
+	return 0;
+}
+
+static int
+handle_client_timeout(void *data)
+{
+	client_reply(data, /* http */ false);
+	return 0;
+}
+
+static int
+handle_connection(int fd, uint32_t mask, void *data)
+{
+	struct server *server = data;
+	int client_fd = accept4(fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (client_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot accept metrics connection");
+		return 0;
+	}
+	if (metrics.nr_clients >= METRICS_MAX_CLIENTS) {
+		close(client_fd);
+		return 0;
+	}
+
+	struct metrics_client *client = znew(*client);
+	client->fd = client_fd;
+	client->server = server;
+	client->source = wl_event_loop_add_fd(server->wl_event_loop,
+		client_fd, WL_EVENT_READABLE, handle_client_readable, client);
+	client->timer = wl_event_loop_add_timer(server->wl_event_loop,
+		handle_client_timeout, client);
+	wl_event_source_timer_update(client->timer,
+		METRICS_CLIENT_TIMEOUT_MSEC);
+	wl_list_insert(&metrics.clients, &client->link);
+	metrics.nr_clients++;
+	return 0;
+}
+
+static void
+metrics_close(void)
+{
+	struct metrics_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &metrics.clients, link) {
+		client_destroy(client);
+	}
+	if (metrics.source) {
+		wl_event_source_remove(metrics.source);
+		metrics.source = NULL;
+	}
+	if (metrics.fd >= 0) {
+		close(metrics.fd);
+		metrics.fd = -1;
+		unlink(metrics.path);
+	}
+	zfree(metrics.configured);
+	zfree(metrics.path);
+}
+
+/* Only remove a stale socket, never some other file at the same path */
+static void
+unlink_stale_socket(const char *path)
+{
+	struct stat st;
+	if (!lstat(path, &st) && S_ISSOCK(st.st_mode)) {
+		unlink(path);
+	}
+}
+
+static void
+metrics_open(struct server *server, const char *configured)
+{
+	struct buf path = BUF_INIT;
+	buf_add(&path, configured);
+	buf_expand_tilde(&path);
+	buf_expand_shell_variables(&path);
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if (path.len >= sizeof(addr.sun_path)) {
+		wlr_log(WLR_ERROR, "metrics socket path too long: %s", path.data);
+		goto out;
+	}
+	strcpy(addr.sun_path, path.data);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot create metrics socket");
+		goto out;
+	}
+	unlink_stale_socket(path.data);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+			|| listen(fd, METRICS_MAX_CLIENTS) < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot listen on %s", path.data);
+		close(fd);
+		goto out;
+	}
+
+	metrics.fd = fd;
+	metrics.configured = xstrdup(configured);
+	metrics.path = xstrdup(path.data);
+	metrics.source = wl_event_loop_add_fd(server->wl_event_loop, fd,
+		WL_EVENT_READABLE, handle_connection, server);
+	wlr_log(WLR_INFO, "serving metrics on %s", metrics.path);
+out:
+	buf_reset(&path);
+}
+
+void
+metrics_init(struct server *server)
+{
+	if (!string_null_or_empty(rc.metrics_socket)) {
+		metrics_open(server, rc.metrics_socket);
+	}
+}
+
+void
+metrics_reconfigure(struct server *server)
+{
+	/* Keep the socket, and scrapers connected to it, if unchanged */
+	if (metrics.configured && rc.metrics_socket
+			&& !strcmp(metrics.configured, rc.metrics_socket)) {
+		return;
+	}
+	metrics_close();
+	metrics_init(server);
+}
+
+void
+metrics_finish(struct server *server)
+{
+	metrics_close();
+	wl_array_release(&metrics.actions);
+	wl_array_init(&metrics.actions);
+}
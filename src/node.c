@@ -2,8 +2,12 @@
 #include <assert.h>
 #include <stdlib.h>
 #include "common/mem.h"
+#include "common/slab.h"
 #include "node.h"
 
+/* Every popup, menu item and scene buffer gets one */
+static struct lab_slab descriptor_slab = LAB_SLAB_INIT(struct node_descriptor);
+
 static void
 descriptor_destroy(struct node_descriptor *node_descriptor)
 {
@@ -11,7 +15,7 @@ descriptor_destroy(struct node_descriptor *node_descriptor)
 		return;
 	}
 	wl_list_remove(&node_descriptor->destroy.link);
-	free(node_descriptor);
+	lab_slab_free(&descriptor_slab, node_descriptor);
 }
 
 static void
@@ -26,7 +30,8 @@ void
 node_descriptor_create(struct wlr_scene_node *scene_node,
 		enum node_descriptor_type type, void *data)
 {
-	struct node_descriptor *node_descriptor = znew(*node_descriptor);
+	struct node_descriptor *node_descriptor =
+		lab_slab_new(&descriptor_slab, *node_descriptor);
 	node_descriptor->type = type;
 	node_descriptor->data = data;
 	node_descriptor->destroy.notify = destroy_notify;
@@ -14,7 +14,8 @@
 static_assert(LAB_FIELD_SINGLE_FMT_MAX_LEN <= 255, "fmt_position is a unsigned char");
 
 /* forward declares */
-typedef void field_conversion_type(struct buf *buf, struct view *view, const char *format);
+typedef void field_conversion_type(struct buf *buf, struct view *view,
+	struct window_switcher_field *field);
 struct field_converter {
 	const char fmt_char;
 	field_conversion_type *fn;
@@ -22,6 +23,22 @@ struct field_converter {
 
 static const struct field_converter field_converter[];
 
+/*
+ * A piece of a custom format: either literal @text, or the content of
+ * another field with @text as printf format, e.g. "%-10s"
+ */
+struct osd_field_token {
+	enum window_switcher_field_content content; /* LAB_FIELD_NONE if literal */
+	char *text;
+};
+
+struct osd_field_cache_entry {
+	struct window_switcher_field *field;
+	char *text;
+};
+
+static uint64_t generation = 1;
+
 /* Internal helpers */
 
 static const char *
@@ -83,28 +100,32 @@ get_title_if_different(struct view *view)
 
 /* Field handlers */
 static void
-field_set_type(struct buf *buf, struct view *view, const char *format)
+field_set_type(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
 	/* custom type conversion-specifier: B (backend) */
 	buf_add(buf, get_type(view, /*short_form*/ false));
 }
 
 static void
-field_set_type_short(struct buf *buf, struct view *view, const char *format)
+field_set_type_short(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
 	/* custom type conversion-specifier: b (backend) */
 	buf_add(buf, get_type(view, /*short_form*/ true));
 }
 
 static void
-field_set_workspace(struct buf *buf, struct view *view, const char *format)
+field_set_workspace(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
 	/* custom type conversion-specifier: W */
 	buf_add(buf, view->workspace->name);
 }
 
 static void
-field_set_workspace_short(struct buf *buf, struct view *view, const char *format)
+field_set_workspace_short(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
 	/* custom type conversion-specifier: w */
 	if (wl_list_length(&rc.workspace_config.workspaces) > 1) {
@@ -113,7 +134,8 @@ field_set_workspace_short(struct buf *buf, struct view *view, const char *format
 }
 
 static void
-field_set_win_state(struct buf *buf, struct view *view, const char *format)
+field_set_win_state(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
 	/* custom type conversion-specifier: s */
 	if (view->maximized) {
@@ -128,7 +150,8 @@ field_set_win_state(struct buf *buf, struct view *view, const char *format)
 }
 
 static void
-field_set_win_state_all(struct buf *buf, struct view *view, const char *format)
+field_set_win_state_all(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
 	/* custom type conversion-specifier: S */
 	buf_add(buf, view->minimized ? "m" : " ");
@@ -138,7 +161,8 @@ field_set_win_state_all(struct buf *buf, struct view *view, const char *format)
 }
 
 static void
-field_set_output(struct buf *buf, struct view *view, const char *format)
+field_set_output(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
 	/* custom type conversion-specifier: O */
 	if (output_is_usable(view->output)) {
@@ -147,7 +171,8 @@ field_set_output(struct buf *buf, struct view *view, const char *format)
 }
 
 static void
-field_set_output_short(struct buf *buf, struct view *view, const char *format)
+field_set_output_short(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
 	/* custom type conversion-specifier: o */
 	if (wl_list_length(&view->server->outputs) > 1 &&
@@ -157,64 +182,141 @@ field_set_output_short(struct buf *buf, struct view *view, const char *format)
 }
 
 static void
-field_set_identifier(struct buf *buf, struct view *view, const char *format)
+field_set_identifier(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
 	/* custom type conversion-specifier: I */
 	buf_add(buf, get_app_id_or_class(view, /*trim*/ false));
 }
 
 static void
-field_set_identifier_trimmed(struct buf *buf, struct view *view, const char *format)
+field_set_identifier_trimmed(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
 	/* custom type conversion-specifier: i */
 	buf_add(buf, get_app_id_or_class(view, /*trim*/ true));
 }
 
 static void
-field_set_desktop_entry_name(struct buf *buf, struct view *view, const char *format)
+field_set_desktop_entry_name(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
 	/* custom type conversion-specifier: n */
 	buf_add(buf, get_desktop_name(view));
 }
 
 static void
-field_set_title(struct buf *buf, struct view *view, const char *format)
+field_set_title(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
 	/* custom type conversion-specifier: T */
 	buf_add(buf, get_title(view));
 }
 
 static void
-field_set_title_short(struct buf *buf, struct view *view, const char *format)
+field_set_title_short(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
 	/* custom type conversion-specifier: t */
 	buf_add(buf, get_title_if_different(view));
 }
 
 static void
-field_set_custom(struct buf *buf, struct view *view, const char *format)
+field_set_custom(struct buf *buf, struct view *view,
+		struct window_switcher_field *field)
 {
-	if (!format) {
+	if (!field->format) {
 		wlr_log(WLR_ERROR, "Missing format for custom window switcher field");
 		return;
 	}
 
-	char fmt[LAB_FIELD_SINGLE_FMT_MAX_LEN];
-	unsigned char fmt_position = 0;
-
 	struct buf field_result = BUF_INIT;
 	char converted_field[4096];
 
+	struct osd_field_token *token;
+	wl_array_for_each(token, &field->tokens) {
+		if (token->content == LAB_FIELD_NONE) {
+			buf_add(buf, token->text);
+			continue;
+		}
+
+		/* Generate the actual content */
+		field_converter[token->content].fn(&field_result, view,
+			/* field */ NULL);
+
+		/* Throw it at snprintf to allow formatting / padding */
+		snprintf(converted_field, sizeof(converted_field),
+			token->text, field_result.data);
+
+		/* And finally write it to the output buffer */
+		buf_add(buf, converted_field);
+		buf_clear(&field_result);
+	}
+	buf_reset(&field_result);
+}
+
+static const struct field_converter field_converter[LAB_FIELD_COUNT] = {
+	[LAB_FIELD_TYPE]               = { 'B', field_set_type },
+	[LAB_FIELD_TYPE_SHORT]         = { 'b', field_set_type_short },
+	[LAB_FIELD_WIN_STATE_ALL]      = { 'S', field_set_win_state_all },
+	[LAB_FIELD_WIN_STATE]          = { 's', field_set_win_state },
+	[LAB_FIELD_IDENTIFIER]         = { 'I', field_set_identifier },
+	[LAB_FIELD_TRIMMED_IDENTIFIER] = { 'i', field_set_identifier_trimmed },
+	[LAB_FIELD_DESKTOP_ENTRY_NAME] = { 'n', field_set_desktop_entry_name},
+	[LAB_FIELD_WORKSPACE]          = { 'W', field_set_workspace },
+	[LAB_FIELD_WORKSPACE_SHORT]    = { 'w', field_set_workspace_short },
+	[LAB_FIELD_OUTPUT]             = { 'O', field_set_output },
+	[LAB_FIELD_OUTPUT_SHORT]       = { 'o', field_set_output_short },
+	[LAB_FIELD_TITLE]              = { 'T', field_set_title },
+	[LAB_FIELD_TITLE_SHORT]        = { 't', field_set_title_short },
+	/* fmt_char can never be matched so prevents LAB_FIELD_CUSTOM recursion */
+	[LAB_FIELD_CUSTOM]             = { '\0', field_set_custom },
+};
+
+static void
+add_token(struct window_switcher_field *field,
+		enum window_switcher_field_content content, const char *text)
+{
+	struct osd_field_token *token = wl_array_add(&field->tokens,
+		sizeof(*token));
+	if (!token) {
+		wlr_log(WLR_ERROR, "Failed to allocate osd field token");
+		return;
+	}
+	token->content = content;
+	token->text = xstrdup(text);
+}
+
+static void
+free_tokens(struct window_switcher_field *field)
+{
+	struct osd_field_token *token;
+	wl_array_for_each(token, &field->tokens) {
+		free(token->text);
+	}
+	wl_array_release(&field->tokens);
+	wl_array_init(&field->tokens);
+}
+
+/* Splits a custom format into tokens, so that it is not parsed per view */
+static void
+parse_format(struct window_switcher_field *field, const char *format)
+{
+	char fmt[LAB_FIELD_SINGLE_FMT_MAX_LEN];
+	unsigned char fmt_position = 0;
+	struct buf literal = BUF_INIT;
+
+	free_tokens(field);
 	for (const char *p = format; *p; p++) {
 		if (!fmt_position) {
 			if (*p == '%') {
 				fmt[fmt_position++] = *p;
 			} else {
 				/*
-				 * Just relay anything not part of a
-				 * format string to the output buffer.
+				 * Anything not part of a format string
+				 * is relayed to the output as is.
 				 */
-				buf_add_char(buf, *p);
+				buf_add_char(&literal, *p);
 			}
 			continue;
 		}
@@ -238,59 +340,40 @@ field_set_custom(struct buf *buf, struct view *view, const char *format)
 		}
 
 		/* Handlers */
-		for (unsigned char i = 0; i < LAB_FIELD_COUNT; i++) {
-			if (*p != field_converter[i].fmt_char) {
-				continue;
+		unsigned char i;
+		for (i = 0; i < LAB_FIELD_COUNT; i++) {
+			if (*p == field_converter[i].fmt_char) {
+				break;
+			}
+		}
+		if (i < LAB_FIELD_COUNT) {
+			if (literal.len) {
+				add_token(field, LAB_FIELD_NONE, literal.data);
+				buf_clear(&literal);
 			}
-
-			/* Generate the actual content*/
-			field_converter[i].fn(&field_result, view, /*format*/ NULL);
-
-			/* Throw it at snprintf to allow formatting / padding */
 			fmt[fmt_position++] = 's';
 			fmt[fmt_position++] = '\0';
-			snprintf(converted_field, sizeof(converted_field),
-				fmt, field_result.data);
-
-			/* And finally write it to the output buffer */
-			buf_add(buf, converted_field);
-			goto reset_format;
+			add_token(field, i, fmt);
+		} else {
+			wlr_log(WLR_ERROR,
+				"invalid format character found for osd %s: '%c'",
+				format, *p);
 		}
 
-		wlr_log(WLR_ERROR,
-			"invalid format character found for osd %s: '%c'",
-			format, *p);
-
-reset_format:
-		/* Reset format string and tmp field result buffer */
-		buf_clear(&field_result);
+		/* Reset format string */
 		fmt_position = 0;
 	}
-	buf_reset(&field_result);
+	if (literal.len) {
+		add_token(field, LAB_FIELD_NONE, literal.data);
+	}
+	buf_reset(&literal);
 }
 
-static const struct field_converter field_converter[LAB_FIELD_COUNT] = {
-	[LAB_FIELD_TYPE]               = { 'B', field_set_type },
-	[LAB_FIELD_TYPE_SHORT]         = { 'b', field_set_type_short },
-	[LAB_FIELD_WIN_STATE_ALL]      = { 'S', field_set_win_state_all },
-	[LAB_FIELD_WIN_STATE]          = { 's', field_set_win_state },
-	[LAB_FIELD_IDENTIFIER]         = { 'I', field_set_identifier },
-	[LAB_FIELD_TRIMMED_IDENTIFIER] = { 'i', field_set_identifier_trimmed },
-	[LAB_FIELD_DESKTOP_ENTRY_NAME] = { 'n', field_set_desktop_entry_name},
-	[LAB_FIELD_WORKSPACE]          = { 'W', field_set_workspace },
-	[LAB_FIELD_WORKSPACE_SHORT]    = { 'w', field_set_workspace_short },
-	[LAB_FIELD_OUTPUT]             = { 'O', field_set_output },
-	[LAB_FIELD_OUTPUT_SHORT]       = { 'o', field_set_output_short },
-	[LAB_FIELD_TITLE]              = { 'T', field_set_title },
-	[LAB_FIELD_TITLE_SHORT]        = { 't', field_set_title_short },
-	/* fmt_char can never be matched so prevents LAB_FIELD_CUSTOM recursion */
-	[LAB_FIELD_CUSTOM]             = { '\0', field_set_custom },
-};
-
 struct window_switcher_field *
 osd_field_create(void)
 {
 	struct window_switcher_field *field = znew(*field);
+	wl_array_init(&field->tokens);
 	return field;
 }
 
@@ -332,6 +415,7 @@ osd_field_arg_from_xml_node(struct window_switcher_field *field,
 	} else if (!strcmp(nodename, "format")) {
 		zfree(field->format);
 		field->format = xstrdup(content);
+		parse_format(field, content);
 	} else if (!strcmp(nodename, "width") && !strchr(content, '%')) {
 		wlr_log(WLR_ERROR, "Invalid osd field width: %s, misses trailing %%", content);
 	} else if (!strcmp(nodename, "width")) {
@@ -360,6 +444,35 @@ osd_field_is_valid(struct window_switcher_field *field)
 	return true;
 }
 
+static void
+clear_cache(struct osd_field_cache *cache)
+{
+	struct osd_field_cache_entry *entry;
+	wl_array_for_each(entry, &cache->entries) {
+		free(entry->text);
+	}
+	wl_array_release(&cache->entries);
+	wl_array_init(&cache->entries);
+}
+
+/* Returns the cached text, or NULL if there is none yet */
+static const char *
+cache_lookup(struct osd_field_cache *cache, struct window_switcher_field *field)
+{
+	if (cache->generation != generation) {
+		clear_cache(cache);
+		cache->generation = generation;
+		return NULL;
+	}
+	struct osd_field_cache_entry *entry;
+	wl_array_for_each(entry, &cache->entries) {
+		if (entry->field == field) {
+			return entry->text;
+		}
+	}
+	return NULL;
+}
+
 void
 osd_field_get_content(struct window_switcher_field *field,
 		struct buf *buf, struct view *view)
@@ -370,12 +483,41 @@ osd_field_get_content(struct window_switcher_field *field,
 	}
 	assert(field->content < LAB_FIELD_COUNT && field_converter[field->content].fn);
 
-	field_converter[field->content].fn(buf, view, field->format);
+	struct osd_field_cache *cache = &view->osd_fields;
+	const char *text = cache_lookup(cache, field);
+	if (text) {
+		buf_add(buf, text);
+		return;
+	}
+
+	struct buf content = BUF_INIT;
+	field_converter[field->content].fn(&content, view, field);
+	struct osd_field_cache_entry *entry = wl_array_add(&cache->entries,
+		sizeof(*entry));
+	if (entry) {
+		entry->field = field;
+		entry->text = xstrdup(content.data);
+	}
+	buf_add(buf, content.data);
+	buf_reset(&content);
+}
+
+void
+osd_field_invalidate(struct view *view)
+{
+	if (!view) {
+		/* Caches are dropped when they are next used */
+		generation++;
+		return;
+	}
+	clear_cache(&view->osd_fields);
+	view->osd_fields.generation = 0;
 }
 
 void
 osd_field_free(struct window_switcher_field *field)
 {
+	free_tokens(field);
 	zfree(field->format);
 	zfree(field);
 }
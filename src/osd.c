@@ -26,36 +26,45 @@ struct osd_scene_item {
 	struct wlr_scene_node *highlight_outline;
 };
 
+/* Views are listed in stacking order, topmost first */
+static void
+take_snapshot(struct server *server)
+{
+	struct osd_state *osd_state = &server->osd_state;
+	wl_array_release(&osd_state->views);
+	wl_array_init(&osd_state->views);
+	osd_state->nr_views = 0;
+
+	struct view *view;
+	for_each_view(view, &server->views, rc.window_switcher.criteria) {
+		array_add(&osd_state->views, view);
+		osd_state->nr_views++;
+	}
+}
+
 /*
- * Returns the view to select next in the window switcher.
- * If !start_view, the second focusable view is returned.
+ * Moves the selection by one live view in direction @dir. Returns the
+ * view at the new position, or NULL if all views are gone.
  */
 static struct view *
-get_next_cycle_view(struct server *server, struct view *start_view,
-		enum lab_cycle_dir dir)
+step_cycle_view(struct osd_state *osd_state, enum lab_cycle_dir dir)
 {
-	struct view *(*iter)(struct wl_list *head, struct view *view,
-		enum lab_view_criteria criteria);
-	bool forwards = dir == LAB_CYCLE_DIR_FORWARD;
-	iter = forwards ? view_next_no_head_stop : view_prev_no_head_stop;
-
-	enum lab_view_criteria criteria = rc.window_switcher.criteria;
-
-	/*
-	 * Views are listed in stacking order, topmost first.  Usually the
-	 * topmost view is already focused, so when iterating in the forward
-	 * direction we pre-select the view second from the top:
-	 *
-	 *   View #1 (on top, currently focused)
-	 *   View #2 (pre-selected)
-	 *   View #3
-	 *   ...
-	 */
-	if (!start_view && forwards) {
-		start_view = iter(&server->views, NULL, criteria);
+	size_t len = wl_array_len(&osd_state->views);
+	struct view **views = osd_state->views.data;
+	if (!osd_state->nr_views) {
+		return NULL;
 	}
 
-	return iter(&server->views, start_view, criteria);
+	size_t i = osd_state->cycle_index;
+	do {
+		if (dir == LAB_CYCLE_DIR_FORWARD) {
+			i = (i + 1) % len;
+		} else {
+			i = (i + len - 1) % len;
+		}
+	} while (!views[i]);
+	osd_state->cycle_index = i;
+	return views[i];
 }
 
 void
@@ -69,27 +78,31 @@ osd_on_view_destroy(struct view *view)
 		return;
 	}
 
+	/* Leave a tombstone, so that the indices stay valid */
+	struct view **item;
+	wl_array_for_each(item, &osd_state->views) {
+		if (*item == view) {
+			*item = NULL;
+			osd_state->nr_views--;
+			break;
+		}
+	}
+
 	if (osd_state->cycle_view == view) {
 		/*
 		 * If we are the current OSD selected view, cycle
-		 * to the next because we are dying.
+		 * to the previous one because we are dying.
 		 */
+		osd_state->cycle_view = step_cycle_view(osd_state,
+			LAB_CYCLE_DIR_BACKWARD);
 
-		/* Also resets preview node */
-		osd_state->cycle_view = get_next_cycle_view(view->server,
-			osd_state->cycle_view, LAB_CYCLE_DIR_BACKWARD);
-
-		/*
-		 * If we cycled back to ourselves, then we have no more windows.
-		 * Just close the OSD for good.
-		 */
-		if (osd_state->cycle_view == view || !osd_state->cycle_view) {
+		/* No more windows, just close the OSD for good */
+		if (!osd_state->cycle_view) {
 			/* osd_finish() additionally resets cycle_view to NULL */
 			osd_finish(view->server);
 		}
 	}
 
-
 	if (view->scene_tree) {
 		struct wlr_scene_node *node = &view->scene_tree->node;
 		if (osd_state->preview_anchor == node) {
@@ -135,8 +148,20 @@ osd_begin(struct server *server, enum lab_cycle_dir direction)
 		return;
 	}
 
-	server->osd_state.cycle_view = get_next_cycle_view(server,
-		server->osd_state.cycle_view, direction);
+	struct osd_state *osd_state = &server->osd_state;
+	take_snapshot(server);
+
+	/*
+	 * Usually the topmost view is already focused, so when cycling
+	 * forwards we pre-select the view second from the top:
+	 *
+	 *   View #1 (on top, currently focused)
+	 *   View #2 (pre-selected)
+	 *   View #3
+	 *   ...
+	 */
+	osd_state->cycle_index = 0;
+	osd_state->cycle_view = step_cycle_view(osd_state, direction);
 
 	seat_focus_override_begin(&server->seat,
 		LAB_INPUT_STATE_WINDOW_SWITCHER, LAB_CURSOR_DEFAULT);
@@ -150,8 +175,8 @@ osd_cycle(struct server *server, enum lab_cycle_dir direction)
 {
 	assert(server->input_mode == LAB_INPUT_STATE_WINDOW_SWITCHER);
 
-	server->osd_state.cycle_view = get_next_cycle_view(server,
-		server->osd_state.cycle_view, direction);
+	server->osd_state.cycle_view = step_cycle_view(&server->osd_state,
+		direction);
 }
 
 void
@@ -163,6 +188,9 @@ osd_finish(struct server *server)
 	server->osd_state.preview_node = NULL;
 	server->osd_state.preview_anchor = NULL;
 	server->osd_state.cycle_view = NULL;
+	wl_array_release(&server->osd_state.views);
+	wl_array_init(&server->osd_state.views);
+	server->osd_state.nr_views = 0;
 
 	if (server->osd_state.preview_outline) {
 		/* Destroy the whole multi_rect so we can easily react to new themes */
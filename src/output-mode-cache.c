@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wlr/backend/drm.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+#include "common/buf.h"
+#include "common/list.h"
+#include "common/mem.h"
+#include "output-mode-cache.h"
+
+/* Most recently stored first, older entries are dropped */
+#define MODE_CACHE_MAX_ENTRIES 32
+
+struct mode_cache_entry {
+	char *id;
+	struct output_mode_record record;
+	struct wl_list link;
+};
+
+static struct wl_list entries = { &entries, &entries };
+static bool loaded;
+
+static bool
+get_dir(struct buf *path)
+{
+	const char *state_home = getenv("XDG_STATE_HOME");
+	if (state_home && *state_home) {
+		buf_add(path, state_home);
+	} else {
+		const char *home = getenv("HOME");
+		if (!home || !*home) {
+			return false;
+		}
+		buf_add_fmt(path, "%s/.local/state", home);
+	}
+	buf_add(path, "/labwc");
+	return true;
+}
+
+static bool
+get_path(struct buf *path)
+{
+	if (!get_dir(path)) {
+		return false;
+	}
+	buf_add(path, "/output-modes");
+	return true;
+}
+
+/* Only physical displays have a stable identity */
+static char *
+get_id(struct wlr_output *wlr_output)
+{
+	if (!wlr_output_is_drm(wlr_output)) {
+		return NULL;
+	}
+	if (!wlr_output->make && !wlr_output->model && !wlr_output->serial) {
+		return NULL;
+	}
+	struct buf id = BUF_INIT;
+	buf_add_fmt(&id, "%s/%s/%s",
+		wlr_output->make ? wlr_output->make : "",
+		wlr_output->model ? wlr_output->model : "",
+		wlr_output->serial ? wlr_output->serial : "");
+	return id.data;
+}
+
+static struct mode_cache_entry *
+find_entry(const char *id)
+{
+	struct mode_cache_entry *entry;
+	wl_list_for_each(entry, &entries, link) {
+		if (!strcmp(entry->id, id)) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static void
+entry_destroy(struct mode_cache_entry *entry)
+{
+	wl_list_remove(&entry->link);
+	free(entry->id);
+	free(entry);
+}
+
+/* Lines are "<width> <height> <refresh> <id>" */
+static void
+load(void)
+{
+	loaded = true;
+	struct buf path = BUF_INIT;
+	if (!get_path(&path)) {
+		buf_reset(&path);
+		return;
+	}
+	FILE *file = fopen(path.data, "r");
+	buf_reset(&path);
+	if (!file) {
+		return;
+	}
+
+	char *line = NULL;
+	size_t len = 0;
+	while (getline(&line, &len, file) != -1) {
+		struct output_mode_record record;
+		int offset = 0;
+		if (sscanf(line, "%d %d %d %n", &record.width, &record.height,
+				&record.refresh, &offset) != 3 || !offset) {
+			continue;
+		}
+		char *id = line + offset;
+		id[strcspn(id, "\n")] = '\0';
+		if (!*id || record.width <= 0 || record.height <= 0
+				|| find_entry(id)) {
+			continue;
+		}
+		struct mode_cache_entry *entry = znew(*entry);
+		entry->id = xstrdup(id);
+		entry->record = record;
+		wl_list_append(&entries, &entry->link);
+	}
+	free(line);
+	fclose(file);
+}
+
+static void
+save(void)
+{
+	struct buf path = BUF_INIT;
+	struct buf tmp_path = BUF_INIT;
+	if (!get_dir(&path)) {
+		goto out;
+	}
+	/* Create $XDG_STATE_HOME and its labwc subdirectory if needed */
+	char *slash = strrchr(path.data, '/');
+	*slash = '\0';
+	if (mkdir(path.data, 0700) && errno != EEXIST) {
+		goto out;
+	}
+	*slash = '/';
+	if (mkdir(path.data, 0700) && errno != EEXIST) {
+		goto out;
+	}
+	buf_add(&path, "/output-modes");
+	buf_add_fmt(&tmp_path, "%s.tmp", path.data);
+
+	FILE *file = fopen(tmp_path.data, "w");
+	if (!file) {
+		goto out;
+	}
+	struct mode_cache_entry *entry;
+	wl_list_for_each(entry, &entries, link) {
+		fprintf(file, "%d %d %d %s\n", entry->record.width,
+			entry->record.height, entry->record.refresh, entry->id);
+	}
+	/* Replace the old cache atomically */
+	if (fclose(file) || rename(tmp_path.data, path.data)) {
+		unlink(tmp_path.data);
+		wlr_log_errno(WLR_DEBUG, "cannot write %s", path.data);
+	}
+out:
+	buf_reset(&tmp_path);
+	buf_reset(&path);
+}
+
+bool
+output_mode_cache_lookup(struct wlr_output *wlr_output,
+		struct output_mode_record *record)
+{
+	char *id = get_id(wlr_output);
+	if (!id) {
+		return false;
+	}
+	if (!loaded) {
+		load();
+	}
+	struct mode_cache_entry *entry = find_entry(id);
+	free(id);
+	if (!entry) {
+		return false;
+	}
+	*record = entry->record;
+	return true;
+}
+
+void
+output_mode_cache_store(struct wlr_output *wlr_output)
+{
+	if (!wlr_output->enabled || wlr_output->width <= 0) {
+		return;
+	}
+	char *id = get_id(wlr_output);
+	if (!id) {
+		return;
+	}
+	if (!loaded) {
+		load();
+	}
+
+	struct output_mode_record record = {
+		.width = wlr_output->width,
+		.height = wlr_output->height,
+		.refresh = wlr_output->refresh,
+	};
+	struct mode_cache_entry *entry = find_entry(id);
+	if (entry) {
+		free(id);
+		if (!memcmp(&entry->record, &record, sizeof(record))) {
+			return;
+		}
+		wl_list_remove(&entry->link);
+	} else {
+		entry = znew(*entry);
+		entry->id = id;
+	}
+	entry->record = record;
+	wl_list_insert(&entries, &entry->link);
+
+	if (wl_list_length(&entries) > MODE_CACHE_MAX_ENTRIES) {
+		struct mode_cache_entry *oldest =
+			wl_container_of(entries.prev, oldest, link);
+		entry_destroy(oldest);
+	}
+	save();
+}
+
+void
+output_mode_cache_finish(void)
+{
+	struct mode_cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &entries, link) {
+		entry_destroy(entry);
+	}
+	loaded = false;
+}
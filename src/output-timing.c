@@ -0,0 +1,376 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * output-timing.c: opt-in per-output frame timing instrumentation
+ *
+ * Each output keeps a ring buffer of the last LAB_FRAME_TIMING_SAMPLES
+ * rendered frames with the time spent in each frame phase. A summary
+ * with percentiles is logged periodically and on the DumpFrameTiming
+ * action.
+ *
+ * Input events are tagged to the output they affect, and the time from the
+ * event timestamp to the next commit of that output is collected in a
+ * histogram per input device and output.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/types/wlr_input_device.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+#include "common/buf.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "config/rcxml.h"
+#include "labwc.h"
+#include "output-timing.h"
+#include "probe.h"
+
+static const char *phase_names[LAB_FRAME_PHASE_COUNT] = {
+	[LAB_FRAME_PHASE_WAIT] = "wait",
+	[LAB_FRAME_PHASE_BUILD] = "build",
+	[LAB_FRAME_PHASE_BUILD_GAMMA] = "build+lut",
+	[LAB_FRAME_PHASE_MAGNIFIER] = "magnifier",
+	[LAB_FRAME_PHASE_COMMIT] = "commit",
+	[LAB_FRAME_PHASE_TEARING] = "tearing",
+};
+
+static uint64_t
+timespec_diff_ns(const struct timespec *start, const struct timespec *end)
+{
+	int64_t ns = (int64_t)(end->tv_sec - start->tv_sec) * 1000000000
+		+ (end->tv_nsec - start->tv_nsec);
+	return ns > 0 ? (uint64_t)ns : 0;
+}
+
+static void
+add_ns(uint32_t *dst, uint64_t ns)
+{
+	uint64_t sum = (uint64_t)*dst + ns;
+	*dst = sum > UINT32_MAX ? UINT32_MAX : (uint32_t)sum;
+}
+
+static struct output_timing *
+get_timing(struct output *output)
+{
+	if (!output->timing) {
+		output->timing = znew(*output->timing);
+		wl_array_init(&output->timing->input_latency);
+	}
+	return output->timing;
+}
+
+void
+output_timing_frame_begin(struct output *output)
+{
+	if (!rc.frame_timing) {
+		return;
+	}
+	struct output_timing *timing = get_timing(output);
+	timing->current = (struct frame_timing_sample){0};
+	timing->recording = true;
+	timing->rendered = false;
+	clock_gettime(CLOCK_MONOTONIC, &timing->frame_start);
+	timing->phase_start = timing->frame_start;
+}
+
+void
+output_timing_phase_begin(struct output *output)
+{
+	struct output_timing *timing = output->timing;
+	if (!timing || !timing->recording) {
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &timing->phase_start);
+}
+
+void
+output_timing_phase_end(struct output *output, enum frame_phase phase)
+{
+	assert(phase < LAB_FRAME_PHASE_COUNT);
+	struct output_timing *timing = output->timing;
+	if (!timing || !timing->recording) {
+		return;
+	}
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	add_ns(&timing->current.ns[phase],
+		timespec_diff_ns(&timing->phase_start, &now));
+	timing->phase_start = now;
+	if (phase == LAB_FRAME_PHASE_BUILD
+			|| phase == LAB_FRAME_PHASE_BUILD_GAMMA) {
+		timing->rendered = true;
+	}
+}
+
+void
+output_timing_frame_end(struct output *output)
+{
+	struct output_timing *timing = output->timing;
+	if (!timing || !timing->recording) {
+		return;
+	}
+	timing->recording = false;
+	if (!timing->rendered) {
+		return;
+	}
+
+	timing->samples[timing->head] = timing->current;
+	timing->head = (timing->head + 1) % LAB_FRAME_TIMING_SAMPLES;
+	if (timing->count < LAB_FRAME_TIMING_SAMPLES) {
+		timing->count++;
+	}
+	timing->total++;
+
+	/* wlr_output->refresh is in mHz and 0 for outputs without a mode */
+	int refresh = output->wlr_output->refresh;
+	if (refresh <= 0) {
+		return;
+	}
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	uint64_t elapsed = timespec_diff_ns(&timing->frame_start, &now);
+	uint64_t period = 1000000000000ULL / (uint64_t)refresh;
+	if (elapsed > period) {
+		timing->missed++;
+		wlr_log(WLR_DEBUG, "%s: frame took %.2f ms (budget %.2f ms)",
+			output->wlr_output->name, elapsed / 1e6, period / 1e6);
+	}
+}
+
+static uint32_t
+now_msec(void)
+{
+	/* Input event timestamps are CLOCK_MONOTONIC truncated to 32 bits */
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)((uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+void
+output_timing_input_event(struct output *output,
+		struct wlr_input_device *device, uint32_t time_msec)
+{
+	if (!rc.frame_timing || !output) {
+		return;
+	}
+	struct output_timing *timing = get_timing(output);
+	const char *name = device->name ? device->name : "unknown";
+
+	struct input_latency *latency, *found = NULL;
+	wl_array_for_each(latency, &timing->input_latency) {
+		if (!strcmp(latency->device, name)) {
+			found = latency;
+			break;
+		}
+	}
+	if (!found) {
+		found = wl_array_add(&timing->input_latency, sizeof(*found));
+		if (!found) {
+			return;
+		}
+		*found = (struct input_latency){ .device = xstrdup(name) };
+	}
+	if (!found->pending) {
+		found->pending_msec = time_msec;
+		found->pending = true;
+	}
+}
+
+void
+output_timing_committed(struct output *output)
+{
+	struct output_timing *timing = output->timing;
+	if (!timing) {
+		return;
+	}
+	uint32_t now = now_msec();
+	struct input_latency *latency;
+	wl_array_for_each(latency, &timing->input_latency) {
+		if (!latency->pending) {
+			continue;
+		}
+		latency->pending = false;
+		/* Unsigned subtraction copes with the 32-bit wrap-around */
+		uint32_t ms = now - latency->pending_msec;
+		if (ms > INT32_MAX) {
+			/* Event timestamp from the future, e.g. virtual input */
+			continue;
+		}
+		latency->histogram[MIN(ms, LAB_INPUT_LATENCY_BUCKETS - 1)]++;
+		latency->count++;
+		latency->total_msec += ms;
+	}
+}
+
+void
+output_timing_destroy(struct output *output)
+{
+	struct output_timing *timing = output->timing;
+	if (!timing) {
+		return;
+	}
+	struct input_latency *latency;
+	wl_array_for_each(latency, &timing->input_latency) {
+		free(latency->device);
+	}
+	wl_array_release(&timing->input_latency);
+	zfree(output->timing);
+}
+
+static int
+compare_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of a sorted array, @permille in [0, 1000] */
+static uint32_t
+percentile(const uint32_t *sorted, size_t len, unsigned int permille)
+{
+	size_t rank = (len * permille + 999) / 1000;
+	return sorted[rank ? rank - 1 : 0];
+}
+
+/* Nearest-rank percentile of a histogram with 1ms buckets */
+static uint32_t
+histogram_percentile(const uint32_t *histogram, uint32_t count,
+		unsigned int permille)
+{
+	uint64_t rank = ((uint64_t)count * permille + 999) / 1000;
+	uint64_t sum = 0;
+	for (uint32_t ms = 0; ms < LAB_INPUT_LATENCY_BUCKETS; ms++) {
+		sum += histogram[ms];
+		if (sum >= rank && sum) {
+			return ms;
+		}
+	}
+	return LAB_INPUT_LATENCY_BUCKETS - 1;
+}
+
+static void
+log_latency_percentile(struct buf *buf, const char *label,
+		const struct input_latency *latency, unsigned int permille)
+{
+	uint32_t ms = histogram_percentile(latency->histogram,
+		latency->count, permille);
+	buf_add_fmt(buf, " %s=%s%ums", label,
+		ms == LAB_INPUT_LATENCY_BUCKETS - 1 ? ">=" : "", ms);
+}
+
+static void
+log_input_latency(struct output *output)
+{
+	struct output_timing *timing = output->timing;
+	struct input_latency *latency;
+	wl_array_for_each(latency, &timing->input_latency) {
+		if (!latency->count) {
+			continue;
+		}
+		struct buf buf = BUF_INIT;
+		log_latency_percentile(&buf, "p50", latency, 500);
+		log_latency_percentile(&buf, "p99", latency, 990);
+		log_latency_percentile(&buf, "p999", latency, 999);
+		wlr_log(WLR_INFO, "  input latency of '%s' (%u events):%s",
+			latency->device, latency->count, buf.data);
+		buf_reset(&buf);
+	}
+}
+
+static void
+log_output_summary(struct output *output, uint32_t *scratch)
+{
+	struct output_timing *timing = output->timing;
+	if (!timing || !timing->count) {
+		return;
+	}
+
+	wlr_log(WLR_INFO, "frame timing for %s: %zu samples, "
+		"%u of %u frames over budget", output->wlr_output->name,
+		timing->count, timing->missed, timing->total);
+
+	for (size_t phase = 0; phase < LAB_FRAME_PHASE_COUNT; phase++) {
+		for (size_t i = 0; i < timing->count; i++) {
+			scratch[i] = timing->samples[i].ns[phase];
+		}
+		qsort(scratch, timing->count, sizeof(*scratch), compare_u32);
+		wlr_log(WLR_INFO, "  %-9s p50=%.3fms p99=%.3fms p999=%.3fms",
+			phase_names[phase],
+			percentile(scratch, timing->count, 500) / 1e6,
+			percentile(scratch, timing->count, 990) / 1e6,
+			percentile(scratch, timing->count, 999) / 1e6);
+	}
+	log_input_latency(output);
+}
+
+void
+output_timing_log_summary(struct server *server)
+{
+	if (!rc.frame_timing) {
+		wlr_log(WLR_INFO, "frame timing is disabled, "
+			"enable it with <core><frameTiming>");
+		return;
+	}
+
+	uint32_t *scratch = znew_n(*scratch, LAB_FRAME_TIMING_SAMPLES);
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		log_output_summary(output, scratch);
+	}
+	free(scratch);
+	probe_log_summary();
+}
+
+static int
+handle_summary_timer(void *data)
+{
+	struct server *server = data;
+	output_timing_log_summary(server);
+	wl_event_source_timer_update(server->frame_timing_timer,
+		rc.frame_timing_log_interval * 1000);
+	return 0;
+}
+
+static void
+arm_summary_timer(struct server *server)
+{
+	int interval = 0;
+	if (rc.frame_timing && rc.frame_timing_log_interval > 0) {
+		interval = rc.frame_timing_log_interval * 1000;
+	}
+	/* A timeout of 0 disarms the timer */
+	wl_event_source_timer_update(server->frame_timing_timer, interval);
+}
+
+void
+output_timing_init(struct server *server)
+{
+	server->frame_timing_timer = wl_event_loop_add_timer(
+		server->wl_event_loop, handle_summary_timer, server);
+	arm_summary_timer(server);
+}
+
+void
+output_timing_reconfigure(struct server *server)
+{
+	if (!rc.frame_timing) {
+		struct output *output;
+		wl_list_for_each(output, &server->outputs, link) {
+			output_timing_destroy(output);
+		}
+		probe_reset();
+	}
+	arm_summary_timer(server);
+}
+
+void
+output_timing_finish(struct server *server)
+{
+	if (server->frame_timing_timer) {
+		wl_event_source_remove(server->frame_timing_timer);
+		server->frame_timing_timer = NULL;
+	}
+}
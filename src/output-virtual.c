@@ -1,18 +1,57 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/backend/headless.h>
 #include <wlr/types/wlr_output.h>
 #include "common/string-helpers.h"
 #include "labwc.h"
+#include "output-state.h"
 #include "output-virtual.h"
 
 static struct wlr_output *fallback_output = NULL;
 
+#define VIRTUAL_OUTPUT_DEFAULT_WIDTH 1920
+#define VIRTUAL_OUTPUT_DEFAULT_HEIGHT 1080
+
+/*
+ * The headless backend creates outputs with a fixed refresh rate of 60Hz
+ * and drives their frame events from a timer, so a custom rate is applied
+ * by a modeset once labwc has set up the new output.
+ */
+static void
+set_refresh(struct server *server, struct wlr_output *wlr_output,
+		const struct virtual_output_mode *mode)
+{
+	struct output *output = output_from_wlr_output(server, wlr_output);
+	if (!output) {
+		return;
+	}
+	wlr_output_state_set_custom_mode(&output->pending,
+		mode->width, mode->height, mode->refresh);
+	if (wlr_output->enabled) {
+		output_state_commit(output);
+	}
+}
+
 void
 output_virtual_add(struct server *server, const char *output_name,
+		const struct virtual_output_mode *mode,
 		struct wlr_output **store_wlr_output)
 {
+	struct virtual_output_mode virtual_mode = {
+		.width = VIRTUAL_OUTPUT_DEFAULT_WIDTH,
+		.height = VIRTUAL_OUTPUT_DEFAULT_HEIGHT,
+	};
+	if (mode) {
+		virtual_mode = *mode;
+	}
+	if (virtual_mode.width <= 0 || virtual_mode.height <= 0) {
+		wlr_log(WLR_ERROR, "invalid virtual output size %dx%d",
+			virtual_mode.width, virtual_mode.height);
+		return;
+	}
+
 	if (output_name) {
 		/* Prevent creating outputs with the same name */
 		struct output *output;
@@ -50,7 +89,7 @@ output_virtual_add(struct server *server, const char *output_name,
 	wl_list_remove(&server->new_output.link);
 
 	struct wlr_output *wlr_output = wlr_headless_add_output(
-		server->headless.backend, 1920, 1080);
+		server->headless.backend, virtual_mode.width, virtual_mode.height);
 
 	if (!wlr_output) {
 		wlr_log(WLR_ERROR, "Failed to create virtual output %s",
@@ -70,6 +109,9 @@ output_virtual_add(struct server *server, const char *output_name,
 	if (server->new_output.notify) {
 		server->new_output.notify(&server->new_output, wlr_output);
 	}
+	if (virtual_mode.refresh > 0) {
+		set_refresh(server, wlr_output, &virtual_mode);
+	}
 
 restore_handler:
 	/* And finally restore output notifications */
@@ -106,6 +148,59 @@ output_virtual_remove(struct server *server, const char *output_name)
 	}
 }
 
+/*
+ * Name of the @index-th output of a batch, with the first "%d" of
+ * @name_template replaced by @index or, without one, "-<index>" appended.
+ * The template is never used as a format string as it comes from rc.xml.
+ */
+static char *
+batch_name(const char *name_template, int index)
+{
+	const char *d = strstr(name_template, "%d");
+	if (!d) {
+		return strdup_printf("%s-%d", name_template, index);
+	}
+	return strdup_printf("%.*s%d%s", (int)(d - name_template),
+		name_template, index, d + 2);
+}
+
+void
+output_virtual_add_many(struct server *server, const char *name_template,
+		int count, const struct virtual_output_mode *mode)
+{
+	if (count == 1) {
+		output_virtual_add(server, name_template, mode, NULL);
+		return;
+	}
+
+	/* Views are rearranged once, for the final layout */
+	output_layout_change_begin(server);
+	for (int i = 1; i <= count; i++) {
+		char *name = name_template ? batch_name(name_template, i) : NULL;
+		output_virtual_add(server, name, mode, NULL);
+		free(name);
+	}
+	output_layout_change_end(server);
+}
+
+void
+output_virtual_remove_many(struct server *server, const char *name_template,
+		int count)
+{
+	if (count == 1) {
+		output_virtual_remove(server, name_template);
+		return;
+	}
+
+	output_layout_change_begin(server);
+	for (int i = 1; i <= count; i++) {
+		char *name = name_template ? batch_name(name_template, i) : NULL;
+		output_virtual_remove(server, name);
+		free(name);
+	}
+	output_layout_change_end(server);
+}
+
 void
 output_virtual_update_fallback(struct server *server)
 {
@@ -116,7 +211,8 @@ output_virtual_update_fallback(struct server *server)
 			&& !string_null_or_empty(fallback_output_name)) {
 		wlr_log(WLR_DEBUG, "adding fallback output %s", fallback_output_name);
 
-		output_virtual_add(server, fallback_output_name, &fallback_output);
+		output_virtual_add(server, fallback_output_name,
+			/* mode */ NULL, &fallback_output);
 	} else if (fallback_output && (wl_list_length(layout_outputs) > 1
 			|| string_null_or_empty(fallback_output_name))) {
 		wlr_log(WLR_DEBUG, "destroying fallback output %s",
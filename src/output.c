@@ -8,9 +8,13 @@
 
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 #include <wlr/backend/drm.h>
 #include <wlr/backend/wayland.h>
+#include <wlr/render/color.h>
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_drm_lease_v1.h>
 #include <wlr/types/wlr_output.h>
@@ -18,25 +22,44 @@
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/region.h>
 #include <wlr/util/log.h>
+#include "animation.h"
+#include "capture.h"
+#include "common/array.h"
 #include "common/direction.h"
 #include "common/macros.h"
 #include "common/mem.h"
 #include "common/scene-helpers.h"
+#include "hud.h"
+#include "input/gestures.h"
 #include "labwc.h"
 #include "layers.h"
 #include "node.h"
+#include "output-mode-cache.h"
 #include "output-state.h"
+#include "output-timing.h"
 #include "output-virtual.h"
+#include "overview.h"
+#include "placement.h"
 #include "protocols/cosmic-workspaces.h"
 #include "protocols/ext-workspace.h"
+#include "protocols/rate-limit.h"
 #include "regions.h"
+#include "trace.h"
 #include "view.h"
+#include "window-rules.h"
 #include "xwayland.h"
 
+/*
+ * Backends report monitors waking up from power saving as a burst of
+ * mode, enable and position changes. They are handled as one.
+ */
+#define OUTPUT_LAYOUT_CHANGE_DEBOUNCE_MSEC 30
+
 bool
 output_get_tearing_allowance(struct output *output)
 {
 	struct server *server = output->server;
+	output->tearing.needs_scanout = false;
 
 	/* never allow tearing when disabled */
 	if (!rc.allow_tearing) {
@@ -50,13 +73,30 @@ output_get_tearing_allowance(struct output *output)
 		return false;
 	}
 
-	/* allow tearing for any window when requested or forced */
-	if (rc.allow_tearing == LAB_TEARING_ENABLED) {
-		if (view->force_tearing == LAB_STATE_UNSPECIFIED) {
-			return view->tearing_hint;
-		} else {
-			return view->force_tearing == LAB_STATE_ENABLED;
+	/* back off while tearing page-flips keep failing */
+	if (tearing_is_suspended(output)) {
+		return false;
+	}
+
+	/* honor tearing as requested by action */
+	if (view->force_tearing != LAB_STATE_UNSPECIFIED) {
+		/* only full-screen windows unless allowed for any window */
+		if (rc.allow_tearing != LAB_TEARING_ENABLED && !view->fullscreen) {
+			return false;
 		}
+		return view->force_tearing == LAB_STATE_ENABLED;
+	}
+
+	/* the window rule overrides the tearing hint, e.g. for video */
+	enum property rule = window_rules_get_property(view, "tearing");
+	if (rule == LAB_PROP_FALSE) {
+		return false;
+	}
+
+	/* honor the tearing hint, for any window if allowed for any */
+	if (view->tearing_hint && (view->fullscreen
+			|| rc.allow_tearing == LAB_TEARING_ENABLED)) {
+		return true;
 	}
 
 	/* remaining tearing options apply only to full-screen windows */
@@ -64,14 +104,52 @@ output_get_tearing_allowance(struct output *output)
 		return false;
 	}
 
-	if (view->force_tearing == LAB_STATE_UNSPECIFIED) {
-		/* honor the tearing hint or the fullscreen-force preference */
-		return view->tearing_hint ||
-			rc.allow_tearing == LAB_TEARING_FULLSCREEN_FORCED;
+	if (rc.allow_tearing == LAB_TEARING_FULLSCREEN_FORCED) {
+		return true;
 	}
 
-	/* honor tearing as requested by action */
-	return view->force_tearing == LAB_STATE_ENABLED;
+	/* latency-critical windows without a hint, if scanned out */
+	if (rule == LAB_PROP_TRUE) {
+		output->tearing.needs_scanout = true;
+		return true;
+	}
+	return false;
+}
+
+static void
+output_set_gamma_transform(struct output *output,
+		struct wlr_color_transform *transform)
+{
+	if (!output->gamma_transform && !transform) {
+		return;
+	}
+	wlr_color_transform_unref(output->gamma_transform);
+	output->gamma_transform = transform;
+	if (output->scene_output) {
+		lab_wlr_scene_output_damage_whole(output->scene_output);
+	}
+}
+
+/*
+ * Let the renderer apply the LUT if the output does not support hardware
+ * gamma, instead of failing the client
+ */
+static bool
+output_apply_software_gamma(struct output *output,
+		struct wlr_gamma_control_v1 *gamma_control)
+{
+	struct wlr_color_transform *transform =
+		wlr_gamma_control_v1_get_color_transform(gamma_control);
+	if (gamma_control && !transform) {
+		return false;
+	}
+	if (!output->gamma_transform) {
+		wlr_log(WLR_INFO, "no hardware gamma support on %s, "
+			"applying the gamma LUT in the renderer",
+			output->wlr_output->name);
+	}
+	output_set_gamma_transform(output, transform);
+	return true;
 }
 
 static void
@@ -97,6 +175,15 @@ output_apply_gamma(struct output *output)
 		return;
 	}
 
+	if (!wlr_output_test_state(output->wlr_output, &pending)) {
+		wlr_output_state_finish(&pending);
+		if (!output_apply_software_gamma(output, gamma_control)) {
+			wlr_gamma_control_v1_send_failed_and_destroy(gamma_control);
+		}
+		return;
+	}
+
+	output_set_gamma_transform(output, NULL);
 	if (!lab_wlr_scene_output_commit(scene_output, &pending)) {
 		wlr_gamma_control_v1_send_failed_and_destroy(gamma_control);
 	}
@@ -104,14 +191,386 @@ output_apply_gamma(struct output *output)
 	wlr_output_state_finish(&pending);
 }
 
+/*
+ * Add the new gamma LUT to the regular pending output state so that it is
+ * applied together with the next content frame. Returns false if the
+ * combined state does not pass an output test, in which case the caller
+ * falls back to output_apply_gamma().
+ */
+static bool
+output_merge_gamma(struct output *output)
+{
+	assert(output->gamma_lut_changed);
+
+	struct wlr_gamma_control_v1 *gamma_control =
+		wlr_gamma_control_manager_v1_get_control(
+			output->server->gamma_control_manager_v1,
+			output->wlr_output);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	if (!wlr_output_state_copy(&state, &output->pending)
+			|| !wlr_gamma_control_v1_apply(gamma_control, &state)
+			|| !wlr_output_test_state(output->wlr_output, &state)) {
+		wlr_output_state_finish(&state);
+		return false;
+	}
+
+	wlr_output_state_finish(&output->pending);
+	output->pending = state;
+	output->gamma_lut_changed = false;
+	output_set_gamma_transform(output, NULL);
+	return true;
+}
+
+static int64_t
+timespec_to_nsec(const struct timespec *ts)
+{
+	return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
 static void
-output_frame_notify(struct wl_listener *listener, void *data)
+output_record_render_cost(struct output *output, int64_t nsec)
+{
+	output->repaint.cost_nsec[output->repaint.cost_head] =
+		MIN(nsec, (int64_t)UINT32_MAX);
+	output->repaint.cost_head = (output->repaint.cost_head + 1)
+		% ARRAY_SIZE(output->repaint.cost_nsec);
+}
+
+/*
+ * Returns the time in nanoseconds to reserve for rendering and committing
+ * a frame. With <maxRenderTime>auto</maxRenderTime> this is the worst
+ * render cost of the recent frames plus one millisecond of slack.
+ */
+static int64_t
+output_render_budget_nsec(struct output *output)
+{
+	if (rc.max_render_time > 0) {
+		return (int64_t)rc.max_render_time * 1000000;
+	}
+	int64_t max = 0;
+	for (size_t i = 0; i < ARRAY_SIZE(output->repaint.cost_nsec); i++) {
+		max = MAX(max, (int64_t)output->repaint.cost_nsec[i]);
+	}
+	return max + 1000000;
+}
+
+/*
+ * Returns the number of milliseconds the repaint can be delayed so that
+ * it still finishes before the next vblank, or 0 to repaint immediately.
+ */
+static int
+output_repaint_delay_msec(struct output *output)
+{
+	if (!rc.max_render_time || !output->repaint.refresh_nsec
+			|| !output->repaint.last_present_nsec) {
+		return 0;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t until_refresh = output->repaint.last_present_nsec
+		+ output->repaint.refresh_nsec - timespec_to_nsec(&now);
+	int64_t delay = until_refresh - output_render_budget_nsec(output);
+
+	/* wl_event_loop timers have millisecond resolution */
+	return delay < 1000000 ? 0 : (int)(delay / 1000000);
+}
+
+/*
+ * Returns the fullscreen view covering all of @output with opaque content
+ * if it is not covered by any other view, NULL otherwise.
+ */
+static struct view *
+output_get_occluding_view(struct output *output)
+{
+	struct view *top = NULL;
+	struct view *view;
+	for_each_view(view, &output->server->views,
+			LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+		if (view->minimized || !view_on_output(view, output)) {
+			continue;
+		}
+		if (!top) {
+			top = view;
+		} else if (view_is_always_on_top(view)) {
+			/* Always-on-top views are shown above fullscreen ones */
+			return NULL;
+		}
+	}
+	if (!top || !top->fullscreen || top->output != output || !top->surface) {
+		return NULL;
+	}
+
+	struct wlr_box box;
+	wlr_output_layout_get_box(output->server->output_layout,
+		output->wlr_output, &box);
+	if (top->current.x > box.x || top->current.y > box.y
+			|| top->current.x + top->current.width < box.x + box.width
+			|| top->current.y + top->current.height < box.y + box.height) {
+		return NULL;
+	}
+
+	struct wlr_surface *surface = top->surface;
+	pixman_box32_t extents = {
+		.x2 = surface->current.width,
+		.y2 = surface->current.height,
+	};
+	if (pixman_region32_contains_rectangle(&surface->opaque_region,
+			&extents) != PIXMAN_REGION_IN) {
+		return NULL;
+	}
+	return top;
+}
+
+static bool
+content_hidden(struct server *server)
+{
+	return server->session_lock_manager
+		&& server->session_lock_manager->content_hidden;
+}
+
+static void
+set_lower_layers_enabled(struct output *output, bool enabled)
+{
+	wlr_scene_node_set_enabled(&output->layer_tree[
+		ZWLR_LAYER_SHELL_V1_LAYER_BACKGROUND]->node, enabled);
+	wlr_scene_node_set_enabled(&output->layer_tree[
+		ZWLR_LAYER_SHELL_V1_LAYER_BOTTOM]->node, enabled);
+}
+
+static void
+restore_culled(struct output *output)
+{
+	if (!output->culled_by) {
+		return;
+	}
+	output->culled_by = NULL;
+
+	/* The session lock enables the layers again when it is unlocked */
+	if (!content_hidden(output->server)) {
+		set_lower_layers_enabled(output, true);
+	}
+	struct view *view;
+	wl_list_for_each(view, &output->server->views, link) {
+		if (view->culled_on != output) {
+			continue;
+		}
+		view->culled_on = NULL;
+		if (view->mapped && !view->minimized) {
+			wlr_scene_node_set_enabled(&view->scene_tree->node, true);
+		}
+	}
+}
+
+void
+output_update_culling(struct output *output, bool force)
+{
+	struct view *occluder = NULL;
+	if (output_is_usable(output) && !content_hidden(output->server)) {
+		occluder = output_get_occluding_view(output);
+	}
+	if (occluder == output->culled_by && !force) {
+		return;
+	}
+	restore_culled(output);
+	if (!occluder) {
+		return;
+	}
+
+	output->culled_by = occluder;
+	set_lower_layers_enabled(output, false);
+	uint64_t output_mask = output_get_mask(output);
+	struct view *view;
+	for_each_view(view, &output->server->views,
+			LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+		/* Views reaching into other outputs are still visible there */
+		if (view == occluder || view->minimized
+				|| view->outputs != output_mask) {
+			continue;
+		}
+		wlr_scene_node_set_enabled(&view->scene_tree->node, false);
+		view->culled_on = output;
+	}
+}
+
+struct frame_done_ctx {
+	struct wlr_scene_output *scene_output;
+	struct timespec *now;
+	struct wl_array occluded;  /* struct wlr_scene_node * */
+	bool send_occluded;
+	/* Trees of views capped by maxFps which get no event this time */
+	struct wl_array capped;  /* struct wlr_scene_node * */
+};
+
+static bool
+array_has_node(struct wl_array *nodes, struct wlr_scene_node *node)
+{
+	struct wlr_scene_node **item;
+	wl_array_for_each(item, nodes) {
+		if (*item == node) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void
+send_frame_done(struct wlr_scene_node *node, struct frame_done_ctx *ctx,
+		bool occluded)
+{
+	/* Culled trees are disabled but still get the throttled events */
+	if (node->type == WLR_SCENE_NODE_TREE
+			&& array_has_node(&ctx->capped, node)) {
+		return;
+	}
+	if (!occluded && node->type == WLR_SCENE_NODE_TREE
+			&& array_has_node(&ctx->occluded, node)) {
+		if (!ctx->send_occluded) {
+			return;
+		}
+		occluded = true;
+	} else if (!node->enabled) {
+		return;
+	}
+
+	if (node->type == WLR_SCENE_NODE_BUFFER) {
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+		/*
+		 * wlroots does not assign a primary output to buffers
+		 * which are not visible anywhere, so also consider those
+		 * when sending the throttled frame events.
+		 */
+		if (buffer->primary_output == ctx->scene_output
+				|| (occluded && !buffer->primary_output)) {
+			wlr_scene_buffer_send_frame_done(buffer, ctx->now);
+		}
+		return;
+	}
+	if (node->type != WLR_SCENE_NODE_TREE) {
+		return;
+	}
+
+	struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &tree->children, link) {
+		send_frame_done(child, ctx, occluded);
+	}
+}
+
+/* Frame rate cap of @view by window rule, 0 if there is none */
+static double
+view_max_fps(struct view *view)
+{
+	double fps = 0;
+	if (view != view->server->active_view) {
+		fps = window_rules_get_value(view,
+			LAB_WINDOW_RULE_VALUE_MAX_FPS_UNFOCUSED);
+	}
+	if (!fps) {
+		fps = window_rules_get_value(view, LAB_WINDOW_RULE_VALUE_MAX_FPS);
+	}
+	return fps;
+}
+
+/*
+ * Collects the views on @output whose maxFps interval has not passed.
+ * The interval is counted on view->output only; on other outputs capped
+ * views never get an event, like any view they are not primary on.
+ */
+static void
+collect_capped_views(struct output *output, int64_t now_nsec,
+		struct wl_array *capped)
+{
+	uint64_t output_mask = output_get_mask(output);
+	/* Frame events come once per refresh, don't miss one by jitter */
+	int64_t slack = output->repaint.refresh_nsec / 2;
+	struct view *view;
+	wl_list_for_each(view, &output->server->views, link) {
+		if (!view->mapped || !(view->outputs & output_mask)) {
+			continue;
+		}
+		double fps = view_max_fps(view);
+		if (!fps) {
+			continue;
+		}
+		int64_t interval = 1e9 / fps;
+		if (view->output == output && now_nsec
+				- view->last_frame_done_nsec >= interval - slack) {
+			view->last_frame_done_nsec = now_nsec;
+		} else {
+			array_add(capped, &view->scene_tree->node);
+		}
+	}
+}
+
+/*
+ * Views entirely covered by an opaque fullscreen view only get a frame
+ * event once a second, so that they don't keep rendering at full speed
+ * without ever being shown. Minimized views are disabled in the scene
+ * and don't get frame events at all. Views with a maxFps window rule get
+ * them at most at that rate.
+ */
+static void
+output_send_frame_done(struct output *output, struct timespec *now)
+{
+	struct wlr_scene_output *scene_output = output->scene_output;
+	int64_t now_nsec = timespec_to_nsec(now);
+	struct frame_done_ctx ctx = {
+		.scene_output = scene_output,
+		.now = now,
+	};
+	wl_array_init(&ctx.occluded);
+	wl_array_init(&ctx.capped);
+	collect_capped_views(output, now_nsec, &ctx.capped);
+
+	struct view *occluder = output_get_occluding_view(output);
+	if (!occluder && !ctx.capped.size) {
+		wlr_scene_output_send_frame_done(scene_output, now);
+		return;
+	}
+	if (!occluder) {
+		send_frame_done(&output->server->scene->tree.node, &ctx, false);
+		wl_array_release(&ctx.capped);
+		return;
+	}
+
+	uint64_t output_mask = 1ull << scene_output->WLR_PRIVATE.index;
+	struct view *view;
+	wl_list_for_each(view, &output->server->views, link) {
+		if (view != occluder && view->mapped && !view->minimized
+				&& view->outputs == output_mask) {
+			array_add(&ctx.occluded, &view->scene_tree->node);
+		}
+	}
+	if (output->culled_by) {
+		array_add(&ctx.occluded, &output->layer_tree[
+			ZWLR_LAYER_SHELL_V1_LAYER_BACKGROUND]->node);
+		array_add(&ctx.occluded, &output->layer_tree[
+			ZWLR_LAYER_SHELL_V1_LAYER_BOTTOM]->node);
+	}
+
+	if (now_nsec - output->occluded_frame_done_nsec >= 1000000000) {
+		output->occluded_frame_done_nsec = now_nsec;
+		ctx.send_occluded = true;
+	}
+
+	send_frame_done(&output->server->scene->tree.node, &ctx, false);
+	wl_array_release(&ctx.occluded);
+	wl_array_release(&ctx.capped);
+}
+
+static bool
+output_vrr_active(struct output *output)
+{
+	return output->wlr_output->adaptive_sync_status
+		== WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED;
+}
+
+static void
+output_repaint(struct output *output)
 {
-	/*
-	 * This function is called every time an output is ready to display a
-	 * frame - which is typically at 60 Hz.
-	 */
-	struct output *output = wl_container_of(listener, output, frame);
 	if (!output_is_usable(output)) {
 		return;
 	}
@@ -134,13 +593,21 @@ output_frame_notify(struct wl_listener *listener, void *data)
 		return;
 	}
 
-	if (output->gamma_lut_changed) {
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	uint32_t commit_seq = output->wlr_output->commit_seq;
+
+	/* A repeated frame is no activity of the output */
+	bool repeat = output->repaint.repeat && !pixman_region32_not_empty(
+		&output->scene_output->WLR_PRIVATE.pending_commit_damage);
+	output->repaint.repeat = false;
+
+	if (output->gamma_lut_changed && !output_merge_gamma(output)) {
 		/*
-		 * We are not mixing the gamma state with
-		 * other pending output changes to make it
-		 * easier to handle a failed output commit
-		 * due to gamma without impacting other
-		 * unrelated output changes.
+		 * The gamma state could not be combined with the
+		 * other pending output changes, so commit it on its
+		 * own to handle a failure due to gamma without
+		 * impacting other unrelated output changes.
 		 */
 		output_apply_gamma(output);
 	} else {
@@ -148,13 +615,388 @@ output_frame_notify(struct wl_listener *listener, void *data)
 		struct wlr_output_state *pending = &output->pending;
 
 		pending->tearing_page_flip = output_get_tearing_allowance(output);
+		output_update_culling(output, /*force*/ false);
 
 		lab_wlr_scene_output_commit(scene_output, pending);
 	}
 
+	output_timing_frame_end(output);
+
 	struct timespec now = { 0 };
 	clock_gettime(CLOCK_MONOTONIC, &now);
-	wlr_scene_output_send_frame_done(output->scene_output, &now);
+	if (output->wlr_output->commit_seq != commit_seq) {
+		output_record_render_cost(output,
+			timespec_to_nsec(&now) - timespec_to_nsec(&start));
+		output->repaint.commit_start_nsec = timespec_to_nsec(&start);
+		if (!repeat) {
+			output->idle.last_active_nsec = timespec_to_nsec(&now);
+		}
+		if (output_vrr_active(output) && rc.adaptive_sync_min_refresh
+				&& !output->idle.active) {
+			wl_event_source_timer_update(
+				output->repaint.min_refresh_timer,
+				MAX(1000 / rc.adaptive_sync_min_refresh, 1));
+		}
+	}
+	output_send_frame_done(output, &now);
+}
+
+static struct idle_output_config *
+output_idle_config(struct output *output)
+{
+	struct idle_output_config *config, *match = NULL;
+	wl_list_for_each(config, &rc.idle_outputs, link) {
+		if (!config->output || !strcasecmp(config->output,
+				output->wlr_output->name)) {
+			/* Later entries take precedence */
+			match = config;
+		}
+	}
+	if (match && match->policy == LAB_IDLE_OUTPUT_NONE) {
+		return NULL;
+	}
+	return match;
+}
+
+static void
+output_idle_arm(struct output *output, int timeout_sec)
+{
+	wl_event_source_timer_update(output->idle.timer, timeout_sec * 1000);
+}
+
+static void
+output_idle_wake(struct output *output)
+{
+	if (!output->idle.active) {
+		return;
+	}
+	output->idle.active = false;
+	wlr_log(WLR_DEBUG, "output %s is no longer idle",
+		output->wlr_output->name);
+
+	struct idle_output_config *config = output_idle_config(output);
+	if (output->idle.restore_adaptive_sync) {
+		/* Committed together with the next frame */
+		output->idle.restore_adaptive_sync = false;
+		output_enable_adaptive_sync(output, false);
+		wlr_output_schedule_frame(output->wlr_output);
+	}
+	if (config) {
+		output_idle_arm(output, config->timeout);
+	}
+}
+
+static int
+handle_idle_timer(void *data)
+{
+	struct output *output = data;
+	struct idle_output_config *config = output_idle_config(output);
+	if (!config || !output_is_usable(output)) {
+		return 0;
+	}
+
+	/* Activity since the timer was armed postpones the timeout */
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t idle_nsec = timespec_to_nsec(&now) - output->idle.last_active_nsec;
+	int64_t timeout_nsec = (int64_t)config->timeout * 1000000000;
+	if (idle_nsec < timeout_nsec) {
+		wl_event_source_timer_update(output->idle.timer,
+			MAX(1, (timeout_nsec - idle_nsec) / 1000000));
+		return 0;
+	}
+
+	wlr_log(WLR_DEBUG, "output %s is idle", output->wlr_output->name);
+	output->idle.active = true;
+	if (config->policy == LAB_IDLE_OUTPUT_MIN_REFRESH
+			&& output->wlr_output->adaptive_sync_status
+				!= WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED) {
+		/* Let the display drop to its minimum refresh rate */
+		output_enable_adaptive_sync(output, true);
+		output_state_commit(output);
+		output->idle.restore_adaptive_sync =
+			output->wlr_output->adaptive_sync_status
+				== WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED;
+	}
+	return 0;
+}
+
+void
+output_idle_reconfigure(struct server *server)
+{
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		output_idle_wake(output);
+		struct idle_output_config *config = output_idle_config(output);
+		output_idle_arm(output, config ? config->timeout : 0);
+	}
+}
+
+/*
+ * With adaptive sync the panel waits for the next frame as long as its
+ * minimum refresh rate allows, and flickers on some panels if frames come
+ * much slower. Repeat the last frame before that happens.
+ */
+static int
+handle_min_refresh_timer(void *data)
+{
+	struct output *output = data;
+	if (output_is_usable(output) && output_vrr_active(output)
+			&& !output->idle.active) {
+		output->repaint.repeat = true;
+		wlr_output_update_needs_frame(output->wlr_output);
+	}
+	return 0;
+}
+
+static int
+handle_repaint_timer(void *data)
+{
+	struct output *output = data;
+	output->repaint.scheduled = false;
+	output_repaint(output);
+	return 0;
+}
+
+static int64_t
+output_next_vblank_nsec(struct output *output)
+{
+	if (!output->repaint.last_present_nsec) {
+		return 0;
+	}
+	return output->repaint.last_present_nsec + output->repaint.refresh_nsec;
+}
+
+static void
+handle_repaint_queue(void *data)
+{
+	struct server *server = data;
+	server->repaint_idle = NULL;
+
+	struct output *output, *tmp;
+	wl_list_for_each_safe(output, tmp, &server->repaint_queue,
+			repaint.link) {
+		wl_list_remove(&output->repaint.link);
+		wl_list_init(&output->repaint.link);
+		output->repaint.scheduled = false;
+		output_repaint(output);
+	}
+}
+
+/*
+ * Frame events of several outputs are often emitted from a single
+ * dispatch of the backend. With <core><repaintQueue> the repaints are
+ * deferred until all of them have been received and then run in order
+ * of their next vblank, so a slow output doesn't delay outputs with an
+ * earlier deadline.
+ */
+static void
+output_queue_repaint(struct output *output)
+{
+	struct server *server = output->server;
+	int64_t deadline = output_next_vblank_nsec(output);
+
+	struct wl_list *prev = &server->repaint_queue;
+	struct output *queued;
+	wl_list_for_each(queued, &server->repaint_queue, repaint.link) {
+		if (output_next_vblank_nsec(queued) > deadline) {
+			break;
+		}
+		prev = &queued->repaint.link;
+	}
+	wl_list_insert(prev, &output->repaint.link);
+	output->repaint.scheduled = true;
+
+	if (!server->repaint_idle) {
+		server->repaint_idle = wl_event_loop_add_idle(
+			server->wl_event_loop, handle_repaint_queue, server);
+	}
+}
+
+static void
+output_frame_notify(struct wl_listener *listener, void *data)
+{
+	TRACE_FUNC();
+	/*
+	 * This function is called every time an output is ready to display a
+	 * frame - which is typically at 60 Hz.
+	 */
+	struct output *output = wl_container_of(listener, output, frame);
+	if (rc.motion_coalesce == LAB_MOTION_COALESCE_OUTPUT_FRAME) {
+		cursor_flush_motion(&output->server->seat);
+	}
+	gestures_output_frame(&output->server->seat);
+	animations_output_frame(output->server);
+	flush_usable_area(output);
+	/* Before rendering, whatever the order of the events was */
+	deferred_queue_flush(&output->server->deferred);
+	if (output->repaint.scheduled || !output_is_usable(output)) {
+		return;
+	}
+
+	if (transaction_blocks_output(output)) {
+		/*
+		 * Keep showing the old layout, but let clients draw the
+		 * new one. A frame is scheduled when the transaction is done.
+		 */
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		output_send_frame_done(output, &now);
+		return;
+	}
+
+	if (output->idle.active) {
+		bool damaged = output->wlr_output->needs_frame
+			|| (output->scene_output && pixman_region32_not_empty(
+				&output->scene_output->WLR_PRIVATE.pending_commit_damage));
+		struct idle_output_config *config = output_idle_config(output);
+		if (!damaged && config && config->policy == LAB_IDLE_OUTPUT_STOP) {
+			/*
+			 * Frame requests without any damage don't wake
+			 * the output, so clients polling for frame events
+			 * are stopped until there is something to show.
+			 */
+			output->metrics.frames_skipped++;
+			return;
+		}
+		if (damaged) {
+			output_idle_wake(output);
+		}
+	}
+
+	output_timing_frame_begin(output);
+
+	/*
+	 * With adaptive sync there is no vblank to wait for: the frame event
+	 * follows the damage, e.g. the new buffer of a fullscreen game, and
+	 * the frame is presented as soon as it is committed.
+	 */
+	if (output_vrr_active(output)) {
+		output_repaint(output);
+		return;
+	}
+
+	/*
+	 * With <maxRenderTime> set, delay the repaint until just before the
+	 * next vblank so that the frame and the frame_done events sent to
+	 * clients are based on the most recent state.
+	 */
+	int delay = output_repaint_delay_msec(output);
+	if (delay > 0) {
+		output->repaint.scheduled = true;
+		wl_event_source_timer_update(output->repaint.timer, delay);
+		return;
+	}
+
+	if (rc.repaint_queue) {
+		output_queue_repaint(output);
+		return;
+	}
+
+	output_repaint(output);
+}
+
+/*
+ * Accounts the presentation of a frame to the pacing metrics of @output.
+ * Only frames rendered by output_repaint() are compared against the vblank
+ * grid, the previous presentation time is that of any frame.
+ */
+static void
+output_account_present(struct output *output,
+		struct wlr_output_event_present *event)
+{
+	struct output_metrics *metrics = &output->metrics;
+	int64_t when = timespec_to_nsec(&event->when);
+	int64_t commit = output->repaint.commit_start_nsec;
+	int64_t last = output->repaint.last_present_nsec;
+
+	metrics->frames_presented++;
+	if (!commit) {
+		return;
+	}
+	if (when > commit) {
+		metrics->latency_ns_sum += when - commit;
+		metrics->latency_samples++;
+	}
+
+	int64_t refresh = event->refresh;
+	if (!last || refresh <= 0 || when <= last
+			|| output->wlr_output->adaptive_sync_status
+				== WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED) {
+		/* There is no fixed vblank grid with adaptive sync */
+		return;
+	}
+	int64_t interval = when - last;
+	int64_t vblanks = MAX((interval + refresh / 2) / refresh, 1);
+	int64_t judder = interval - vblanks * refresh;
+	metrics->judder_ns_sum += judder < 0 ? -judder : judder;
+	metrics->judder_samples++;
+
+	/*
+	 * A repaint started before the vblank following the last presentation
+	 * was meant for that vblank; when it shows up later the vblanks in
+	 * between were missed.
+	 */
+	if (commit < last + refresh && vblanks > 1) {
+		metrics->missed_vblanks += vblanks - 1;
+	}
+}
+
+static void
+output_present_notify(struct wl_listener *listener, void *data)
+{
+	struct output *output = wl_container_of(listener, output, present);
+	struct wlr_output_event_present *event = data;
+
+	if (!event->presented) {
+		output->repaint.commit_start_nsec = 0;
+		return;
+	}
+	output_account_present(output, event);
+	output->repaint.commit_start_nsec = 0;
+	output->repaint.last_present_nsec = timespec_to_nsec(&event->when);
+	output->repaint.refresh_nsec = event->refresh;
+#if HAVE_XWAYLAND
+	xwayland_output_presented(output->server);
+#endif
+}
+
+/* Outputs by lower-cased name, see output_find_by_name() */
+static GHashTable *outputs_by_name;
+
+/*
+ * Layout boxes of the outputs in layout order, as searched by
+ * output_nearest_to(). Rebuilt after a change of the output layout.
+ */
+struct output_box {
+	struct wlr_box box;
+	struct output *output;
+};
+static struct wl_array output_boxes;
+static bool output_boxes_valid;
+
+static void
+name_index_add(struct output *output)
+{
+	if (!outputs_by_name) {
+		outputs_by_name = g_hash_table_new_full(g_str_hash,
+			g_str_equal, g_free, NULL);
+	}
+	g_hash_table_insert(outputs_by_name,
+		g_ascii_strdown(output->wlr_output->name, -1), output);
+}
+
+static void
+name_index_remove(struct output *output)
+{
+	if (!outputs_by_name) {
+		return;
+	}
+	char *key = g_ascii_strdown(output->wlr_output->name, -1);
+	if (g_hash_table_lookup(outputs_by_name, key) == output) {
+		g_hash_table_remove(outputs_by_name, key);
+	}
+	g_free(key);
 }
 
 static void
@@ -164,19 +1006,48 @@ output_destroy_notify(struct wl_listener *listener, void *data)
 	struct seat *seat = &output->server->seat;
 	regions_evacuate_output(output);
 	regions_destroy(seat, &output->regions);
+	regions_finish_output(output);
 	if (seat->overlay.active.output == output) {
 		overlay_hide(seat);
 	}
+	if (!wlr_box_empty(&output->arranged_box)) {
+		struct wlr_box *box = wl_array_add(
+			&output->server->removed_output_boxes, sizeof(*box));
+		if (box) {
+			*box = output->arranged_box;
+		}
+	}
+	output->server->output_test_generation++;
+	lab_change_journal_record(&output->server->scene_journal,
+		LAB_SCENE_CHANGE_OUTPUTS);
 	wl_list_remove(&output->link);
+	/* Not found by output_from_wlr_output() anymore */
+	wl_list_init(&output->link);
+	name_index_remove(output);
+	output_boxes_valid = false;
+	/* Other outputs may have cached this one as adjacent */
+	struct output *other;
+	wl_list_for_each(other, &output->server->outputs, link) {
+		other->edge_cache.valid = false;
+	}
+	/* Output field texts depend on the number of outputs */
+	osd_field_invalidate(NULL);
 	wl_list_remove(&output->frame.link);
+	wl_list_remove(&output->present.link);
 	wl_list_remove(&output->destroy.link);
+	wl_list_remove(&output->commit.link);
 	wl_list_remove(&output->request_state.link);
 	seat_output_layout_changed(seat);
 
+	restore_culled(output);
 	for (size_t i = 0; i < ARRAY_SIZE(output->layer_tree); i++) {
 		wlr_scene_node_destroy(&output->layer_tree[i]->node);
 	}
 	wlr_scene_node_destroy(&output->layer_popup_tree->node);
+	/* The overview has thumbnails in the osd_tree */
+	overview_finish(output->server);
+	hud_output_destroy(output);
+	capture_output_destroy(output);
 	wlr_scene_node_destroy(&output->osd_tree->node);
 	wlr_scene_node_destroy(&output->session_lock_tree->node);
 	if (output->workspace_osd) {
@@ -193,6 +1064,13 @@ output_destroy_notify(struct wl_listener *listener, void *data)
 	}
 
 	wlr_output_state_finish(&output->pending);
+	wl_event_source_remove(output->repaint.timer);
+	wl_event_source_remove(output->repaint.min_refresh_timer);
+	wl_list_remove(&output->repaint.link);
+	wl_event_source_remove(output->idle.timer);
+	wlr_color_transform_unref(output->gamma_transform);
+	output_timing_destroy(output);
+	placement_finish(output);
 
 	/*
 	 * Ensure that we don't accidentally try to dereference
@@ -208,6 +1086,21 @@ output_destroy_notify(struct wl_listener *listener, void *data)
 	free(output);
 }
 
+static void
+output_commit_notify(struct wl_listener *listener, void *data)
+{
+	struct output *output = wl_container_of(listener, output, commit);
+	struct wlr_output_event_commit *event = data;
+	uint32_t affects_tests = WLR_OUTPUT_STATE_ENABLED
+		| WLR_OUTPUT_STATE_MODE | WLR_OUTPUT_STATE_SCALE
+		| WLR_OUTPUT_STATE_TRANSFORM
+		| WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED
+		| WLR_OUTPUT_STATE_RENDER_FORMAT;
+	if (event->state->committed & affects_tests) {
+		output->server->output_test_generation++;
+	}
+}
+
 static void
 output_request_state_notify(struct wl_listener *listener, void *data)
 {
@@ -253,6 +1146,13 @@ static void
 add_output_to_layout(struct server *server, struct output *output)
 {
 	struct wlr_output *wlr_output = output->wlr_output;
+	if (!output->scene_output && wl_list_length(&server->scene->outputs)
+			>= LAB_OUTPUT_MASK_BITS) {
+		/* wlroots would abort() on creating the scene output */
+		wlr_log(WLR_ERROR, "too many outputs, not adding %s to layout",
+			wlr_output->name);
+		return;
+	}
 	struct wlr_output_layout_output *layout_output =
 		wlr_output_layout_add_auto(server->output_layout, wlr_output);
 	if (!layout_output) {
@@ -290,6 +1190,27 @@ add_output_to_layout(struct server *server, struct output *output)
 	}
 }
 
+struct mode_candidate {
+	struct wlr_output_mode *mode;
+	size_t index;  /* keeps the order of wlr_output->modes on ties */
+	int64_t area_diff;
+	int refresh_diff;
+};
+
+static int
+compare_mode_candidates(const void *a, const void *b)
+{
+	const struct mode_candidate *x = a;
+	const struct mode_candidate *y = b;
+	if (x->area_diff != y->area_diff) {
+		return x->area_diff < y->area_diff ? -1 : 1;
+	}
+	if (x->refresh_diff != y->refresh_diff) {
+		return x->refresh_diff < y->refresh_diff ? -1 : 1;
+	}
+	return (x->index > y->index) - (x->index < y->index);
+}
+
 static bool
 output_test_auto(struct wlr_output *wlr_output, struct wlr_output_state *state,
 		bool is_client_request)
@@ -353,23 +1274,58 @@ output_test_auto(struct wlr_output *wlr_output, struct wlr_output_state *state,
 	 * constraints (e.g. GPU or cable bandwidth limitations). In these
 	 * cases it's better to fallback to lower modes than to end up with
 	 * a black screen. See sway@4cdc4ac6
+	 *
+	 * Fallbacks are tried closest to the mode which last worked on this
+	 * monitor first, starting with that mode itself.
 	 */
+	struct output_mode_record record;
+	bool have_record = output_mode_cache_lookup(wlr_output, &record);
+
+	struct wl_array candidates;
+	wl_array_init(&candidates);
 	struct wlr_output_mode *mode;
 	wl_list_for_each(mode, &wlr_output->modes, link) {
 		if (mode == preferred_mode) {
 			continue;
 		}
+		struct mode_candidate *candidate =
+			wl_array_add(&candidates, sizeof(*candidate));
+		if (!candidate) {
+			break;
+		}
+		*candidate = (struct mode_candidate){
+			.mode = mode,
+			.index = candidates.size / sizeof(*candidate),
+		};
+		if (have_record) {
+			int64_t area = (int64_t)mode->width * mode->height;
+			int64_t last_area = (int64_t)record.width * record.height;
+			candidate->area_diff = llabs(area - last_area);
+			candidate->refresh_diff = abs(mode->refresh - record.refresh);
+		}
+	}
+	qsort(candidates.data, candidates.size / sizeof(struct mode_candidate),
+		sizeof(struct mode_candidate), compare_mode_candidates);
+
+	bool found = false;
+	struct mode_candidate *candidate;
+	wl_array_for_each(candidate, &candidates) {
+		mode = candidate->mode;
 		wlr_log(WLR_DEBUG, "testing fallback mode %dx%d@%d",
 			mode->width, mode->height, mode->refresh);
 		wlr_output_state_set_mode(state, mode);
 		if (wlr_output_test_state(wlr_output, state)) {
-			return true;
+			found = true;
+			break;
 		}
 	}
+	wl_array_release(&candidates);
 
-	/* Reset mode if none worked (we may still try to commit) */
-	wlr_output_state_set_mode(state, NULL);
-	return false;
+	if (!found) {
+		/* Reset mode if none worked (we may still try to commit) */
+		wlr_output_state_set_mode(state, NULL);
+	}
+	return found;
 }
 
 static void
@@ -394,10 +1350,13 @@ configure_new_output(struct server *server, struct output *output)
 		output_enable_adaptive_sync(output, true);
 	}
 
-	output_state_commit(output);
+	if (output_state_commit(output)) {
+		output_mode_cache_store(wlr_output);
+	}
 
 	wlr_output_effective_resolution(wlr_output,
 		&output->usable_area.width, &output->usable_area.height);
+	cursor_load_scale(&server->seat, wlr_output->scale);
 
 	/*
 	 * Wait until wlr_output_layout_add_auto() returns before
@@ -476,15 +1435,34 @@ new_output_notify(struct wl_listener *listener, void *data)
 	output_state_init(output);
 
 	wl_list_insert(&server->outputs, &output->link);
+	name_index_add(output);
+	osd_field_invalidate(NULL);
 
 	output->destroy.notify = output_destroy_notify;
 	wl_signal_add(&wlr_output->events.destroy, &output->destroy);
 	output->frame.notify = output_frame_notify;
 	wl_signal_add(&wlr_output->events.frame, &output->frame);
+	output->present.notify = output_present_notify;
+	wl_signal_add(&wlr_output->events.present, &output->present);
+	output->repaint.timer = wl_event_loop_add_timer(server->wl_event_loop,
+		handle_repaint_timer, output);
+	output->repaint.min_refresh_timer = wl_event_loop_add_timer(
+		server->wl_event_loop, handle_min_refresh_timer, output);
+	wl_list_init(&output->repaint.link);
+	output->idle.timer = wl_event_loop_add_timer(server->wl_event_loop,
+		handle_idle_timer, output);
+	struct idle_output_config *idle_config = output_idle_config(output);
+	if (idle_config) {
+		output_idle_arm(output, idle_config->timeout);
+	}
 
 	output->request_state.notify = output_request_state_notify;
 	wl_signal_add(&wlr_output->events.request_state, &output->request_state);
 
+	output->commit.notify = output_commit_notify;
+	wl_signal_add(&wlr_output->events.commit, &output->commit);
+	server->output_test_generation++;
+
 	wl_list_init(&output->regions);
 	wl_array_init(&output->osd_scene.items);
 
@@ -569,8 +1547,11 @@ output_init(struct server *server)
 		server->output_layout);
 
 	wl_list_init(&server->outputs);
+	wl_list_init(&server->repaint_queue);
+	wl_array_init(&server->removed_output_boxes);
 
 	output_manager_init(server);
+	output_timing_init(server);
 }
 
 static void output_manager_finish(struct server *server);
@@ -580,11 +1561,76 @@ output_finish(struct server *server)
 {
 	wl_list_remove(&server->new_output.link);
 	output_manager_finish(server);
+	output_timing_finish(server);
+	output_mode_cache_finish();
+	wl_array_release(&server->removed_output_boxes);
+	wl_array_release(&output_boxes);
+	wl_array_init(&output_boxes);
+	output_boxes_valid = false;
+	if (outputs_by_name) {
+		g_hash_table_destroy(outputs_by_name);
+		outputs_by_name = NULL;
+	}
+	if (server->repaint_idle) {
+		wl_event_source_remove(server->repaint_idle);
+		server->repaint_idle = NULL;
+	}
+}
+
+static uint64_t
+hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+	/* FNV-1a */
+	const unsigned char *bytes = data;
+	for (size_t i = 0; i < len; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211u;
+	}
+	return hash;
+}
+
+/* Independent of the order of server->outputs, never 0 */
+static uint64_t
+layout_signature(struct server *server)
+{
+	uint64_t signature = 1;
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		struct wlr_output *wlr_output = output->wlr_output;
+		struct wlr_box box;
+		wlr_output_layout_get_box(server->output_layout, wlr_output,
+			&box);
+		if (!output_is_usable(output) || wlr_box_empty(&box)) {
+			continue;
+		}
+		uint64_t hash = 14695981039346656037u;
+		hash = hash_bytes(hash, wlr_output->name,
+			strlen(wlr_output->name));
+		hash = hash_bytes(hash, &box, sizeof(box));
+		hash = hash_bytes(hash, &wlr_output->scale,
+			sizeof(wlr_output->scale));
+		hash = hash_bytes(hash, &wlr_output->transform,
+			sizeof(wlr_output->transform));
+		signature += hash;
+	}
+	return signature ? signature : 1;
 }
 
 static void
 output_update_for_layout_change(struct server *server)
 {
+	/*
+	 * Views remember their geometry in the layout being left, and get
+	 * it back when the layout returns, see view_adjust_for_layout_change()
+	 */
+	uint64_t signature = layout_signature(server);
+	if (signature != server->output_layout_signature) {
+		struct view *view;
+		wl_list_for_each(view, &server->views, link) {
+			view_save_layout_geometry(view);
+		}
+		server->output_layout_signature = signature;
+	}
+
 	output_update_all_usable_areas(server, /*layout_changed*/ true);
 	session_lock_update_for_layout_change(server);
 
@@ -611,6 +1657,8 @@ output_config_apply(struct server *server,
 		struct wlr_output_state *os = &output->pending;
 		bool output_enabled = head->state.enabled && !output->leased;
 
+		/* An explicit configuration overrides the power state */
+		output->power_off = false;
 		wlr_output_state_set_enabled(os, output_enabled);
 		if (output_enabled) {
 			/* Output specific actions only */
@@ -644,6 +1692,9 @@ output_config_apply(struct server *server,
 			success = false;
 			break;
 		}
+		if (output_enabled) {
+			output_mode_cache_store(o);
+		}
 
 		/*
 		 * Add or remove output from layout only if the commit went
@@ -696,6 +1747,81 @@ output_config_apply(struct server *server,
 	return success;
 }
 
+static struct output_test_result *
+find_test_result(struct output *output,
+		const struct wlr_output_head_v1_state *state)
+{
+	if (output->test_cache.generation
+			!= output->server->output_test_generation) {
+		return NULL;
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(output->test_cache.results); i++) {
+		struct output_test_result *result = &output->test_cache.results[i];
+		if (result->valid
+				&& result->mode == state->mode
+				&& result->width == state->custom_mode.width
+				&& result->height == state->custom_mode.height
+				&& result->refresh == state->custom_mode.refresh
+				&& result->scale == state->scale
+				&& result->transform == state->transform
+				&& result->adaptive_sync == state->adaptive_sync_enabled) {
+			return result;
+		}
+	}
+	return NULL;
+}
+
+static void
+add_test_result(struct output *output,
+		const struct wlr_output_head_v1_state *state, bool passed)
+{
+	uint32_t generation = output->server->output_test_generation;
+	if (output->test_cache.generation != generation) {
+		memset(&output->test_cache, 0, sizeof(output->test_cache));
+		output->test_cache.generation = generation;
+	}
+	size_t next = output->test_cache.next;
+	output->test_cache.results[next] = (struct output_test_result){
+		.valid = true,
+		.passed = passed,
+		.mode = state->mode,
+		.width = state->custom_mode.width,
+		.height = state->custom_mode.height,
+		.refresh = state->custom_mode.refresh,
+		.scale = state->scale,
+		.transform = state->transform,
+		.adaptive_sync = state->adaptive_sync_enabled,
+	};
+	output->test_cache.next = (next + 1) % ARRAY_SIZE(output->test_cache.results);
+}
+
+/*
+ * Settings GUIs test the same head state over and over while the user
+ * drags a slider, so remember the results until an output changes
+ */
+static bool
+test_head_state(const struct wlr_output_head_v1_state *head_state)
+{
+	struct output *output = head_state->output->data;
+	struct output_test_result *result =
+		output ? find_test_result(output, head_state) : NULL;
+	if (result) {
+		return result->passed;
+	}
+
+	struct wlr_output_state output_state;
+	wlr_output_state_init(&output_state);
+	wlr_output_head_v1_state_apply(head_state, &output_state);
+	bool passed = output_test_auto(head_state->output, &output_state,
+		/* is_client_request */ true);
+	wlr_output_state_finish(&output_state);
+
+	if (output) {
+		add_test_result(output, head_state, passed);
+	}
+	return passed;
+}
+
 static bool
 verify_output_config_v1(const struct wlr_output_configuration_v1 *config)
 {
@@ -730,16 +1856,9 @@ verify_output_config_v1(const struct wlr_output_configuration_v1 *config)
 		 * getting mixed with wlr_output->pending which
 		 * may contain further unrelated changes.
 		 */
-		struct wlr_output_state output_state;
-		wlr_output_state_init(&output_state);
-		wlr_output_head_v1_state_apply(&head->state, &output_state);
-
-		if (!output_test_auto(head->state.output, &output_state,
-				/* is_client_request */ true)) {
-			wlr_output_state_finish(&output_state);
+		if (!test_head_state(&head->state)) {
 			return false;
 		}
-		wlr_output_state_finish(&output_state);
 	}
 
 	return true;
@@ -755,12 +1874,24 @@ custom_mode_failed:
 	return false;
 }
 
+/* Rejects configurations of clients flooding the output manager */
+static bool
+config_allowed(struct wlr_output_configuration_v1 *config,
+		enum lab_rate_limit limit)
+{
+	struct wl_client *client =
+		config->resource ? wl_resource_get_client(config->resource) : NULL;
+	return lab_rate_limit_allow(client, limit);
+}
+
 static void
 handle_output_manager_test(struct wl_listener *listener, void *data)
 {
 	struct wlr_output_configuration_v1 *config = data;
 
-	if (verify_output_config_v1(config)) {
+	if (!config_allowed(config, LAB_RATE_LIMIT_OUTPUT_TEST)) {
+		wlr_output_configuration_v1_send_failed(config);
+	} else if (verify_output_config_v1(config)) {
 		wlr_output_configuration_v1_send_succeeded(config);
 	} else {
 		wlr_output_configuration_v1_send_failed(config);
@@ -775,6 +1906,12 @@ handle_output_manager_apply(struct wl_listener *listener, void *data)
 		wl_container_of(listener, server, output_manager_apply);
 	struct wlr_output_configuration_v1 *config = data;
 
+	if (!config_allowed(config, LAB_RATE_LIMIT_OUTPUT_APPLY)) {
+		wlr_output_configuration_v1_send_failed(config);
+		wlr_output_configuration_v1_destroy(config);
+		return;
+	}
+
 	bool config_is_good = verify_output_config_v1(config);
 
 	if (config_is_good && output_config_apply(server, config)) {
@@ -785,12 +1922,11 @@ handle_output_manager_apply(struct wl_listener *listener, void *data)
 	wlr_output_configuration_v1_destroy(config);
 	struct output *output;
 	wl_list_for_each(output, &server->outputs, link) {
-		wlr_xcursor_manager_load(server->seat.xcursor_manager,
-			output->wlr_output->scale);
+		cursor_load_scale(&server->seat, output->wlr_output->scale);
 	}
 
 	/* Re-set cursor image in case scale changed */
-	cursor_update_focus(server);
+	cursor_schedule_focus_update(server);
 	cursor_update_image(&server->seat);
 }
 
@@ -837,6 +1973,9 @@ static void
 do_output_layout_change(struct server *server)
 {
 	if (!server->pending_output_layout_change) {
+		/* Any debounced change is handled along with this one */
+		wl_event_source_timer_update(
+			server->output_layout_change_timer, 0);
 		struct wlr_output_configuration_v1 *config =
 			create_output_config(server);
 		if (config) {
@@ -857,14 +1996,55 @@ handle_output_layout_change(struct wl_listener *listener, void *data)
 	struct server *server =
 		wl_container_of(listener, server, output_layout_change);
 
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		output->layout_origin.valid = false;
+		output->edge_cache.valid = false;
+	}
+	output_boxes_valid = false;
+	server->output_layout_generation++;
+	lab_change_journal_record(&server->scene_journal,
+		LAB_SCENE_CHANGE_OUTPUTS);
+
 	/* Prevents unnecessary layout recalculations */
 	server->pending_output_layout_change++;
 	output_virtual_update_fallback(server);
 	server->pending_output_layout_change--;
 
+	/*
+	 * Changes made by the compositor itself have the counter raised
+	 * and call do_output_layout_change() when done. Others, typically
+	 * from the backend, are debounced.
+	 */
+	if (server->pending_output_layout_change) {
+		return;
+	}
+
+	wl_event_source_timer_update(server->output_layout_change_timer,
+		OUTPUT_LAYOUT_CHANGE_DEBOUNCE_MSEC);
+}
+
+void
+output_layout_change_begin(struct server *server)
+{
+	server->pending_output_layout_change++;
+}
+
+void
+output_layout_change_end(struct server *server)
+{
+	assert(server->pending_output_layout_change > 0);
+	server->pending_output_layout_change--;
 	do_output_layout_change(server);
 }
 
+static int
+handle_output_layout_change_timer(void *data)
+{
+	do_output_layout_change(data);
+	return 0;
+}
+
 static void
 handle_gamma_control_set_gamma(struct wl_listener *listener, void *data)
 {
@@ -883,6 +2063,9 @@ output_manager_init(struct server *server)
 {
 	server->output_manager = wlr_output_manager_v1_create(server->wl_display);
 
+	server->output_layout_change_timer = wl_event_loop_add_timer(
+		server->wl_event_loop, handle_output_layout_change_timer,
+		server);
 	server->output_layout_change.notify = handle_output_layout_change;
 	wl_signal_add(&server->output_layout->events.change,
 		&server->output_layout_change);
@@ -904,6 +2087,8 @@ static void
 output_manager_finish(struct server *server)
 {
 	wl_list_remove(&server->output_layout_change.link);
+	wl_event_source_remove(server->output_layout_change_timer);
+	server->output_layout_change_timer = NULL;
 	wl_list_remove(&server->output_manager_apply.link);
 	wl_list_remove(&server->output_manager_test.link);
 	wl_list_remove(&server->gamma_control_set_gamma.link);
@@ -912,40 +2097,137 @@ output_manager_finish(struct server *server)
 struct output *
 output_from_wlr_output(struct server *server, struct wlr_output *wlr_output)
 {
-	struct output *output;
-	wl_list_for_each(output, &server->outputs, link) {
-		if (output->wlr_output == wlr_output) {
-			return output;
-		}
+	if (!wlr_output) {
+		return NULL;
 	}
-	return NULL;
+	/* Set by new_output_notify(), cleared when the output is destroyed */
+	struct output *output = wlr_output->data;
+	if (!output || wl_list_empty(&output->link)) {
+		return NULL;
+	}
+	assert(output->wlr_output == wlr_output);
+	return output;
+}
+
+struct output *
+output_find_by_name(struct server *server, const char *name)
+{
+	assert(name);
+	if (!outputs_by_name) {
+		return NULL;
+	}
+	char *key = g_ascii_strdown(name, -1);
+	struct output *output = g_hash_table_lookup(outputs_by_name, key);
+	g_free(key);
+	return output;
 }
 
 struct output *
 output_from_name(struct server *server, const char *name)
 {
-	struct output *output;
-	wl_list_for_each(output, &server->outputs, link) {
-		if (!output_is_usable(output) || !output->wlr_output->name) {
+	struct output *output = output_find_by_name(server, name);
+	return output_is_usable(output) ? output : NULL;
+}
+
+static void
+update_output_boxes(struct server *server)
+{
+	if (output_boxes_valid) {
+		return;
+	}
+	output_boxes.size = 0;
+
+	struct wlr_output_layout_output *l_output;
+	wl_list_for_each(l_output, &server->output_layout->outputs, link) {
+		struct output *output =
+			output_from_wlr_output(server, l_output->output);
+		struct wlr_box box;
+		wlr_output_layout_get_box(server->output_layout,
+			l_output->output, &box);
+		if (!output || wlr_box_empty(&box)) {
 			continue;
 		}
-		if (!strcasecmp(name, output->wlr_output->name)) {
-			return output;
+		struct output_box *item = wl_array_add(&output_boxes,
+			sizeof(*item));
+		if (!item) {
+			wlr_log(WLR_ERROR, "failed to allocate output box");
+			return;
 		}
+		item->box = box;
+		item->output = output;
 	}
-	return NULL;
+	output_boxes_valid = true;
+}
+
+uint64_t
+output_get_mask(struct output *output)
+{
+	if (!output || !output->scene_output) {
+		return 0;
+	}
+	return 1ull << output->scene_output->WLR_PRIVATE.index;
+}
+
+uint64_t
+output_mask_from_box(struct server *server, struct wlr_box *box)
+{
+	update_output_boxes(server);
+
+	uint64_t mask = 0;
+	struct wlr_box intersection;
+	struct output_box *item;
+	wl_array_for_each(item, &output_boxes) {
+		struct output *output = item->output;
+		if (output_is_usable(output) && output->scene_output
+				&& wlr_box_intersection(&intersection,
+					&item->box, box)) {
+			mask |= output_get_mask(output);
+		}
+	}
+	return mask;
+}
+
+/* Squared distance from (@lx, @ly) to the closest point of @box */
+static double
+box_distance_sq(struct wlr_box *box, double lx, double ly)
+{
+	double dx = 0, dy = 0;
+	if (lx < box->x) {
+		dx = box->x - lx;
+	} else if (lx > box->x + box->width - 1) {
+		dx = lx - (box->x + box->width - 1);
+	}
+	if (ly < box->y) {
+		dy = box->y - ly;
+	} else if (ly > box->y + box->height - 1) {
+		dy = ly - (box->y + box->height - 1);
+	}
+	return dx * dx + dy * dy;
 }
 
+/*
+ * Same result as wlr_output_layout_closest_point() followed by
+ * wlr_output_layout_output_at(), without walking the layout twice
+ */
 struct output *
 output_nearest_to(struct server *server, int lx, int ly)
 {
-	double closest_x, closest_y;
-	wlr_output_layout_closest_point(server->output_layout, NULL, lx, ly,
-		&closest_x, &closest_y);
-
-	return output_from_wlr_output(server,
-		wlr_output_layout_output_at(server->output_layout,
-			closest_x, closest_y));
+	update_output_boxes(server);
+
+	struct output *nearest = NULL;
+	double min_distance = 0;
+	struct output_box *item;
+	wl_array_for_each(item, &output_boxes) {
+		if (wlr_box_contains_point(&item->box, lx, ly)) {
+			return item->output;
+		}
+		double distance = box_distance_sq(&item->box, lx, ly);
+		if (!nearest || distance < min_distance) {
+			nearest = item->output;
+			min_distance = distance;
+		}
+	}
+	return nearest;
 }
 
 struct output *
@@ -955,15 +2237,9 @@ output_nearest_to_cursor(struct server *server)
 		server->seat.cursor->y);
 }
 
-struct output *
-output_get_adjacent(struct output *output, enum view_edge edge, bool wrap)
+static struct output *
+find_adjacent(struct output *output, enum view_edge edge, bool wrap)
 {
-	if (!output_is_usable(output)) {
-		wlr_log(WLR_ERROR,
-			"output is not usable, cannot find adjacent output");
-		return NULL;
-	}
-
 	struct wlr_box box = output_usable_area_in_layout_coords(output);
 	int lx = box.x + box.width / 2;
 	int ly = box.y + box.height / 2;
@@ -992,14 +2268,87 @@ output_get_adjacent(struct output *output, enum view_edge edge, bool wrap)
 	if (!new_output || new_output == current_output) {
 		return NULL;
 	}
+	return output_from_wlr_output(output->server, new_output);
+}
+
+static void
+update_edge_cache(struct output *output)
+{
+	if (output->edge_cache.valid && output->edge_cache.gap == rc.gap) {
+		return;
+	}
+
+	struct wlr_box usable = output_usable_area_in_layout_coords(output);
+	int gap = rc.gap;
+	for (enum view_edge edge = VIEW_EDGE_INVALID;
+			edge <= VIEW_EDGE_CENTER; edge++) {
+		struct wlr_box full = usable;
+		struct wlr_box tiled = {
+			.x = usable.x + gap,
+			.y = usable.y + gap,
+			.width = usable.width - 2 * gap,
+			.height = usable.height - 2 * gap,
+		};
+		switch (edge) {
+		case VIEW_EDGE_RIGHT:
+			full.x += full.width / 2;
+			tiled.x = usable.x + (usable.width + gap) / 2;
+			/* Falls through to VIEW_EDGE_LEFT */
+		case VIEW_EDGE_LEFT:
+			full.width /= 2;
+			tiled.width = (usable.width - 3 * gap) / 2;
+			break;
+		case VIEW_EDGE_DOWN:
+			full.y += full.height / 2;
+			tiled.y = usable.y + (usable.height + gap) / 2;
+			/* Falls through to VIEW_EDGE_UP */
+		case VIEW_EDGE_UP:
+			full.height /= 2;
+			tiled.height = (usable.height - 3 * gap) / 2;
+			break;
+		default:
+			/* VIEW_EDGE_CENTER and <topMaximize> */
+			break;
+		}
+		output->edge_cache.full[edge] = full;
+		output->edge_cache.tiled[edge] = tiled;
+		output->edge_cache.adjacent[edge][false] =
+			find_adjacent(output, edge, /* wrap */ false);
+		output->edge_cache.adjacent[edge][true] =
+			find_adjacent(output, edge, /* wrap */ true);
+	}
+	output->edge_cache.gap = gap;
+	output->edge_cache.valid = true;
+}
 
-	output = output_from_wlr_output(output->server, new_output);
+struct output *
+output_get_adjacent(struct output *output, enum view_edge edge, bool wrap)
+{
 	if (!output_is_usable(output)) {
+		wlr_log(WLR_ERROR,
+			"output is not usable, cannot find adjacent output");
+		return NULL;
+	}
+	assert(edge <= VIEW_EDGE_CENTER);
+
+	update_edge_cache(output);
+	struct output *adjacent = output->edge_cache.adjacent[edge][wrap];
+	if (adjacent && !output_is_usable(adjacent)) {
 		wlr_log(WLR_ERROR, "invalid output in layout");
 		return NULL;
 	}
+	return adjacent;
+}
 
-	return output;
+struct wlr_box
+output_get_edge_box(struct output *output, enum view_edge edge, bool with_gaps)
+{
+	assert(output);
+	assert(edge <= VIEW_EDGE_CENTER);
+
+	update_edge_cache(output);
+	return with_gaps ? output->edge_cache.tiled[edge]
+		: output->edge_cache.full[edge];
 }
 
 bool
@@ -1014,19 +2363,18 @@ static bool
 update_usable_area(struct output *output)
 {
 	struct wlr_box old = output->usable_area;
+	output->usable_area_dirty = false;
 	layers_arrange(output);
 
 #if HAVE_XWAYLAND
-	struct view *view;
-	wl_list_for_each(view, &output->server->views, link) {
-		if (view->mapped && view->type == LAB_XWAYLAND_VIEW) {
-			xwayland_adjust_usable_area(view,
-				output->server->output_layout,
-				output->wlr_output, &output->usable_area);
-		}
-	}
+	xwayland_adjust_usable_area(output->server, output->wlr_output,
+		&output->usable_area);
 #endif
-	return !wlr_box_equal(&old, &output->usable_area);
+	if (wlr_box_equal(&old, &output->usable_area)) {
+		return false;
+	}
+	output->edge_cache.valid = false;
+	return true;
 }
 
 void
@@ -1041,6 +2389,85 @@ output_update_usable_area(struct output *output)
 	}
 }
 
+void
+output_schedule_usable_area_update(struct output *output)
+{
+	if (!output->usable_area_dirty) {
+		output->usable_area_dirty = true;
+		wlr_output_schedule_frame(output->wlr_output);
+	}
+}
+
+static void
+flush_usable_area(struct output *output)
+{
+	if (!output->usable_area_dirty) {
+		return;
+	}
+	output_update_usable_area(output);
+	/*
+	 * Update cursor focus here to ensure we
+	 * enter a new/moved/resized layer surface.
+	 */
+	cursor_schedule_focus_update(output->server);
+}
+
+static void
+add_changed_box(struct wl_array *boxes, struct wlr_box *box)
+{
+	if (wlr_box_empty(box)) {
+		return;
+	}
+	struct wlr_box *dst = wl_array_add(boxes, sizeof(*dst));
+	if (dst) {
+		*dst = *box;
+	}
+}
+
+/*
+ * Record the old and new geometry of @output in @boxes if its layout box
+ * or usable area changed since views were last arranged
+ */
+static void
+collect_changed_boxes(struct output *output, struct wl_array *boxes)
+{
+	struct wlr_box box = {0};
+	struct wlr_box usable = {0};
+	if (output->power_off) {
+		/* Views stay where they are while the output is powered off */
+		return;
+	}
+	if (output_is_usable(output)) {
+		wlr_output_layout_get_box(output->server->output_layout,
+			output->wlr_output, &box);
+		usable = output_usable_area_in_layout_coords(output);
+	}
+	if (wlr_box_equal(&box, &output->arranged_box)
+			&& wlr_box_equal(&usable, &output->arranged_usable_area)) {
+		return;
+	}
+	add_changed_box(boxes, &output->arranged_box);
+	add_changed_box(boxes, &box);
+	output->arranged_box = box;
+	output->arranged_usable_area = usable;
+}
+
+static void
+update_all_usable_areas(void *data)
+{
+	output_update_all_usable_areas(data, /*layout_changed*/ false);
+}
+
+void
+output_schedule_all_usable_areas_update(struct server *server)
+{
+	static struct deferred_task task = {
+		.func = update_all_usable_areas,
+	};
+	task.data = server;
+	deferred_task_schedule(&server->deferred, &task);
+}
+
 void
 output_update_all_usable_areas(struct server *server, bool layout_changed)
 {
@@ -1059,7 +2486,23 @@ output_update_all_usable_areas(struct server *server, bool layout_changed)
 #if HAVE_XWAYLAND
 		xwayland_update_workarea(server);
 #endif
-		desktop_arrange_all_views(server);
+		/*
+		 * Only views overlapping an output that was added, removed,
+		 * moved or had its usable area changed need re-arranging.
+		 * Everything else keeps its geometry and last_layout_geometry.
+		 */
+		struct wl_array boxes;
+		wl_array_init(&boxes);
+		struct wlr_box *box;
+		wl_array_for_each(box, &server->removed_output_boxes) {
+			add_changed_box(&boxes, box);
+		}
+		server->removed_output_boxes.size = 0;
+		wl_list_for_each(output, &server->outputs, link) {
+			collect_changed_boxes(output, &boxes);
+		}
+		desktop_arrange_views_in_boxes(server, &boxes);
+		wl_array_release(&boxes);
 	}
 }
 
@@ -1069,15 +2512,65 @@ output_usable_area_in_layout_coords(struct output *output)
 	if (!output) {
 		return (struct wlr_box){0};
 	}
+	if (!output->layout_origin.valid) {
+		double ox = 0, oy = 0;
+		wlr_output_layout_output_coords(output->server->output_layout,
+			output->wlr_output, &ox, &oy);
+		output->layout_origin.x = -ox;
+		output->layout_origin.y = -oy;
+		output->layout_origin.valid = true;
+	}
 	struct wlr_box box = output->usable_area;
-	double ox = 0, oy = 0;
-	wlr_output_layout_output_coords(output->server->output_layout,
-		output->wlr_output, &ox, &oy);
-	box.x -= ox;
-	box.y -= oy;
+	box.x += output->layout_origin.x;
+	box.y += output->layout_origin.y;
 	return box;
 }
 
+static void
+output_views_update_outputs(struct server *server)
+{
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		view_update_outputs(view);
+	}
+	osd_field_invalidate(NULL);
+}
+
+/*
+ * Drop everything which would wake the output up again. A disabled
+ * wlr_output emits no frame events, so scene rendering and frame_done
+ * for views only shown on this output stop with it.
+ */
+static void
+output_power_suspend(struct output *output)
+{
+	output->power_off = true;
+	if (output->repaint.scheduled) {
+		wl_event_source_timer_update(output->repaint.timer, 0);
+		wl_list_remove(&output->repaint.link);
+		wl_list_init(&output->repaint.link);
+		output->repaint.scheduled = false;
+	}
+	/* Any adaptive sync change is committed together with the disable */
+	output_idle_wake(output);
+	output_idle_arm(output, 0);
+}
+
+static void
+output_power_resume(struct output *output)
+{
+	output->power_off = false;
+	output->repaint.last_present_nsec = 0;
+	struct idle_output_config *config = output_idle_config(output);
+	if (config) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		output->idle.last_active_nsec = timespec_to_nsec(&now);
+		output_idle_arm(output, config->timeout);
+	}
+	wlr_output_schedule_frame(output->wlr_output);
+}
+
 void
 handle_output_power_manager_set_mode(struct wl_listener *listener, void *data)
 {
@@ -1092,8 +2585,14 @@ handle_output_power_manager_set_mode(struct wl_listener *listener, void *data)
 		if (!event->output->enabled) {
 			return;
 		}
+		output_power_suspend(output);
 		wlr_output_state_set_enabled(&output->pending, false);
-		output_state_commit(output);
+		if (!output_state_commit(output)) {
+			output_power_resume(output);
+			break;
+		}
+		/* Not usable anymore, but the layout is left untouched */
+		output_views_update_outputs(server);
 		break;
 	case ZWLR_OUTPUT_POWER_V1_MODE_ON:
 		if (event->output->enabled) {
@@ -1122,7 +2621,11 @@ handle_output_power_manager_set_mode(struct wl_listener *listener, void *data)
 			wlr_output_state_set_custom_mode(&output->pending, width,
 				event->output->height, event->output->refresh);
 		}
-		output_state_commit(output);
+		if (!output_state_commit(output)) {
+			break;
+		}
+		output_power_resume(output);
+		output_views_update_outputs(server);
 		/*
 		 * Re-set the cursor image so that the cursor
 		 * isn't invisible on the newly enabled output.
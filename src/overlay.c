@@ -5,63 +5,58 @@
 #include "view.h"
 #include "theme.h"
 
+/*
+ * Both the filled rectangle and the outlines are always created, so that
+ * a new theme only needs to update them instead of allocating new nodes
+ */
 static void
-create_overlay_rect(struct seat *seat, struct overlay_rect *rect,
+configure_overlay_rect(struct seat *seat, struct overlay_rect *rect,
 		struct theme_snapping_overlay *theme)
 {
 	struct server *server = seat->server;
+	float *colors[3] = {
+		theme->border_color[0],
+		theme->border_color[1],
+		theme->border_color[2],
+	};
 
-	rect->bg_enabled = theme->bg_enabled;
-	rect->border_enabled = theme->border_enabled;
-	rect->tree = wlr_scene_tree_create(&server->scene->tree);
-
-	if (rect->bg_enabled) {
-		/* Create a filled rectangle */
+	if (!rect->tree) {
+		rect->tree = wlr_scene_tree_create(&server->scene->tree);
 		rect->bg_rect = wlr_scene_rect_create(
 			rect->tree, 0, 0, theme->bg_color);
-	}
-
-	if (rect->border_enabled) {
-		/* Create outlines */
-		float *colors[3] = {
-			theme->border_color[0],
-			theme->border_color[1],
-			theme->border_color[2],
-		};
 		rect->border_rect = multi_rect_create(
 			rect->tree, colors, theme->border_width);
+		wlr_scene_node_set_enabled(&rect->tree->node, false);
+	} else {
+		wlr_scene_rect_set_color(rect->bg_rect, theme->bg_color);
+		multi_rect_set_style(rect->border_rect, colors,
+			theme->border_width);
 	}
 
-	wlr_scene_node_set_enabled(&rect->tree->node, false);
+	rect->bg_enabled = theme->bg_enabled;
+	rect->border_enabled = theme->border_enabled;
+	wlr_scene_node_set_enabled(&rect->bg_rect->node, rect->bg_enabled);
+	wlr_scene_node_set_enabled(&rect->border_rect->tree->node,
+		rect->border_enabled);
 }
 
 void overlay_reconfigure(struct seat *seat)
 {
-	if (seat->overlay.region_rect.tree) {
-		wlr_scene_node_destroy(&seat->overlay.region_rect.tree->node);
-	}
-	if (seat->overlay.edge_rect.tree) {
-		wlr_scene_node_destroy(&seat->overlay.edge_rect.tree->node);
-	}
-
 	struct theme *theme = seat->server->theme;
-	create_overlay_rect(seat, &seat->overlay.region_rect,
+	configure_overlay_rect(seat, &seat->overlay.region_rect,
 		&theme->snapping_overlay_region);
-	create_overlay_rect(seat, &seat->overlay.edge_rect,
+	configure_overlay_rect(seat, &seat->overlay.edge_rect,
 		&theme->snapping_overlay_edge);
 }
 
+/* Only moves and resizes the nodes created by overlay_reconfigure() */
 static void
 show_overlay(struct seat *seat, struct overlay_rect *rect, struct wlr_box *box)
 {
 	struct server *server = seat->server;
 	struct view *view = server->grabbed_view;
 	assert(view);
-
-	if (!rect->tree) {
-		overlay_reconfigure(seat);
-		assert(rect->tree);
-	}
+	assert(rect->tree);
 
 	if (rect->bg_enabled) {
 		wlr_scene_rect_set_size(rect->bg_rect, box->width, box->height);
@@ -91,9 +86,7 @@ inactivate_overlay(struct overlay *overlay)
 	overlay->active.region = NULL;
 	overlay->active.edge = VIEW_EDGE_INVALID;
 	overlay->active.output = NULL;
-	if (overlay->timer) {
-		wl_event_source_timer_update(overlay->timer, 0);
-	}
+	lab_timer_disarm(&overlay->timer);
 }
 
 static void
@@ -108,72 +101,22 @@ show_region_overlay(struct seat *seat, struct region *region)
 	show_overlay(seat, &seat->overlay.region_rect, &region->geo);
 }
 
-/* TODO: share logic with view_get_edge_snap_box() */
-static struct wlr_box get_edge_snap_box(enum view_edge edge, struct output *output)
-{
-	struct wlr_box box = output_usable_area_in_layout_coords(output);
-	switch (edge) {
-	case VIEW_EDGE_RIGHT:
-		box.x += box.width / 2;
-		/* fallthrough */
-	case VIEW_EDGE_LEFT:
-		box.width /= 2;
-		break;
-	case VIEW_EDGE_DOWN:
-		box.y += box.height / 2;
-		/* fallthrough */
-	case VIEW_EDGE_UP:
-		box.height /= 2;
-		break;
-	case VIEW_EDGE_CENTER:
-		/* <topMaximize> */
-		break;
-	default:
-		/* not reached */
-		assert(false);
-	}
-	return box;
-}
-
-static int
+static void
 handle_edge_overlay_timeout(void *data)
 {
 	struct seat *seat = data;
 	assert(seat->overlay.active.edge != VIEW_EDGE_INVALID
 		&& seat->overlay.active.output);
-	struct wlr_box box = get_edge_snap_box(seat->overlay.active.edge,
-		seat->overlay.active.output);
+	struct wlr_box box = output_get_edge_box(seat->overlay.active.output,
+		seat->overlay.active.edge, /* with_gaps */ false);
 	show_overlay(seat, &seat->overlay.edge_rect, &box);
-	return 0;
-}
-
-static enum wlr_direction
-get_wlr_direction(enum view_edge edge)
-{
-	switch (edge) {
-	case VIEW_EDGE_LEFT:
-		return WLR_DIRECTION_LEFT;
-	case VIEW_EDGE_RIGHT:
-		return WLR_DIRECTION_RIGHT;
-	case VIEW_EDGE_UP:
-	case VIEW_EDGE_CENTER:
-		return WLR_DIRECTION_UP;
-	case VIEW_EDGE_DOWN:
-		return WLR_DIRECTION_DOWN;
-	default:
-		/* not reached */
-		assert(false);
-		return 0;
-	}
 }
 
+/* Adjacent outputs are cached per output, see output_get_adjacent() */
 static bool
-edge_has_adjacent_output_from_cursor(struct seat *seat, struct output *output,
-		enum view_edge edge)
+edge_has_adjacent_output(struct output *output, enum view_edge edge)
 {
-	return wlr_output_layout_adjacent_output(
-		seat->server->output_layout, get_wlr_direction(edge),
-		output->wlr_output, seat->cursor->x, seat->cursor->y);
+	return output_get_adjacent(output, edge, /* wrap */ false);
 }
 
 static void
@@ -192,24 +135,24 @@ show_edge_overlay(struct seat *seat, enum view_edge edge,
 	seat->overlay.active.output = output;
 
 	int delay;
-	if (edge_has_adjacent_output_from_cursor(seat, output, edge)) {
+	if (edge_has_adjacent_output(output, edge)) {
 		delay = rc.snap_overlay_delay_inner;
 	} else {
 		delay = rc.snap_overlay_delay_outer;
 	}
 
 	if (delay > 0) {
-		if (!seat->overlay.timer) {
-			seat->overlay.timer = wl_event_loop_add_timer(
-				seat->server->wl_event_loop,
+		if (!seat->overlay.timer.func) {
+			lab_timer_init(&seat->overlay.timer,
 				handle_edge_overlay_timeout, seat);
 		}
 		/* Show overlay <snapping><preview><delay>ms later */
-		wl_event_source_timer_update(seat->overlay.timer, delay);
+		lab_timer_arm(&seat->timers, &seat->overlay.timer, delay);
 	} else {
 		/* Show overlay now */
-		struct wlr_box box = get_edge_snap_box(seat->overlay.active.edge,
-			seat->overlay.active.output);
+		struct wlr_box box = output_get_edge_box(
+			seat->overlay.active.output, seat->overlay.active.edge,
+			/* with_gaps */ false);
 		show_overlay(seat, &seat->overlay.edge_rect, &box);
 	}
 }
@@ -264,8 +207,5 @@ overlay_hide(struct seat *seat)
 void
 overlay_finish(struct seat *seat)
 {
-	if (seat->overlay.timer) {
-		wl_event_source_remove(seat->overlay.timer);
-		seat->overlay.timer = NULL;
-	}
+	lab_timer_disarm(&seat->overlay.timer);
 }
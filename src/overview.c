@@ -0,0 +1,374 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * overview.c: thumbnails of all views in a grid on each output
+ *
+ * The thumbnails are snapshots rendered at the size they are shown at
+ * (see view-snapshot.c), so a view costs one small texture instead of
+ * its surface tree while the overview is open. All snapshots are taken
+ * when the overview opens. Afterwards a timer refreshes a few of them at
+ * a time, round robin, so that no thumbnail is updated more often than
+ * 10 times per second and an overview with many views does not render
+ * all of them on every tick.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/box.h>
+#include "common/array.h"
+#include "common/macros.h"
+#include "common/scaled-icon-buffer.h"
+#include "common/scaled-rect-buffer.h"
+#include "common/string-helpers.h"
+#include "labwc.h"
+#include "overview.h"
+#include "theme.h"
+#include "view.h"
+#include "view-snapshot.h"
+
+#define OVERVIEW_REFRESH_MSEC 100
+#define OVERVIEW_REFRESH_BATCH 8
+#define OVERVIEW_PADDING 24
+#define OVERVIEW_ICON_SIZE 48
+
+/* Bytes of all thumbnails together, they are downscaled further beyond */
+#define OVERVIEW_TEXTURE_BUDGET (64 * 1024 * 1024)
+
+#define OVERVIEW_CRITERIA (LAB_VIEW_CRITERIA_ROOT_TOPLEVEL \
+	| LAB_VIEW_CRITERIA_NO_SKIP_WINDOW_SWITCHER)
+
+struct overview_item {
+	struct view *view; /* NULL once the view is destroyed */
+	struct wlr_scene_tree *tree;
+	struct scaled_rect_buffer *highlight;
+	struct wlr_scene_buffer *thumbnail;
+	struct wlr_box box; /* layout coordinates */
+	float scale; /* snapshot pixels per layout pixel of the view */
+};
+
+static struct {
+	struct wl_array trees; /* struct wlr_scene_tree *, one per output */
+	struct wl_array items; /* struct overview_item */
+	size_t nr_items;
+	size_t selected;
+	size_t next_refresh;
+	struct wl_event_source *timer;
+} overview;
+
+static size_t
+nr_slots(void)
+{
+	return overview.items.size / sizeof(struct overview_item);
+}
+
+static void
+refresh_item(struct overview_item *item)
+{
+	struct wlr_scene_buffer *thumbnail =
+		view_snapshot_create(item->view, item->tree, item->scale);
+	if (!thumbnail) {
+		/* Keep showing the previous snapshot */
+		return;
+	}
+	wlr_scene_buffer_set_dest_size(thumbnail, item->box.width,
+		item->box.height);
+	if (item->thumbnail) {
+		wlr_scene_node_destroy(&item->thumbnail->node);
+	}
+	/* Below the highlight and the icon */
+	wlr_scene_node_lower_to_bottom(&thumbnail->node);
+	item->thumbnail = thumbnail;
+}
+
+static void
+select_item(size_t index)
+{
+	struct overview_item *items = overview.items.data;
+	if (overview.selected < nr_slots()
+			&& items[overview.selected].highlight) {
+		wlr_scene_node_set_enabled(
+			&items[overview.selected].highlight->tree->node, false);
+	}
+	overview.selected = index;
+	wlr_scene_node_set_enabled(&items[index].highlight->tree->node, true);
+}
+
+static void
+place_item(struct overview_item *item, struct wlr_box *cell, float scale)
+{
+	struct view *view = item->view;
+	double fit = MIN((double)cell->width / view->current.width,
+		(double)cell->height / view->current.height);
+	fit = MIN(fit, 1.0);
+	item->box.width = MAX(lround(view->current.width * fit), 1);
+	item->box.height = MAX(lround(view->current.height * fit), 1);
+	item->box.x = cell->x + (cell->width - item->box.width) / 2;
+	item->box.y = cell->y + (cell->height - item->box.height) / 2;
+	item->scale = fit * scale;
+}
+
+/* The app icon, bottom-centered over the thumbnail */
+static void
+add_icon(struct server *server, struct overview_item *item)
+{
+	const char *app_id = view_get_string_prop(item->view, "app_id");
+	int size = MIN(OVERVIEW_ICON_SIZE,
+		MIN(item->box.width, item->box.height) / 2);
+	if (string_null_or_empty(app_id) || size <= 0) {
+		return;
+	}
+	struct scaled_icon_buffer *icon =
+		scaled_icon_buffer_create(item->tree, server, size, size);
+	scaled_icon_buffer_set_app_id(icon, app_id);
+	wlr_scene_node_set_position(&icon->scene_buffer->node,
+		(item->box.width - size) / 2, item->box.height - size - size / 4);
+}
+
+/* Lays out the views of @output in a grid of about square shape */
+static void
+add_output(struct server *server, struct output *output)
+{
+	struct wlr_box output_box;
+	wlr_output_layout_get_box(server->output_layout, output->wlr_output,
+		&output_box);
+	struct wlr_scene_tree *tree = wlr_scene_tree_create(output->osd_tree);
+	array_add(&overview.trees, tree);
+	struct wlr_scene_rect *bg = wlr_scene_rect_create(tree,
+		output_box.width, output_box.height, server->theme->osd_bg_color);
+	wlr_scene_node_set_position(&bg->node, output_box.x, output_box.y);
+
+	int nr_views = 0;
+	struct view *view;
+	for_each_view(view, &server->views, OVERVIEW_CRITERIA) {
+		if (view->output == output && !wlr_box_empty(&view->current)) {
+			nr_views++;
+		}
+	}
+	if (!nr_views) {
+		return;
+	}
+
+	struct wlr_box usable = output_usable_area_in_layout_coords(output);
+	int cols = ceil(sqrt(nr_views));
+	int rows = (nr_views + cols - 1) / cols;
+	struct wlr_box cell = {
+		.width = MAX((usable.width - OVERVIEW_PADDING * (cols + 1)) / cols, 1),
+		.height = MAX((usable.height - OVERVIEW_PADDING * (rows + 1)) / rows, 1),
+	};
+	int border = server->theme->osd_border_width;
+	int i = 0;
+	for_each_view(view, &server->views, OVERVIEW_CRITERIA) {
+		if (view->output != output || wlr_box_empty(&view->current)) {
+			continue;
+		}
+		cell.x = usable.x + OVERVIEW_PADDING
+			+ i % cols * (cell.width + OVERVIEW_PADDING);
+		cell.y = usable.y + OVERVIEW_PADDING
+			+ i / cols * (cell.height + OVERVIEW_PADDING);
+		i++;
+
+		struct overview_item item = { .view = view };
+		place_item(&item, &cell, output->wlr_output->scale);
+		item.tree = wlr_scene_tree_create(tree);
+		wlr_scene_node_set_position(&item.tree->node, item.box.x,
+			item.box.y);
+		/* Only the border, the thumbnail covers the rest */
+		item.highlight = scaled_rect_buffer_create_native(item.tree,
+			item.box.width + 2 * border,
+			item.box.height + 2 * border, border,
+			(float[4]){0}, server->theme->osd_border_color);
+		wlr_scene_node_set_position(&item.highlight->tree->node,
+			-border, -border);
+		wlr_scene_node_set_enabled(&item.highlight->tree->node, false);
+		add_icon(server, &item);
+		array_add(&overview.items, item);
+		overview.nr_items++;
+	}
+}
+
+/* Scales all thumbnails down alike if they would exceed the budget */
+static void
+apply_texture_budget(void)
+{
+	double bytes = 0;
+	struct overview_item *item;
+	wl_array_for_each(item, &overview.items) {
+		bytes += 4.0 * item->view->current.width * item->scale
+			* item->view->current.height * item->scale;
+	}
+	if (bytes <= OVERVIEW_TEXTURE_BUDGET) {
+		return;
+	}
+	float factor = sqrt(OVERVIEW_TEXTURE_BUDGET / bytes);
+	wl_array_for_each(item, &overview.items) {
+		item->scale *= factor;
+	}
+}
+
+static int
+handle_timer(void *data)
+{
+	size_t len = nr_slots();
+	struct overview_item *items = overview.items.data;
+	size_t batch = MIN((size_t)OVERVIEW_REFRESH_BATCH, len);
+	for (size_t i = 0; i < batch; i++) {
+		struct overview_item *item = &items[overview.next_refresh];
+		overview.next_refresh = (overview.next_refresh + 1) % len;
+		if (item->view) {
+			refresh_item(item);
+		}
+	}
+	wl_event_source_timer_update(overview.timer, OVERVIEW_REFRESH_MSEC);
+	return 0;
+}
+
+static void
+begin(struct server *server)
+{
+	struct view *active_view = server->active_view;
+	wl_array_init(&overview.trees);
+	wl_array_init(&overview.items);
+	overview.nr_items = 0;
+	overview.next_refresh = 0;
+
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output_is_usable(output)) {
+			add_output(server, output);
+		}
+	}
+	apply_texture_budget();
+
+	size_t selected = 0;
+	struct overview_item *item;
+	wl_array_for_each(item, &overview.items) {
+		refresh_item(item);
+		if (item->view == active_view) {
+			selected = item - (struct overview_item *)overview.items.data;
+		}
+	}
+	overview.selected = SIZE_MAX;
+	if (overview.nr_items) {
+		select_item(selected);
+	}
+
+	overview.timer = wl_event_loop_add_timer(server->wl_event_loop,
+		handle_timer, NULL);
+	wl_event_source_timer_update(overview.timer, OVERVIEW_REFRESH_MSEC);
+
+	seat_focus_override_begin(&server->seat, LAB_INPUT_STATE_OVERVIEW,
+		LAB_CURSOR_DEFAULT);
+	cursor_update_focus(server);
+}
+
+void
+overview_toggle(struct server *server)
+{
+	if (server->input_mode == LAB_INPUT_STATE_OVERVIEW) {
+		overview_finish(server);
+	} else if (server->input_mode == LAB_INPUT_STATE_PASSTHROUGH) {
+		begin(server);
+	}
+}
+
+void
+overview_cycle(struct server *server, enum lab_cycle_dir direction)
+{
+	assert(server->input_mode == LAB_INPUT_STATE_OVERVIEW);
+	if (!overview.nr_items) {
+		return;
+	}
+	size_t len = nr_slots();
+	struct overview_item *items = overview.items.data;
+	size_t i = overview.selected;
+	do {
+		if (direction == LAB_CYCLE_DIR_BACKWARD) {
+			i = (i + len - 1) % len;
+		} else {
+			i = (i + 1) % len;
+		}
+	} while (!items[i].view);
+	select_item(i);
+}
+
+static void
+activate(struct server *server, struct view *view)
+{
+	overview_finish(server);
+	if (view) {
+		desktop_focus_view(view, /*raise*/ true);
+	}
+}
+
+void
+overview_activate(struct server *server)
+{
+	assert(server->input_mode == LAB_INPUT_STATE_OVERVIEW);
+	struct overview_item *items = overview.items.data;
+	activate(server, overview.nr_items
+		? items[overview.selected].view : NULL);
+}
+
+void
+overview_press(struct server *server, double lx, double ly)
+{
+	assert(server->input_mode == LAB_INPUT_STATE_OVERVIEW);
+	struct overview_item *item;
+	wl_array_for_each(item, &overview.items) {
+		if (item->view && wlr_box_contains_point(&item->box, lx, ly)) {
+			activate(server, item->view);
+			return;
+		}
+	}
+	activate(server, NULL);
+}
+
+void
+overview_on_view_destroy(struct view *view)
+{
+	struct server *server = view->server;
+	if (server->input_mode != LAB_INPUT_STATE_OVERVIEW) {
+		return;
+	}
+
+	/* Leave a tombstone, so that the indices stay valid */
+	struct overview_item *items = overview.items.data;
+	struct overview_item *item;
+	wl_array_for_each(item, &overview.items) {
+		if (item->view != view) {
+			continue;
+		}
+		wlr_scene_node_destroy(&item->tree->node);
+		*item = (struct overview_item){0};
+		overview.nr_items--;
+		if (!overview.nr_items) {
+			overview_finish(server);
+		} else if (item == &items[overview.selected]) {
+			overview_cycle(server, LAB_CYCLE_DIR_FORWARD);
+		}
+		return;
+	}
+}
+
+void
+overview_finish(struct server *server)
+{
+	if (server->input_mode != LAB_INPUT_STATE_OVERVIEW) {
+		return;
+	}
+	struct wlr_scene_tree **tree;
+	wl_array_for_each(tree, &overview.trees) {
+		wlr_scene_node_destroy(&(*tree)->node);
+	}
+	wl_array_release(&overview.trees);
+	wl_array_release(&overview.items);
+	overview.nr_items = 0;
+	wl_event_source_remove(overview.timer);
+	overview.timer = NULL;
+
+	seat_focus_override_end(&server->seat);
+	cursor_update_focus(server);
+}
@@ -1,397 +1,508 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
-#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "common/macros.h"
 #include "common/mem.h"
 #include "labwc.h"
 #include "placement.h"
+#include "probe.h"
 #include "ssd.h"
 #include "view.h"
 
-#define overlap_bitmap_index(bmp, i, j) \
-	(bmp)->grid[i * ((bmp)->nr_cols - 1) + j]
+/*
+ * Grid edges along one axis. The first and last edge are the bounds of
+ * the usable area, all others are view edges strictly inside it.
+ */
+struct placement_axis {
+	int nr;
+	int *edges;  /* sorted in increasing order */
+	int *refs;   /* number of view edges on each grid edge */
+};
 
-struct overlap_bitmap {
-	int nr_rows;
-	int nr_cols;
-	int *rows;
-	int *cols;
-	int *grid;
+struct placement_box {
+	struct view *view;
+	struct wlr_box box;  /* including the SSD margin */
+	bool seen;
 };
 
-static int
-compare_ints(const void *a, const void *b)
-{
-	return *(const int *)a - *(const int *)b;
-}
+/*
+ * Persistent per-output placement state. The grid is the irregular grid
+ * that divides the usable area of the output by extending the edges of
+ * every view to infinity. Each interval is either entirely uncovered or
+ * entirely covered by some views, and counts[] holds the number of views
+ * covering it.
+ *
+ * Views are added and removed incrementally by diffing against the boxes
+ * used last time, so mapping one more view only touches the intervals it
+ * covers instead of rebuilding the whole grid. A summed-area table over
+ * the weighted interval areas makes the overlap of any rectangle an O(1)
+ * lookup.
+ */
+struct placement_grid {
+	struct wlr_box usable;
+	struct workspace *workspace;
 
-static void
-destroy_bitmap(struct overlap_bitmap *bmp)
-{
-	assert(bmp);
+	struct placement_axis rows, cols;
+	int *counts;   /* (rows.nr - 1) x (cols.nr - 1) */
+	int64_t *sat;  /* rows.nr x cols.nr */
+	bool sat_dirty;
 
-	zfree(bmp->rows);
-	zfree(bmp->cols);
-	zfree(bmp->grid);
+	struct wl_array boxes;  /* struct placement_box */
+};
 
-	bmp->nr_rows = 0;
-	bmp->nr_cols = 0;
-}
+#define grid_count(grid, i, j) \
+	(grid)->counts[(i) * ((grid)->cols.nr - 1) + (j)]
+#define grid_sat(grid, i, j) \
+	(grid)->sat[(i) * (grid)->cols.nr + (j)]
 
-/* Count the number of views on view->output, excluding *view itself */
+/*
+ * Perform a rightmost binary search along a list of edges in a 1-D grid for
+ * the maximum index j such that edges[j] <= val. The list of edges must be
+ * sorted in increasing order.
+ *
+ * For a returned index j:
+ *
+ * - The index j == -1 implies that val < edges[0].
+ * - An index 0 <= j < (nedges - 1) implies that edges[j] <= val < edges[j + 1].
+ * - The index j == (nedges - 1) implies that edges[nedges - 1] <= val.
+ */
 static int
-count_views(struct view *view)
+find_interval(int *edges, int nedges, double val)
 {
-	assert(view);
-
-	struct server *server = view->server;
+	int l = 0;
+	int r = nedges;
 
-	struct output *output = view->output;
-	if (!output_is_usable(output)) {
-		return 0;
+	while (l < r) {
+		int m = (l + r) / 2;
+		if (edges[m] > val) {
+			r = m;
+		} else {
+			l = m + 1;
+		}
 	}
 
-	int nviews = 0;
+	return r - 1;
+}
 
-	struct view *v;
-	for_each_view(v, &server->views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
-		/* Ignore the target view or anything on a different output */
-		if (v == view || v->output != output) {
-			continue;
-		}
+/* Index of the grid edge at exactly @val, which must exist */
+static int
+axis_index(struct placement_axis *axis, int val)
+{
+	int idx = find_interval(axis->edges, axis->nr, val);
+	assert(idx >= 0 && axis->edges[idx] == val);
+	return idx;
+}
 
-		nviews++;
-	}
+static void
+axis_init(struct placement_axis *axis, int low, int high)
+{
+	axis->nr = 2;
+	axis->edges = znew_n(*axis->edges, 2);
+	axis->refs = znew_n(*axis->refs, 2);
+	axis->edges[0] = low;
+	axis->edges[1] = high;
+}
 
-	return nviews;
+static void
+axis_finish(struct placement_axis *axis)
+{
+	zfree(axis->edges);
+	zfree(axis->refs);
+	axis->nr = 0;
 }
 
-/* Sort and de-duplicate a list of points that define a 1-D grid */
-static int
-order_grid(int *edges, int nedges)
+static bool
+axis_is_interior(struct placement_axis *axis, int val)
+{
+	return val > axis->edges[0] && val < axis->edges[axis->nr - 1];
+}
+
+/*
+ * Insert a new grid edge in front of @idx of @axis, which splits interval
+ * idx - 1 in two. Both halves keep the overlap count of the old interval.
+ */
+static void
+grid_insert_edge(struct placement_grid *grid, bool is_col, int idx, int val)
 {
-	/* Sort grid edges */
-	qsort(edges, nedges, sizeof(int), compare_ints);
-
-	/* Skip over non-unique edges, counting the unique ones */
-	/* This is taken almost verbatim from Openbox. */
-	int i = 0;
-	int j = 0;
-
-	while (j < nedges) {
-		int last = edges[j++];
-		edges[i++] = last;
-		while (j < nedges && edges[j] == last) {
-			++j;
+	struct placement_axis *axis = is_col ? &grid->cols : &grid->rows;
+	int old_rows = grid->rows.nr - 1;
+	int old_cols = grid->cols.nr - 1;
+	int *old = grid->counts;
+
+	axis->edges = xrealloc(axis->edges, (axis->nr + 1) * sizeof(int));
+	axis->refs = xrealloc(axis->refs, (axis->nr + 1) * sizeof(int));
+	memmove(&axis->edges[idx + 1], &axis->edges[idx],
+		(axis->nr - idx) * sizeof(int));
+	memmove(&axis->refs[idx + 1], &axis->refs[idx],
+		(axis->nr - idx) * sizeof(int));
+	axis->edges[idx] = val;
+	axis->refs[idx] = 0;
+	axis->nr++;
+
+	grid->counts = znew_n(*grid->counts,
+		(grid->rows.nr - 1) * (grid->cols.nr - 1));
+	for (int i = 0; i < grid->rows.nr - 1; i++) {
+		int oi = (!is_col && i >= idx) ? i - 1 : i;
+		for (int j = 0; j < grid->cols.nr - 1; j++) {
+			int oj = (is_col && j >= idx) ? j - 1 : j;
+			assert(oi < old_rows && oj < old_cols);
+			grid_count(grid, i, j) = old[oi * old_cols + oj];
 		}
 	}
-
-	return i;
+	free(old);
 }
 
 /*
- * Construct an irregular grid that divides the usable area of view->output
- * by extending the edges of every view on the output (except for *view itself)
- * to infinity. The resulting grid will consist of rectangular intervals that
- * are either completely uncovered by any view, or entirely covered.
- * Furthermore, when any view intersects any interval on the grid, that view
- * overlaps the whole interval: no view ever partially intersects any interval.
+ * Remove grid edge @idx of @axis, which merges intervals idx - 1 and idx.
+ * No view has an edge there anymore, so both have the same overlap count.
  */
 static void
-build_grid(struct overlap_bitmap *bmp, struct view *view)
+grid_remove_edge(struct placement_grid *grid, bool is_col, int idx)
 {
-	assert(bmp);
-	assert(view);
-
-	struct server *server = view->server;
-
-	/* Always start with a fresh bitmap */
-	destroy_bitmap(bmp);
+	struct placement_axis *axis = is_col ? &grid->cols : &grid->rows;
+	int old_cols = grid->cols.nr - 1;
+	int *old = grid->counts;
+
+	memmove(&axis->edges[idx], &axis->edges[idx + 1],
+		(axis->nr - idx - 1) * sizeof(int));
+	memmove(&axis->refs[idx], &axis->refs[idx + 1],
+		(axis->nr - idx - 1) * sizeof(int));
+	axis->nr--;
+
+	grid->counts = znew_n(*grid->counts,
+		(grid->rows.nr - 1) * (grid->cols.nr - 1));
+	for (int i = 0; i < grid->rows.nr - 1; i++) {
+		int oi = (!is_col && i >= idx) ? i + 1 : i;
+		for (int j = 0; j < grid->cols.nr - 1; j++) {
+			int oj = (is_col && j >= idx) ? j + 1 : j;
+			grid_count(grid, i, j) = old[oi * old_cols + oj];
+		}
+	}
+	free(old);
+}
 
-	struct output *output = view->output;
-	if (!output_is_usable(output)) {
+static void
+grid_ref_edge(struct placement_grid *grid, bool is_col, int val)
+{
+	struct placement_axis *axis = is_col ? &grid->cols : &grid->rows;
+	if (!axis_is_interior(axis, val)) {
 		return;
 	}
+	int idx = find_interval(axis->edges, axis->nr, val);
+	if (axis->edges[idx] != val) {
+		idx++;
+		grid_insert_edge(grid, is_col, idx, val);
+	}
+	axis->refs[idx]++;
+}
 
-	int nviews = count_views(view);
-	if (nviews < 1) {
+static void
+grid_unref_edge(struct placement_grid *grid, bool is_col, int val)
+{
+	struct placement_axis *axis = is_col ? &grid->cols : &grid->rows;
+	if (!axis_is_interior(axis, val)) {
 		return;
 	}
+	int idx = axis_index(axis, val);
+	assert(axis->refs[idx] > 0);
+	if (--axis->refs[idx] == 0) {
+		grid_remove_edge(grid, is_col, idx);
+	}
+}
 
-	/* Number of rows/columns is bounded by two per view plus screen edges */
-	int max_rc = 2 * nviews + 2;
-
-	bmp->rows = xzalloc(max_rc * sizeof(int));
-	bmp->cols = xzalloc(max_rc * sizeof(int));
-	if (!bmp->rows || !bmp->cols) {
-		destroy_bitmap(bmp);
+/* Add @delta to the overlap count of all intervals covered by @box */
+static void
+grid_cover(struct placement_grid *grid, struct wlr_box *box, int delta)
+{
+	int x0 = MAX(box->x, grid->cols.edges[0]);
+	int y0 = MAX(box->y, grid->rows.edges[0]);
+	int x1 = MIN(box->x + box->width, grid->cols.edges[grid->cols.nr - 1]);
+	int y1 = MIN(box->y + box->height, grid->rows.edges[grid->rows.nr - 1]);
+	if (x0 >= x1 || y0 >= y1) {
 		return;
 	}
 
-	/* First edges of grid are start of usable area of output */
-	struct wlr_box usable = output_usable_area_in_layout_coords(output);
-	int usable_right = usable.x + usable.width;
-	int usable_bottom = usable.y + usable.height;
-
-	bmp->cols[0] = usable.x;
-	bmp->rows[0] = usable.y;
-
-	bmp->cols[1] = usable_right;
-	bmp->rows[1] = usable_bottom;
-
-	int nr_rows = 2;
-	int nr_cols = 2;
-
-	struct view *v;
-	for_each_view(v, &server->views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
-		if (v == view || v->output != output) {
-			continue;
+	/* By construction, all four view edges are on grid edges */
+	int fc = axis_index(&grid->cols, x0);
+	int lc = axis_index(&grid->cols, x1);
+	int fr = axis_index(&grid->rows, y0);
+	int lr = axis_index(&grid->rows, y1);
+	for (int i = fr; i < lr; i++) {
+		for (int j = fc; j < lc; j++) {
+			grid_count(grid, i, j) += delta;
+			assert(grid_count(grid, i, j) >= 0);
 		}
+	}
+	grid->sat_dirty = true;
+}
 
-		struct border margin = ssd_get_margin(v->ssd);
-		int x = v->pending.x - margin.left;
-		int y = v->pending.y - margin.top;
-
-		/* Add a column if the left view edge is in the usable region */
-		if (x > usable.x && x < usable_right) {
-			assert(nr_cols < max_rc);
-			bmp->cols[nr_cols++] = x;
-		}
+static void
+grid_add_box(struct placement_grid *grid, struct wlr_box *box)
+{
+	grid_ref_edge(grid, /* is_col */ true, box->x);
+	grid_ref_edge(grid, /* is_col */ true, box->x + box->width);
+	grid_ref_edge(grid, /* is_col */ false, box->y);
+	grid_ref_edge(grid, /* is_col */ false, box->y + box->height);
+	grid_cover(grid, box, 1);
+}
 
-		/* Add a row if the top view edge is in the usable region */
-		if (y > usable.y && y < usable_bottom) {
-			assert(nr_rows < max_rc);
-			bmp->rows[nr_rows++] = y;
-		}
+static void
+grid_remove_box(struct placement_grid *grid, struct wlr_box *box)
+{
+	/* Counts must be updated first so that merged intervals agree */
+	grid_cover(grid, box, -1);
+	grid_unref_edge(grid, /* is_col */ true, box->x);
+	grid_unref_edge(grid, /* is_col */ true, box->x + box->width);
+	grid_unref_edge(grid, /* is_col */ false, box->y);
+	grid_unref_edge(grid, /* is_col */ false, box->y + box->height);
+}
 
-		x = v->pending.x + margin.right + v->pending.width;
-		y = v->pending.y + margin.bottom
-			+ view_effective_height(v, /* use_pending */ true);
+static void
+grid_init(struct placement_grid *grid, struct wlr_box *usable,
+		struct workspace *workspace)
+{
+	*grid = (struct placement_grid){
+		.usable = *usable,
+		.workspace = workspace,
+		.sat_dirty = true,
+	};
+	axis_init(&grid->cols, usable->x, usable->x + usable->width);
+	axis_init(&grid->rows, usable->y, usable->y + usable->height);
+	grid->counts = znew_n(*grid->counts, 1);
+	wl_array_init(&grid->boxes);
+}
 
-		/* Add a column if the right view edge is in the usable region */
-		if (x > usable.x && x < usable_right) {
-			assert(nr_cols < max_rc);
-			bmp->cols[nr_cols++] = x;
-		}
+static void
+grid_finish(struct placement_grid *grid)
+{
+	axis_finish(&grid->cols);
+	axis_finish(&grid->rows);
+	zfree(grid->counts);
+	zfree(grid->sat);
+	wl_array_release(&grid->boxes);
+}
 
-		/* Add a row if the bottom view edge is in the usable region */
-		if (y > usable.y && y < usable_bottom) {
-			assert(nr_rows < max_rc);
-			bmp->rows[nr_rows++] = y;
+/*
+ * Summed-area table over the grid: grid_sat(i, j) is the overlap-weighted
+ * area of the region between the first and the i-th row edge and the first
+ * and the j-th column edge.
+ */
+static void
+grid_update_sat(struct placement_grid *grid)
+{
+	if (!grid->sat_dirty) {
+		return;
+	}
+	int nr = grid->rows.nr;
+	int nc = grid->cols.nr;
+	free(grid->sat);
+	grid->sat = znew_n(*grid->sat, nr * nc);
+	for (int i = 1; i < nr; i++) {
+		int64_t rh = grid->rows.edges[i] - grid->rows.edges[i - 1];
+		int64_t row_sum = 0;
+		for (int j = 1; j < nc; j++) {
+			int64_t cw = grid->cols.edges[j] - grid->cols.edges[j - 1];
+			row_sum += grid_count(grid, i - 1, j - 1) * rh * cw;
+			grid_sat(grid, i, j) = grid_sat(grid, i - 1, j) + row_sum;
 		}
 	}
+	grid->sat_dirty = false;
+}
 
-	bmp->nr_rows = order_grid(bmp->rows, nr_rows);
-	bmp->nr_cols = order_grid(bmp->cols, nr_cols);
-
-	int grid_size = (bmp->nr_rows - 1) * (bmp->nr_cols - 1);
+/* Index of the interval containing @val, which must be within the grid */
+static int
+axis_locate(struct placement_axis *axis, int val)
+{
+	int idx = find_interval(axis->edges, axis->nr, val);
+	return MIN(MAX(idx, 0), axis->nr - 2);
+}
 
-	bmp->grid = xzalloc(grid_size * sizeof(int));
-	if (!bmp->grid) {
-		destroy_bitmap(bmp);
-		return;
-	}
+/*
+ * Overlap-weighted area of the region from the top-left corner of the
+ * grid to the point (x, y), which lies in interval (r, c) or on its right
+ * or bottom edge. The overlap count is constant within an interval, so
+ * the area is bilinear in the position of the point inside its interval.
+ */
+static int64_t
+grid_area_to(struct placement_grid *grid, int r, int c, int x, int y)
+{
+	int64_t dx = x - grid->cols.edges[c];
+	int64_t dy = y - grid->rows.edges[r];
+	int64_t cw = grid->cols.edges[c + 1] - grid->cols.edges[c];
+	int64_t rh = grid->rows.edges[r + 1] - grid->rows.edges[r];
+
+	int64_t base = grid_sat(grid, r, c);
+	/* Area of the intervals above and to the left, exactly divisible */
+	int64_t above = (grid_sat(grid, r, c + 1) - base) / cw;
+	int64_t left = (grid_sat(grid, r + 1, c) - base) / rh;
+
+	return base + dx * above + dy * left
+		+ dx * dy * grid_count(grid, r, c);
 }
 
 /*
- * Perform a rightmost binary search along a list of edges in a 1-D grid for
- * the maximum index j such that edges[j] <= val. The list of edges must be
- * sorted in increasing order.
+ * Find the total overlap of a region of a given width and height that
+ * starts in interval (i, j). If the region is larger than the interval, it
+ * extends rightward (when right is true) or leftward (otherwise) and
+ * downward (when down is true) or upward (otherwise).
  *
- * For a returned index j:
- *
- * - The index j == -1 implies that val < edges[0].
- * - An index 0 <= j < (nedges - 1) implies that edges[j] <= val < edges[j + 1].
- * - The index j == (nedges - 1) implies that edges[nedges - 1] <= val.
+ * If the region would extend beyond the edges of the grid (i.e. beyond the
+ * usable region of an output), an overlap of INT64_MAX is returned.
+ * Otherwise, the overlap is the sum of the areas of each interval covered
+ * by the region multiplied by its overlap count. For example, an interval
+ * currently covered by three windows will be triply counted in the overlap
+ * sum.
  */
-static int
-find_interval(int *edges, int nedges, double val)
+static int64_t
+compute_overlap(struct placement_grid *grid, int i, int j,
+		int width, int height, bool right, bool down, bool *single)
 {
-	int l = 0;
-	int r = nedges;
-
-	while (l < r) {
-		int m = (l + r) / 2;
-		if (edges[m] > val) {
-			r = m;
-		} else {
-			l = m + 1;
-		}
+	int *cols = grid->cols.edges;
+	int *rows = grid->rows.edges;
+
+	/* Indicate whether the region fits into a single interval */
+	*single = width <= cols[j + 1] - cols[j]
+		&& height <= rows[i + 1] - rows[i];
+
+	int x0 = right ? cols[j] : cols[j + 1] - width;
+	int y0 = down ? rows[i] : rows[i + 1] - height;
+	int x1 = x0 + width;
+	int y1 = y0 + height;
+	if (x0 < cols[0] || y0 < rows[0] || x1 > cols[grid->cols.nr - 1]
+			|| y1 > rows[grid->rows.nr - 1]) {
+		return INT64_MAX;
 	}
 
-	return r - 1;
+	/*
+	 * The anchored corners lie in the starting interval, so only the
+	 * opposite corners have to be searched for.
+	 */
+	int c0 = right ? j : axis_locate(&grid->cols, x0);
+	int c1 = right ? axis_locate(&grid->cols, x1) : j;
+	int r0 = down ? i : axis_locate(&grid->rows, y0);
+	int r1 = down ? axis_locate(&grid->rows, y1) : i;
+
+	/* Four lookups in the summed-area table */
+	return grid_area_to(grid, r1, c1, x1, y1)
+		- grid_area_to(grid, r1, c0, x0, y1)
+		- grid_area_to(grid, r0, c1, x1, y0)
+		+ grid_area_to(grid, r0, c0, x0, y0);
+}
+
+static struct wlr_box
+view_box_with_margin(struct view *view)
+{
+	struct border margin = ssd_get_margin(view->ssd);
+	return (struct wlr_box){
+		.x = view->pending.x - margin.left,
+		.y = view->pending.y - margin.top,
+		.width = view->pending.width + margin.left + margin.right,
+		.height = view_effective_height(view, /* use_pending */ true)
+			+ margin.top + margin.bottom,
+	};
 }
 
 /*
- * Construct an overlap bitmap for the irregular grid, computed by
- * build_grid(), that spans view->output. The overlap bitmap maps
- * each interval to the number of views on the output (excluding *view)
- * that overlap that interval.
+ * Bring the placement grid of view->output up to date with all views on
+ * the output (excluding *view itself). Returns the number of views.
  */
-static void
-build_overlap(struct overlap_bitmap *bmp, struct view *view)
+static int
+grid_sync(struct placement_grid *grid, struct view *view)
 {
-	assert(bmp);
-	assert(view);
-
 	struct server *server = view->server;
+	struct output *output = view->output;
 
-	if (bmp->nr_rows < 1 || bmp->nr_cols < 1) {
-		return;
+	struct placement_box *pbox;
+	wl_array_for_each(pbox, &grid->boxes) {
+		pbox->seen = false;
 	}
 
-	struct output *output = view->output;
-	if (!output_is_usable(output)) {
-		return;
-	}
+	struct wl_array added;
+	wl_array_init(&added);
+	int nviews = 0;
 
 	struct view *v;
 	for_each_view(v, &server->views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+		/* Ignore the target view or anything on a different output */
 		if (v == view || v->output != output) {
 			continue;
 		}
+		nviews++;
 
-		/* Find boundaries of the window */
-		struct border margin = ssd_get_margin(v->ssd);
-		int lx = v->pending.x - margin.left;
-		int ly = v->pending.y - margin.top;
-		int hx = v->pending.x + margin.right + v->pending.width;
-		int hy = v->pending.y + margin.bottom
-			+ view_effective_height(v, /* use_pending */ true);
-
-		/*
-		 * Find the first and last row and column intervals spanned by
-		 * this view. We want the left and top edges to fall in a
-		 * half-open interval [low, high) but the right and bottom
-		 * edges to fall in a half-open interval (low, high] to ensure
-		 * that the results do not include intervals adjacent to the
-		 * view. View edges are guaranteed by construction to fall
-		 * exactly on the grid points, so we perturb the left and top
-		 * edges by +0.5 units, and the right and bottom edges by -0.5
-		 * units, to ensure that we are always searching in the
-		 * interior of an interval.
-		 */
-
-		/* First row and column overlapping the view */
-		int fc = find_interval(bmp->cols, bmp->nr_cols, lx + 0.5);
-		int fr = find_interval(bmp->rows, bmp->nr_rows, ly + 0.5);
-
-		/* Clip first row/column to start of usable grid */
-		fc = MAX(fc, 0);
-		fr = MAX(fr, 0);
-
-		/* Last row and column overlapping the view */
-		int lc = find_interval(bmp->cols, bmp->nr_cols, hx - 0.5);
-		int lr = find_interval(bmp->rows, bmp->nr_rows, hy - 0.5);
-
-		/*
-		 * Increment the last indices to convert them to strict upper
-		 * bounds, then clip them to the limits of the usable grid.
-		 */
-		lc = MIN(bmp->nr_cols - 1, lc + 1);
-		lr = MIN(bmp->nr_rows - 1, lr + 1);
-
-		/*
-		 * Every interval in the region [fr, lr) x [fc, lc) is
-		 * completely covered by the view. Increment the overlap
-		 * counters these intervals to account for the view.
-		 */
-		for (int i = fr; i < lr; ++i) {
-			for (int j = fc; j < lc; ++j) {
-				overlap_bitmap_index(bmp, i, j) += 1;
+		struct wlr_box box = view_box_with_margin(v);
+		bool found = false;
+		wl_array_for_each(pbox, &grid->boxes) {
+			if (!pbox->seen && pbox->view == v
+					&& wlr_box_equal(&pbox->box, &box)) {
+				pbox->seen = true;
+				found = true;
+				break;
 			}
 		}
-	}
-}
-
-/*
- * Find the total overlap of an arbitrary region of a given width and height
- * with intervals in a pre-computed overlap bitmap. The starting interval for
- * the region is (i, j) in the bitmap grid. If the region is larger than
- * interval (i, j), neighboring regions will be considered width-wise rightward
- * (when right is true) or leftward (otherwise) and height-wise downward (when
- * down is true) or upward (otherwise).
- *
- * If the region would extend beyond the edges of the grid (i.e., beyond the
- * usable region of an output) in the prescribed directions, an overlap of
- * INT_MAX is returned. Otherwise, the overlap is the sum of the areas of each
- * interval covered by the region multiplied by its overlap count. For example,
- * an interval currently covered by three windows will be triply counted in the
- * overlap sum.
- */
-static int
-compute_overlap(struct overlap_bitmap *bmp, int i, int j,
-		int width, int height, bool right, bool down, bool *single)
-{
-	/*
-	 * The number of row or column intervals is one less than corresponding
-	 * number of row or column grid points.
-	 */
-	int nri = bmp->nr_rows - 1;
-	int nci = bmp->nr_cols - 1;
-
-	int i_incr = down ? 1 : -1;
-	int j_incr = right ? 1 : -1;
-
-	int overlap = 0;
-	int count = 0;
-
-	/* Walk up or down along rows according to preference */
-	for (int ii = i; ii >= 0 && ii < nri && height > 0; ii += i_incr) {
-		/* Height of this row */
-		int rh = bmp->rows[ii + 1] - bmp->rows[ii];
-
-		/* Height of overlap between this row and test region */
-		int mh = MAX(0, MIN(height, rh));
-
-		/* Remaining height to consider for next row */
-		height -= rh;
-
-		/* Walk left or right along columns according to preference */
-		int ww = width;
-		for (int jj = j; jj >= 0 && jj < nci && ww > 0; jj += j_incr) {
-			/* Width of this column */
-			int cw = bmp->cols[jj + 1] - bmp->cols[jj];
-
-			/* Width of overlap between this column and test region */
-			int mw = MAX(0, MIN(ww, cw));
-
-			/* Add overlap contribution for this interval */
-			overlap += overlap_bitmap_index(bmp, ii, jj) * mh * mw;
-
-			/* Count the number of overlapping intervals */
-			count++;
-
-			/* Remaining width to consider for next column */
-			ww -= cw;
+		if (!found) {
+			struct placement_box *new =
+				wl_array_add(&added, sizeof(*new));
+			*new = (struct placement_box){ .view = v, .box = box };
 		}
+	}
 
-		/*
-		 * If there is width left to consider after walking columns,
-		 * the region extends out of bounds and placement is invalid.
-		 */
-		if (ww > 0) {
-			overlap = INT_MAX;
-			break;
+	/* Drop views which were unmapped, moved or resized */
+	struct placement_box *boxes = grid->boxes.data;
+	size_t nr = grid->boxes.size / sizeof(*boxes);
+	size_t kept = 0;
+	for (size_t i = 0; i < nr; i++) {
+		if (boxes[i].seen) {
+			boxes[kept++] = boxes[i];
+		} else {
+			grid_remove_box(grid, &boxes[i].box);
 		}
 	}
-
-	/*
-	 * If there is height left to consider after walking rows, the region
-	 * extends out of bounds and placement is invalid.
-	 */
-	if (height > 0) {
-		overlap = INT_MAX;
+	grid->boxes.size = kept * sizeof(*boxes);
+
+	wl_array_for_each(pbox, &added) {
+		grid_add_box(grid, &pbox->box);
+		struct placement_box *new =
+			wl_array_add(&grid->boxes, sizeof(*new));
+		*new = *pbox;
+		new->seen = true;
 	}
+	wl_array_release(&added);
+
+	grid_update_sat(grid);
+	return nviews;
+}
 
-	/* Indicate whether overlap is confined to a single region */
-	if (single) {
-		*single = (count == 1);
+static struct placement_grid *
+get_grid(struct output *output, struct view *view)
+{
+	struct wlr_box usable = output_usable_area_in_layout_coords(output);
+	struct workspace *workspace = view->server->workspaces.current;
+
+	struct placement_grid *grid = output->placement_grid;
+	if (grid && (grid->workspace != workspace
+			|| !wlr_box_equal(&grid->usable, &usable))) {
+		/* Everything changes, start from scratch */
+		grid_finish(grid);
+		grid_init(grid, &usable, workspace);
+	} else if (!grid) {
+		grid = znew(*grid);
+		grid_init(grid, &usable, workspace);
+		output->placement_grid = grid;
 	}
+	return grid;
+}
 
-	return overlap;
+void
+placement_finish(struct output *output)
+{
+	if (output->placement_grid) {
+		grid_finish(output->placement_grid);
+		zfree(output->placement_grid);
+	}
 }
 
 /*
@@ -400,8 +511,8 @@ compute_overlap(struct overlap_bitmap *bmp, int i, int j,
  * overlap with all other views. The values geometry->x and geometry->y will be
  * overwritten with the optimum placement.
  */
-bool
-placement_find_best(struct view *view, struct wlr_box *geometry)
+static bool
+find_best(struct view *view, struct wlr_box *geometry)
 {
 	assert(view);
 
@@ -417,10 +528,11 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 	geometry->x = usable.x + margin.left + rc.gap;
 	geometry->y = usable.y + margin.top + rc.gap;
 
-	/* Build the placement grid and overlap bitmap */
-	struct overlap_bitmap bmp = { 0 };
-	build_grid(&bmp, view);
-	build_overlap(&bmp, view);
+	/* Bring the placement grid and summed-area table up to date */
+	struct placement_grid *grid = get_grid(output, view);
+	if (grid_sync(grid, view) < 1) {
+		return true;
+	}
 
 	/* Dimensions include gap along all edges to ensure proper separation */
 	int height = geometry->height + margin.top + margin.bottom + 2 * rc.gap;
@@ -433,10 +545,12 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 	int offset_x = margin.left + rc.gap;
 	int offset_y = margin.top + rc.gap;
 
-	int min_overlap = INT_MAX;
+	int64_t min_overlap = INT64_MAX;
 
-	int nri = bmp.nr_rows - 1;
-	int nci = bmp.nr_cols - 1;
+	int nri = grid->rows.nr - 1;
+	int nci = grid->cols.nr - 1;
+	int *rows = grid->rows.edges;
+	int *cols = grid->cols.edges;
 
 	/*
 	 * Convolve the view region with the overlap grid to determine the
@@ -477,7 +591,7 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 				bool single = false;
 
 				/* Compute overlap in specified direction */
-				int overlap = compute_overlap(&bmp, i, j,
+				int64_t overlap = compute_overlap(grid, i, j,
 					width, height, rt, dn, &single);
 
 				/* Move on if overlap isn't reduced */
@@ -490,25 +604,25 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 
 				if (rt) {
 					/* Extend window right from left edge */
-					geometry->x = bmp.cols[j] + offset_x;
+					geometry->x = cols[j] + offset_x;
 				} else {
 					/* Extend window left from right edge */
 					geometry->x =
-						bmp.cols[j + 1] - width + offset_x;
+						cols[j + 1] - width + offset_x;
 				}
 
 				if (dn) {
 					/* Extend window down from top edge */
-					geometry->y = bmp.rows[i] + offset_y;
+					geometry->y = rows[i] + offset_y;
 				} else {
 					/* Extend window up from bottom edge */
 					geometry->y =
-						bmp.rows[i + 1] - height + offset_y;
+						rows[i + 1] - height + offset_y;
 				}
 
 				/* If there is no overlap, the search is done. */
 				if (min_overlap <= 0) {
-					goto final_placement;
+					return true;
 				}
 
 				/*
@@ -522,7 +636,15 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 		}
 	}
 
-final_placement:
-	destroy_bitmap(&bmp);
 	return true;
 }
+
+bool
+placement_find_best(struct view *view, struct wlr_box *geometry)
+{
+	struct probe_timer timer;
+	probe_begin(&timer);
+	bool found = find_best(view, geometry);
+	probe_end(&timer, LAB_PROBE_PLACEMENT_FIND_BEST);
+	return found;
+}
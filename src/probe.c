@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * probe.c: opt-in run time statistics of selected functions
+ *
+ * Durations are collected in a histogram with power-of-two buckets, so a
+ * percentile is reported as the upper bound of the bucket it falls into.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <wlr/util/log.h>
+#include "common/macros.h"
+#include "config/rcxml.h"
+#include "probe.h"
+
+/* Bucket n collects durations below 2^n ns, the last one everything else */
+#define PROBE_BUCKETS 40
+
+struct probe_stats {
+	uint64_t count;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint64_t histogram[PROBE_BUCKETS];
+};
+
+static const char *site_names[LAB_PROBE_COUNT] = {
+	[LAB_PROBE_PLACEMENT_FIND_BEST] = "placement_find_best",
+	[LAB_PROBE_WORKSPACES_SWITCH_TO] = "workspaces_switch_to",
+	[LAB_PROBE_WORKSPACES_SETTLE] = "workspaces_settle",
+	[LAB_PROBE_GET_CURSOR_CONTEXT] = "get_cursor_context",
+};
+
+static struct probe_stats stats[LAB_PROBE_COUNT];
+
+void
+probe_begin(struct probe_timer *timer)
+{
+	timer->running = rc.frame_timing;
+	if (timer->running) {
+		clock_gettime(CLOCK_MONOTONIC, &timer->start);
+	}
+}
+
+static unsigned int
+bucket_of(uint64_t ns)
+{
+	unsigned int bucket = 0;
+	while (bucket < PROBE_BUCKETS - 1 && ns >= (1ULL << bucket)) {
+		bucket++;
+	}
+	return bucket;
+}
+
+void
+probe_end(struct probe_timer *timer, enum probe_site site)
+{
+	assert(site < LAB_PROBE_COUNT);
+	if (!timer->running) {
+		return;
+	}
+	timer->running = false;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t ns = (int64_t)(now.tv_sec - timer->start.tv_sec) * 1000000000
+		+ (now.tv_nsec - timer->start.tv_nsec);
+	if (ns < 0) {
+		ns = 0;
+	}
+
+	struct probe_stats *s = &stats[site];
+	s->count++;
+	s->total_ns += ns;
+	s->max_ns = MAX(s->max_ns, (uint64_t)ns);
+	s->histogram[bucket_of(ns)]++;
+}
+
+/* Upper bound in ns of the bucket holding the nearest-rank percentile */
+static uint64_t
+percentile_ns(const struct probe_stats *s, unsigned int permille)
+{
+	uint64_t rank = (s->count * permille + 999) / 1000;
+	uint64_t sum = 0;
+	for (unsigned int bucket = 0; bucket < PROBE_BUCKETS; bucket++) {
+		sum += s->histogram[bucket];
+		if (sum >= rank && sum) {
+			return MIN(1ULL << bucket, s->max_ns);
+		}
+	}
+	return s->max_ns;
+}
+
+void
+probe_log_summary(void)
+{
+	for (size_t site = 0; site < LAB_PROBE_COUNT; site++) {
+		const struct probe_stats *s = &stats[site];
+		if (!s->count) {
+			continue;
+		}
+		wlr_log(WLR_INFO, "%s: %lu calls, mean=%.3fms max=%.3fms "
+			"p50<=%.3fms p99<=%.3fms", site_names[site],
+			(unsigned long)s->count, s->total_ns / 1e6 / s->count,
+			s->max_ns / 1e6, percentile_ns(s, 500) / 1e6,
+			percentile_ns(s, 990) / 1e6);
+	}
+}
+
+void
+probe_reset(void)
+{
+	memset(stats, 0, sizeof(stats));
+}
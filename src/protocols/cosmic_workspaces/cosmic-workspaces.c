@@ -8,14 +8,13 @@
 #include "cosmic-workspace-unstable-v1-protocol.h"
 #include "protocols/cosmic-workspaces.h"
 #include "protocols/cosmic-workspaces-internal.h"
+#include "protocols/rate-limit.h"
 #include "protocols/transaction-addon.h"
 
 /*
  *	.--------------------.
  *	|        TODO        |
  *	|--------------------|
- *	| - prevent empty    |
- *	|   done events      |
  *	| - go through xml   |
  *	|   and verify impl  |
  *	| - assert pub API   |
@@ -77,6 +76,8 @@ add_caps(struct wl_array *caps_arr, uint32_t caps)
 	}
 }
 
+static void manager_schedule_idle(struct lab_cosmic_workspace_manager *manager);
+
 /* Workspace */
 static void
 workspace_handle_destroy(struct wl_client *client, struct wl_resource *resource)
@@ -93,8 +94,8 @@ workspace_handle_activate(struct wl_client *client, struct wl_resource *resource
 		return;
 	}
 	struct lab_cosmic_workspace *workspace = addon->data;
-	lab_transaction_op_add(addon->ctx, CW_PENDING_WS_ACTIVATE,
-		workspace, /*data*/ NULL);
+	lab_transaction_op_add_unique(addon->ctx, CW_PENDING_WS_ACTIVATE,
+		workspace, /*data*/ NULL, CW_PENDING_WS_STATE);
 }
 
 static void
@@ -106,8 +107,8 @@ workspace_handle_deactivate(struct wl_client *client, struct wl_resource *resour
 		return;
 	}
 	struct lab_cosmic_workspace *workspace = addon->data;
-	lab_transaction_op_add(addon->ctx, CW_PENDING_WS_DEACTIVATE,
-		workspace, /*data*/ NULL);
+	lab_transaction_op_add_unique(addon->ctx, CW_PENDING_WS_DEACTIVATE,
+		workspace, /*data*/ NULL, CW_PENDING_WS_STATE);
 }
 
 static void
@@ -219,7 +220,7 @@ workspace_set_state(struct lab_cosmic_workspace *workspace,
 	} else {
 		workspace->state_pending &= ~state;
 	}
-	cosmic_manager_schedule_done_event(workspace->group->manager);
+	manager_schedule_idle(workspace->group->manager);
 }
 
 /* Group */
@@ -318,9 +319,17 @@ manager_handle_commit(struct wl_client *client, struct wl_resource *resource)
 		return;
 	}
 
+	struct lab_transaction_op *trans_op, *trans_op_tmp;
+	if (!lab_rate_limit_allow(client, LAB_RATE_LIMIT_WORKSPACE_COMMIT)) {
+		/* Drop the whole transaction */
+		lab_transaction_for_each_safe(trans_op, trans_op_tmp, addon->ctx) {
+			lab_transaction_op_destroy(trans_op);
+		}
+		return;
+	}
+
 	struct lab_cosmic_workspace *workspace;
 	struct lab_cosmic_workspace_group *group;
-	struct lab_transaction_op *trans_op, *trans_op_tmp;
 	lab_transaction_for_each_safe(trans_op, trans_op_tmp, addon->ctx) {
 		switch (trans_op->change) {
 		case CW_PENDING_WS_CREATE:
@@ -442,6 +451,10 @@ static void
 manager_idle_send_done(void *data)
 {
 	struct lab_cosmic_workspace_manager *manager = data;
+	manager->idle_source = NULL;
+
+	bool changed = manager->serial != manager->done_serial;
+	manager->done_serial = manager->serial;
 
 	struct lab_cosmic_workspace *workspace;
 	struct lab_cosmic_workspace_group *group;
@@ -450,20 +463,24 @@ manager_idle_send_done(void *data)
 			if (workspace->state != workspace->state_pending) {
 				workspace->state = workspace->state_pending;
 				workspace_send_state(workspace, /*target*/ NULL);
+				changed = true;
 			}
 		}
 	}
 
+	/* State changes may have cancelled each other out */
+	if (!changed) {
+		return;
+	}
+
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &manager->resources) {
 		zcosmic_workspace_manager_v1_send_done(resource);
 	}
-	manager->idle_source = NULL;
 }
 
-/* Internal API */
-void
-cosmic_manager_schedule_done_event(struct lab_cosmic_workspace_manager *manager)
+static void
+manager_schedule_idle(struct lab_cosmic_workspace_manager *manager)
 {
 	if (manager->idle_source) {
 		return;
@@ -475,6 +492,14 @@ cosmic_manager_schedule_done_event(struct lab_cosmic_workspace_manager *manager)
 		manager->event_loop, manager_idle_send_done, manager);
 }
 
+/* Internal API */
+void
+cosmic_manager_schedule_done_event(struct lab_cosmic_workspace_manager *manager)
+{
+	manager->serial++;
+	manager_schedule_idle(manager);
+}
+
 /* Public API */
 struct lab_cosmic_workspace_manager *
 lab_cosmic_workspace_manager_create(struct wl_display *display, uint32_t caps, uint32_t version)
@@ -637,8 +662,8 @@ lab_cosmic_workspace_set_name(struct lab_cosmic_workspace *workspace, const char
 		wl_resource_for_each(resource, &workspace->resources) {
 			zcosmic_workspace_handle_v1_send_name(resource, workspace->name);
 		}
+		cosmic_manager_schedule_done_event(workspace->group->manager);
 	}
-	cosmic_manager_schedule_done_event(workspace->group->manager);
 }
 
 void
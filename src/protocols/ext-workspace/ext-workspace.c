@@ -8,6 +8,7 @@
 #include "ext-workspace-v1-protocol.h"
 #include "protocols/ext-workspace.h"
 #include "protocols/ext-workspace-internal.h"
+#include "protocols/rate-limit.h"
 #include "protocols/transaction-addon.h"
 
 /*
@@ -39,6 +40,8 @@ struct ws_create_workspace_event {
 	} on;
 };
 
+static void manager_schedule_idle(struct lab_ext_workspace_manager *manager);
+
 /* Workspace */
 static void
 workspace_handle_destroy(struct wl_client *client, struct wl_resource *resource)
@@ -55,8 +58,8 @@ workspace_handle_activate(struct wl_client *client, struct wl_resource *resource
 		return;
 	}
 	struct lab_ext_workspace *workspace = addon->data;
-	lab_transaction_op_add(addon->ctx, WS_PENDING_WS_ACTIVATE,
-		workspace, /*data*/ NULL);
+	lab_transaction_op_add_unique(addon->ctx, WS_PENDING_WS_ACTIVATE,
+		workspace, /*data*/ NULL, WS_PENDING_WS_STATE);
 }
 
 static void
@@ -68,8 +71,8 @@ workspace_handle_deactivate(struct wl_client *client, struct wl_resource *resour
 		return;
 	}
 	struct lab_ext_workspace *workspace = addon->data;
-	lab_transaction_op_add(addon->ctx, WS_PENDING_WS_DEACTIVATE,
-		workspace, /*data*/ NULL);
+	lab_transaction_op_add_unique(addon->ctx, WS_PENDING_WS_DEACTIVATE,
+		workspace, /*data*/ NULL, WS_PENDING_WS_STATE);
 }
 
 static void
@@ -89,7 +92,8 @@ workspace_handle_assign(struct wl_client *client, struct wl_resource *resource,
 		return;
 	}
 	struct lab_ext_workspace_group *new_grp = grp_addon->data;
-	lab_transaction_op_add(addon->ctx, WS_PENDING_WS_ASSIGN, workspace, new_grp);
+	lab_transaction_op_add_unique(addon->ctx, WS_PENDING_WS_ASSIGN,
+		workspace, new_grp, WS_PENDING_WS_ASSIGN);
 }
 
 static void
@@ -191,7 +195,7 @@ workspace_set_state(struct lab_ext_workspace *workspace,
 	} else {
 		workspace->state_pending &= ~state;
 	}
-	ext_manager_schedule_done_event(workspace->manager);
+	manager_schedule_idle(workspace->manager);
 }
 
 /* Group */
@@ -290,9 +294,17 @@ manager_handle_commit(struct wl_client *client, struct wl_resource *resource)
 		return;
 	}
 
+	struct lab_transaction_op *trans_op, *trans_op_tmp;
+	if (!lab_rate_limit_allow(client, LAB_RATE_LIMIT_WORKSPACE_COMMIT)) {
+		/* Drop the whole transaction */
+		lab_transaction_for_each_safe(trans_op, trans_op_tmp, addon->ctx) {
+			lab_transaction_op_destroy(trans_op);
+		}
+		return;
+	}
+
 	struct lab_ext_workspace *workspace;
 	struct lab_ext_workspace_group *group;
-	struct lab_transaction_op *trans_op, *trans_op_tmp;
 	lab_transaction_for_each_safe(trans_op, trans_op_tmp, addon->ctx) {
 		switch (trans_op->change) {
 		case WS_PENDING_WS_CREATE:
@@ -437,6 +449,10 @@ static void
 manager_idle_send_done(void *data)
 {
 	struct lab_ext_workspace_manager *manager = data;
+	manager->idle_source = NULL;
+
+	bool changed = manager->serial != manager->done_serial;
+	manager->done_serial = manager->serial;
 
 	struct lab_ext_workspace *workspace;
 	wl_list_for_each(workspace, &manager->workspaces, link) {
@@ -446,16 +462,19 @@ manager_idle_send_done(void *data)
 		}
 	}
 
+	/* State changes may have cancelled each other out */
+	if (!changed) {
+		return;
+	}
+
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &manager->resources) {
 		ext_workspace_manager_v1_send_done(resource);
 	}
-	manager->idle_source = NULL;
 }
 
-/* Internal API */
-void
-ext_manager_schedule_done_event(struct lab_ext_workspace_manager *manager)
+static void
+manager_schedule_idle(struct lab_ext_workspace_manager *manager)
 {
 	if (manager->idle_source) {
 		return;
@@ -467,6 +486,14 @@ ext_manager_schedule_done_event(struct lab_ext_workspace_manager *manager)
 		manager->event_loop, manager_idle_send_done, manager);
 }
 
+/* Internal API */
+void
+ext_manager_schedule_done_event(struct lab_ext_workspace_manager *manager)
+{
+	manager->serial++;
+	manager_schedule_idle(manager);
+}
+
 static void
 send_group_workspace_event(struct lab_ext_workspace_group *group,
 		struct lab_ext_workspace *workspace,
@@ -677,8 +704,8 @@ lab_ext_workspace_set_name(struct lab_ext_workspace *workspace, const char *name
 		wl_resource_for_each(resource, &workspace->resources) {
 			ext_workspace_handle_v1_send_name(resource, workspace->name);
 		}
+		ext_manager_schedule_done_event(workspace->manager);
 	}
-	ext_manager_schedule_done_event(workspace->manager);
 }
 
 void
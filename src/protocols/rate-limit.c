@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+#include "common/mem.h"
+#include "common/token-bucket.h"
+#include "protocols/rate-limit.h"
+
+/*
+ * Budgets are generous enough for interactive use, like a settings GUI
+ * testing configurations while a slider is dragged or a pager scrolled
+ * through workspaces, and only hit by clients looping on a request.
+ */
+static const struct {
+	const char *name;
+	uint32_t rate;  /* per second */
+	uint32_t burst;
+} limits[LAB_RATE_LIMIT_COUNT] = {
+	[LAB_RATE_LIMIT_WORKSPACE_COMMIT] = { "workspace commit", 30, 60 },
+	[LAB_RATE_LIMIT_OUTPUT_TEST] = { "output configuration test", 20, 40 },
+	[LAB_RATE_LIMIT_OUTPUT_APPLY] = { "output configuration apply", 2, 5 },
+};
+
+struct client_rate_limit {
+	struct lab_token_bucket buckets[LAB_RATE_LIMIT_COUNT];
+	uint32_t rejected[LAB_RATE_LIMIT_COUNT];
+	struct wl_listener client_destroy;
+};
+
+static uint64_t
+now_msec(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void
+handle_client_destroy(struct wl_listener *listener, void *data)
+{
+	struct client_rate_limit *rate_limit =
+		wl_container_of(listener, rate_limit, client_destroy);
+	for (size_t i = 0; i < LAB_RATE_LIMIT_COUNT; i++) {
+		if (rate_limit->rejected[i]) {
+			wlr_log(WLR_DEBUG, "client rejected %u times for %s",
+				rate_limit->rejected[i], limits[i].name);
+		}
+	}
+	wl_list_remove(&rate_limit->client_destroy.link);
+	free(rate_limit);
+}
+
+static struct client_rate_limit *
+get_rate_limit(struct wl_client *client)
+{
+	/* The destroy listener doubles as per-client storage */
+	struct wl_listener *listener =
+		wl_client_get_destroy_listener(client, handle_client_destroy);
+	if (listener) {
+		struct client_rate_limit *rate_limit =
+			wl_container_of(listener, rate_limit, client_destroy);
+		return rate_limit;
+	}
+
+	struct client_rate_limit *rate_limit = znew(*rate_limit);
+	uint64_t now = now_msec();
+	for (size_t i = 0; i < LAB_RATE_LIMIT_COUNT; i++) {
+		lab_token_bucket_init(&rate_limit->buckets[i],
+			limits[i].rate, limits[i].burst, now);
+	}
+	rate_limit->client_destroy.notify = handle_client_destroy;
+	wl_client_add_destroy_listener(client, &rate_limit->client_destroy);
+	return rate_limit;
+}
+
+bool
+lab_rate_limit_allow(struct wl_client *client, enum lab_rate_limit limit)
+{
+	assert(limit < LAB_RATE_LIMIT_COUNT);
+	if (!client) {
+		return true;
+	}
+
+	struct client_rate_limit *rate_limit = get_rate_limit(client);
+	if (lab_token_bucket_take(&rate_limit->buckets[limit], now_msec())) {
+		return true;
+	}
+
+	uint32_t rejected = ++rate_limit->rejected[limit];
+	/* Log the 1st, 2nd, 4th, 8th... rejection only */
+	if (!(rejected & (rejected - 1))) {
+		pid_t pid;
+		wl_client_get_credentials(client, &pid, NULL, NULL);
+		wlr_log(WLR_DEBUG, "rate limit of %s exceeded by pid %d "
+			"(%u requests rejected)", limits[limit].name,
+			(int)pid, rejected);
+	}
+	return false;
+}
@@ -5,21 +5,38 @@
 #include "common/mem.h"
 #include "protocols/transaction-addon.h"
 
+/*
+ * Clients like pagers may queue many ops per commit, so destroyed ops are
+ * kept in the session context and re-used instead of being freed one by one
+ */
+#define TRANSACTION_OP_POOL_MAX 64
+
 void
 lab_transaction_op_destroy(struct lab_transaction_op *trans_op)
 {
 	wl_signal_emit_mutable(&trans_op->events.destroy, trans_op);
 	wl_list_remove(&trans_op->link);
-	free(trans_op);
+
+	struct lab_transaction_session_context *ctx = trans_op->ctx;
+	if (ctx->nr_free_ops < TRANSACTION_OP_POOL_MAX) {
+		wl_list_insert(&ctx->free_ops, &trans_op->link);
+		ctx->nr_free_ops++;
+	} else {
+		free(trans_op);
+	}
 }
 
 static void
-transaction_destroy(struct wl_list *list)
+transaction_destroy(struct lab_transaction_session_context *ctx)
 {
 	struct lab_transaction_op *trans_op, *trans_op_tmp;
-	wl_list_for_each_safe(trans_op, trans_op_tmp, list, link) {
+	wl_list_for_each_safe(trans_op, trans_op_tmp, &ctx->transaction_ops, link) {
 		lab_transaction_op_destroy(trans_op);
 	}
+	/* Free the pool in one go */
+	wl_list_for_each_safe(trans_op, trans_op_tmp, &ctx->free_ops, link) {
+		free(trans_op);
+	}
 }
 
 void
@@ -32,7 +49,7 @@ lab_resource_addon_destroy(struct lab_wl_resource_addon *addon)
 	assert(addon->ctx->ref_count >= 0);
 
 	if (!addon->ctx->ref_count) {
-		transaction_destroy(&addon->ctx->transaction_ops);
+		transaction_destroy(addon->ctx);
 		free(addon->ctx);
 	}
 
@@ -46,6 +63,7 @@ lab_resource_addon_create(struct lab_transaction_session_context *ctx)
 	if (!ctx) {
 		ctx = znew(*ctx);
 		wl_list_init(&ctx->transaction_ops);
+		wl_list_init(&ctx->free_ops);
 	}
 	addon->ctx = ctx;
 	addon->ctx->ref_count++;
@@ -58,7 +76,15 @@ lab_transaction_op_add(struct lab_transaction_session_context *ctx,
 {
 	assert(ctx);
 
-	struct lab_transaction_op *trans_op = znew(*trans_op);
+	struct lab_transaction_op *trans_op;
+	if (!wl_list_empty(&ctx->free_ops)) {
+		trans_op = wl_container_of(ctx->free_ops.next, trans_op, link);
+		wl_list_remove(&trans_op->link);
+		ctx->nr_free_ops--;
+	} else {
+		trans_op = znew(*trans_op);
+	}
+	trans_op->ctx = ctx;
 	trans_op->change = pending_change;
 	trans_op->src = src;
 	trans_op->data = data;
@@ -68,3 +94,18 @@ lab_transaction_op_add(struct lab_transaction_session_context *ctx,
 
 	return trans_op;
 }
+
+struct lab_transaction_op *
+lab_transaction_op_add_unique(struct lab_transaction_session_context *ctx,
+		uint32_t pending_change, void *src, void *data, uint32_t supersedes)
+{
+	assert(ctx);
+
+	struct lab_transaction_op *trans_op, *trans_op_tmp;
+	lab_transaction_for_each_safe(trans_op, trans_op_tmp, ctx) {
+		if (trans_op->src == src && (trans_op->change & supersedes)) {
+			lab_transaction_op_destroy(trans_op);
+		}
+	}
+	return lab_transaction_op_add(ctx, pending_change, src, data);
+}
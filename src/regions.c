@@ -4,17 +4,159 @@
 #include <assert.h>
 #include <float.h>
 #include <math.h>
+#include <stdint.h>
 #include <string.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
 #include "common/list.h"
+#include "common/macros.h"
 #include "common/mem.h"
 #include "input/keyboard.h"
 #include "labwc.h"
 #include "regions.h"
 #include "view.h"
 
+/* Upper limit of grid cells along each axis */
+#define REGION_GRID_MAX 64
+
+/*
+ * Uniform grid over the bounding box of the regions of one output. Each
+ * cell lists the regions overlapping it, in the order of output->regions,
+ * so that a lookup only looks at the few regions near the cursor.
+ */
+struct region_grid {
+	struct wlr_box bounds;
+	int cols, rows;
+	/* Cell i is covered by entries[offsets[i]] to entries[offsets[i + 1]] */
+	int *offsets;
+	struct region **entries;
+};
+
+static int
+grid_cell(int start, int size, int nr, double pos)
+{
+	int cell = (int)floor((pos - start) * nr / size);
+	return MIN(MAX(cell, 0), nr - 1);
+}
+
+/* Last cell touched by the half-open interval ending at @end */
+static int
+grid_cell_end(int start, int size, int nr, int end)
+{
+	int64_t scaled = (int64_t)(end - start) * nr;
+	int cell = (int)((scaled + size - 1) / size) - 1;
+	return MIN(MAX(cell, 0), nr - 1);
+}
+
+/* Range of cells overlapped by @box, returns false if there are none */
+static bool
+grid_cells_of_box(struct region_grid *grid, struct wlr_box *box,
+		int *c0, int *c1, int *r0, int *r1)
+{
+	struct wlr_box *bounds = &grid->bounds;
+	if (wlr_box_empty(box)) {
+		return false;
+	}
+	*c0 = grid_cell(bounds->x, bounds->width, grid->cols, box->x);
+	*c1 = grid_cell_end(bounds->x, bounds->width, grid->cols,
+		box->x + box->width);
+	*r0 = grid_cell(bounds->y, bounds->height, grid->rows, box->y);
+	*r1 = grid_cell_end(bounds->y, bounds->height, grid->rows,
+		box->y + box->height);
+	return true;
+}
+
+static void
+grid_destroy(struct output *output)
+{
+	struct region_grid *grid = output->region_grid;
+	if (!grid) {
+		return;
+	}
+	free(grid->offsets);
+	free(grid->entries);
+	zfree(output->region_grid);
+}
+
+static void
+grid_build(struct output *output)
+{
+	grid_destroy(output);
+
+	int nr_regions = 0;
+	struct wlr_box bounds = {0};
+	struct region *region;
+	wl_list_for_each(region, &output->regions, link) {
+		if (wlr_box_empty(&region->geo)) {
+			continue;
+		}
+		if (!nr_regions) {
+			bounds = region->geo;
+		} else {
+			int x2 = MAX(bounds.x + bounds.width,
+				region->geo.x + region->geo.width);
+			int y2 = MAX(bounds.y + bounds.height,
+				region->geo.y + region->geo.height);
+			bounds.x = MIN(bounds.x, region->geo.x);
+			bounds.y = MIN(bounds.y, region->geo.y);
+			bounds.width = x2 - bounds.x;
+			bounds.height = y2 - bounds.y;
+		}
+		nr_regions++;
+	}
+	if (!nr_regions) {
+		return;
+	}
+
+	/* Roughly one region per cell for regions laid out as a grid */
+	int dim = 1;
+	while (dim * dim < nr_regions && dim < REGION_GRID_MAX) {
+		dim++;
+	}
+
+	struct region_grid *grid = znew(*grid);
+	grid->bounds = bounds;
+	grid->cols = MIN(dim, bounds.width);
+	grid->rows = MIN(dim, bounds.height);
+	int nr_cells = grid->cols * grid->rows;
+	grid->offsets = znew_n(*grid->offsets, nr_cells + 1);
+
+	/* Count the regions per cell, offsets[i + 1] is the count of cell i */
+	int c0, c1, r0, r1;
+	wl_list_for_each(region, &output->regions, link) {
+		if (!grid_cells_of_box(grid, &region->geo, &c0, &c1, &r0, &r1)) {
+			continue;
+		}
+		for (int r = r0; r <= r1; r++) {
+			for (int c = c0; c <= c1; c++) {
+				grid->offsets[r * grid->cols + c + 1]++;
+			}
+		}
+	}
+	for (int i = 0; i < nr_cells; i++) {
+		grid->offsets[i + 1] += grid->offsets[i];
+	}
+
+	/* Fill in the regions, using a copy of the offsets as insert position */
+	grid->entries = znew_n(*grid->entries, grid->offsets[nr_cells]);
+	int *pos = znew_n(*pos, nr_cells);
+	memcpy(pos, grid->offsets, nr_cells * sizeof(*pos));
+	wl_list_for_each(region, &output->regions, link) {
+		if (!grid_cells_of_box(grid, &region->geo, &c0, &c1, &r0, &r1)) {
+			continue;
+		}
+		for (int r = r0; r <= r1; r++) {
+			for (int c = c0; c <= c1; c++) {
+				grid->entries[pos[r * grid->cols + c]++] = region;
+			}
+		}
+	}
+	free(pos);
+
+	output->region_grid = grid;
+}
+
 bool
 regions_should_snap(struct server *server)
 {
@@ -56,11 +198,19 @@ regions_from_cursor(struct server *server)
 		return NULL;
 	}
 
+	struct region_grid *grid = output->region_grid;
+	if (!grid || !wlr_box_contains_point(&grid->bounds, lx, ly)) {
+		return NULL;
+	}
+	int col = grid_cell(grid->bounds.x, grid->bounds.width, grid->cols, lx);
+	int row = grid_cell(grid->bounds.y, grid->bounds.height, grid->rows, ly);
+	int cell = row * grid->cols + col;
+
 	double dist;
 	double dist_min = DBL_MAX;
 	struct region *closest_region = NULL;
-	struct region *region;
-	wl_list_for_each(region, &output->regions, link) {
+	for (int i = grid->offsets[cell]; i < grid->offsets[cell + 1]; i++) {
+		struct region *region = grid->entries[i];
 		if (wlr_box_contains_point(&region->geo, lx, ly)) {
 			/* No need for sqrt((x1 - x2)^2 + (y1 - y2)^2) as we just compare */
 			dist = pow(region->center.x - lx, 2) + pow(region->center.y - ly, 2);
@@ -142,6 +292,15 @@ regions_update_geometry(struct output *output)
 		region->center.x = geo->x + geo->width / 2;
 		region->center.y = geo->y + geo->height / 2;
 	}
+
+	grid_build(output);
+}
+
+void
+regions_finish_output(struct output *output)
+{
+	assert(output);
+	grid_destroy(output);
 }
 
 void
@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * render-pool.c: worker threads rendering buffers
+ *
+ * A long window title or a large svg rendered at a high scale can take
+ * milliseconds, which the main thread would otherwise spend not handling
+ * input. Jobs are queued to a small number of workers; an eventfd wakes
+ * up the main thread when they are done.
+ *
+ * Like the icon loader, jobs are only linked into the queue or the done
+ * list while holding the lock, and the worker only calls the render
+ * function on data the submitter does not touch until done is called.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+#include "common/macros.h"
+#include "common/mem.h"
+#include "labwc.h"
+#include "render-pool.h"
+
+#define RENDER_POOL_THREADS 2
+
+struct render_job {
+	render_func_t render;
+	render_func_t done;
+	void *data;
+	struct wl_list link; /* pool.queue or pool.done */
+};
+
+static struct {
+	pthread_t threads[RENDER_POOL_THREADS];
+	size_t nr_threads;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/* Protected by lock */
+	struct wl_list queue;
+	struct wl_list done;
+	bool quit;
+
+	int event_fd;
+	struct wl_event_source *source;
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.event_fd = -1,
+};
+
+static void *
+worker_main(void *data)
+{
+	pthread_mutex_lock(&pool.lock);
+	for (;;) {
+		while (!pool.quit && wl_list_empty(&pool.queue)) {
+			pthread_cond_wait(&pool.cond, &pool.lock);
+		}
+		if (pool.quit) {
+			break;
+		}
+		struct render_job *job =
+			wl_container_of(pool.queue.next, job, link);
+		wl_list_remove(&job->link);
+		pthread_mutex_unlock(&pool.lock);
+
+		job->render(job->data);
+
+		pthread_mutex_lock(&pool.lock);
+		wl_list_insert(pool.done.prev, &job->link);
+		uint64_t one = 1;
+		if (write(pool.event_fd, &one, sizeof(one)) < 0) {
+			/* The counter is already non-zero, never mind */
+		}
+	}
+	pthread_mutex_unlock(&pool.lock);
+	return NULL;
+}
+
+/* Calls done for the jobs of @list, which the workers don't touch anymore */
+static void
+finish_jobs(struct wl_list *list)
+{
+	while (!wl_list_empty(list)) {
+		struct render_job *job = wl_container_of(list->next, job, link);
+		wl_list_remove(&job->link);
+		job->done(job->data);
+		free(job);
+	}
+}
+
+static int
+handle_done(int fd, uint32_t mask, void *data)
+{
+	uint64_t count;
+	if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+		wlr_log_errno(WLR_ERROR, "render pool");
+	}
+
+	struct wl_list done;
+	pthread_mutex_lock(&pool.lock);
+	wl_list_init(&done);
+	wl_list_insert_list(&done, &pool.done);
+	wl_list_init(&pool.done);
+	pthread_mutex_unlock(&pool.lock);
+
+	/* done may submit new jobs */
+	finish_jobs(&done);
+	return 0;
+}
+
+void
+render_pool_init(struct server *server)
+{
+	wl_list_init(&pool.queue);
+	wl_list_init(&pool.done);
+	pool.quit = false;
+
+	pool.event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (pool.event_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot create render pool eventfd");
+		return;
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(pool.threads); i++) {
+		if (pthread_create(&pool.threads[i], NULL, worker_main, NULL)) {
+			wlr_log(WLR_ERROR, "cannot start render thread");
+			break;
+		}
+		pool.nr_threads++;
+	}
+	if (!pool.nr_threads) {
+		close(pool.event_fd);
+		pool.event_fd = -1;
+		return;
+	}
+	pool.source = wl_event_loop_add_fd(server->wl_event_loop,
+		pool.event_fd, WL_EVENT_READABLE, handle_done, NULL);
+}
+
+bool
+render_pool_submit(render_func_t render, render_func_t done, void *data)
+{
+	if (!pool.nr_threads) {
+		return false;
+	}
+	struct render_job *job = znew(*job);
+	job->render = render;
+	job->done = done;
+	job->data = data;
+
+	pthread_mutex_lock(&pool.lock);
+	wl_list_insert(pool.queue.prev, &job->link);
+	pthread_cond_signal(&pool.cond);
+	pthread_mutex_unlock(&pool.lock);
+	return true;
+}
+
+void
+render_pool_finish(void)
+{
+	if (!pool.nr_threads) {
+		return;
+	}
+	pthread_mutex_lock(&pool.lock);
+	pool.quit = true;
+	pthread_cond_broadcast(&pool.cond);
+	pthread_mutex_unlock(&pool.lock);
+	for (size_t i = 0; i < pool.nr_threads; i++) {
+		pthread_join(pool.threads[i], NULL);
+	}
+	pool.nr_threads = 0;
+
+	finish_jobs(&pool.done);
+	finish_jobs(&pool.queue);
+	wl_event_source_remove(pool.source);
+	pool.source = NULL;
+	close(pool.event_fd);
+	pool.event_fd = -1;
+}
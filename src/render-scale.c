@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * render-scale.c: downscaled rendering of chosen clients
+ *
+ * The scene sends every surface the scale of the outputs it is shown on
+ * whenever that set changes. For views with a renderScale window rule,
+ * a listener registered after the one of the scene sends the reduced
+ * scale instead, so the client renders fewer pixels and the scene scales
+ * its buffer up to the surface size.
+ *
+ * Only the main surface of xdg-shell views is handled. Xwayland has one
+ * scale for all of its clients.
+ */
+#include <math.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_fractional_scale_v1.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_scene.h>
+#include "common/macros.h"
+#include "labwc.h"
+#include "render-scale.h"
+#include "view.h"
+#include "window-rules.h"
+
+static double
+view_render_scale(struct view *view)
+{
+	float output_scale = 0;
+	struct output *output;
+	wl_list_for_each(output, &view->server->outputs, link) {
+		if (output_is_usable(output)
+				&& (view->outputs & output_get_mask(output))) {
+			output_scale = MAX(output_scale, output->wlr_output->scale);
+		}
+	}
+	if (!output_scale) {
+		output_scale = output_is_usable(view->output)
+			? view->output->wlr_output->scale : 1;
+	}
+	return output_scale * window_rules_get_value(view,
+		LAB_WINDOW_RULE_VALUE_RENDER_SCALE);
+}
+
+static void
+apply(struct view *view)
+{
+	double scale = view_render_scale(view);
+	wlr_fractional_scale_v1_notify_scale(view->surface, scale);
+	wlr_surface_set_preferred_buffer_scale(view->surface,
+		MAX(1, (int)ceil(scale)));
+
+	enum wlr_scale_filter_mode filter = window_rules_get_value(view,
+		LAB_WINDOW_RULE_VALUE_RENDER_FILTER) == LAB_RENDER_FILTER_NEAREST
+		? WLR_SCALE_FILTER_NEAREST : WLR_SCALE_FILTER_BILINEAR;
+	wlr_scene_buffer_set_filter_mode(view->render_scale.buffer, filter);
+}
+
+static void
+handle_outputs_update(struct wl_listener *listener, void *data)
+{
+	struct view *view = wl_container_of(listener, view,
+		render_scale.outputs_update);
+	apply(view);
+}
+
+static void
+disconnect(struct view *view)
+{
+	wl_list_remove(&view->render_scale.outputs_update.link);
+	wl_list_remove(&view->render_scale.destroy.link);
+	view->render_scale.buffer = NULL;
+}
+
+/* The surface is going away as well, there is nothing to restore */
+static void
+handle_buffer_destroy(struct wl_listener *listener, void *data)
+{
+	struct view *view = wl_container_of(listener, view,
+		render_scale.destroy);
+	disconnect(view);
+}
+
+static void
+find_surface_buffer(struct wlr_scene_buffer *buffer, int sx, int sy,
+		void *data)
+{
+	struct view *view = data;
+	struct wlr_scene_surface *scene_surface =
+		wlr_scene_surface_try_from_buffer(buffer);
+	if (scene_surface && scene_surface->surface == view->surface) {
+		view->render_scale.buffer = buffer;
+	}
+}
+
+void
+render_scale_update(struct view *view)
+{
+	if (view->type != LAB_XDG_SHELL_VIEW || !view->surface
+			|| !window_rules_get_value(view,
+				LAB_WINDOW_RULE_VALUE_RENDER_SCALE)) {
+		render_scale_finish(view);
+		return;
+	}
+
+	if (!view->render_scale.buffer) {
+		wlr_scene_node_for_each_buffer(&view->content_tree->node,
+			find_surface_buffer, view);
+		struct wlr_scene_buffer *buffer = view->render_scale.buffer;
+		if (!buffer) {
+			return;
+		}
+		view->render_scale.outputs_update.notify = handle_outputs_update;
+		wl_signal_add(&buffer->events.outputs_update,
+			&view->render_scale.outputs_update);
+		view->render_scale.destroy.notify = handle_buffer_destroy;
+		wl_signal_add(&buffer->node.events.destroy,
+			&view->render_scale.destroy);
+	}
+	apply(view);
+}
+
+void
+render_scale_finish(struct view *view)
+{
+	if (!view->render_scale.buffer) {
+		return;
+	}
+	wlr_scene_buffer_set_filter_mode(view->render_scale.buffer,
+		WLR_SCALE_FILTER_BILINEAR);
+	disconnect(view);
+
+	/* Back to what the scene would have sent */
+	if (view->surface) {
+		float scale = output_is_usable(view->output)
+			? view->output->wlr_output->scale : 1;
+		wlr_fractional_scale_v1_notify_scale(view->surface, scale);
+		wlr_surface_set_preferred_buffer_scale(view->surface,
+			(int)ceil(scale));
+	}
+}
+
+void
+render_scale_reconfigure(struct server *server)
+{
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		if (view->mapped && !view->init_deferred) {
+			render_scale_update(view);
+		}
+	}
+}
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * sandbox.c: security contexts of clients, looked up once
+ *
+ * wlr_security_context_manager_v1_lookup_client() walks all security
+ * contexts, and it is called for every global advertised to a client and
+ * whenever a window rule matches on the sandbox. The result is copied into
+ * an entry hanging off the client's destroy listener instead, so all but
+ * the first lookup only walk the few destroy listeners of the client.
+ */
+
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_security_context_v1.h>
+#include "common/mem.h"
+#include "labwc.h"
+#include "sandbox.h"
+
+struct client_sandbox {
+	struct sandbox_info info;
+	struct wl_listener destroy;
+};
+
+static void
+handle_client_destroy(struct wl_listener *listener, void *data)
+{
+	struct client_sandbox *entry = wl_container_of(listener, entry, destroy);
+	wl_list_remove(&entry->destroy.link);
+	free(entry->info.engine);
+	free(entry->info.app_id);
+	free(entry->info.instance_id);
+	free(entry);
+}
+
+static char *
+copy_string(const char *string)
+{
+	return string ? xstrdup(string) : NULL;
+}
+
+const struct sandbox_info *
+sandbox_info_from_client(struct server *server, struct wl_client *client)
+{
+	struct client_sandbox *entry;
+	struct wl_listener *listener =
+		wl_client_get_destroy_listener(client, handle_client_destroy);
+	if (listener) {
+		entry = wl_container_of(listener, entry, destroy);
+		return &entry->info;
+	}
+
+	entry = znew(*entry);
+	const struct wlr_security_context_v1_state *state =
+		wlr_security_context_manager_v1_lookup_client(
+			server->security_context_manager_v1, client);
+	if (state) {
+		entry->info.sandboxed = true;
+		entry->info.engine = copy_string(state->sandbox_engine);
+		entry->info.app_id = copy_string(state->app_id);
+		entry->info.instance_id = copy_string(state->instance_id);
+	}
+	entry->destroy.notify = handle_client_destroy;
+	wl_client_add_destroy_listener(client, &entry->destroy);
+	return &entry->info;
+}
@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * scanout.c: direct scanout diagnostics
+ *
+ * wlroots does not tell why a frame could not be scanned out directly,
+ * so the most likely reason is derived from the scene and the output
+ * state after each rendered frame.
+ */
+
+#include <wlr/render/drm_format_set.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/log.h>
+#include "labwc.h"
+#include "magnifier.h"
+#include "scanout.h"
+
+static const char *status_names[LAB_SCANOUT_STATUS_COUNT] = {
+	[LAB_SCANOUT_HIT] = "hit",
+	[LAB_SCANOUT_DISABLED] = "disabled",
+	[LAB_SCANOUT_MAGNIFIER] = "magnifier active",
+	[LAB_SCANOUT_GAMMA] = "gamma pending",
+	[LAB_SCANOUT_SOFTWARE_CURSOR] = "software cursor",
+	[LAB_SCANOUT_NO_CANDIDATE] = "no client buffer",
+	[LAB_SCANOUT_OVERLAP] = "overlapping node",
+	[LAB_SCANOUT_TRANSFORM] = "transform",
+	[LAB_SCANOUT_FORMAT] = "format",
+	[LAB_SCANOUT_REJECTED] = "rejected",
+};
+
+struct visible_buffers {
+	int count;
+	struct wlr_scene_buffer *buffer;
+};
+
+static void
+count_visible_buffer(struct wlr_scene_buffer *buffer, int sx, int sy,
+		void *data)
+{
+	struct visible_buffers *visible = data;
+	if (!pixman_region32_not_empty(&buffer->node.visible)) {
+		return;
+	}
+	visible->count++;
+	visible->buffer = buffer;
+}
+
+/* Returns true if a cursor is shown on @wlr_output, hardware or not */
+static bool
+cursor_is_shown(struct wlr_output *wlr_output)
+{
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &wlr_output->cursors, link) {
+		if (cursor->enabled && cursor->visible) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool
+has_software_cursor(struct wlr_output *wlr_output)
+{
+	if (wlr_output->software_cursor_locks > 0) {
+		return cursor_is_shown(wlr_output);
+	}
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &wlr_output->cursors, link) {
+		if (cursor->enabled && cursor->visible
+				&& cursor != wlr_output->hardware_cursor) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * A cursor without a cursor plane is rendered into every frame, which
+ * rules out direct scanout on its own. Count both kinds and log when an
+ * output falls back to the software cursor.
+ */
+static void
+account_cursor(struct output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	if (!cursor_is_shown(wlr_output)) {
+		return;
+	}
+	bool software = has_software_cursor(wlr_output);
+	if (software) {
+		output->metrics.cursor_software_frames++;
+	} else {
+		output->metrics.cursor_hardware_frames++;
+	}
+	if (software != output->scanout.software_cursor) {
+		wlr_log(WLR_DEBUG, "%s: %s cursor", wlr_output->name,
+			software ? "software" : "hardware");
+		if (software) {
+			output->metrics.cursor_fallbacks++;
+		}
+		output->scanout.software_cursor = software;
+	}
+}
+
+static enum scanout_status
+get_miss_reason(struct output *output, struct wlr_output_state *state)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	if (!output->server->direct_scanout_enabled) {
+		return LAB_SCANOUT_DISABLED;
+	}
+	if (magnifier_is_enabled()) {
+		return LAB_SCANOUT_MAGNIFIER;
+	}
+	if (state->committed & WLR_OUTPUT_STATE_GAMMA_LUT) {
+		return LAB_SCANOUT_GAMMA;
+	}
+	if (output->scanout.software_cursor) {
+		return LAB_SCANOUT_SOFTWARE_CURSOR;
+	}
+
+	struct visible_buffers visible = {0};
+	wlr_scene_output_for_each_buffer(output->scene_output,
+		count_visible_buffer, &visible);
+	if (!visible.count || !visible.buffer->buffer) {
+		return LAB_SCANOUT_NO_CANDIDATE;
+	}
+	if (visible.count > 1) {
+		return LAB_SCANOUT_OVERLAP;
+	}
+
+	struct wlr_scene_buffer *buffer = visible.buffer;
+	if (buffer->transform != wlr_output->transform) {
+		return LAB_SCANOUT_TRANSFORM;
+	}
+
+	struct wlr_dmabuf_attributes attribs;
+	if (!wlr_buffer_get_dmabuf(buffer->buffer, &attribs)) {
+		return LAB_SCANOUT_FORMAT;
+	}
+	const struct wlr_drm_format_set *formats =
+		wlr_output_get_primary_formats(wlr_output, WLR_BUFFER_CAP_DMABUF);
+	if (formats && !wlr_drm_format_set_get(formats, attribs.format)) {
+		return LAB_SCANOUT_FORMAT;
+	}
+
+	return LAB_SCANOUT_REJECTED;
+}
+
+void
+scanout_update(struct output *output, struct wlr_output_state *state)
+{
+	struct scanout_stats *stats = &output->scanout;
+	enum scanout_status status = LAB_SCANOUT_HIT;
+	account_cursor(output);
+	if (!output->scene_output->WLR_PRIVATE.prev_scanout) {
+		status = get_miss_reason(output, state);
+	}
+
+	stats->count[status]++;
+	if (status != stats->last) {
+		wlr_log(WLR_DEBUG, "%s: direct scanout %s%s",
+			output->wlr_output->name,
+			status == LAB_SCANOUT_HIT ? "" : "miss: ",
+			status_names[status]);
+		stats->last = status;
+	}
+}
+
+void
+scanout_log_summary(struct server *server)
+{
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		struct scanout_stats *stats = &output->scanout;
+		wlr_log(WLR_INFO, "direct scanout for %s: last frame %s",
+			output->wlr_output->name, status_names[stats->last]);
+		for (int i = 0; i < LAB_SCANOUT_STATUS_COUNT; i++) {
+			if (stats->count[i]) {
+				wlr_log(WLR_INFO, "  %-16s %u", status_names[i],
+					stats->count[i]);
+			}
+		}
+	}
+}
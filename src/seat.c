@@ -13,6 +13,7 @@
 #include "input/tablet.h"
 #include "input/tablet-pad.h"
 #include "input/input.h"
+#include "input/input-record.h"
 #include "input/keyboard.h"
 #include "input/key-state.h"
 #include "labwc.h"
@@ -65,8 +66,10 @@ device_type_from_wlr_device(struct wlr_input_device *wlr_input_device)
  * those two criteria we fallback on 'default'.
  */
 static struct libinput_category *
-get_category(struct wlr_input_device *device)
+get_category(struct input *input)
 {
+	struct wlr_input_device *device = input->wlr_input_device;
+
 	/* By name */
 	struct libinput_category *category;
 	wl_list_for_each_reverse(category, &rc.libinput_categories, link) {
@@ -78,7 +81,11 @@ get_category(struct wlr_input_device *device)
 	}
 
 	/* By type */
-	enum lab_libinput_device_type type = device_type_from_wlr_device(device);
+	/* The capabilities of a device don't change, ask libinput once */
+	if (input->libinput.type == LAB_LIBINPUT_DEVICE_NONE) {
+		input->libinput.type = device_type_from_wlr_device(device);
+	}
+	enum lab_libinput_device_type type = input->libinput.type;
 	wl_list_for_each_reverse(category, &rc.libinput_categories, link) {
 		if (category->type == type) {
 			return category;
@@ -89,8 +96,9 @@ get_category(struct wlr_input_device *device)
 	return libinput_category_get_default();
 }
 
+/* Applies the profile resolved by configure_libinput() to the device */
 static void
-configure_libinput(struct wlr_input_device *wlr_input_device)
+apply_libinput_profile(struct input *input)
 {
 	/*
 	 * TODO: We do not check any return values for the various
@@ -109,33 +117,14 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 	 *       mask & value == value. All libinput enums are
 	 *       way below UINT32_MAX.
 	 */
-
-	if (!wlr_input_device) {
-		wlr_log(WLR_ERROR, "no wlr_input_device");
-		return;
-	}
-	struct input *input = wlr_input_device->data;
-
-	/* Set scroll factor to 1.0 for Wayland/X11 backends or virtual pointers */
-	if (!wlr_input_device_is_libinput(wlr_input_device)) {
-		input->scroll_factor = 1.0;
-		return;
-	}
-
 	struct libinput_device *libinput_dev =
-		wlr_libinput_get_device_handle(wlr_input_device);
+		wlr_libinput_get_device_handle(input->wlr_input_device);
 	if (!libinput_dev) {
 		wlr_log(WLR_ERROR, "no libinput_dev");
 		return;
 	}
-
-	struct libinput_category *dc = get_category(wlr_input_device);
-
-	/*
-	 * The above logic should have always matched SOME category
-	 * (the default category if none other took precedence)
-	 */
-	assert(dc);
+	struct libinput_category *dc = &input->libinput.profile;
+	wlr_log(WLR_INFO, "configure %s", input->wlr_input_device->name);
 
 	if (libinput_device_config_tap_get_finger_count(libinput_dev) <= 0) {
 		wlr_log(WLR_INFO, "tap unavailable");
@@ -251,22 +240,87 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "calibration matrix configured");
 		libinput_device_config_calibration_set_matrix(libinput_dev, dc->calibration_matrix);
 	}
+}
+
+/*
+ * Number of devices configured per idle callback, so that adding a dock
+ * with lots of devices does not hold up the event loop in one go
+ */
+#define LIBINPUT_CONFIGURE_BATCH 4
+
+static void
+handle_libinput_idle(void *data)
+{
+	struct seat *seat = data;
+	seat->libinput_idle = NULL;
+
+	int nr_configured = 0;
+	struct input *input;
+	wl_list_for_each(input, &seat->inputs, link) {
+		if (!input->libinput.pending) {
+			continue;
+		}
+		if (nr_configured == LIBINPUT_CONFIGURE_BATCH) {
+			/* Continue with the rest after other events */
+			seat->libinput_idle = wl_event_loop_add_idle(
+				seat->server->wl_event_loop,
+				handle_libinput_idle, seat);
+			return;
+		}
+		input->libinput.pending = false;
+		apply_libinput_profile(input);
+		nr_configured++;
+	}
+}
+
+/*
+ * Resolves the libinput category of a device and queues the device for
+ * configuration if the resulting settings differ from the ones it has.
+ * The scroll factor is not a libinput setting and takes effect at once.
+ */
+static void
+configure_libinput(struct seat *seat, struct input *input)
+{
+	struct wlr_input_device *wlr_input_device = input->wlr_input_device;
+
+	/* Set scroll factor to 1.0 for Wayland/X11 backends or virtual pointers */
+	if (!wlr_input_device_is_libinput(wlr_input_device)) {
+		input->scroll_factor = 1.0;
+		return;
+	}
+
+	struct libinput_category *dc = get_category(input);
 
-	wlr_log(WLR_INFO, "scroll factor configured");
+	/*
+	 * The above logic should have always matched SOME category
+	 * (the default category if none other took precedence)
+	 */
+	assert(dc);
 	input->scroll_factor = dc->scroll_factor;
+
+	if (input->libinput.configured
+			&& libinput_category_settings_equal(&input->libinput.profile, dc)) {
+		return;
+	}
+
+	/* The category itself is freed on the next reconfigure */
+	input->libinput.profile = *dc;
+	input->libinput.profile.name = NULL;
+	wl_list_init(&input->libinput.profile.link);
+	input->libinput.configured = true;
+	input->libinput.pending = true;
+
+	if (!seat->libinput_idle) {
+		seat->libinput_idle = wl_event_loop_add_idle(
+			seat->server->wl_event_loop, handle_libinput_idle, seat);
+	}
 }
 
 static struct wlr_output *
 output_by_name(struct server *server, const char *name)
 {
-	assert(name);
-	struct output *output;
-	wl_list_for_each(output, &server->outputs, link) {
-		if (!strcasecmp(output->wlr_output->name, name)) {
-			return output->wlr_output;
-		}
-	}
-	return NULL;
+	struct output *output = output_find_by_name(server, name);
+	return output ? output->wlr_output : NULL;
 }
 
 static void
@@ -294,7 +348,7 @@ new_pointer(struct seat *seat, struct wlr_input_device *dev)
 	struct input *input = znew(*input);
 	input->wlr_input_device = dev;
 	dev->data = input;
-	configure_libinput(dev);
+	configure_libinput(seat, input);
 	wlr_cursor_attach_input_device(seat->cursor, dev);
 
 	/* In support of running with WLR_WL_OUTPUTS set to >=2 */
@@ -358,6 +412,41 @@ map_touch_to_output(struct seat *seat, struct wlr_input_device *dev)
 	char *output_name = touch->output_name ? touch->output_name : touch_config_output_name;
 	wlr_log(WLR_INFO, "map touch to output %s", output_name ? output_name : "unknown");
 	map_input_to_output(seat, dev, output_name);
+
+	struct input *input = dev->data;
+	input->mapping.valid = false;
+}
+
+static void
+map_tablet_to_output(struct seat *seat, struct wlr_input_device *dev)
+{
+	wlr_log(WLR_INFO, "map tablet to output %s", rc.tablet.output_name);
+	map_input_to_output(seat, dev, rc.tablet.output_name);
+
+	struct input *input = dev->data;
+	input->mapping.valid = false;
+}
+
+void
+input_absolute_to_layout_coords(struct seat *seat, struct wlr_input_device *dev,
+		double x, double y, double *lx, double *ly)
+{
+	struct input *input = dev->data;
+	if (!input->mapping.valid) {
+		/* The mapping is linear, so two corners describe it */
+		double x0, y0, x1, y1;
+		wlr_cursor_absolute_to_layout_coords(seat->cursor, dev,
+			0.0, 0.0, &x0, &y0);
+		wlr_cursor_absolute_to_layout_coords(seat->cursor, dev,
+			1.0, 1.0, &x1, &y1);
+		input->mapping.x = x0;
+		input->mapping.y = y0;
+		input->mapping.width = x1 - x0;
+		input->mapping.height = y1 - y0;
+		input->mapping.valid = true;
+	}
+	*lx = input->mapping.x + x * input->mapping.width;
+	*ly = input->mapping.y + y * input->mapping.height;
 }
 
 static struct input *
@@ -366,7 +455,7 @@ new_touch(struct seat *seat, struct wlr_input_device *dev)
 	struct input *input = znew(*input);
 	input->wlr_input_device = dev;
 	dev->data = input;
-	configure_libinput(dev);
+	configure_libinput(seat, input);
 	wlr_cursor_attach_input_device(seat->cursor, dev);
 	/* In support of running with WLR_WL_OUTPUTS set to >=2 */
 	map_touch_to_output(seat, dev);
@@ -379,10 +468,10 @@ new_tablet(struct seat *seat, struct wlr_input_device *dev)
 {
 	struct input *input = znew(*input);
 	input->wlr_input_device = dev;
+	dev->data = input;
 	tablet_create(seat, dev);
 	wlr_cursor_attach_input_device(seat->cursor, dev);
-	wlr_log(WLR_INFO, "map tablet to output %s", rc.tablet.output_name);
-	map_input_to_output(seat, dev, rc.tablet.output_name);
+	map_tablet_to_output(seat, dev);
 
 	return input;
 }
@@ -536,13 +625,14 @@ seat_init(struct server *server)
 	struct seat *seat = &server->seat;
 	seat->server = server;
 
+	timer_wheel_init(&seat->timers, server->wl_event_loop);
+
 	seat->seat = wlr_seat_create(server->wl_display, "seat0");
 	if (!seat->seat) {
 		wlr_log(WLR_ERROR, "cannot allocate seat");
 		exit(EXIT_FAILURE);
 	}
 
-	wl_list_init(&seat->touch_points);
 	wl_list_init(&seat->constraint_commit.link);
 	wl_list_init(&seat->inputs);
 	seat->new_input.notify = new_input_notify;
@@ -590,6 +680,7 @@ seat_finish(struct server *server)
 	wl_list_remove(&seat->focus_change.link);
 	wl_list_remove(&seat->virtual_pointer_new.link);
 	wl_list_remove(&seat->virtual_keyboard_new.link);
+	input_record_finish();
 
 	struct input *input, *next;
 	wl_list_for_each_safe(input, next, &seat->inputs, link) {
@@ -600,10 +691,19 @@ seat_finish(struct server *server)
 		wl_event_source_remove(seat->workspace_osd_timer);
 		seat->workspace_osd_timer = NULL;
 	}
+	if (seat->libinput_idle) {
+		wl_event_source_remove(seat->libinput_idle);
+		seat->libinput_idle = NULL;
+	}
+	if (seat->modifier_broadcast_idle) {
+		wl_event_source_remove(seat->modifier_broadcast_idle);
+		seat->modifier_broadcast_idle = NULL;
+	}
 	overlay_finish(seat);
 
 	input_handlers_finish(seat);
 	input_method_relay_finish(seat->input_method_relay);
+	timer_wheel_finish(&seat->timers);
 }
 
 static void
@@ -646,22 +746,22 @@ seat_reconfigure(struct server *server)
 	struct input *input;
 	cursor_reload(seat);
 	overlay_reconfigure(seat);
-	keyboard_reset_current_keybind();
+	keyboard_reset_current_keybind(seat);
 	wl_list_for_each(input, &seat->inputs, link) {
 		switch (input->wlr_input_device->type) {
 		case WLR_INPUT_DEVICE_KEYBOARD:
 			configure_keyboard(seat, input);
 			break;
 		case WLR_INPUT_DEVICE_POINTER:
-			configure_libinput(input->wlr_input_device);
+			configure_libinput(seat, input);
 			map_pointer_to_output(seat, input->wlr_input_device);
 			break;
 		case WLR_INPUT_DEVICE_TOUCH:
-			configure_libinput(input->wlr_input_device);
+			configure_libinput(seat, input);
 			map_touch_to_output(seat, input->wlr_input_device);
 			break;
 		case WLR_INPUT_DEVICE_TABLET:
-			map_input_to_output(seat, input->wlr_input_device, rc.tablet.output_name);
+			map_tablet_to_output(seat, input->wlr_input_device);
 			break;
 		default:
 			break;
@@ -712,8 +812,10 @@ seat_focus(struct seat *seat, struct wlr_surface *surface,
 	 * those that were actually _sent_ to clients (that is, those that were
 	 * not bound).
 	 */
-	uint32_t *pressed_sent_keycodes = key_state_pressed_sent_keycodes();
-	int nr_pressed_sent_keycodes = key_state_nr_pressed_sent_keycodes();
+	uint32_t *pressed_sent_keycodes =
+		key_state_pressed_sent_keycodes(&seat->key_state);
+	int nr_pressed_sent_keycodes =
+		key_state_nr_pressed_sent_keycodes(&seat->key_state);
 
 	struct wlr_keyboard *kb = &seat->keyboard_group->keyboard;
 	wlr_seat_keyboard_notify_enter(seat->seat, surface,
@@ -811,7 +913,7 @@ seat_output_layout_changed(struct seat *seat)
 			map_touch_to_output(seat, input->wlr_input_device);
 			break;
 		case WLR_INPUT_DEVICE_TABLET:
-			map_input_to_output(seat, input->wlr_input_device, rc.tablet.output_name);
+			map_tablet_to_output(seat, input->wlr_input_device);
 			break;
 		default:
 			break;
@@ -33,19 +33,35 @@
 #endif
 
 #include "drm-lease-v1-protocol.h"
+#include "animation.h"
+#include "buffer.h"
+#include "capture.h"
+#include "client-buffers.h"
+#include "common/array.h"
 #include "common/macros.h"
 #include "common/scaled-scene-buffer.h"
+#include "common/spawn.h"
 #include "config/rcxml.h"
 #include "config/session.h"
+#include "config/watch.h"
 #include "decorations.h"
+#include "hud.h"
+#include "icon-index.h"
+#include "icon-loader.h"
 #include "idle.h"
 #include "input/keyboard.h"
 #include "labwc.h"
 #include "layers.h"
 #include "magnifier.h"
+#include "metrics.h"
 #include "output-state.h"
+#include "output-timing.h"
 #include "output-virtual.h"
+#include "overview.h"
 #include "regions.h"
+#include "render-pool.h"
+#include "sandbox.h"
+#include "render-scale.h"
 #include "theme.h"
 #include "view.h"
 #include "workspaces.h"
@@ -63,21 +79,75 @@ static struct wl_event_source *sigint_source;
 static struct wl_event_source *sigterm_source;
 static struct wl_event_source *sigchld_source;
 
+/* After a themerc or themerc-override alone has been written */
+static void
+reload_theme(struct server *server)
+{
+	if (theme_is_current(server->theme, rc.theme_name)) {
+		wlr_log(WLR_DEBUG, "theme unchanged, not reloading it");
+		return;
+	}
+	scaled_scene_buffer_invalidate_sharing();
+	theme_reload(server->theme, server, rc.theme_name);
+	overlay_reconfigure(&server->seat);
+	hud_reconfigure(server);
+	overview_finish(server);
+	buffer_pool_trim();
+}
+
 static void
 reload_config_and_theme(struct server *server)
 {
 	scaled_scene_buffer_invalidate_sharing();
 	rcxml_finish();
 	rcxml_read(rc.config_file);
-	theme_finish(server->theme);
-	theme_init(server->theme, server, rc.theme_name);
-
+	window_rules_invalidate(NULL);
+	render_scale_reconfigure(server);
+	osd_field_invalidate(NULL);
 
+	/* Keep the theme and its rendered assets if nothing it reads changed */
+	if (theme_is_current(server->theme, rc.theme_name)) {
+		wlr_log(WLR_DEBUG, "theme unchanged, not reloading it");
+	} else {
+		theme_reload(server->theme, server, rc.theme_name);
+	}
 
 	seat_reconfigure(server);
 	regions_reconfigure(server);
 	kde_server_decoration_update_default();
+	kde_server_decoration_update_views();
+	xdg_server_decoration_update_views();
 	workspaces_reconfigure(server);
+	output_timing_reconfigure(server);
+	metrics_reconfigure(server);
+	capture_reconfigure(server);
+	config_watch_reconfigure(server);
+#if HAVE_LIBSFDO
+	/* Picks up a changed <theme><icon> and newly installed icons */
+	icon_index_finish();
+	icon_index_init();
+#endif
+	hud_reconfigure(server);
+	overview_finish(server);
+	output_idle_reconfigure(server);
+
+	/* The old theme buffers have been recycled into the new ones by now */
+	buffer_pool_trim();
+}
+
+void
+server_reload(struct server *server, uint32_t what)
+{
+	if (what & LAB_RELOAD_ENVIRONMENT) {
+		session_environment_init();
+	}
+	if (what & LAB_RELOAD_CONFIG) {
+		keyboard_cancel_all_keybind_repeats(&server->seat);
+		reload_config_and_theme(server);
+		output_virtual_update_fallback(server);
+	} else if (what & LAB_RELOAD_THEME) {
+		reload_theme(server);
+	}
 }
 
 static int
@@ -85,10 +155,7 @@ handle_sighup(int signal, void *data)
 {
 	struct server *server = data;
 
-	keyboard_cancel_all_keybind_repeats(&server->seat);
-	session_environment_init();
-	reload_config_and_theme(server);
-	output_virtual_update_fallback(server);
+	server_reload(server, LAB_RELOAD_ALL);
 	return 0;
 }
 
@@ -126,6 +193,11 @@ handle_sigchld(int signal, void *data)
 	}
 #endif
 
+	/* Reaped by its pidfd watch, see spawn_watch_child() */
+	if (spawn_child_is_watched(info.si_pid)) {
+		return 0;
+	}
+
 	/* And then do the actual (consuming) lookup again */
 	int ret = waitid(P_PID, info.si_pid, &info, WEXITED);
 	if (ret == -1) {
@@ -222,8 +294,7 @@ protocol_is_privileged(const struct wl_interface *iface)
 }
 
 static bool
-allow_for_sandbox(const struct wlr_security_context_v1_state *security_state,
-		const struct wl_interface *iface)
+allow_for_sandbox(const struct wl_interface *iface)
 {
 	if (!strcmp(iface->name, "security_context_manager_v1")) {
 		return false;
@@ -274,6 +345,45 @@ allow_for_sandbox(const struct wlr_security_context_v1_state *security_state,
 	return false;
 }
 
+struct sandbox_verdict {
+	const struct wl_interface *iface;
+	bool allow;
+};
+
+/*
+ * The verdicts only depend on the interface, and each global is filtered
+ * for every registry of every sandboxed client, so they are kept by
+ * interface rather than comparing names against both lists each time.
+ */
+static bool
+sandbox_verdict(const struct wl_interface *iface)
+{
+	static struct wl_array verdicts; /* struct sandbox_verdict */
+	struct sandbox_verdict *verdict;
+	wl_array_for_each(verdict, &verdicts) {
+		if (verdict->iface == iface) {
+			return verdict->allow;
+		}
+	}
+
+	bool allow = allow_for_sandbox(iface);
+	/*
+	 * TODO: The following call is basically useless right now
+	 *       and should be replaced with
+	 *       assert(allow || protocol_is_privileged(iface));
+	 *       This ensures that our lists are in sync with what
+	 *       protocols labwc supports.
+	 */
+	if (!allow && !protocol_is_privileged(iface)) {
+		wlr_log(WLR_ERROR, "Blocking unknown protocol %s", iface->name);
+	}
+	array_add(&verdicts, ((struct sandbox_verdict){
+		.iface = iface,
+		.allow = allow,
+	}));
+	return allow;
+}
+
 static bool
 server_global_filter(const struct wl_client *client, const struct wl_global *global, void *data)
 {
@@ -304,30 +414,20 @@ server_global_filter(const struct wl_client *client, const struct wl_global *glo
 #endif
 
 	/* Do not allow security_context_manager_v1 to clients with a security context attached */
-	const struct wlr_security_context_v1_state *security_context =
-		wlr_security_context_manager_v1_lookup_client(
-			server->security_context_manager_v1, (struct wl_client *)client);
-	if (security_context && global == server->security_context_manager_v1->global) {
+	const struct sandbox_info *sandbox =
+		sandbox_info_from_client(server, (struct wl_client *)client);
+	if (sandbox->sandboxed && global == server->security_context_manager_v1->global) {
 		return false;
-	} else if (security_context) {
+	} else if (sandbox->sandboxed) {
 		/*
 		 * We are using an allow list for sandboxes to not
 		 * accidentally leak a new privileged protocol.
 		 */
-		bool allow = allow_for_sandbox(security_context, iface);
-		/*
-		 * TODO: The following call is basically useless right now
-		 *       and should be replaced with
-		 *       assert(allow || protocol_is_privileged(iface));
-		 *       This ensures that our lists are in sync with what
-		 *       protocols labwc supports.
-		 */
-		if (!allow && !protocol_is_privileged(iface)) {
-			wlr_log(WLR_ERROR, "Blocking unknown protocol %s", iface->name);
-		} else if (!allow) {
+		bool allow = sandbox_verdict(iface);
+		if (!allow) {
 			wlr_log(WLR_DEBUG, "Blocking %s for security context %s->%s->%s",
-				iface->name, security_context->sandbox_engine,
-				security_context->app_id, security_context->instance_id);
+				iface->name, sandbox->engine, sandbox->app_id,
+				sandbox->instance_id);
 		}
 		return allow;
 	}
@@ -434,6 +534,7 @@ server_init(struct server *server)
 	sigchld_source = wl_event_loop_add_signal(
 		event_loop, SIGCHLD, handle_sigchld, server);
 	server->wl_event_loop = event_loop;
+	deferred_queue_init(&server->deferred, event_loop);
 
 	/*
 	 * Prevent wayland clients that request the X11 clipboard but closing
@@ -538,7 +639,11 @@ server_init(struct server *server)
 	}
 
 	wl_list_init(&server->views);
+	wl_list_init(&server->animations);
+	wl_list_init(&server->views_always_on_top);
+	wl_list_init(&server->views_omnipresent);
 	wl_list_init(&server->unmanaged_surfaces);
+	wl_list_init(&server->unmanaged_focus_surfaces);
 
 	server->ssd_hover_state = ssd_hover_state_new();
 
@@ -598,6 +703,7 @@ server_init(struct server *server)
 		exit(EXIT_FAILURE);
 	}
 	wlr_subcompositor_create(server->wl_display);
+	client_buffers_init(server, compositor);
 
 	struct wlr_data_device_manager *device_manager = NULL;
 	device_manager = wlr_data_device_manager_create(server->wl_display);
@@ -623,6 +729,15 @@ server_init(struct server *server)
 	server->text_input_manager = wlr_text_input_manager_v3_create(
 		server->wl_display);
 	seat_init(server);
+	transaction_init(server);
+	metrics_init(server);
+	capture_init(server);
+	config_watch_init(server);
+	render_pool_init(server);
+#if HAVE_LIBSFDO
+	icon_index_init();
+	icon_loader_init(server);
+#endif
 	xdg_shell_init(server);
 	kde_server_decoration_init(server);
 	xdg_server_decoration_init(server);
@@ -746,14 +861,29 @@ server_finish(struct server *server)
 	if (sighup_source) {
 		wl_event_source_remove(sighup_source);
 	}
+	spawn_watch_finish();
 	wl_display_destroy_clients(server->wl_display);
 
+	overview_finish(server);
+	animations_finish_all(server);
+	hud_finish(server);
+	metrics_finish(server);
+	capture_finish(server);
+	client_buffers_finish();
+	config_watch_finish();
+	render_pool_finish();
+#if HAVE_LIBSFDO
+	icon_loader_finish();
+	icon_index_finish();
+#endif
+	transaction_finish(server);
 	seat_finish(server);
 	output_finish(server);
 	xdg_shell_finish(server);
 	layers_finish(server);
 	kde_server_decoration_finish(server);
 	xdg_server_decoration_finish(server);
+	deferred_queue_finish(&server->deferred);
 	wl_list_remove(&server->new_constraint.link);
 	wl_list_remove(&server->output_power_manager_set_mode.link);
 	wl_list_remove(&server->tearing_new_object.link);
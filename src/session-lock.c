@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
+#include "config.h"
 #include <assert.h>
+#include "common/macros.h"
 #include "common/mem.h"
 #include "labwc.h"
 #include "node.h"
@@ -187,11 +189,78 @@ align_session_lock_tree(struct output *output)
 	wlr_scene_node_set_position(&output->session_lock_tree->node, box.x, box.y);
 }
 
+static void
+output_set_content_enabled(struct output *output, bool enabled)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(output->layer_tree); i++) {
+		wlr_scene_node_set_enabled(&output->layer_tree[i]->node, enabled);
+	}
+	wlr_scene_node_set_enabled(&output->layer_popup_tree->node, enabled);
+	wlr_scene_node_set_enabled(&output->osd_tree->node, enabled);
+}
+
+/*
+ * Disable everything but the lock trees while the outputs are blanked. The
+ * scene then neither traverses nor renders hidden content and no longer
+ * sends frame events to hidden clients, so a locked idle session only
+ * repaints for the lock surfaces themselves. It also leaves the lock
+ * surface as the only candidate for direct scan-out.
+ */
+static void
+set_content_hidden(struct session_lock_manager *manager, bool hidden)
+{
+	if (manager->content_hidden == hidden) {
+		return;
+	}
+	manager->content_hidden = hidden;
+
+	struct server *server = manager->server;
+	struct wlr_scene_tree *trees[] = {
+		server->view_tree_always_on_bottom,
+		server->view_tree,
+		server->view_tree_always_on_top,
+		server->xdg_popup_tree,
+#if HAVE_XWAYLAND
+		server->unmanaged_tree,
+#endif
+		server->menu_tree,
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(trees); i++) {
+		wlr_scene_node_set_enabled(&trees[i]->node, !hidden);
+	}
+
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		output_set_content_enabled(output, !hidden);
+	}
+	if (!hidden) {
+		/* Restore top layers hidden by fullscreen views */
+		desktop_update_top_layer_visibility(server);
+	}
+}
+
+/* Hide the normal content once all outputs are blanked */
+static void
+update_content_hidden(struct session_lock_manager *manager)
+{
+	if (!manager->locked) {
+		return;
+	}
+	struct session_lock_output *lock_output;
+	wl_list_for_each(lock_output, &manager->lock_outputs, link) {
+		if (!lock_output->background->node.enabled) {
+			return;
+		}
+	}
+	set_content_hidden(manager, true);
+}
+
 static int
 handle_output_blank_timeout(void *data)
 {
 	struct session_lock_output *lock_output = data;
 	wlr_scene_node_set_enabled(&lock_output->background->node, true);
+	update_content_hidden(lock_output->manager);
 	return 0;
 }
 
@@ -253,6 +322,11 @@ session_lock_output_create(struct session_lock_manager *manager, struct output *
 	lock_output_reconfigure(lock_output);
 
 	wl_list_insert(&manager->lock_outputs, &lock_output->link);
+
+	/* Outputs added while locked are blanked immediately */
+	if (manager->content_hidden) {
+		output_set_content_enabled(output, false);
+	}
 	return;
 
 exit_session:
@@ -283,6 +357,7 @@ handle_lock_unlock(struct wl_listener *listener, void *data)
 		wl_container_of(listener, manager, lock_unlock);
 	session_lock_destroy(manager);
 	manager->locked = false;
+	set_content_hidden(manager, false);
 
 	if (manager->last_active_view) {
 		desktop_focus_view(manager->last_active_view, /* raise */ false);
@@ -351,6 +426,9 @@ handle_new_session_lock(struct wl_listener *listener, void *data)
 	manager->locked = true;
 	manager->lock = lock;
 	wlr_session_lock_v1_send_locked(lock);
+
+	/* Covers replaced locks and setups without outputs */
+	update_content_hidden(manager);
 }
 
 static void
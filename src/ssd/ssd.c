@@ -11,6 +11,7 @@
 #include "common/mem.h"
 #include "common/scene-helpers.h"
 #include "labwc.h"
+#include "node.h"
 #include "ssd-internal.h"
 #include "theme.h"
 #include "view.h"
@@ -76,6 +77,16 @@ get_resizing_type(const struct ssd *ssd, struct wlr_cursor *cursor)
 	return LAB_SSD_NONE;
 }
 
+static struct ssd_part *
+part_from_node(struct wlr_scene_node *node)
+{
+	struct node_descriptor *desc = node->data;
+	if (desc && desc->type == LAB_NODE_DESC_SSD_PART) {
+		return desc->data;
+	}
+	return NULL;
+}
+
 enum ssd_part_type
 ssd_get_part_type(const struct ssd *ssd, struct wlr_scene_node *node,
 		struct wlr_cursor *cursor)
@@ -89,85 +100,49 @@ ssd_get_part_type(const struct ssd *ssd, struct wlr_scene_node *node,
 		return LAB_SSD_NONE;
 	}
 
-	const struct wl_list *part_list = NULL;
-	struct wlr_scene_tree *grandparent =
-		node->parent ? node->parent->node.parent : NULL;
-	struct wlr_scene_tree *greatgrandparent =
-		grandparent ? grandparent->node.parent : NULL;
-
-	/* active titlebar */
-	if (node->parent == ssd->titlebar.active.tree) {
-		part_list = &ssd->titlebar.active.parts;
-	} else if (grandparent == ssd->titlebar.active.tree) {
-		part_list = &ssd->titlebar.active.parts;
-	} else if (greatgrandparent == ssd->titlebar.active.tree) {
-		part_list = &ssd->titlebar.active.parts;
-
-	/* extents */
-	// } else if (node->parent == ssd->extents.tree) {
-	// 	part_list = &ssd->extents.parts;
-
-	/* active border */
-	} else if (node->parent == ssd->border.active.tree) {
-		part_list = &ssd->border.active.parts;
-
-	/* inactive titlebar */
-	} else if (node->parent == ssd->titlebar.inactive.tree) {
-		part_list = &ssd->titlebar.inactive.parts;
-	} else if (grandparent == ssd->titlebar.inactive.tree) {
-		part_list = &ssd->titlebar.inactive.parts;
-	} else if (greatgrandparent == ssd->titlebar.inactive.tree) {
-		part_list = &ssd->titlebar.inactive.parts;
-
-	/* inactive border */
-	} else if (node->parent == ssd->border.inactive.tree) {
-		part_list = &ssd->border.inactive.parts;
+	/*
+	 * Parts carry their type in the node descriptor of their node, or
+	 * of the tree wrapping it when the node is a scaled buffer
+	 */
+	struct ssd_part *part = part_from_node(node);
+	if (!part && node->parent) {
+		part = part_from_node(&node->parent->node);
 	}
-
-	enum ssd_part_type part_type = LAB_SSD_NONE;
-
-	if (part_list) {
-		struct ssd_part *part;
-		wl_list_for_each(part, part_list, link) {
-			if (node == part->node) {
-				part_type = part->type;
-				break;
-			}
-		}
-	}
-
-	if (part_type == LAB_SSD_NONE) {
-		return part_type;
+	if (!part || part->type == LAB_SSD_NONE) {
+		return LAB_SSD_NONE;
 	}
+	enum ssd_part_type part_type = part->type;
 
 	/* Perform cursor-based context checks */
 	enum ssd_part_type resizing_type = get_resizing_type(ssd, cursor);
 	return resizing_type != LAB_SSD_NONE ? resizing_type : part_type;
 }
 
+void
+ssd_part_register(struct ssd_part *part)
+{
+	assert(part->node && !part->node->data);
+	node_descriptor_create(part->node, LAB_NODE_DESC_SSD_PART, part);
+}
+
+static const uint32_t resize_edges[LAB_SSD_END_MARKER] = {
+	[LAB_SSD_PART_TOP] = WLR_EDGE_TOP,
+	[LAB_SSD_PART_RIGHT] = WLR_EDGE_RIGHT,
+	[LAB_SSD_PART_BOTTOM] = WLR_EDGE_BOTTOM,
+	[LAB_SSD_PART_LEFT] = WLR_EDGE_LEFT,
+	[LAB_SSD_PART_CORNER_TOP_LEFT] = WLR_EDGE_TOP | WLR_EDGE_LEFT,
+	[LAB_SSD_PART_CORNER_TOP_RIGHT] = WLR_EDGE_RIGHT | WLR_EDGE_TOP,
+	[LAB_SSD_PART_CORNER_BOTTOM_RIGHT] = WLR_EDGE_BOTTOM | WLR_EDGE_RIGHT,
+	[LAB_SSD_PART_CORNER_BOTTOM_LEFT] = WLR_EDGE_BOTTOM | WLR_EDGE_LEFT,
+};
+
 uint32_t
 ssd_resize_edges(enum ssd_part_type type)
 {
-	switch (type) {
-	case LAB_SSD_PART_TOP:
-		return WLR_EDGE_TOP;
-	case LAB_SSD_PART_RIGHT:
-		return WLR_EDGE_RIGHT;
-	case LAB_SSD_PART_BOTTOM:
-		return WLR_EDGE_BOTTOM;
-	case LAB_SSD_PART_LEFT:
-		return WLR_EDGE_LEFT;
-	case LAB_SSD_PART_CORNER_TOP_LEFT:
-		return WLR_EDGE_TOP | WLR_EDGE_LEFT;
-	case LAB_SSD_PART_CORNER_TOP_RIGHT:
-		return WLR_EDGE_RIGHT | WLR_EDGE_TOP;
-	case LAB_SSD_PART_CORNER_BOTTOM_RIGHT:
-		return WLR_EDGE_BOTTOM | WLR_EDGE_RIGHT;
-	case LAB_SSD_PART_CORNER_BOTTOM_LEFT:
-		return WLR_EDGE_BOTTOM | WLR_EDGE_LEFT;
-	default:
+	if ((unsigned int)type >= LAB_SSD_END_MARKER) {
 		return WLR_EDGE_NONE;
 	}
+	return resize_edges[type];
 }
 
 struct border
@@ -178,46 +153,47 @@ ssd_get_margin(const struct ssd *ssd)
 
 
 
+/*
+ * The parts contained by each part other than itself, as a bitset of
+ * part types, so matching a mouse context is a single AND
+ */
+static_assert(LAB_SSD_END_MARKER <= 64, "ssd_part_type does not fit a mask");
+
+#define PART_BIT(type) (1ull << (type))
+#define PART_RANGE(first, last) \
+	((PART_BIT(last) << 1) - PART_BIT(first))
+
+static const uint64_t contained_parts[LAB_SSD_END_MARKER] = {
+	[LAB_SSD_BUTTON] =
+		PART_RANGE(LAB_SSD_BUTTON_CLOSE, LAB_SSD_BUTTON_OMNIPRESENT),
+	[LAB_SSD_PART_TITLEBAR] =
+		PART_RANGE(LAB_SSD_BUTTON_CLOSE, LAB_SSD_PART_TITLE),
+	/* "Title" includes blank areas of "Titlebar" as well */
+	[LAB_SSD_PART_TITLE] =
+		PART_RANGE(LAB_SSD_PART_TITLEBAR, LAB_SSD_PART_TITLE),
+	[LAB_SSD_FRAME] = PART_RANGE(LAB_SSD_BUTTON_CLOSE, LAB_SSD_CLIENT),
+	[LAB_SSD_PART_TOP] = PART_BIT(LAB_SSD_PART_CORNER_TOP_LEFT)
+		| PART_BIT(LAB_SSD_PART_CORNER_TOP_RIGHT),
+	[LAB_SSD_PART_RIGHT] = PART_BIT(LAB_SSD_PART_CORNER_TOP_RIGHT)
+		| PART_BIT(LAB_SSD_PART_CORNER_BOTTOM_RIGHT),
+	[LAB_SSD_PART_BOTTOM] = PART_BIT(LAB_SSD_PART_CORNER_BOTTOM_RIGHT)
+		| PART_BIT(LAB_SSD_PART_CORNER_BOTTOM_LEFT),
+	[LAB_SSD_PART_LEFT] = PART_BIT(LAB_SSD_PART_CORNER_TOP_LEFT)
+		| PART_BIT(LAB_SSD_PART_CORNER_BOTTOM_LEFT),
+	[LAB_SSD_ALL] = PART_RANGE(LAB_SSD_NONE, LAB_SSD_END_MARKER - 1),
+};
+
 bool
 ssd_part_contains(enum ssd_part_type whole, enum ssd_part_type candidate)
 {
 	if (whole == candidate || whole == LAB_SSD_ALL) {
 		return true;
 	}
-	if (whole == LAB_SSD_BUTTON) {
-		return candidate >= LAB_SSD_BUTTON_CLOSE
-			&& candidate <= LAB_SSD_BUTTON_OMNIPRESENT;
-	}
-	if (whole == LAB_SSD_PART_TITLEBAR) {
-		return candidate >= LAB_SSD_BUTTON_CLOSE
-			&& candidate <= LAB_SSD_PART_TITLE;
-	}
-	if (whole == LAB_SSD_PART_TITLE) {
-		/* "Title" includes blank areas of "Titlebar" as well */
-		return candidate >= LAB_SSD_PART_TITLEBAR
-			&& candidate <= LAB_SSD_PART_TITLE;
-	}
-	if (whole == LAB_SSD_FRAME) {
-		return candidate >= LAB_SSD_BUTTON_CLOSE
-			&& candidate <= LAB_SSD_CLIENT;
-	}
-	if (whole == LAB_SSD_PART_TOP) {
-		return candidate == LAB_SSD_PART_CORNER_TOP_LEFT
-			|| candidate == LAB_SSD_PART_CORNER_TOP_RIGHT;
-	}
-	if (whole == LAB_SSD_PART_RIGHT) {
-		return candidate == LAB_SSD_PART_CORNER_TOP_RIGHT
-			|| candidate == LAB_SSD_PART_CORNER_BOTTOM_RIGHT;
-	}
-	if (whole == LAB_SSD_PART_BOTTOM) {
-		return candidate == LAB_SSD_PART_CORNER_BOTTOM_RIGHT
-			|| candidate == LAB_SSD_PART_CORNER_BOTTOM_LEFT;
-	}
-	if (whole == LAB_SSD_PART_LEFT) {
-		return candidate == LAB_SSD_PART_CORNER_TOP_LEFT
-			|| candidate == LAB_SSD_PART_CORNER_BOTTOM_LEFT;
+	if ((unsigned int)whole >= LAB_SSD_END_MARKER
+			|| (unsigned int)candidate >= LAB_SSD_END_MARKER) {
+		return false;
 	}
-	return false;
+	return contained_parts[whole] & PART_BIT(candidate);
 }
 
 enum ssd_mode
@@ -1,9 +1,16 @@
 // SPDX-License-Identifier: GPL-2.0-only
-
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include "common/macros.h"
 #include "common/mem.h"
 #include "labwc.h"
 #include "view.h"
 
+/* Consecutive fallbacks after which tearing is suspended */
+#define TEARING_FAILURE_LIMIT 3
+#define TEARING_BACKOFF_MIN_NSEC (1000 * 1000 * 1000LL)
+#define TEARING_BACKOFF_MAX_NSEC (64 * TEARING_BACKOFF_MIN_NSEC)
+
 struct tearing_controller {
 		struct wlr_tearing_control_v1 *tearing_control;
 		struct wl_listener set_hint;
@@ -57,3 +64,44 @@ new_tearing_hint(struct wl_listener *listener, void *data)
 	controller->destroy.notify = tearing_controller_destroy;
 	wl_signal_add(&tearing_control->events.destroy, &controller->destroy);
 }
+
+static int64_t
+now_nsec(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void
+tearing_commit_result(struct output *output, bool torn)
+{
+	if (torn) {
+		output->metrics.tearing_commits++;
+		output->tearing.failures = 0;
+		output->tearing.backoff_nsec = 0;
+		return;
+	}
+
+	output->metrics.tearing_fallbacks++;
+	if (++output->tearing.failures < TEARING_FAILURE_LIMIT) {
+		return;
+	}
+	/* Doubled each time tearing fails again right after a suspension */
+	output->tearing.failures = 0;
+	output->tearing.backoff_nsec = output->tearing.backoff_nsec
+		? MIN(2 * output->tearing.backoff_nsec, TEARING_BACKOFF_MAX_NSEC)
+		: TEARING_BACKOFF_MIN_NSEC;
+	output->tearing.suspended_until_nsec =
+		now_nsec() + output->tearing.backoff_nsec;
+	wlr_log(WLR_INFO, "tearing page-flips on %s keep failing, "
+		"suspended for %lld s", output->wlr_output->name,
+		(long long)(output->tearing.backoff_nsec / 1000000000));
+}
+
+bool
+tearing_is_suspended(struct output *output)
+{
+	return output->tearing.suspended_until_nsec
+		&& now_nsec() < output->tearing.suspended_until_nsec;
+}
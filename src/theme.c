@@ -19,14 +19,18 @@
 #include <wlr/util/log.h>
 #include <wlr/render/pixman.h>
 #include <strings.h>
+#include <sys/stat.h>
 #include "common/macros.h"
 #include "common/dir.h"
 #include "common/font.h"
+#include "common/grab-file.h"
 #include "common/graphic-helpers.h"
 #include "common/match.h"
 #include "common/mem.h"
 #include "common/parse-bool.h"
 #include "common/parse-double.h"
+#include "common/scaled-scene-buffer.h"
+#include "common/shadow.h"
 #include "common/string-helpers.h"
 #include "config/rcxml.h"
 #include "img/img.h"
@@ -34,6 +38,7 @@
 #include "theme.h"
 #include "buffer.h"
 #include "ssd.h"
+#include "trace.h"
 
 struct button {
 	const char *name;
@@ -147,7 +152,7 @@ get_button_filename(char *buf, size_t len, const char *name, const char *postfix
 	snprintf(filename, sizeof(filename), "%s%s", name, postfix);
 
 	struct wl_list paths;
-	paths_theme_create(&paths, rc.theme_name, filename);
+	paths_theme_find(&paths, rc.theme_name, filename);
 
 	/*
 	 * You can't really merge buttons, so let's just iterate forwards
@@ -286,7 +291,7 @@ load_button(struct theme *theme, struct button *b, int active)
  * ...in the button array definition below.
  */
 static void
-load_buttons(struct theme *theme)
+load_buttons(struct theme *theme, int active)
 {
 	struct button buttons[] = { {
 		.name = "menu",
@@ -384,9 +389,7 @@ load_buttons(struct theme *theme)
 	}, };
 
 	for (size_t i = 0; i < ARRAY_SIZE(buttons); ++i) {
-		struct button *b = &buttons[i];
-		load_button(theme, b, THEME_INACTIVE);
-		load_button(theme, b, THEME_ACTIVE);
+		load_button(theme, &buttons[i], active);
 	}
 }
 
@@ -610,60 +613,67 @@ entry(struct theme *theme, const char *key, const char *value)
 	/*
 	 * Note that in order for the pattern match to apply to more than just
 	 * the first instance, "else if" cannot be used throughout this function
+	 *
+	 * The key is compiled once so that the common case of a key without
+	 * wildcards is a plain string compare against each keyword rather
+	 * than an fnmatch() call.
 	 */
-	if (match_glob(key, "border.width")) {
+	struct match_glob glob;
+	match_glob_compile(&glob, key);
+
+	if (match_glob_compiled(&glob, "border.width")) {
 		theme->border_width = get_int_if_positive(
 			value, "border.width");
 	}
-	if (match_glob(key, "window.titlebar.padding.width")) {
+	if (match_glob_compiled(&glob, "window.titlebar.padding.width")) {
 		theme->window_titlebar_padding_width = get_int_if_positive(
 			value, "window.titlebar.padding.width");
 	}
-	if (match_glob(key, "window.titlebar.padding.height")) {
+	if (match_glob_compiled(&glob, "window.titlebar.padding.height")) {
 		theme->window_titlebar_padding_height = get_int_if_positive(
 			value, "window.titlebar.padding.height");
 	}
-	if (match_glob(key, "titlebar.height")) {
+	if (match_glob_compiled(&glob, "titlebar.height")) {
 		wlr_log(WLR_ERROR, "titlebar.height is no longer supported");
 	}
-	if (match_glob(key, "padding.height")) {
+	if (match_glob_compiled(&glob, "padding.height")) {
 		wlr_log(WLR_INFO, "padding.height is no longer supported");
 	}
 
-	if (match_glob(key, "window.active.border.color")) {
+	if (match_glob_compiled(&glob, "window.active.border.color")) {
 		parse_hexstr(value, theme->window[THEME_ACTIVE].border_color);
 	}
-	if (match_glob(key, "window.inactive.border.color")) {
+	if (match_glob_compiled(&glob, "window.inactive.border.color")) {
 		parse_hexstr(value, theme->window[THEME_INACTIVE].border_color);
 	}
 	/* border.color is obsolete, but handled for backward compatibility */
-	if (match_glob(key, "border.color")) {
+	if (match_glob_compiled(&glob, "border.color")) {
 		parse_hexstr(value, theme->window[THEME_ACTIVE].border_color);
 		parse_hexstr(value, theme->window[THEME_INACTIVE].border_color);
 	}
 
-	if (match_glob(key, "window.active.indicator.toggled-keybind.color")) {
+	if (match_glob_compiled(&glob, "window.active.indicator.toggled-keybind.color")) {
 		parse_hexstr(value, theme->window_toggled_keybinds_color);
 	}
 
-	if (match_glob(key, "window.active.title.bg.color")) {
+	if (match_glob_compiled(&glob, "window.active.title.bg.color")) {
 		parse_hexstr(value, theme->window[THEME_ACTIVE].title_bg_color);
 	}
-	if (match_glob(key, "window.inactive.title.bg.color")) {
+	if (match_glob_compiled(&glob, "window.inactive.title.bg.color")) {
 		parse_hexstr(value, theme->window[THEME_INACTIVE].title_bg_color);
 	}
 
-	if (match_glob(key, "window.active.label.text.color")) {
+	if (match_glob_compiled(&glob, "window.active.label.text.color")) {
 		parse_hexstr(value, theme->window[THEME_ACTIVE].label_text_color);
 	}
-	if (match_glob(key, "window.inactive.label.text.color")) {
+	if (match_glob_compiled(&glob, "window.inactive.label.text.color")) {
 		parse_hexstr(value, theme->window[THEME_INACTIVE].label_text_color);
 	}
-	if (match_glob(key, "window.label.text.justify")) {
+	if (match_glob_compiled(&glob, "window.label.text.justify")) {
 		theme->window_label_text_justify = parse_justification(value);
 	}
 
-	if (match_glob(key, "window.button.width")) {
+	if (match_glob_compiled(&glob, "window.button.width")) {
 		theme->window_button_width = atoi(value);
 		if (theme->window_button_width < 1) {
 			wlr_log(WLR_ERROR, "window.button.width cannot "
@@ -671,7 +681,7 @@ entry(struct theme *theme, const char *key, const char *value)
 			theme->window_button_width = 1;
 		}
 	}
-	if (match_glob(key, "window.button.height")) {
+	if (match_glob_compiled(&glob, "window.button.height")) {
 		theme->window_button_height = atoi(value);
 		if (theme->window_button_height < 1) {
 			wlr_log(WLR_ERROR, "window.button.height cannot "
@@ -679,24 +689,24 @@ entry(struct theme *theme, const char *key, const char *value)
 			theme->window_button_height = 1;
 		}
 	}
-	if (match_glob(key, "window.button.spacing")) {
+	if (match_glob_compiled(&glob, "window.button.spacing")) {
 		theme->window_button_spacing = get_int_if_positive(
 			value, "window.button.spacing");
 	}
-	if (match_glob(key, "window.button.hover.bg.corner-radius")) {
+	if (match_glob_compiled(&glob, "window.button.hover.bg.corner-radius")) {
 		theme->window_button_hover_bg_corner_radius = get_int_if_positive(
 			value, "window.button.hover.bg.corner-radius");
 	}
 
 	/* universal button */
-	if (match_glob(key, "window.active.button.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.active.button.unpressed.image.color")) {
 		for (enum ssd_part_type type = LAB_SSD_BUTTON_FIRST;
 				type <= LAB_SSD_BUTTON_LAST; type++) {
 			parse_hexstr(value,
 				theme->window[THEME_ACTIVE].button_colors[type]);
 		}
 	}
-	if (match_glob(key, "window.inactive.button.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.inactive.button.unpressed.image.color")) {
 		for (enum ssd_part_type type = LAB_SSD_BUTTON_FIRST;
 				type <= LAB_SSD_BUTTON_LAST; type++) {
 			parse_hexstr(value,
@@ -705,155 +715,155 @@ entry(struct theme *theme, const char *key, const char *value)
 	}
 
 	/* individual buttons */
-	if (match_glob(key, "window.active.button.menu.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.active.button.menu.unpressed.image.color")) {
 		parse_hexstr(value, theme->window[THEME_ACTIVE]
 			.button_colors[LAB_SSD_BUTTON_WINDOW_MENU]);
 		parse_hexstr(value, theme->window[THEME_ACTIVE]
 			.button_colors[LAB_SSD_BUTTON_WINDOW_ICON]);
 	}
-	if (match_glob(key, "window.active.button.iconify.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.active.button.iconify.unpressed.image.color")) {
 		parse_hexstr(value, theme->window[THEME_ACTIVE]
 			.button_colors[LAB_SSD_BUTTON_ICONIFY]);
 	}
-	if (match_glob(key, "window.active.button.max.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.active.button.max.unpressed.image.color")) {
 		parse_hexstr(value, theme->window[THEME_ACTIVE]
 			.button_colors[LAB_SSD_BUTTON_MAXIMIZE]);
 	}
-	if (match_glob(key, "window.active.button.shade.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.active.button.shade.unpressed.image.color")) {
 		parse_hexstr(value, theme->window[THEME_ACTIVE]
 			.button_colors[LAB_SSD_BUTTON_SHADE]);
 	}
-	if (match_glob(key, "window.active.button.desk.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.active.button.desk.unpressed.image.color")) {
 		parse_hexstr(value, theme->window[THEME_ACTIVE]
 			.button_colors[LAB_SSD_BUTTON_OMNIPRESENT]);
 	}
-	if (match_glob(key, "window.active.button.close.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.active.button.close.unpressed.image.color")) {
 		parse_hexstr(value, theme->window[THEME_ACTIVE]
 			.button_colors[LAB_SSD_BUTTON_CLOSE]);
 	}
-	if (match_glob(key, "window.inactive.button.menu.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.inactive.button.menu.unpressed.image.color")) {
 		parse_hexstr(value, theme->window[THEME_INACTIVE]
 			.button_colors[LAB_SSD_BUTTON_WINDOW_MENU]);
 		parse_hexstr(value, theme->window[THEME_INACTIVE]
 			.button_colors[LAB_SSD_BUTTON_WINDOW_ICON]);
 	}
-	if (match_glob(key, "window.inactive.button.iconify.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.inactive.button.iconify.unpressed.image.color")) {
 		parse_hexstr(value, theme->window[THEME_INACTIVE]
 			.button_colors[LAB_SSD_BUTTON_ICONIFY]);
 	}
-	if (match_glob(key, "window.inactive.button.max.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.inactive.button.max.unpressed.image.color")) {
 		parse_hexstr(value, theme->window[THEME_INACTIVE]
 			.button_colors[LAB_SSD_BUTTON_MAXIMIZE]);
 	}
-	if (match_glob(key, "window.inactive.button.shade.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.inactive.button.shade.unpressed.image.color")) {
 		parse_hexstr(value, theme->window[THEME_INACTIVE]
 			.button_colors[LAB_SSD_BUTTON_SHADE]);
 	}
-	if (match_glob(key, "window.inactive.button.desk.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.inactive.button.desk.unpressed.image.color")) {
 		parse_hexstr(value, theme->window[THEME_INACTIVE]
 			.button_colors[LAB_SSD_BUTTON_OMNIPRESENT]);
 	}
-	if (match_glob(key, "window.inactive.button.close.unpressed.image.color")) {
+	if (match_glob_compiled(&glob, "window.inactive.button.close.unpressed.image.color")) {
 		parse_hexstr(value, theme->window[THEME_INACTIVE]
 			.button_colors[LAB_SSD_BUTTON_CLOSE]);
 	}
 
 	/* window drop-shadows */
-	if (match_glob(key, "window.active.shadow.size")) {
+	if (match_glob_compiled(&glob, "window.active.shadow.size")) {
 		theme->window[THEME_ACTIVE].shadow_size = get_int_if_positive(
 			value, "window.active.shadow.size");
 	}
-	if (match_glob(key, "window.inactive.shadow.size")) {
+	if (match_glob_compiled(&glob, "window.inactive.shadow.size")) {
 		theme->window[THEME_INACTIVE].shadow_size = get_int_if_positive(
 			value, "window.inactive.shadow.size");
 	}
-	if (match_glob(key, "window.active.shadow.color")) {
+	if (match_glob_compiled(&glob, "window.active.shadow.color")) {
 		parse_hexstr(value, theme->window[THEME_ACTIVE].shadow_color);
 	}
-	if (match_glob(key, "window.inactive.shadow.color")) {
+	if (match_glob_compiled(&glob, "window.inactive.shadow.color")) {
 		parse_hexstr(value, theme->window[THEME_INACTIVE].shadow_color);
 	}
 
-	if (match_glob(key, "menu.overlap.x")) {
+	if (match_glob_compiled(&glob, "menu.overlap.x")) {
 		theme->menu_overlap_x = atoi(value);
 	}
-	if (match_glob(key, "menu.overlap.y")) {
+	if (match_glob_compiled(&glob, "menu.overlap.y")) {
 		theme->menu_overlap_y = atoi(value);
 	}
-	if (match_glob(key, "menu.width.min")) {
+	if (match_glob_compiled(&glob, "menu.width.min")) {
 		theme->menu_min_width = get_int_if_positive(
 			value, "menu.width.min");
 	}
-	if (match_glob(key, "menu.width.max")) {
+	if (match_glob_compiled(&glob, "menu.width.max")) {
 		theme->menu_max_width = get_int_if_positive(
 			value, "menu.width.max");
 	}
-	if (match_glob(key, "menu.border.width")) {
+	if (match_glob_compiled(&glob, "menu.border.width")) {
 		theme->menu_border_width = get_int_if_positive(
 			value, "menu.border.width");
 	}
-	if (match_glob(key, "menu.border.color")) {
+	if (match_glob_compiled(&glob, "menu.border.color")) {
 		parse_hexstr(value, theme->menu_border_color);
 	}
 
-	if (match_glob(key, "menu.items.padding.x")) {
+	if (match_glob_compiled(&glob, "menu.items.padding.x")) {
 		theme->menu_items_padding_x = get_int_if_positive(
 			value, "menu.items.padding.x");
 	}
-	if (match_glob(key, "menu.items.padding.y")) {
+	if (match_glob_compiled(&glob, "menu.items.padding.y")) {
 		theme->menu_items_padding_y = get_int_if_positive(
 			value, "menu.items.padding.y");
 	}
-	if (match_glob(key, "menu.items.bg.color")) {
+	if (match_glob_compiled(&glob, "menu.items.bg.color")) {
 		parse_hexstr(value, theme->menu_items_bg_color);
 	}
-	if (match_glob(key, "menu.items.text.color")) {
+	if (match_glob_compiled(&glob, "menu.items.text.color")) {
 		parse_hexstr(value, theme->menu_items_text_color);
 	}
-	if (match_glob(key, "menu.items.active.bg.color")) {
+	if (match_glob_compiled(&glob, "menu.items.active.bg.color")) {
 		parse_hexstr(value, theme->menu_items_active_bg_color);
 	}
-	if (match_glob(key, "menu.items.active.text.color")) {
+	if (match_glob_compiled(&glob, "menu.items.active.text.color")) {
 		parse_hexstr(value, theme->menu_items_active_text_color);
 	}
 
-	if (match_glob(key, "menu.separator.width")) {
+	if (match_glob_compiled(&glob, "menu.separator.width")) {
 		theme->menu_separator_line_thickness = get_int_if_positive(
 			value, "menu.separator.width");
 	}
-	if (match_glob(key, "menu.separator.padding.width")) {
+	if (match_glob_compiled(&glob, "menu.separator.padding.width")) {
 		theme->menu_separator_padding_width = get_int_if_positive(
 			value, "menu.separator.padding.width");
 	}
-	if (match_glob(key, "menu.separator.padding.height")) {
+	if (match_glob_compiled(&glob, "menu.separator.padding.height")) {
 		theme->menu_separator_padding_height = get_int_if_positive(
 			value, "menu.separator.padding.height");
 	}
-	if (match_glob(key, "menu.separator.color")) {
+	if (match_glob_compiled(&glob, "menu.separator.color")) {
 		parse_hexstr(value, theme->menu_separator_color);
 	}
 
-	if (match_glob(key, "menu.title.bg.color")) {
+	if (match_glob_compiled(&glob, "menu.title.bg.color")) {
 		parse_hexstr(value, theme->menu_title_bg_color);
 	}
-	if (match_glob(key, "menu.title.text.justify")) {
+	if (match_glob_compiled(&glob, "menu.title.text.justify")) {
 		theme->menu_title_text_justify = parse_justification(value);
 	}
-	if (match_glob(key, "menu.title.text.color")) {
+	if (match_glob_compiled(&glob, "menu.title.text.color")) {
 		parse_hexstr(value, theme->menu_title_text_color);
 	}
 
-	if (match_glob(key, "osd.bg.color")) {
+	if (match_glob_compiled(&glob, "osd.bg.color")) {
 		parse_hexstr(value, theme->osd_bg_color);
 	}
-	if (match_glob(key, "osd.border.width")) {
+	if (match_glob_compiled(&glob, "osd.border.width")) {
 		theme->osd_border_width = get_int_if_positive(
 			value, "osd.border.width");
 	}
-	if (match_glob(key, "osd.border.color")) {
+	if (match_glob_compiled(&glob, "osd.border.color")) {
 		parse_hexstr(value, theme->osd_border_color);
 	}
-	if (match_glob(key, "osd.window-switcher.width")) {
+	if (match_glob_compiled(&glob, "osd.window-switcher.width")) {
 		if (strrchr(value, '%')) {
 			theme->osd_window_switcher_width_is_percent = true;
 		} else {
@@ -862,94 +872,94 @@ entry(struct theme *theme, const char *key, const char *value)
 		theme->osd_window_switcher_width = get_int_if_positive(
 			value, "osd.window-switcher.width");
 	}
-	if (match_glob(key, "osd.window-switcher.padding")) {
+	if (match_glob_compiled(&glob, "osd.window-switcher.padding")) {
 		theme->osd_window_switcher_padding = get_int_if_positive(
 			value, "osd.window-switcher.padding");
 	}
-	if (match_glob(key, "osd.window-switcher.item.padding.x")) {
+	if (match_glob_compiled(&glob, "osd.window-switcher.item.padding.x")) {
 		theme->osd_window_switcher_item_padding_x =
 			get_int_if_positive(
 				value, "osd.window-switcher.item.padding.x");
 	}
-	if (match_glob(key, "osd.window-switcher.item.padding.y")) {
+	if (match_glob_compiled(&glob, "osd.window-switcher.item.padding.y")) {
 		theme->osd_window_switcher_item_padding_y =
 			get_int_if_positive(
 				value, "osd.window-switcher.item.padding.y");
 	}
-	if (match_glob(key, "osd.window-switcher.item.active.border.width")) {
+	if (match_glob_compiled(&glob, "osd.window-switcher.item.active.border.width")) {
 		theme->osd_window_switcher_item_active_border_width =
 			get_int_if_positive(
 				value, "osd.window-switcher.item.active.border.width");
 	}
-	if (match_glob(key, "osd.window-switcher.item.icon.size")) {
+	if (match_glob_compiled(&glob, "osd.window-switcher.item.icon.size")) {
 		theme->osd_window_switcher_item_icon_size =
 			get_int_if_positive(
 				value, "osd.window-switcher.item.icon.size");
 	}
-	if (match_glob(key, "osd.window-switcher.preview.border.width")) {
+	if (match_glob_compiled(&glob, "osd.window-switcher.preview.border.width")) {
 		theme->osd_window_switcher_preview_border_width =
 			get_int_if_positive(
 				value, "osd.window-switcher.preview.border.width");
 	}
-	if (match_glob(key, "osd.window-switcher.preview.border.color")) {
+	if (match_glob_compiled(&glob, "osd.window-switcher.preview.border.color")) {
 		parse_hexstrs(value, theme->osd_window_switcher_preview_border_color);
 	}
-	if (match_glob(key, "osd.workspace-switcher.boxes.width")) {
+	if (match_glob_compiled(&glob, "osd.workspace-switcher.boxes.width")) {
 		theme->osd_workspace_switcher_boxes_width =
 			get_int_if_positive(
 				value, "osd.workspace-switcher.boxes.width");
 	}
-	if (match_glob(key, "osd.workspace-switcher.boxes.height")) {
+	if (match_glob_compiled(&glob, "osd.workspace-switcher.boxes.height")) {
 		theme->osd_workspace_switcher_boxes_height =
 			get_int_if_positive(
 				value, "osd.workspace-switcher.boxes.height");
 	}
-	if (match_glob(key, "osd.workspace-switcher.boxes.border.width")) {
+	if (match_glob_compiled(&glob, "osd.workspace-switcher.boxes.border.width")) {
 		theme->osd_workspace_switcher_boxes_border_width =
 			get_int_if_positive(
 				value, "osd.workspace-switcher.boxes.border.width");
 	}
-	if (match_glob(key, "osd.label.text.color")) {
+	if (match_glob_compiled(&glob, "osd.label.text.color")) {
 		parse_hexstr(value, theme->osd_label_text_color);
 	}
-	if (match_glob(key, "snapping.overlay.region.bg.enabled")) {
+	if (match_glob_compiled(&glob, "snapping.overlay.region.bg.enabled")) {
 		set_bool(value, &theme->snapping_overlay_region.bg_enabled);
 	}
-	if (match_glob(key, "snapping.overlay.edge.bg.enabled")) {
+	if (match_glob_compiled(&glob, "snapping.overlay.edge.bg.enabled")) {
 		set_bool(value, &theme->snapping_overlay_edge.bg_enabled);
 	}
-	if (match_glob(key, "snapping.overlay.region.border.enabled")) {
+	if (match_glob_compiled(&glob, "snapping.overlay.region.border.enabled")) {
 		set_bool(value, &theme->snapping_overlay_region.border_enabled);
 	}
-	if (match_glob(key, "snapping.overlay.edge.border.enabled")) {
+	if (match_glob_compiled(&glob, "snapping.overlay.edge.border.enabled")) {
 		set_bool(value, &theme->snapping_overlay_edge.border_enabled);
 	}
-	if (match_glob(key, "snapping.overlay.region.bg.color")) {
+	if (match_glob_compiled(&glob, "snapping.overlay.region.bg.color")) {
 		parse_hexstr(value, theme->snapping_overlay_region.bg_color);
 	}
-	if (match_glob(key, "snapping.overlay.edge.bg.color")) {
+	if (match_glob_compiled(&glob, "snapping.overlay.edge.bg.color")) {
 		parse_hexstr(value, theme->snapping_overlay_edge.bg_color);
 	}
-	if (match_glob(key, "snapping.overlay.region.border.width")) {
+	if (match_glob_compiled(&glob, "snapping.overlay.region.border.width")) {
 		theme->snapping_overlay_region.border_width = get_int_if_positive(
 			value, "snapping.overlay.region.border.width");
 	}
-	if (match_glob(key, "snapping.overlay.edge.border.width")) {
+	if (match_glob_compiled(&glob, "snapping.overlay.edge.border.width")) {
 		theme->snapping_overlay_edge.border_width = get_int_if_positive(
 			value, "snapping.overlay.edge.border.width");
 	}
-	if (match_glob(key, "snapping.overlay.region.border.color")) {
+	if (match_glob_compiled(&glob, "snapping.overlay.region.border.color")) {
 		parse_hexstrs(value, theme->snapping_overlay_region.border_color);
 	}
-	if (match_glob(key, "snapping.overlay.edge.border.color")) {
+	if (match_glob_compiled(&glob, "snapping.overlay.edge.border.color")) {
 		parse_hexstrs(value, theme->snapping_overlay_edge.border_color);
 	}
 
-	if (match_glob(key, "magnifier.border.width")) {
+	if (match_glob_compiled(&glob, "magnifier.border.width")) {
 		theme->mag_border_width = get_int_if_positive(
 			value, "magnifier.border.width");
 	}
-	if (match_glob(key, "magnifier.border.color")) {
+	if (match_glob_compiled(&glob, "magnifier.border.color")) {
 		parse_hexstr(value, theme->mag_border_color);
 	}
 }
@@ -986,30 +996,44 @@ theme_read(struct theme *theme, struct wl_list *paths)
 
 	for (struct wl_list *elm = iter(paths); elm != paths; elm = iter(elm)) {
 		struct path *path = wl_container_of(elm, path, link);
-		FILE *stream = fopen(path->string, "r");
-		if (!stream) {
+		struct buf file = grab_file(path->string);
+		if (!file.alloc) {
 			continue;
 		}
 
 		wlr_log(WLR_INFO, "read theme %s", path->string);
 
-		char *line = NULL;
-		size_t len = 0;
-		while (getline(&line, &len, stream) != -1) {
-			char *p = strrchr(line, '\n');
-			if (p) {
-				*p = '\0';
-			}
+		size_t pos = 0;
+		char *line;
+		while ((line = grab_file_next_line(&file, &pos))) {
 			process_line(theme, line);
 		}
-		zfree(line);
-		fclose(stream);
+		buf_reset(&file);
 		if (!should_merge_config) {
 			break;
 		}
 	}
 }
 
+void
+theme_parse_buffer(struct theme *theme, const char *data, size_t len)
+{
+	char *copy = xmalloc(len + 1);
+	memcpy(copy, data, len);
+	copy[len] = '\0';
+
+	char *line = copy;
+	while (line) {
+		char *next = strchr(line, '\n');
+		if (next) {
+			*next++ = '\0';
+		}
+		process_line(theme, line);
+		line = next;
+	}
+	free(copy);
+}
+
 static struct lab_data_buffer *
 rounded_rect(struct rounded_corner_ctx *ctx)
 {
@@ -1174,7 +1198,7 @@ out:
 }
 
 static void
-create_corners(struct theme *theme)
+create_corners(struct theme *theme, int active)
 {
 	int corner_width = 5;
 
@@ -1185,133 +1209,17 @@ create_corners(struct theme *theme)
 		.height = theme->titlebar_height + theme->border_width,
 	};
 
-	for (int active = THEME_INACTIVE; active <= THEME_ACTIVE; active++) {
-		struct rounded_corner_ctx ctx = {
-			.box = &box,
-			.radius = rc.corner_radius,
-			.line_width = theme->border_width,
-			.fill_color = theme->window[active].title_bg_color,
-			.border_color = theme->window[active].border_color,
-			.corner = LAB_CORNER_TOP_LEFT,
-		};
-		theme->window[active].corner_top_left_normal = rounded_rect(&ctx);
-		ctx.corner = LAB_CORNER_TOP_RIGHT;
-		theme->window[active].corner_top_right_normal = rounded_rect(&ctx);
-	}
-}
-
-/*
- * Draw the buffer used to render the edges of window drop-shadows. The buffer
- * is 1 pixel tall and `visible_size` pixels wide and can be rotated and scaled for the
- * different edges.  The buffer is drawn as would be found at the right-hand
- * edge of a window. The gradient has a color of `start_color` at its left edge
- * fading to clear at its right edge.
- */
-static void
-shadow_edge_gradient(struct lab_data_buffer *buffer,
-		int visible_size, int total_size, float start_color[4])
-{
-	if (!buffer) {
-		/* This type of shadow is disabled, do nothing */
-		return;
-	}
-
-	assert(buffer->format == DRM_FORMAT_ARGB8888);
-	uint8_t *pixels = buffer->data;
-
-	/* Inset portion which is obscured */
-	int inset = total_size - visible_size;
-
-	/* Standard deviation normalised against the shadow width, squared */
-	double variance = 0.3 * 0.3;
-
-	for (int x = 0; x < visible_size; x++) {
-		/*
-		 * x normalised against total shadow width. We add on inset here
-		 * because we don't bother drawing inset for the edge shadow
-		 * buffers but still need the pattern to line up with the corner
-		 * shadow buffers which do have inset drawn.
-		 */
-		double xn = (double)(x + inset) / (double)total_size;
-
-		/* Gaussian dropoff */
-		double alpha = exp(-(xn * xn) / variance);
-
-		/* RGBA values are all pre-multiplied */
-		pixels[4 * x] = start_color[2] * alpha * 255;
-		pixels[4 * x + 1] = start_color[1] * alpha * 255;
-		pixels[4 * x + 2] = start_color[0] * alpha * 255;
-		pixels[4 * x + 3] = start_color[3] * alpha * 255;
-	}
-}
-
-/*
- * Draw the buffer used to render the corners of window drop-shadows.  The
- * shadow looks better if the buffer is inset behind the window, so the buffer
- * is square with a size of radius+inset.  The buffer is drawn for the
- * bottom-right corner but can be rotated for other corners.  The gradient fades
- * from `start_color` at the top-left to clear at the opposite edge.
- *
- * If the window is translucent we don't want the shadow to be visible through
- * it.  For the bottom corners of the window this is easy, we just erase the
- * square of the buffer which will be behind the window.  For the top it's a
- * little more complicated because the titlebar can have rounded corners.
- * However, the titlebar itself is always opaque so we only have to erase the
- * L-shaped area of the buffer which can appear behind the non-titlebar part of
- * the window.
- */
-static void
-shadow_corner_gradient(struct lab_data_buffer *buffer, int visible_size,
-	int total_size, int titlebar_height, float start_color[4])
-{
-	if (!buffer) {
-		/* This type of shadow is disabled, do nothing */
-		return;
-	}
-
-	assert(buffer->format == DRM_FORMAT_ARGB8888);
-	uint8_t *pixels = buffer->data;
-
-	/* Standard deviation normalised against the shadow width, squared */
-	double variance = 0.3 * 0.3;
-
-	int inset = total_size - visible_size;
-
-	for (int y = 0; y < total_size; y++) {
-		uint8_t *pixel_row = &pixels[y * buffer->stride];
-		for (int x = 0; x < total_size; x++) {
-			/* x and y normalised against total shadow width */
-			double x_norm = (double)(x) / (double)total_size;
-			double y_norm = (double)(y) / (double)total_size;
-			/*
-			 * For Gaussian drop-off in 2d you can just calculate
-			 * the outer product of the horizontal and vertical
-			 * profiles.
-			 */
-			double gauss_x = exp(-(x_norm * x_norm) / variance);
-			double gauss_y = exp(-(y_norm * y_norm) / variance);
-			double alpha = gauss_x * gauss_y;
-
-			/*
-			 * Erase the L-shaped region which could be visible
-			 * through a transparent window but not obscured by the
-			 * titlebar. If inset is smaller than the titlebar
-			 * height then there's nothing to do, this is handled by
-			 * (inset - titlebar_height) being negative.
-			 */
-			bool in1 = x < inset && y < inset - titlebar_height;
-			bool in2 = x < inset - titlebar_height && y < inset;
-			if (in1 || in2) {
-				alpha = 0.0;
-			}
-
-			/* RGBA values are all pre-multiplied */
-			pixel_row[4 * x] = start_color[2] * alpha * 255;
-			pixel_row[4 * x + 1] = start_color[1] * alpha * 255;
-			pixel_row[4 * x + 2] = start_color[0] * alpha * 255;
-			pixel_row[4 * x + 3] = start_color[3] * alpha * 255;
-		}
-	}
+	struct rounded_corner_ctx ctx = {
+		.box = &box,
+		.radius = rc.corner_radius,
+		.line_width = theme->border_width,
+		.fill_color = theme->window[active].title_bg_color,
+		.border_color = theme->window[active].border_color,
+		.corner = LAB_CORNER_TOP_LEFT,
+	};
+	theme->window[active].corner_top_left_normal = rounded_rect(&ctx);
+	ctx.corner = LAB_CORNER_TOP_RIGHT;
+	theme->window[active].corner_top_right_normal = rounded_rect(&ctx);
 }
 
 static void
@@ -1329,36 +1237,40 @@ create_shadow(struct theme *theme, int active)
 	 * the visible width.  Corners are inset so the buffers are larger for
 	 * this.
 	 */
-	if (visible_size > 0) {
-		theme->window[active].shadow_edge = buffer_create_cairo(
-			visible_size, 1, 1.0);
-		theme->window[active].shadow_corner_top = buffer_create_cairo(
-			total_size, total_size, 1.0);
-		theme->window[active].shadow_corner_bottom = buffer_create_cairo(
-			total_size, total_size, 1.0);
-		if (!theme->window[active].shadow_corner_top
-				|| !theme->window[active].shadow_corner_bottom
-				|| !theme->window[active].shadow_edge) {
-			wlr_log(WLR_ERROR, "Failed to allocate shadow buffer");
-			return;
-		}
+	if (visible_size <= 0) {
+		return;
+	}
+	theme->window[active].shadow_edge = buffer_create_cairo(
+		visible_size, 1, 1.0);
+	theme->window[active].shadow_corner_top = buffer_create_cairo(
+		total_size, total_size, 1.0);
+	theme->window[active].shadow_corner_bottom = buffer_create_cairo(
+		total_size, total_size, 1.0);
+	if (!theme->window[active].shadow_corner_top
+			|| !theme->window[active].shadow_corner_bottom
+			|| !theme->window[active].shadow_edge) {
+		wlr_log(WLR_ERROR, "Failed to allocate shadow buffer");
+		return;
 	}
 
-	shadow_edge_gradient(theme->window[active].shadow_edge, visible_size,
-		total_size, theme->window[active].shadow_color);
-	shadow_corner_gradient(theme->window[active].shadow_corner_top,
-		visible_size, total_size,
+	struct lab_data_buffer *edge = theme->window[active].shadow_edge;
+	struct lab_data_buffer *top = theme->window[active].shadow_corner_top;
+	struct lab_data_buffer *bottom =
+		theme->window[active].shadow_corner_bottom;
+	assert(edge->format == DRM_FORMAT_ARGB8888);
+	assert(top->format == DRM_FORMAT_ARGB8888);
+	assert(bottom->format == DRM_FORMAT_ARGB8888);
+
+	double *profile = shadow_profile(total_size);
+	shadow_edge_gradient((uint32_t *)edge->data, profile,
+		visible_size, total_size, theme->window[active].shadow_color);
+	shadow_corner_gradient((uint32_t *)top->data, top->stride,
+		profile, visible_size, total_size,
 		theme->titlebar_height, theme->window[active].shadow_color);
-	shadow_corner_gradient(theme->window[active].shadow_corner_bottom,
-		visible_size, total_size, 0,
+	shadow_corner_gradient((uint32_t *)bottom->data, bottom->stride,
+		profile, visible_size, total_size, 0,
 		theme->window[active].shadow_color);
-}
-
-static void
-create_shadows(struct theme *theme)
-{
-	create_shadow(theme, THEME_INACTIVE);
-	create_shadow(theme, THEME_ACTIVE);
+	free(profile);
 }
 
 static void
@@ -1497,9 +1409,121 @@ post_processing(struct theme *theme)
 	}
 }
 
+static uint32_t
+hash_path_stat(uint32_t hash, const char *path)
+{
+	struct stat st;
+	hash = scaled_scene_buffer_hash_str(hash, path);
+	if (stat(path, &st) < 0) {
+		return scaled_scene_buffer_hash(hash, "-", 1);
+	}
+	hash = scaled_scene_buffer_hash(hash, &st.st_ino, sizeof(st.st_ino));
+	hash = scaled_scene_buffer_hash(hash, &st.st_size, sizeof(st.st_size));
+	return scaled_scene_buffer_hash(hash, &st.st_mtim, sizeof(st.st_mtim));
+}
+
+static uint32_t
+hash_paths_stat(uint32_t hash, struct wl_list *paths)
+{
+	struct path *path;
+	wl_list_for_each(path, paths, link) {
+		hash = hash_path_stat(hash, path->string);
+	}
+	paths_destroy(paths);
+	return hash;
+}
+
+static uint32_t
+hash_font(uint32_t hash, struct font *font)
+{
+	hash = scaled_scene_buffer_hash_str(hash, font->name);
+	hash = scaled_scene_buffer_hash(hash, &font->size, sizeof(font->size));
+	hash = scaled_scene_buffer_hash(hash, &font->slant, sizeof(font->slant));
+	return scaled_scene_buffer_hash(hash, &font->weight,
+		sizeof(font->weight));
+}
+
+static uint32_t
+hash_title_buttons(uint32_t hash, struct wl_list *buttons)
+{
+	struct title_button *button;
+	wl_list_for_each(button, buttons, link) {
+		hash = scaled_scene_buffer_hash(hash, &button->type,
+			sizeof(button->type));
+	}
+	/* Separate the left and right lists */
+	return scaled_scene_buffer_hash(hash, "|", 1);
+}
+
+/*
+ * Fingerprint of everything theme_init() reads: the rc.xml options used by
+ * the theme and the stat() data of the themerc files and theme directories.
+ * Theme directories are included because buttons are looked up in them on
+ * first use, and adding or replacing a file changes the directory mtime.
+ */
+static uint32_t
+theme_sources_hash(const char *theme_name)
+{
+	uint32_t hash = LAB_SCALED_BUFFER_HASH_INIT;
+	hash = scaled_scene_buffer_hash_str(hash, theme_name);
+	hash = scaled_scene_buffer_hash(hash, &rc.corner_radius,
+		sizeof(rc.corner_radius));
+	hash = scaled_scene_buffer_hash(hash, &rc.resize_corner_range,
+		sizeof(rc.resize_corner_range));
+	hash = scaled_scene_buffer_hash(hash, &rc.merge_config,
+		sizeof(rc.merge_config));
+	hash = hash_font(hash, &rc.font_activewindow);
+	hash = hash_font(hash, &rc.font_inactivewindow);
+	hash = hash_font(hash, &rc.font_menuheader);
+	hash = hash_font(hash, &rc.font_menuitem);
+	hash = hash_font(hash, &rc.font_osd);
+	hash = hash_title_buttons(hash, &rc.title_buttons_left);
+	hash = hash_title_buttons(hash, &rc.title_buttons_right);
+
+	struct wl_list paths;
+	if (theme_name) {
+		paths_theme_create(&paths, theme_name, "");
+		hash = hash_paths_stat(hash, &paths);
+		paths_theme_create(&paths, theme_name, "themerc");
+		hash = hash_paths_stat(hash, &paths);
+	}
+	paths_config_create(&paths, "themerc-override");
+	return hash_paths_stat(hash, &paths);
+}
+
+bool
+theme_is_current(struct theme *theme, const char *theme_name)
+{
+	return theme->loaded
+		&& theme->sources_hash == theme_sources_hash(theme_name);
+}
+
+/*
+ * Buttons are looked up in the theme directories, and the leftmost and
+ * rightmost buttons get rounded variants
+ */
+static uint32_t
+button_sources_hash(const char *theme_name)
+{
+	uint32_t hash = LAB_SCALED_BUFFER_HASH_INIT;
+	hash = scaled_scene_buffer_hash_str(hash, theme_name);
+	hash = hash_title_buttons(hash, &rc.title_buttons_left);
+	hash = hash_title_buttons(hash, &rc.title_buttons_right);
+	if (theme_name) {
+		struct wl_list paths;
+		paths_theme_create(&paths, theme_name, "");
+		hash = hash_paths_stat(hash, &paths);
+	}
+	return hash;
+}
+
 void
 theme_init(struct theme *theme, struct server *server, const char *theme_name)
 {
+	TRACE_FUNC();
+	theme->sources_hash = theme_sources_hash(theme_name);
+	theme->loaded = true;
+
 	/*
 	 * Set some default values. This is particularly important on
 	 * reconfigure as not all themes set all options
@@ -1514,20 +1538,152 @@ theme_init(struct theme *theme, struct server *server, const char *theme_name)
 		 *   - <data-dir>/share/themes/$theme_name/labwc/themerc
 		 *   - <data-dir>/share/themes/$theme_name/openbox-3/themerc
 		 */
-		paths_theme_create(&paths, theme_name, "themerc");
+		paths_theme_find(&paths, theme_name, "themerc");
 		theme_read(theme, &paths);
 		paths_destroy(&paths);
 	}
 
 	/* Read <config-dir>/labwc/themerc-override */
-	paths_config_create(&paths, "themerc-override");
+	paths_config_find(&paths, "themerc-override");
 	theme_read(theme, &paths);
 	paths_destroy(&paths);
 
+	/* Corners, buttons and shadows are created by theme_ensure_assets() */
 	post_processing(theme);
-	create_corners(theme);
-	load_buttons(theme);
-	create_shadows(theme);
+
+	theme->corner_radius = rc.corner_radius;
+	theme->button_sources_hash = button_sources_hash(theme_name);
+}
+
+void
+theme_ensure_assets(struct theme *theme, int active, uint32_t assets)
+{
+	assert(active == THEME_INACTIVE || active == THEME_ACTIVE);
+	uint32_t missing = assets & ~theme->window[active].assets_loaded;
+	if (!missing) {
+		return;
+	}
+	/* Mark first so that a failure is not retried on every call */
+	theme->window[active].assets_loaded |= missing;
+
+	if (missing & LAB_THEME_ASSET_CORNERS) {
+		create_corners(theme, active);
+	}
+	if (missing & LAB_THEME_ASSET_BUTTONS) {
+		load_buttons(theme, active);
+	}
+	if (missing & LAB_THEME_ASSET_SHADOWS) {
+		create_shadow(theme, active);
+	}
+}
+
+#define HASH_FIELD(hash, field) \
+	scaled_scene_buffer_hash((hash), &(field), sizeof(field))
+
+/* Everything an asset group of theme->window[@active] is rendered from */
+static uint32_t
+asset_hash(struct theme *theme, int active, enum lab_theme_asset asset)
+{
+	uint32_t hash = LAB_SCALED_BUFFER_HASH_INIT;
+	hash = HASH_FIELD(hash, theme->titlebar_height);
+	hash = HASH_FIELD(hash, theme->border_width);
+	hash = HASH_FIELD(hash, theme->corner_radius);
+
+	switch (asset) {
+	case LAB_THEME_ASSET_CORNERS:
+		hash = HASH_FIELD(hash, theme->window[active].title_bg_color);
+		return HASH_FIELD(hash, theme->window[active].border_color);
+	case LAB_THEME_ASSET_BUTTONS:
+		/* The button modifiers read these when rendering */
+		hash = HASH_FIELD(hash, theme->window_button_width);
+		hash = HASH_FIELD(hash, theme->window_button_height);
+		hash = HASH_FIELD(hash, theme->window_titlebar_padding_width);
+		hash = HASH_FIELD(hash,
+			theme->window_button_hover_bg_corner_radius);
+		hash = HASH_FIELD(hash, theme->window[active].button_colors);
+		return HASH_FIELD(hash, theme->button_sources_hash);
+	case LAB_THEME_ASSET_SHADOWS:
+		hash = HASH_FIELD(hash, theme->window[active].shadow_size);
+		return HASH_FIELD(hash, theme->window[active].shadow_color);
+	case LAB_THEME_ASSET_ALL:
+		break;
+	}
+	assert(false);
+	return hash;
+}
+
+#undef HASH_FIELD
+
+#define MOVE_ASSET(to, from, field) do { \
+	(to)->field = (from)->field; \
+	(from)->field = NULL; \
+} while (0)
+
+/* Moves one rendered asset group of theme->window[@active] to @to */
+static void
+move_assets(struct theme *to, struct theme *from, int active,
+		enum lab_theme_asset asset)
+{
+	switch (asset) {
+	case LAB_THEME_ASSET_CORNERS:
+		MOVE_ASSET(&to->window[active], &from->window[active],
+			corner_top_left_normal);
+		MOVE_ASSET(&to->window[active], &from->window[active],
+			corner_top_right_normal);
+		break;
+	case LAB_THEME_ASSET_BUTTONS:
+		memcpy(to->window[active].button_imgs,
+			from->window[active].button_imgs,
+			sizeof(to->window[active].button_imgs));
+		memset(from->window[active].button_imgs, 0,
+			sizeof(from->window[active].button_imgs));
+		break;
+	case LAB_THEME_ASSET_SHADOWS:
+		MOVE_ASSET(&to->window[active], &from->window[active],
+			shadow_corner_top);
+		MOVE_ASSET(&to->window[active], &from->window[active],
+			shadow_corner_bottom);
+		MOVE_ASSET(&to->window[active], &from->window[active],
+			shadow_edge);
+		break;
+	case LAB_THEME_ASSET_ALL:
+		assert(false);
+		return;
+	}
+	to->window[active].assets_loaded |= asset;
+	from->window[active].assets_loaded &= ~asset;
+}
+
+#undef MOVE_ASSET
+
+void
+theme_reload(struct theme *theme, struct server *server,
+		const char *theme_name)
+{
+	static const enum lab_theme_asset groups[] = {
+		LAB_THEME_ASSET_CORNERS,
+		LAB_THEME_ASSET_BUTTONS,
+		LAB_THEME_ASSET_SHADOWS,
+	};
+
+	struct theme next = {0};
+	theme_init(&next, server, theme_name);
+
+	for (int active = THEME_INACTIVE; active <= THEME_ACTIVE; active++) {
+		for (size_t i = 0; i < ARRAY_SIZE(groups); i++) {
+			if (!(theme->window[active].assets_loaded & groups[i])) {
+				continue;
+			}
+			if (asset_hash(theme, active, groups[i])
+					== asset_hash(&next, active, groups[i])) {
+				move_assets(&next, theme, active, groups[i]);
+			}
+		}
+	}
+
+	/* Assets which have not been moved are freed with the old theme */
+	theme_finish(theme);
+	*theme = next;
 }
 
 static void destroy_img(struct lab_img **img)
@@ -1556,5 +1712,7 @@ theme_finish(struct theme *theme)
 		zdrop(&theme->window[active].shadow_corner_top);
 		zdrop(&theme->window[active].shadow_corner_bottom);
 		zdrop(&theme->window[active].shadow_edge);
+		theme->window[active].assets_loaded = 0;
 	}
+	theme->loaded = false;
 }
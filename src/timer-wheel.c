@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include "common/macros.h"
+#include "timer-wheel.h"
+
+static uint64_t
+now_msec(void)
+{
+	/* wl_event_loop timers are based on CLOCK_MONOTONIC too */
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void
+program(struct timer_wheel *wheel, uint64_t now)
+{
+	if (wl_list_empty(&wheel->timers)) {
+		/*
+		 * Leave the timerfd armed, a spurious wakeup is cheaper
+		 * than a syscall for every disarm.
+		 */
+		return;
+	}
+	struct lab_timer *first =
+		wl_container_of(wheel->timers.next, first, link);
+	if (wheel->programmed_msec
+			&& wheel->programmed_msec <= first->deadline_msec) {
+		return;
+	}
+	uint64_t delay = first->deadline_msec > now
+		? first->deadline_msec - now : 0;
+	/* A timeout of 0 would disarm the timer */
+	delay = MAX(delay, 1);
+	wl_event_source_timer_update(wheel->source, (int)delay);
+	wheel->programmed_msec = now + delay;
+}
+
+static int
+handle_timer(void *data)
+{
+	struct timer_wheel *wheel = data;
+	wheel->programmed_msec = 0;
+
+	uint64_t now = now_msec();
+	while (!wl_list_empty(&wheel->timers)) {
+		struct lab_timer *timer =
+			wl_container_of(wheel->timers.next, timer, link);
+		if (timer->deadline_msec > now) {
+			break;
+		}
+		lab_timer_disarm(timer);
+		/* May re-arm any timer, including itself */
+		timer->func(timer->data);
+	}
+	program(wheel, now);
+
+	return 0; /* ignored per wl_event_loop docs */
+}
+
+void
+timer_wheel_init(struct timer_wheel *wheel, struct wl_event_loop *loop)
+{
+	wl_list_init(&wheel->timers);
+	wheel->programmed_msec = 0;
+	wheel->source = wl_event_loop_add_timer(loop, handle_timer, wheel);
+}
+
+void
+timer_wheel_finish(struct timer_wheel *wheel)
+{
+	struct lab_timer *timer, *tmp;
+	wl_list_for_each_safe(timer, tmp, &wheel->timers, link) {
+		lab_timer_disarm(timer);
+	}
+	if (wheel->source) {
+		wl_event_source_remove(wheel->source);
+		wheel->source = NULL;
+	}
+}
+
+void
+lab_timer_init(struct lab_timer *timer, lab_timer_func_t func, void *data)
+{
+	wl_list_init(&timer->link);
+	timer->deadline_msec = 0;
+	timer->func = func;
+	timer->data = data;
+	timer->armed = false;
+}
+
+void
+lab_timer_arm(struct timer_wheel *wheel, struct lab_timer *timer,
+		int delay_msec)
+{
+	assert(timer->func);
+	lab_timer_disarm(timer);
+
+	uint64_t now = now_msec();
+	timer->deadline_msec = now + MAX(delay_msec, 1);
+	timer->armed = true;
+
+	/*
+	 * Most timers are armed with one of a few fixed delays, so the new
+	 * deadline usually belongs at or near the end of the list.
+	 */
+	struct lab_timer *pos;
+	wl_list_for_each_reverse(pos, &wheel->timers, link) {
+		if (pos->deadline_msec <= timer->deadline_msec) {
+			break;
+		}
+	}
+	/* If no earlier timer was found, &pos->link is the list head */
+	wl_list_insert(&pos->link, &timer->link);
+
+	program(wheel, now);
+}
+
+void
+lab_timer_disarm(struct lab_timer *timer)
+{
+	if (!timer->armed) {
+		return;
+	}
+	wl_list_remove(&timer->link);
+	wl_list_init(&timer->link);
+	timer->armed = false;
+}
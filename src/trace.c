@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * trace.c: spans written to the ftrace trace_marker file
+ *
+ * Perfetto and systrace parse "B|pid|name" as the start of a span and
+ * "E|pid" as the end of the innermost span of the writing thread.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "trace.h"
+
+static const char *marker_paths[] = {
+	"/sys/kernel/tracing/trace_marker",
+	"/sys/kernel/debug/tracing/trace_marker",
+	NULL,
+};
+
+static int marker_fd = -1;
+static bool marker_opened;
+static int pid;
+
+/* Opened on first use, rcxml_read() runs before the server is set up */
+static bool
+marker_open(void)
+{
+	if (marker_opened) {
+		return marker_fd >= 0;
+	}
+	marker_opened = true;
+	pid = getpid();
+	for (const char **path = marker_paths; *path; path++) {
+		marker_fd = open(*path, O_WRONLY | O_CLOEXEC);
+		if (marker_fd >= 0) {
+			wlr_log(WLR_INFO, "tracing to %s", *path);
+			return true;
+		}
+	}
+	wlr_log(WLR_INFO, "tracing disabled, cannot open trace_marker (%s)",
+		strerror(errno));
+	return false;
+}
+
+static void
+marker_write(const char *buf, int len)
+{
+	if (len <= 0) {
+		return;
+	}
+	/* Spans are best effort, a full trace buffer must not stall us */
+	if (write(marker_fd, buf, (size_t)len) < 0 && errno != EINTR) {
+		wlr_log_errno(WLR_ERROR, "failed to write trace_marker");
+		close(marker_fd);
+		marker_fd = -1;
+	}
+}
+
+void
+trace_begin(const char *name)
+{
+	if (!marker_open()) {
+		return;
+	}
+	char buf[128];
+	int len = snprintf(buf, sizeof(buf), "B|%d|%s", pid, name);
+	marker_write(buf, len < (int)sizeof(buf) ? len : (int)sizeof(buf) - 1);
+}
+
+void
+trace_end(void)
+{
+	if (marker_fd < 0) {
+		return;
+	}
+	char buf[32];
+	int len = snprintf(buf, sizeof(buf), "E|%d", pid);
+	marker_write(buf, len);
+}
+
+void
+trace_finish(void)
+{
+	if (marker_fd >= 0) {
+		close(marker_fd);
+		marker_fd = -1;
+	}
+}
@@ -0,0 +1,205 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * transaction.c: atomic geometry changes of multiple views
+ *
+ * Clients commit their new size at different times after a configure,
+ * so re-arranging many views at once used to show a few frames of
+ * partial layouts. Views resized within one transaction are tracked
+ * until all of them have committed and the affected outputs skip their
+ * repaints meanwhile. Frame events are still sent, since some clients
+ * only draw from their frame callback.
+ *
+ * Within a transaction, the outputs of moved views and the visibility of
+ * the top layers are only recomputed once at the end. Actions on many
+ * views would otherwise walk all outputs and views for each of them.
+ */
+
+#include <assert.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/util/log.h>
+#include "common/list.h"
+#include "labwc.h"
+#include "transaction.h"
+#include "view.h"
+
+static void
+remove_views(struct transaction *transaction)
+{
+	struct view *view, *tmp;
+	wl_list_for_each_safe(view, tmp, &transaction->views, transaction_link) {
+		wl_list_remove(&view->transaction_link);
+		wl_list_init(&view->transaction_link);
+	}
+}
+
+static void
+transaction_done(struct server *server)
+{
+	struct transaction *transaction = &server->transaction;
+	transaction->waiting = false;
+	lab_timer_disarm(&transaction->timeout);
+	remove_views(transaction);
+
+	/* Show the result of the transaction */
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output_is_usable(output)) {
+			wlr_output_schedule_frame(output->wlr_output);
+		}
+	}
+}
+
+static void
+handle_timeout(void *data)
+{
+	struct server *server = data;
+	wlr_log(WLR_INFO, "%d view(s) did not commit in time for the "
+		"configure transaction", wl_list_length(&server->transaction.views));
+	transaction_done(server);
+}
+
+void
+transaction_init(struct server *server)
+{
+	struct transaction *transaction = &server->transaction;
+	*transaction = (struct transaction){0};
+	wl_list_init(&transaction->views);
+	lab_timer_init(&transaction->timeout, handle_timeout, server);
+}
+
+void
+transaction_finish(struct server *server)
+{
+	struct transaction *transaction = &server->transaction;
+	lab_timer_disarm(&transaction->timeout);
+	remove_views(transaction);
+	transaction->outputs_dirty = false;
+	transaction->top_layer_outputs = 0;
+}
+
+/* Called with the transaction still open so top layer updates add up */
+static void
+flush_outputs(struct server *server)
+{
+	struct transaction *transaction = &server->transaction;
+	if (!transaction->outputs_dirty) {
+		return;
+	}
+	transaction->outputs_dirty = false;
+	transaction->flushing = true;
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		if (view->outputs_dirty) {
+			view->outputs_dirty = false;
+			view_update_outputs(view);
+		}
+	}
+	transaction->flushing = false;
+}
+
+void
+transaction_begin(struct server *server)
+{
+	server->transaction.depth++;
+}
+
+void
+transaction_commit(struct server *server)
+{
+	struct transaction *transaction = &server->transaction;
+	assert(transaction->depth > 0);
+	if (transaction->depth == 1) {
+		flush_outputs(server);
+	}
+	if (--transaction->depth > 0) {
+		return;
+	}
+	if (transaction->top_layer_outputs) {
+		uint64_t outputs = transaction->top_layer_outputs;
+		transaction->top_layer_outputs = 0;
+		desktop_update_top_layer_outputs(server, outputs);
+	}
+
+	if (transaction->waiting) {
+		/* Joined the views still pending from an earlier transaction */
+		return;
+	}
+	if (wl_list_length(&transaction->views) < 2) {
+		remove_views(transaction);
+		return;
+	}
+	transaction->waiting = true;
+	lab_timer_arm(&server->seat.timers, &transaction->timeout,
+		CONFIGURE_TIMEOUT_MS);
+}
+
+bool
+transaction_defer_outputs(struct view *view)
+{
+	struct transaction *transaction = &view->server->transaction;
+	if (!transaction->depth || transaction->flushing) {
+		return false;
+	}
+	view->outputs_dirty = true;
+	transaction->outputs_dirty = true;
+	return true;
+}
+
+bool
+transaction_defer_top_layer(struct server *server, uint64_t outputs)
+{
+	struct transaction *transaction = &server->transaction;
+	if (!transaction->depth) {
+		return false;
+	}
+	transaction->top_layer_outputs |= outputs;
+	return true;
+}
+
+void
+transaction_add_view(struct view *view)
+{
+	struct transaction *transaction = &view->server->transaction;
+	if (!transaction->depth || !view->mapped
+			|| !wl_list_empty(&view->transaction_link)) {
+		return;
+	}
+	wl_list_append(&transaction->views, &view->transaction_link);
+}
+
+void
+transaction_view_done(struct view *view)
+{
+	if (wl_list_empty(&view->transaction_link)) {
+		return;
+	}
+	wl_list_remove(&view->transaction_link);
+	wl_list_init(&view->transaction_link);
+
+	struct transaction *transaction = &view->server->transaction;
+	if (transaction->waiting && wl_list_empty(&transaction->views)) {
+		transaction_done(view->server);
+	}
+}
+
+bool
+transaction_blocks_output(struct output *output)
+{
+	struct transaction *transaction = &output->server->transaction;
+	if (!transaction->waiting) {
+		return false;
+	}
+
+	/* Both the old and the new geometry need to change in one frame */
+	struct wlr_output_layout *layout = output->server->output_layout;
+	struct view *view;
+	wl_list_for_each(view, &transaction->views, transaction_link) {
+		if (wlr_output_layout_intersects(layout, output->wlr_output,
+					&view->current)
+				|| wlr_output_layout_intersects(layout,
+					output->wlr_output, &view->pending)) {
+			return true;
+		}
+	}
+	return false;
+}
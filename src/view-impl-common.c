@@ -4,6 +4,7 @@
 #include <strings.h>
 #include "foreign-toplevel.h"
 #include "labwc.h"
+#include "render-scale.h"
 #include "view.h"
 #include "view-impl-common.h"
 #include "window-rules.h"
@@ -11,6 +12,8 @@
 void
 view_impl_map(struct view *view)
 {
+	lab_change_journal_record(&view->server->scene_journal,
+		LAB_SCENE_CHANGE_VIEW_MAPPED);
 	desktop_focus_view(view, /*raise*/ true);
 	view_update_title(view);
 	view_update_app_id(view);
@@ -18,6 +21,13 @@ view_impl_map(struct view *view)
 		window_rules_apply(view, LAB_WINDOW_RULE_EVENT_ON_FIRST_MAP);
 	}
 
+	/*
+	 * Views sent to a hidden workspace, typically by a first-map rule
+	 * when a session is restored, are set up when it is first shown
+	 */
+	view->init_deferred = true;
+	view_finish_deferred_init(view);
+
 	/*
 	 * It's tempting to just never create the foreign-toplevel handle in the
 	 * map handlers, but the app_id/title might not have been set at that
@@ -46,6 +56,11 @@ void
 view_impl_unmap(struct view *view)
 {
 	struct server *server = view->server;
+	lab_change_journal_record(&server->scene_journal,
+		LAB_SCENE_CHANGE_VIEW_UNMAPPED);
+	transaction_view_done(view);
+	view->init_deferred = false;
+	render_scale_finish(view);
 	if (view == server->active_view) {
 		desktop_focus_topmost_view(server);
 	}
@@ -101,6 +116,10 @@ view_impl_apply_geometry(struct view *view, int w, int h)
 	current->width = w;
 	current->height = h;
 
+	if (current->width != old.width || current->height != old.height) {
+		lab_change_journal_record(&view->server->scene_journal,
+			LAB_SCENE_CHANGE_VIEW_RESIZED);
+	}
 	if (!wlr_box_equal(current, &old)) {
 		view_moved(view);
 	}
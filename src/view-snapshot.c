@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <drm_fourcc.h>
+#include <math.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/log.h>
+#include "common/array.h"
+#include "common/macros.h"
+#include "labwc.h"
+#include "view.h"
+#include "view-snapshot.h"
+
+struct render_context {
+	struct server *server;
+	struct wlr_render_pass *pass;
+	/* Position of the view tree, which the iterator includes */
+	int x, y;
+	float scale;
+	/* Textures must stay alive until the pass is submitted */
+	struct wl_array textures; /* struct wlr_texture * */
+};
+
+static void
+render_buffer(struct wlr_scene_buffer *scene_buffer, int sx, int sy,
+		void *data)
+{
+	struct render_context *ctx = data;
+	if (!scene_buffer->buffer) {
+		return;
+	}
+	struct wlr_texture *texture = wlr_texture_from_buffer(
+		ctx->server->renderer, scene_buffer->buffer);
+	if (!texture) {
+		return;
+	}
+	array_add(&ctx->textures, texture);
+
+	int width = scene_buffer->dst_width
+		? scene_buffer->dst_width : scene_buffer->buffer->width;
+	int height = scene_buffer->dst_height
+		? scene_buffer->dst_height : scene_buffer->buffer->height;
+	struct wlr_box dst_box = {
+		.x = lround((sx - ctx->x) * ctx->scale),
+		.y = lround((sy - ctx->y) * ctx->scale),
+		.width = lround(width * ctx->scale),
+		.height = lround(height * ctx->scale),
+	};
+	wlr_render_pass_add_texture(ctx->pass, &(struct wlr_render_texture_options){
+		.texture = texture,
+		.src_box = scene_buffer->src_box,
+		.dst_box = dst_box,
+		.transform = scene_buffer->transform,
+		.alpha = &scene_buffer->opacity,
+		.filter_mode = WLR_SCALE_FILTER_BILINEAR,
+	});
+}
+
+static struct wlr_buffer *
+create_buffer(struct server *server, int width, int height)
+{
+	const struct wlr_drm_format_set *formats =
+		wlr_renderer_get_render_formats(server->renderer);
+	const struct wlr_drm_format *format = formats
+		? wlr_drm_format_set_get(formats, DRM_FORMAT_ARGB8888) : NULL;
+	if (!format) {
+		wlr_log(WLR_ERROR, "no ARGB8888 render format for snapshots");
+		return NULL;
+	}
+	return wlr_allocator_create_buffer(server->allocator, width, height,
+		format);
+}
+
+struct wlr_scene_buffer *
+view_snapshot_create(struct view *view, struct wlr_scene_tree *parent,
+		float scale)
+{
+	assert(view && parent && scale > 0);
+	struct server *server = view->server;
+	int width = lround(view->current.width * scale);
+	int height = lround(view->current.height * scale);
+	if (width <= 0 || height <= 0 || !view->surface) {
+		return NULL;
+	}
+
+	struct wlr_buffer *buffer = create_buffer(server, width, height);
+	if (!buffer) {
+		return NULL;
+	}
+	struct render_context ctx = {
+		.server = server,
+		.pass = wlr_renderer_begin_buffer_pass(server->renderer, buffer,
+			NULL),
+		.x = view->scene_tree->node.x,
+		.y = view->scene_tree->node.y,
+		.scale = scale,
+	};
+	if (!ctx.pass) {
+		wlr_log(WLR_ERROR, "failed to begin snapshot render pass");
+		wlr_buffer_drop(buffer);
+		return NULL;
+	}
+	wl_array_init(&ctx.textures);
+
+	wlr_render_pass_add_rect(ctx.pass, &(struct wlr_render_rect_options){
+		.box = { .width = width, .height = height },
+		.color = { 0, 0, 0, 0 },
+		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+	});
+
+	/* Only enabled nodes are iterated, the tree of a hidden view too */
+	struct wlr_scene_node *node = &view->scene_tree->node;
+	bool enabled = node->enabled;
+	if (!enabled) {
+		wlr_scene_node_set_enabled(node, true);
+	}
+	wlr_scene_node_for_each_buffer(node, render_buffer, &ctx);
+	if (!enabled) {
+		wlr_scene_node_set_enabled(node, false);
+	}
+
+	bool ok = wlr_render_pass_submit(ctx.pass);
+	struct wlr_texture **texture;
+	wl_array_for_each(texture, &ctx.textures) {
+		wlr_texture_destroy(*texture);
+	}
+	wl_array_release(&ctx.textures);
+	if (!ok) {
+		wlr_log(WLR_ERROR, "failed to render snapshot");
+		wlr_buffer_drop(buffer);
+		return NULL;
+	}
+
+	/* The scene buffer holds its own lock on the buffer */
+	struct wlr_scene_buffer *snapshot = wlr_scene_buffer_create(parent,
+		buffer);
+	wlr_buffer_drop(buffer);
+	if (!snapshot) {
+		return NULL;
+	}
+	wlr_scene_buffer_set_dest_size(snapshot, view->current.width,
+		view->current.height);
+	return snapshot;
+}
@@ -1,10 +1,16 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
+#include <glib.h>
+#include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <strings.h>
+#include <unistd.h>
 #include <wlr/types/wlr_output_layout.h>
-#include <wlr/types/wlr_security_context_v1.h>
 #include "common/box.h"
+#include "common/intern.h"
 #include "common/list.h"
 #include "common/macros.h"
 #include "common/match.h"
@@ -15,11 +21,15 @@
 #include "input/keyboard.h"
 #include "labwc.h"
 #include "osd.h"
+#include "overview.h"
 #include "output-state.h"
 #include "placement.h"
 #include "regions.h"
+#include "render-scale.h"
+#include "sandbox.h"
 #include "snap-constraints.h"
 #include "ssd.h"
+#include "trace.h"
 #include "view.h"
 #include "window-rules.h"
 #include "wlr/util/log.h"
@@ -30,6 +40,10 @@
 #include <wlr/xwayland.h>
 #endif
 
+/* View scans should not need more than two cache lines per view */
+static_assert(offsetof(struct view, outputs_dirty) < 128,
+	"hot fields of struct view exceed two cache lines");
+
 struct view *
 view_from_wlr_surface(struct wlr_surface *surface)
 {
@@ -54,13 +68,12 @@ view_from_wlr_surface(struct wlr_surface *surface)
 	return NULL;
 }
 
-static const struct wlr_security_context_v1_state *
-security_context_from_view(struct view *view)
+static const struct sandbox_info *
+sandbox_info_from_view(struct view *view)
 {
 	if (view && view->surface && view->surface->resource) {
 		struct wl_client *client = wl_resource_get_client(view->surface->resource);
-		return wlr_security_context_manager_v1_lookup_client(
-			view->server->security_context_manager_v1, client);
+		return sandbox_info_from_client(view->server, client);
 	}
 	return NULL;
 }
@@ -85,6 +98,8 @@ view_query_free(struct view_query *query)
 	zfree(query->tiled_region);
 	zfree(query->desktop);
 	zfree(query->monitor);
+	lab_intern_release(query->identifier_key);
+	workspace_ref_finish(&query->desktop_ref);
 	zfree(query);
 }
 
@@ -101,116 +116,168 @@ query_tristate_match(enum three_state desired, bool actual)
 	}
 }
 
+void
+view_query_compile(struct view_query *query)
+{
+	match_glob_compile(&query->identifier_glob, query->identifier);
+	match_glob_compile(&query->title_glob, query->title);
+	match_glob_compile(&query->sandbox_engine_glob, query->sandbox_engine);
+	match_glob_compile(&query->sandbox_app_id_glob, query->sandbox_app_id);
+	match_glob_compile(&query->tiled_region_glob, query->tiled_region);
+
+	lab_intern_release(query->identifier_key);
+	query->identifier_key = NULL;
+	if (query->identifier_glob.type == LAB_MATCH_GLOB_LITERAL) {
+		char *key = g_ascii_strdown(query->identifier, -1);
+		query->identifier_key = lab_intern(key);
+		g_free(key);
+	}
+
+	workspace_ref_finish(&query->desktop_ref);
+	query->desktop_other = false;
+	if (query->desktop) {
+		if (!strcasecmp(query->desktop, "other")) {
+			query->desktop_other = true;
+		} else {
+			workspace_ref_parse(&query->desktop_ref, query->desktop);
+		}
+	}
+
+	query->monitor_type = LAB_QUERY_MONITOR_ANY;
+	if (!query->monitor) {
+		/* Any monitor */
+	} else if (!strcasecmp(query->monitor, "current")) {
+		query->monitor_type = LAB_QUERY_MONITOR_CURRENT;
+	} else if (!strcasecmp(query->monitor, "left")) {
+		query->monitor_type = LAB_QUERY_MONITOR_LEFT;
+	} else if (!strcasecmp(query->monitor, "right")) {
+		query->monitor_type = LAB_QUERY_MONITOR_RIGHT;
+	} else {
+		query->monitor_type = LAB_QUERY_MONITOR_NAME;
+	}
+	query->compiled = true;
+}
+
 static bool
-query_str_match(const char *condition, const char *value)
+query_matches_desktop(struct view *view, struct view_query *query)
 {
-	if (!condition) {
-		return true;
+	struct workspace *current = view->server->workspaces.current;
+	if (query->desktop_other) {
+		/* "other" means the view is NOT on the current desktop */
+		return view->workspace != current;
 	}
-	return value && match_glob(condition, value);
+	// TODO: perhaps wrap "left" and "right" workspaces
+	struct workspace *target = workspaces_find_ref(current,
+		&query->desktop_ref, /* wrap */ false);
+	return target && view->workspace == target;
+}
+
+static bool
+query_matches_monitor(struct view *view, struct view_query *query)
+{
+	struct output *current = output_nearest_to_cursor(view->server);
+	switch (query->monitor_type) {
+	case LAB_QUERY_MONITOR_CURRENT:
+		return current == view->output;
+	case LAB_QUERY_MONITOR_LEFT:
+		return output_get_adjacent(current, VIEW_EDGE_LEFT, false)
+			== view->output;
+	case LAB_QUERY_MONITOR_RIGHT:
+		return output_get_adjacent(current, VIEW_EDGE_RIGHT, false)
+			== view->output;
+	case LAB_QUERY_MONITOR_NAME:
+		return output_from_name(view->server, query->monitor)
+			== view->output;
+	case LAB_QUERY_MONITOR_ANY:
+		break;
+	}
+	return true;
 }
 
+/*
+ * The criteria are checked from the cheapest to the most expensive: view
+ * state first, then desktop and monitor, then string patterns, and the
+ * window type and security context which need calls into the shell or
+ * the protocol last.
+ */
 bool
 view_matches_query(struct view *view, struct view_query *query)
 {
-	if (!query_str_match(query->identifier, view_get_string_prop(view, "app_id"))) {
-		return false;
+	if (!query->compiled) {
+		view_query_compile(query);
 	}
 
-	if (!query_str_match(query->title, view_get_string_prop(view, "title"))) {
+	if (!query_tristate_match(query->shaded, view->shaded)) {
 		return false;
 	}
 
-	if (query->window_type >= 0 && !view_contains_window_type(view, query->window_type)) {
+	if (query->maximized != VIEW_AXIS_INVALID && view->maximized != query->maximized) {
 		return false;
 	}
 
-	if (query->sandbox_engine || query->sandbox_app_id) {
-		const struct wlr_security_context_v1_state *ctx =
-			security_context_from_view(view);
-
-		if (!ctx) {
-			return false;
-		}
+	if (!query_tristate_match(query->iconified, view->minimized)) {
+		return false;
+	}
 
-		if (!query_str_match(query->sandbox_engine, ctx->sandbox_engine)) {
-			return false;
-		}
+	if (!query_tristate_match(query->focused, view->server->active_view == view)) {
+		return false;
+	}
 
-		if (!query_str_match(query->sandbox_app_id, ctx->app_id)) {
-			return false;
-		}
+	if (!query_tristate_match(query->omnipresent, view->visible_on_all_workspaces)) {
+		return false;
 	}
 
-	if (!query_tristate_match(query->shaded, view->shaded)) {
+	if (query->tiled != VIEW_EDGE_INVALID && query->tiled != view->tiled) {
 		return false;
 	}
 
-	if (query->maximized != VIEW_AXIS_INVALID && view->maximized != query->maximized) {
+	if (query->decoration != LAB_SSD_MODE_INVALID
+			&& query->decoration != view_get_ssd_mode(view)) {
 		return false;
 	}
 
-	if (!query_tristate_match(query->iconified, view->minimized)) {
+	if (query->desktop && !query_matches_desktop(view, query)) {
 		return false;
 	}
 
-	if (!query_tristate_match(query->focused, view->server->active_view == view)) {
+	if (!query_matches_monitor(view, query)) {
 		return false;
 	}
 
-	if (!query_tristate_match(query->omnipresent, view->visible_on_all_workspaces)) {
+	if (!match_glob_compiled(&query->identifier_glob,
+			view_get_string_prop(view, "app_id"))) {
 		return false;
 	}
 
-	if (query->tiled != VIEW_EDGE_INVALID && query->tiled != view->tiled) {
+	if (!match_glob_compiled(&query->title_glob,
+			view_get_string_prop(view, "title"))) {
 		return false;
 	}
 
 	const char *tiled_region =
 		view->tiled_region ? view->tiled_region->name : NULL;
-	if (!query_str_match(query->tiled_region, tiled_region)) {
+	if (!match_glob_compiled(&query->tiled_region_glob, tiled_region)) {
 		return false;
 	}
 
-	if (query->desktop) {
-		const char *view_workspace = view->workspace->name;
-		struct workspace *current = view->server->workspaces.current;
-
-		if (!strcasecmp(query->desktop, "other")) {
-			/* "other" means the view is NOT on the current desktop */
-			if (!strcasecmp(view_workspace, current->name)) {
-				return false;
-			}
-		} else {
-			// TODO: perhaps wrap "left" and "right" workspaces
-			struct workspace *target =
-				workspaces_find(current, query->desktop, /* wrap */ false);
-			if (!target || strcasecmp(view_workspace, target->name)) {
-				return false;
-			}
-		}
-	}
-
-	enum ssd_mode decor = view_get_ssd_mode(view);
-	if (query->decoration != LAB_SSD_MODE_INVALID && query->decoration != decor) {
+	if (query->window_type >= 0 && !view_contains_window_type(view, query->window_type)) {
 		return false;
 	}
 
-	if (query->monitor) {
-		struct output *current = output_nearest_to_cursor(view->server);
+	if (query->sandbox_engine || query->sandbox_app_id) {
+		const struct sandbox_info *sandbox = sandbox_info_from_view(view);
 
-		if (!strcasecmp(query->monitor, "current") && current != view->output) {
-			return false;
-		}
-		if (!strcasecmp(query->monitor, "left") &&
-			output_get_adjacent(current, VIEW_EDGE_LEFT, false) != view->output) {
+		if (!sandbox || !sandbox->sandboxed) {
 			return false;
 		}
-		if (!strcasecmp(query->monitor, "right") &&
-			output_get_adjacent(current, VIEW_EDGE_RIGHT, false) != view->output) {
+
+		if (!match_glob_compiled(&query->sandbox_engine_glob,
+				sandbox->engine)) {
 			return false;
 		}
-		if (output_from_name(view->server, query->monitor) != view->output) {
+
+		if (!match_glob_compiled(&query->sandbox_app_id_glob,
+				sandbox->app_id)) {
 			return false;
 		}
 	}
@@ -226,11 +293,14 @@ matches_criteria(struct view *view, enum lab_view_criteria criteria)
 	}
 	if (criteria & LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
 		/*
-		 * Always-on-top views are always on the current desktop and are
-		 * special in that they live in a different tree.
+		 * Omnipresent and always-on-top views are always on the
+		 * current desktop and are special in that they live in
+		 * different trees.
 		 */
 		struct server *server = view->server;
-		if (view->scene_tree->node.parent != server->workspaces.current->tree
+		struct wlr_scene_tree *parent = view->scene_tree->node.parent;
+		if (parent != server->workspaces.current->tree
+				&& parent != server->view_tree_omnipresent
 				&& !view_is_always_on_top(view)) {
 			return false;
 		}
@@ -263,11 +333,192 @@ matches_criteria(struct view *view, enum lab_view_criteria criteria)
 	return true;
 }
 
+static struct wl_list *
+stack_bucket_of(struct view *view)
+{
+	struct wlr_scene_tree *parent = view->scene_tree->node.parent;
+	if (parent == view->server->view_tree_always_on_top) {
+		return &view->server->views_always_on_top;
+	}
+	if (parent == view->server->view_tree_omnipresent) {
+		return &view->server->views_omnipresent;
+	}
+	if (view->workspace && parent == view->workspace->tree) {
+		return &view->workspace->views;
+	}
+	/* Always-on-bottom views are not indexed */
+	return NULL;
+}
+
+/* Insert @view into @bucket, which is sorted by decreasing stack_order */
+static void
+stack_bucket_insert(struct wl_list *bucket, struct view *view)
+{
+	if (wl_list_empty(bucket)) {
+		wl_list_insert(bucket, &view->stack_link);
+		return;
+	}
+
+	/* Views are mostly raised or lowered, so check both ends first */
+	struct view *first = wl_container_of(bucket->next, first, stack_link);
+	struct view *last = wl_container_of(bucket->prev, last, stack_link);
+	if (first->stack_order < view->stack_order) {
+		wl_list_insert(bucket, &view->stack_link);
+		return;
+	}
+	if (last->stack_order > view->stack_order) {
+		wl_list_append(bucket, &view->stack_link);
+		return;
+	}
+
+	struct view *pos;
+	wl_list_for_each(pos, bucket, stack_link) {
+		if (pos->stack_order < view->stack_order) {
+			break;
+		}
+	}
+	/* Insert in front of pos */
+	wl_list_insert(pos->stack_link.prev, &view->stack_link);
+}
+
+static void
+view_stack_update(struct view *view)
+{
+	struct wl_list *bucket = stack_bucket_of(view);
+	if (bucket == view->stack_bucket) {
+		return;
+	}
+	wl_list_remove(&view->stack_link);
+	wl_list_init(&view->stack_link);
+	view->stack_bucket = bucket;
+	if (bucket) {
+		stack_bucket_insert(bucket, view);
+	}
+}
+
+static void
+view_stack_reinsert(struct view *view)
+{
+	wl_list_remove(&view->stack_link);
+	wl_list_init(&view->stack_link);
+	view->stack_bucket = NULL;
+	view_stack_update(view);
+}
+
+void
+view_stack_add(struct view *view)
+{
+	struct server *server = view->server;
+	view->stack_order = ++server->view_stack_top;
+	wl_list_insert(&server->views, &view->link);
+	wl_list_init(&view->stack_link);
+	/* matchOnce rules of other views may no longer match */
+	window_rules_invalidate(view);
+	view->stack_bucket = NULL;
+	view_stack_update(view);
+}
+
+void
+view_stack_detach_all(struct wl_list *bucket)
+{
+	struct view *view, *tmp;
+	wl_list_for_each_safe(view, tmp, bucket, stack_link) {
+		wl_list_remove(&view->stack_link);
+		wl_list_init(&view->stack_link);
+		view->stack_bucket = NULL;
+	}
+}
+
+/*
+ * Adjacent view in @bucket below (@forward) or above @from in stacking
+ * order, where @from may be NULL to start at the top or bottom.
+ */
+static struct view *
+stack_bucket_step(struct wl_list *bucket, struct view *from, bool forward)
+{
+	struct wl_list *elm;
+	if (from && from->stack_bucket == bucket) {
+		elm = forward ? from->stack_link.next : from->stack_link.prev;
+		return elm == bucket
+			? NULL : wl_container_of(elm, from, stack_link);
+	}
+
+	struct view *view;
+	if (forward) {
+		wl_list_for_each(view, bucket, stack_link) {
+			if (!from || view->stack_order < from->stack_order) {
+				return view;
+			}
+		}
+	} else {
+		wl_list_for_each_reverse(view, bucket, stack_link) {
+			if (!from || view->stack_order > from->stack_order) {
+				return view;
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Views on the current workspace are the ones in the current workspace
+ * tree plus all omnipresent and always-on-top views. Iterate over the
+ * index lists of those trees, merged by stacking order, so that views on
+ * other workspaces are never visited.
+ */
+static struct view *
+view_step_indexed(struct server *server, struct view *view,
+		enum lab_view_criteria criteria, bool forward)
+{
+	struct wl_list *buckets[3] = { &server->views_always_on_top, NULL, NULL };
+	if (!(criteria & LAB_VIEW_CRITERIA_ALWAYS_ON_TOP)) {
+		buckets[1] = &server->views_omnipresent;
+		buckets[2] = &server->workspaces.current->views;
+		if (criteria & LAB_VIEW_CRITERIA_NO_ALWAYS_ON_TOP) {
+			buckets[0] = NULL;
+		}
+	}
+
+	for (;;) {
+		struct view *best = NULL;
+		for (size_t i = 0; i < ARRAY_SIZE(buckets); i++) {
+			if (!buckets[i]) {
+				continue;
+			}
+			struct view *next =
+				stack_bucket_step(buckets[i], view, forward);
+			if (next && (!best || (forward
+					? next->stack_order > best->stack_order
+					: next->stack_order < best->stack_order))) {
+				best = next;
+			}
+		}
+		if (!best || matches_criteria(best, criteria)) {
+			return best;
+		}
+		view = best;
+	}
+}
+
+static bool
+criteria_use_index(enum lab_view_criteria criteria)
+{
+	return criteria & (LAB_VIEW_CRITERIA_CURRENT_WORKSPACE
+		| LAB_VIEW_CRITERIA_ALWAYS_ON_TOP);
+}
+
 struct view *
 view_next(struct wl_list *head, struct view *view, enum lab_view_criteria criteria)
 {
 	assert(head);
 
+	if (criteria_use_index(criteria)) {
+		/* All callers iterate over server->views */
+		struct server *server = wl_container_of(head, server, views);
+		return view_step_indexed(server, view, criteria,
+			/* forward */ true);
+	}
+
 	struct wl_list *elm = view ? &view->link : head;
 
 	for (elm = elm->next; elm != head; elm = elm->next) {
@@ -284,6 +535,12 @@ view_prev(struct wl_list *head, struct view *view, enum lab_view_criteria criter
 {
 	assert(head);
 
+	if (criteria_use_index(criteria)) {
+		struct server *server = wl_container_of(head, server, views);
+		return view_step_indexed(server, view, criteria,
+			/* forward */ false);
+	}
+
 	struct wl_list *elm = view ? &view->link : head;
 
 	for (elm = elm->prev; elm != head; elm = elm->prev) {
@@ -301,19 +558,12 @@ view_next_no_head_stop(struct wl_list *head, struct view *from,
 {
 	assert(head);
 
-	struct wl_list *elm = from ? &from->link : head;
-
-	struct wl_list *end = elm;
-	for (elm = elm->next; elm != end; elm = elm->next) {
-		if (elm == head) {
-			continue;
-		}
-		struct view *view = wl_container_of(elm, view, link);
-		if (matches_criteria(view, criteria)) {
-			return view;
-		}
+	struct view *view = view_next(head, from, criteria);
+	if (!view) {
+		/* Wrap around */
+		view = view_next(head, NULL, criteria);
 	}
-	return from;
+	return view ? view : from;
 }
 
 struct view *
@@ -322,19 +572,12 @@ view_prev_no_head_stop(struct wl_list *head, struct view *from,
 {
 	assert(head);
 
-	struct wl_list *elm = from ? &from->link : head;
-
-	struct wl_list *end = elm;
-	for (elm = elm->prev; elm != end; elm = elm->prev) {
-		if (elm == head) {
-			continue;
-		}
-		struct view *view = wl_container_of(elm, view, link);
-		if (matches_criteria(view, criteria)) {
-			return view;
-		}
+	struct view *view = view_prev(head, from, criteria);
+	if (!view) {
+		/* Wrap around */
+		view = view_prev(head, NULL, criteria);
 	}
-	return from;
+	return view ? view : from;
 }
 
 void
@@ -352,6 +595,127 @@ view_array_append(struct server *server, struct wl_array *views,
 	}
 }
 
+/*
+ * Views by interned lower-cased app_id, value is a GPtrArray of struct
+ * view. The keys are compared by pointer and their hashes are cached.
+ */
+static GHashTable *views_by_app_id;
+
+static guint
+hash_atom(gconstpointer atom)
+{
+	return lab_intern_hash(atom);
+}
+
+static void
+app_id_index_remove(struct view *view)
+{
+	if (!view->app_id_key) {
+		return;
+	}
+	GPtrArray *views = g_hash_table_lookup(views_by_app_id,
+		view->app_id_key);
+	if (views) {
+		g_ptr_array_remove_fast(views, view);
+		if (!views->len) {
+			g_hash_table_remove(views_by_app_id, view->app_id_key);
+		}
+	}
+	lab_intern_release(view->app_id_key);
+	view->app_id_key = NULL;
+}
+
+static void
+app_id_index_update(struct view *view)
+{
+	char *lower = g_ascii_strdown(view_get_string_prop(view, "app_id"), -1);
+	const char *key = lab_intern(lower);
+	g_free(lower);
+	if (key == view->app_id_key) {
+		lab_intern_release(key);
+		return;
+	}
+	app_id_index_remove(view);
+
+	if (!views_by_app_id) {
+		views_by_app_id = g_hash_table_new_full(hash_atom,
+			g_direct_equal, NULL, (GDestroyNotify)g_ptr_array_unref);
+	}
+	/* The key is kept alive by the references of the views */
+	GPtrArray *views = g_hash_table_lookup(views_by_app_id, key);
+	if (!views) {
+		views = g_ptr_array_new();
+		g_hash_table_insert(views_by_app_id, (gpointer)key, views);
+	}
+	g_ptr_array_add(views, view);
+	view->app_id_key = key;
+}
+
+static int
+compare_stack_order(const void *a, const void *b)
+{
+	const struct view *x = *(const struct view * const *)a;
+	const struct view *y = *(const struct view * const *)b;
+	/* Topmost first, like server->views */
+	return (y->stack_order > x->stack_order)
+		- (y->stack_order < x->stack_order);
+}
+
+bool
+view_array_append_by_identifier(struct server *server, struct wl_array *views,
+		struct wl_list *queries)
+{
+	struct view_query *query;
+	wl_list_for_each(query, queries, link) {
+		if (!query->compiled) {
+			view_query_compile(query);
+		}
+		if (!query->identifier_key) {
+			return false;
+		}
+	}
+	if (!views_by_app_id) {
+		return true;
+	}
+
+	size_t first = views->size / sizeof(struct view *);
+	wl_list_for_each(query, queries, link) {
+		/* Several queries for the same identifier add the views once */
+		bool seen = false;
+		struct view_query *other;
+		wl_list_for_each(other, queries, link) {
+			if (other == query) {
+				break;
+			}
+			if (other->identifier_key == query->identifier_key) {
+				seen = true;
+				break;
+			}
+		}
+		GPtrArray *matches = seen ? NULL : g_hash_table_lookup(
+			views_by_app_id, query->identifier_key);
+		for (guint i = 0; matches && i < matches->len; i++) {
+			struct view *view = g_ptr_array_index(matches, i);
+			if (!matches_criteria(view, LAB_VIEW_CRITERIA_NONE)) {
+				continue;
+			}
+			struct view **entry = wl_array_add(views, sizeof(*entry));
+			if (!entry) {
+				wlr_log(WLR_ERROR, "wl_array_add(): out of memory");
+				continue;
+			}
+			*entry = view;
+		}
+	}
+
+	size_t count = views->size / sizeof(struct view *) - first;
+	if (count > 1) {
+		qsort((struct view **)views->data + first, count,
+			sizeof(struct view *), compare_stack_order);
+	}
+	return true;
+}
+
 enum view_wants_focus
 view_wants_focus(struct view *view)
 {
@@ -424,42 +788,43 @@ static struct wlr_box
 view_get_edge_snap_box(struct view *view, struct output *output,
 		enum view_edge edge)
 {
-	struct wlr_box usable = output_usable_area_in_layout_coords(output);
-	int x_offset = edge == VIEW_EDGE_RIGHT
-		? (usable.width + rc.gap) / 2 : rc.gap;
-	int y_offset = edge == VIEW_EDGE_DOWN
-		? (usable.height + rc.gap) / 2 : rc.gap;
-
-	int base_width, base_height;
-	switch (edge) {
-	case VIEW_EDGE_LEFT:
-	case VIEW_EDGE_RIGHT:
-		base_width = (usable.width - 3 * rc.gap) / 2;
-		base_height = usable.height - 2 * rc.gap;
-		break;
-	case VIEW_EDGE_UP:
-	case VIEW_EDGE_DOWN:
-		base_width = usable.width - 2 * rc.gap;
-		base_height = (usable.height - 3 * rc.gap) / 2;
-		break;
-	default:
-	case VIEW_EDGE_CENTER:
-		base_width = usable.width - 2 * rc.gap;
-		base_height = usable.height - 2 * rc.gap;
-		break;
-	}
-
+	struct wlr_box box = output_get_edge_box(output, edge,
+		/* with_gaps */ true);
 	struct border margin = ssd_get_margin(view->ssd);
 	struct wlr_box dst = {
-		.x = x_offset + usable.x + margin.left,
-		.y = y_offset + usable.y + margin.top,
-		.width = base_width - margin.left - margin.right,
-		.height = base_height - margin.top - margin.bottom,
+		.x = box.x + margin.left,
+		.y = box.y + margin.top,
+		.width = box.width - margin.left - margin.right,
+		.height = box.height - margin.top - margin.bottom,
 	};
 
 	return dst;
 }
 
+/*
+ * Sets view->output and view->fullscreen, keeping the number of
+ * fullscreen views per output up to date
+ */
+static void
+set_output_state(struct view *view, struct output *output, bool fullscreen)
+{
+	if (view->fullscreen && view->output) {
+		view->output->nr_fullscreen_views--;
+	}
+	view->output = output;
+	view->fullscreen = fullscreen;
+	if (fullscreen && output) {
+		output->nr_fullscreen_views++;
+	}
+}
+
+/* Outputs whose top layer visibility may depend on @view */
+static uint64_t
+top_layer_outputs(struct view *view)
+{
+	return view->outputs | output_get_mask(view->output);
+}
+
 static bool
 view_discover_output(struct view *view, struct wlr_box *geometry)
 {
@@ -475,10 +840,12 @@ view_discover_output(struct view *view, struct wlr_box *geometry)
 			geometry->y + geometry->height / 2);
 
 	if (output && output != view->output) {
-		view->output = output;
+		uint64_t old_outputs = top_layer_outputs(view);
+		set_output_state(view, output, view->fullscreen);
 		/* Show fullscreen views above top-layer */
 		if (view->fullscreen) {
-			desktop_update_top_layer_visibility(view->server);
+			desktop_update_top_layer_outputs(view->server,
+				old_outputs | top_layer_outputs(view));
 		}
 		return true;
 	}
@@ -512,13 +879,23 @@ view_set_activated(struct view *view, bool activated)
 	wl_signal_emit_mutable(&view->events.activated, &activated);
 
 	if (rc.kb_layout_per_window) {
+		struct seat *seat = &view->server->seat;
 		if (!activated) {
 			/* Store configured keyboard layout per view */
 			view->keyboard_layout =
-				view->server->seat.keyboard_group->keyboard.modifiers.group;
+				seat->keyboard_group->keyboard.modifiers.group;
+			view->keyboard_layout_generation =
+				seat->keyboard_layout_generation;
 		} else {
+			/* Layouts stored before a keymap change are reset */
+			if (view->keyboard_layout_generation
+					!= seat->keyboard_layout_generation) {
+				view->keyboard_layout = 0;
+				view->keyboard_layout_generation =
+					seat->keyboard_layout_generation;
+			}
 			/* Switch to previously stored keyboard layout */
-			keyboard_update_layout(&view->server->seat, view->keyboard_layout);
+			keyboard_update_layout(seat, view->keyboard_layout);
 		}
 	}
 	set_adaptive_sync_fullscreen(view);
@@ -532,10 +909,13 @@ view_set_output(struct view *view, struct output *output)
 		wlr_log(WLR_ERROR, "invalid output set for view");
 		return;
 	}
-	view->output = output;
+	uint64_t old_outputs = top_layer_outputs(view);
+	set_output_state(view, output, view->fullscreen);
+	osd_field_invalidate(view);
 	/* Show fullscreen views above top-layer */
 	if (view->fullscreen) {
-		desktop_update_top_layer_visibility(view->server);
+		desktop_update_top_layer_outputs(view->server,
+			old_outputs | top_layer_outputs(view));
 	}
 }
 
@@ -548,25 +928,148 @@ view_close(struct view *view)
 	}
 }
 
+void
+view_kill(struct view *view)
+{
+	assert(view);
+	assert(view->impl->get_pid);
+	pid_t pid = view->impl->get_pid(view);
+	if (pid == getpid()) {
+		wlr_log(WLR_ERROR, "Preventing sending SIGTERM to labwc");
+	} else if (pid > 0) {
+		kill(pid, SIGTERM);
+	}
+}
+
+/* Time after which views of a batch not killed are given up on */
+#define CLOSE_BATCH_TIMEOUT_MS 3000
+
+struct view_close_batch {
+	struct server *server;
+	int remaining;
+	bool kill;
+	struct lab_timer timer;
+	view_close_done_func_t done;
+	void *data;
+};
+
 static void
-view_update_outputs(struct view *view)
+close_batch_finish(struct view_close_batch *batch)
+{
+	lab_timer_disarm(&batch->timer);
+	if (batch->done) {
+		batch->done(batch->data);
+	}
+	free(batch);
+}
+
+/*
+ * Views which are still around, for example asking whether to save
+ * changes, become regular views again
+ */
+static void
+handle_close_batch_timeout(void *data)
+{
+	struct view_close_batch *batch = data;
+	struct server *server = batch->server;
+	if (batch->kill) {
+		wlr_log(WLR_INFO, "killing %d view(s) which did not close "
+			"in time", batch->remaining);
+	}
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		if (view->close_batch == batch) {
+			if (batch->kill) {
+				view_kill(view);
+			}
+			view->close_batch = NULL;
+		}
+	}
+	close_batch_finish(batch);
+	if (!server->active_view) {
+		desktop_focus_topmost_view(server);
+	}
+}
+
+static void
+close_batch_remove_view(struct view *view)
 {
-	struct output *output;
-	struct wlr_output_layout *layout = view->server->output_layout;
+	struct view_close_batch *batch = view->close_batch;
+	if (!batch) {
+		return;
+	}
+	view->close_batch = NULL;
+	if (--batch->remaining == 0) {
+		close_batch_finish(batch);
+	}
+}
 
-	uint64_t new_outputs = 0;
-	wl_list_for_each(output, &view->server->outputs, link) {
-		if (output_is_usable(output) && wlr_output_layout_intersects(
-				layout, output->wlr_output, &view->current)) {
-			new_outputs |= (1ull << output->scene_output->WLR_PRIVATE.index);
+void
+view_close_many(struct server *server, struct wl_array *views,
+		int kill_timeout_msec, view_close_done_func_t done, void *data)
+{
+	struct view_close_batch *batch = znew(*batch);
+	batch->server = server;
+	batch->done = done;
+	batch->data = data;
+	batch->kill = kill_timeout_msec > 0;
+	lab_timer_init(&batch->timer, handle_close_batch_timeout, batch);
+
+	struct view **view;
+	wl_array_for_each(view, views) {
+		/* Already closing as part of another batch */
+		if ((*view)->close_batch) {
+			continue;
 		}
+		(*view)->close_batch = batch;
+		batch->remaining++;
 	}
+	if (!batch->remaining) {
+		if (done) {
+			done(data);
+		}
+		free(batch);
+		return;
+	}
+
+	/*
+	 * Move focus away once, instead of to each closing view in turn
+	 * as the views above it go away
+	 */
+	if (server->active_view && server->active_view->close_batch == batch) {
+		desktop_focus_topmost_view(server);
+	}
+
+	lab_timer_arm(&server->seat.timers, &batch->timer,
+		batch->kill ? kill_timeout_msec : CLOSE_BATCH_TIMEOUT_MS);
+
+	/* Clients respond asynchronously, so the batch stays valid here */
+	wl_array_for_each(view, views) {
+		view_close(*view);
+	}
+}
 
-	if (new_outputs != view->outputs) {
-		view->outputs = new_outputs;
-		wl_signal_emit_mutable(&view->events.new_outputs, NULL);
-		desktop_update_top_layer_visibility(view->server);
+void
+view_update_outputs(struct view *view)
+{
+	if (transaction_defer_outputs(view)) {
+		return;
+	}
+
+	uint64_t new_outputs = output_mask_from_box(view->server, &view->current);
+	if (new_outputs == view->outputs) {
+		return;
+	}
+
+	uint64_t changed = new_outputs ^ view->outputs;
+	view->outputs = new_outputs;
+	wl_signal_emit_mutable(&view->events.new_outputs, NULL);
+
+	/* A fullscreen view may also have left all outputs */
+	if (view->fullscreen) {
+		changed |= output_get_mask(view->output);
 	}
+	desktop_update_top_layer_outputs(view->server, changed);
 }
 
 bool
@@ -593,12 +1096,15 @@ void
 view_moved(struct view *view)
 {
 	assert(view);
+	lab_change_journal_record(&view->server->scene_journal,
+		LAB_SCENE_CHANGE_VIEW_MOVED);
 	view_set_fullscreen(view, true);
 }
 
 void
 view_move_resize(struct view *view, struct wlr_box geo)
 {
+	TRACE_FUNC();
 	assert(view);
 	if (view->impl->configure) {
 		view->impl->configure(view, geo);
@@ -706,6 +1212,7 @@ _minimize(struct view *view, bool minimized)
 	}
 
 	view->minimized = minimized;
+	osd_field_invalidate(view);
 	wl_signal_emit_mutable(&view->events.minimized, NULL);
 
 	if (minimized) {
@@ -757,7 +1264,8 @@ view_minimize(struct view *view, bool minimized)
 
 	/* Enable top-layer when full-screen views are minimized */
 	if (view->fullscreen && view->output) {
-		desktop_update_top_layer_visibility(view->server);
+		desktop_update_top_layer_outputs(view->server,
+			top_layer_outputs(view));
 	}
 }
 
@@ -1174,6 +1682,7 @@ set_maximized(struct view *view, enum view_axis maximized)
 	}
 
 	view->maximized = maximized;
+	osd_field_invalidate(view);
 	wl_signal_emit_mutable(&view->events.maximized, NULL);
 
 	/*
@@ -1271,18 +1780,30 @@ view_is_always_on_top(struct view *view)
 		view->server->view_tree_always_on_top;
 }
 
+/* Tree of a view which is neither always-on-top nor always-on-bottom */
+static struct wlr_scene_tree *
+view_workspace_tree(struct view *view)
+{
+	if (view->visible_on_all_workspaces) {
+		return view->server->view_tree_omnipresent;
+	}
+	return view->workspace->tree;
+}
+
 void
 view_toggle_always_on_top(struct view *view)
 {
 	assert(view);
 	if (view_is_always_on_top(view)) {
 		view->workspace = view->server->workspaces.current;
+		osd_field_invalidate(view);
 		wlr_scene_node_reparent(&view->scene_tree->node,
-			view->workspace->tree);
+			view_workspace_tree(view));
 	} else {
 		wlr_scene_node_reparent(&view->scene_tree->node,
 			view->server->view_tree_always_on_top);
 	}
+	view_stack_update(view);
 }
 
 bool
@@ -1299,12 +1820,14 @@ view_toggle_always_on_bottom(struct view *view)
 	assert(view);
 	if (view_is_always_on_bottom(view)) {
 		view->workspace = view->server->workspaces.current;
+		osd_field_invalidate(view);
 		wlr_scene_node_reparent(&view->scene_tree->node,
-			view->workspace->tree);
+			view_workspace_tree(view));
 	} else {
 		wlr_scene_node_reparent(&view->scene_tree->node,
 			view->server->view_tree_always_on_bottom);
 	}
+	view_stack_update(view);
 }
 
 void
@@ -1312,6 +1835,14 @@ view_toggle_visible_on_all_workspaces(struct view *view)
 {
 	assert(view);
 	view->visible_on_all_workspaces = !view->visible_on_all_workspaces;
+	if (view_is_always_on_top(view) || view_is_always_on_bottom(view)) {
+		return;
+	}
+	view->workspace = view->server->workspaces.current;
+	osd_field_invalidate(view);
+	wlr_scene_node_reparent(&view->scene_tree->node,
+		view_workspace_tree(view));
+	view_stack_update(view);
 }
 
 void
@@ -1319,13 +1850,58 @@ view_move_to_workspace(struct view *view, struct workspace *workspace)
 {
 	assert(view);
 	assert(workspace);
-	if (view->workspace != workspace) {
-		view->workspace = workspace;
-		wlr_scene_node_reparent(&view->scene_tree->node,
-			workspace->tree);
+	if (view->workspace == workspace) {
+		return;
+	}
+	view->workspace = workspace;
+	osd_field_invalidate(view);
+	/* Omnipresent views stay in their shared tree */
+	if (view->visible_on_all_workspaces) {
+		view_finish_deferred_init(view);
+		return;
+	}
+	wlr_scene_node_reparent(&view->scene_tree->node, workspace->tree);
+	view_stack_update(view);
+	view_finish_deferred_init(view);
+}
+
+void
+view_finish_deferred_init(struct view *view)
+{
+	if (!view->init_deferred || (!view->visible_on_all_workspaces
+			&& view->workspace != view->server->workspaces.current)) {
+		return;
 	}
+	view->init_deferred = false;
+	render_scale_update(view);
 }
 
+bool
+view_wants_decorations(struct view *view)
+{
+	/* Window-rules take priority if they exist for this view */
+	switch (window_rules_get_property(view, "serverDecoration")) {
+	case LAB_PROP_TRUE:
+		return true;
+	case LAB_PROP_FALSE:
+		return false;
+	default:
+		break;
+	}
+
+	/*
+	 * view->ssd_preference is set by the decoration protocols, see
+	 * src/decorations/xdg-deco.c and src/decorations/kde-deco.c
+	 */
+	switch (view->ssd_preference) {
+	case LAB_SSD_PREF_SERVER:
+		return true;
+	case LAB_SSD_PREF_CLIENT:
+		return false;
+	default:
+		return rc.xdg_shell_server_side_deco;
+	}
+}
 
 enum ssd_mode
 view_get_ssd_mode(struct view *view)
@@ -1380,12 +1956,14 @@ set_fullscreen(struct view *view, bool fullscreen)
 		view->impl->set_fullscreen(view, fullscreen);
 	}
 
-	view->fullscreen = fullscreen;
+	set_output_state(view, view->output, fullscreen);
+	osd_field_invalidate(view);
 	wl_signal_emit_mutable(&view->events.fullscreened, NULL);
 
 	/* Show fullscreen views above top-layer */
 	if (view->output) {
-		desktop_update_top_layer_visibility(view->server);
+		desktop_update_top_layer_outputs(view->server,
+			top_layer_outputs(view));
 	}
 }
 
@@ -1483,11 +2061,81 @@ view_invalidate_last_layout_geometry(struct view *view)
 	view->last_layout_geometry.height = 0;
 }
 
+void
+view_save_layout_geometry(struct view *view)
+{
+	assert(view);
+	uint64_t signature = view->server->output_layout_signature;
+	if (!signature || wlr_box_empty(&view->pending)) {
+		return;
+	}
+
+	struct view_layout_geometry entry = {
+		.signature = signature,
+		.box = view_is_floating(view)
+			? view->pending : view->natural_geometry,
+	};
+	/* Drop an older entry for the layout, or else the oldest entry */
+	size_t i = 0;
+	while (i < VIEW_LAYOUT_HISTORY_SIZE - 1
+			&& view->layout_history[i].signature != signature) {
+		i++;
+	}
+	memmove(&view->layout_history[1], &view->layout_history[0],
+		i * sizeof(view->layout_history[0]));
+	view->layout_history[0] = entry;
+}
+
+/* Returns true if @view got back its geometry of the current layout */
+static bool
+restore_layout_geometry(struct view *view)
+{
+	uint64_t signature = view->server->output_layout_signature;
+	size_t i = 0;
+	while (i < VIEW_LAYOUT_HISTORY_SIZE
+			&& view->layout_history[i].signature != signature) {
+		i++;
+	}
+	if (!signature || i == VIEW_LAYOUT_HISTORY_SIZE
+			|| wlr_box_empty(&view->layout_history[i].box)) {
+		return false;
+	}
+
+	/*
+	 * The geometry was valid in this very layout, so it is applied
+	 * as it is. The entry is used up, the view may be moved before
+	 * the layout is left again.
+	 */
+	struct wlr_box box = view->layout_history[i].box;
+	memmove(&view->layout_history[i], &view->layout_history[i + 1],
+		(VIEW_LAYOUT_HISTORY_SIZE - 1 - i)
+		* sizeof(view->layout_history[0]));
+	view->layout_history[VIEW_LAYOUT_HISTORY_SIZE - 1] =
+		(struct view_layout_geometry){0};
+
+	view_discover_output(view, &box);
+	if (!output_is_usable(view->output)) {
+		return false;
+	}
+	view->natural_geometry = box;
+	view_invalidate_last_layout_geometry(view);
+	if (view_is_floating(view)) {
+		view_apply_natural_geometry(view);
+	} else {
+		view_apply_special_geometry(view);
+	}
+	return true;
+}
+
 void
 view_adjust_for_layout_change(struct view *view)
 {
 	assert(view);
 
+	if (restore_layout_geometry(view)) {
+		return;
+	}
+
 	bool is_floating = view_is_floating(view);
 	bool use_natural = false;
 
@@ -1566,7 +2214,7 @@ void
 view_on_output_destroy(struct view *view)
 {
 	assert(view);
-	view->output = NULL;
+	set_output_state(view, NULL, view->fullscreen);
 }
 
 
@@ -1660,6 +2308,8 @@ move_to_front(struct view *view)
 {
 	wl_list_remove(&view->link);
 	wl_list_insert(&view->server->views, &view->link);
+	view->stack_order = ++view->server->view_stack_top;
+	view_stack_reinsert(view);
 	wlr_scene_node_raise_to_top(&view->scene_tree->node);
 }
 
@@ -1668,6 +2318,8 @@ move_to_back(struct view *view)
 {
 	wl_list_remove(&view->link);
 	wl_list_append(&view->server->views, &view->link);
+	view->stack_order = --view->server->view_stack_bottom;
+	view_stack_reinsert(view);
 	wlr_scene_node_lower_to_bottom(&view->scene_tree->node);
 }
 
@@ -1693,7 +2345,8 @@ view_move_to_front(struct view *view)
 	}
 
 	cursor_update_focus(view->server);
-	desktop_update_top_layer_visibility(view->server);
+	desktop_update_top_layer_outputs(view->server,
+		top_layer_outputs(root) | top_layer_outputs(view));
 }
 
 void
@@ -1707,7 +2360,8 @@ view_move_to_back(struct view *view)
 	move_to_back(root);
 
 	cursor_update_focus(view->server);
-	desktop_update_top_layer_visibility(view->server);
+	desktop_update_top_layer_outputs(view->server,
+		top_layer_outputs(root) | top_layer_outputs(view));
 }
 
 struct view *
@@ -1754,6 +2408,8 @@ void
 view_update_title(struct view *view)
 {
 	assert(view);
+	window_rules_invalidate(view);
+	osd_field_invalidate(view);
 	wl_signal_emit_mutable(&view->events.new_title, NULL);
 }
 
@@ -1761,6 +2417,9 @@ void
 view_update_app_id(struct view *view)
 {
 	assert(view);
+	window_rules_invalidate(view);
+	app_id_index_update(view);
+	osd_field_invalidate(view);
 	wl_signal_emit_mutable(&view->events.new_app_id, NULL);
 }
 
@@ -1866,6 +2525,7 @@ view_init(struct view *view)
 	wl_signal_init(&view->events.minimized);
 	wl_signal_init(&view->events.fullscreened);
 	wl_signal_init(&view->events.activated);
+	wl_list_init(&view->transaction_link);
 }
 
 void
@@ -1875,19 +2535,13 @@ view_destroy(struct view *view)
 	struct server *server = view->server;
 
 	snap_constraints_invalidate(view);
+	transaction_view_done(view);
+	close_batch_remove_view(view);
 
 	if (view->mappable.connected) {
 		mappable_disconnect(&view->mappable);
 	}
 
-	wl_list_remove(&view->request_move.link);
-	wl_list_remove(&view->request_resize.link);
-	wl_list_remove(&view->request_minimize.link);
-	wl_list_remove(&view->request_maximize.link);
-	wl_list_remove(&view->request_fullscreen.link);
-	wl_list_remove(&view->set_title.link);
-	wl_list_remove(&view->destroy.link);
-
 	if (view->foreign_toplevel) {
 		foreign_toplevel_destroy(view->foreign_toplevel);
 		view->foreign_toplevel = NULL;
@@ -1920,6 +2574,7 @@ view_destroy(struct view *view)
 	}
 
 	osd_on_view_destroy(view);
+	overview_on_view_destroy(view);
 
 	/*
 	 * The layer-shell top-layer is disabled when an application is running
@@ -1927,8 +2582,8 @@ view_destroy(struct view *view)
 	 * it here.
 	 */
 	if (view->fullscreen && view->output) {
-		view->fullscreen = false;
-		desktop_update_top_layer_visibility(server);
+		set_output_state(view, view->output, false);
+		desktop_update_top_layer_outputs(server, top_layer_outputs(view));
 		if (rc.adaptive_sync == LAB_ADAPTIVE_SYNC_FULLSCREEN) {
 			set_adaptive_sync_fullscreen(view);
 		}
@@ -1947,6 +2602,10 @@ view_destroy(struct view *view)
 
 	/* Remove view from server->views */
 	wl_list_remove(&view->link);
+	wl_list_remove(&view->stack_link);
+	window_rules_invalidate(view);
+	osd_field_invalidate(view);
+	app_id_index_remove(view);
 	free(view);
 
 	cursor_update_focus(server);
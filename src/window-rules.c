@@ -37,6 +37,11 @@ view_matches_criteria(struct window_rule *rule, struct view *view)
 		.sandbox_engine = rule->sandbox_engine,
 		.sandbox_app_id = rule->sandbox_app_id,
 		.maximized = VIEW_AXIS_INVALID,
+		.compiled = true,
+		.identifier_glob = rule->identifier_glob,
+		.title_glob = rule->title_glob,
+		.sandbox_engine_glob = rule->sandbox_engine_glob,
+		.sandbox_app_id_glob = rule->sandbox_app_id_glob,
 	};
 
 	if (rule->match_once && other_instances_exist(view, &query)) {
@@ -46,6 +51,20 @@ view_matches_criteria(struct window_rule *rule, struct view *view)
 	return view_matches_query(view, &query);
 }
 
+void
+window_rules_compile(void)
+{
+	struct window_rule *rule;
+	wl_list_for_each(rule, &rc.window_rules, link) {
+		match_glob_compile(&rule->identifier_glob, rule->identifier);
+		match_glob_compile(&rule->title_glob, rule->title);
+		match_glob_compile(&rule->sandbox_engine_glob,
+			rule->sandbox_engine);
+		match_glob_compile(&rule->sandbox_app_id_glob,
+			rule->sandbox_app_id);
+	}
+}
+
 void
 window_rules_apply(struct view *view, enum window_rule_event event)
 {
@@ -60,10 +79,46 @@ window_rules_apply(struct view *view, enum window_rule_event event)
 	}
 }
 
-enum property
-window_rules_get_property(struct view *view, const char *property)
+static const char *prop_names[LAB_WINDOW_RULE_PROP_COUNT] = {
+	[LAB_WINDOW_RULE_PROP_SERVER_DECORATION] = "serverDecoration",
+	[LAB_WINDOW_RULE_PROP_SKIP_TASKBAR] = "skipTaskbar",
+	[LAB_WINDOW_RULE_PROP_SKIP_WINDOW_SWITCHER] = "skipWindowSwitcher",
+	[LAB_WINDOW_RULE_PROP_IGNORE_FOCUS_REQUEST] = "ignoreFocusRequest",
+	[LAB_WINDOW_RULE_PROP_IGNORE_CONFIGURE_REQUEST] = "ignoreConfigureRequest",
+	[LAB_WINDOW_RULE_PROP_FIXED_POSITION] = "fixedPosition",
+	[LAB_WINDOW_RULE_PROP_PREFER_SCANOUT] = "preferScanout",
+	[LAB_WINDOW_RULE_PROP_TEARING] = "tearing",
+};
+
+/* Bumped whenever the resolved properties of all views become stale */
+static uint64_t generation = 1;
+
+static void
+rule_get_props(struct window_rule *rule, enum property *props)
 {
-	assert(property);
+	props[LAB_WINDOW_RULE_PROP_SERVER_DECORATION] = rule->server_decoration;
+	props[LAB_WINDOW_RULE_PROP_SKIP_TASKBAR] = rule->skip_taskbar;
+	props[LAB_WINDOW_RULE_PROP_SKIP_WINDOW_SWITCHER] =
+		rule->skip_window_switcher;
+	props[LAB_WINDOW_RULE_PROP_IGNORE_FOCUS_REQUEST] =
+		rule->ignore_focus_request;
+	props[LAB_WINDOW_RULE_PROP_IGNORE_CONFIGURE_REQUEST] =
+		rule->ignore_configure_request;
+	props[LAB_WINDOW_RULE_PROP_FIXED_POSITION] = rule->fixed_position;
+	props[LAB_WINDOW_RULE_PROP_PREFER_SCANOUT] = rule->prefer_scanout;
+	props[LAB_WINDOW_RULE_PROP_TEARING] = rule->tearing;
+}
+
+static void
+resolve_props(struct view *view)
+{
+	struct window_rules_cache *cache = &view->window_rules;
+	for (size_t i = 0; i < LAB_WINDOW_RULE_PROP_COUNT; i++) {
+		cache->props[i] = LAB_PROP_UNSPECIFIED;
+	}
+	for (size_t i = 0; i < LAB_WINDOW_RULE_VALUE_COUNT; i++) {
+		cache->values[i] = 0;
+	}
 
 	/*
 	 * We iterate in reverse here because later items in list have higher
@@ -74,41 +129,97 @@ window_rules_get_property(struct view *view, const char *property)
 	 *       <windowRule identifier="*" serverDecoration="no"/>
 	 *       <windowRule identifier="foot" serverDecoration="default"/>
 	 *     </windowRules>
+	 *
+	 * Only properties != LAB_PROP_UNSPECIFIED are taken from a rule,
+	 * otherwise a <windowRule> which does not set a particular property
+	 * attribute would override lower priority rules that do.
 	 */
+	size_t remaining = LAB_WINDOW_RULE_PROP_COUNT
+		+ LAB_WINDOW_RULE_VALUE_COUNT;
 	struct window_rule *rule;
 	wl_list_for_each_reverse(rule, &rc.window_rules, link) {
-		/*
-		 * Only return if property != LAB_PROP_UNSPECIFIED otherwise a
-		 * <windowRule> which does not set a particular property
-		 * attribute would still return here if that property was asked
-		 * for.
-		 */
-		if (view_matches_criteria(rule, view)) {
-			if (rule->server_decoration
-					&& !strcasecmp(property, "serverDecoration")) {
-				return rule->server_decoration;
-			}
-			if (rule->skip_taskbar
-					&& !strcasecmp(property, "skipTaskbar")) {
-				return rule->skip_taskbar;
-			}
-			if (rule->skip_window_switcher
-					&& !strcasecmp(property, "skipWindowSwitcher")) {
-				return rule->skip_window_switcher;
+		if (!remaining) {
+			break;
+		}
+		enum property props[LAB_WINDOW_RULE_PROP_COUNT];
+		rule_get_props(rule, props);
+		bool useful = false;
+		for (size_t i = 0; i < LAB_WINDOW_RULE_PROP_COUNT; i++) {
+			if (props[i] && !cache->props[i]) {
+				useful = true;
+				break;
 			}
-			if (rule->ignore_focus_request
-					&& !strcasecmp(property, "ignoreFocusRequest")) {
-				return rule->ignore_focus_request;
+		}
+		for (size_t i = 0; i < LAB_WINDOW_RULE_VALUE_COUNT; i++) {
+			if (rule->values[i] && !cache->values[i]) {
+				useful = true;
+				break;
 			}
-			if (rule->ignore_configure_request
-					&& !strcasecmp(property, "ignoreConfigureRequest")) {
-				return rule->ignore_configure_request;
+		}
+		/* Skip the matching cost of rules which cannot contribute */
+		if (!useful || !view_matches_criteria(rule, view)) {
+			continue;
+		}
+		for (size_t i = 0; i < LAB_WINDOW_RULE_PROP_COUNT; i++) {
+			if (props[i] && !cache->props[i]) {
+				cache->props[i] = props[i];
+				remaining--;
 			}
-			if (rule->fixed_position
-					&& !strcasecmp(property, "fixedPosition")) {
-				return rule->fixed_position;
+		}
+		for (size_t i = 0; i < LAB_WINDOW_RULE_VALUE_COUNT; i++) {
+			if (rule->values[i] && !cache->values[i]) {
+				cache->values[i] = rule->values[i];
+				remaining--;
 			}
 		}
 	}
+	cache->generation = generation;
+}
+
+enum property
+window_rules_get_property(struct view *view, const char *property)
+{
+	assert(property);
+
+	if (view->window_rules.generation != generation) {
+		resolve_props(view);
+	}
+	for (size_t i = 0; i < LAB_WINDOW_RULE_PROP_COUNT; i++) {
+		if (!strcasecmp(property, prop_names[i])) {
+			return view->window_rules.props[i];
+		}
+	}
 	return LAB_PROP_UNSPECIFIED;
 }
+
+double
+window_rules_get_value(struct view *view, enum window_rule_value value)
+{
+	assert(value < LAB_WINDOW_RULE_VALUE_COUNT);
+	if (view->window_rules.generation != generation) {
+		resolve_props(view);
+	}
+	return view->window_rules.values[value];
+}
+
+static bool
+have_match_once_rules(void)
+{
+	struct window_rule *rule;
+	wl_list_for_each(rule, &rc.window_rules, link) {
+		if (rule->match_once) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+window_rules_invalidate(struct view *view)
+{
+	if (!view || have_match_once_rules()) {
+		generation++;
+	} else {
+		view->window_rules.generation = 0;
+	}
+}
@@ -4,17 +4,22 @@
 #include <cairo.h>
 #include <pango/pangocairo.h>
 #include <errno.h>
+#include <glib.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include "config.h"
+#include "animation.h"
 #include "buffer.h"
 #include "common/font.h"
 #include "common/graphic-helpers.h"
 #include "common/list.h"
 #include "common/mem.h"
+#include "input/gestures.h"
 #include "input/keyboard.h"
 #include "labwc.h"
+#include "probe.h"
 #include "protocols/cosmic-workspaces.h"
 #include "protocols/ext-workspace.h"
 #include "view.h"
@@ -24,6 +29,61 @@
 #define COSMIC_WORKSPACES_VERSION 1
 #define EXT_WORKSPACES_VERSION 1
 
+/*
+ * Index of server->workspaces.all by case-folded name and by position. The
+ * first workspace of a given name wins, like the linear search did. The
+ * index is rebuilt lazily on the first lookup after the list has changed.
+ */
+static GHashTable *workspace_by_name;
+static struct wl_array workspace_by_index; /* struct workspace * */
+static bool workspace_index_stale = true;
+
+static void
+workspace_index_invalidate(void)
+{
+	workspace_index_stale = true;
+}
+
+static void
+workspace_index_rebuild(struct server *server)
+{
+	if (workspace_by_name) {
+		g_hash_table_remove_all(workspace_by_name);
+	} else {
+		workspace_by_name = g_hash_table_new_full(g_str_hash,
+			g_str_equal, g_free, NULL);
+		wl_array_init(&workspace_by_index);
+	}
+	workspace_by_index.size = 0;
+
+	struct workspace *workspace;
+	wl_list_for_each(workspace, &server->workspaces.all, link) {
+		struct workspace **slot = wl_array_add(&workspace_by_index,
+			sizeof(*slot));
+		if (slot) {
+			*slot = workspace;
+		}
+		char *key = g_ascii_strdown(workspace->name, -1);
+		if (g_hash_table_contains(workspace_by_name, key)) {
+			g_free(key);
+			continue;
+		}
+		g_hash_table_insert(workspace_by_name, key, workspace);
+	}
+	workspace_index_stale = false;
+}
+
+static void
+workspace_index_finish(void)
+{
+	if (workspace_by_name) {
+		g_hash_table_destroy(workspace_by_name);
+		workspace_by_name = NULL;
+		wl_array_release(&workspace_by_index);
+	}
+	workspace_index_stale = true;
+}
+
 /* Internal helpers */
 static size_t
 parse_workspace_index(const char *name)
@@ -75,28 +135,33 @@ handle_ext_workspace_activate(struct wl_listener *listener, void *data)
 	wlr_log(WLR_INFO, "ext activating workspace %s", workspace->name);
 }
 
-/* Internal API */
+/*
+ * Both workspace protocols are kept in sync from here only. They share
+ * the canonical state in struct workspace, each protocol then batches
+ * its events until its next done event.
+ */
 static void
-add_workspace(struct server *server, const char *name)
+protocols_set_name(struct workspace *workspace)
 {
-	struct workspace *workspace = znew(*workspace);
-	workspace->server = server;
-	workspace->name = xstrdup(name);
-	workspace->tree = wlr_scene_tree_create(server->view_tree);
-	wl_list_append(&server->workspaces.all, &workspace->link);
-	if (!server->workspaces.current) {
-		server->workspaces.current = workspace;
-	} else {
-		wlr_scene_node_set_enabled(&workspace->tree->node, false);
-	}
-
-	bool active = server->workspaces.current == workspace;
+	lab_cosmic_workspace_set_name(workspace->cosmic_workspace, workspace->name);
+	lab_ext_workspace_set_name(workspace->ext_workspace, workspace->name);
+}
 
-	/* cosmic */
-	workspace->cosmic_workspace = lab_cosmic_workspace_create(server->workspaces.cosmic_group);
-	lab_cosmic_workspace_set_name(workspace->cosmic_workspace, name);
+static void
+protocols_set_active(struct workspace *workspace, bool active)
+{
 	lab_cosmic_workspace_set_active(workspace->cosmic_workspace, active);
+	lab_ext_workspace_set_active(workspace->ext_workspace, active);
+}
 
+static void
+protocols_create(struct workspace *workspace)
+{
+	struct server *server = workspace->server;
+
+	/* cosmic */
+	workspace->cosmic_workspace =
+		lab_cosmic_workspace_create(server->workspaces.cosmic_group);
 	workspace->on_cosmic.activate.notify = handle_cosmic_workspace_activate;
 	wl_signal_add(&workspace->cosmic_workspace->events.activate,
 		&workspace->on_cosmic.activate);
@@ -104,13 +169,46 @@ add_workspace(struct server *server, const char *name)
 	/* ext */
 	workspace->ext_workspace = lab_ext_workspace_create(
 		server->workspaces.ext_manager, /*id*/ NULL);
-	lab_ext_workspace_assign_to_group(workspace->ext_workspace, server->workspaces.ext_group);
-	lab_ext_workspace_set_name(workspace->ext_workspace, name);
-	lab_ext_workspace_set_active(workspace->ext_workspace, active);
-
+	lab_ext_workspace_assign_to_group(workspace->ext_workspace,
+		server->workspaces.ext_group);
 	workspace->on_ext.activate.notify = handle_ext_workspace_activate;
 	wl_signal_add(&workspace->ext_workspace->events.activate,
 		&workspace->on_ext.activate);
+
+	protocols_set_name(workspace);
+	protocols_set_active(workspace, server->workspaces.current == workspace);
+}
+
+static void
+protocols_destroy(struct workspace *workspace)
+{
+	wl_list_remove(&workspace->on_cosmic.activate.link);
+	wl_list_remove(&workspace->on_ext.activate.link);
+	lab_cosmic_workspace_destroy(workspace->cosmic_workspace);
+	lab_ext_workspace_destroy(workspace->ext_workspace);
+}
+
+/* Internal API */
+static void
+add_workspace(struct server *server, const char *name)
+{
+	struct workspace *workspace = znew(*workspace);
+	workspace->server = server;
+	workspace->name = xstrdup(name);
+	workspace->tree = wlr_scene_tree_create(server->view_tree);
+	wlr_scene_node_place_below(&workspace->tree->node,
+		&server->view_tree_omnipresent->node);
+	wl_list_init(&workspace->views);
+	wl_list_append(&server->workspaces.all, &workspace->link);
+	workspace_index_invalidate();
+	if (!server->workspaces.current) {
+		server->workspaces.current = workspace;
+		server->workspaces.settle.reported = workspace;
+	} else {
+		wlr_scene_node_set_enabled(&workspace->tree->node, false);
+	}
+
+	protocols_create(workspace);
 }
 
 static struct workspace *
@@ -145,6 +243,82 @@ get_next(struct workspace *current, struct wl_list *workspaces, bool wrap)
 
 
 /* Public API */
+static void
+slide_step(struct lab_animation *animation, double progress)
+{
+	struct server *server = wl_container_of(animation, server,
+		workspaces.slide.animation);
+	int distance = server->workspaces.slide.distance;
+	wlr_scene_node_set_position(&server->workspaces.slide.from->tree->node,
+		lround(distance * progress), 0);
+	wlr_scene_node_set_position(&server->workspaces.slide.to->tree->node,
+		lround(distance * (progress - 1.0)), 0);
+}
+
+static void
+slide_finish(struct lab_animation *animation)
+{
+	struct server *server = wl_container_of(animation, server,
+		workspaces.slide.animation);
+	struct workspace *from = server->workspaces.slide.from;
+	wlr_scene_node_set_position(&from->tree->node, 0, 0);
+	wlr_scene_node_set_position(&server->workspaces.slide.to->tree->node,
+		0, 0);
+	/* Unless it has been switched back to meanwhile */
+	if (from != server->workspaces.current) {
+		wlr_scene_node_set_enabled(&from->tree->node, false);
+	}
+	server->workspaces.slide.from = NULL;
+	server->workspaces.slide.to = NULL;
+}
+
+static const struct lab_animation_impl slide_impl = {
+	.step = slide_step,
+	.finish = slide_finish,
+};
+
+/* Keeps @from shown while it slides out and @to slides in */
+static void
+slide_begin(struct workspace *from, struct workspace *to)
+{
+	struct server *server = to->server;
+	if (!rc.workspace_config.slide_time
+			|| server->seat.workspace_swipe.animating) {
+		/* A swipe has moved the workspaces into place already */
+		return;
+	}
+	struct output *output = output_nearest_to(server,
+		server->seat.cursor->x, server->seat.cursor->y);
+	struct wlr_box box = {0};
+	if (output_is_usable(output)) {
+		wlr_output_layout_get_box(server->output_layout,
+			output->wlr_output, &box);
+	}
+	if (wlr_box_empty(&box)) {
+		return;
+	}
+
+	/* The new workspace comes in from the side it is on */
+	bool to_the_right = false;
+	struct workspace *workspace;
+	wl_list_for_each(workspace, &server->workspaces.all, link) {
+		if (workspace == from) {
+			to_the_right = true;
+			break;
+		} else if (workspace == to) {
+			break;
+		}
+	}
+
+	wlr_scene_node_set_enabled(&from->tree->node, true);
+	server->workspaces.slide.from = from;
+	server->workspaces.slide.to = to;
+	server->workspaces.slide.distance =
+		to_the_right ? -box.width : box.width;
+	animation_start(server, &server->workspaces.slide.animation,
+		rc.workspace_config.slide_time);
+}
+
 void
 workspaces_init(struct server *server)
 {
@@ -162,7 +336,10 @@ workspaces_init(struct server *server)
 	server->workspaces.ext_group = lab_ext_workspace_group_create(
 		server->workspaces.ext_manager);
 
+	server->view_tree_omnipresent =
+		wlr_scene_tree_create(server->view_tree);
 	wl_list_init(&server->workspaces.all);
+	animation_init(&server->workspaces.slide.animation, &slide_impl);
 
 	struct workspace *conf;
 	wl_list_for_each(conf, &rc.workspace_config.workspaces, link) {
@@ -170,10 +347,88 @@ workspaces_init(struct server *server)
 	}
 }
 
+static void
+do_settle(struct server *server)
+{
+	struct workspace *target = server->workspaces.current;
+
+	/*
+	 * Make sure we are focusing what the user sees. Only refocus if
+	 * the focus is not already on an omnipresent or always-on-top view,
+	 * or on a view of the new workspace focused since the switch.
+	 *
+	 * TODO: Decouple always-on-top views from the omnipresent state.
+	 *       One option for that would be to create a new scene tree
+	 *       as child of every workspace tree and then reparent a-o-t
+	 *       windows to that one. Combined with adjusting the condition
+	 *       below that should take care of the issue.
+	 */
+	if (server->workspaces.settle.update_focus) {
+		server->workspaces.settle.update_focus = false;
+		struct view *view = server->active_view;
+		if (!view || (view->workspace != target
+				&& !view->visible_on_all_workspaces
+				&& !view_is_always_on_top(view))) {
+			desktop_focus_topmost_view(server);
+		}
+	}
+
+	/*
+	 * Make sure we are not carrying around a
+	 * cursor image from the previous desktop
+	 */
+	cursor_update_focus(server);
+
+	/* Workspaces only passed through are never reported as active */
+	struct workspace *reported = server->workspaces.settle.reported;
+	if (reported == target) {
+		return;
+	}
+	if (reported) {
+		protocols_set_active(reported, false);
+	}
+	protocols_set_active(target, true);
+	server->workspaces.settle.reported = target;
+}
+
+static void
+settle(struct server *server)
+{
+	struct probe_timer timer;
+	probe_begin(&timer);
+	do_settle(server);
+	probe_end(&timer, LAB_PROBE_WORKSPACES_SETTLE);
+}
+
+static void
+handle_settle_idle(void *data)
+{
+	struct server *server = data;
+	/* Idle sources are removed automatically once dispatched */
+	server->workspaces.settle.idle = NULL;
+	settle(server);
+}
+
+void
+workspaces_settle(struct server *server)
+{
+	if (!server->workspaces.settle.idle) {
+		return;
+	}
+	wl_event_source_remove(server->workspaces.settle.idle);
+	server->workspaces.settle.idle = NULL;
+	settle(server);
+}
+
 /*
  * update_focus should normally be set to true. It is set to false only
  * when this function is called from desktop_focus_view(), in order to
  * avoid unnecessary extra focus changes and possible recursion.
+ *
+ * Only the scene graph is updated right away. Refocusing, the cursor focus
+ * and the workspace protocols are updated once the event loop is idle so
+ * that a burst of switches, for example from scrolling over a panel,
+ * results in a single update for the final workspace.
  */
 void
 workspaces_switch_to(struct workspace *target, bool update_focus)
@@ -184,23 +439,25 @@ workspaces_switch_to(struct workspace *target, bool update_focus)
 		return;
 	}
 
+	struct probe_timer timer;
+	probe_begin(&timer);
+
+	/* Land a running slide first, it may be the one being reversed */
+	animation_finish(&server->workspaces.slide.animation);
+	struct workspace *from = server->workspaces.current;
+
 	/* Disable the old workspace */
 	wlr_scene_node_set_enabled(
 		&server->workspaces.current->tree->node, false);
 
-	lab_cosmic_workspace_set_active(
-		server->workspaces.current->cosmic_workspace, false);
-	lab_ext_workspace_set_active(
-		server->workspaces.current->ext_workspace, false);
-
-	/* Move Omnipresent views to new workspace */
+	/*
+	 * Omnipresent views live in a tree shared by all workspaces, so
+	 * only their workspace needs to be updated
+	 */
 	struct view *view;
-	enum lab_view_criteria criteria =
-		LAB_VIEW_CRITERIA_CURRENT_WORKSPACE;
-	for_each_view_reverse(view, &server->views, criteria) {
-		if (view->visible_on_all_workspaces) {
-			view_move_to_workspace(view, target);
-		}
+	wl_list_for_each(view, &server->views_omnipresent, stack_link) {
+		view->workspace = target;
+		osd_field_invalidate(view);
 	}
 
 	/* Enable the new workspace */
@@ -212,36 +469,21 @@ workspaces_switch_to(struct workspace *target, bool update_focus)
 	/* Make sure new views will spawn on the new workspace */
 	server->workspaces.current = target;
 
-	/*
-	 * Make sure we are focusing what the user sees. Only refocus if
-	 * the focus is not already on an omnipresent or always-on-top view.
-	 *
-	 * TODO: Decouple always-on-top views from the omnipresent state.
-	 *       One option for that would be to create a new scene tree
-	 *       as child of every workspace tree and then reparent a-o-t
-	 *       windows to that one. Combined with adjusting the condition
-	 *       below that should take care of the issue.
-	 */
-	if (update_focus) {
-		struct view *view = server->active_view;
-		if (!view || (!view->visible_on_all_workspaces
-				&& !view_is_always_on_top(view))) {
-			desktop_focus_topmost_view(server);
-		}
+	wl_list_for_each(view, &server->views, link) {
+		view_finish_deferred_init(view);
 	}
 
-	/* And finally show the OSD */
-	/*
-	 * Make sure we are not carrying around a
-	 * cursor image from the previous desktop
-	 */
-	cursor_update_focus(server);
-
 	/* Ensure that only currently visible fullscreen windows hide the top layer */
 	desktop_update_top_layer_visibility(server);
 
-	lab_cosmic_workspace_set_active(target->cosmic_workspace, true);
-	lab_ext_workspace_set_active(target->ext_workspace, true);
+	slide_begin(from, target);
+
+	server->workspaces.settle.update_focus |= update_focus;
+	if (!server->workspaces.settle.idle) {
+		server->workspaces.settle.idle = wl_event_loop_add_idle(
+			server->wl_event_loop, handle_settle_idle, server);
+	}
+	probe_end(&timer, LAB_PROBE_WORKSPACES_SWITCH_TO);
 }
 
 void
@@ -263,54 +505,107 @@ workspaces_osd_hide(struct seat *seat)
 	cursor_update_focus(server);
 }
 
+void
+workspace_ref_parse(struct workspace_ref *ref, const char *name)
+{
+	assert(name);
+	*ref = (struct workspace_ref){ .index = parse_workspace_index(name) };
+	if (ref->index) {
+		ref->type = LAB_WORKSPACE_REF_INDEX;
+	} else if (!strcasecmp(name, "current")) {
+		ref->type = LAB_WORKSPACE_REF_CURRENT;
+	} else if (!strcasecmp(name, "last")) {
+		ref->type = LAB_WORKSPACE_REF_LAST;
+	} else if (!strcasecmp(name, "left")) {
+		ref->type = LAB_WORKSPACE_REF_LEFT;
+	} else if (!strcasecmp(name, "right")) {
+		ref->type = LAB_WORKSPACE_REF_RIGHT;
+	} else {
+		ref->type = LAB_WORKSPACE_REF_NAME;
+		ref->key = g_ascii_strdown(name, -1);
+	}
+}
+
+void
+workspace_ref_finish(struct workspace_ref *ref)
+{
+	g_free(ref->key);
+	ref->key = NULL;
+}
+
 struct workspace *
-workspaces_find(struct workspace *anchor, const char *name, bool wrap)
+workspaces_find_ref(struct workspace *anchor, const struct workspace_ref *ref,
+		bool wrap)
 {
 	assert(anchor);
-	if (!name) {
-		return NULL;
+	struct server *server = anchor->server;
+	struct wl_list *workspaces = &server->workspaces.all;
+
+	if (workspace_index_stale) {
+		workspace_index_rebuild(server);
 	}
-	size_t index = 0;
-	struct workspace *target;
-	size_t wants_index = parse_workspace_index(name);
-	struct wl_list *workspaces = &anchor->server->workspaces.all;
 
-	if (wants_index) {
-		wl_list_for_each(target, workspaces, link) {
-			if (wants_index == ++index) {
-				return target;
-			}
+	struct workspace *target = NULL;
+	switch (ref->type) {
+	case LAB_WORKSPACE_REF_INDEX: {
+		struct workspace **by_index = workspace_by_index.data;
+		size_t count = workspace_by_index.size / sizeof(*by_index);
+		if (ref->index <= count) {
+			return by_index[ref->index - 1];
 		}
-	} else if (!strcasecmp(name, "current")) {
+		wlr_log(WLR_ERROR, "Workspace '%zu' not found", ref->index);
+		return NULL;
+	}
+	case LAB_WORKSPACE_REF_CURRENT:
 		return anchor;
-	} else if (!strcasecmp(name, "last")) {
-		return anchor->server->workspaces.last;
-	} else if (!strcasecmp(name, "left")) {
+	case LAB_WORKSPACE_REF_LAST:
+		return server->workspaces.last;
+	case LAB_WORKSPACE_REF_LEFT:
 		return get_prev(anchor, workspaces, wrap);
-	} else if (!strcasecmp(name, "right")) {
+	case LAB_WORKSPACE_REF_RIGHT:
 		return get_next(anchor, workspaces, wrap);
-	} else {
-		wl_list_for_each(target, workspaces, link) {
-			if (!strcasecmp(target->name, name)) {
-				return target;
-			}
-		}
+	case LAB_WORKSPACE_REF_NAME:
+		target = g_hash_table_lookup(workspace_by_name, ref->key);
+		break;
+	}
+	if (!target) {
+		wlr_log(WLR_ERROR, "Workspace '%s' not found", ref->key);
+	}
+	return target;
+}
+
+struct workspace *
+workspaces_find(struct workspace *anchor, const char *name, bool wrap)
+{
+	assert(anchor);
+	if (!name) {
+		return NULL;
 	}
-	wlr_log(WLR_ERROR, "Workspace '%s' not found", name);
-	return NULL;
+	struct workspace_ref ref;
+	workspace_ref_parse(&ref, name);
+	struct workspace *target = workspaces_find_ref(anchor, &ref, wrap);
+	workspace_ref_finish(&ref);
+	return target;
 }
 
 static void
 destroy_workspace(struct workspace *workspace)
 {
+	struct server *server = workspace->server;
+	gestures_workspace_destroyed(&server->seat, workspace);
+	if (server->workspaces.slide.from == workspace
+			|| server->workspaces.slide.to == workspace) {
+		animation_finish(&server->workspaces.slide.animation);
+	}
+	if (server->workspaces.settle.reported == workspace) {
+		server->workspaces.settle.reported = NULL;
+	}
+	view_stack_detach_all(&workspace->views);
 	wlr_scene_node_destroy(&workspace->tree->node);
 	zfree(workspace->name);
 	wl_list_remove(&workspace->link);
-	wl_list_remove(&workspace->on_cosmic.activate.link);
-	wl_list_remove(&workspace->on_ext.activate.link);
-
-	lab_cosmic_workspace_destroy(workspace->cosmic_workspace);
-	lab_ext_workspace_destroy(workspace->ext_workspace);
+	workspace_index_invalidate();
+	protocols_destroy(workspace);
 	free(workspace);
 }
 
@@ -345,10 +640,8 @@ workspaces_reconfigure(struct server *server)
 				actual_workspace->name, configured_workspace->name);
 			free(actual_workspace->name);
 			actual_workspace->name = xstrdup(configured_workspace->name);
-			lab_cosmic_workspace_set_name(
-				actual_workspace->cosmic_workspace, actual_workspace->name);
-			lab_ext_workspace_set_name(
-				actual_workspace->ext_workspace, actual_workspace->name);
+			workspace_index_invalidate();
+			protocols_set_name(actual_workspace);
 		}
 		actual_workspace_link = actual_workspace_link->next;
 	}
@@ -392,9 +685,14 @@ workspaces_reconfigure(struct server *server)
 void
 workspaces_destroy(struct server *server)
 {
+	if (server->workspaces.settle.idle) {
+		wl_event_source_remove(server->workspaces.settle.idle);
+		server->workspaces.settle.idle = NULL;
+	}
 	struct workspace *workspace, *tmp;
 	wl_list_for_each_safe(workspace, tmp, &server->workspaces.all, link) {
 		destroy_workspace(workspace);
 	}
 	assert(wl_list_empty(&server->workspaces.all));
+	workspace_index_finish();
 }
@@ -9,6 +9,7 @@
 
 #include "common/macros.h"
 #include "common/mem.h"
+#include "common/slab.h"
 #include "labwc.h"
 #include "node.h"
 #include "view.h"
@@ -23,6 +24,9 @@ struct xdg_popup {
 	struct wl_listener reposition;
 };
 
+/* Menu-heavy clients open and close popups all the time */
+static struct lab_slab popup_slab = LAB_SLAB_INIT(struct xdg_popup);
+
 static void
 popup_unconstrain(struct xdg_popup *popup)
 {
@@ -84,7 +88,7 @@ handle_xdg_popup_destroy(struct wl_listener *listener, void *data)
 
 	cursor_update_focus(popup->parent_view->server);
 
-	free(popup);
+	lab_slab_free(&popup_slab, popup);
 }
 
 static void
@@ -126,7 +130,7 @@ xdg_popup_create(struct view *view, struct wlr_xdg_popup *wlr_popup)
 		return;
 	}
 
-	struct xdg_popup *popup = znew(*popup);
+	struct xdg_popup *popup = lab_slab_new(&popup_slab, *popup);
 	popup->parent_view = view;
 	popup->wlr_popup = wlr_popup;
 
@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <wlr/types/wlr_fractional_scale_v1.h>
 
+#include "common/listener.h"
 #include "common/macros.h"
 #include "common/mem.h"
 #include "decorations.h"
@@ -10,13 +11,13 @@
 #include "labwc.h"
 #include "node.h"
 #include "snap-constraints.h"
+#include "trace.h"
 #include "view.h"
 #include "view-impl-common.h"
 #include "window-rules.h"
 #include "workspaces.h"
 
 #define LAB_XDG_SHELL_VERSION (3)
-#define CONFIGURE_TIMEOUT_MS 100
 
 static struct xdg_toplevel_view *
 xdg_toplevel_view_from_view(struct view *view)
@@ -119,9 +120,12 @@ do_late_positioning(struct view *view)
 	}
 }
 
+static bool send_deferred_configure(struct view *view);
+
 static void
 handle_commit(struct wl_listener *listener, void *data)
 {
+	TRACE_SCOPE("xdg_commit");
 	struct view *view = wl_container_of(listener, view, commit);
 	struct wlr_xdg_surface *xdg_surface = xdg_surface_from_view(view);
 	struct wlr_xdg_toplevel *toplevel = xdg_toplevel_from_view(view);
@@ -200,11 +204,13 @@ handle_commit(struct wl_listener *listener, void *data)
 
 	uint32_t serial = view->pending_configure_serial;
 	if (serial > 0 && serial == xdg_surface->current.configure_serial) {
-		assert(view->pending_configure_timeout);
-		wl_event_source_remove(view->pending_configure_timeout);
+		assert(lab_timer_is_armed(&view->pending_configure_timeout));
+		lab_timer_disarm(&view->pending_configure_timeout);
 		view->pending_configure_serial = 0;
-		view->pending_configure_timeout = NULL;
 		update_required = true;
+		if (!send_deferred_configure(view)) {
+			transaction_view_done(view);
+		}
 	}
 
 	if (update_required) {
@@ -250,20 +256,22 @@ handle_commit(struct wl_listener *listener, void *data)
 	}
 }
 
-static int
+static void
 handle_configure_timeout(void *data)
 {
 	struct view *view = data;
 	assert(view->pending_configure_serial > 0);
-	assert(view->pending_configure_timeout);
 
 	const char *app_id = view_get_string_prop(view, "app_id");
 	wlr_log(WLR_INFO, "client (%s) did not respond to configure request "
 		"in %d ms", app_id, CONFIGURE_TIMEOUT_MS);
 
-	wl_event_source_remove(view->pending_configure_timeout);
 	view->pending_configure_serial = 0;
-	view->pending_configure_timeout = NULL;
+	if (send_deferred_configure(view)) {
+		/* The client gets another chance with the latest size */
+		return;
+	}
+	transaction_view_done(view);
 
 	bool empty_pending = wlr_box_empty(&view->pending);
 	if (empty_pending || view->pending.x != view->current.x
@@ -300,45 +308,42 @@ handle_configure_timeout(void *data)
 	/* Re-sync pending view with current state */
 	snap_constraints_update(view);
 	view->pending = view->current;
-
-	return 0; /* ignored per wl_event_loop docs */
 }
 
 static void
 set_pending_configure_serial(struct view *view, uint32_t serial)
 {
 	view->pending_configure_serial = serial;
-	if (!view->pending_configure_timeout) {
-		view->pending_configure_timeout =
-			wl_event_loop_add_timer(view->server->wl_event_loop,
-				handle_configure_timeout, view);
+	if (!view->pending_configure_timeout.func) {
+		lab_timer_init(&view->pending_configure_timeout,
+			handle_configure_timeout, view);
 	}
-	wl_event_source_timer_update(view->pending_configure_timeout,
-		CONFIGURE_TIMEOUT_MS);
+	lab_timer_arm(&view->server->seat.timers,
+		&view->pending_configure_timeout, CONFIGURE_TIMEOUT_MS);
 }
 
-static void
-handle_destroy(struct wl_listener *listener, void *data)
+/*
+ * Send the size deferred by xdg_toplevel_view_configure() now that the
+ * previous configure has been acked or has timed out. Returns true if
+ * a new configure is pending.
+ */
+static bool
+send_deferred_configure(struct view *view)
 {
-	struct view *view = wl_container_of(listener, view, destroy);
-	assert(view->type == LAB_XDG_SHELL_VIEW);
 	struct xdg_toplevel_view *xdg_toplevel_view =
 		xdg_toplevel_view_from_view(view);
-
-	xdg_toplevel_view->xdg_surface->data = NULL;
-	xdg_toplevel_view->xdg_surface = NULL;
-
-	/* Remove xdg-shell view specific listeners */
-	wl_list_remove(&xdg_toplevel_view->set_app_id.link);
-	wl_list_remove(&xdg_toplevel_view->new_popup.link);
-	wl_list_remove(&view->commit.link);
-
-	if (view->pending_configure_timeout) {
-		wl_event_source_remove(view->pending_configure_timeout);
-		view->pending_configure_timeout = NULL;
+	if (!xdg_toplevel_view->configure_deferred) {
+		return false;
 	}
+	xdg_toplevel_view->configure_deferred = false;
 
-	view_destroy(view);
+	uint32_t serial = wlr_xdg_toplevel_set_size(xdg_toplevel_from_view(view),
+		view->pending.width, view->pending.height);
+	if (!serial) {
+		return false;
+	}
+	set_pending_configure_serial(view, serial);
+	return true;
 }
 
 static void
@@ -425,6 +430,57 @@ handle_set_app_id(struct wl_listener *listener, void *data)
 	view_update_app_id(view);
 }
 
+#define XDG_LISTENER(src_type, member, name) \
+	LAB_LISTENER(src_type, struct xdg_toplevel_view, member, name)
+
+static const struct lab_listener_binding toplevel_listeners[] = {
+	XDG_LISTENER(struct wlr_xdg_toplevel, base.destroy, destroy),
+	XDG_LISTENER(struct wlr_xdg_toplevel, base.request_move, request_move),
+	XDG_LISTENER(struct wlr_xdg_toplevel, base.request_resize,
+		request_resize),
+	XDG_LISTENER(struct wlr_xdg_toplevel, base.request_minimize,
+		request_minimize),
+	XDG_LISTENER(struct wlr_xdg_toplevel, base.request_maximize,
+		request_maximize),
+	XDG_LISTENER(struct wlr_xdg_toplevel, base.request_fullscreen,
+		request_fullscreen),
+	XDG_LISTENER(struct wlr_xdg_toplevel, base.set_title, set_title),
+	XDG_LISTENER(struct wlr_xdg_toplevel, set_app_id, set_app_id),
+};
+
+static const struct lab_listener_binding xdg_surface_listeners[] = {
+	XDG_LISTENER(struct wlr_xdg_surface, new_popup, new_popup),
+};
+
+static const struct lab_listener_binding surface_listeners[] = {
+	XDG_LISTENER(struct wlr_surface, base.commit, commit),
+};
+
+#undef XDG_LISTENER
+
+static void
+handle_destroy(struct wl_listener *listener, void *data)
+{
+	struct view *view = wl_container_of(listener, view, destroy);
+	assert(view->type == LAB_XDG_SHELL_VIEW);
+	struct xdg_toplevel_view *xdg_toplevel_view =
+		xdg_toplevel_view_from_view(view);
+
+	xdg_toplevel_view->xdg_surface->data = NULL;
+	xdg_toplevel_view->xdg_surface = NULL;
+
+	lab_listeners_disconnect(xdg_toplevel_view, toplevel_listeners,
+		ARRAY_SIZE(toplevel_listeners));
+	lab_listeners_disconnect(xdg_toplevel_view, xdg_surface_listeners,
+		ARRAY_SIZE(xdg_surface_listeners));
+	lab_listeners_disconnect(xdg_toplevel_view, surface_listeners,
+		ARRAY_SIZE(surface_listeners));
+
+	lab_timer_disarm(&view->pending_configure_timeout);
+
+	view_destroy(view);
+}
+
 static void
 xdg_toplevel_view_configure(struct view *view, struct wlr_box geo)
 {
@@ -438,13 +494,24 @@ xdg_toplevel_view_configure(struct view *view, struct wlr_box geo)
 	 */
 	if (geo.width != view->pending.width
 			|| geo.height != view->pending.height) {
-		serial = wlr_xdg_toplevel_set_size(xdg_toplevel_from_view(view),
-			geo.width, geo.height);
+		if (view->pending_configure_serial) {
+			/*
+			 * The client has not caught up with the previous
+			 * size yet. Rather than queueing up configures,
+			 * only the latest size is sent once it does.
+			 */
+			xdg_toplevel_view_from_view(view)->configure_deferred = true;
+		} else {
+			serial = wlr_xdg_toplevel_set_size(
+				xdg_toplevel_from_view(view),
+				geo.width, geo.height);
+		}
 	}
 
 	view->pending = geo;
 	if (serial > 0) {
 		set_pending_configure_serial(view, serial);
+		transaction_add_view(view);
 	} else if (view->pending_configure_serial == 0) {
 		view->current.x = geo.x;
 		view->current.y = geo.y;
@@ -764,17 +831,53 @@ static const struct view_impl xdg_toplevel_view_impl = {
 	.get_pid = xdg_view_get_pid,
 };
 
+/*
+ * Unused activation tokens expire after one to two periods. Rather than
+ * wlroots arming a timer per token, the tokens are kept in two lists and
+ * a single timer per period destroys the older list and ages the newer
+ * one, so expiry is constant time per token and launchers starting many
+ * apps don't leave tokens piling up.
+ */
+#define XDG_ACTIVATION_TOKEN_PERIOD_MSEC 15000
+
 struct token_data {
 	bool had_valid_surface;
 	bool had_valid_seat;
+	struct wlr_xdg_activation_token_v1 *token;
+	struct wl_list link; /* activation_tokens.young or .old */
 	struct wl_listener destroy;
 };
 
+static struct {
+	struct wl_list young;
+	struct wl_list old;
+	struct wl_event_source *timer;
+} activation_tokens;
+
+static int
+handle_token_timer(void *data)
+{
+	while (!wl_list_empty(&activation_tokens.old)) {
+		struct token_data *token_data = wl_container_of(
+			activation_tokens.old.next, token_data, link);
+		/* Ends up in xdg_activation_handle_token_destroy() */
+		wlr_xdg_activation_token_v1_destroy(token_data->token);
+	}
+	wl_list_insert_list(&activation_tokens.old, &activation_tokens.young);
+	wl_list_init(&activation_tokens.young);
+	if (!wl_list_empty(&activation_tokens.old)) {
+		wl_event_source_timer_update(activation_tokens.timer,
+			XDG_ACTIVATION_TOKEN_PERIOD_MSEC);
+	}
+	return 0;
+}
+
 static void
 xdg_activation_handle_token_destroy(struct wl_listener *listener, void *data)
 {
 	struct token_data *token_data = wl_container_of(listener, token_data, destroy);
 	wl_list_remove(&token_data->destroy.link);
+	wl_list_remove(&token_data->link);
 	free(token_data);
 }
 
@@ -785,10 +888,18 @@ xdg_activation_handle_new_token(struct wl_listener *listener, void *data)
 	struct token_data *token_data = znew(*token_data);
 	token_data->had_valid_surface = !!token->surface;
 	token_data->had_valid_seat = !!token->seat;
+	token_data->token = token;
 	token->data = token_data;
 
 	token_data->destroy.notify = xdg_activation_handle_token_destroy;
 	wl_signal_add(&token->events.destroy, &token_data->destroy);
+
+	if (wl_list_empty(&activation_tokens.young)
+			&& wl_list_empty(&activation_tokens.old)) {
+		wl_event_source_timer_update(activation_tokens.timer,
+			XDG_ACTIVATION_TOKEN_PERIOD_MSEC);
+	}
+	wl_list_insert(activation_tokens.young.prev, &token_data->link);
 }
 
 static void
@@ -922,22 +1033,15 @@ xdg_toplevel_new(struct wl_listener *listener, void *data)
 
 	view_connect_map(view, xdg_surface->surface);
 
-	struct wlr_xdg_toplevel *toplevel = xdg_surface->toplevel;
-	CONNECT_SIGNAL(toplevel, view, destroy);
-	CONNECT_SIGNAL(toplevel, view, request_move);
-	CONNECT_SIGNAL(toplevel, view, request_resize);
-	CONNECT_SIGNAL(toplevel, view, request_minimize);
-	CONNECT_SIGNAL(toplevel, view, request_maximize);
-	CONNECT_SIGNAL(toplevel, view, request_fullscreen);
-	CONNECT_SIGNAL(toplevel, view, set_title);
-	CONNECT_SIGNAL(view->surface, view, commit);
-
-	/* Events specific to XDG toplevel views */
-	CONNECT_SIGNAL(toplevel, xdg_toplevel_view, set_app_id);
-	CONNECT_SIGNAL(xdg_surface, xdg_toplevel_view, new_popup);
+	lab_listeners_connect(xdg_surface->toplevel, xdg_toplevel_view,
+		toplevel_listeners, ARRAY_SIZE(toplevel_listeners));
+	lab_listeners_connect(xdg_surface, xdg_toplevel_view,
+		xdg_surface_listeners, ARRAY_SIZE(xdg_surface_listeners));
+	lab_listeners_connect(view->surface, xdg_toplevel_view,
+		surface_listeners, ARRAY_SIZE(surface_listeners));
 
 	view_init(view);
-	wl_list_insert(&server->views, &view->link);
+	view_stack_add(view);
 }
 
 void
@@ -959,6 +1063,13 @@ xdg_shell_init(struct server *server)
 		exit(EXIT_FAILURE);
 	}
 
+	/* Expired by handle_token_timer() instead */
+	server->xdg_activation->token_timeout_msec = 0;
+	wl_list_init(&activation_tokens.young);
+	wl_list_init(&activation_tokens.old);
+	activation_tokens.timer = wl_event_loop_add_timer(
+		server->wl_event_loop, handle_token_timer, NULL);
+
 	server->xdg_activation_request.notify = xdg_activation_handle_request;
 	wl_signal_add(&server->xdg_activation->events.request_activate,
 		&server->xdg_activation_request);
@@ -974,4 +1085,6 @@ xdg_shell_finish(struct server *server)
 	wl_list_remove(&server->new_xdg_toplevel.link);
 	wl_list_remove(&server->xdg_activation_request.link);
 	wl_list_remove(&server->xdg_activation_new_token.link);
+	wl_event_source_remove(activation_tokens.timer);
+	activation_tokens.timer = NULL;
 }
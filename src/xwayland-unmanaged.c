@@ -4,9 +4,32 @@
 #include "common/list.h"
 #include "common/macros.h"
 #include "common/mem.h"
+#include "common/slab.h"
 #include "labwc.h"
 #include "xwayland.h"
 
+/*
+ * Some clients create and destroy override-redirect surfaces for every
+ * tooltip or menu
+ */
+static struct lab_slab unmanaged_slab =
+	LAB_SLAB_INIT(struct xwayland_unmanaged);
+
+void
+xwayland_unmanaged_pool_finish(void)
+{
+	lab_slab_release(&unmanaged_slab);
+}
+
+static void
+add_focus_surface(struct xwayland_unmanaged *unmanaged)
+{
+	if (wl_list_empty(&unmanaged->focus_link)) {
+		wl_list_append(&unmanaged->server->unmanaged_focus_surfaces,
+			&unmanaged->focus_link);
+	}
+}
+
 static void
 handle_grab_focus(struct wl_listener *listener, void *data)
 {
@@ -15,6 +38,7 @@ handle_grab_focus(struct wl_listener *listener, void *data)
 
 	unmanaged->ever_grabbed_focus = true;
 	if (unmanaged->node) {
+		add_focus_surface(unmanaged);
 		assert(unmanaged->xwayland_surface->surface);
 		seat_focus_surface(&unmanaged->server->seat,
 			unmanaged->xwayland_surface->surface);
@@ -62,6 +86,7 @@ handle_map(struct wl_listener *listener, void *data)
 
 	if (wlr_xwayland_surface_override_redirect_wants_focus(xsurface)
 			|| unmanaged->ever_grabbed_focus) {
+		add_focus_surface(unmanaged);
 		seat_focus_surface(&unmanaged->server->seat, xsurface->surface);
 	}
 
@@ -77,15 +102,12 @@ static void
 focus_next_surface(struct server *server, struct wlr_xwayland_surface *xsurface)
 {
 	/* Try to focus on last created unmanaged xwayland surface */
-	struct xwayland_unmanaged *u;
-	struct wl_list *list = &server->unmanaged_surfaces;
-	wl_list_for_each_reverse(u, list, link) {
-		struct wlr_xwayland_surface *prev = u->xwayland_surface;
-		if (wlr_xwayland_surface_override_redirect_wants_focus(prev)
-				|| u->ever_grabbed_focus) {
-			seat_focus_surface(&server->seat, prev->surface);
-			return;
-		}
+	struct wl_list *list = &server->unmanaged_focus_surfaces;
+	if (!wl_list_empty(list)) {
+		struct xwayland_unmanaged *u =
+			wl_container_of(list->prev, u, focus_link);
+		seat_focus_surface(&server->seat, u->xwayland_surface->surface);
+		return;
 	}
 
 	/*
@@ -106,6 +128,8 @@ handle_unmap(struct wl_listener *listener, void *data)
 	assert(unmanaged->node);
 
 	wl_list_remove(&unmanaged->link);
+	wl_list_remove(&unmanaged->focus_link);
+	wl_list_init(&unmanaged->focus_link);
 	wl_list_remove(&unmanaged->set_geometry.link);
 	wlr_scene_node_set_enabled(unmanaged->node, false);
 
@@ -173,7 +197,7 @@ handle_destroy(struct wl_listener *listener, void *data)
 	wl_list_remove(&unmanaged->request_configure.link);
 	wl_list_remove(&unmanaged->set_override_redirect.link);
 	wl_list_remove(&unmanaged->destroy.link);
-	free(unmanaged);
+	lab_slab_free(&unmanaged_slab, unmanaged);
 }
 
 static void
@@ -227,9 +251,11 @@ void
 xwayland_unmanaged_create(struct server *server,
 		struct wlr_xwayland_surface *xsurface, bool mapped)
 {
-	struct xwayland_unmanaged *unmanaged = znew(*unmanaged);
+	struct xwayland_unmanaged *unmanaged =
+		lab_slab_new(&unmanaged_slab, *unmanaged);
 	unmanaged->server = server;
 	unmanaged->xwayland_surface = xsurface;
+	wl_list_init(&unmanaged->focus_link);
 	/*
 	 * xsurface->data is presumed to be a (struct view *) if set,
 	 * so it must be left NULL for an unmanaged surface (it should
@@ -2,8 +2,14 @@
 #include <stdbool.h>
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 #include <wlr/xwayland.h>
+#include "common/list.h"
+#include "common/listener.h"
 #include "common/macros.h"
 #include "common/mem.h"
 #include "config/rcxml.h"
@@ -12,6 +18,7 @@
 #include "labwc.h"
 #include "node.h"
 #include "ssd.h"
+#include "trace.h"
 #include "view.h"
 #include "view-impl-common.h"
 #include "window-rules.h"
@@ -19,6 +26,14 @@
 #include "xwayland.h"
 
 static void xwayland_view_unmap(struct view *view, bool client_request);
+static void handle_destroy(struct wl_listener *listener, void *data);
+
+static struct xwayland_view *
+xwayland_view_from_view(struct view *view)
+{
+	assert(view->type == LAB_XWAYLAND_VIEW);
+	return (struct xwayland_view *)view;
+}
 
 static bool
 xwayland_view_contains_window_type(struct view *view,
@@ -58,9 +73,11 @@ xwayland_view_contains_window_type(struct view *view,
 		"enum window_type does not match wlr_xwayland_net_wm_window_type");
 
 	assert(view);
-	struct wlr_xwayland_surface *surface = xwayland_surface_from_view(view);
-	return wlr_xwayland_surface_has_window_type(surface,
-		(enum wlr_xwayland_net_wm_window_type)window_type);
+	/* Compile-time check that the enum fits into the bitmask */
+	static_assert(WINDOW_TYPE_LEN <= 32, "too many window types");
+	assert(window_type >= 0 && window_type < WINDOW_TYPE_LEN);
+	return xwayland_view_from_view(view)->props.window_types
+		& (1u << window_type);
 }
 
 static struct view_size_hints
@@ -81,11 +98,8 @@ xwayland_view_get_size_hints(struct view *view)
 }
 
 static enum view_wants_focus
-xwayland_view_wants_focus(struct view *view)
+get_wants_focus(struct wlr_xwayland_surface *xsurface)
 {
-	struct wlr_xwayland_surface *xsurface =
-		xwayland_surface_from_view(view);
-
 	switch (wlr_xwayland_surface_icccm_input_model(xsurface)) {
 	/*
 	 * Abbreviated from ICCCM section 4.1.7 (Input Focus):
@@ -142,6 +156,12 @@ xwayland_view_wants_focus(struct view *view)
 	return VIEW_WANTS_FOCUS_NEVER;
 }
 
+static enum view_wants_focus
+xwayland_view_wants_focus(struct view *view)
+{
+	return xwayland_view_from_view(view)->props.wants_focus;
+}
+
 static bool
 xwayland_view_has_strut_partial(struct view *view)
 {
@@ -166,13 +186,6 @@ top_parent_of(struct view *view)
 	return s;
 }
 
-static struct xwayland_view *
-xwayland_view_from_view(struct view *view)
-{
-	assert(view->type == LAB_XWAYLAND_VIEW);
-	return (struct xwayland_view *)view;
-}
-
 struct wlr_xwayland_surface *
 xwayland_surface_from_view(struct view *view)
 {
@@ -230,6 +243,7 @@ want_deco(struct wlr_xwayland_surface *xwayland_surface)
 static void
 handle_commit(struct wl_listener *listener, void *data)
 {
+	TRACE_SCOPE("xwayland_commit");
 	struct view *view = wl_container_of(listener, view, commit);
 	assert(data && data == view->surface);
 
@@ -246,6 +260,10 @@ handle_commit(struct wl_listener *listener, void *data)
 	if (current->width != state->width || current->height != state->height) {
 		view_impl_apply_geometry(view, state->width, state->height);
 	}
+	if (view->pending.width == state->width
+			&& view->pending.height == state->height) {
+		transaction_view_done(view);
+	}
 }
 
 static void
@@ -302,48 +320,6 @@ handle_surface_destroy(struct wl_listener *listener, void *data)
 	wl_list_remove(&view->surface_destroy.link);
 }
 
-static void
-handle_destroy(struct wl_listener *listener, void *data)
-{
-	struct view *view = wl_container_of(listener, view, destroy);
-	struct xwayland_view *xwayland_view = xwayland_view_from_view(view);
-	assert(xwayland_view->xwayland_surface->data == view);
-
-	if (view->surface) {
-		/*
-		 * We got the destroy signal from
-		 * wlr_xwayland_surface before the
-		 * destroy signal from wlr_surface.
-		 */
-		wl_list_remove(&view->surface_destroy.link);
-	}
-	view->surface = NULL;
-
-	/*
-	 * Break view <-> xsurface association.  Note that the xsurface
-	 * may not actually be destroyed at this point; it may become an
-	 * "unmanaged" surface instead (in that case it is important
-	 * that xsurface->data not point to the destroyed view).
-	 */
-	xwayland_view->xwayland_surface->data = NULL;
-	xwayland_view->xwayland_surface = NULL;
-
-	/* Remove XWayland view specific listeners */
-	wl_list_remove(&xwayland_view->associate.link);
-	wl_list_remove(&xwayland_view->dissociate.link);
-	wl_list_remove(&xwayland_view->request_activate.link);
-	wl_list_remove(&xwayland_view->request_configure.link);
-	wl_list_remove(&xwayland_view->set_class.link);
-	wl_list_remove(&xwayland_view->set_decorations.link);
-	wl_list_remove(&xwayland_view->set_override_redirect.link);
-	wl_list_remove(&xwayland_view->set_strut_partial.link);
-	wl_list_remove(&xwayland_view->set_window_type.link);
-	wl_list_remove(&xwayland_view->focus_in.link);
-	wl_list_remove(&xwayland_view->map_request.link);
-
-	view_destroy(view);
-}
-
 static void
 xwayland_view_configure(struct view *view, struct wlr_box geo)
 {
@@ -368,6 +344,9 @@ xwayland_view_configure(struct view *view, struct wlr_box geo)
 		view->current.x = geo.x;
 		view->current.y = geo.y;
 		view_moved(view);
+	} else {
+		/* Resized, handle_commit() completes the transaction */
+		transaction_add_view(view);
 	}
 }
 
@@ -524,10 +503,39 @@ handle_set_decorations(struct wl_listener *listener, void *data)
 	}
 }
 
+static void
+update_cached_props(struct xwayland_view *xwayland_view)
+{
+	struct wlr_xwayland_surface *xsurface = xwayland_view->xwayland_surface;
+
+	uint32_t window_types = 0;
+	for (int type = 0; type < WINDOW_TYPE_LEN; type++) {
+		if (wlr_xwayland_surface_has_window_type(xsurface,
+				(enum wlr_xwayland_net_wm_window_type)type)) {
+			window_types |= 1u << type;
+		}
+	}
+	xwayland_view->props.window_types = window_types;
+	xwayland_view->props.wants_focus = get_wants_focus(xsurface);
+}
+
 static void
 handle_set_window_type(struct wl_listener *listener, void *data)
 {
-	/* Intentionally left blank */
+	struct xwayland_view *xwayland_view =
+		wl_container_of(listener, xwayland_view, set_window_type);
+	update_cached_props(xwayland_view);
+	/* Window rules can match on the window type */
+	window_rules_invalidate(&xwayland_view->base);
+}
+
+static void
+handle_set_hints(struct wl_listener *listener, void *data)
+{
+	struct xwayland_view *xwayland_view =
+		wl_container_of(listener, xwayland_view, set_hints);
+	/* The input field of WM_HINTS selects the ICCCM input model */
+	update_cached_props(xwayland_view);
 }
 
 static void
@@ -548,6 +556,29 @@ handle_set_override_redirect(struct wl_listener *listener, void *data)
 	xwayland_unmanaged_create(server, xsurface, mapped);
 }
 
+/*
+ * Keep server.xwayland_strut_views in sync with the views which have to
+ * be considered by xwayland_adjust_usable_area(). Returns true if the
+ * usable areas need to be recomputed.
+ */
+static bool
+update_strut_view(struct xwayland_view *xwayland_view)
+{
+	struct view *view = &xwayland_view->base;
+	bool listed = !wl_list_empty(&xwayland_view->strut_link);
+	bool has_strut = view->mapped && xwayland_view->xwayland_surface
+		&& xwayland_view->xwayland_surface->strut_partial;
+
+	if (has_strut && !listed) {
+		wl_list_append(&view->server->xwayland_strut_views,
+			&xwayland_view->strut_link);
+	} else if (!has_strut && listed) {
+		wl_list_remove(&xwayland_view->strut_link);
+		wl_list_init(&xwayland_view->strut_link);
+	}
+	return has_strut || listed;
+}
+
 static void
 handle_set_strut_partial(struct wl_listener *listener, void *data)
 {
@@ -555,8 +586,8 @@ handle_set_strut_partial(struct wl_listener *listener, void *data)
 		wl_container_of(listener, xwayland_view, set_strut_partial);
 	struct view *view = &xwayland_view->base;
 
-	if (view->mapped) {
-		output_update_all_usable_areas(view->server, false);
+	if (update_strut_view(xwayland_view)) {
+		output_schedule_all_usable_areas_update(view->server);
 	}
 }
 
@@ -597,6 +628,68 @@ handle_map_request(struct wl_listener *listener, void *data)
 
 }
 
+#define XSURFACE_LISTENER(member, name) LAB_LISTENER( \
+	struct wlr_xwayland_surface, struct xwayland_view, member, name)
+
+static const struct lab_listener_binding xsurface_listeners[] = {
+	XSURFACE_LISTENER(base.destroy, destroy),
+	XSURFACE_LISTENER(base.request_minimize, request_minimize),
+	XSURFACE_LISTENER(base.request_maximize, request_maximize),
+	XSURFACE_LISTENER(base.request_fullscreen, request_fullscreen),
+	XSURFACE_LISTENER(base.request_move, request_move),
+	XSURFACE_LISTENER(base.request_resize, request_resize),
+	XSURFACE_LISTENER(base.set_title, set_title),
+
+	/* Events specific to XWayland views */
+	XSURFACE_LISTENER(associate, associate),
+	XSURFACE_LISTENER(dissociate, dissociate),
+	XSURFACE_LISTENER(request_activate, request_activate),
+	XSURFACE_LISTENER(request_configure, request_configure),
+	XSURFACE_LISTENER(set_class, set_class),
+	XSURFACE_LISTENER(set_decorations, set_decorations),
+	XSURFACE_LISTENER(set_override_redirect, set_override_redirect),
+	XSURFACE_LISTENER(set_strut_partial, set_strut_partial),
+	XSURFACE_LISTENER(set_window_type, set_window_type),
+	XSURFACE_LISTENER(focus_in, focus_in),
+	XSURFACE_LISTENER(map_request, map_request),
+	XSURFACE_LISTENER(set_hints, set_hints),
+};
+
+#undef XSURFACE_LISTENER
+
+static void
+handle_destroy(struct wl_listener *listener, void *data)
+{
+	struct view *view = wl_container_of(listener, view, destroy);
+	struct xwayland_view *xwayland_view = xwayland_view_from_view(view);
+	assert(xwayland_view->xwayland_surface->data == view);
+
+	if (view->surface) {
+		/*
+		 * We got the destroy signal from
+		 * wlr_xwayland_surface before the
+		 * destroy signal from wlr_surface.
+		 */
+		wl_list_remove(&view->surface_destroy.link);
+	}
+	view->surface = NULL;
+
+	/*
+	 * Break view <-> xsurface association.  Note that the xsurface
+	 * may not actually be destroyed at this point; it may become an
+	 * "unmanaged" surface instead (in that case it is important
+	 * that xsurface->data not point to the destroyed view).
+	 */
+	xwayland_view->xwayland_surface->data = NULL;
+	xwayland_view->xwayland_surface = NULL;
+
+	lab_listeners_disconnect(xwayland_view, xsurface_listeners,
+		ARRAY_SIZE(xsurface_listeners));
+	wl_list_remove(&xwayland_view->strut_link);
+
+	view_destroy(view);
+}
+
 static void
 check_natural_geometry(struct view *view)
 {
@@ -699,6 +792,9 @@ xwayland_view_map(struct view *view)
 	 */
 	handle_map_request(&xwayland_view->map_request, NULL);
 
+	/* WM_PROTOCOLS, which is part of the input model, has no event */
+	update_cached_props(xwayland_view);
+
 	view->mapped = true;
 	wlr_scene_node_set_enabled(&view->scene_tree->node, true);
 
@@ -757,8 +853,8 @@ xwayland_view_map(struct view *view)
 	view->been_mapped = true;
 
 	/* Update usable area to account for XWayland "struts" (panels) */
-	if (xwayland_surface->strut_partial) {
-		output_update_all_usable_areas(view->server, false);
+	if (update_strut_view(xwayland_view_from_view(view))) {
+		output_schedule_all_usable_areas_update(view->server);
 	}
 }
 
@@ -774,8 +870,8 @@ xwayland_view_unmap(struct view *view, bool client_request)
 	view_impl_unmap(view);
 
 	/* Update usable area to account for XWayland "struts" (panels) */
-	if (xwayland_surface_from_view(view)->strut_partial) {
-		output_update_all_usable_areas(view->server, false);
+	if (update_strut_view(xwayland_view_from_view(view))) {
+		output_schedule_all_usable_areas_update(view->server);
 	}
 
 	/*
@@ -923,34 +1019,18 @@ xwayland_view_create(struct server *server,
 	 */
 	xwayland_view->xwayland_surface = xsurface;
 	xsurface->data = view;
+	wl_list_init(&xwayland_view->strut_link);
 
 	view->workspace = server->workspaces.current;
 	view->scene_tree = wlr_scene_tree_create(view->workspace->tree);
 	node_descriptor_create(&view->scene_tree->node, LAB_NODE_DESC_VIEW, view);
 
-	CONNECT_SIGNAL(xsurface, view, destroy);
-	CONNECT_SIGNAL(xsurface, view, request_minimize);
-	CONNECT_SIGNAL(xsurface, view, request_maximize);
-	CONNECT_SIGNAL(xsurface, view, request_fullscreen);
-	CONNECT_SIGNAL(xsurface, view, request_move);
-	CONNECT_SIGNAL(xsurface, view, request_resize);
-	CONNECT_SIGNAL(xsurface, view, set_title);
-
-	/* Events specific to XWayland views */
-	CONNECT_SIGNAL(xsurface, xwayland_view, associate);
-	CONNECT_SIGNAL(xsurface, xwayland_view, dissociate);
-	CONNECT_SIGNAL(xsurface, xwayland_view, request_activate);
-	CONNECT_SIGNAL(xsurface, xwayland_view, request_configure);
-	CONNECT_SIGNAL(xsurface, xwayland_view, set_class);
-	CONNECT_SIGNAL(xsurface, xwayland_view, set_decorations);
-	CONNECT_SIGNAL(xsurface, xwayland_view, set_override_redirect);
-	CONNECT_SIGNAL(xsurface, xwayland_view, set_strut_partial);
-	CONNECT_SIGNAL(xsurface, xwayland_view, set_window_type);
-	CONNECT_SIGNAL(xsurface, xwayland_view, focus_in);
-	CONNECT_SIGNAL(xsurface, xwayland_view, map_request);
+	lab_listeners_connect(xsurface, xwayland_view, xsurface_listeners,
+		ARRAY_SIZE(xsurface_listeners));
 
+	update_cached_props(xwayland_view);
 	view_init(view);
-	wl_list_insert(&view->server->views, &view->link);
+	view_stack_add(view);
 
 	if (xsurface->surface) {
 		handle_associate(&xwayland_view->associate, NULL);
@@ -984,6 +1064,7 @@ handle_server_ready(struct wl_listener *listener, void *data)
 {
 	/* Fire an Xwayland startup script if one (or many) can be found */
 	session_run_script("xinitrc");
+	session_autostart_stage(LAB_AUTOSTART_AFTER_XWAYLAND);
 }
 
 static void
@@ -992,15 +1073,51 @@ handle_xwm_ready(struct wl_listener *listener, void *data)
 	struct server *server =
 		wl_container_of(listener, server, xwayland_xwm_ready);
 	wlr_xwayland_set_seat(server->xwayland, server->seat.seat);
+	/* A new XWM has no workarea yet */
+	server->xwayland_workarea = (struct wlr_box){0};
 	xwayland_update_workarea(server);
 }
 
+static struct wlr_xwayland *
+create_warm_xwayland(struct server *server, struct wlr_compositor *compositor)
+{
+	/*
+	 * Lazy like the default policy, so that the X11 sockets and DISPLAY
+	 * exist right away, but never terminated once it has been started
+	 */
+	struct wlr_xwayland_server_options options = {
+		.lazy = true,
+		.enable_wm = true,
+		.terminate_delay = 0,
+	};
+	server->xwayland_warm_server =
+		wlr_xwayland_server_create(server->wl_display, &options);
+	if (!server->xwayland_warm_server) {
+		return NULL;
+	}
+	struct wlr_xwayland *xwayland = wlr_xwayland_create_with_server(
+		server->wl_display, compositor, server->xwayland_warm_server);
+	if (!xwayland) {
+		wlr_xwayland_server_destroy(server->xwayland_warm_server);
+		server->xwayland_warm_server = NULL;
+		return NULL;
+	}
+	server->xwayland_warm_pending = true;
+	return xwayland;
+}
+
 void
 xwayland_server_init(struct server *server, struct wlr_compositor *compositor)
 {
-	server->xwayland =
-		wlr_xwayland_create(server->wl_display,
+	wl_list_init(&server->xwayland_strut_views);
+	server->xwayland_workarea = (struct wlr_box){0};
+
+	if (rc.xwayland_warm_start) {
+		server->xwayland = create_warm_xwayland(server, compositor);
+	} else {
+		server->xwayland = wlr_xwayland_create(server->wl_display,
 			compositor, /* lazy */ !rc.xwayland_persistence);
+	}
 	if (!server->xwayland) {
 		wlr_log(WLR_ERROR, "cannot create xwayland server");
 		exit(EXIT_FAILURE);
@@ -1086,6 +1203,55 @@ xwayland_reset_cursor(struct server *server)
 	}
 }
 
+/*
+ * A lazy xwayland server is started by the first connection to one of its
+ * X11 sockets, so connect once and let Xwayland deal with the hang-up
+ */
+static void
+trigger_lazy_start(struct wlr_xwayland_server *xserver)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "/tmp/.X11-unix/X%d",
+		xserver->display);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot create socket");
+		return;
+	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot connect to %s", addr.sun_path);
+	}
+	close(fd);
+}
+
+void
+xwayland_output_presented(struct server *server)
+{
+	if (!server->xwayland_warm_pending) {
+		return;
+	}
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output_is_usable(output)
+				&& !output->repaint.last_present_nsec) {
+			return;
+		}
+	}
+	server->xwayland_warm_pending = false;
+
+	struct wlr_xwayland_server *xserver = server->xwayland->server;
+	if (xserver->pid) {
+		/* Already started on demand by an X11 client */
+		return;
+	}
+	wlr_log(WLR_DEBUG, "starting xwayland on display %s",
+		xserver->display_name);
+	/* Hand the current cursor theme to the server before it starts */
+	xwayland_reset_cursor(server);
+	trigger_lazy_start(xserver);
+}
+
 void
 xwayland_server_finish(struct server *server)
 {
@@ -1100,6 +1266,14 @@ xwayland_server_finish(struct server *server)
 	 */
 	server->xwayland = NULL;
 	wlr_xwayland_destroy(xwayland);
+	xwayland_unmanaged_pool_finish();
+
+	/* Not owned by wlr_xwayland when created with a separate server */
+	if (server->xwayland_warm_server) {
+		wlr_xwayland_server_destroy(server->xwayland_warm_server);
+		server->xwayland_warm_server = NULL;
+	}
+	server->xwayland_warm_pending = false;
 }
 
 static bool
@@ -1118,32 +1292,13 @@ intervals_overlap(int start_a, int end_a, int start_b, int end_b)
 /*
  * Subtract the area of an XWayland view (e.g. panel) from the usable
  * area of the output based on _NET_WM_STRUT_PARTIAL property.
+ * @lb and @ob are the layout boxes of the whole layout and of @output.
  */
-void
-xwayland_adjust_usable_area(struct view *view, struct wlr_output_layout *layout,
-		struct wlr_output *output, struct wlr_box *usable)
+static void
+adjust_usable_area(xcb_ewmh_wm_strut_partial_t *strut,
+		struct wlr_output_layout *layout, struct wlr_output *output,
+		struct wlr_box lb, struct wlr_box ob, struct wlr_box *usable)
 {
-	assert(view);
-	assert(layout);
-	assert(output);
-	assert(usable);
-
-	if (view->type != LAB_XWAYLAND_VIEW) {
-		return;
-	}
-
-	xcb_ewmh_wm_strut_partial_t *strut =
-		xwayland_surface_from_view(view)->strut_partial;
-	if (!strut) {
-		return;
-	}
-
-	/* these are layout coordinates */
-	struct wlr_box lb = { 0 };
-	wlr_output_layout_get_box(layout, NULL, &lb);
-	struct wlr_box ob = { 0 };
-	wlr_output_layout_get_box(layout, output, &ob);
-
 	/*
 	 * strut->right/bottom are offsets from the lower right corner
 	 * of the X11 screen, which should generally correspond with the
@@ -1191,8 +1346,35 @@ xwayland_adjust_usable_area(struct view *view, struct wlr_output_layout *layout,
 }
 
 void
-xwayland_update_workarea(struct server *server)
+xwayland_adjust_usable_area(struct server *server, struct wlr_output *output,
+		struct wlr_box *usable)
 {
+	assert(output);
+	assert(usable);
+
+	if (wl_list_empty(&server->xwayland_strut_views)) {
+		return;
+	}
+
+	/* these are layout coordinates */
+	struct wlr_output_layout *layout = server->output_layout;
+	struct wlr_box lb = { 0 };
+	wlr_output_layout_get_box(layout, NULL, &lb);
+	struct wlr_box ob = { 0 };
+	wlr_output_layout_get_box(layout, output, &ob);
+
+	struct xwayland_view *xwayland_view;
+	wl_list_for_each(xwayland_view, &server->xwayland_strut_views,
+			strut_link) {
+		adjust_usable_area(xwayland_view->xwayland_surface->strut_partial,
+			layout, output, lb, ob, usable);
+	}
+}
+
+static void
+update_workarea(void *data)
+{
+	struct server *server = data;
 	/*
 	 * Do nothing if called during destroy or before xwayland is ready.
 	 * This function will be called again from the ready signal handler.
@@ -1266,5 +1448,19 @@ xwayland_update_workarea(struct server *server)
 		.width = workarea_right - workarea_left,
 		.height = workarea_bottom - workarea_top,
 	};
+	if (wlr_box_equal(&workarea, &server->xwayland_workarea)) {
+		return;
+	}
+	server->xwayland_workarea = workarea;
 	wlr_xwayland_set_workareas(server->xwayland, &workarea, 1);
 }
+
+void
+xwayland_update_workarea(struct server *server)
+{
+	static struct deferred_task task = {
+		.func = update_workarea,
+	};
+	task.data = server;
+	deferred_task_schedule(&server->deferred, &task);
+}
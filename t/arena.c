@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <cmocka.h>
+#include "common/arena.h"
+
+static void
+test_arena_alloc(void **state)
+{
+	(void)state;
+
+	struct lab_arena arena = {0};
+	char *prev = NULL;
+	for (int i = 1; i < 1000; i++) {
+		char *ptr = lab_arena_alloc(&arena, i % 37);
+		assert_non_null(ptr);
+		/* Zeroed and aligned for any type */
+		for (int j = 0; j < i % 37; j++) {
+			assert_int_equal(ptr[j], 0);
+		}
+		assert_int_equal((uintptr_t)ptr % _Alignof(max_align_t), 0);
+		assert_ptr_not_equal(ptr, prev);
+		memset(ptr, 0xff, i % 37);
+		prev = ptr;
+	}
+
+	/* Bigger than a chunk */
+	char *big = lab_arena_alloc(&arena, 1024 * 1024);
+	assert_int_equal(big[1024 * 1024 - 1], 0);
+	assert_true(arena.bytes >= 1024 * 1024);
+
+	lab_arena_release(&arena);
+	assert_null(arena.chunks);
+	assert_int_equal(arena.bytes, 0);
+}
+
+static void
+test_arena_strdup(void **state)
+{
+	(void)state;
+
+	struct lab_arena arena = {0};
+	char *a = lab_arena_strdup(&arena, "keybind");
+	char *b = lab_arena_strdup(&arena, "");
+	char *c = lab_arena_strdup(&arena, "window rule");
+	assert_string_equal(a, "keybind");
+	assert_string_equal(b, "");
+	assert_string_equal(c, "window rule");
+	lab_arena_release(&arena);
+
+	/* Reusable after release */
+	assert_string_equal(lab_arena_strdup(&arena, "again"), "again");
+	lab_arena_release(&arena);
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_arena_alloc),
+		cmocka_unit_test(test_arena_strdup),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
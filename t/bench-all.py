@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# Runs bench, bench-parse and bench-headless and compares their results
+# with a baseline, failing if any of them got slower by more than the
+# threshold of the baseline. Run through the 'bench-all' target, or the
+# 'bench-baseline' target to replace the baseline with the current results.
+#
+# The benchmarks only use fixed inputs, so results differ between runs by
+# timing noise alone. Each result is identified by a key like
+# "bench/buf_add": the name of the program followed by the workload.
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+DEFAULT_THRESHOLD_PERCENT = 25
+
+# Lines of the compositor log, see main.c, output-timing.c and probe.c
+STARTUP_RE = re.compile(r'startup: (.+) took ([0-9.]+) ms')
+FRAME_OUTPUT_RE = re.compile(r'frame timing for (\S+?): ')
+FRAME_PHASE_RE = re.compile(r'\] +(\S+) +p50=([0-9.]+)ms')
+PROBE_RE = re.compile(r'(\w+): (\d+) calls, mean=([0-9.]+)ms')
+
+def run(argv, capture_stderr=False):
+	print('running', ' '.join(argv), file=sys.stderr)
+	result = subprocess.run(argv, stdout=subprocess.PIPE,
+		stderr=subprocess.PIPE if capture_stderr else None,
+		env=dict(os.environ, LC_ALL='C'), text=True)
+	if result.returncode != 0:
+		if capture_stderr:
+			sys.stderr.write(result.stderr)
+		sys.exit('{} failed with status {}'.format(argv[0],
+			result.returncode))
+	return result
+
+def run_bench(path):
+	output = json.loads(run([path]).stdout)
+	return {'bench/' + b['name']: (b['median_ns_per_op'], 'ns/op')
+		for b in output['benchmarks']}
+
+def run_bench_parse(path, files):
+	output = json.loads(run([path] + files).stdout)
+	results = {}
+	for b in output['benchmarks']:
+		if b['count']:
+			key = 'parse/{}/{}'.format(b['name'], b['count'])
+		else:
+			key = 'parse/' + os.path.basename(b['name'])
+		results[key] = (b['parse_ms'], 'ms')
+	return results
+
+def run_bench_headless(path, compositor, windows):
+	result = run([path, '-c', compositor, '-n', str(windows)],
+		capture_stderr=True)
+	output = json.loads(result.stdout)
+	results = {'headless/' + w['name']: (w['mean_ms'], 'ms')
+		for w in output['workloads']}
+	output_name = None
+	for line in result.stderr.splitlines():
+		match = STARTUP_RE.search(line)
+		if match:
+			key = 'headless/startup/' + match.group(1).replace(' ', '_')
+			results[key] = (float(match.group(2)), 'ms')
+			continue
+		match = FRAME_OUTPUT_RE.search(line)
+		if match:
+			output_name = match.group(1)
+			continue
+		match = FRAME_PHASE_RE.search(line)
+		if match and output_name:
+			key = 'headless/frame/{}/{}'.format(output_name,
+				match.group(1))
+			results[key] = (float(match.group(2)), 'ms p50')
+			continue
+		match = PROBE_RE.search(line)
+		if match:
+			results['headless/probe/' + match.group(1)] = \
+				(float(match.group(3)), 'ms')
+	return results
+
+def compare(baseline, results, threshold):
+	regressions = []
+	rows = []
+	for key in sorted(set(baseline) | set(results)):
+		old = baseline.get(key)
+		new = results.get(key)
+		if new is None:
+			rows.append((key, old['value'], None, 'missing'))
+			continue
+		value, unit = new
+		if old is None:
+			rows.append((key, None, value, 'new'))
+			continue
+		change = (value - old['value']) / old['value'] * 100 \
+			if old['value'] else 0
+		status = '{:+.1f}%'.format(change)
+		if change > threshold:
+			status += ' REGRESSION'
+			regressions.append(key)
+		rows.append((key, old['value'], value, status))
+
+	width = max([len(row[0]) for row in rows] + [len('result')])
+	print('{:<{}} {:>14} {:>14}  {}'.format('result', width,
+		'baseline', 'current', 'change'))
+	for key, old, new, status in rows:
+		print('{:<{}} {:>14} {:>14}  {}'.format(key, width,
+			'-' if old is None else '{:.3f}'.format(old),
+			'-' if new is None else '{:.3f}'.format(new), status))
+	return regressions
+
+def main():
+	parser = argparse.ArgumentParser()
+	parser.add_argument('--baseline', required=True)
+	parser.add_argument('--update', action='store_true',
+		help='write the results to the baseline instead of comparing')
+	parser.add_argument('--bench')
+	parser.add_argument('--bench-parse')
+	parser.add_argument('--parse-file', action='append', default=[])
+	parser.add_argument('--bench-headless')
+	parser.add_argument('--compositor')
+	parser.add_argument('--windows', type=int, default=500)
+	args = parser.parse_args()
+
+	results = {}
+	if args.bench:
+		results.update(run_bench(args.bench))
+	if args.bench_parse:
+		results.update(run_bench_parse(args.bench_parse, args.parse_file))
+	if args.bench_headless and args.compositor:
+		results.update(run_bench_headless(args.bench_headless,
+			args.compositor, args.windows))
+
+	try:
+		with open(args.baseline) as f:
+			baseline = json.load(f)
+	except FileNotFoundError:
+		baseline = {}
+	threshold = baseline.get('threshold_percent', DEFAULT_THRESHOLD_PERCENT)
+
+	if args.update:
+		baseline = {
+			'threshold_percent': threshold,
+			'results': {key: {'value': value, 'unit': unit}
+				for key, (value, unit) in sorted(results.items())},
+		}
+		with open(args.baseline, 'w') as f:
+			json.dump(baseline, f, indent=2)
+			f.write('\n')
+		print('wrote {} results to {}'.format(len(results), args.baseline))
+		return
+
+	regressions = compare(baseline.get('results', {}), results, threshold)
+	if regressions:
+		sys.exit('{} result(s) regressed by more than {}%: {}'.format(
+			len(regressions), threshold, ', '.join(regressions)))
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,600 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Scene benchmark on the headless backend
+ *
+ * The compositor is started on the headless backend with a generated
+ * configuration and this program as its primary client. The client maps a
+ * number of windows and then drives region snapping, alt-tab cycling,
+ * workspace switching and output hotplug through keybinds of a virtual
+ * keyboard, so all of it goes through the same paths as real input.
+ *
+ * The client prints the wall-clock time of each workload as JSON. Every
+ * step ends with a roundtrip, so it includes the time the compositor needed
+ * to handle it. The compositor logs its frame timing summary, including the
+ * run time of placement_find_best(), workspaces_switch_to() and
+ * get_cursor_context(), before the client exits.
+ *
+ * Usage: bench-headless [-c <compositor>] [-n <windows>]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/input-event-codes.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <xkbcommon/xkbcommon.h>
+#include "virtual-keyboard-unstable-v1-client-protocol.h"
+#include "xdg-shell-client-protocol.h"
+
+#define WINDOW_WIDTH 320
+#define WINDOW_HEIGHT 240
+
+#define ALT_TAB_CYCLES 50
+#define WORKSPACE_SWITCHES 100
+#define REGION_SNAPS 100
+#define OUTPUT_HOTPLUGS 10
+
+/* Keys need the logo modifier, see the keybinds in rc_xml below */
+#define KEY_NEXT_WINDOW KEY_F1
+#define KEY_NEXT_WORKSPACE KEY_F2
+#define KEY_SNAP_LEFT KEY_F3
+#define KEY_SNAP_RIGHT KEY_F4
+#define KEY_OUTPUT_ADD KEY_F5
+#define KEY_OUTPUT_REMOVE KEY_F6
+#define KEY_DUMP_TIMING KEY_F7
+
+static const char rc_xml[] =
+	"<?xml version=\"1.0\"?>\n"
+	"<labwc_config>\n"
+	"  <core>\n"
+	"    <frameTiming>yes</frameTiming>\n"
+	"    <frameTimingLogInterval>0</frameTimingLogInterval>\n"
+	"  </core>\n"
+	"  <placement><policy>automatic</policy></placement>\n"
+	"  <desktops number=\"4\" />\n"
+	"  <regions>\n"
+	"    <region name=\"left\" x=\"0%\" y=\"0%\" width=\"50%\" height=\"100%\" />\n"
+	"    <region name=\"right\" x=\"50%\" y=\"0%\" width=\"50%\" height=\"100%\" />\n"
+	"  </regions>\n"
+	"  <keyboard>\n"
+	"    <keybind key=\"W-F1\"><action name=\"NextWindow\" /></keybind>\n"
+	"    <keybind key=\"W-F2\">\n"
+	"      <action name=\"GoToDesktop\" to=\"right\" wrap=\"yes\" />\n"
+	"    </keybind>\n"
+	"    <keybind key=\"W-F3\">\n"
+	"      <action name=\"SnapToRegion\" region=\"left\" />\n"
+	"    </keybind>\n"
+	"    <keybind key=\"W-F4\">\n"
+	"      <action name=\"SnapToRegion\" region=\"right\" />\n"
+	"    </keybind>\n"
+	"    <keybind key=\"W-F5\">\n"
+	"      <action name=\"VirtualOutputAdd\" output_name=\"BENCH-1\" />\n"
+	"    </keybind>\n"
+	"    <keybind key=\"W-F6\">\n"
+	"      <action name=\"VirtualOutputRemove\" output_name=\"BENCH-1\" />\n"
+	"    </keybind>\n"
+	"    <keybind key=\"W-F7\"><action name=\"DumpFrameTiming\" /></keybind>\n"
+	"  </keyboard>\n"
+	"</labwc_config>\n";
+
+struct window {
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *xdg_toplevel;
+};
+
+struct client {
+	struct wl_display *display;
+	struct wl_compositor *compositor;
+	struct wl_shm *shm;
+	struct wl_seat *seat;
+	struct xdg_wm_base *wm_base;
+	struct zwp_virtual_keyboard_manager_v1 *keyboard_manager;
+
+	struct wl_buffer *buffer;
+	struct zwp_virtual_keyboard_v1 *keyboard;
+	uint32_t logo_mask;
+
+	struct window *windows;
+	int nr_windows;
+	bool frame_done;
+	bool first_result;
+};
+
+static int64_t
+now_nsec(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static uint32_t
+now_msec(void)
+{
+	return (uint32_t)(now_nsec() / 1000000);
+}
+
+static void
+report(struct client *client, const char *name, int count, int64_t start)
+{
+	double total_ms = (now_nsec() - start) / 1e6;
+	printf("%s\n    {\"name\": \"%s\", \"count\": %d, \"total_ms\": %.3f, "
+		"\"mean_ms\": %.3f}", client->first_result ? "" : ",", name,
+		count, total_ms, total_ms / count);
+	fflush(stdout);
+	client->first_result = false;
+}
+
+static void
+handle_wm_base_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial)
+{
+	xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = handle_wm_base_ping,
+};
+
+static void
+handle_global(void *data, struct wl_registry *registry, uint32_t name,
+		const char *interface, uint32_t version)
+{
+	struct client *client = data;
+	if (!strcmp(interface, wl_compositor_interface.name)) {
+		client->compositor = wl_registry_bind(registry, name,
+			&wl_compositor_interface, 4);
+	} else if (!strcmp(interface, wl_shm_interface.name)) {
+		client->shm = wl_registry_bind(registry, name,
+			&wl_shm_interface, 1);
+	} else if (!strcmp(interface, wl_seat_interface.name) && !client->seat) {
+		client->seat = wl_registry_bind(registry, name,
+			&wl_seat_interface, 1);
+	} else if (!strcmp(interface, xdg_wm_base_interface.name)) {
+		client->wm_base = wl_registry_bind(registry, name,
+			&xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(client->wm_base, &wm_base_listener,
+			client);
+	} else if (!strcmp(interface,
+			zwp_virtual_keyboard_manager_v1_interface.name)) {
+		client->keyboard_manager = wl_registry_bind(registry, name,
+			&zwp_virtual_keyboard_manager_v1_interface, 1);
+	}
+}
+
+static void
+handle_global_remove(void *data, struct wl_registry *registry, uint32_t name)
+{
+	/* Outputs come and go during the hotplug workload */
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = handle_global,
+	.global_remove = handle_global_remove,
+};
+
+static int
+create_memfd(const void *data, size_t size)
+{
+	int fd = memfd_create("labwc-bench", MFD_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		return -1;
+	}
+	if (data && write(fd, data, size) != (ssize_t)size) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* One buffer is shared by all windows, it is never written to again */
+static bool
+create_buffer(struct client *client)
+{
+	int stride = WINDOW_WIDTH * 4;
+	size_t size = (size_t)stride * WINDOW_HEIGHT;
+	int fd = create_memfd(NULL, size);
+	if (fd < 0) {
+		return false;
+	}
+	uint32_t *pixels = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	if (pixels == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+	for (size_t i = 0; i < size / 4; i++) {
+		pixels[i] = 0xff336699;
+	}
+	munmap(pixels, size);
+
+	struct wl_shm_pool *pool = wl_shm_create_pool(client->shm, fd, size);
+	client->buffer = wl_shm_pool_create_buffer(pool, 0, WINDOW_WIDTH,
+		WINDOW_HEIGHT, stride, WL_SHM_FORMAT_XRGB8888);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+	return true;
+}
+
+static bool
+create_keyboard(struct client *client)
+{
+	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+	if (!context) {
+		return false;
+	}
+	struct xkb_rule_names names = { .layout = "us" };
+	struct xkb_keymap *keymap = xkb_keymap_new_from_names(context, &names,
+		XKB_KEYMAP_COMPILE_NO_FLAGS);
+	if (!keymap) {
+		xkb_context_unref(context);
+		return false;
+	}
+	client->logo_mask = 1u << xkb_keymap_mod_get_index(keymap,
+		XKB_MOD_NAME_LOGO);
+
+	char *string = xkb_keymap_get_as_string(keymap,
+		XKB_KEYMAP_FORMAT_TEXT_V1);
+	size_t size = strlen(string) + 1;
+	int fd = create_memfd(string, size);
+	free(string);
+	xkb_keymap_unref(keymap);
+	xkb_context_unref(context);
+	if (fd < 0) {
+		return false;
+	}
+
+	client->keyboard = zwp_virtual_keyboard_manager_v1_create_virtual_keyboard(
+		client->keyboard_manager, client->seat);
+	zwp_virtual_keyboard_v1_keymap(client->keyboard,
+		WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, fd, size);
+	close(fd);
+	return true;
+}
+
+static void
+set_logo(struct client *client, bool pressed)
+{
+	zwp_virtual_keyboard_v1_modifiers(client->keyboard,
+		pressed ? client->logo_mask : 0, 0, 0, 0);
+}
+
+static void
+tap_key(struct client *client, uint32_t key)
+{
+	zwp_virtual_keyboard_v1_key(client->keyboard, now_msec(), key,
+		WL_KEYBOARD_KEY_STATE_PRESSED);
+	zwp_virtual_keyboard_v1_key(client->keyboard, now_msec(), key,
+		WL_KEYBOARD_KEY_STATE_RELEASED);
+}
+
+/* Press logo+@key and wait until the compositor has handled the keybind */
+static void
+run_keybind(struct client *client, uint32_t key)
+{
+	set_logo(client, true);
+	tap_key(client, key);
+	set_logo(client, false);
+	wl_display_roundtrip(client->display);
+}
+
+static void
+handle_xdg_surface_configure(void *data, struct xdg_surface *xdg_surface,
+		uint32_t serial)
+{
+	struct window *window = data;
+	xdg_surface_ack_configure(xdg_surface, serial);
+	/* The buffer size is kept, which is fine for floating windows */
+	wl_surface_commit(window->surface);
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = handle_xdg_surface_configure,
+};
+
+static void
+handle_toplevel_configure(void *data, struct xdg_toplevel *toplevel,
+		int32_t width, int32_t height, struct wl_array *states)
+{
+}
+
+static void
+handle_toplevel_close(void *data, struct xdg_toplevel *toplevel)
+{
+}
+
+static const struct xdg_toplevel_listener toplevel_listener = {
+	.configure = handle_toplevel_configure,
+	.close = handle_toplevel_close,
+};
+
+static void
+handle_frame_done(void *data, struct wl_callback *callback, uint32_t time)
+{
+	struct client *client = data;
+	client->frame_done = true;
+	wl_callback_destroy(callback);
+}
+
+static const struct wl_callback_listener frame_listener = {
+	.done = handle_frame_done,
+};
+
+/*
+ * Wait for the next frame event of @window, which is sent once the
+ * compositor has rendered the current state. Gives up after one second,
+ * for example if the window is not visible.
+ */
+static bool
+wait_frame(struct client *client, struct window *window)
+{
+	client->frame_done = false;
+	struct wl_callback *callback = wl_surface_frame(window->surface);
+	wl_callback_add_listener(callback, &frame_listener, client);
+	wl_surface_commit(window->surface);
+
+	int64_t deadline = now_nsec() + 1000000000;
+	while (!client->frame_done) {
+		while (wl_display_prepare_read(client->display) != 0) {
+			wl_display_dispatch_pending(client->display);
+		}
+		wl_display_flush(client->display);
+		int timeout = (deadline - now_nsec()) / 1000000;
+		struct pollfd pfd = {
+			.fd = wl_display_get_fd(client->display),
+			.events = POLLIN,
+		};
+		if (timeout <= 0 || poll(&pfd, 1, timeout) <= 0) {
+			wl_display_cancel_read(client->display);
+			return client->frame_done;
+		}
+		wl_display_read_events(client->display);
+		wl_display_dispatch_pending(client->display);
+	}
+	return true;
+}
+
+static void
+map_windows(struct client *client)
+{
+	int64_t start = now_nsec();
+	for (int i = 0; i < client->nr_windows; i++) {
+		struct window *window = &client->windows[i];
+		window->surface = wl_compositor_create_surface(client->compositor);
+		window->xdg_surface = xdg_wm_base_get_xdg_surface(
+			client->wm_base, window->surface);
+		xdg_surface_add_listener(window->xdg_surface,
+			&xdg_surface_listener, window);
+		window->xdg_toplevel = xdg_surface_get_toplevel(
+			window->xdg_surface);
+		xdg_toplevel_add_listener(window->xdg_toplevel,
+			&toplevel_listener, window);
+
+		char title[32];
+		snprintf(title, sizeof(title), "bench %d", i);
+		xdg_toplevel_set_title(window->xdg_toplevel, title);
+		xdg_toplevel_set_app_id(window->xdg_toplevel, "labwc-bench");
+		wl_surface_commit(window->surface);
+	}
+	/* Receive the initial configure events */
+	wl_display_roundtrip(client->display);
+
+	for (int i = 0; i < client->nr_windows; i++) {
+		struct window *window = &client->windows[i];
+		wl_surface_attach(window->surface, client->buffer, 0, 0);
+		wl_surface_damage_buffer(window->surface, 0, 0,
+			INT32_MAX, INT32_MAX);
+		wl_surface_commit(window->surface);
+	}
+	wl_display_roundtrip(client->display);
+	report(client, "map_windows", client->nr_windows, start);
+
+	start = now_nsec();
+	if (wait_frame(client, &client->windows[client->nr_windows - 1])) {
+		report(client, "first_frame_after_map", 1, start);
+	}
+}
+
+static void
+snap_to_regions(struct client *client)
+{
+	/* The last mapped window is the focused one */
+	struct window *window = &client->windows[client->nr_windows - 1];
+	int64_t start = now_nsec();
+	for (int i = 0; i < REGION_SNAPS; i++) {
+		run_keybind(client, i % 2 ? KEY_SNAP_RIGHT : KEY_SNAP_LEFT);
+	}
+	report(client, "region_snap", REGION_SNAPS, start);
+
+	start = now_nsec();
+	for (int i = 0; i < REGION_SNAPS; i++) {
+		run_keybind(client, i % 2 ? KEY_SNAP_RIGHT : KEY_SNAP_LEFT);
+		if (!wait_frame(client, window)) {
+			return;
+		}
+	}
+	report(client, "region_snap_frame", REGION_SNAPS, start);
+}
+
+static void
+cycle_windows(struct client *client)
+{
+	int64_t start = now_nsec();
+	for (int i = 0; i < ALT_TAB_CYCLES; i++) {
+		/* Three steps, then releasing the modifier focuses the view */
+		set_logo(client, true);
+		tap_key(client, KEY_NEXT_WINDOW);
+		tap_key(client, KEY_NEXT_WINDOW);
+		tap_key(client, KEY_NEXT_WINDOW);
+		wl_display_roundtrip(client->display);
+		set_logo(client, false);
+		wl_display_roundtrip(client->display);
+	}
+	report(client, "alt_tab_cycle", ALT_TAB_CYCLES, start);
+}
+
+static void
+switch_workspaces(struct client *client)
+{
+	int64_t start = now_nsec();
+	for (int i = 0; i < WORKSPACE_SWITCHES; i++) {
+		run_keybind(client, KEY_NEXT_WORKSPACE);
+	}
+	report(client, "workspace_switch", WORKSPACE_SWITCHES, start);
+}
+
+static void
+hotplug_outputs(struct client *client)
+{
+	int64_t start = now_nsec();
+	for (int i = 0; i < OUTPUT_HOTPLUGS; i++) {
+		run_keybind(client, KEY_OUTPUT_ADD);
+		run_keybind(client, KEY_OUTPUT_REMOVE);
+	}
+	report(client, "output_hotplug", OUTPUT_HOTPLUGS, start);
+}
+
+static int
+run_client(int nr_windows)
+{
+	struct client client = {
+		.nr_windows = nr_windows,
+		.first_result = true,
+	};
+	client.display = wl_display_connect(NULL);
+	if (!client.display) {
+		fprintf(stderr, "cannot connect to the compositor\n");
+		return 1;
+	}
+	struct wl_registry *registry = wl_display_get_registry(client.display);
+	wl_registry_add_listener(registry, &registry_listener, &client);
+	wl_display_roundtrip(client.display);
+	if (!client.compositor || !client.shm || !client.seat
+			|| !client.wm_base || !client.keyboard_manager) {
+		fprintf(stderr, "required globals are missing\n");
+		return 1;
+	}
+	if (!create_buffer(&client) || !create_keyboard(&client)) {
+		fprintf(stderr, "cannot create buffer or keyboard: %s\n",
+			strerror(errno));
+		return 1;
+	}
+	client.windows = calloc(nr_windows, sizeof(*client.windows));
+	if (!client.windows) {
+		return 1;
+	}
+
+	printf("{\n  \"windows\": %d,\n  \"workloads\": [", nr_windows);
+	map_windows(&client);
+	snap_to_regions(&client);
+	cycle_windows(&client);
+	switch_workspaces(&client);
+	hotplug_outputs(&client);
+	printf("\n  ]\n}\n");
+
+	/* Have the compositor log its own numbers before we leave */
+	run_keybind(&client, KEY_DUMP_TIMING);
+
+	/* All objects go away with the connection */
+	wl_display_disconnect(client.display);
+	free(client.windows);
+	return 0;
+}
+
+static int
+run_compositor(const char *compositor, int nr_windows)
+{
+	char self[PATH_MAX];
+	ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+	if (len < 0) {
+		perror("readlink");
+		return 1;
+	}
+	self[len] = '\0';
+
+	char config_dir[] = "/tmp/labwc-bench-XXXXXX";
+	if (!mkdtemp(config_dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	char rc_path[sizeof(config_dir) + 16];
+	snprintf(rc_path, sizeof(rc_path), "%s/rc.xml", config_dir);
+	FILE *rc = fopen(rc_path, "w");
+	if (!rc) {
+		perror("fopen");
+		rmdir(config_dir);
+		return 1;
+	}
+	fputs(rc_xml, rc);
+	fclose(rc);
+
+	char client_cmd[PATH_MAX + 32];
+	snprintf(client_cmd, sizeof(client_cmd), "'%s' -C %d",
+		self, nr_windows);
+
+	setenv("WLR_BACKENDS", "headless", 1);
+	setenv("WLR_RENDERER", "pixman", 0);
+	setenv("WLR_HEADLESS_OUTPUTS", "1", 1);
+
+	int status = 1;
+	pid_t pid = fork();
+	if (pid == 0) {
+		/* The compositor exits when its primary client does */
+		execlp(compositor, compositor, "-C", config_dir, "-V",
+			"-S", client_cmd, (char *)NULL);
+		perror("execlp");
+		_exit(127);
+	} else if (pid > 0) {
+		waitpid(pid, &status, 0);
+		status = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+	} else {
+		perror("fork");
+	}
+
+	unlink(rc_path);
+	rmdir(config_dir);
+	return status;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *compositor = "labwc";
+	int nr_windows = 500;
+	int opt;
+	while ((opt = getopt(argc, argv, "c:n:C:")) != -1) {
+		switch (opt) {
+		case 'c':
+			compositor = optarg;
+			break;
+		case 'n':
+			nr_windows = atoi(optarg);
+			break;
+		case 'C':
+			/* Internal, see run_compositor() */
+			return run_client(atoi(optarg) > 0 ? atoi(optarg) : 1);
+		default:
+			fprintf(stderr, "usage: %s [-c <compositor>] "
+				"[-n <windows>]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (nr_windows < 1) {
+		nr_windows = 1;
+	}
+	return run_compositor(compositor, nr_windows);
+}
@@ -0,0 +1,278 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Benchmark of the rc.xml and themerc parsers
+ *
+ * Synthetic configurations with 1k, 10k and 100k keybinds, window rules
+ * and themerc entries are generated in memory and parsed through
+ * rcxml_parse_buffer() and theme_parse_buffer(). Files given on the
+ * command line are parsed as well, as themerc if their name ends in
+ * "themerc" and as rc.xml otherwise, so real configurations can be
+ * tracked next to the synthetic ones.
+ *
+ * Every workload runs in a child process. The parse time is measured in
+ * the child, the peak memory is the growth of its maximum resident set
+ * size during the parse. Results are printed as JSON.
+ *
+ * Usage: bench-parse [-n <max count>] [file...]
+ */
+#define _DEFAULT_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "common/buf.h"
+#include "common/macros.h"
+#include "config/rcxml.h"
+#include "theme.h"
+
+/* Defined in main.c otherwise */
+struct rcxml rc = { 0 };
+
+static const int counts[] = { 1000, 10000, 100000 };
+
+enum parser {
+	PARSER_RCXML,
+	PARSER_THEME,
+};
+
+struct workload {
+	const char *name;
+	enum parser parser;
+	void (*generate)(struct buf *buf, int count);
+};
+
+/* Up to 64 * 60 distinct keybinds, later ones replace earlier ones */
+static void
+add_key(struct buf *buf, int i)
+{
+	static const char *mods[] = { "W-", "A-", "C-", "S-", "H-", "M-" };
+	int combo = i / 60 % 64;
+	for (size_t m = 0; m < ARRAY_SIZE(mods); m++) {
+		if (combo & (1 << m)) {
+			buf_add(buf, mods[m]);
+		}
+	}
+	int key = i % 60;
+	if (key < 26) {
+		buf_add_char(buf, 'a' + key);
+	} else if (key < 36) {
+		buf_add_char(buf, '0' + key - 26);
+	} else {
+		buf_add_fmt(buf, "F%d", key - 35);
+	}
+}
+
+static void
+generate_keybinds(struct buf *buf, int count)
+{
+	buf_add(buf, "<?xml version=\"1.0\"?>\n<labwc_config>\n<keyboard>\n");
+	for (int i = 0; i < count; i++) {
+		buf_add(buf, "<keybind key=\"");
+		add_key(buf, i);
+		buf_add_fmt(buf, "\"><action name=\"Execute\" "
+			"command=\"app-%d\"/><action name=\"GoToDesktop\" "
+			"to=\"%d\"/></keybind>\n", i, i % 4 + 1);
+	}
+	buf_add(buf, "</keyboard>\n</labwc_config>\n");
+}
+
+static void
+generate_window_rules(struct buf *buf, int count)
+{
+	buf_add(buf, "<?xml version=\"1.0\"?>\n<labwc_config>\n<windowRules>\n");
+	for (int i = 0; i < count; i++) {
+		buf_add_fmt(buf, "<windowRule identifier=\"org.example.app%d\" "
+			"title=\"*document %d*\" serverDecoration=\"yes\">"
+			"<skipTaskbar>yes</skipTaskbar>"
+			"<action name=\"MoveTo\" x=\"%d\" y=\"%d\"/>"
+			"</windowRule>\n", i, i, i % 1000, i % 700);
+	}
+	buf_add(buf, "</windowRules>\n</labwc_config>\n");
+}
+
+static void
+generate_themerc(struct buf *buf, int count)
+{
+	static const char *entries[] = {
+		"window.active.title.bg.color: #%06x",
+		"window.inactive.label.text.color: #%06x",
+		"border.width: %d",
+		"menu.items.padding.x: %d",
+		"osd.border.color: #%06x",
+		"window.*.button.*.image.color: #%06x",
+		"# comment %d",
+	};
+	for (int i = 0; i < count; i++) {
+		buf_add_fmt(buf, entries[i % ARRAY_SIZE(entries)],
+			(i * 2654435761U) & 0xffffff);
+		buf_add_char(buf, '\n');
+	}
+}
+
+static const struct workload workloads[] = {
+	{ "rcxml_keybinds", PARSER_RCXML, generate_keybinds },
+	{ "rcxml_window_rules", PARSER_RCXML, generate_window_rules },
+	{ "themerc_entries", PARSER_THEME, generate_themerc },
+};
+
+static int64_t
+now_nsec(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static long
+max_rss_kib(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+struct child_result {
+	int64_t ns;
+	long rss_before_kib;
+};
+
+static void
+parse(enum parser parser, struct buf *input, struct child_result *result)
+{
+	result->rss_before_kib = max_rss_kib();
+	int64_t start = now_nsec();
+	if (parser == PARSER_RCXML) {
+		rcxml_parse_buffer(input->data, input->len);
+	} else {
+		struct theme theme = { 0 };
+		theme_parse_buffer(&theme, input->data, input->len);
+	}
+	result->ns = now_nsec() - start;
+	if (parser == PARSER_RCXML) {
+		rcxml_finish();
+	}
+}
+
+static bool
+read_file(const char *path, struct buf *buf)
+{
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		perror(path);
+		return false;
+	}
+	char chunk[4096];
+	size_t len;
+	while ((len = fread(chunk, 1, sizeof(chunk) - 1, file)) > 0) {
+		chunk[len] = '\0';
+		buf_add(buf, chunk);
+	}
+	fclose(file);
+	return true;
+}
+
+/*
+ * Runs one workload in a child process, so that its peak memory is not
+ * hidden by an earlier, bigger one
+ */
+static void
+run(const char *name, int count, enum parser parser,
+		void (*generate)(struct buf *buf, int count), const char *path,
+		bool *first)
+{
+	int fds[2];
+	if (pipe(fds) < 0) {
+		perror("pipe");
+		exit(EXIT_FAILURE);
+	}
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		struct buf input = BUF_INIT;
+		if (!path) {
+			generate(&input, count);
+		} else if (!read_file(path, &input)) {
+			_exit(EXIT_FAILURE);
+		}
+		struct child_result result;
+		parse(parser, &input, &result);
+		buf_reset(&input);
+		if (write(fds[1], &result, sizeof(result)) != sizeof(result)) {
+			_exit(EXIT_FAILURE);
+		}
+		_exit(EXIT_SUCCESS);
+	}
+
+	close(fds[1]);
+	struct child_result result;
+	ssize_t len = read(fds[0], &result, sizeof(result));
+	close(fds[0]);
+	int status;
+	struct rusage usage;
+	if (wait4(pid, &status, 0, &usage) < 0 || len != sizeof(result)
+			|| !WIFEXITED(status) || WEXITSTATUS(status)) {
+		fprintf(stderr, "%s: workload failed\n", name);
+		return;
+	}
+
+	printf("%s\n    {\"name\": \"%s\", \"count\": %d, \"parse_ms\": %.3f, "
+		"\"peak_kib\": %ld}", *first ? "" : ",", name, count,
+		result.ns / 1e6, usage.ru_maxrss - result.rss_before_kib);
+	*first = false;
+}
+
+static bool
+ends_with(const char *str, const char *suffix)
+{
+	size_t len = strlen(str), suffix_len = strlen(suffix);
+	return len >= suffix_len && !strcmp(str + len - suffix_len, suffix);
+}
+
+int
+main(int argc, char **argv)
+{
+	int max_count = counts[ARRAY_SIZE(counts) - 1];
+	int opt;
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			max_count = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-n <max count>] [file...]\n",
+				argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	wlr_log_init(WLR_SILENT, NULL);
+
+	bool first = true;
+	printf("{\n  \"benchmarks\": [");
+	for (size_t i = 0; i < ARRAY_SIZE(workloads); i++) {
+		for (size_t j = 0; j < ARRAY_SIZE(counts); j++) {
+			if (counts[j] > max_count) {
+				continue;
+			}
+			run(workloads[i].name, counts[j], workloads[i].parser,
+				workloads[i].generate, NULL, &first);
+		}
+	}
+	for (int i = optind; i < argc; i++) {
+		enum parser parser = ends_with(argv[i], "themerc")
+			? PARSER_THEME : PARSER_RCXML;
+		run(argv[i], 0, parser, NULL, argv[i], &first);
+	}
+	printf("\n  ]\n}\n");
+	return 0;
+}
@@ -0,0 +1,295 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Micro-benchmarks of hot common/ routines
+ *
+ * Every benchmark runs a fixed number of iterations over fixed inputs, a
+ * warm-up pass followed by BENCH_REPEATS timed passes. The median and the
+ * minimum time per operation are printed as JSON on stdout. An optional
+ * glob pattern on the command line selects the benchmarks to run.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common/box.h"
+#include "common/buf.h"
+#include "common/macros.h"
+#include "common/match.h"
+#include "common/set.h"
+#include "common/shadow.h"
+#include "img/xpm-color.h"
+
+#define BENCH_REPEATS 7
+
+/* Keeps the compiler from optimizing the benchmarked calls away */
+static volatile uint64_t sink;
+
+struct bench {
+	const char *name;
+	/* Number of operations done by one call of @run */
+	long ops;
+	void (*run)(void);
+};
+
+static void
+bench_buf_add(void)
+{
+	struct buf buf = BUF_INIT;
+	for (int i = 0; i < 1000; i++) {
+		buf_add(&buf, "client.example.Application");
+	}
+	sink += buf.len;
+	buf_reset(&buf);
+}
+
+static void
+bench_buf_add_fmt(void)
+{
+	struct buf buf = BUF_INIT;
+	for (int i = 0; i < 1000; i++) {
+		buf_add_fmt(&buf, "%s-%d:%.2f;", "output", i, i / 3.0);
+	}
+	sink += buf.len;
+	buf_reset(&buf);
+}
+
+/* Like the values of the window switcher fields, mostly under 64 bytes */
+static void
+bench_buf_short_fmt(void)
+{
+	for (int i = 0; i < 1000; i++) {
+		struct buf buf = BUF_INIT;
+		buf_add_fmt(&buf, "%d", i);
+		buf_add(&buf, " - ");
+		buf_add_fmt(&buf, "%s [%c]", "Terminal", i % 2 ? 'M' : ' ');
+		sink += buf.len;
+		buf_reset(&buf);
+	}
+}
+
+static void
+bench_buf_add_char(void)
+{
+	struct buf buf = BUF_INIT;
+	for (int i = 0; i < 10000; i++) {
+		buf_add_char(&buf, 'a' + i % 26);
+	}
+	sink += buf.len;
+	buf_reset(&buf);
+}
+
+static void
+bench_buf_expand_shell_variables(void)
+{
+	for (int i = 0; i < 100; i++) {
+		struct buf buf = BUF_INIT;
+		buf_add(&buf, "$LABWC_BENCH_DIR/themes/${LABWC_BENCH_NAME}"
+			"/openbox-3/$LABWC_BENCH_UNSET/themerc");
+		buf_expand_shell_variables(&buf);
+		sink += buf.len;
+		buf_reset(&buf);
+	}
+}
+
+static const char *glob_strings[] = {
+	"org.mozilla.firefox",
+	"org.gnome.Nautilus",
+	"foot",
+	"Alacritty",
+	"com.github.very.long.application.identifier.Name",
+	"steam_app_1234567",
+	"jetbrains-idea-ce",
+	"xdg-desktop-portal-gtk",
+};
+
+static void
+bench_match_glob(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(glob_strings); i++) {
+		sink += match_glob("org.*", glob_strings[i]);
+		sink += match_glob("*firefox*", glob_strings[i]);
+		sink += match_glob("steam_app_*", glob_strings[i]);
+		sink += match_glob("*.*.*.Name", glob_strings[i]);
+		sink += match_glob("foot", glob_strings[i]);
+	}
+}
+
+static void
+bench_lab_set(void)
+{
+	struct lab_set set = {0};
+	for (uint32_t i = 0; i < 1000; i++) {
+		lab_set_add(&set, i % LAB_SET_MAX_SIZE);
+		sink += lab_set_contains(&set, (i * 7) % (2 * LAB_SET_MAX_SIZE));
+		if (i % 3 == 0) {
+			lab_set_remove(&set, (i * 5) % LAB_SET_MAX_SIZE);
+		}
+	}
+	sink += set.size;
+}
+
+static void
+bench_box_fit_within(void)
+{
+	struct wlr_box bound = { .x = 10, .y = 20, .width = 64, .height = 48 };
+	for (int i = 1; i <= 1000; i++) {
+		struct wlr_box box = box_fit_within(i, 1001 - i, &bound);
+		sink += box.x + box.y + box.width + box.height;
+	}
+}
+
+static const char *xpm_colors[] = {
+	"#000",
+	"#ffffff",
+	"#ffff00000000",
+	"black",
+	"white",
+	"LightGoldenrodYellow",
+	"dark slate gray",
+	"gray50",
+	"YellowGreen",
+	"no such color",
+};
+
+static void
+bench_xpm_parse_color(void)
+{
+	for (int i = 0; i < 10; i++) {
+		for (size_t j = 0; j < ARRAY_SIZE(xpm_colors); j++) {
+			uint32_t argb = 0;
+			sink += xpm_parse_color(xpm_colors[j], &argb);
+			sink += argb;
+		}
+	}
+}
+
+/* Default shadow of the active window, see theme.c */
+#define SHADOW_VISIBLE 60
+#define SHADOW_TOTAL (SHADOW_VISIBLE + SHADOW_VISIBLE / 4)
+static const float shadow_color[4] = { 0, 0, 0, 0x60 / 255.0 };
+static uint32_t shadow_pixels[SHADOW_TOTAL * SHADOW_TOTAL];
+
+static void
+bench_shadow_profile(void)
+{
+	double *profile = shadow_profile(SHADOW_TOTAL);
+	sink += profile[SHADOW_TOTAL - 1] > 0.0;
+	free(profile);
+}
+
+static void
+bench_shadow_edge_gradient(void)
+{
+	double *profile = shadow_profile(SHADOW_TOTAL);
+	shadow_edge_gradient(shadow_pixels, profile, SHADOW_VISIBLE,
+		SHADOW_TOTAL, shadow_color);
+	sink += shadow_pixels[0];
+	free(profile);
+}
+
+static void
+bench_shadow_corner_gradient(void)
+{
+	double *profile = shadow_profile(SHADOW_TOTAL);
+	shadow_corner_gradient(shadow_pixels,
+		SHADOW_TOTAL * sizeof(*shadow_pixels), profile,
+		SHADOW_VISIBLE, SHADOW_TOTAL, /* titlebar_height */ 26,
+		shadow_color);
+	sink += shadow_pixels[SHADOW_TOTAL * SHADOW_TOTAL - 1];
+	free(profile);
+}
+
+static const struct bench benches[] = {
+	{ "buf_add", 1000, bench_buf_add },
+	{ "buf_add_fmt", 1000, bench_buf_add_fmt },
+	{ "buf_short_fmt", 1000, bench_buf_short_fmt },
+	{ "buf_add_char", 10000, bench_buf_add_char },
+	{ "buf_expand_shell_variables", 100, bench_buf_expand_shell_variables },
+	{ "match_glob", 5 * ARRAY_SIZE(glob_strings), bench_match_glob },
+	{ "lab_set", 1000, bench_lab_set },
+	{ "box_fit_within", 1000, bench_box_fit_within },
+	{ "xpm_parse_color", 10 * ARRAY_SIZE(xpm_colors), bench_xpm_parse_color },
+	{ "shadow_profile", 1, bench_shadow_profile },
+	{ "shadow_edge_gradient", 1, bench_shadow_edge_gradient },
+	{ "shadow_corner_gradient", 1, bench_shadow_corner_gradient },
+};
+
+static int64_t
+now_nsec(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/* Enough calls of @run to keep each timed pass around 10ms */
+static long
+calibrate(const struct bench *bench)
+{
+	long calls = 1;
+	for (;;) {
+		int64_t start = now_nsec();
+		for (long i = 0; i < calls; i++) {
+			bench->run();
+		}
+		int64_t elapsed = now_nsec() - start;
+		if (elapsed >= 10000000 || calls >= (1L << 24)) {
+			return calls;
+		}
+		calls *= 2;
+	}
+}
+
+static void
+run_bench(const struct bench *bench, bool first)
+{
+	long calls = calibrate(bench);
+	double ns_per_op[BENCH_REPEATS];
+	for (int r = 0; r < BENCH_REPEATS; r++) {
+		int64_t start = now_nsec();
+		for (long i = 0; i < calls; i++) {
+			bench->run();
+		}
+		ns_per_op[r] = (double)(now_nsec() - start)
+			/ ((double)calls * bench->ops);
+	}
+	qsort(ns_per_op, BENCH_REPEATS, sizeof(*ns_per_op), compare_double);
+
+	printf("%s\n    {\"name\": \"%s\", \"ops\": %ld, \"repeats\": %d, "
+		"\"median_ns_per_op\": %.3f, \"min_ns_per_op\": %.3f}",
+		first ? "" : ",", bench->name, calls * bench->ops,
+		BENCH_REPEATS, ns_per_op[BENCH_REPEATS / 2], ns_per_op[0]);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *filter = argc > 1 ? argv[1] : "*";
+
+	/* Fixed environment for buf_expand_shell_variables() */
+	setenv("LABWC_BENCH_DIR", "/usr/share", 1);
+	setenv("LABWC_BENCH_NAME", "Numix", 1);
+	unsetenv("LABWC_BENCH_UNSET");
+
+	bool first = true;
+	printf("{\n  \"benchmarks\": [");
+	for (size_t i = 0; i < ARRAY_SIZE(benches); i++) {
+		if (!match_glob(filter, benches[i].name)) {
+			continue;
+		}
+		run_bench(&benches[i], first);
+		first = false;
+	}
+	printf("\n  ]\n}\n");
+	return 0;
+}
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <cmocka.h>
+#include "common/bitset.h"
+
+static void
+test_bitset_add_remove(void **state)
+{
+	(void)state;
+
+	struct lab_bitset set = {0};
+	assert_false(lab_bitset_contains(&set, 30));
+
+	lab_bitset_add(&set, 30);
+	lab_bitset_add(&set, 30);
+	lab_bitset_add(&set, 64);
+	lab_bitset_add(&set, LAB_BITSET_MAX_BITS - 1);
+	assert_true(lab_bitset_contains(&set, 30));
+	assert_true(lab_bitset_contains(&set, 64));
+	assert_true(lab_bitset_contains(&set, LAB_BITSET_MAX_BITS - 1));
+	assert_false(lab_bitset_contains(&set, 63));
+	assert_int_equal(lab_bitset_count(&set), 3);
+
+	lab_bitset_remove(&set, 64);
+	lab_bitset_remove(&set, 65);
+	assert_false(lab_bitset_contains(&set, 64));
+	assert_int_equal(lab_bitset_count(&set), 2);
+}
+
+static void
+test_bitset_out_of_range(void **state)
+{
+	(void)state;
+
+	struct lab_bitset set = {0};
+	lab_bitset_add(&set, LAB_BITSET_MAX_BITS);
+	lab_bitset_add(&set, UINT32_MAX);
+	assert_false(lab_bitset_contains(&set, LAB_BITSET_MAX_BITS));
+	assert_int_equal(lab_bitset_count(&set), 0);
+	assert_int_equal(lab_bitset_next(&set, UINT32_MAX), -1);
+}
+
+static void
+test_bitset_for_each(void **state)
+{
+	(void)state;
+
+	struct lab_bitset set = {0};
+	const int values[] = { 0, 1, 63, 64, 200, LAB_BITSET_MAX_BITS - 1 };
+	for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		lab_bitset_add(&set, values[i]);
+	}
+
+	size_t i = 0;
+	lab_bitset_for_each(value, &set) {
+		assert_true(i < sizeof(values) / sizeof(values[0]));
+		assert_int_equal(value, values[i]);
+		i++;
+	}
+	assert_int_equal(i, sizeof(values) / sizeof(values[0]));
+	assert_int_equal(lab_bitset_next(&set, 65), 200);
+}
+
+static void
+test_bitset_parse_list(void **state)
+{
+	(void)state;
+
+	struct lab_bitset set = {0};
+	assert_true(lab_bitset_parse_list(&set, "0,2-3"));
+	assert_int_equal(lab_bitset_count(&set), 3);
+	assert_true(lab_bitset_contains(&set, 0));
+	assert_false(lab_bitset_contains(&set, 1));
+	assert_true(lab_bitset_contains(&set, 3));
+
+	/* Added to the existing values, overlaps are fine */
+	assert_true(lab_bitset_parse_list(&set, " 3 - 5 , 64 "));
+	assert_int_equal(lab_bitset_count(&set), 6);
+	assert_true(lab_bitset_contains(&set, 64));
+
+	const char *invalid[] = { "", " ", "1,", ",1", "3-2", "1-", "a",
+		"1;2", "-1", "768", "0-768" };
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		assert_false(lab_bitset_parse_list(&set, invalid[i]));
+	}
+	assert_int_equal(lab_bitset_count(&set), 6);
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_bitset_add_remove),
+		cmocka_unit_test(test_bitset_out_of_range),
+		cmocka_unit_test(test_bitset_for_each),
+		cmocka_unit_test(test_bitset_parse_list),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cmocka.h>
+#include "common/change-journal.h"
+
+static void
+test_change_journal_since(void **state)
+{
+	(void)state;
+
+	struct lab_change_journal journal = {0};
+	assert_int_equal(lab_change_journal_since(&journal, 0), 0);
+
+	lab_change_journal_record(&journal, 1 << 0);
+	uint64_t seen = journal.generation;
+	lab_change_journal_record(&journal, 1 << 1);
+	lab_change_journal_record(&journal, 1 << 2);
+
+	assert_int_equal(lab_change_journal_since(&journal, 0), 0x7);
+	assert_int_equal(lab_change_journal_since(&journal, seen), 0x6);
+	assert_int_equal(lab_change_journal_since(&journal,
+		journal.generation), 0);
+}
+
+static void
+test_change_journal_overflow(void **state)
+{
+	(void)state;
+
+	struct lab_change_journal journal = {0};
+	for (int i = 0; i < LAB_CHANGE_JOURNAL_SIZE; i++) {
+		lab_change_journal_record(&journal, 1 << 3);
+	}
+	/* Exactly as many generations as the journal keeps */
+	assert_int_equal(lab_change_journal_since(&journal, 0), 1 << 3);
+
+	lab_change_journal_record(&journal, 1 << 3);
+	/* One more and the first generation is forgotten */
+	assert_int_equal(lab_change_journal_since(&journal, 0), UINT32_MAX);
+	assert_int_equal(lab_change_journal_since(&journal, 1), 1 << 3);
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_change_journal_since),
+		cmocka_unit_test(test_change_journal_overflow),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * libFuzzer target of the rc.xml parser, from the XML document through
+ * post-processing and validation of the resulting configuration
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <wlr/util/log.h>
+#include "config/rcxml.h"
+
+/* Defined in main.c otherwise */
+struct rcxml rc = { 0 };
+
+int
+LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+	wlr_log_init(WLR_SILENT, NULL);
+	return 0;
+}
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	rcxml_parse_buffer((const char *)data, size);
+	rcxml_finish();
+	return 0;
+}
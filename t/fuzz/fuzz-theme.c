@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/* libFuzzer target of the themerc parser */
+#include <stddef.h>
+#include <stdint.h>
+#include <wlr/util/log.h>
+#include "config/rcxml.h"
+#include "theme.h"
+
+/* Defined in main.c otherwise */
+struct rcxml rc = { 0 };
+
+int
+LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+	wlr_log_init(WLR_SILENT, NULL);
+	return 0;
+}
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	struct theme theme = { 0 };
+	theme_parse_buffer(&theme, (const char *)data, size);
+	return 0;
+}
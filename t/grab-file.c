@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmocka.h>
+#include "common/grab-file.h"
+
+static void
+write_file(char *path, const char *content)
+{
+	int fd = mkstemp(path);
+	assert_true(fd >= 0);
+	size_t len = strlen(content);
+	assert_int_equal(write(fd, content, len), len);
+	close(fd);
+}
+
+static void
+test_grab_file_lines(void **state)
+{
+	(void)state;
+
+	char path[] = "/tmp/labwc-grab-file-XXXXXX";
+	write_file(path, "first\n\nthird\nno newline");
+	struct buf file = grab_file(path);
+	unlink(path);
+
+	/* Read as is, with exactly the file size allocated */
+	assert_int_equal(file.len, 24);
+	assert_int_equal(file.alloc, 25);
+	assert_string_equal(file.data, "first\n\nthird\nno newline");
+
+	size_t pos = 0;
+	assert_string_equal(grab_file_next_line(&file, &pos), "first");
+	assert_string_equal(grab_file_next_line(&file, &pos), "");
+	assert_string_equal(grab_file_next_line(&file, &pos), "third");
+	assert_string_equal(grab_file_next_line(&file, &pos), "no newline");
+	assert_null(grab_file_next_line(&file, &pos));
+	buf_reset(&file);
+}
+
+static void
+test_grab_file_empty_and_missing(void **state)
+{
+	(void)state;
+
+	char path[] = "/tmp/labwc-grab-file-XXXXXX";
+	write_file(path, "");
+	struct buf file = grab_file(path);
+	assert_int_equal(file.len, 0);
+	assert_true(file.alloc);
+	size_t pos = 0;
+	assert_null(grab_file_next_line(&file, &pos));
+	buf_reset(&file);
+
+	/* A missing file is told apart by an unallocated buffer */
+	unlink(path);
+	file = grab_file(path);
+	assert_int_equal(file.len, 0);
+	assert_false(file.alloc);
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_grab_file_lines),
+		cmocka_unit_test(test_grab_file_empty_and_missing),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
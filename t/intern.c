@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cmocka.h>
+#include "common/intern.h"
+
+static void
+test_intern_identity(void **state)
+{
+	(void)state;
+
+	char foot[] = "foot";
+	const char *a = lab_intern("foot");
+	const char *b = lab_intern(foot);
+	const char *c = lab_intern("Foot");
+	assert_ptr_equal(a, b);
+	assert_ptr_not_equal(a, foot);
+	assert_ptr_not_equal(a, c);
+	assert_string_equal(a, "foot");
+	assert_int_equal(lab_intern_hash(a), lab_intern_hash(b));
+	assert_ptr_equal(lab_intern_find("foot"), a);
+	assert_null(lab_intern_find("alacritty"));
+
+	assert_null(lab_intern(NULL));
+	assert_int_equal(lab_intern_hash(NULL), 0);
+	lab_intern_release(NULL);
+
+	lab_intern_release(a);
+	lab_intern_release(b);
+	lab_intern_release(c);
+}
+
+static void
+test_intern_release(void **state)
+{
+	(void)state;
+
+	const char *a = lab_intern("org.example.App");
+	const char *b = lab_intern("org.example.App");
+
+	/* Still there while a reference is left */
+	lab_intern_release(a);
+	assert_ptr_equal(lab_intern_find("org.example.App"), b);
+	lab_intern_release(b);
+	assert_null(lab_intern_find("org.example.App"));
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_intern_identity),
+		cmocka_unit_test(test_intern_release),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
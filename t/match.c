@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <cmocka.h>
+#include "common/match.h"
+
+static void
+test_match_glob_types(void **state)
+{
+	(void)state;
+
+	const struct {
+		const char *pattern;
+		enum match_glob_type type;
+	} cases[] = {
+		{ "foot", LAB_MATCH_GLOB_LITERAL },
+		{ "", LAB_MATCH_GLOB_LITERAL },
+		{ "*", LAB_MATCH_GLOB_ANY },
+		{ "**", LAB_MATCH_GLOB_ANY },
+		{ "org.*", LAB_MATCH_GLOB_PREFIX },
+		{ "*.desktop", LAB_MATCH_GLOB_SUFFIX },
+		{ "*fire*", LAB_MATCH_GLOB_SUBSTRING },
+		{ "a*b", LAB_MATCH_GLOB_FNMATCH },
+		{ "fo?t", LAB_MATCH_GLOB_FNMATCH },
+		{ "[ab]c", LAB_MATCH_GLOB_FNMATCH },
+		{ "\\*", LAB_MATCH_GLOB_FNMATCH },
+		{ "caf\xc3\xa9", LAB_MATCH_GLOB_FNMATCH },
+	};
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		struct match_glob glob;
+		match_glob_compile(&glob, cases[i].pattern);
+		assert_int_equal(glob.type, cases[i].type);
+	}
+}
+
+static void
+test_match_glob_null(void **state)
+{
+	(void)state;
+
+	struct match_glob glob;
+	match_glob_compile(&glob, NULL);
+	assert_true(match_glob_compiled(&glob, NULL));
+	assert_true(match_glob_compiled(&glob, "foo"));
+
+	match_glob_compile(&glob, "*");
+	assert_false(match_glob_compiled(&glob, NULL));
+	assert_true(match_glob_compiled(&glob, ""));
+}
+
+static void
+test_match_glob_same_as_fnmatch(void **state)
+{
+	(void)state;
+
+	const char *patterns[] = {
+		"foot", "FOOT", "", "*", "foo*", "*foot", "*OO*", "*o*o*",
+		"f?ot", "[fg]oot", "foot*", "*", "*t", "f*", "oo", "*oot*",
+	};
+	const char *strings[] = {
+		"foot", "Foot", "", "fo", "footclient", "xfoot", "o", "oo",
+		"boot", "FOOTX",
+	};
+
+	for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+		struct match_glob glob;
+		match_glob_compile(&glob, patterns[i]);
+		for (size_t j = 0; j < sizeof(strings) / sizeof(strings[0]); j++) {
+			assert_int_equal(match_glob_compiled(&glob, strings[j]),
+				match_glob(patterns[i], strings[j]));
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_match_glob_types),
+		cmocka_unit_test(test_match_glob_null),
+		cmocka_unit_test(test_match_glob_same_as_fnmatch),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
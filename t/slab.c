@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <cmocka.h>
+#include "common/slab.h"
+
+struct object {
+	int id;
+	char name[52];
+};
+
+static void
+test_slab_alloc(void **state)
+{
+	(void)state;
+
+	struct lab_slab slab = LAB_SLAB_INIT(struct object);
+	struct object *objects[1000];
+	for (int i = 0; i < 1000; i++) {
+		objects[i] = lab_slab_new(&slab, struct object);
+		assert_non_null(objects[i]);
+		assert_int_equal((uintptr_t)objects[i] % _Alignof(max_align_t), 0);
+		assert_int_equal(objects[i]->id, 0);
+		objects[i]->id = i;
+		memset(objects[i]->name, 'x', sizeof(objects[i]->name));
+	}
+	for (int i = 0; i < 1000; i++) {
+		assert_int_equal(objects[i]->id, i);
+	}
+	assert_int_equal(slab.nr_live, 1000);
+
+	for (int i = 0; i < 1000; i += 2) {
+		lab_slab_free(&slab, objects[i]);
+	}
+	assert_int_equal(slab.nr_live, 500);
+	lab_slab_free(&slab, NULL);
+
+	/* Freed objects are reused, and zeroed when handed out again */
+	struct object *reused = lab_slab_new(&slab, struct object);
+	assert_ptr_equal(reused, objects[998]);
+	assert_int_equal(reused->id, 0);
+	assert_int_equal(reused->name[0], 0);
+
+	lab_slab_release(&slab);
+	assert_null(slab.chunks);
+	assert_int_equal(slab.nr_live, 0);
+}
+
+static void
+test_slab_small_objects(void **state)
+{
+	(void)state;
+
+	/* Smaller than the free list link */
+	struct lab_slab slab = LAB_SLAB_INIT(char);
+	char *a = lab_slab_new(&slab, char);
+	char *b = lab_slab_new(&slab, char);
+	assert_ptr_not_equal(a, b);
+	*a = 'a';
+	*b = 'b';
+	lab_slab_free(&slab, a);
+	assert_int_equal(*b, 'b');
+	lab_slab_release(&slab);
+
+	/* Reusable after release */
+	assert_non_null(lab_slab_new(&slab, char));
+	lab_slab_release(&slab);
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_slab_alloc),
+		cmocka_unit_test(test_slab_small_objects),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
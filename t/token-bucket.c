@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <cmocka.h>
+#include "common/token-bucket.h"
+
+static void
+test_token_bucket_burst(void **state)
+{
+	(void)state;
+
+	struct lab_token_bucket bucket;
+	lab_token_bucket_init(&bucket, /* rate */ 10, /* burst */ 3, 1000);
+	assert_true(lab_token_bucket_take(&bucket, 1000));
+	assert_true(lab_token_bucket_take(&bucket, 1000));
+	assert_true(lab_token_bucket_take(&bucket, 1000));
+	assert_false(lab_token_bucket_take(&bucket, 1000));
+	assert_false(lab_token_bucket_take(&bucket, 1000));
+}
+
+static void
+test_token_bucket_refill(void **state)
+{
+	(void)state;
+
+	struct lab_token_bucket bucket;
+	lab_token_bucket_init(&bucket, /* rate */ 10, /* burst */ 2, 0);
+	assert_true(lab_token_bucket_take(&bucket, 0));
+	assert_true(lab_token_bucket_take(&bucket, 0));
+
+	/* 10 per second is one token every 100ms */
+	assert_false(lab_token_bucket_take(&bucket, 99));
+	assert_true(lab_token_bucket_take(&bucket, 100));
+	assert_false(lab_token_bucket_take(&bucket, 150));
+	assert_true(lab_token_bucket_take(&bucket, 200));
+
+	/* Refill is capped at the burst size */
+	assert_true(lab_token_bucket_take(&bucket, 100000));
+	assert_true(lab_token_bucket_take(&bucket, 100000));
+	assert_false(lab_token_bucket_take(&bucket, 100000));
+
+	/* Time going backwards must not refill */
+	assert_false(lab_token_bucket_take(&bucket, 50));
+}
+
+int main(int argc, char **argv)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_token_bucket_burst),
+		cmocka_unit_test(test_token_bucket_refill),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}